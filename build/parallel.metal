@@ -0,0 +1,215 @@
+#include <metal_stdlib>
+using namespace metal;
+
+// 병렬 기본 연산. study-metal/common/ComputePrimitives.hpp에 같은 kernel을 C++로 옮겨 두었다.
+// 01-primitive는 LEARNMETAL_PARALLEL_CHECK가 있으면 이 파일을 compile 해서 돌리고 CPU 결과와 비교한다.
+// threadgroup 하나는 thread 256개 x 4개 = 1024개를 맡고, thread는 연속된 4개를 맡는다.
+constant uint kThreads = 256;
+constant uint kItemsPerThread = 4;
+constant uint kBlockSize = kThreads * kItemsPerThread;
+constant uint kScanSteps = 8;
+constant uint kRadixBits = 4;
+constant uint kRadixDigits = 1 << kRadixBits;
+
+struct HistogramParams {
+	uint count;
+	uint numberOfBins;
+	uint itemsPerGroup;
+	uint numberOfGroups;
+};
+
+struct RadixParams {
+	uint count;
+	uint shift;
+	uint numberOfBlocks;
+	uint withValues;
+};
+
+// partial[2][kThreads]를 ping-pong 하는 Hillis-Steele inclusive scan. 끝나면 partial[0]에 있다.
+static void scanThreadgroup(threadgroup uint* partial, uint t)
+{
+	for (uint step = 0; step < kScanSteps; ++step) {
+		uint offset = 1u << step;
+		threadgroup uint* source = partial + (step & 1) * kThreads;
+		threadgroup uint* destination = partial + ((step + 1) & 1) * kThreads;
+		destination[t] = source[t] + (t >= offset ? source[t - offset] : 0);
+		threadgroup_barrier(mem_flags::mem_threadgroup);
+	}
+}
+
+// block마다 exclusive scan 하고 block 합을 blockSums에 쓴다. input과 output이 같아도 된다.
+kernel void scanBlocks(device const uint* input [[buffer(0)]],
+		device uint* output [[buffer(1)]],
+		device uint* blockSums [[buffer(2)]],
+		constant uint& count [[buffer(3)]],
+		threadgroup uint* partial [[threadgroup(0)]],
+		uint t [[thread_index_in_threadgroup]],
+		uint group [[threadgroup_position_in_grid]])
+{
+	uint first = group * kBlockSize + t * kItemsPerThread;
+	uint values[kItemsPerThread];
+	uint sum = 0;
+	for (uint k = 0; k < kItemsPerThread; ++k) {
+		values[k] = first + k < count ? input[first + k] : 0;
+		sum += values[k];
+	}
+	partial[t] = sum;
+	threadgroup_barrier(mem_flags::mem_threadgroup);
+	scanThreadgroup(partial, t);
+
+	uint running = partial[t] - sum;
+	for (uint k = 0; k < kItemsPerThread; ++k) {
+		if (first + k < count) {
+			output[first + k] = running;
+		}
+		running += values[k];
+	}
+	if (t == kThreads - 1) {
+		blockSums[group] = partial[t];
+	}
+}
+
+// scan 한 block 합을 block의 모든 원소에 더한다.
+kernel void addBlockOffsets(device uint* data [[buffer(0)]],
+		device const uint* blockOffsets [[buffer(1)]],
+		uint i [[thread_position_in_grid]])
+{
+	data[i] += blockOffsets[i / kBlockSize];
+}
+
+kernel void flagsToPositions(device const uchar* flags [[buffer(0)]],
+		device uint* positions [[buffer(1)]],
+		uint i [[thread_position_in_grid]])
+{
+	positions[i] = flags[i] != 0;
+}
+
+// positions는 flagsToPositions 결과를 scan 한 것이다.
+kernel void scatterFlagged(device const uint* values [[buffer(0)]],
+		device const uchar* flags [[buffer(1)]],
+		device const uint* positions [[buffer(2)]],
+		device uint* output [[buffer(3)]],
+		uint i [[thread_position_in_grid]])
+{
+	if (flags[i]) {
+		output[positions[i]] = values[i];
+	}
+}
+
+// group마다 연속된 itemsPerGroup개를 threadgroup memory에 세어 blockHistograms[group]에 쓴다.
+kernel void histogramBlocks(device const uint* values [[buffer(0)]],
+		device uint* blockHistograms [[buffer(1)]],
+		constant HistogramParams& params [[buffer(2)]],
+		threadgroup atomic_uint* bins [[threadgroup(0)]],
+		uint t [[thread_index_in_threadgroup]],
+		uint threads [[threads_per_threadgroup]],
+		uint group [[threadgroup_position_in_grid]])
+{
+	for (uint bin = t; bin < params.numberOfBins; bin += threads) {
+		atomic_store_explicit(&bins[bin], 0, memory_order_relaxed);
+	}
+	threadgroup_barrier(mem_flags::mem_threadgroup);
+	uint end = min(params.count, (group + 1) * params.itemsPerGroup);
+	for (uint i = group * params.itemsPerGroup + t; i < end; i += threads) {
+		uint value = values[i];
+		if (value < params.numberOfBins) {
+			atomic_fetch_add_explicit(&bins[value], 1, memory_order_relaxed);
+		}
+	}
+	threadgroup_barrier(mem_flags::mem_threadgroup);
+	for (uint bin = t; bin < params.numberOfBins; bin += threads) {
+		blockHistograms[group * params.numberOfBins + bin] = atomic_load_explicit(&bins[bin], memory_order_relaxed);
+	}
+}
+
+// thread 하나가 bin 하나의 group 합을 구한다.
+kernel void reduceHistograms(device const uint* blockHistograms [[buffer(0)]],
+		device uint* bins [[buffer(1)]],
+		constant HistogramParams& params [[buffer(2)]],
+		uint bin [[thread_position_in_grid]])
+{
+	uint sum = 0;
+	for (uint group = 0; group < params.numberOfGroups; ++group) {
+		sum += blockHistograms[group * params.numberOfBins + bin];
+	}
+	bins[bin] = sum;
+}
+
+// block마다 digit 개수를 blockCounts[digit * numberOfBlocks + block]에 쓴다. 이것을 scan 하면 radixScatter의 digitOffsets가 된다.
+kernel void radixCount(device const uint* keys [[buffer(0)]],
+		device uint* blockCounts [[buffer(1)]],
+		constant RadixParams& params [[buffer(2)]],
+		threadgroup atomic_uint* bins [[threadgroup(0)]],
+		uint t [[thread_index_in_threadgroup]],
+		uint block [[threadgroup_position_in_grid]])
+{
+	if (t < kRadixDigits) {
+		atomic_store_explicit(&bins[t], 0, memory_order_relaxed);
+	}
+	threadgroup_barrier(mem_flags::mem_threadgroup);
+	uint first = block * kBlockSize + t * kItemsPerThread;
+	for (uint i = first; i < min(first + kItemsPerThread, params.count); ++i) {
+		atomic_fetch_add_explicit(&bins[(keys[i] >> params.shift) & (kRadixDigits - 1)], 1, memory_order_relaxed);
+	}
+	threadgroup_barrier(mem_flags::mem_threadgroup);
+	if (t < kRadixDigits) {
+		blockCounts[t * params.numberOfBlocks + block] = atomic_load_explicit(&bins[t], memory_order_relaxed);
+	}
+}
+
+// counts[digit][thread]를 (digit, thread) 순서로 exclusive scan 하면 block 안의 stable rank가 된다.
+kernel void radixScatter(device const uint* keysIn [[buffer(0)]],
+		device uint* keysOut [[buffer(1)]],
+		device const uint* valuesIn [[buffer(2)]],
+		device uint* valuesOut [[buffer(3)]],
+		device const uint* digitOffsets [[buffer(4)]],
+		constant RadixParams& params [[buffer(5)]],
+		threadgroup uint* counts [[threadgroup(0)]],
+		threadgroup uint* partial [[threadgroup(1)]],
+		threadgroup uint* digitStart [[threadgroup(2)]],
+		uint t [[thread_index_in_threadgroup]],
+		uint block [[threadgroup_position_in_grid]])
+{
+	uint first = block * kBlockSize + t * kItemsPerThread;
+	uint last = min(first + kItemsPerThread, params.count);
+	// 자기 열(counts[*][t])만 건드리므로 barrier 없이 지우고 센다.
+	for (uint digit = 0; digit < kRadixDigits; ++digit) {
+		counts[digit * kThreads + t] = 0;
+	}
+	for (uint i = first; i < last; ++i) {
+		++counts[((keysIn[i] >> params.shift) & (kRadixDigits - 1)) * kThreads + t];
+	}
+	threadgroup_barrier(mem_flags::mem_threadgroup);
+
+	// thread t는 flat counts의 [t * kRadixDigits, (t + 1) * kRadixDigits)를 맡는다.
+	threadgroup uint* segment = counts + t * kRadixDigits;
+	uint sum = 0;
+	for (uint e = 0; e < kRadixDigits; ++e) {
+		sum += segment[e];
+	}
+	partial[t] = sum;
+	threadgroup_barrier(mem_flags::mem_threadgroup);
+	scanThreadgroup(partial, t);
+
+	uint running = partial[t] - sum;
+	for (uint e = 0; e < kRadixDigits; ++e) {
+		uint n = segment[e];
+		segment[e] = running;
+		running += n;
+	}
+	if (t % (kThreads / kRadixDigits) == 0) {
+		digitStart[t / (kThreads / kRadixDigits)] = segment[0];
+	}
+	threadgroup_barrier(mem_flags::mem_threadgroup);
+
+	for (uint i = first; i < last; ++i) {
+		uint key = keysIn[i];
+		uint digit = (key >> params.shift) & (kRadixDigits - 1);
+		uint local = counts[digit * kThreads + t]++;
+		uint position = digitOffsets[digit * params.numberOfBlocks + block] + local - digitStart[digit];
+		keysOut[position] = key;
+		if (params.withValues) {
+			valuesOut[position] = valuesIn[i];
+		}
+	}
+}
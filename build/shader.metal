@@ -6,16 +6,270 @@ struct VertexOut {
 	float4 color;
 };
 
-VertexOut vertex vertexMain(uint vertexId [[vertex_id]], 
-		device const float3* positions [[buffer(0)]],
-		device const float3* colors [[buffer(1)]]) 
+// attribute(4...8)은 MTL::VertexStepFunctionPerInstance buffer에서 instance마다 한 번 읽는다 (InstanceData).
+struct VertexIn {
+	float3 position [[attribute(0)]];
+	float3 color [[attribute(1)]];
+	float4 model0 [[attribute(4)]];
+	float4 model1 [[attribute(5)]];
+	float4 model2 [[attribute(6)]];
+	float4 model3 [[attribute(7)]];
+	float4 instanceColor [[attribute(8)]];
+};
+
+VertexOut vertex vertexMain(VertexIn in [[stage_in]])
 {
+	float4x4 model = float4x4(in.model0, in.model1, in.model2, in.model3);
 	VertexOut out;
-	out.position = float4(positions[vertexId], 1.0);
-	out.color = float4(colors[vertexId], 1.0);
+	out.position = model * float4(in.position, 1.0);
+	out.color = float4(in.color, 1.0) * in.instanceColor;
 	return out;
 }
 
 float4 fragment fragmentMain(VertexOut in [[stage_in]]) {
 	return in.color;
 }
+
+// glTF scene. vertex data는 glTF accessor로 만든 MTL::VertexDescriptor를 통해 읽는다.
+// 같은 mesh를 쓰는 draw는 instance 하나씩으로 모여 한 번에 그려진다.
+// 기능은 pipeline을 만들 때 function constant로 정한다. (ShaderVariants.hpp의 ShaderFeature bit 번호)
+// 꺼진 기능의 attribute는 vertex descriptor에 없어도 되고 그 계산은 compile 할 때 지워진다.
+constant bool kHasVertexColor [[function_constant(0)]];
+constant bool kHasTexture [[function_constant(1)]];
+constant bool kHasFog [[function_constant(2)]];
+constant bool kHasSkinning [[function_constant(3)]];
+
+struct SceneVertexIn {
+	float3 position [[attribute(0)]];
+	float4 color [[attribute(1), function_constant(kHasVertexColor)]];
+	float3 normal [[attribute(2)]];
+	float2 texcoord [[attribute(3), function_constant(kHasTexture)]];
+	float4 model0 [[attribute(4)]];
+	float4 model1 [[attribute(5)]];
+	float4 model2 [[attribute(6)]];
+	float4 model3 [[attribute(7)]];
+	float4 instanceColor [[attribute(8)]];
+	// glTF JOINTS_0 / WEIGHTS_0
+	uint4 joints [[attribute(9), function_constant(kHasSkinning)]];
+	float4 weights [[attribute(10), function_constant(kHasSkinning)]];
+};
+
+struct SceneVertexOut {
+	float4 position [[position]];
+	float4 color;
+	float2 texcoord;
+};
+
+SceneVertexOut vertex sceneVertexMain(SceneVertexIn in [[stage_in]],
+		constant float4x4& viewProjection [[buffer(16)]],
+		constant float4x4* jointMatrices [[buffer(18), function_constant(kHasSkinning)]])
+{
+	float4x4 modelViewProjection = viewProjection * float4x4(in.model0, in.model1, in.model2, in.model3);
+	float4 position = float4(in.position, 1.0);
+	float3 normal = in.normal;
+	if (kHasSkinning) {
+		float4x4 skin = in.weights.x * jointMatrices[in.joints.x] + in.weights.y * jointMatrices[in.joints.y] +
+			in.weights.z * jointMatrices[in.joints.z] + in.weights.w * jointMatrices[in.joints.w];
+		position = skin * position;
+		normal = (skin * float4(normal, 0.0)).xyz;
+	}
+	SceneVertexOut out;
+	out.position = modelViewProjection * position;
+	// 조명이 없으므로 화면을 향하는 정도로만 어둡게 한다.
+	normal = normalize((modelViewProjection * float4(normal, 0.0)).xyz);
+	// COLOR_0이 없으면 기본 attribute buffer와 같은 회색
+	float4 color = (kHasVertexColor ? in.color : float4(0.8, 0.8, 0.8, 1.0)) * in.instanceColor;
+	out.color = float4(color.rgb * (0.3 + 0.7 * abs(normal.z)), color.a);
+	out.texcoord = kHasTexture ? in.texcoord : float2(0.0);
+	return out;
+}
+
+// 01-primitive.cpp의 SceneFog와 같은 배치. depth가 start에서 end로 가는 동안 color로 섞는다.
+struct SceneFog {
+	float4 color;
+	float start;
+	float end;
+};
+
+float4 applyFog(float4 color, float depth, constant SceneFog& fog)
+{
+	float amount = saturate((depth - fog.start) / (fog.end - fog.start));
+	return float4(mix(color.rgb, fog.color.rgb, amount), color.a);
+}
+
+// residentLod보다 정밀한 mip은 아직 올라오지 않았으므로 그 level까지만 읽는다.
+float4 fragment sceneFragmentMain(SceneVertexOut in [[stage_in]],
+		texture2d<float> baseColor [[texture(0), function_constant(kHasTexture)]],
+		sampler baseColorSampler [[sampler(0), function_constant(kHasTexture)]],
+		constant float& residentLod [[buffer(0), function_constant(kHasTexture)]],
+		constant SceneFog& fog [[buffer(2), function_constant(kHasFog)]])
+{
+	float4 color = in.color;
+	if (kHasTexture) {
+		color *= baseColor.sample(baseColorSampler, in.texcoord, min_lod_clamp(residentLod));
+	}
+	if (kHasFog) {
+		color = applyFog(color, in.position.z, fog);
+	}
+	return color;
+}
+
+// 01-primitive.cpp의 VirtualTextureInfo와 같은 배치
+struct VirtualTextureInfo {
+	uint2 size;
+	uint2 tileSize;
+	uint tailLevel;
+	uint frame;
+	uint firstTile[16];
+	uint tilesWide[16];
+};
+
+// sparse texture. residencyMap은 level 0 tile마다 map 되어 있는 가장 정밀한 level이므로 그보다 정밀한 mip은 읽지 않는다.
+// 4x4 pixel 중 frame마다 돌아가며 한 pixel만 읽으려던 tile을 feedback에 표시한다. (SparseFeedback::record와 같은 계산)
+float4 fragment sceneVirtualFragmentMain(SceneVertexOut in [[stage_in]],
+		texture2d<float> baseColor [[texture(0)]],
+		texture2d<uint> residencyMap [[texture(1)]],
+		sampler baseColorSampler [[sampler(0)]],
+		constant VirtualTextureInfo& info [[buffer(0)]],
+		device atomic_uint* feedback [[buffer(1)]],
+		constant SceneFog& fog [[buffer(2), function_constant(kHasFog)]])
+{
+	float2 uv = fract(in.texcoord);
+	uint2 pixel = uint2(in.position.xy) & 3;
+	if ((pixel.x | pixel.y << 2) == (info.frame & 15)) {
+		uint level = uint(max(baseColor.calculate_unclamped_lod(baseColorSampler, in.texcoord), 0.0));
+		if (level < info.tailLevel) {
+			uint2 levelSize = max(info.size >> level, uint2(1));
+			uint2 tile = min(uint2(uv * float2(levelSize)), levelSize - 1) / info.tileSize;
+			uint index = info.firstTile[level] + tile.y * info.tilesWide[level] + tile.x;
+			uint bit = 1u << (index & 31);
+			// 이미 표시된 tile은 atomic 쓰기를 건너뛴다.
+			if ((atomic_load_explicit(&feedback[index >> 5], memory_order_relaxed) & bit) == 0) {
+				atomic_fetch_or_explicit(&feedback[index >> 5], bit, memory_order_relaxed);
+			}
+		}
+	}
+	uint2 tile = min(uint2(uv * float2(info.size)), info.size - 1) / info.tileSize;
+	float minLod = float(residencyMap.read(tile).r);
+	float4 color = in.color * baseColor.sample(baseColorSampler, in.texcoord, min_lod_clamp(minLod));
+	if (kHasFog) {
+		color = applyFog(color, in.position.z, fog);
+	}
+	return color;
+}
+
+// particle. ParticleSystem.hpp의 ParticleInstance와 같은 20 byte 배치
+struct ParticleInstance {
+	packed_float3 position;
+	float size;
+	uint color;
+};
+
+struct ParticleOut {
+	float4 position [[position]];
+	float4 color;
+	float2 corner;
+};
+
+// instance 하나가 triangle strip 4개 vertex의 사각형이다. 크기는 clip space에서 정하므로 항상 화면을 본다.
+ParticleOut vertex particleVertexMain(uint vertexId [[vertex_id]], uint instanceId [[instance_id]],
+		device const ParticleInstance* particles [[buffer(0)]],
+		constant float4x4& viewProjection [[buffer(1)]])
+{
+	ParticleInstance particle = particles[instanceId];
+	float2 corner = float2(vertexId & 1, vertexId >> 1) * 2.0 - 1.0;
+	float4 center = viewProjection * float4(float3(particle.position), 1.0);
+	ParticleOut out;
+	out.position = center + float4(corner * particle.size * center.w, 0.0, 0.0);
+	out.color = unpack_unorm4x8_to_float(particle.color);
+	out.corner = corner;
+	return out;
+}
+
+// 가운데에서 멀어질수록 투명해지는 원. 먼 것부터 그리므로 depth는 쓰지 않는다.
+float4 fragment particleFragmentMain(ParticleOut in [[stage_in]])
+{
+	float falloff = saturate(1.0 - dot(in.corner, in.corner));
+	return float4(in.color.rgb, in.color.a * falloff);
+}
+
+// HUD sprite. SpriteBatch.hpp의 SpriteVertex와 같은 20 byte 배치
+struct SpriteVertex {
+	packed_float2 position;
+	packed_float2 texcoord;
+	uint color;
+};
+
+struct SpriteOut {
+	float4 position [[position]];
+	float4 color;
+	float2 texcoord;
+};
+
+// position은 왼쪽 위가 (0, 0)인 pixel 좌표이다.
+SpriteOut vertex spriteVertexMain(uint vertexId [[vertex_id]],
+		device const SpriteVertex* vertices [[buffer(0)]],
+		constant float2& viewportSize [[buffer(1)]])
+{
+	SpriteVertex sprite = vertices[vertexId];
+	SpriteOut out;
+	out.position = float4(float2(sprite.position) / viewportSize * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+	out.color = unpack_unorm4x8_to_float(sprite.color);
+	out.texcoord = float2(sprite.texcoord);
+	return out;
+}
+
+float4 fragment spriteFragmentMain(SpriteOut in [[stage_in]],
+		texture2d<float> atlas [[texture(0)]],
+		sampler atlasSampler [[sampler(0)]])
+{
+	return in.color * atlas.sample(atlasSampler, in.texcoord);
+}
+
+// 통계 글자. FontAtlas.hpp의 GlyphInstance와 같은 32 byte 배치
+struct GlyphInstance {
+	packed_float2 position;
+	packed_float2 size;
+	ushort4 atlasRect;
+	uint color;
+	float screenRange;
+};
+
+struct TextUniforms {
+	float2 viewportSize;
+	float2 atlasSize;
+};
+
+struct TextOut {
+	float4 position [[position]];
+	float4 color;
+	float2 texcoord;
+	float screenRange [[flat]];
+};
+
+// instance 하나가 triangle strip 4개 vertex의 glyph 사각형이다. position은 왼쪽 위가 (0, 0)인 pixel 좌표이다.
+TextOut vertex textVertexMain(uint vertexId [[vertex_id]], uint instanceId [[instance_id]],
+		device const GlyphInstance* instances [[buffer(0)]],
+		constant TextUniforms& uniforms [[buffer(1)]])
+{
+	GlyphInstance glyph = instances[instanceId];
+	float2 corner = float2(vertexId & 1, vertexId >> 1);
+	float2 position = float2(glyph.position) + corner * float2(glyph.size);
+	TextOut out;
+	out.position = float4(position / uniforms.viewportSize * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+	out.color = unpack_unorm4x8_to_float(glyph.color);
+	out.texcoord = (float2(glyph.atlasRect.xy) + corner * float2(glyph.atlasRect.zw)) / uniforms.atlasSize;
+	out.screenRange = glyph.screenRange;
+	return out;
+}
+
+// rgb 중앙값이 0.5인 곳이 윤곽선이다. 화면 pixel 하나 폭으로 alpha를 부드럽게 바꾼다.
+float4 fragment textFragmentMain(TextOut in [[stage_in]],
+		texture2d<float> atlas [[texture(0)]],
+		sampler atlasSampler [[sampler(0)]])
+{
+	float3 distances = atlas.sample(atlasSampler, in.texcoord).rgb;
+	float median = max(min(distances.r, distances.g), min(max(distances.r, distances.g), distances.b));
+	float opacity = saturate((median - 0.5) * in.screenRange + 0.5);
+	return float4(in.color.rgb, in.color.a * opacity);
+}
@@ -14,13 +14,19 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <cassert>
+#include <random>
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
+#include <dispatch/dispatch.h>
 #include <simd/simd.h>
 
 #define NS_PRIVATE_IMPLEMENTATION
@@ -31,6 +37,28 @@
 #include <AppKit/AppKit.hpp>
 #include <MetalKit/MetalKit.hpp>
 
+#include "CommandTrace.hpp"
+#include "ComputePrimitives.hpp"
+#include "FilteringEncoder.hpp"
+#include "FontAtlas.hpp"
+#include "GltfLoader.hpp"
+#include "InstanceBatcher.hpp"
+#include "MeshImporter.hpp"
+#include "Meshlet.hpp"
+#include "MipmapGenerator.hpp"
+#include "OcclusionCulling.hpp"
+#include "ParallelPrimitives.hpp"
+#include "ParticleSystem.hpp"
+#include "PipelineCache.hpp"
+#include "RenderQueue.hpp"
+#include "SceneObjects.hpp"
+#include "ShaderVariants.hpp"
+#include "Simplifier.hpp"
+#include "SparseTexture.hpp"
+#include "SpriteBatch.hpp"
+#include "StateCache.hpp"
+#include "TextureLoader.hpp"
+
 #pragma region Declarations {
 	
 class Mesh {
@@ -38,14 +66,287 @@ class Mesh {
 		int numberOfVertices{0};
 		MTL::Buffer* pVertexPositionsBuffer{nullptr};
 		MTL::Buffer* pVertexColorsBuffer{nullptr};
+		// 파일에서 읽은 mesh는 index buffer로 vertex를 공유한다. 없으면 drawPrimitives로 그린다.
+		int numberOfIndices{0};
+		MTL::Buffer* pIndexBuffer{nullptr};
+		// 큰 mesh는 frame마다 meshlet 단위로 culling 하고 보이는 삼각형만 RenderPass::visibleIndexStream에 채운다.
+		MeshletData meshlets;
+		std::vector<uint32_t> visibleIndices;
+		size_t visibleTriangles{0};
+		// pIndexBuffer 안의 LOD 구간. lods[0]은 원래 mesh이고, 그릴 때는 meshlet culling 결과로 대신한다.
+		std::vector<MeshLod> lods;
+		// instance마다 LOD를 고를 때 화면까지의 거리를 재는 bounding sphere (mesh 좌표)
+		Float3 boundsCenter{};
+		float boundsRadius{0.0f};
 };
 
+// GPU가 앞 frame을 그리는 동안 덮어쓰지 않도록 frame마다 바뀌는 buffer는 이만큼 돌려 쓴다.
+// instance data는 currentRenderPassDescriptor로 drawable을 받기 전에 쓰므로 drawable 수로는 막을 수 없다.
+// Renderer::draw가 처음에 _frameSemaphore를 기다려 CPU가 이보다 앞서 나가지 않게 한다.
+static const size_t kMaxFramesInFlight = 3;
+
+// MTK::View의 attachment와 모든 render pipeline이 같이 쓰는 format. 다르면 Metal validation이 draw를 거부한다.
+// shader는 선형 색을 내고, sRGB로 바꾸는 일은 attachment에 맡긴다.
+static const MTL::PixelFormat kColorPixelFormat = MTL::PixelFormatBGRA8Unorm_sRGB;
+static const MTL::PixelFormat kDepthPixelFormat = MTL::PixelFormatDepth32Float;
+
+/*
+ * frame마다 새로 채우는 per-instance buffer (InstanceData 또는 ParticleInstance 배열). SpritePass는 SpriteVertex, TextPass는 GlyphInstance를 담는다.
+ * RenderPass::visibleIndexStream은 meshlet culling으로 남은 index를 담는다.
+ * */
+class InstanceStream {
+	public:
+		MTL::Buffer* pBuffers[kMaxFramesInFlight]{};
+		size_t frame{0};
+};
+
+// shader.metal의 VirtualTextureInfo와 같은 배치. 배열은 tail 앞의 level마다이다.
+struct VirtualTextureInfo {
+	uint32_t width;
+	uint32_t height;
+	uint32_t tileWidth;
+	uint32_t tileHeight;
+	uint32_t tailLevel;
+	// 4x4 pixel 중 이번 frame에 feedback을 쓰는 pixel
+	uint32_t frame;
+	uint32_t firstTile[16];
+	uint32_t tilesWide[16];
+};
+
+// shader.metal의 SceneFog와 같은 배치. 뒤의 padding은 MSL struct 크기(32 byte)를 맞춘다.
+struct SceneFog {
+	float color[4];
+	float start;
+	float end;
+	float padding[2];
+};
+
+/*
+ * LEARNMETAL_VIRTUAL_TEXTURE=<.vtex>이면 base color texture 대신 sparse heap에 만든 texture를 입힌다. (Apple6 이상)
+ * fragment shader가 읽은 tile을 feedback buffer에 표시하면 그 buffer를 다시 쓰기 직전(kMaxFramesInFlight frame 뒤)에 모아
+ * SparseResidency에 넘긴다. 모으는 것은 draw가 _frameSemaphore로 그 frame의 command buffer가 끝난 것을 확인한 뒤이다.
+ * 새 tile은 SparseTileStreamer가 읽어 오면 map 하고 blit으로 올리며, 내린 tile은 unmap 한다.
+ * 예산은 LEARNMETAL_VIRTUAL_TEXTURE_BUDGET_MB(기본 64)이고 heap도 그만큼만 잡는다.
+ * */
+class VirtualTexture {
+	public:
+		bool enabled{false};
+		SparseTextureFile file;
+		std::unique_ptr<SparseResidency> pResidency;
+		std::unique_ptr<SparseTileStreamer> pStreamer;
+		MTL::Heap* pHeap{nullptr};
+		MTL::Texture* pTexture{nullptr};
+		// level 0 tile마다 읽어도 되는 가장 정밀한 level (R8Uint)
+		MTL::Texture* pResidencyMap{nullptr};
+		MTL::Buffer* pFeedbackBuffers[kMaxFramesInFlight]{};
+		std::vector<SparseFeedback> feedback;
+		size_t frame{0};
+		VirtualTextureInfo info{};
+		std::vector<uint32_t> requested;
+		std::vector<uint32_t> loads;
+		std::vector<uint32_t> evictions;
+		std::vector<SparseTileData> arrived;
+		std::chrono::steady_clock::time_point lastReport;
+};
+
+// 모든 pass가 그리는 encoder. 호출을 그대로 Metal로 넘기고, LEARNMETAL_CAPTURE로 기록 중이면 trace에도 남긴다.
+using CapturedRenderEncoder = CapturingRenderEncoder<MTL::RenderCommandEncoder>;
+
 class RenderPass {
 	public:
 		// An object that contains graphics functions and
 		// configuration state to use in a render command.
 		MTL::RenderPipelineState* renderPipelineState{nullptr};
 		Mesh mesh;
+		// mesh를 그릴 위치와 색. instance 수만큼 한 번의 draw call로 그린다.
+		std::vector<InstanceData> instances;
+		InstanceStream instanceStream;
+		// instances를 고른 LOD 순서로 모은 것과 instance마다 고른 LOD. frame마다 다시 채운다.
+		std::vector<InstanceData> lodInstances;
+		std::vector<size_t> instanceLods;
+		// mesh.meshlets를 이번 frame의 view로 culling 한 triangle list
+		InstanceStream visibleIndexStream;
+};
+
+/*
+ * glTF scene을 그리기 위한 상태.
+ * vertex data는 glTF buffer를 복사 없이 감싼 MTL::Buffer에서 accessor offset 그대로 읽는다.
+ * */
+class ScenePass {
+	public:
+		GltfScene scene;
+		// scene.buffers[i]를 감싼 MTL::Buffer
+		std::vector<MTL::Buffer*> buffers;
+		// NORMAL이 없는 primitive가 읽는 기본값. COLOR_0, TEXCOORD_0이 없으면 그 기능이 꺼진 shader variant를 쓴다.
+		MTL::Buffer* pDefaultAttributesBuffer{nullptr};
+		// primitive마다 shader variant를 고르는 기준. LEARNMETAL_FOG가 있으면 멀수록 배경색으로 흐려진다.
+		// 값을 주면 fog가 시작하는 depth이다. (기본 0.5)
+		ShaderVariantOptions variantOptions;
+		SceneFog fog{};
+		// LEARNMETAL_TEXTURE=<.ktx2 / .dds>이면 scene 전체에 입히는 base color texture.
+		// 작은 mip부터 streamer가 읽어 두면 frame마다 blit으로 올리고, residentLod를 올라온 가장 정밀한 level로 낮춘다.
+		// texture가 없거나 아직 한 level도 올라오지 않았으면 1x1 흰색 texture를 쓴다.
+		// 파일에 level이 하나뿐이면 나머지 mip 자리를 잡아 두고, level 0을 올린 blit에서 generateMipmaps로 채운다.
+		MTL::Texture* pBaseColorTexture{nullptr};
+		MTL::Texture* pWhiteTexture{nullptr};
+		MTL::SamplerState* pSamplerState{nullptr};
+		TextureStreamer textureStreamer;
+		float residentLod{0.0f};
+		bool generateMipmaps{false};
+		std::chrono::steady_clock::time_point textureStart;
+		VirtualTexture virtualTexture;
+		// scene 전체를 clip volume 안에 넣는 변환
+		Float4x4 fitTransform;
+
+		// draw의 world bounds. userData는 scene.draws 번호이다.
+		// POSITION accessor에 min/max가 있는 draw만 들어 있고, 나머지는 항상 그린다.
+		SceneObjectStore objects;
+		std::vector<uint32_t> frustumVisible;
+
+		// Hi-Z occlusion culling. 큰 draw를 occluder로 software raster 해서 frustum 안의 draw를 검사한다.
+		struct Occluder {
+			uint32_t draw;
+			BvhTriangleGeometry geometry;
+		};
+		std::vector<Occluder> occluders;
+		OccluderRasterizer occluderRasterizer{256, 128};
+		DepthPyramid depthPyramid;
+		// frustumVisible 순서
+		std::vector<Aabb> occlusionBounds;
+		std::vector<uint8_t> occlusionVisible;
+		// scene.draws와 같은 순서
+		std::vector<uint8_t> drawVisible;
+
+		// 보이는 draw를 mesh별로 모아 instanced draw로 그린다.
+		InstanceBatcher batcher;
+		InstanceStream instanceStream;
+
+		// sort key에 넣는 pipeline 번호. primitivePipelines[mesh][primitive]가 pipelines의 번호이다.
+		std::vector<MTL::RenderPipelineState*> pipelines;
+		std::vector<std::vector<uint32_t>> primitivePipelines;
+		// batch의 primitive 하나가 draw 하나이다. queue의 draw 번호는 drawCommands의 번호이다.
+		struct DrawCommand {
+			uint32_t batch;
+			uint32_t primitive;
+		};
+		std::vector<DrawCommand> drawCommands;
+		RenderQueue renderQueue;
+		// 이미 묶인 state는 encoder까지 보내지 않는다. 통계는 frame마다 새로 센다.
+		// 걸러지고 남은 호출은 Renderer의 capture를 거쳐 Metal로 간다.
+		FilteringRenderEncoder<CapturedRenderEncoder> encoder;
+		size_t frameIndex{0};
+};
+
+/*
+ * LEARNMETAL_PARTICLES=<최대 수>이면 mesh / scene 위에 particle을 그린다.
+ * 시뮬레이션은 thread pool의 ParticleSystem이 하고, 먼 것부터 정렬한 ParticleInstance를 frame마다 올려
+ * 사각형 하나를 instance 수만큼 그린다. alpha blending을 하므로 depth test만 하고 depth는 쓰지 않는다.
+ * */
+class ParticlePass {
+	public:
+		std::unique_ptr<ParticleSystem> system;
+		MTL::RenderPipelineState* pPipelineState{nullptr};
+		MTL::DepthStencilState* pDepthStencilState{nullptr};
+		InstanceStream instanceStream;
+		std::chrono::steady_clock::time_point lastUpdate;
+		size_t frameIndex{0};
+};
+
+/*
+ * LEARNMETAL_HUD가 있으면 왼쪽 위에 frame 시간 graph를 그린다. 값을 주면 그만큼의 icon sprite가 화면을 떠다닌다. (LEARNMETAL_HUD=10000)
+ * HUD의 모든 사각형은 SpriteBatch 하나에 모여 atlas page마다 drawIndexedPrimitives 하나로 그린다.
+ * vertex는 pixel 좌표이고 depth와 상관없이 맨 위에 덮는다.
+ * */
+class SpritePass {
+	public:
+		SpriteAtlas atlas;
+		std::unique_ptr<SpriteBatch> batch;
+		std::vector<MTL::Texture*> pPageTextures;
+		MTL::RenderPipelineState* pPipelineState{nullptr};
+		MTL::DepthStencilState* pDepthStencilState{nullptr};
+		MTL::SamplerState* pSamplerState{nullptr};
+		// quad 순서대로 고정된 index. 더 많은 quad가 필요할 때만 다시 만든다.
+		MTL::Buffer* pIndexBuffer{nullptr};
+		size_t indexBufferQuads{0};
+		InstanceStream vertexStream;
+		uint32_t iconCount{0};
+		// 최근 frame 시간(ms) ring
+		std::vector<float> frameTimes;
+		size_t frameIndex{0};
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point lastFrame;
+};
+
+/*
+ * LEARNMETAL_FONT=<.mfnt>이면 왼쪽 위에 frame 시간과 pass별 counter를 글자로 쓴다. (tools/font-atlas로 만든다)
+ * 글자는 frame마다 TextBatch로 배치만 하고, glyph 하나가 instance 하나인 사각형을 draw 하나로 그린다.
+ * */
+class TextPass {
+	public:
+		FontAtlas atlas;
+		std::unique_ptr<TextBatch> batch;
+		MTL::Texture* pAtlasTexture{nullptr};
+		MTL::RenderPipelineState* pPipelineState{nullptr};
+		MTL::DepthStencilState* pDepthStencilState{nullptr};
+		MTL::SamplerState* pSamplerState{nullptr};
+		InstanceStream instanceStream;
+		std::chrono::steady_clock::time_point lastFrame;
+		// 숫자가 읽히도록 frame 시간은 몇 frame 평균을 쓴다.
+		float averageFrameTime{0.0f};
+};
+
+/*
+ * parallel.metal의 kernel을 GPU에서 dispatch 한다. dispatch 순서와 buffer 배치는 ComputePrimitives.hpp와 같다.
+ * 연산마다 command buffer 하나를 만들어 기다리므로 결과를 CPU와 비교하는 데만 쓴다.
+ * buffer는 shared storage이고 연산이 끝나면 모두 release 한다.
+ * */
+class ParallelKernels {
+	public:
+		ParallelKernels(MTL::Device* pDevice, MTL::CommandQueue* pCommandQueue) : _pDevice(pDevice), _pCommandQueue(pCommandQueue) {}
+		~ParallelKernels();
+		// path의 MSL을 compile 하고 kernel마다 compute pipeline을 만든다.
+		bool build(const char* path);
+
+		uint32_t exclusiveScan(const std::vector<uint32_t>& input, std::vector<uint32_t>& output);
+		size_t compact(const std::vector<uint32_t>& values, const std::vector<uint8_t>& flags, std::vector<uint32_t>& output);
+		// bin은 ComputePrimitivesDetail::kMaxHistogramBins 이하여야 한다.
+		bool histogram(const std::vector<uint32_t>& values, std::vector<uint32_t>& bins, uint32_t numberOfBins);
+		void radixSort(std::vector<uint32_t>& keys) { sort(keys, nullptr); }
+		void radixSortPairs(std::vector<uint32_t>& keys, std::vector<uint32_t>& values) { sort(keys, &values); }
+		// 마지막 연산의 command buffer가 GPU에서 걸린 시간
+		double gpuMilliseconds() const { return _gpuMilliseconds; }
+
+	private:
+		enum Kernel {
+			ScanBlocks,
+			AddBlockOffsets,
+			FlagsToPositions,
+			ScatterFlagged,
+			HistogramBlocks,
+			ReduceHistograms,
+			RadixCount,
+			RadixScatter,
+			NumberOfKernels,
+		};
+
+		void begin();
+		void commitAndWait();
+		// contents가 있으면 length byte를 복사해 둔다.
+		MTL::Buffer* newBuffer(size_t length, const void* contents = nullptr);
+		void releaseBuffers();
+		void dispatchThreadgroups(Kernel kernel, uint32_t threadgroups);
+		void dispatchThreads(Kernel kernel, uint32_t threads);
+		// block 합 buffer를 level마다 새로 만든다. input과 output이 같아도 된다.
+		void encodeScan(MTL::Buffer* pInput, MTL::Buffer* pOutput, uint32_t count);
+		void sort(std::vector<uint32_t>& keys, std::vector<uint32_t>* values);
+
+		MTL::Device* _pDevice;
+		MTL::CommandQueue* _pCommandQueue;
+		MTL::ComputePipelineState* _pPipelineStates[NumberOfKernels]{};
+		MTL::CommandBuffer* _pCommandBuffer{nullptr};
+		MTL::ComputeCommandEncoder* _pEncoder{nullptr};
+		std::vector<MTL::Buffer*> _buffers;
+		double _gpuMilliseconds{0.0};
 };
 
 /*
@@ -55,11 +356,61 @@ class RenderPass {
 class Renderer
 {
 	public:
-		Renderer(MTL::Device* pDevice);
+		Renderer(MTL::Device* pDevice, const char* meshPath = nullptr);
 		~Renderer();
 		// New in 01-primitive
 		void buildShaders();
 		void buildBuffers();
+		// LEARNMETAL_PARTICLES가 있으면 particlePass를 만든다.
+		void buildParticles();
+		// LEARNMETAL_HUD가 있으면 spritePass의 atlas와 pipeline을 만든다.
+		void buildSprites();
+		// LEARNMETAL_FONT가 있으면 textPass의 atlas texture와 pipeline을 만든다.
+		void buildText();
+		// .obj / .ply 파일을 읽어 renderPass.mesh를 만든다.
+		bool loadMesh(const char* path);
+		// mesh.meshlets를 현재 view로 culling 해서 이번 frame의 visible index buffer를 채워 반환한다. draw가 frame마다 부른다.
+		MTL::Buffer* cullMeshletsForView(const MeshletCullParams& params);
+		// .gltf / .glb 파일을 읽어 scenePass를 만든다.
+		bool loadScene(const char* path);
+		// primitive의 vertex layout과 shader variant로 scene pipeline key를 만든다.
+		PipelineKey scenePipelineKey(const GltfPrimitive& primitive) const;
+		// _pipelineStates가 pool thread에서 부른다. 실패하면 nullptr
+		MTL::RenderPipelineState* newRenderPipelineState(const PipelineKey& key);
+		// scenePass의 sampler와 base color texture를 만들고 LEARNMETAL_TEXTURE의 streaming을 시작한다.
+		void buildSceneTexture();
+		// LEARNMETAL_VIRTUAL_TEXTURE의 sparse texture를 만들고 mip tail을 올린다. 쓸 수 없으면 false
+		bool buildVirtualTexture(const char* path);
+		// 읽혀 있는 mip을 blit으로 올린다. render encoder를 만들기 전에 부른다.
+		void uploadTextureLevels(MTL::CommandBuffer* pCmd);
+		// feedback으로 virtual texture의 tile을 map / unmap 하고 읽혀 있는 tile을 올린다.
+		// _frameSemaphore를 기다린 뒤, render encoder를 만들기 전에 부른다.
+		void updateVirtualTexture(MTL::CommandBuffer* pCmd);
+		// draw bounds와 occluder를 고른다. loadScene에서 한 번 부른다.
+		void prepareCulling();
+		// frustum / occlusion culling으로 scenePass.drawVisible을 채운다.
+		void cullDraws();
+		// 이번 frame에 쓸 stream의 buffer. size byte보다 작으면 다시 만든다. draw가 _frameSemaphore를 기다린 뒤에만 부른다.
+		MTL::Buffer* nextInstanceBuffer(InstanceStream& stream, size_t size);
+		// instances를 이번 frame의 buffer에 복사해서 반환한다.
+		MTL::Buffer* uploadInstances(InstanceStream& stream, const std::vector<InstanceData>& instances);
+		void drawScene(CapturedRenderEncoder& capture);
+		// particle을 dt만큼 움직이고 정렬해서 그린다.
+		void drawParticles(CapturedRenderEncoder& encoder);
+		// HUD sprite를 모아 atlas page마다 한 번씩 그린다. 마지막에 부른다.
+		void drawSprites(CapturedRenderEncoder& encoder, MTK::View* pView);
+		// 통계 글자를 배치해서 그린다. HUD 위에 덮도록 가장 마지막에 부른다.
+		void drawText(CapturedRenderEncoder& encoder, MTK::View* pView);
+		/*
+		 * LEARNMETAL_PARALLEL_CHECK가 있으면 시작할 때 부른다. 값을 주면 그만큼의 key로 한다. (기본 100만)
+		 * parallel.metal의 scan / compaction / histogram / radix sort를 GPU에서 돌려 ParallelPrimitives.hpp의 CPU 결과와
+		 * bit 단위로 비교한다.
+		 * */
+		void checkParallelKernels(size_t count);
+		// 기록할 frame이 남았으면 trace를 시작한다. encoder를 만든 직후에 부른다.
+		void beginCapture(MTL::RenderCommandEncoder* pEnc);
+		// frame을 닫고, 마지막 frame이었으면 파일로 저장한다. endEncoding 뒤에 부른다.
+		void endCapture();
 		void draw(MTK::View* pView);
 
 	private:
@@ -67,11 +418,33 @@ class Renderer
 		MTL::CommandQueue* _pCommandQueue;
 		// 01-primitive
 		RenderPass renderPass;
+		const char* _meshPath;
+		MTL::Library* _pShaderLibrary{nullptr};
+		MTL::DepthStencilState* _pDepthStencilState{nullptr};
+		// 같은 내용의 sampler / depth-stencil descriptor는 한 번만 만든다. pass는 acquire로 받은 참조를 release 한다.
+		StateCache<SamplerKey, MTL::SamplerState> _samplerStates;
+		StateCache<DepthStencilKey, MTL::DepthStencilState> _depthStencilStates;
+		// 모든 render pipeline. cache가 가지고 있으므로 pass는 release 하지 않는다.
+		// LEARNMETAL_PIPELINE_MANIFEST=<.lmpc>이면 시작할 때 그 파일의 pipeline을 미리 compile 하고 끝날 때 다시 쓴다.
+		PipelineCache<MTL::RenderPipelineState> _pipelineStates;
+		ScenePass scenePass;
+		bool _drawScene{false};
+		ParticlePass particlePass;
+		SpritePass spritePass;
+		TextPass textPass;
+		// 모든 pass의 호출이 거쳐 간다.
+		// LEARNMETAL_CAPTURE=<파일>이면 처음 _framesToCapture frame(LEARNMETAL_CAPTURE_FRAMES, 기본 1)을 trace로 저장한다.
+		CapturedRenderEncoder _capture;
+		CommandTraceWriter _traceWriter;
+		const char* _capturePath{nullptr};
+		size_t _framesToCapture{0};
+		// GPU가 끝내지 않은 frame 수를 kMaxFramesInFlight로 제한한다. command buffer가 끝나면 signal 한다.
+		dispatch_semaphore_t _frameSemaphore;
 };
 
 class MyMTKViewDelegate : public MTK::ViewDelegate {
 	public:
-		MyMTKViewDelegate(MTL::Device* pDevice);
+		MyMTKViewDelegate(MTL::Device* pDevice, const char* meshPath);
 		virtual ~MyMTKViewDelegate() override;
 		/* Called every frame(precisely, application loop) from the main evetn application loop.
 		 * MTK::View forwards events to the view delegate class, such as a "render" event.
@@ -90,6 +463,8 @@ class MyMTKViewDelegate : public MTK::ViewDelegate {
 class MyAppDelegate : public NS::ApplicationDelegate
 {
 	public:
+		// meshPath가 주어지면 사각형 대신 그 파일의 mesh를 그린다.
+		explicit MyAppDelegate(const char* meshPath = nullptr);
 		~MyAppDelegate();
 		// 사용자가 윈도우를 조작할수 있는 다양한 메뉴를 만든다.
 		NS::Menu* createMenuBar();
@@ -110,16 +485,18 @@ class MyAppDelegate : public NS::ApplicationDelegate
 		MTK::View* _pMtkView;
 		MTL::Device* _pDevice;
 		MyMTKViewDelegate* _pViewDelegate = nullptr;
+		const char* _meshPath;
 };
 
 #pragma endregion Declarations }
 
-int main() {
+int main(int argc, char* argv[]) {
 	std::cout << "Hello Metal\n";
 
 	NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
 
-	MyAppDelegate del;
+	// ./01-primitive [mesh.obj | mesh.ply | scene.gltf | scene.glb]
+	MyAppDelegate del(argc > 1 ? argv[1] : nullptr);
 
 	NS::Application* pSharedApplication = NS::Application::sharedApplication();
 	pSharedApplication->setDelegate(&del);
@@ -133,6 +510,11 @@ int main() {
 # pragma mark - AppDelegate
 # pragma region AppDelegate
 
+MyAppDelegate::MyAppDelegate(const char* meshPath)
+: _meshPath(meshPath)
+{
+}
+
 MyAppDelegate::~MyAppDelegate()
 {
 	_pWindow->release();
@@ -218,9 +600,11 @@ void MyAppDelegate::applicationDidFinishLaunching(NS::Notification* pNotificatio
 	// View 객체 준비
 	_pDevice = MTL::CreateSystemDefaultDevice();
 	_pMtkView = MTK::View::alloc()->init(frame, _pDevice);
-	_pMtkView->setColorPixelFormat(MTL::PixelFormatBGRA8Unorm);
+	_pMtkView->setColorPixelFormat(kColorPixelFormat);
+	_pMtkView->setDepthStencilPixelFormat(kDepthPixelFormat);
+	_pMtkView->setClearDepth(1.0);
 	_pMtkView->setClearColor(MTL::ClearColor::Make(1.0, 0.0, 0.0, 1.0));
-	_pViewDelegate = new MyMTKViewDelegate(_pDevice);
+	_pViewDelegate = new MyMTKViewDelegate(_pDevice, _meshPath);
 	_pMtkView->setDelegate(_pViewDelegate);
 	_pWindow->setContentView(_pMtkView);
 	_pWindow->setTitle(NS::String::string("01 - Primitive 실습", NS::UTF8StringEncoding));
@@ -242,8 +626,8 @@ bool MyAppDelegate::applicationShouldTerminateAfterLastWindowClosed(
 # pragma mark - ViewDelegate
 # pragma region ViewDelegate {
 
-MyMTKViewDelegate::MyMTKViewDelegate(MTL::Device* pDevice)
-: MTK::ViewDelegate(), _pRenderer(new Renderer(pDevice))
+MyMTKViewDelegate::MyMTKViewDelegate(MTL::Device* pDevice, const char* meshPath)
+: MTK::ViewDelegate(), _pRenderer(new Renderer(pDevice, meshPath))
 {
 }
 
@@ -263,18 +647,185 @@ void MyMTKViewDelegate::drawInMTKView(MTK::View* pView)
 #pragma mark - Renderer
 #pragma region Renderer {
 
-Renderer::Renderer(MTL::Device* pDevice)
-: _pDevice(pDevice->retain())
+static MTL::SamplerState* newSamplerState(MTL::Device* pDevice, const SamplerKey& key)
+{
+	MTL::SamplerDescriptor* pSamplerDescriptor = MTL::SamplerDescriptor::alloc()->init();
+	pSamplerDescriptor->setMinFilter(MTL::SamplerMinMagFilter(key.minFilter));
+	pSamplerDescriptor->setMagFilter(MTL::SamplerMinMagFilter(key.magFilter));
+	pSamplerDescriptor->setMipFilter(MTL::SamplerMipFilter(key.mipFilter));
+	pSamplerDescriptor->setMaxAnisotropy(key.maxAnisotropy);
+	pSamplerDescriptor->setSAddressMode(MTL::SamplerAddressMode(key.sAddressMode));
+	pSamplerDescriptor->setTAddressMode(MTL::SamplerAddressMode(key.tAddressMode));
+	pSamplerDescriptor->setRAddressMode(MTL::SamplerAddressMode(key.rAddressMode));
+	pSamplerDescriptor->setBorderColor(MTL::SamplerBorderColor(key.borderColor));
+	pSamplerDescriptor->setNormalizedCoordinates(key.normalizedCoordinates);
+	pSamplerDescriptor->setLodMinClamp(key.lodMinClamp);
+	pSamplerDescriptor->setLodMaxClamp(key.lodMaxClamp);
+	pSamplerDescriptor->setLodAverage(key.lodAverage);
+	pSamplerDescriptor->setCompareFunction(MTL::CompareFunction(key.compareFunction));
+	pSamplerDescriptor->setSupportArgumentBuffers(key.supportArgumentBuffers);
+	MTL::SamplerState* pSamplerState = pDevice->newSamplerState(pSamplerDescriptor);
+	pSamplerDescriptor->release();
+	return pSamplerState;
+}
+
+static MTL::StencilDescriptor* newStencilDescriptor(const StencilKey& key)
+{
+	MTL::StencilDescriptor* pStencil = MTL::StencilDescriptor::alloc()->init();
+	pStencil->setStencilCompareFunction(MTL::CompareFunction(key.compareFunction));
+	pStencil->setStencilFailureOperation(MTL::StencilOperation(key.stencilFailureOperation));
+	pStencil->setDepthFailureOperation(MTL::StencilOperation(key.depthFailureOperation));
+	pStencil->setDepthStencilPassOperation(MTL::StencilOperation(key.depthStencilPassOperation));
+	pStencil->setReadMask(key.readMask);
+	pStencil->setWriteMask(key.writeMask);
+	return pStencil;
+}
+
+static MTL::DepthStencilState* newDepthStencilState(MTL::Device* pDevice, const DepthStencilKey& key)
+{
+	MTL::DepthStencilDescriptor* pDsd = MTL::DepthStencilDescriptor::alloc()->init();
+	pDsd->setDepthCompareFunction(MTL::CompareFunction(key.depthCompareFunction));
+	pDsd->setDepthWriteEnabled(key.depthWriteEnabled);
+	if (key.frontFaceStencilEnabled) {
+		MTL::StencilDescriptor* pStencil = newStencilDescriptor(key.frontFaceStencil);
+		pDsd->setFrontFaceStencil(pStencil);
+		pStencil->release();
+	}
+	if (key.backFaceStencilEnabled) {
+		MTL::StencilDescriptor* pStencil = newStencilDescriptor(key.backFaceStencil);
+		pDsd->setBackFaceStencil(pStencil);
+		pStencil->release();
+	}
+	MTL::DepthStencilState* pDepthStencilState = pDevice->newDepthStencilState(pDsd);
+	pDsd->release();
+	return pDepthStencilState;
+}
+
+Renderer::Renderer(MTL::Device* pDevice, const char* meshPath)
+: _pDevice(pDevice->retain()), _meshPath(meshPath),
+	_samplerStates([this](const SamplerKey& key) { return newSamplerState(_pDevice, key); }),
+	_depthStencilStates([this](const DepthStencilKey& key) { return newDepthStencilState(_pDevice, key); }),
+	_pipelineStates([this](const PipelineKey& key) { return newRenderPipelineState(key); })
 {
 	_pCommandQueue = _pDevice->newCommandQueue();
+	_frameSemaphore = dispatch_semaphore_create(kMaxFramesInFlight);
 	buildShaders();
+	// library가 있어야 하므로 buildShaders 다음에 건다. 기다리지 않고 mesh / scene을 읽는 동안 compile 된다.
+	if (const char* manifest = std::getenv("LEARNMETAL_PIPELINE_MANIFEST")) {
+		std::vector<PipelineKey> keys;
+		if (loadPipelineManifest(manifest, keys)) {
+			_pipelineStates.prewarm(keys);
+		}
+	}
 	buildBuffers();
+	buildParticles();
+	buildSprites();
+	buildText();
+	if (const char* parallelCheck = std::getenv("LEARNMETAL_PARALLEL_CHECK")) {
+		const long count = std::atol(parallelCheck);
+		checkParallelKernels(count > 0 ? size_t(std::min(count, 1l << 28)) : 1000000);
+	}
+	if (const char* capturePath = std::getenv("LEARNMETAL_CAPTURE")) {
+		const char* frames = std::getenv("LEARNMETAL_CAPTURE_FRAMES");
+		_capturePath = capturePath;
+		_framesToCapture = frames ? std::max(1l, std::atol(frames)) : 1;
+		_traceWriter.setBufferResolver([](const void* pBuffer) {
+			MTL::Buffer* pMetalBuffer = const_cast<MTL::Buffer*>(static_cast<const MTL::Buffer*>(pBuffer));
+			return TraceBufferView{ pMetalBuffer->contents(), pMetalBuffer->length() };
+		});
+	}
+	const StateCacheStats samplerStats = _samplerStates.stats(), depthStencilStats = _depthStencilStates.stats();
+	std::cout << "states: " << samplerStats.creations << " samplers (" << samplerStats.hits << " reused), " << depthStencilStats.creations
+		<< " depth-stencil (" << depthStencilStats.hits << " reused)" << std::endl;
+	const PipelineCacheStats pipelineStats = _pipelineStates.stats();
+	std::cout << "pipelines: " << pipelineStats.size << " (" << pipelineStats.prewarmed << " prewarmed, " << pipelineStats.hits
+		<< " reused), " << pipelineStats.compileMilliseconds << " ms compiling" << std::endl;
 }
 
 Renderer::~Renderer()
 {
+	// 아직 GPU가 쓰고 있는 buffer가 없도록 남은 frame이 모두 끝나길 기다린다.
+	for (size_t i = 0; i < kMaxFramesInFlight; ++i) {
+		dispatch_semaphore_wait(_frameSemaphore, DISPATCH_TIME_FOREVER);
+	}
+	Mesh& mesh = renderPass.mesh;
+	if (mesh.pVertexPositionsBuffer) {
+		mesh.pVertexPositionsBuffer->release();
+		mesh.pVertexColorsBuffer->release();
+	}
+	if (mesh.pIndexBuffer) {
+		mesh.pIndexBuffer->release();
+	}
+	for (MTL::Buffer* pBuffer : scenePass.buffers) {
+		pBuffer->release();
+	}
+	if (scenePass.pDefaultAttributesBuffer) {
+		scenePass.pDefaultAttributesBuffer->release();
+	}
+	for (MTL::Texture* pTexture : { scenePass.pBaseColorTexture, scenePass.pWhiteTexture }) {
+		if (pTexture) {
+			pTexture->release();
+		}
+	}
+	if (scenePass.pSamplerState) {
+		scenePass.pSamplerState->release();
+	}
+	// tile을 읽던 작업이 끝난 뒤에 texture를 놓는다.
+	scenePass.virtualTexture.pStreamer.reset();
+	for (MTL::Texture* pTexture : { scenePass.virtualTexture.pTexture, scenePass.virtualTexture.pResidencyMap }) {
+		if (pTexture) {
+			pTexture->release();
+		}
+	}
+	if (scenePass.virtualTexture.pHeap) {
+		scenePass.virtualTexture.pHeap->release();
+	}
+	for (MTL::Buffer* pBuffer : scenePass.virtualTexture.pFeedbackBuffers) {
+		if (pBuffer) {
+			pBuffer->release();
+		}
+	}
+	for (InstanceStream* pStream : { &renderPass.instanceStream, &renderPass.visibleIndexStream, &scenePass.instanceStream, &particlePass.instanceStream, &spritePass.vertexStream, &textPass.instanceStream }) {
+		for (MTL::Buffer* pBuffer : pStream->pBuffers) {
+			if (pBuffer) {
+				pBuffer->release();
+			}
+		}
+	}
+	if (particlePass.pPipelineState) {
+		particlePass.pDepthStencilState->release();
+	}
+	for (MTL::Texture* pTexture : spritePass.pPageTextures) {
+		pTexture->release();
+	}
+	if (spritePass.pPipelineState) {
+		spritePass.pDepthStencilState->release();
+		spritePass.pSamplerState->release();
+	}
+	if (spritePass.pIndexBuffer) {
+		spritePass.pIndexBuffer->release();
+	}
+	if (textPass.pPipelineState) {
+		textPass.pAtlasTexture->release();
+		textPass.pDepthStencilState->release();
+		textPass.pSamplerState->release();
+	}
+	_pDepthStencilState->release();
+	_samplerStates.clear();
+	_depthStencilStates.clear();
+	if (const char* manifest = std::getenv("LEARNMETAL_PIPELINE_MANIFEST")) {
+		_pipelineStates.saveManifest(manifest);
+	}
+	// compile 중인 pipeline이 library를 쓰므로 그 전에 비운다.
+	_pipelineStates.clear();
+	_pShaderLibrary->release();
 	_pCommandQueue->release();
 	_pDevice->release();
+	// 만들 때보다 값이 작은 semaphore를 놓으면 libdispatch가 abort 하므로 되돌려 놓는다.
+	for (size_t i = 0; i < kMaxFramesInFlight; ++i) {
+		dispatch_semaphore_signal(_frameSemaphore);
+	}
+	dispatch_release(_frameSemaphore);
 }
 
 
@@ -291,6 +842,114 @@ void fileToString(const char* path, std::string& content)
 	content = buffer.str();
 }
 
+// Per-instance InstanceData를 읽는 vertex buffer와 attribute 번호. glTF attribute slot(0...3) 뒤에 둔다.
+static const NS::UInteger kInstanceBufferIndex = 17;
+static const NS::UInteger kInstanceFirstAttribute = 4;
+
+// vertex descriptor에 InstanceData(model column 4개 + 색)를 instance마다 한 번 읽는 attribute를 더한다.
+static void addInstanceAttributes(PipelineKey& key)
+{
+	for (uint32_t i = 0; i < 5; ++i) {
+		key.setAttribute(kInstanceFirstAttribute + i, MTL::VertexFormatFloat4, i * sizeof(Float4), kInstanceBufferIndex);
+	}
+	key.setLayout(kInstanceBufferIndex, sizeof(InstanceData), MTL::VertexStepFunctionPerInstance, 1);
+}
+
+// particle, HUD, 글자처럼 vertex descriptor 없이 buffer를 직접 읽고 alpha blending 하는 pipeline
+static PipelineKey blendedPipelineKey(const char* vertexFunction, const char* fragmentFunction)
+{
+	PipelineKey key;
+	key.vertexFunction = vertexFunction;
+	key.fragmentFunction = fragmentFunction;
+	PipelineColorAttachment& color = key.colorAttachment(0);
+	color.pixelFormat = kColorPixelFormat;
+	color.blendingEnabled = true;
+	color.rgbBlendOperation = color.alphaBlendOperation = MTL::BlendOperationAdd;
+	color.sourceRGBBlendFactor = MTL::BlendFactorSourceAlpha;
+	color.sourceAlphaBlendFactor = MTL::BlendFactorOne;
+	color.destinationRGBBlendFactor = color.destinationAlphaBlendFactor = MTL::BlendFactorOneMinusSourceAlpha;
+	key.depthPixelFormat = kDepthPixelFormat;
+	return key;
+}
+
+MTL::RenderPipelineState* Renderer::newRenderPipelineState(const PipelineKey& key) {
+	using NS::StringEncoding::UTF8StringEncoding;
+	// pool thread에는 autorelease pool이 없으므로 NS::String과 error를 여기서 놓는다.
+	NS::AutoreleasePool* pAutoreleasePool = NS::AutoreleasePool::alloc()->init();
+	MTL::FunctionConstantValues* pConstantValues = nullptr;
+	if (!key.constants.empty()) {
+		pConstantValues = MTL::FunctionConstantValues::alloc()->init();
+		for (const PipelineFunctionConstant& constant : key.constants) {
+			// bool constant는 첫 byte만 읽는다. (little endian)
+			pConstantValues->setConstantValue(&constant.value, MTL::DataType(constant.dataType), constant.index);
+		}
+	}
+	NS::Error* error = nullptr;
+	auto newFunction = [&](const std::string& name) -> MTL::Function* {
+		NS::String* pName = NS::String::string(name.c_str(), UTF8StringEncoding);
+		return pConstantValues ? _pShaderLibrary->newFunction(pName, pConstantValues, &error) : _pShaderLibrary->newFunction(pName);
+	};
+	MTL::Function* vertexFunction = newFunction(key.vertexFunction);
+	MTL::Function* fragmentFunction = key.fragmentFunction.empty() ? nullptr : newFunction(key.fragmentFunction);
+	MTL::RenderPipelineState* pPipelineState = nullptr;
+	if (vertexFunction && (fragmentFunction || key.fragmentFunction.empty())) {
+		MTL::RenderPipelineDescriptor* pPDO = MTL::RenderPipelineDescriptor::alloc()->init();
+		pPDO->setVertexFunction(vertexFunction);
+		pPDO->setFragmentFunction(fragmentFunction);
+		if (!key.attributes.empty()) {
+			MTL::VertexDescriptor* pVertexDescriptor = MTL::VertexDescriptor::alloc()->init();
+			for (const PipelineVertexAttribute& attribute : key.attributes) {
+				MTL::VertexAttributeDescriptor* pAttribute = pVertexDescriptor->attributes()->object(attribute.index);
+				pAttribute->setFormat(MTL::VertexFormat(attribute.format));
+				pAttribute->setOffset(attribute.offset);
+				pAttribute->setBufferIndex(attribute.bufferIndex);
+			}
+			for (const PipelineVertexLayout& layout : key.layouts) {
+				MTL::VertexBufferLayoutDescriptor* pLayout = pVertexDescriptor->layouts()->object(layout.index);
+				pLayout->setStride(layout.stride);
+				pLayout->setStepFunction(MTL::VertexStepFunction(layout.stepFunction));
+				pLayout->setStepRate(layout.stepRate);
+			}
+			pPDO->setVertexDescriptor(pVertexDescriptor);
+			pVertexDescriptor->release();
+		}
+		for (size_t i = 0; i < key.colorAttachments.size(); ++i) {
+			const PipelineColorAttachment& color = key.colorAttachments[i];
+			MTL::RenderPipelineColorAttachmentDescriptor* pColor = pPDO->colorAttachments()->object(i);
+			pColor->setPixelFormat(MTL::PixelFormat(color.pixelFormat));
+			pColor->setBlendingEnabled(color.blendingEnabled);
+			pColor->setRgbBlendOperation(MTL::BlendOperation(color.rgbBlendOperation));
+			pColor->setAlphaBlendOperation(MTL::BlendOperation(color.alphaBlendOperation));
+			pColor->setSourceRGBBlendFactor(MTL::BlendFactor(color.sourceRGBBlendFactor));
+			pColor->setSourceAlphaBlendFactor(MTL::BlendFactor(color.sourceAlphaBlendFactor));
+			pColor->setDestinationRGBBlendFactor(MTL::BlendFactor(color.destinationRGBBlendFactor));
+			pColor->setDestinationAlphaBlendFactor(MTL::BlendFactor(color.destinationAlphaBlendFactor));
+			pColor->setWriteMask(MTL::ColorWriteMask(color.writeMask));
+		}
+		pPDO->setDepthAttachmentPixelFormat(MTL::PixelFormat(key.depthPixelFormat));
+		pPDO->setStencilAttachmentPixelFormat(MTL::PixelFormat(key.stencilPixelFormat));
+		pPDO->setRasterSampleCount(key.sampleCount);
+		pPDO->setAlphaToCoverageEnabled(key.alphaToCoverageEnabled);
+		pPDO->setInputPrimitiveTopology(MTL::PrimitiveTopologyClass(key.inputPrimitiveTopology));
+		pPipelineState = _pDevice->newRenderPipelineState(pPDO, &error);
+		pPDO->release();
+	}
+	if (!pPipelineState) {
+		std::cout << key.vertexFunction << " / " << key.fragmentFunction << ": "
+			<< (error ? error->localizedDescription()->utf8String() : "function not found") << std::endl;
+	}
+	for (MTL::Function* pFunction : { vertexFunction, fragmentFunction }) {
+		if (pFunction) {
+			pFunction->release();
+		}
+	}
+	if (pConstantValues) {
+		pConstantValues->release();
+	}
+	pAutoreleasePool->release();
+	return pPipelineState;
+}
+
 void Renderer::buildShaders() {
 	using NS::StringEncoding::UTF8StringEncoding;
 
@@ -335,31 +994,42 @@ void Renderer::buildShaders() {
 		std::cout << error->localizedDescription()->utf8String() << std::endl;
 		assert(false);
 	}
-	// Object that represents a shader fucntion in the library
-	MTL::Function* vertexFunction = pLibrary->newFunction(NS::String::string("vertexMain", UTF8StringEncoding));
-	MTL::Function* fragmentFunction = pLibrary->newFunction(NS::String::string("fragmentMain", UTF8StringEncoding));
-	// Object to specify the rendering configuration state
-	MTL::RenderPipelineDescriptor* pPDO = MTL::RenderPipelineDescriptor::alloc()->init();
-	// In a render pass we use this vertex function
-	pPDO->setVertexFunction(vertexFunction);
-	pPDO->setFragmentFunction(fragmentFunction);
-	pPDO->colorAttachments()->object(0)->setPixelFormat(MTL::PixelFormatBGRA8Unorm_sRGB);
+	// 모든 pipeline이 이 library에서 function을 만든다.
+	_pShaderLibrary = pLibrary;
+	// Pipeline key: vertexMain / fragmentMain과 rendering 설정
+	PipelineKey pipeline;
+	pipeline.vertexFunction = "vertexMain";
+	pipeline.fragmentFunction = "fragmentMain";
+	// position, color는 vertex마다, transform과 instance 색은 instance마다 읽는다.
+	for (uint32_t i = 0; i < 2; ++i) {
+		pipeline.setAttribute(i, MTL::VertexFormatFloat3, 0, i);
+		pipeline.setLayout(i, sizeof(simd::float3));
+	}
+	addInstanceAttributes(pipeline);
+	pipeline.colorAttachment(0).pixelFormat = kColorPixelFormat;
+	pipeline.depthPixelFormat = kDepthPixelFormat;
 
 	// Create a render pipline state
-	renderPass.renderPipelineState = _pDevice->newRenderPipelineState(pPDO, &error);
-	if (!renderPass.renderPipelineState) {
-		std::cout << error -> localizedDescription()->utf8String() << std::endl;
-		assert(false);
-	}
+	renderPass.renderPipelineState = _pipelineStates.get(pipeline);
+	assert(renderPass.renderPipelineState);
 
-	// Release objects no longer needed
-	vertexFunction->release();
-	fragmentFunction->release();
-	pPDO->release();
-	pLibrary->release();
+	// Depth test. 여러 mesh가 겹치는 scene을 그리기 위해 필요하다.
+	DepthStencilKey depthStencil;
+	depthStencil.depthCompareFunction = MTL::CompareFunctionLess;
+	depthStencil.depthWriteEnabled = true;
+	_pDepthStencilState = _depthStencilStates.acquire(depthStencil);
 }
 
 void Renderer::buildBuffers() {
+	// 아직 camera가 없으므로 clip space 그대로 한 번 그린다.
+	renderPass.instances = { { identity4x4(), { 1.0f, 1.0f, 1.0f, 1.0f } } };
+	std::string extension = _meshPath ? std::filesystem::path(_meshPath).extension().string() : "";
+	if (extension == ".gltf" || extension == ".glb") {
+		_drawScene = loadScene(_meshPath);
+	}
+	if (!_drawScene && _meshPath && loadMesh(_meshPath)) {
+		return;
+	}
 	// The number of total vertices
 	const int numberOfVertices = 6;
 
@@ -399,6 +1069,1064 @@ void Renderer::buildBuffers() {
 	mesh.pVertexPositionsBuffer = pVertexPositionBuffer;
 }
 
+void Renderer::buildParticles() {
+	const char* count = std::getenv("LEARNMETAL_PARTICLES");
+	if (!count || std::atol(count) <= 0) {
+		return;
+	}
+	// clip space 아래쪽에서 위로 뿜어 올렸다가 바닥에 떨어진다. 수명 동안 capacity가 다 차도록 생성한다.
+	ParticleSystem* pSystem = new ParticleSystem(size_t(std::atol(count)));
+	particlePass.system.reset(pSystem);
+	ParticleEmitter emitter;
+	emitter.position = { 0.0f, -0.6f, 0.5f };
+	emitter.radius = 0.02f;
+	emitter.velocity = { 0.0f, 1.6f, 0.0f };
+	emitter.velocityJitter = 0.5f;
+	emitter.lifetime = 2.5f;
+	emitter.lifetimeJitter = 0.5f;
+	emitter.rate = float(pSystem->capacity()) / (emitter.lifetime + emitter.lifetimeJitter);
+	emitter.color = { 1.0f, 0.6f, 0.2f, 0.8f };
+	emitter.size = 0.006f;
+	pSystem->emitters.push_back(emitter);
+	pSystem->params.gravity = { 0.0f, -1.5f, 0.0f };
+	pSystem->params.interactionRadius = 0.02f;
+	pSystem->params.floorHeight = -0.9f;
+
+	particlePass.pPipelineState = _pipelineStates.get(blendedPipelineKey("particleVertexMain", "particleFragmentMain"));
+	assert(particlePass.pPipelineState);
+	DepthStencilKey depthStencil;
+	depthStencil.depthCompareFunction = MTL::CompareFunctionLess;
+	particlePass.pDepthStencilState = _depthStencilStates.acquire(depthStencil);
+
+	std::cout << "particles: up to " << pSystem->capacity() << ", " << ThreadPool::shared().size() << " threads" << std::endl;
+}
+
+// HUD atlas의 image 번호. 0은 panel과 graph 막대를 칠하는 흰 사각형이고 뒤로 icon 모양이 이어진다.
+static const uint32_t kHudImageWhite = 0;
+static const uint32_t kHudIconImages = 12;
+// frame 시간 graph의 막대 수와 막대 하나의 너비(pixel). 16.7 ms가 32 pixel이다.
+static const size_t kHudGraphFrames = 120;
+static const float kHudBarWidth = 2.0f;
+static const float kHudPixelsPerMillisecond = 32.0f / 16.7f;
+
+// 가운데를 원점으로 한 pixel 좌표에서 kind 모양(원, 고리, 마름모)이 덮는 비율로 alpha를 채운 흰 image
+static SpriteImage makeHudIcon(uint32_t size, uint32_t kind)
+{
+	SpriteImage image;
+	image.width = size;
+	image.height = size;
+	image.pixels.resize(size_t(size) * size * 4);
+	const float radius = 0.5f * float(size) - 1.0f;
+	for (uint32_t y = 0; y < size; ++y) {
+		for (uint32_t x = 0; x < size; ++x) {
+			const float px = float(x) + 0.5f - 0.5f * float(size), py = float(y) + 0.5f - 0.5f * float(size);
+			// 모양 경계까지의 거리(안쪽이 음수)로 1 pixel 폭의 가장자리를 부드럽게 한다.
+			float distance = std::sqrt(px * px + py * py) - radius;
+			if (kind == 1) {
+				distance = std::fabs(distance + 0.2f * radius) - 0.2f * radius;
+			} else if (kind == 2) {
+				distance = (std::fabs(px) + std::fabs(py) - radius) * 0.7071f;
+			}
+			const float coverage = std::min(std::max(0.5f - distance, 0.0f), 1.0f);
+			uint8_t* pixel = image.pixels.data() + (size_t(y) * size + x) * 4;
+			pixel[0] = pixel[1] = pixel[2] = 255;
+			pixel[3] = uint8_t(coverage * 255.0f + 0.5f);
+		}
+	}
+	return image;
+}
+
+void Renderer::buildSprites() {
+	const char* hud = std::getenv("LEARNMETAL_HUD");
+	if (!hud) {
+		return;
+	}
+	std::vector<SpriteImage> images;
+	SpriteImage white;
+	white.width = 4;
+	white.height = 4;
+	white.pixels.assign(4 * 4 * 4, 255);
+	images.push_back(white);
+	for (uint32_t icon = 0; icon < kHudIconImages; ++icon) {
+		images.push_back(makeHudIcon(12 + 4 * icon, icon % 3));
+	}
+	if (!buildSpriteAtlas(images, 256, 256, 1, 4, spritePass.atlas)) {
+		return;
+	}
+	for (const std::vector<uint8_t>& page : spritePass.atlas.pages) {
+		MTL::Texture* pTexture = _pDevice->newTexture(MTL::TextureDescriptor::texture2DDescriptor(MTL::PixelFormatRGBA8Unorm,
+					spritePass.atlas.pageWidth, spritePass.atlas.pageHeight, false));
+		pTexture->replaceRegion(MTL::Region::Make2D(0, 0, spritePass.atlas.pageWidth, spritePass.atlas.pageHeight), 0, page.data(),
+				spritePass.atlas.pageWidth * 4);
+		spritePass.pPageTextures.push_back(pTexture);
+	}
+	spritePass.batch.reset(new SpriteBatch(spritePass.atlas));
+	spritePass.iconCount = uint32_t(std::max(0l, std::atol(hud)));
+	spritePass.frameTimes.assign(kHudGraphFrames, 0.0f);
+
+	spritePass.pPipelineState = _pipelineStates.get(blendedPipelineKey("spriteVertexMain", "spriteFragmentMain"));
+	assert(spritePass.pPipelineState);
+	// HUD는 항상 맨 위에 있다.
+	spritePass.pDepthStencilState = _depthStencilStates.acquire(DepthStencilKey());
+	// padding에 가장자리 texel을 채워 두었으므로 linear로 읽어도 옆 image가 섞이지 않는다.
+	SamplerKey sampler;
+	sampler.minFilter = sampler.magFilter = MTL::SamplerMinMagFilterLinear;
+	spritePass.pSamplerState = _samplerStates.acquire(sampler);
+
+	spritePass.start = spritePass.lastFrame = std::chrono::steady_clock::now();
+	std::cout << "hud: " << images.size() << " images in " << spritePass.atlas.pages.size() << " atlas pages ("
+		<< spritePass.atlas.occupancy * 100.0 << "% used), " << spritePass.iconCount << " icons" << std::endl;
+}
+
+void Renderer::buildText() {
+	const char* path = std::getenv("LEARNMETAL_FONT");
+	if (!path || !loadFontAtlas(path, textPass.atlas)) {
+		return;
+	}
+	FontAtlas& atlas = textPass.atlas;
+	// distance는 선형 값이므로 sRGB가 아닌 format에 둔다.
+	textPass.pAtlasTexture = _pDevice->newTexture(MTL::TextureDescriptor::texture2DDescriptor(MTL::PixelFormatRGBA8Unorm, atlas.width,
+				atlas.height, false));
+	textPass.pAtlasTexture->replaceRegion(MTL::Region::Make2D(0, 0, atlas.width, atlas.height), 0, atlas.pixels.data(), atlas.width * 4);
+	textPass.batch.reset(new TextBatch(atlas));
+
+	textPass.pPipelineState = _pipelineStates.get(blendedPipelineKey("textVertexMain", "textFragmentMain"));
+	assert(textPass.pPipelineState);
+	// HUD와 같은 state이므로 cache에서 같은 객체를 받는다.
+	textPass.pDepthStencilState = _depthStencilStates.acquire(DepthStencilKey());
+	SamplerKey sampler;
+	sampler.minFilter = sampler.magFilter = MTL::SamplerMinMagFilterLinear;
+	textPass.pSamplerState = _samplerStates.acquire(sampler);
+
+	textPass.lastFrame = std::chrono::steady_clock::now();
+	std::cout << path << ": " << atlas.glyphs.size() << " glyphs, " << atlas.width << "x" << atlas.height << " MSDF atlas" << std::endl;
+}
+
+bool Renderer::loadMesh(const char* path) {
+	static_assert(sizeof(Float3) == sizeof(simd::float3), "MeshData is copied into float3 buffers as is");
+
+	MeshData data;
+	auto start = std::chrono::steady_clock::now();
+	if (!importMesh(path, data)) {
+		return false;
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << path << ": " << data.numberOfVertices() << " vertices, "
+		<< data.numberOfTriangles() << " triangles (" << elapsed.count() << " ms)" << std::endl;
+	// 아직 카메라 변환이 없으므로 clip space 안으로 옮기고, 색이 없으면 normal로 색을 만든다.
+	data.fitToClipVolume();
+	if (data.colors.size() != data.positions.size()) {
+		data.computeColorsFromNormals();
+	}
+
+	size_t positionsDataSize = data.positions.size() * sizeof(simd::float3);
+	size_t colorDataSize = data.colors.size() * sizeof(simd::float3);
+	// 멀리 있으면 삼각형 수가 병목이므로 LOD chain을 만들어서 index buffer 뒤쪽에 이어 붙인다.
+	MeshLodChain lodChain;
+	start = std::chrono::steady_clock::now();
+	buildLodChain(data, LodChainOptions(), lodChain);
+	elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << lodChain.lods.size() << " LODs, coarsest " << lodChain.lods.back().indexCount / 3
+		<< " triangles (" << elapsed.count() << " ms)" << std::endl;
+
+	size_t indexDataSize = lodChain.indices.size() * sizeof(uint32_t);
+	MTL::Buffer* pVertexPositionBuffer = _pDevice->newBuffer(positionsDataSize, MTL::ResourceStorageModeManaged);
+	MTL::Buffer* pVertexColorsBuffer = _pDevice->newBuffer(colorDataSize, MTL::ResourceStorageModeManaged);
+	MTL::Buffer* pIndexBuffer = _pDevice->newBuffer(indexDataSize, MTL::ResourceStorageModeManaged);
+	memcpy(pVertexPositionBuffer->contents(), data.positions.data(), positionsDataSize);
+	memcpy(pVertexColorsBuffer->contents(), data.colors.data(), colorDataSize);
+	memcpy(pIndexBuffer->contents(), lodChain.indices.data(), indexDataSize);
+	pVertexPositionBuffer->didModifyRange(NS::Range::Make(0, pVertexPositionBuffer->length()));
+	pVertexColorsBuffer->didModifyRange(NS::Range::Make(0, pVertexColorsBuffer->length()));
+	pIndexBuffer->didModifyRange(NS::Range::Make(0, pIndexBuffer->length()));
+
+	Mesh& mesh = renderPass.mesh;
+	mesh.numberOfVertices = int(data.numberOfVertices());
+	mesh.pVertexColorsBuffer = pVertexColorsBuffer;
+	mesh.pVertexPositionsBuffer = pVertexPositionBuffer;
+	mesh.numberOfIndices = int(data.indices.size());
+	mesh.pIndexBuffer = pIndexBuffer;
+	mesh.lods = lodChain.lods;
+	Float3 boundsMin, boundsMax;
+	data.computeBounds(boundsMin, boundsMax);
+	mesh.boundsCenter = (boundsMin + boundsMax) * 0.5f;
+	mesh.boundsRadius = length(boundsMax - boundsMin) * 0.5f;
+
+	// Offline으로 만들어 둔 <mesh>.meshlets가 mesh보다 새것이면 그대로 쓰고, 아니면 만들어서 저장한다.
+	std::string meshletPath = std::string(path) + ".meshlets";
+	std::error_code ec;
+	bool cacheIsFresh = std::filesystem::last_write_time(meshletPath, ec) >= std::filesystem::last_write_time(path, ec) && !ec;
+	start = std::chrono::steady_clock::now();
+	if (!cacheIsFresh || !loadMeshlets(meshletPath.c_str(), mesh.meshlets, data.numberOfVertices(), data.numberOfTriangles())) {
+		buildMeshlets(data, mesh.meshlets);
+		saveMeshlets(meshletPath.c_str(), mesh.meshlets, data.numberOfVertices());
+	}
+	elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << mesh.meshlets.meshlets.size() << " meshlets (" << elapsed.count() << " ms)" << std::endl;
+	return true;
+}
+
+MTL::Buffer* Renderer::cullMeshletsForView(const MeshletCullParams& params) {
+	Mesh& mesh = renderPass.mesh;
+	MeshletCullStats stats = cullMeshlets(mesh.meshlets, params, mesh.visibleIndices);
+	size_t visibleDataSize = stats.visibleTriangles * 3 * sizeof(uint32_t);
+	MTL::Buffer* pBuffer = nextInstanceBuffer(renderPass.visibleIndexStream, std::max<size_t>(1, visibleDataSize));
+	memcpy(pBuffer->contents(), mesh.visibleIndices.data(), visibleDataSize);
+	// frame마다 찍지 않고 보이는 삼각형 수가 바뀔 때만 알린다.
+	if (stats.visibleTriangles != mesh.visibleTriangles) {
+		std::cout << "meshlet culling: " << stats.visibleTriangles << " / " << stats.totalTriangles << " triangles visible ("
+			<< stats.frustumCulledMeshlets << " frustum, " << stats.backfaceCulledMeshlets << " backface culled meshlets)" << std::endl;
+	}
+	mesh.visibleTriangles = stats.visibleTriangles;
+	return pBuffer;
+}
+
+static MTL::VertexFormat vertexFormatFor(const GltfAccessor& accessor)
+{
+	static const MTL::VertexFormat kFloat[] = { MTL::VertexFormatFloat, MTL::VertexFormatFloat2, MTL::VertexFormatFloat3, MTL::VertexFormatFloat4 };
+	static const MTL::VertexFormat kUChar[] = { MTL::VertexFormatUChar, MTL::VertexFormatUChar2, MTL::VertexFormatUChar3, MTL::VertexFormatUChar4 };
+	static const MTL::VertexFormat kUCharNormalized[] = { MTL::VertexFormatUCharNormalized, MTL::VertexFormatUChar2Normalized, MTL::VertexFormatUChar3Normalized, MTL::VertexFormatUChar4Normalized };
+	static const MTL::VertexFormat kChar[] = { MTL::VertexFormatChar, MTL::VertexFormatChar2, MTL::VertexFormatChar3, MTL::VertexFormatChar4 };
+	static const MTL::VertexFormat kCharNormalized[] = { MTL::VertexFormatCharNormalized, MTL::VertexFormatChar2Normalized, MTL::VertexFormatChar3Normalized, MTL::VertexFormatChar4Normalized };
+	static const MTL::VertexFormat kUShort[] = { MTL::VertexFormatUShort, MTL::VertexFormatUShort2, MTL::VertexFormatUShort3, MTL::VertexFormatUShort4 };
+	static const MTL::VertexFormat kUShortNormalized[] = { MTL::VertexFormatUShortNormalized, MTL::VertexFormatUShort2Normalized, MTL::VertexFormatUShort3Normalized, MTL::VertexFormatUShort4Normalized };
+	static const MTL::VertexFormat kShort[] = { MTL::VertexFormatShort, MTL::VertexFormatShort2, MTL::VertexFormatShort3, MTL::VertexFormatShort4 };
+	static const MTL::VertexFormat kShortNormalized[] = { MTL::VertexFormatShortNormalized, MTL::VertexFormatShort2Normalized, MTL::VertexFormatShort3Normalized, MTL::VertexFormatShort4Normalized };
+	static const MTL::VertexFormat kUInt[] = { MTL::VertexFormatUInt, MTL::VertexFormatUInt2, MTL::VertexFormatUInt3, MTL::VertexFormatUInt4 };
+
+	if (accessor.numberOfComponents < 1 || accessor.numberOfComponents > 4) {
+		return MTL::VertexFormatInvalid;
+	}
+	size_t i = accessor.numberOfComponents - 1;
+	switch (accessor.componentType) {
+		case GltfComponentTypeFloat: return kFloat[i];
+		case GltfComponentTypeUnsignedByte: return accessor.normalized ? kUCharNormalized[i] : kUChar[i];
+		case GltfComponentTypeByte: return accessor.normalized ? kCharNormalized[i] : kChar[i];
+		case GltfComponentTypeUnsignedShort: return accessor.normalized ? kUShortNormalized[i] : kUShort[i];
+		case GltfComponentTypeShort: return accessor.normalized ? kShortNormalized[i] : kShort[i];
+		case GltfComponentTypeUnsignedInt: return kUInt[i];
+		default: return MTL::VertexFormatInvalid;
+	}
+}
+
+static MTL::PrimitiveType primitiveTypeFor(uint32_t mode)
+{
+	switch (mode) {
+		case 0: return MTL::PrimitiveTypePoint;
+		case 1: return MTL::PrimitiveTypeLine;
+		case 3: return MTL::PrimitiveTypeLineStrip;
+		case 5: return MTL::PrimitiveTypeTriangleStrip;
+		default: return MTL::PrimitiveTypeTriangle;
+	}
+}
+
+// Vertex buffer indices used by sceneVertexMain besides the glTF layouts (0...).
+static const NS::UInteger kSceneDefaultAttributesBufferIndex = 15;
+static const NS::UInteger kSceneTransformBufferIndex = 16;
+// sceneFragmentMain / sceneVirtualFragmentMain의 SceneFog
+static const NS::UInteger kSceneFogBufferIndex = 2;
+
+bool Renderer::loadScene(const char* path) {
+	auto start = std::chrono::steady_clock::now();
+	if (!loadGltf(path, scenePass.scene)) {
+		return false;
+	}
+	GltfScene& scene = scenePass.scene;
+
+	// 복사 없이 glTF buffer 메모리를 그대로 GPU buffer로 쓴다. 메모리는 scenePass.scene이 소유한다.
+	for (GltfBufferStorage& storage : scene.buffers) {
+		scenePass.buffers.push_back(_pDevice->newBuffer(storage.data(), storage.allocationSize(),
+				MTL::ResourceStorageModeShared, nullptr));
+	}
+	const float defaultAttributes[4] = { 0.0f, 0.0f, 1.0f, 0.0f };
+	scenePass.pDefaultAttributesBuffer = _pDevice->newBuffer(defaultAttributes, sizeof(defaultAttributes), MTL::ResourceStorageModeShared);
+
+	// virtual texture를 쓰면 fragment shader가 달라지므로 pipeline보다 먼저 만든다.
+	buildSceneTexture();
+	// skin은 읽지 않으므로 skinning variant는 나오지 않는다.
+	ShaderVariantOptions& options = scenePass.variantOptions;
+	options.texture = scenePass.virtualTexture.enabled || scenePass.pBaseColorTexture;
+	if (const char* fog = std::getenv("LEARNMETAL_FOG")) {
+		options.fog = true;
+		scenePass.fog = { { 1.0f, 0.0f, 0.0f, 1.0f }, *fog ? float(std::atof(fog)) : 0.5f, 1.0f, {} };
+	}
+
+	// Pipeline은 vertex descriptor 종류마다 하나씩만 만든다. key를 모두 먼저 걸어 pool에서 함께 compile 한다.
+	std::vector<PipelineKey> pipelineKeys;
+	for (const GltfMesh& mesh : scene.meshes) {
+		for (const GltfPrimitive& primitive : mesh.primitives) {
+			pipelineKeys.push_back(scenePipelineKey(primitive));
+		}
+	}
+	_pipelineStates.prewarm(pipelineKeys);
+	size_t numberOfPrimitives = 0;
+	std::unordered_map<MTL::RenderPipelineState*, uint32_t> pipelineIds;
+	for (const GltfMesh& mesh : scene.meshes) {
+		std::vector<uint32_t>& ids = scenePass.primitivePipelines.emplace_back();
+		for (size_t i = 0; i < mesh.primitives.size(); ++i) {
+			MTL::RenderPipelineState* pPipelineState = _pipelineStates.get(pipelineKeys[numberOfPrimitives]);
+			if (!pPipelineState) {
+				return false;
+			}
+			auto [found, inserted] = pipelineIds.try_emplace(pPipelineState, uint32_t(scenePass.pipelines.size()));
+			if (inserted) {
+				scenePass.pipelines.push_back(pPipelineState);
+			}
+			ids.push_back(found->second);
+			++numberOfPrimitives;
+		}
+	}
+
+	// glTF는 오른손 좌표계(-Z 방향을 봄)이므로 z를 뒤집어 Metal clip space([0, 1] depth)에 넣는다.
+	Float3 center = (scene.boundsMin + scene.boundsMax) * 0.5f;
+	Float3 extent = scene.boundsMax - scene.boundsMin;
+	float largest = std::max(extent.x, std::max(extent.y, extent.z));
+	float scale = largest > 0.0f && std::isfinite(largest) ? 1.0f / largest : 1.0f;
+	if (!std::isfinite(center.x)) {
+		center = { 0.0f, 0.0f, 0.0f };
+	}
+	scenePass.fitTransform = translation4x4({ 0.0f, 0.0f, 0.5f }) * scale4x4({ scale, scale, -scale }) * translation4x4(center * -1.0f);
+	prepareCulling();
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << path << ": " << scene.draws.size() << " draws, " << numberOfPrimitives << " primitives, "
+		<< scenePass.pipelines.size() << " pipelines, " << enumerateShaderVariants(scene, options).size() << " shader variants, "
+		<< scene.repackedBytes << " bytes repacked, "
+		<< scenePass.occluders.size() << " occluders ("
+		<< elapsed.count() << " ms)" << std::endl;
+	return true;
+}
+
+/*
+ * GltfPrimitive의 attribute/layout 정보를 그대로 vertex descriptor로 옮긴다.
+ * 없는 NORMAL은 stepFunction이 Constant인 기본값 buffer에서 읽는다. COLOR_0, TEXCOORD_0은 variant가 정한다.
+ * */
+PipelineKey Renderer::scenePipelineKey(const GltfPrimitive& primitive) const {
+	PipelineKey key;
+	key.vertexFunction = "sceneVertexMain";
+	key.fragmentFunction = scenePass.virtualTexture.enabled ? "sceneVirtualFragmentMain" : "sceneFragmentMain";
+	setShaderVariant(key, shaderVariantOf(primitive, scenePass.variantOptions));
+	bool hasSlot[GltfAttributeSlotCount] = {};
+	for (const GltfVertexAttribute& attribute : primitive.attributes) {
+		key.setAttribute(attribute.slot, vertexFormatFor(scenePass.scene.accessors[attribute.accessor]), attribute.offset, attribute.layout);
+		hasSlot[attribute.slot] = true;
+	}
+	for (size_t i = 0; i < primitive.layouts.size(); ++i) {
+		key.setLayout(uint32_t(i), primitive.layouts[i].stride, MTL::VertexStepFunctionPerVertex);
+	}
+	if (!hasSlot[GltfAttributeSlotNormal]) {
+		key.setAttribute(GltfAttributeSlotNormal, MTL::VertexFormatFloat3, 0, kSceneDefaultAttributesBufferIndex);
+	}
+	key.setLayout(kSceneDefaultAttributesBufferIndex, 16, MTL::VertexStepFunctionConstant, 0);
+	addInstanceAttributes(key);
+	key.colorAttachment(0).pixelFormat = kColorPixelFormat;
+	key.depthPixelFormat = kDepthPixelFormat;
+	return key;
+}
+
+// 한 frame에 올리는 mip 크기의 상한. 이보다 큰 level은 그 frame에 혼자 올라간다.
+static const uint64_t kTextureUploadBytesPerFrame = 16 << 20;
+
+void Renderer::buildSceneTexture() {
+	SamplerKey sampler;
+	sampler.minFilter = sampler.magFilter = MTL::SamplerMinMagFilterLinear;
+	sampler.mipFilter = MTL::SamplerMipFilterLinear;
+	sampler.sAddressMode = sampler.tAddressMode = MTL::SamplerAddressModeRepeat;
+	scenePass.pSamplerState = _samplerStates.acquire(sampler);
+
+	const uint32_t white = 0xFFFFFFFF;
+	scenePass.pWhiteTexture = _pDevice->newTexture(MTL::TextureDescriptor::texture2DDescriptor(MTL::PixelFormatRGBA8Unorm, 1, 1, false));
+	scenePass.pWhiteTexture->replaceRegion(MTL::Region::Make2D(0, 0, 1, 1), 0, &white, sizeof(white));
+
+	if (const char* virtualPath = std::getenv("LEARNMETAL_VIRTUAL_TEXTURE")) {
+		scenePass.virtualTexture.enabled = buildVirtualTexture(virtualPath);
+		if (scenePass.virtualTexture.enabled) {
+			return;
+		}
+	}
+	const char* path = std::getenv("LEARNMETAL_TEXTURE");
+	TextureStreamer& streamer = scenePass.textureStreamer;
+	if (!path || !streamer.open(path)) {
+		return;
+	}
+	const TextureLayout& layout = streamer.layout();
+	if (layout.type != TextureType2D) {
+		std::cerr << path << ": only 2D textures can be applied to the scene" << std::endl;
+		return;
+	}
+	// TextureFormat의 값은 MTL::PixelFormat과 같다. 가장 정밀한 level까지 자리를 미리 잡아 두고 내용은 streaming으로 채운다.
+	MTL::TextureDescriptor* pDescriptor = MTL::TextureDescriptor::alloc()->init();
+	pDescriptor->setTextureType(MTL::TextureType2D);
+	pDescriptor->setPixelFormat(MTL::PixelFormat(layout.format));
+	pDescriptor->setWidth(layout.width);
+	pDescriptor->setHeight(layout.height);
+	scenePass.generateMipmaps = layout.levels == 1 && canBlitGenerateMipmaps(layout.format);
+	const uint32_t levels = scenePass.generateMipmaps ? mipLevelCount(layout.width, layout.height) : layout.levels;
+	pDescriptor->setMipmapLevelCount(levels);
+	pDescriptor->setStorageMode(MTL::StorageModePrivate);
+	pDescriptor->setUsage(MTL::TextureUsageShaderRead);
+	scenePass.pBaseColorTexture = _pDevice->newTexture(pDescriptor);
+	pDescriptor->release();
+	if (!scenePass.pBaseColorTexture) {
+		std::cerr << path << ": pixel format " << layout.format << " is not supported on this device" << std::endl;
+		return;
+	}
+	scenePass.residentLod = float(levels);
+	scenePass.textureStart = std::chrono::steady_clock::now();
+	streamer.stream();
+	std::cout << path << ": " << layout.width << "x" << layout.height << ", " << layout.levels << " levels, "
+		<< layout.totalSize() << " bytes" << (levels > layout.levels ? " (mipmaps generated on the GPU)" : "") << std::endl;
+}
+
+void Renderer::uploadTextureLevels(MTL::CommandBuffer* pCmd) {
+	MTL::Texture* pTexture = scenePass.pBaseColorTexture;
+	if (!pTexture || scenePass.residentLod == 0.0f) {
+		return;
+	}
+	TextureStreamer& streamer = scenePass.textureStreamer;
+	const TextureLayout& layout = streamer.layout();
+	MTL::BlitCommandEncoder* pBlit = nullptr;
+	uint64_t uploaded = 0;
+	TextureLevelData level;
+	while (uploaded < kTextureUploadBytesPerFrame && streamer.poll(level)) {
+		if (!pBlit) {
+			pBlit = pCmd->blitCommandEncoder();
+		}
+		// command buffer가 끝날 때까지 staging buffer를 붙잡고 있으므로 encode 뒤에 바로 release 해도 된다.
+		MTL::Buffer* pStaging = _pDevice->newBuffer(level.bytes.data(), level.bytes.size(), MTL::ResourceStorageModeShared);
+		const TextureSubresource& subresource = layout.subresource(level.level, 0);
+		pBlit->copyFromBuffer(pStaging, 0, subresource.bytesPerRow, 0, MTL::Size::Make(subresource.width, subresource.height, 1),
+				pTexture, 0, level.level, MTL::Origin::Make(0, 0, 0));
+		pStaging->release();
+		uploaded += level.bytes.size();
+		// 작은 level부터 오므로 방금 올린 level까지는 모두 있다.
+		scenePass.residentLod = float(level.level);
+	}
+	if (!pBlit) {
+		return;
+	}
+	// 같은 blit encoder 안이므로 level 0 복사가 끝난 뒤에 나머지 level을 만든다.
+	if (scenePass.residentLod == 0.0f && scenePass.generateMipmaps) {
+		pBlit->generateMipmaps(pTexture);
+	}
+	pBlit->endEncoding();
+	if (scenePass.residentLod == 0.0f) {
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - scenePass.textureStart;
+		std::cout << "texture: all " << pTexture->mipmapLevelCount() << " levels resident (" << elapsed.count() << " ms)" << std::endl;
+	}
+}
+
+// virtual texture가 한 frame에 새로 읽기 시작하고 올리는 tile 수의 상한. 16 KB tile이면 4 MB이다.
+static const uint32_t kVirtualTileLoadsPerFrame = 256;
+// virtual texture의 hit rate와 메모리를 출력하는 간격
+static const double kVirtualTextureReportSeconds = 5.0;
+
+bool Renderer::buildVirtualTexture(const char* path) {
+	VirtualTexture& virtualTexture = scenePass.virtualTexture;
+	if (!_pDevice->supportsFamily(MTL::GPUFamilyApple6)) {
+		std::cerr << path << ": sparse textures need an Apple6 GPU" << std::endl;
+		return false;
+	}
+	if (!virtualTexture.file.open(path)) {
+		return false;
+	}
+	const SparseTileLayout& layout = virtualTexture.file.layout();
+	// tile 하나가 GPU page 하나여야 map 한 번, blit 한 번으로 올릴 수 있다.
+	const MTL::Size tileSize = _pDevice->sparseTileSize(MTL::TextureType2D, MTL::PixelFormat(layout.format), 1, MTL::SparsePageSize16);
+	const NS::UInteger pageBytes = _pDevice->sparseTileSizeInBytes(MTL::SparsePageSize16);
+	if (tileSize.width != layout.tileWidth || tileSize.height != layout.tileHeight || pageBytes != layout.tileBytes) {
+		std::cerr << path << ": tiles are " << layout.tileWidth << "x" << layout.tileHeight << " but GPU pages are " << tileSize.width << "x"
+			<< tileSize.height << " (" << pageBytes << " bytes)" << std::endl;
+		return false;
+	}
+	if (layout.tailLevel == 0) {
+		std::cerr << path << ": smaller than a tile, use LEARNMETAL_TEXTURE instead" << std::endl;
+		return false;
+	}
+	const char* budgetText = std::getenv("LEARNMETAL_VIRTUAL_TEXTURE_BUDGET_MB");
+	const uint64_t budget = uint64_t(budgetText ? std::max(1l, std::atol(budgetText)) : 64) << 20;
+	virtualTexture.pResidency = std::make_unique<SparseResidency>(layout, budget);
+	virtualTexture.pStreamer = std::make_unique<SparseTileStreamer>(virtualTexture.file);
+
+	// 예산만큼의 tile과 mip tail. GPU는 tail을 level마다 page로 나눌 수 있으므로 level 수만큼 여유를 둔다.
+	MTL::HeapDescriptor* pHeapDescriptor = MTL::HeapDescriptor::alloc()->init();
+	pHeapDescriptor->setType(MTL::HeapTypeSparse);
+	pHeapDescriptor->setStorageMode(MTL::StorageModePrivate);
+	pHeapDescriptor->setSparsePageSize(MTL::SparsePageSize16);
+	const uint64_t tailPages = (layout.tailBytes + pageBytes - 1) / pageBytes + (layout.levels - layout.tailLevel);
+	pHeapDescriptor->setSize(NS::UInteger((virtualTexture.pResidency->capacityTiles() + tailPages) * pageBytes));
+	virtualTexture.pHeap = _pDevice->newHeap(pHeapDescriptor);
+	pHeapDescriptor->release();
+
+	MTL::TextureDescriptor* pDescriptor = MTL::TextureDescriptor::alloc()->init();
+	pDescriptor->setTextureType(MTL::TextureType2D);
+	pDescriptor->setPixelFormat(MTL::PixelFormat(layout.format));
+	pDescriptor->setWidth(layout.width);
+	pDescriptor->setHeight(layout.height);
+	pDescriptor->setMipmapLevelCount(layout.levels);
+	pDescriptor->setStorageMode(MTL::StorageModePrivate);
+	pDescriptor->setUsage(MTL::TextureUsageShaderRead);
+	virtualTexture.pTexture = virtualTexture.pHeap ? virtualTexture.pHeap->newTexture(pDescriptor) : nullptr;
+	pDescriptor->release();
+	if (!virtualTexture.pTexture) {
+		std::cerr << path << ": failed to create a " << layout.width << "x" << layout.height << " sparse texture" << std::endl;
+		return false;
+	}
+	if (virtualTexture.pTexture->firstMipmapInTail() != layout.tailLevel) {
+		std::cerr << path << ": the GPU mip tail starts at level " << virtualTexture.pTexture->firstMipmapInTail() << ", not "
+			<< layout.tailLevel << std::endl;
+		return false;
+	}
+	virtualTexture.pResidencyMap = _pDevice->newTexture(MTL::TextureDescriptor::texture2DDescriptor(MTL::PixelFormatR8Uint, layout.tilesWide[0],
+				layout.tilesHigh[0], false));
+	for (size_t i = 0; i < kMaxFramesInFlight; ++i) {
+		const size_t bytes = SparseFeedback::wordCount(layout) * sizeof(uint32_t);
+		virtualTexture.pFeedbackBuffers[i] = _pDevice->newBuffer(bytes, MTL::ResourceStorageModeShared);
+		std::memset(virtualTexture.pFeedbackBuffers[i]->contents(), 0, bytes);
+		virtualTexture.feedback.emplace_back(layout, static_cast<uint32_t*>(virtualTexture.pFeedbackBuffers[i]->contents()));
+	}
+	VirtualTextureInfo& info = virtualTexture.info;
+	info = { layout.width, layout.height, layout.tileWidth, layout.tileHeight, layout.tailLevel, 0, {}, {} };
+	std::copy(layout.firstTile.begin(), layout.firstTile.end(), info.firstTile);
+	std::copy(layout.tilesWide.begin(), layout.tilesWide.end(), info.tilesWide);
+
+	// mip tail은 처음에 한 번 map 하고 계속 둔다. 같은 queue이므로 첫 frame보다 먼저 끝난다.
+	std::vector<uint8_t> tail;
+	if (!virtualTexture.file.readTail(tail)) {
+		return false;
+	}
+	const TextureLayout tailLayout = makeTextureLayout(layout.format, layout.levelWidth(layout.tailLevel), layout.levelHeight(layout.tailLevel),
+			layout.levels - layout.tailLevel);
+	MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+	MTL::ResourceStateCommandEncoder* pMapping = pCmd->resourceStateCommandEncoder();
+	pMapping->updateTextureMapping(virtualTexture.pTexture, MTL::SparseTextureMappingModeMap, MTL::Region::Make2D(0, 0, 1, 1), layout.tailLevel, 0);
+	pMapping->endEncoding();
+	MTL::Buffer* pStaging = _pDevice->newBuffer(tail.data(), tail.size(), MTL::ResourceStorageModeShared);
+	MTL::BlitCommandEncoder* pBlit = pCmd->blitCommandEncoder();
+	for (uint32_t level = 0; level < tailLayout.levels; ++level) {
+		const TextureSubresource& subresource = tailLayout.subresource(level, 0);
+		pBlit->copyFromBuffer(pStaging, subresource.offset, subresource.bytesPerRow, 0, MTL::Size::Make(subresource.width, subresource.height, 1),
+				virtualTexture.pTexture, 0, layout.tailLevel + level, MTL::Origin::Make(0, 0, 0));
+	}
+	pBlit->endEncoding();
+	pCmd->commit();
+	pStaging->release();
+	virtualTexture.lastReport = std::chrono::steady_clock::now();
+	std::cout << path << ": " << layout.width << "x" << layout.height << " virtual texture, " << layout.tileCount << " tiles of "
+		<< layout.tileWidth << "x" << layout.tileHeight << ", mip tail from level " << layout.tailLevel << ", budget " << (budget >> 20) << " MB ("
+		<< virtualTexture.pResidency->capacityTiles() << " tiles)" << std::endl;
+	return true;
+}
+
+void Renderer::updateVirtualTexture(MTL::CommandBuffer* pCmd) {
+	VirtualTexture& virtualTexture = scenePass.virtualTexture;
+	if (!virtualTexture.enabled) {
+		return;
+	}
+	const SparseTileLayout& layout = virtualTexture.file.layout();
+	SparseResidency& residency = *virtualTexture.pResidency;
+	// 이번 frame에 쓸 feedback buffer는 kMaxFramesInFlight frame 전의 command buffer가 썼다.
+	// draw가 _frameSemaphore를 기다렸으므로 그 command buffer는 끝났다. 모으면서 지운다.
+	virtualTexture.frame = (virtualTexture.frame + 1) % kMaxFramesInFlight;
+	++virtualTexture.info.frame;
+	virtualTexture.requested.clear();
+	virtualTexture.feedback[virtualTexture.frame].collect(virtualTexture.requested);
+	virtualTexture.loads.clear();
+	virtualTexture.evictions.clear();
+	residency.update(virtualTexture.requested, kVirtualTileLoadsPerFrame, virtualTexture.loads, virtualTexture.evictions);
+	virtualTexture.pStreamer->request(virtualTexture.loads);
+
+	// 읽지 못한 tile은 자리를 돌려준다.
+	virtualTexture.arrived.clear();
+	SparseTileData tile;
+	while (virtualTexture.arrived.size() < kVirtualTileLoadsPerFrame && virtualTexture.pStreamer->poll(tile)) {
+		if (tile.bytes.empty()) {
+			residency.cancelLoad(tile.key);
+			continue;
+		}
+		residency.markResident(tile.key);
+		virtualTexture.arrived.push_back(std::move(tile));
+	}
+
+	// 내린 tile은 이번 frame의 residency map에서 이미 빠졌으므로 바로 unmap 해도 shader가 읽지 않는다.
+	if (!virtualTexture.evictions.empty() || !virtualTexture.arrived.empty()) {
+		MTL::ResourceStateCommandEncoder* pMapping = pCmd->resourceStateCommandEncoder();
+		for (uint32_t key : virtualTexture.evictions) {
+			pMapping->updateTextureMapping(virtualTexture.pTexture, MTL::SparseTextureMappingModeUnmap,
+					MTL::Region::Make2D(sparseTileX(key), sparseTileY(key), 1, 1), sparseTileLevel(key), 0);
+		}
+		for (const SparseTileData& data : virtualTexture.arrived) {
+			pMapping->updateTextureMapping(virtualTexture.pTexture, MTL::SparseTextureMappingModeMap,
+					MTL::Region::Make2D(sparseTileX(data.key), sparseTileY(data.key), 1, 1), sparseTileLevel(data.key), 0);
+		}
+		pMapping->endEncoding();
+	}
+
+	// 도착한 tile과 바뀐 residency map을 staging buffer 하나에 모아 올린다.
+	const bool mapChanged = residency.takeResidencyMapChanged();
+	const size_t tileBytes = virtualTexture.arrived.size() * layout.tileBytes;
+	if (tileBytes > 0 || mapChanged) {
+		const std::vector<uint8_t>& residencyMap = residency.residencyMap();
+		MTL::Buffer* pStaging = _pDevice->newBuffer(tileBytes + (mapChanged ? residencyMap.size() : 0), MTL::ResourceStorageModeShared);
+		uint8_t* staging = static_cast<uint8_t*>(pStaging->contents());
+		MTL::BlitCommandEncoder* pBlit = pCmd->blitCommandEncoder();
+		for (size_t i = 0; i < virtualTexture.arrived.size(); ++i) {
+			const SparseTileData& data = virtualTexture.arrived[i];
+			const uint32_t level = sparseTileLevel(data.key);
+			const uint32_t x = sparseTileX(data.key) * layout.tileWidth, y = sparseTileY(data.key) * layout.tileHeight;
+			std::memcpy(staging + i * layout.tileBytes, data.bytes.data(), layout.tileBytes);
+			// 가장자리 tile은 level 밖으로 나가는 부분을 자른다.
+			pBlit->copyFromBuffer(pStaging, i * layout.tileBytes, layout.tileRowBytes, 0,
+					MTL::Size::Make(std::min(layout.tileWidth, layout.levelWidth(level) - x), std::min(layout.tileHeight, layout.levelHeight(level) - y), 1),
+					virtualTexture.pTexture, 0, level, MTL::Origin::Make(x, y, 0));
+		}
+		if (mapChanged) {
+			std::memcpy(staging + tileBytes, residencyMap.data(), residencyMap.size());
+			pBlit->copyFromBuffer(pStaging, tileBytes, layout.tilesWide[0], 0, MTL::Size::Make(layout.tilesWide[0], layout.tilesHigh[0], 1),
+					virtualTexture.pResidencyMap, 0, 0, MTL::Origin::Make(0, 0, 0));
+		}
+		pBlit->endEncoding();
+		pStaging->release();
+	}
+
+	std::chrono::duration<double> sinceReport = std::chrono::steady_clock::now() - virtualTexture.lastReport;
+	if (sinceReport.count() >= kVirtualTextureReportSeconds) {
+		const SparseResidencyStats& stats = residency.stats();
+		std::cout << "virtual texture: hit " << stats.hitRate() * 100.0 << "%, " << stats.residentTiles << " tiles resident ("
+			<< (stats.residentBytes >> 20) << " MB, peak " << (stats.peakBytes >> 20) << " MB), " << stats.loads << " loads, " << stats.evictions
+			<< " evictions, " << stats.deferred << " deferred" << std::endl;
+		residency.resetCounters();
+		virtualTexture.lastReport = std::chrono::steady_clock::now();
+	}
+}
+
+// Occluder로 쓸 삼각형 수의 상한. 256x128 raster에서 1 ms 안쪽으로 그릴 수 있는 정도.
+static const size_t kOccluderTriangleBudget = 1 << 15;
+
+/*
+ * primitive의 POSITION(float3)과 index buffer를 복사 없이 BvhTriangleGeometry로 본다.
+ * 삼각형 list가 아니거나 위치가 float3이 아니면 false.
+ * */
+static bool occluderGeometryFor(const GltfScene& scene, const GltfPrimitive& primitive, BvhTriangleGeometry& geometry)
+{
+	if (primitive.mode != 4 || primitive.count < 3) {
+		return false;
+	}
+	for (const GltfVertexAttribute& attribute : primitive.attributes) {
+		const GltfAccessor& accessor = scene.accessors[attribute.accessor];
+		if (attribute.slot != GltfAttributeSlotPosition || accessor.componentType != GltfComponentTypeFloat || accessor.numberOfComponents != 3) {
+			continue;
+		}
+		const GltfVertexBufferLayout& layout = primitive.layouts[attribute.layout];
+		geometry.vertexData = scene.buffers[layout.buffer].data() + layout.bufferOffset + attribute.offset;
+		geometry.vertexStride = layout.stride;
+		geometry.indexData = primitive.indexSize ? scene.buffers[primitive.indexBuffer].data() + primitive.indexBufferOffset : nullptr;
+		geometry.indexSize = primitive.indexSize ? primitive.indexSize : 4;
+		geometry.triangleCount = primitive.count / 3;
+		return true;
+	}
+	return false;
+}
+
+void Renderer::prepareCulling() {
+	const GltfScene& scene = scenePass.scene;
+	scenePass.occluders.clear();
+	scenePass.objects.clear();
+	scenePass.drawVisible.assign(scene.draws.size(), 1);
+
+	// 화면을 많이 가리는 draw부터 occluder로 쓴다. world bounds의 표면적으로 순서를 정한다.
+	std::vector<std::pair<float, uint32_t>> candidates;
+	for (uint32_t d = 0; d < scene.draws.size(); ++d) {
+		const GltfDraw& draw = scene.draws[d];
+		BvhDetail::Box box;
+		bool bounded = true;
+		for (const GltfPrimitive& primitive : scene.meshes[draw.mesh].primitives) {
+			const int32_t position = primitive.accessors[GltfAttributeSlotPosition];
+			if (position < 0 || !scene.accessors[position].hasBounds) {
+				bounded = false;
+				break;
+			}
+			const GltfAccessor& accessor = scene.accessors[position];
+			for (int corner = 0; corner < 8; ++corner) {
+				box.grow(transformPoint(draw.world, { corner & 1 ? accessor.boundsMax.x : accessor.boundsMin.x,
+						corner & 2 ? accessor.boundsMax.y : accessor.boundsMin.y, corner & 4 ? accessor.boundsMax.z : accessor.boundsMin.z }));
+			}
+		}
+		if (!bounded || !(box.min.x <= box.max.x)) {
+			continue;
+		}
+		scenePass.objects.add({ pack(box.min), pack(box.max) }, d);
+		candidates.push_back({ box.area(), d });
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+	size_t numberOfTriangles = 0;
+	for (const auto& [area, d] : candidates) {
+		const GltfDraw& draw = scene.draws[d];
+		for (const GltfPrimitive& primitive : scene.meshes[draw.mesh].primitives) {
+			BvhTriangleGeometry geometry;
+			if (occluderGeometryFor(scene, primitive, geometry) && numberOfTriangles + geometry.triangleCount <= kOccluderTriangleBudget) {
+				scenePass.occluders.push_back({ d, geometry });
+				numberOfTriangles += geometry.triangleCount;
+			}
+		}
+	}
+}
+
+/*
+ * 이번 frame의 변환으로 frustum 밖의 draw를 빼고, 남은 draw를 occluder의 Hi-Z pyramid로 검사한다.
+ * occluder는 낮은 해상도 depth에 software로 그리므로 GPU depth를 읽어 올 때처럼 한 frame 늦지 않는다.
+ * */
+void Renderer::cullDraws() {
+	const GltfScene& scene = scenePass.scene;
+	std::fill(scenePass.drawVisible.begin(), scenePass.drawVisible.end(), uint8_t(1));
+	if (scenePass.objects.size() == 0) {
+		return;
+	}
+	for (uint32_t object = 0; object < scenePass.objects.size(); ++object) {
+		scenePass.drawVisible[scenePass.objects.userData(object)] = 0;
+	}
+	scenePass.objects.cull(scenePass.fitTransform, scenePass.frustumVisible);
+
+	scenePass.occlusionBounds.clear();
+	for (uint32_t object : scenePass.frustumVisible) {
+		scenePass.occlusionBounds.push_back(scenePass.objects.bounds(object));
+	}
+	scenePass.occlusionVisible.assign(scenePass.occlusionBounds.size(), 1);
+	if (!scenePass.occluders.empty()) {
+		scenePass.occluderRasterizer.clear();
+		for (const ScenePass::Occluder& occluder : scenePass.occluders) {
+			scenePass.occluderRasterizer.rasterize(occluder.geometry, scenePass.fitTransform * scene.draws[occluder.draw].world);
+		}
+		scenePass.depthPyramid.build(scenePass.occluderRasterizer.depth(), scenePass.occluderRasterizer.width(),
+				scenePass.occluderRasterizer.height());
+		testOcclusion(scenePass.depthPyramid, scenePass.fitTransform, scenePass.occlusionBounds.data(), scenePass.occlusionBounds.size(),
+				scenePass.occlusionVisible.data());
+	}
+	for (size_t i = 0; i < scenePass.frustumVisible.size(); ++i) {
+		scenePass.drawVisible[scenePass.objects.userData(scenePass.frustumVisible[i])] = scenePass.occlusionVisible[i];
+	}
+}
+
+MTL::Buffer* Renderer::nextInstanceBuffer(InstanceStream& stream, size_t size) {
+	stream.frame = (stream.frame + 1) % kMaxFramesInFlight;
+	MTL::Buffer*& pBuffer = stream.pBuffers[stream.frame];
+	if (!pBuffer || pBuffer->length() < size) {
+		if (pBuffer) {
+			pBuffer->release();
+		}
+		// 다시 만드는 일이 잦지 않도록 여유를 둔다.
+		pBuffer = _pDevice->newBuffer(size + size / 2, MTL::ResourceStorageModeShared);
+	}
+	return pBuffer;
+}
+
+MTL::Buffer* Renderer::uploadInstances(InstanceStream& stream, const std::vector<InstanceData>& instances) {
+	MTL::Buffer* pBuffer = nextInstanceBuffer(stream, std::max<size_t>(1, instances.size()) * sizeof(InstanceData));
+	memcpy(pBuffer->contents(), instances.data(), instances.size() * sizeof(InstanceData));
+	return pBuffer;
+}
+
+void Renderer::drawScene(CapturedRenderEncoder& capture) {
+	const GltfScene& scene = scenePass.scene;
+	cullDraws();
+
+	// scene의 pipeline은 primitive의 vertex layout으로 정해지므로 mesh가 같으면 pipeline도 같다.
+	InstanceBatcher& batcher = scenePass.batcher;
+	for (size_t d = 0; d < scene.draws.size(); ++d) {
+		if (scenePass.drawVisible[d]) {
+			batcher.add(scene.draws[d].mesh, 0, scene.draws[d].world);
+		}
+	}
+	batcher.build();
+	MTL::Buffer* pInstanceBuffer = uploadInstances(scenePass.instanceStream, batcher.instances());
+
+	// pipeline, vertex buffer, 가장 가까운 instance의 depth 순서로 정렬해서 state 변경을 줄인다.
+	const std::vector<InstanceBatch>& batches = batcher.batches();
+	const std::vector<InstanceData>& instances = batcher.instances();
+	RenderQueue& queue = scenePass.renderQueue;
+	queue.clear();
+	scenePass.drawCommands.clear();
+	for (uint32_t b = 0; b < batches.size(); ++b) {
+		const InstanceBatch& batch = batches[b];
+		float depth = INFINITY;
+		for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; ++i) {
+			depth = std::min(depth, (scenePass.fitTransform * instances[i].model.columns[3]).z);
+		}
+		const std::vector<GltfPrimitive>& primitives = scene.meshes[batch.mesh].primitives;
+		for (uint32_t p = 0; p < primitives.size(); ++p) {
+			uint32_t buffers = primitives[p].layouts.empty() ? 0 : primitives[p].layouts[0].buffer;
+			queue.push(renderSortKey(scenePass.primitivePipelines[batch.mesh][p], buffers, depth), uint32_t(scenePass.drawCommands.size()));
+			scenePass.drawCommands.push_back({ b, p });
+		}
+	}
+	queue.sort();
+
+	FilteringRenderEncoder<CapturedRenderEncoder>& encoder = scenePass.encoder;
+	encoder.reset(&capture);
+	encoder.resetStats();
+	encoder.setVertexBuffer(scenePass.pDefaultAttributesBuffer, 0, kSceneDefaultAttributesBufferIndex);
+	encoder.setVertexBytes(&scenePass.fitTransform, sizeof(scenePass.fitTransform), kSceneTransformBufferIndex);
+	encoder.setFragmentSamplerState(scenePass.pSamplerState, 0);
+	if (scenePass.virtualTexture.enabled) {
+		VirtualTexture& virtualTexture = scenePass.virtualTexture;
+		encoder.setFragmentTexture(virtualTexture.pTexture, 0);
+		encoder.setFragmentTexture(virtualTexture.pResidencyMap, 1);
+		encoder.setFragmentBytes(&virtualTexture.info, sizeof(virtualTexture.info), 0);
+		encoder.setFragmentBuffer(virtualTexture.pFeedbackBuffers[virtualTexture.frame], 0, 1);
+	} else {
+		const bool textured = scenePass.pBaseColorTexture && scenePass.residentLod < float(scenePass.pBaseColorTexture->mipmapLevelCount());
+		encoder.setFragmentTexture(textured ? scenePass.pBaseColorTexture : scenePass.pWhiteTexture, 0);
+		encoder.setFragmentBytes(&scenePass.residentLod, sizeof(scenePass.residentLod), 0);
+	}
+	if (scenePass.variantOptions.fog) {
+		encoder.setFragmentBytes(&scenePass.fog, sizeof(scenePass.fog), kSceneFogBufferIndex);
+	}
+	for (const RenderQueueItem& item : queue.items()) {
+		const ScenePass::DrawCommand& command = scenePass.drawCommands[item.draw];
+		const InstanceBatch& batch = batches[command.batch];
+		const GltfPrimitive& primitive = scene.meshes[batch.mesh].primitives[command.primitive];
+		encoder.setRenderPipelineState(scenePass.pipelines[pipelineOfSortKey(item.key)]);
+		// accessor가 가리키는 위치를 buffer offset으로 넘기므로 vertex data를 옮길 필요가 없다.
+		for (uint32_t i = 0; i < primitive.layouts.size(); ++i) {
+			const GltfVertexBufferLayout& layout = primitive.layouts[i];
+			encoder.setVertexBuffer(scenePass.buffers[layout.buffer], layout.bufferOffset, i);
+		}
+		// instance buffer는 하나이므로 두 번째 batch부터는 offset만 바뀐다.
+		encoder.setVertexBuffer(pInstanceBuffer, batch.firstInstance * sizeof(InstanceData), kInstanceBufferIndex);
+		if (primitive.indexSize) {
+			encoder.drawIndexedPrimitives(primitiveTypeFor(primitive.mode), NS::UInteger(primitive.count),
+					primitive.indexSize == 2 ? MTL::IndexTypeUInt16 : MTL::IndexTypeUInt32,
+					scenePass.buffers[primitive.indexBuffer], NS::UInteger(primitive.indexBufferOffset), NS::UInteger(batch.instanceCount));
+		} else {
+			encoder.drawPrimitives(primitiveTypeFor(primitive.mode), NS::UInteger(0), NS::UInteger(primitive.count), NS::UInteger(batch.instanceCount));
+		}
+	}
+
+	// 10초(60 fps)마다 한 frame의 state 호출 수를 출력한다.
+	if (scenePass.frameIndex++ % 600 == 0) {
+		const EncoderFilterStats& stats = encoder.stats();
+		std::cout << "render queue: " << stats.draws << " draws, " << stats.stateCalls << " state calls ("
+			<< stats.filtered << " filtered, " << stats.offsetOnly << " offset only, " << stats.pipelineFiltered << " pipeline, "
+			<< stats.bufferFiltered << " buffer, " << stats.textureFiltered << " texture)" << std::endl;
+	}
+	encoder.reset(nullptr);
+}
+
+void Renderer::drawParticles(CapturedRenderEncoder& encoder) {
+	if (!particlePass.system) {
+		return;
+	}
+	ParticleSystem& system = *particlePass.system;
+	// 창이 가려져 있다가 돌아와도 한 번에 너무 많이 움직이지 않도록 dt를 자른다.
+	auto start = std::chrono::steady_clock::now();
+	float dt = 1.0f / 60.0f;
+	if (particlePass.lastUpdate != std::chrono::steady_clock::time_point()) {
+		dt = std::min(std::chrono::duration<float>(start - particlePass.lastUpdate).count(), 1.0f / 30.0f);
+	}
+	particlePass.lastUpdate = start;
+	ParticleUpdateStats stats = system.update(dt);
+	auto updated = std::chrono::steady_clock::now();
+	// particle은 clip space에 있다.
+	const Float4x4 viewProjection = identity4x4();
+	system.sortForBlending(viewProjection);
+	MTL::Buffer* pBuffer = nextInstanceBuffer(particlePass.instanceStream, std::max<size_t>(1, system.size()) * sizeof(ParticleInstance));
+	system.writeInstances(static_cast<ParticleInstance*>(pBuffer->contents()));
+	std::chrono::duration<double, std::milli> updateTime = updated - start;
+	std::chrono::duration<double, std::milli> sortTime = std::chrono::steady_clock::now() - updated;
+
+	// 10초(60 fps)마다 한 frame의 update 시간을 출력한다.
+	if (particlePass.frameIndex++ % 600 == 0) {
+		std::cout << "particles: " << stats.alive << " alive (" << stats.emitted << " emitted, " << stats.expired << " expired), update "
+			<< updateTime.count() << " ms, sort + upload " << sortTime.count() << " ms, "
+			<< double(stats.neighbourCandidates) / std::max<size_t>(1, stats.alive) << " neighbours per particle" << std::endl;
+	}
+	if (system.size() == 0) {
+		return;
+	}
+	encoder.setRenderPipelineState(particlePass.pPipelineState);
+	encoder.setDepthStencilState(particlePass.pDepthStencilState);
+	encoder.setVertexBuffer(pBuffer, 0, 0);
+	encoder.setVertexBytes(&viewProjection, sizeof(viewProjection), 1);
+	encoder.drawPrimitives(MTL::PrimitiveTypeTriangleStrip, NS::UInteger(0), NS::UInteger(4), NS::UInteger(system.size()));
+}
+
+void Renderer::drawSprites(CapturedRenderEncoder& encoder, MTK::View* pView) {
+	if (!spritePass.batch) {
+		return;
+	}
+	auto now = std::chrono::steady_clock::now();
+	std::chrono::duration<float, std::milli> frameTime = now - spritePass.lastFrame;
+	std::chrono::duration<float> elapsed = now - spritePass.start;
+	spritePass.lastFrame = now;
+	spritePass.frameTimes[spritePass.frameIndex % kHudGraphFrames] = frameTime.count();
+	const float width = float(pView->drawableSize().width), height = float(pView->drawableSize().height);
+	const float time = elapsed.count();
+
+	// layer 0: 어두운 판, 1: 오래된 frame부터 왼쪽에 쌓는 막대, 2: 16.7 ms 선, 3: 떠다니는 icon
+	SpriteBatch& batch = *spritePass.batch;
+	batch.clear();
+	const float graphHeight = 64.0f, left = 16.0f, bottom = 16.0f + graphHeight;
+	Sprite panel;
+	panel.position = { 8.0f, 8.0f };
+	panel.size = { 2.0f * left - 8.0f + kHudBarWidth * float(kHudGraphFrames), graphHeight + 16.0f };
+	panel.color = 0xA0000000u;
+	panel.image = kHudImageWhite;
+	batch.add(panel);
+	for (size_t bar = 0; bar < kHudGraphFrames; ++bar) {
+		const float milliseconds = spritePass.frameTimes[(spritePass.frameIndex + 1 + bar) % kHudGraphFrames];
+		Sprite sprite;
+		sprite.size = { kHudBarWidth, std::min(milliseconds * kHudPixelsPerMillisecond, graphHeight) };
+		sprite.position = { left + kHudBarWidth * float(bar), bottom - sprite.size.y };
+		// 초록: 60 fps 안, 노랑: 30 fps 안, 빨강: 그보다 느림
+		sprite.color = milliseconds <= 16.7f ? 0xFF40D040u : milliseconds <= 33.4f ? 0xFF40D0E0u : 0xFF4040E0u;
+		sprite.image = kHudImageWhite;
+		sprite.layer = 1;
+		batch.add(sprite);
+	}
+	Sprite budget;
+	budget.position = { left, bottom - 16.7f * kHudPixelsPerMillisecond };
+	budget.size = { kHudBarWidth * float(kHudGraphFrames), 1.0f };
+	budget.color = 0xC0FFFFFFu;
+	budget.image = kHudImageWhite;
+	budget.layer = 2;
+	batch.add(budget);
+	for (uint32_t icon = 0; icon < spritePass.iconCount; ++icon) {
+		// icon마다 다른 속도의 Lissajous 곡선을 따라 돈다.
+		const float seed = float(icon) * 0.618034f;
+		const float speedX = 0.2f + 0.3f * (seed - std::floor(seed)), speedY = 0.15f + 0.35f * (seed * 1.7f - std::floor(seed * 1.7f));
+		const AtlasRect& rect = spritePass.atlas.rects[1 + icon % kHudIconImages];
+		Sprite sprite;
+		sprite.size = { float(rect.width), float(rect.height) };
+		sprite.position = { (0.5f + 0.45f * std::sin(time * speedX + seed * 6.2832f)) * width - 0.5f * sprite.size.x,
+			(0.5f + 0.45f * std::cos(time * speedY + seed * 3.1416f)) * height - 0.5f * sprite.size.y };
+		sprite.rotation = time * (0.5f + 0.25f * float(icon % 5));
+		sprite.color = 0xC0000000u | ((icon * 0x9E3779B9u >> 8) & 0x00FFFFFFu);
+		sprite.image = 1 + icon % kHudIconImages;
+		sprite.layer = 3;
+		batch.add(sprite);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	batch.build();
+	MTL::Buffer* pVertexBuffer = nextInstanceBuffer(spritePass.vertexStream, batch.size() * 4 * sizeof(SpriteVertex));
+	batch.writeVertices(static_cast<SpriteVertex*>(pVertexBuffer->contents()));
+	std::chrono::duration<double, std::milli> batchTime = std::chrono::steady_clock::now() - start;
+	if (batch.size() > spritePass.indexBufferQuads) {
+		// 이전 buffer는 그것을 쓰는 command buffer가 붙잡고 있으므로 바로 놓아도 된다.
+		if (spritePass.pIndexBuffer) {
+			spritePass.pIndexBuffer->release();
+		}
+		spritePass.indexBufferQuads = batch.size() + batch.size() / 2;
+		spritePass.pIndexBuffer = _pDevice->newBuffer(spritePass.indexBufferQuads * 6 * sizeof(uint32_t), MTL::ResourceStorageModeShared);
+		SpriteBatch::writeQuadIndices(static_cast<uint32_t*>(spritePass.pIndexBuffer->contents()), spritePass.indexBufferQuads);
+	}
+	if (spritePass.frameIndex++ % 600 == 0) {
+		std::cout << "hud: " << batch.size() << " sprites in " << batch.draws().size() << " draws, batch + upload " << batchTime.count()
+			<< " ms" << std::endl;
+	}
+
+	const simd::float2 viewport = { width, height };
+	encoder.setRenderPipelineState(spritePass.pPipelineState);
+	encoder.setDepthStencilState(spritePass.pDepthStencilState);
+	encoder.setVertexBuffer(pVertexBuffer, 0, 0);
+	encoder.setVertexBytes(&viewport, sizeof(viewport), 1);
+	encoder.setFragmentSamplerState(spritePass.pSamplerState, 0);
+	for (const SpriteDraw& draw : batch.draws()) {
+		encoder.setFragmentTexture(spritePass.pPageTextures[draw.page], 0);
+		encoder.drawIndexedPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(draw.indexCount), MTL::IndexTypeUInt32,
+				spritePass.pIndexBuffer, NS::UInteger(draw.firstIndex) * sizeof(uint32_t));
+	}
+}
+
+// shader.metal의 TextUniforms와 같은 배치
+struct TextUniforms {
+	simd::float2 viewportSize;
+	simd::float2 atlasSize;
+};
+
+void Renderer::drawText(CapturedRenderEncoder& encoder, MTK::View* pView) {
+	if (!textPass.batch) {
+		return;
+	}
+	auto now = std::chrono::steady_clock::now();
+	std::chrono::duration<float, std::milli> frameTime = now - textPass.lastFrame;
+	textPass.lastFrame = now;
+	textPass.averageFrameTime += (frameTime.count() - textPass.averageFrameTime) * 0.05f;
+
+	// 쓸 값이 있는 pass만 줄을 더한다.
+	std::string text;
+	char line[128];
+	std::snprintf(line, sizeof(line), "frame %.2f ms (%.0f fps)\n", textPass.averageFrameTime, 1000.0f / std::max(textPass.averageFrameTime, 0.01f));
+	text += line;
+	if (_drawScene) {
+		const size_t visible = size_t(std::count(scenePass.drawVisible.begin(), scenePass.drawVisible.end(), uint8_t(1)));
+		std::snprintf(line, sizeof(line), "scene draws %zu / %zu visible\n", visible, scenePass.drawVisible.size());
+		text += line;
+	}
+	if (particlePass.system) {
+		std::snprintf(line, sizeof(line), "particles %zu\n", particlePass.system->size());
+		text += line;
+	}
+	if (spritePass.batch) {
+		std::snprintf(line, sizeof(line), "hud sprites %zu in %zu draws\n", spritePass.batch->size(), spritePass.batch->draws().size());
+		text += line;
+	}
+	std::snprintf(line, sizeof(line), "glyphs %zu", textPass.batch->instances().size());
+	text += line;
+
+	// HUD graph가 있으면 그 아래에 쓴다. 1 pixel 어긋난 검은 글자를 먼저 깔아 밝은 배경에서도 읽힌다.
+	const FontAtlas& atlas = textPass.atlas;
+	const float pixelSize = 16.0f, left = 16.0f;
+	const float top = (spritePass.batch ? 104.0f : 12.0f) + atlas.ascender * pixelSize;
+	TextBatch& batch = *textPass.batch;
+	batch.clear();
+	batch.add(text.c_str(), left + 1.0f, top + 1.0f, pixelSize, 0xC0000000u);
+	batch.add(text.c_str(), left, top, pixelSize, 0xFFFFFFFFu);
+	const std::vector<GlyphInstance>& instances = batch.instances();
+	if (instances.empty()) {
+		return;
+	}
+	MTL::Buffer* pBuffer = nextInstanceBuffer(textPass.instanceStream, instances.size() * sizeof(GlyphInstance));
+	memcpy(pBuffer->contents(), instances.data(), instances.size() * sizeof(GlyphInstance));
+
+	const TextUniforms uniforms = { { float(pView->drawableSize().width), float(pView->drawableSize().height) },
+		{ float(atlas.width), float(atlas.height) } };
+	encoder.setRenderPipelineState(textPass.pPipelineState);
+	encoder.setDepthStencilState(textPass.pDepthStencilState);
+	encoder.setVertexBuffer(pBuffer, 0, 0);
+	encoder.setVertexBytes(&uniforms, sizeof(uniforms), 1);
+	encoder.setFragmentTexture(textPass.pAtlasTexture, 0);
+	encoder.setFragmentSamplerState(textPass.pSamplerState, 0);
+	encoder.drawPrimitives(MTL::PrimitiveTypeTriangleStrip, NS::UInteger(0), NS::UInteger(4), NS::UInteger(instances.size()));
+}
+
+void Renderer::beginCapture(MTL::RenderCommandEncoder* pEnc) {
+	const bool capturing = _framesToCapture > 0;
+	_capture.reset(pEnc);
+	_capture.setWriter(capturing ? &_traceWriter : nullptr);
+	if (capturing) {
+		_traceWriter.beginFrame();
+	}
+}
+
+void Renderer::endCapture() {
+	_capture.reset(nullptr);
+	if (_framesToCapture == 0) {
+		return;
+	}
+	// buffer 내용은 encode가 끝난 뒤, GPU가 읽기 전의 것을 저장한다.
+	_traceWriter.endFrame();
+	if (--_framesToCapture == 0) {
+		if (_traceWriter.save(_capturePath)) {
+			std::cout << _capturePath << ": " << _traceWriter.numberOfFrames() << " frames, " << _traceWriter.bytes().size() << " bytes captured" << std::endl;
+		} else {
+			std::cerr << "Failed to write " << _capturePath << std::endl;
+		}
+		_traceWriter.clear();
+	}
+}
+
 /*
  * Whent it is time to draw the screen, this function is called.
  * */
@@ -407,28 +2135,425 @@ void Renderer::draw(MTK::View* pView)
 	// AutoreleasePool for managing Metal objects.
 	NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
 
+	// kMaxFramesInFlight frame 전의 command buffer가 끝나야 그 frame의 instance / feedback buffer를 다시 쓸 수 있다.
+	dispatch_semaphore_wait(_frameSemaphore, DISPATCH_TIME_FOREVER);
 	MTL::CommandBuffer* pCmd = _pCommandQueue->commandBuffer();
+	pCmd->addCompletedHandler([this](MTL::CommandBuffer*) {
+		dispatch_semaphore_signal(_frameSemaphore);
+	});
+	if (_drawScene) {
+		uploadTextureLevels(pCmd);
+		updateVirtualTexture(pCmd);
+	}
 	MTL::RenderPassDescriptor* pRpd = pView->currentRenderPassDescriptor();
 	MTL::RenderCommandEncoder* pEnc = pCmd->renderCommandEncoder(pRpd);
+	beginCapture(pEnc);
+	_capture.setDepthStencilState(_pDepthStencilState);
+	if (_drawScene) {
+		drawScene(_capture);
+		drawParticles(_capture);
+		drawSprites(_capture, pView);
+		drawText(_capture, pView);
+		pEnc->endEncoding();
+		endCapture();
+		pCmd->presentDrawable(pView->currentDrawable());
+		pCmd->commit();
+		pPool->release();
+		return;
+	}
 	// Tell the encoder to set the render pipeline state to this object.
 	if (!renderPass.renderPipelineState) {
 		std::cout << "renderPipelineState: " << renderPass.renderPipelineState << std::endl;
 		assert(false);
 	}
-	pEnc->setRenderPipelineState(renderPass.renderPipelineState);
+	_capture.setRenderPipelineState(renderPass.renderPipelineState);
 	Mesh& mesh = renderPass.mesh;
 	// Set vertex position buffer to index 0 in the buffer argument table starting at offset 0 in the buffer.
-	pEnc->setVertexBuffer(mesh.pVertexPositionsBuffer, 0, 0);
-	pEnc->setVertexBuffer(mesh.pVertexColorsBuffer, 0, 1);
+	_capture.setVertexBuffer(mesh.pVertexPositionsBuffer, 0, 0);
+	_capture.setVertexBuffer(mesh.pVertexColorsBuffer, 0, 1);
+	const std::vector<InstanceData>& instances = renderPass.instances;
 	// Invoke a draw command and how many vertices to use.
-	pEnc->drawPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(0), NS::UInteger(mesh.numberOfVertices));
+	if (mesh.pIndexBuffer) {
+		/*
+		 * instance마다 화면에서 1 pixel 이하로 틀리는 가장 거친 LOD를 고른다. 아직 camera가 없으므로 view와 projection은 단위 행렬이고,
+		 * clip volume을 보는 직교 투영이라 거리 대신 model 행렬의 배율만 pixel 크기를 바꾼다.
+		 * 같은 LOD끼리 instance를 모아 LOD마다 한 번씩 그린다.
+		 * */
+		const Float4x4 projection = identity4x4();
+		const Float4x4 view = identity4x4();
+		const float viewportHeight = float(pView->drawableSize().height);
+		std::vector<size_t>& instanceLods = renderPass.instanceLods;
+		instanceLods.resize(instances.size());
+		std::vector<size_t> lodFirst(mesh.lods.size() + 1, 0);
+		for (size_t i = 0; i < instances.size(); ++i) {
+			float pixelsPerUnit = instancePixelsPerUnit(projection, view * instances[i].model, mesh.boundsCenter, mesh.boundsRadius,
+					viewportHeight);
+			instanceLods[i] = selectLod(mesh.lods, pixelsPerUnit);
+			++lodFirst[instanceLods[i] + 1];
+		}
+		for (size_t lod = 0; lod < mesh.lods.size(); ++lod) {
+			lodFirst[lod + 1] += lodFirst[lod];
+		}
+		std::vector<InstanceData>& lodInstances = renderPass.lodInstances;
+		lodInstances.resize(instances.size());
+		std::vector<size_t> lodNext(lodFirst.begin(), lodFirst.end() - 1);
+		for (size_t i = 0; i < instances.size(); ++i) {
+			lodInstances[lodNext[instanceLods[i]]++] = instances[i];
+		}
+		MTL::Buffer* pInstanceBuffer = uploadInstances(renderPass.instanceStream, lodInstances);
+
+		for (size_t lod = 0; lod < mesh.lods.size(); ++lod) {
+			NS::UInteger instanceCount = NS::UInteger(lodFirst[lod + 1] - lodFirst[lod]);
+			if (instanceCount == 0) {
+				continue;
+			}
+			MTL::Buffer* pIndexBuffer = mesh.pIndexBuffer;
+			NS::UInteger indexCount = NS::UInteger(mesh.lods[lod].indexCount);
+			NS::UInteger indexOffset = NS::UInteger(mesh.lods[lod].indexOffset) * sizeof(uint32_t);
+			if (lod == 0) {
+				/*
+				 * instance의 model 행렬이 곧 view-projection이고, clip volume을 +z 방향으로 보는 직교 투영이다.
+				 * 보는 방향은 model의 역행렬로 object space에 옮긴다. instance마다 보이는 삼각형이 다르므로 여럿이면 culling 하지 않는다.
+				 * */
+				const bool singleInstance = instanceCount == 1;
+				const Float4x4 viewProjection = singleInstance ? projection * view * lodInstances[lodFirst[lod]].model : identity4x4();
+				MeshletCullParams params = meshletCullParamsFor(viewProjection, { 0.0f, 0.0f, 0.0f });
+				params.orthographic = true;
+				params.viewDirection = normalize(transformDirection(inverseAffine4x4(viewProjection), { 0.0f, 0.0f, 1.0f }));
+				params.frustumCulling = params.backfaceCulling = singleInstance;
+				pIndexBuffer = cullMeshletsForView(params);
+				indexCount = NS::UInteger(mesh.visibleTriangles * 3);
+				indexOffset = 0;
+			}
+			// meshlet culling으로 모두 걸러졌으면 그릴 것이 없다.
+			if (indexCount > 0) {
+				_capture.setVertexBuffer(pInstanceBuffer, lodFirst[lod] * sizeof(InstanceData), kInstanceBufferIndex);
+				_capture.drawIndexedPrimitives(MTL::PrimitiveTypeTriangle, indexCount,
+						MTL::IndexTypeUInt32, pIndexBuffer, indexOffset, instanceCount);
+			}
+		}
+	} else if (!instances.empty()) {
+		_capture.setVertexBuffer(uploadInstances(renderPass.instanceStream, instances), 0, kInstanceBufferIndex);
+		_capture.drawPrimitives(MTL::PrimitiveTypeTriangle, NS::UInteger(0), NS::UInteger(mesh.numberOfVertices), NS::UInteger(instances.size()));
+	}
+	drawParticles(_capture);
+	drawSprites(_capture, pView);
+	drawText(_capture, pView);
 	// Stop encoding.
 	pEnc->endEncoding();
+	endCapture();
 	// Tell GPU we got something to draw.
 	pCmd->presentDrawable(pView->currentDrawable());
 	pCmd->commit();
 
 	pPool->release();
 }
+
+void Renderer::checkParallelKernels(size_t count) {
+	NS::AutoreleasePool* pPool = NS::AutoreleasePool::alloc()->init();
+	ParallelKernels kernels(_pDevice, _pCommandQueue);
+	if (!kernels.build("parallel.metal")) {
+		pPool->release();
+		return;
+	}
+	// bench/parallel-primitives와 같은 입력
+	std::mt19937 random(17);
+	std::vector<uint32_t> keys(count), values(count), small(count);
+	std::vector<uint8_t> flags(count);
+	for (size_t i = 0; i < count; ++i) {
+		keys[i] = uint32_t(random());
+		values[i] = uint32_t(i);
+		small[i] = keys[i] & 0xFF;
+		flags[i] = uint8_t(random() & 1);
+	}
+	bool allMatch = true;
+	auto report = [&](const char* name, bool match) {
+		std::cout << "parallel.metal " << name << ": " << count << " keys, " << kernels.gpuMilliseconds() << " ms on GPU, "
+			<< (match ? "matches" : "DIFFERS from") << " the CPU" << std::endl;
+		allMatch = allMatch && match;
+	};
+
+	std::vector<uint32_t> reference(count), result;
+	const uint32_t referenceTotal = exclusiveScan(small.data(), reference.data(), count);
+	const uint32_t total = kernels.exclusiveScan(small, result);
+	report("scan", result == reference && total == referenceTotal);
+
+	const size_t referenceKept = compact(keys.data(), flags.data(), count, reference.data());
+	reference.resize(referenceKept);
+	kernels.compact(keys, flags, result);
+	report("compact", result == reference);
+
+	reference.assign(256, 0);
+	histogram(small.data(), count, reference.data(), 256);
+	report("histogram", kernels.histogram(small, result, 256) && result == reference);
+
+	std::vector<uint32_t> referenceKeys = keys, referenceValues = values, sortedKeys = keys, sortedValues = values;
+	radixSort(referenceKeys);
+	kernels.radixSort(sortedKeys);
+	report("sort", sortedKeys == referenceKeys);
+
+	referenceKeys = keys;
+	sortedKeys = keys;
+	radixSortPairs(referenceKeys, referenceValues);
+	kernels.radixSortPairs(sortedKeys, sortedValues);
+	report("pairs", sortedKeys == referenceKeys && sortedValues == referenceValues);
+	if (!allMatch) {
+		std::cerr << "parallel.metal and ComputePrimitives.hpp disagree" << std::endl;
+	}
+	pPool->release();
+}
 #pragma endregion Renderer }
 
+#pragma region ParallelKernels {
+
+ParallelKernels::~ParallelKernels() {
+	releaseBuffers();
+	for (MTL::ComputePipelineState* pPipelineState : _pPipelineStates) {
+		if (pPipelineState) {
+			pPipelineState->release();
+		}
+	}
+}
+
+bool ParallelKernels::build(const char* path) {
+	using NS::StringEncoding::UTF8StringEncoding;
+	using ComputePrimitivesDetail::kThreads;
+	if (!std::filesystem::exists(path)) {
+		std::cerr << "File not found: " << path << std::endl;
+		return false;
+	}
+	std::string source;
+	fileToString(path, source);
+	NS::Error* error = nullptr;
+	MTL::Library* pLibrary = _pDevice->newLibrary(NS::String::string(source.c_str(), UTF8StringEncoding), nullptr, &error);
+	if (!pLibrary) {
+		std::cerr << path << ": " << error->localizedDescription()->utf8String() << std::endl;
+		return false;
+	}
+	static const char* const names[NumberOfKernels] = { "scanBlocks", "addBlockOffsets", "flagsToPositions", "scatterFlagged",
+		"histogramBlocks", "reduceHistograms", "radixCount", "radixScatter" };
+	bool built = true;
+	for (int kernel = 0; kernel < NumberOfKernels; ++kernel) {
+		MTL::Function* pFunction = pLibrary->newFunction(NS::String::string(names[kernel], UTF8StringEncoding));
+		if (!pFunction) {
+			std::cerr << path << ": no kernel " << names[kernel] << std::endl;
+			built = false;
+			continue;
+		}
+		MTL::ComputePipelineState* pPipelineState = _pDevice->newComputePipelineState(pFunction, &error);
+		pFunction->release();
+		if (!pPipelineState) {
+			std::cerr << names[kernel] << ": " << error->localizedDescription()->utf8String() << std::endl;
+			built = false;
+			continue;
+		}
+		// kernel은 threadgroup 하나가 thread kThreads개라고 가정한다.
+		if (pPipelineState->maxTotalThreadsPerThreadgroup() < kThreads) {
+			std::cerr << names[kernel] << ": only " << pPipelineState->maxTotalThreadsPerThreadgroup() << " threads per threadgroup" << std::endl;
+			built = false;
+		}
+		_pPipelineStates[kernel] = pPipelineState;
+	}
+	pLibrary->release();
+	return built;
+}
+
+void ParallelKernels::begin() {
+	_pCommandBuffer = _pCommandQueue->commandBuffer();
+	// serial dispatch이므로 dispatch는 앞의 dispatch가 쓴 것을 본다.
+	_pEncoder = _pCommandBuffer->computeCommandEncoder();
+}
+
+void ParallelKernels::commitAndWait() {
+	_pEncoder->endEncoding();
+	_pCommandBuffer->commit();
+	_pCommandBuffer->waitUntilCompleted();
+	_gpuMilliseconds = (_pCommandBuffer->GPUEndTime() - _pCommandBuffer->GPUStartTime()) * 1e3;
+	_pEncoder = nullptr;
+	_pCommandBuffer = nullptr;
+}
+
+MTL::Buffer* ParallelKernels::newBuffer(size_t length, const void* contents) {
+	// 길이 0인 buffer는 만들 수 없다.
+	MTL::Buffer* pBuffer = _pDevice->newBuffer(std::max<size_t>(length, 16), MTL::ResourceStorageModeShared);
+	if (contents && length) {
+		memcpy(pBuffer->contents(), contents, length);
+	}
+	_buffers.push_back(pBuffer);
+	return pBuffer;
+}
+
+void ParallelKernels::releaseBuffers() {
+	for (MTL::Buffer* pBuffer : _buffers) {
+		pBuffer->release();
+	}
+	_buffers.clear();
+}
+
+void ParallelKernels::dispatchThreadgroups(Kernel kernel, uint32_t threadgroups) {
+	_pEncoder->setComputePipelineState(_pPipelineStates[kernel]);
+	_pEncoder->dispatchThreadgroups(MTL::Size(threadgroups, 1, 1), MTL::Size(ComputePrimitivesDetail::kThreads, 1, 1));
+}
+
+void ParallelKernels::dispatchThreads(Kernel kernel, uint32_t threads) {
+	// 마지막 group은 grid 밖의 thread 없이 돈다. (non-uniform threadgroup) kernel은 범위를 검사하지 않는다.
+	_pEncoder->setComputePipelineState(_pPipelineStates[kernel]);
+	_pEncoder->dispatchThreads(MTL::Size(threads, 1, 1), MTL::Size(ComputePrimitivesDetail::kThreads, 1, 1));
+}
+
+void ParallelKernels::encodeScan(MTL::Buffer* pInput, MTL::Buffer* pOutput, uint32_t count) {
+	using namespace ComputePrimitivesDetail;
+	const uint32_t blocks = (count + kBlockSize - 1) / kBlockSize;
+	MTL::Buffer* pBlockSums = newBuffer(blocks * sizeof(uint32_t));
+	_pEncoder->setBuffer(pInput, 0, 0);
+	_pEncoder->setBuffer(pOutput, 0, 1);
+	_pEncoder->setBuffer(pBlockSums, 0, 2);
+	_pEncoder->setBytes(&count, sizeof(count), 3);
+	_pEncoder->setThreadgroupMemoryLength(2 * kThreads * sizeof(uint32_t), 0);
+	dispatchThreadgroups(ScanBlocks, blocks);
+	if (blocks == 1) {
+		return;
+	}
+	// block 합을 제자리에서 scan 하면 각 block의 시작 offset이 된다.
+	encodeScan(pBlockSums, pBlockSums, blocks);
+	_pEncoder->setBuffer(pOutput, 0, 0);
+	_pEncoder->setBuffer(pBlockSums, 0, 1);
+	dispatchThreads(AddBlockOffsets, count);
+}
+
+uint32_t ParallelKernels::exclusiveScan(const std::vector<uint32_t>& input, std::vector<uint32_t>& output) {
+	const uint32_t count = uint32_t(input.size());
+	output.resize(count);
+	if (count == 0) {
+		return 0;
+	}
+	begin();
+	MTL::Buffer* pInput = newBuffer(count * sizeof(uint32_t), input.data());
+	MTL::Buffer* pOutput = newBuffer(count * sizeof(uint32_t));
+	encodeScan(pInput, pOutput, count);
+	commitAndWait();
+	memcpy(output.data(), pOutput->contents(), count * sizeof(uint32_t));
+	releaseBuffers();
+	return output.back() + input.back();
+}
+
+size_t ParallelKernels::compact(const std::vector<uint32_t>& values, const std::vector<uint8_t>& flags, std::vector<uint32_t>& output) {
+	const uint32_t count = uint32_t(values.size());
+	output.clear();
+	if (count == 0) {
+		return 0;
+	}
+	begin();
+	MTL::Buffer* pValues = newBuffer(count * sizeof(uint32_t), values.data());
+	MTL::Buffer* pFlags = newBuffer(count, flags.data());
+	MTL::Buffer* pPositions = newBuffer(count * sizeof(uint32_t));
+	MTL::Buffer* pOutput = newBuffer(count * sizeof(uint32_t));
+	_pEncoder->setBuffer(pFlags, 0, 0);
+	_pEncoder->setBuffer(pPositions, 0, 1);
+	dispatchThreads(FlagsToPositions, count);
+	encodeScan(pPositions, pPositions, count);
+	_pEncoder->setBuffer(pValues, 0, 0);
+	_pEncoder->setBuffer(pFlags, 0, 1);
+	_pEncoder->setBuffer(pPositions, 0, 2);
+	_pEncoder->setBuffer(pOutput, 0, 3);
+	dispatchThreads(ScatterFlagged, count);
+	commitAndWait();
+	// exclusive scan이므로 마지막 자리에 마지막 flag를 더하면 남은 수이다.
+	const size_t kept = static_cast<const uint32_t*>(pPositions->contents())[count - 1] + (flags[count - 1] != 0);
+	const uint32_t* kernelOutput = static_cast<const uint32_t*>(pOutput->contents());
+	output.assign(kernelOutput, kernelOutput + kept);
+	releaseBuffers();
+	return kept;
+}
+
+bool ParallelKernels::histogram(const std::vector<uint32_t>& values, std::vector<uint32_t>& bins, uint32_t numberOfBins) {
+	using namespace ComputePrimitivesDetail;
+	if (numberOfBins == 0 || numberOfBins > kMaxHistogramBins) {
+		std::cerr << "histogram needs 1 to " << kMaxHistogramBins << " bins, not " << numberOfBins << std::endl;
+		return false;
+	}
+	// parallel.metal의 HistogramParams와 같은 배치
+	struct {
+		uint32_t count;
+		uint32_t numberOfBins;
+		uint32_t itemsPerGroup;
+		uint32_t numberOfGroups;
+	} params;
+	const size_t count = values.size();
+	const size_t blocks = std::max<size_t>(1, (count + kBlockSize - 1) / kBlockSize);
+	const uint32_t groups = uint32_t(std::min<size_t>(kHistogramGroups, blocks));
+	params = { uint32_t(count), numberOfBins, uint32_t((blocks + groups - 1) / groups * kBlockSize), groups };
+	begin();
+	MTL::Buffer* pValues = newBuffer(count * sizeof(uint32_t), values.data());
+	MTL::Buffer* pBlockHistograms = newBuffer(size_t(groups) * numberOfBins * sizeof(uint32_t));
+	MTL::Buffer* pBins = newBuffer(numberOfBins * sizeof(uint32_t));
+	_pEncoder->setBuffer(pValues, 0, 0);
+	_pEncoder->setBuffer(pBlockHistograms, 0, 1);
+	_pEncoder->setBytes(&params, sizeof(params), 2);
+	// threadgroup memory는 16 byte 단위이다.
+	_pEncoder->setThreadgroupMemoryLength((numberOfBins * sizeof(uint32_t) + 15) & ~size_t(15), 0);
+	dispatchThreadgroups(HistogramBlocks, groups);
+	_pEncoder->setBuffer(pBlockHistograms, 0, 0);
+	_pEncoder->setBuffer(pBins, 0, 1);
+	dispatchThreads(ReduceHistograms, numberOfBins);
+	commitAndWait();
+	const uint32_t* kernelBins = static_cast<const uint32_t*>(pBins->contents());
+	bins.assign(kernelBins, kernelBins + numberOfBins);
+	releaseBuffers();
+	return true;
+}
+
+void ParallelKernels::sort(std::vector<uint32_t>& keys, std::vector<uint32_t>* values) {
+	using namespace ComputePrimitivesDetail;
+	const uint32_t count = uint32_t(keys.size());
+	if (count < 2) {
+		return;
+	}
+	// parallel.metal의 RadixParams와 같은 배치
+	struct {
+		uint32_t count;
+		uint32_t shift;
+		uint32_t numberOfBlocks;
+		uint32_t withValues;
+	} params;
+	const uint32_t blocks = (count + kBlockSize - 1) / kBlockSize;
+	begin();
+	MTL::Buffer* pKeys[2] = { newBuffer(count * sizeof(uint32_t), keys.data()), newBuffer(count * sizeof(uint32_t)) };
+	// value 없이 정렬해도 kernel의 buffer 자리는 채워야 한다. withValues가 0이면 읽지 않는다.
+	MTL::Buffer* pValues[2] = { pKeys[0], pKeys[1] };
+	if (values) {
+		pValues[0] = newBuffer(count * sizeof(uint32_t), values->data());
+		pValues[1] = newBuffer(count * sizeof(uint32_t));
+	}
+	MTL::Buffer* pBlockCounts = newBuffer(size_t(kRadixDigits) * blocks * sizeof(uint32_t));
+	for (uint32_t shift = 0, pass = 0; shift < 32; shift += kRadixBits, ++pass) {
+		const uint32_t source = pass & 1, destination = source ^ 1;
+		params = { count, shift, blocks, values != nullptr };
+		_pEncoder->setBuffer(pKeys[source], 0, 0);
+		_pEncoder->setBuffer(pBlockCounts, 0, 1);
+		_pEncoder->setBytes(&params, sizeof(params), 2);
+		_pEncoder->setThreadgroupMemoryLength(kRadixDigits * sizeof(uint32_t), 0);
+		dispatchThreadgroups(RadixCount, blocks);
+		encodeScan(pBlockCounts, pBlockCounts, kRadixDigits * blocks);
+		_pEncoder->setBuffer(pKeys[source], 0, 0);
+		_pEncoder->setBuffer(pKeys[destination], 0, 1);
+		_pEncoder->setBuffer(pValues[source], 0, 2);
+		_pEncoder->setBuffer(pValues[destination], 0, 3);
+		_pEncoder->setBuffer(pBlockCounts, 0, 4);
+		_pEncoder->setBytes(&params, sizeof(params), 5);
+		_pEncoder->setThreadgroupMemoryLength(kRadixDigits * kThreads * sizeof(uint32_t), 0);
+		_pEncoder->setThreadgroupMemoryLength(2 * kThreads * sizeof(uint32_t), 1);
+		_pEncoder->setThreadgroupMemoryLength(kRadixDigits * sizeof(uint32_t), 2);
+		dispatchThreadgroups(RadixScatter, blocks);
+	}
+	commitAndWait();
+	// pass 수가 짝수라서 결과는 처음 buffer에 있다.
+	memcpy(keys.data(), pKeys[0]->contents(), count * sizeof(uint32_t));
+	if (values) {
+		memcpy(values->data(), pValues[0]->contents(), count * sizeof(uint32_t));
+	}
+	releaseBuffers();
+}
+
+#pragma endregion ParallelKernels }
+
@@ -0,0 +1,55 @@
+/*
+ * astc-encode benchmark
+ *
+ * BenchUtil.hpp의 `makeImage`로 만든 RGBA8 image(gradient, noise, 체크 무늬 경계, 반투명한 영역)를
+ * ASTC block 크기(4x4 ~ 12x12)와 quality마다 압축하고
+ *   encode   - 압축 속도 (Mpix/s)
+ *   decode   - 푸는 속도 (Mpix/s)
+ *   PSNR     - RGBA 전체를 비교한 PSNR (dB)
+ *   bpp      - pixel당 bit (128 / block texel 수)
+ * 를 잰다. thread 하나로 압축한 결과와 bit 단위로 같은지도 확인한다.
+ * argv[1]은 image의 한 변이다. (기본 512)
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "AstcEncoder.hpp"
+#include "BcEncoder.hpp"
+#include "BenchUtil.hpp"
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	ThreadPool single(1);
+	const uint32_t size = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 512;
+	const std::vector<uint8_t> image = makeImage(size);
+	const size_t rowPitch = size_t(size) * 4;
+	const double megapixels = double(size) * size * 1e-6;
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%6s %9s %14s %14s %10s %6s %8s\n", "block", "quality", "encode(Mpix/s)", "decode(Mpix/s)", "PSNR(dB)", "bpp", "match");
+
+	const char* qualities[] = { "fast", "thorough" };
+	for (TextureFormat format : { TextureFormatASTC_4x4_LDR, TextureFormatASTC_5x5_LDR, TextureFormatASTC_6x6_LDR, TextureFormatASTC_8x6_LDR,
+			 TextureFormatASTC_8x8_LDR, TextureFormatASTC_10x10_LDR, TextureFormatASTC_12x12_LDR }) {
+		const TextureFormatInfo info = textureFormatInfo(format);
+		const TextureLayout layout = makeTextureLayout(format, size, size);
+		char block[16];
+		std::snprintf(block, sizeof(block), "%ux%u", info.blockWidth, info.blockHeight);
+		for (uint32_t quality = AstcQualityFast; quality <= AstcQualityThorough; ++quality) {
+			std::vector<uint8_t> blocks(size_t(layout.totalSize())), reference(blocks.size());
+			std::vector<uint8_t> decoded(image.size());
+			const int runs = quality == AstcQualityThorough ? 1 : 3;
+			double encode = bestOf(runs, [&] { encodeAstc(format, image.data(), size, size, rowPitch, blocks.data(), AstcQuality(quality), pool); });
+			double decode = bestOf(3, [&] { decodeAstc(format, blocks.data(), size, size, decoded.data(), rowPitch, pool); });
+			encodeAstc(format, image.data(), size, size, rowPitch, reference.data(), AstcQuality(quality), single);
+			const bool match = blocks == reference;
+			std::printf("%6s %9s %14.2f %14.1f %10.2f %6.2f %8s\n", block, qualities[quality], megapixels / encode * 1e3, megapixels / decode * 1e3,
+					computePsnr(image.data(), decoded.data(), size, size, rowPitch, 0xF), 128.0 / (info.blockWidth * info.blockHeight),
+					match ? "yes" : "NO");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * bc-encode benchmark
+ *
+ * 부드러운 gradient, 약한 noise, 날카로운 경계와 반투명한 영역을 섞은 RGBA8 image를 BCn으로 압축하고
+ *   encode   - 압축 속도 (Mpix/s)
+ *   decode   - 푸는 속도 (Mpix/s)
+ *   PSNR     - format이 담는 채널만 비교한 PSNR (dB)
+ *   bpp      - pixel당 bit, ratio는 RGBA8 대비 크기 비율
+ * 을 format과 quality마다 잰다. thread 하나로 압축한 결과와 bit 단위로 같은지도 확인한다.
+ * argv[1]은 image의 한 변이다. (기본 1024)
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "BcEncoder.hpp"
+#include "BenchUtil.hpp"
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	ThreadPool single(1);
+	const uint32_t size = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 1024;
+	const std::vector<uint8_t> image = makeImage(size);
+	// BC1은 alpha가 1 bit라 불투명한 image로 잰다.
+	std::vector<uint8_t> opaqueImage = image;
+	for (size_t i = 3; i < opaqueImage.size(); i += 4) {
+		opaqueImage[i] = 255;
+	}
+	const size_t rowPitch = size_t(size) * 4;
+	const double megapixels = double(size) * size * 1e-6;
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%6s %8s %14s %14s %10s %6s %7s %8s\n", "format", "quality", "encode(Mpix/s)", "decode(Mpix/s)", "PSNR(dB)", "bpp", "ratio",
+			"match");
+
+	struct Format {
+		const char* name;
+		TextureFormat format;
+		uint32_t channels;
+	};
+	const char* qualities[] = { "fast", "normal", "high" };
+	for (Format format : { Format{ "BC1", TextureFormatBC1_RGBA, 0x7 }, Format{ "BC3", TextureFormatBC3_RGBA, 0xF },
+			 Format{ "BC4", TextureFormatBC4_RUnorm, 0x1 }, Format{ "BC5", TextureFormatBC5_RGUnorm, 0x3 },
+			 Format{ "BC7", TextureFormatBC7_RGBAUnorm, 0xF } }) {
+		const TextureLayout layout = makeTextureLayout(format.format, size, size);
+		const uint8_t* source = format.format == TextureFormatBC1_RGBA ? opaqueImage.data() : image.data();
+		for (uint32_t quality = BcQualityFast; quality <= BcQualityHigh; ++quality) {
+			std::vector<uint8_t> blocks(size_t(layout.totalSize())), reference(blocks.size());
+			std::vector<uint8_t> decoded(image.size());
+			// 높은 quality는 느리므로 한 번만 잰다.
+			const int runs = quality == BcQualityHigh ? 1 : 3;
+			double encode = bestOf(runs, [&] { encodeBc(format.format, source, size, size, rowPitch, blocks.data(), BcQuality(quality), pool); });
+			double decode = bestOf(3, [&] { decodeBc(format.format, blocks.data(), size, size, decoded.data(), rowPitch, pool); });
+			encodeBc(format.format, source, size, size, rowPitch, reference.data(), BcQuality(quality), single);
+			const bool match = blocks == reference;
+			const double psnr = computePsnr(source, decoded.data(), size, size, rowPitch, format.channels);
+			const double bitsPerPixel = double(blocks.size()) * 8.0 / (double(size) * size);
+			std::printf("%6s %8s %14.2f %14.1f %10.2f %6.1f %6.1fx %8s\n", format.name, qualities[quality], megapixels / encode * 1e3,
+					megapixels / decode * 1e3, psnr, bitsPerPixel, 32.0 / bitsPerPixel, match ? "yes" : "NO");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * bvh-trace benchmark
+ *
+ * 구를 격자로 늘어놓은 scene으로 BVH build / refit 시간과
+ * 카메라 ray(coherent)와 무작위 ray(incoherent)의 초당 ray 수(Mrays/s)를 출력한다.
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "Bvh.hpp"
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	int parts = argc > 1 ? std::atoi(argv[1]) : 16;
+
+	MeshData mesh;
+	for (int z = 0; z < parts; ++z) {
+		for (int x = 0; x < parts; ++x) {
+			addSphere(mesh, { float(x) * 3.0f, 0.0f, -float(z) * 3.0f }, 1.0f, 64);
+		}
+	}
+	BvhTriangleGeometry geometry = triangleGeometryFor(mesh);
+	std::printf("threads: %u\n", pool.size());
+	std::printf("scene: %zu vertices, %zu triangles\n", mesh.numberOfVertices(), mesh.numberOfTriangles());
+
+	Bvh bvh;
+	double buildTime = bestOf(3, [&] { bvh.build(geometry, BvhBuildMode::Sah, pool); });
+	std::printf("build: %zu nodes, %.2f ms (%.1f Mtri/s)\n", bvh.numberOfNodes(), buildTime, mesh.numberOfTriangles() / (buildTime * 1000.0));
+
+	// vertex를 조금 움직이고 refit
+	for (Float3& p : mesh.positions) {
+		p.y += 0.05f * std::sin(p.x * 2.0f + p.z);
+	}
+	double refitTime = bestOf(3, [&] { bvh.refit(geometry, pool); });
+	std::printf("refit: %.2f ms (%.1f Mtri/s)\n", refitTime, mesh.numberOfTriangles() / (refitTime * 1000.0));
+
+	const float extent = parts * 3.0f;
+	const int width = 1280, height = 720;
+	std::vector<Ray> primary(size_t(width) * height);
+	Float3 eye = { extent * 0.5f, extent * 0.4f, extent * 0.3f };
+	Float4x4 view = lookAt4x4(eye, { extent * 0.5f, 0.0f, -extent * 0.5f }, { 0.0f, 1.0f, 0.0f });
+	// view 행렬의 회전 부분을 전치하면 camera 공간 -> world 공간
+	Float3 right = { view.columns[0].x, view.columns[1].x, view.columns[2].x };
+	Float3 up = { view.columns[0].y, view.columns[1].y, view.columns[2].y };
+	Float3 back = { view.columns[0].z, view.columns[1].z, view.columns[2].z };
+	float tanHalf = std::tan(0.5f);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			float u = ((x + 0.5f) / width * 2.0f - 1.0f) * tanHalf * width / height;
+			float v = (1.0f - (y + 0.5f) / height * 2.0f) * tanHalf;
+			primary[size_t(y) * width + x] = { pack(eye), 0.0f, pack(normalize(right * u + up * v - back)), INFINITY };
+		}
+	}
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Ray> incoherent(primary.size());
+	Aabb bounds = bvh.bounds();
+	for (Ray& ray : incoherent) {
+		Float3 origin = { bounds.min.x + (unit(random) * 0.5f + 0.5f) * (bounds.max.x - bounds.min.x), unit(random) * 2.0f,
+			bounds.min.z + (unit(random) * 0.5f + 0.5f) * (bounds.max.z - bounds.min.z) };
+		Float3 direction = normalize({ unit(random), unit(random), unit(random) });
+		ray = { pack(origin), 0.0f, pack(direction), INFINITY };
+	}
+
+	std::vector<RayHit> hits(primary.size());
+	std::vector<uint8_t> occluded(primary.size());
+	std::printf("%-12s %10s %12s %12s %12s\n", "rays", "hit%", "closest(ms)", "Mrays/s", "any Mrays/s");
+	struct Batch { const char* name; const std::vector<Ray>& rays; };
+	for (const Batch& batch : { Batch{ "primary", primary }, Batch{ "incoherent", incoherent } }) {
+		double closest = bestOf(3, [&] { bvh.intersect(batch.rays.data(), hits.data(), batch.rays.size(), 0.0f, pool); });
+		double any = bestOf(3, [&] {
+			pool.parallelFor(batch.rays.size(), 1024, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					occluded[i] = bvh.occluded(batch.rays[i]);
+				}
+			});
+		});
+		size_t numberOfHits = 0;
+		for (const RayHit& hit : hits) {
+			numberOfHits += hit.distance >= 0.0f;
+		}
+		std::printf("%-12s %10.1f %12.2f %12.1f %12.1f\n", batch.name, 100.0 * numberOfHits / hits.size(), closest,
+				batch.rays.size() / (closest * 1000.0), batch.rays.size() / (any * 1000.0));
+	}
+	return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * compute-dispatch benchmark
+ *
+ * CpuComputeEncoder로 MSL 모양의 kernel 세 개를 돌리고 같은 일을 하는 보통 C++ loop와 시간, 결과를 비교한다.
+ *   saxpy  - thread마다 원소 하나. dispatchThreads(non-uniform)로 thread 하나당 dispatch 비용을 본다.
+ *   reduce - threadgroup 256개 thread가 threadgroup memory에서 tree reduction. barrier 8번(구간 9개)
+ *   blur   - 16x16 tile과 가장자리 2 pixel을 threadgroup memory에 읽고 5x5 평균. barrier 1번
+ * argv[1]은 saxpy / reduce의 원소 수이다. (기본 1600만)
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "ComputeDispatch.hpp"
+
+struct SaxpyKernel {
+	float a;
+	const float* x;
+	float* y;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		const uint32_t i = thread.positionInGrid.x;
+		y[i] = a * x[i] + y[i];
+	}
+};
+
+// thread 하나가 4개를 더해 threadgroup memory에 두고 반씩 줄여 간다. group의 합을 partialSums에 쓴다.
+struct ReduceKernel {
+	static constexpr uint32_t kThreadsPerThreadgroup = 256;
+	static constexpr uint32_t kElementsPerThread = 4;
+	static constexpr uint32_t kNumberOfPhases = 9;
+
+	const float* input;
+	size_t count;
+	float* partialSums;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		float* shared = thread.threadgroupMemory<float>(0);
+		const uint32_t lane = thread.indexInThreadgroup;
+		if (thread.phase == 0) {
+			const size_t first = size_t(thread.positionInGrid.x) * kElementsPerThread;
+			float sum = 0.0f;
+			for (size_t i = first; i < std::min(first + kElementsPerThread, count); ++i) {
+				sum += input[i];
+			}
+			shared[lane] = sum;
+			return;
+		}
+		const uint32_t stride = kThreadsPerThreadgroup >> thread.phase;
+		if (lane < stride) {
+			shared[lane] += shared[lane + stride];
+		}
+		if (thread.phase == kNumberOfPhases - 1 && lane == 0) {
+			partialSums[thread.threadgroupPositionInGrid.x] = shared[0];
+		}
+	}
+};
+
+struct BlurKernel {
+	static constexpr uint32_t kTile = 16;
+	static constexpr int kRadius = 2;
+	static constexpr uint32_t kApron = kTile + 2 * kRadius;
+	static constexpr uint32_t kNumberOfPhases = 2;
+
+	const float* source;
+	float* destination;
+	uint32_t width, height;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		float* tile = thread.threadgroupMemory<float>(0);
+		const int originX = int(thread.threadgroupPositionInGrid.x * kTile) - kRadius;
+		const int originY = int(thread.threadgroupPositionInGrid.y * kTile) - kRadius;
+		if (thread.phase == 0) {
+			// group의 thread가 20x20 tile을 나눠 읽는다. 오른쪽 / 아래 끝 group은 thread가 적다. 경계 밖은 가장자리 pixel로 채운다.
+			const uint32_t threads = thread.threadsPerThreadgroup.x * thread.threadsPerThreadgroup.y;
+			for (uint32_t i = thread.indexInThreadgroup; i < kApron * kApron; i += threads) {
+				const int x = std::min(std::max(originX + int(i % kApron), 0), int(width) - 1);
+				const int y = std::min(std::max(originY + int(i / kApron), 0), int(height) - 1);
+				tile[i] = source[size_t(y) * width + x];
+			}
+			return;
+		}
+		float sum = 0.0f;
+		for (int dy = 0; dy <= 2 * kRadius; ++dy) {
+			for (int dx = 0; dx <= 2 * kRadius; ++dx) {
+				sum += tile[(thread.positionInThreadgroup.y + dy) * kApron + thread.positionInThreadgroup.x + dx];
+			}
+		}
+		destination[size_t(thread.positionInGrid.y) * width + thread.positionInGrid.x] = sum * (1.0f / 25.0f);
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16000000;
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+	std::vector<float> x(count), y(count);
+	for (size_t i = 0; i < count; ++i) {
+		x[i] = value(random);
+		y[i] = value(random);
+	}
+	CpuComputeEncoder encoder(pool);
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%8s %12s %8s %12s %14s %14s %8s\n", "kernel", "threads", "phases", "dispatch(ms)", "reference(ms)", "Gthreads/s", "match");
+
+	// saxpy
+	{
+		std::vector<float> gpu = y, cpu = y;
+		double dispatch = bestOf(3, [&] {
+			gpu = y;
+			encoder.dispatchThreads(SaxpyKernel{ 2.0f, x.data(), gpu.data() }, { uint32_t(count), 1, 1 }, { 256, 1, 1 });
+		});
+		double reference = bestOf(3, [&] {
+			cpu = y;
+			for (size_t i = 0; i < count; ++i) {
+				cpu[i] = 2.0f * x[i] + cpu[i];
+			}
+		});
+		std::printf("%8s %12zu %8d %12.2f %14.2f %14.3f %8s\n", "saxpy", count, 1, dispatch, reference, count / dispatch * 1e-6,
+				gpu == cpu ? "yes" : "NO");
+	}
+
+	// reduce
+	{
+		const uint32_t threads = uint32_t((count + ReduceKernel::kElementsPerThread - 1) / ReduceKernel::kElementsPerThread);
+		const uint32_t groups = (threads + ReduceKernel::kThreadsPerThreadgroup - 1) / ReduceKernel::kThreadsPerThreadgroup;
+		std::vector<float> partialSums(groups);
+		encoder.setThreadgroupMemoryLength(ReduceKernel::kThreadsPerThreadgroup * sizeof(float), 0);
+		double total = 0.0;
+		double dispatch = bestOf(3, [&] {
+			// 마지막 group의 grid 밖 thread도 0을 더하도록 group 단위로 dispatch 한다.
+			encoder.dispatchThreadgroups(ReduceKernel{ x.data(), count, partialSums.data() }, { groups, 1, 1 },
+					{ ReduceKernel::kThreadsPerThreadgroup, 1, 1 });
+			total = 0.0;
+			for (float partialSum : partialSums) {
+				total += partialSum;
+			}
+		});
+		double expected = 0.0;
+		double reference = bestOf(3, [&] {
+			expected = 0.0;
+			for (size_t i = 0; i < count; ++i) {
+				expected += x[i];
+			}
+		});
+		std::printf("%8s %12zu %8u %12.2f %14.2f %14.3f %8s\n", "reduce", size_t(groups) * ReduceKernel::kThreadsPerThreadgroup,
+				ReduceKernel::kNumberOfPhases, dispatch, reference, double(groups) * ReduceKernel::kThreadsPerThreadgroup / dispatch * 1e-6,
+				std::fabs(total - expected) <= 1e-3 * std::sqrt(double(count)) ? "yes" : "NO");
+	}
+
+	// blur
+	{
+		// 16의 배수가 아니어서 끝의 group은 thread가 적다.
+		const uint32_t width = 1999, height = 1201;
+		std::vector<float> image(size_t(width) * height), gpu(image.size()), cpu(image.size());
+		for (float& pixel : image) {
+			pixel = value(random);
+		}
+		encoder.setThreadgroupMemoryLength(BlurKernel::kApron * BlurKernel::kApron * sizeof(float), 0);
+		double dispatch = bestOf(3, [&] {
+			encoder.dispatchThreads(BlurKernel{ image.data(), gpu.data(), width, height }, { width, height, 1 },
+					{ BlurKernel::kTile, BlurKernel::kTile, 1 });
+		});
+		double reference = bestOf(3, [&] {
+			for (int y = 0; y < int(height); ++y) {
+				for (int x = 0; x < int(width); ++x) {
+					float sum = 0.0f;
+					for (int dy = -BlurKernel::kRadius; dy <= BlurKernel::kRadius; ++dy) {
+						for (int dx = -BlurKernel::kRadius; dx <= BlurKernel::kRadius; ++dx) {
+							const int sx = std::min(std::max(x + dx, 0), int(width) - 1);
+							const int sy = std::min(std::max(y + dy, 0), int(height) - 1);
+							sum += image[size_t(sy) * width + sx];
+						}
+					}
+					cpu[size_t(y) * width + x] = sum * (1.0f / 25.0f);
+				}
+			}
+		});
+		std::printf("%8s %12zu %8u %12.2f %14.2f %14.3f %8s\n", "blur", image.size(), BlurKernel::kNumberOfPhases, dispatch, reference,
+				image.size() / dispatch * 1e-6, gpu == cpu ? "yes" : "NO");
+	}
+	return 0;
+}
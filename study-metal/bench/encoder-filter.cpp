@@ -0,0 +1,107 @@
+/*
+ * encoder-filter benchmark
+ *
+ * pipeline 16종, mesh 256개(vertex buffer 4개에 나눠 담음), material 32종을 쓰는 draw 1만 ~ 100만 개를
+ * pipeline, mesh 순서로 정렬해 두고, draw마다 필요한 state를 모두 설정하는 단순한 encode 코드를 흉내 낸다.
+ * 같은 호출 열을 RecordingEncoder에 그대로 넣은 것과 FilteringRenderEncoder를 거쳐 넣은 것의 draw state hash를 비교하고
+ * encoder까지 간 호출 수와 wrapper가 들어온 호출 하나에 쓰는 시간을 출력한다.
+ * */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "FilteringEncoder.hpp"
+#include "RecordingEncoder.hpp"
+
+// 호출 수만 세는 encoder. wrapper 자체의 비용을 재는 데 쓴다.
+struct CountingEncoder {
+	size_t calls{0};
+
+	void setRenderPipelineState(const void*) { ++calls; }
+	void setDepthStencilState(const void*) { ++calls; }
+	void setViewport(const RecordedViewport&) { ++calls; }
+	void setCullMode(uint32_t) { ++calls; }
+	void setVertexBuffer(const void*, uint64_t, uint64_t) { ++calls; }
+	void setVertexBufferOffset(uint64_t, uint64_t) { ++calls; }
+	void setVertexBytes(const void*, uint64_t, uint64_t) { ++calls; }
+	void setFragmentBuffer(const void*, uint64_t, uint64_t) { ++calls; }
+	void setFragmentBufferOffset(uint64_t, uint64_t) { ++calls; }
+	void setFragmentBytes(const void*, uint64_t, uint64_t) { ++calls; }
+	void drawPrimitives(uint32_t, uint64_t, uint64_t, uint64_t) { ++calls; }
+	void drawIndexedPrimitives(uint32_t, uint64_t, uint32_t, const void*, uint64_t, uint64_t) { ++calls; }
+};
+
+struct Draw {
+	uint32_t pipeline;
+	uint32_t mesh;
+	uint32_t material;
+	uint32_t firstInstance;
+};
+
+static const void* handle(uint32_t kind, uint32_t id)
+{
+	return reinterpret_cast<const void*>(uintptr_t(kind) << 32 | uintptr_t(id + 1));
+}
+
+template <class Encoder>
+static void encode(Encoder& encoder, const std::vector<Draw>& draws, const float (&transform)[16])
+{
+	const RecordedViewport viewport{ 0.0, 0.0, 1280.0, 720.0, 0.0, 1.0 };
+	encoder.setVertexBytes(transform, sizeof(transform), 16);
+	for (const Draw& draw : draws) {
+		encoder.setViewport(viewport);
+		encoder.setCullMode(uint32_t(draw.pipeline & 1));
+		encoder.setRenderPipelineState(handle(1, draw.pipeline));
+		encoder.setDepthStencilState(handle(2, draw.pipeline >= 12));
+		// mesh는 vertex buffer 4개 중 하나에 위치, 속성 순서로 들어 있다.
+		const void* vertexBuffer = handle(3, draw.mesh % 4);
+		const uint64_t meshOffset = uint64_t(draw.mesh / 4) * 65536;
+		encoder.setVertexBuffer(vertexBuffer, meshOffset, 0);
+		encoder.setVertexBuffer(vertexBuffer, meshOffset + 32768, 1);
+		encoder.setVertexBuffer(handle(4, 0), uint64_t(draw.firstInstance) * 80, 17);
+		encoder.setFragmentBuffer(handle(5, 0), uint64_t(draw.material) * 256, 0);
+		encoder.drawIndexedPrimitives(3u, 1536u, 1u, handle(6, draw.mesh % 4), meshOffset, 4u);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+	const float transform[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+	std::printf("%10s %12s %12s %10s %12s %10s %12s %14s\n", "draws", "state calls", "forwarded", "filtered", "offset only",
+			"pipeline", "same draws", "ns/state call");
+	for (size_t count : { size_t(10000), size_t(100000), size_t(1000000) }) {
+		if (count > largest) {
+			break;
+		}
+		std::mt19937 random(5);
+		std::vector<Draw> draws(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			draws[i] = { uint32_t(random() % 16), uint32_t(random() % 256), uint32_t(random() % 32), i * 4 };
+		}
+		std::sort(draws.begin(), draws.end(), [](const Draw& a, const Draw& b) {
+			return a.pipeline != b.pipeline ? a.pipeline < b.pipeline : a.mesh < b.mesh;
+		});
+
+		RecordingEncoder unfiltered, recorded;
+		FilteringRenderEncoder<RecordingEncoder> filtering(&recorded);
+		encode(unfiltered, draws, transform);
+		encode(filtering, draws, transform);
+		const bool same = unfiltered.drawStateHashes() == recorded.drawStateHashes();
+		const EncoderFilterStats stats = filtering.stats();
+
+		CountingEncoder counter;
+		FilteringRenderEncoder<CountingEncoder> timed;
+		double milliseconds = bestOf(5, [&] {
+			timed.reset(&counter);
+			encode(timed, draws, transform);
+		});
+		std::printf("%10zu %12zu %12zu %10zu %12zu %10zu %12s %14.2f\n", count, stats.stateCalls, recorded.calls().size() - stats.draws,
+				stats.filtered, stats.offsetOnly, stats.pipelineFiltered, same ? "yes" : "NO", milliseconds * 1e6 / double(stats.stateCalls));
+	}
+	return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * frustum-cull benchmark
+ *
+ * 넓은 공간에 흩어진 물체 10만 ~ 100만 개를 SceneObjectStore에 넣고 돌아가는 camera로 frustum culling 한다.
+ * 물체를 하나씩 검사하는 scalar 구현과 ms당 처리한 물체 수를 비교한다.
+ * `make bench BENCH_ARCH=-mavx2`로 빌드하면 AVX2 경로를 쓴다.
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "SceneObjects.hpp"
+
+// 비교 기준: Aabb 배열을 하나씩 p-vertex로 검사한다.
+static size_t cullScalar(const std::vector<Aabb>& bounds, const Float4x4& viewProjection, std::vector<uint32_t>& visible)
+{
+	Float4 planes[6];
+	extractFrustumPlanes(viewProjection, planes);
+	visible.clear();
+	for (uint32_t i = 0; i < bounds.size(); ++i) {
+		bool inside = true;
+		for (const Float4& plane : planes) {
+			Float3 p = { plane.x >= 0.0f ? bounds[i].max.x : bounds[i].min.x, plane.y >= 0.0f ? bounds[i].max.y : bounds[i].min.y,
+				plane.z >= 0.0f ? bounds[i].max.z : bounds[i].min.z };
+			if (plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < 0.0f) {
+				inside = false;
+				break;
+			}
+		}
+		if (inside) {
+			visible.push_back(i);
+		}
+	}
+	return visible.size();
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+#if SIMD_AVX2
+	const char* lanes = "AVX2";
+#elif SIMD_SSE
+	const char* lanes = "2 x SSE";
+#elif SIMD_NEON
+	const char* lanes = "2 x NEON";
+#else
+	const char* lanes = "scalar";
+#endif
+	std::printf("threads: %u, Lanes8: %s\n", pool.size(), lanes);
+
+	const float extent = 1000.0f;
+	Float4x4 projection = perspective4x4(1.0f, 16.0f / 9.0f, 0.5f, extent);
+	std::printf("%10s %10s %12s %12s %10s %10s %10s\n", "objects", "cull(ms)", "objects/ms", "scalar(ms)", "sphere%", "box%", "visible%");
+	for (size_t count : { size_t(100000), size_t(250000), size_t(1000000) }) {
+		if (count > largest) {
+			break;
+		}
+		std::mt19937 random(9);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<Aabb> bounds(count);
+		SceneObjectStore store;
+		store.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			Float3 center = { unit(random) * extent, unit(random) * extent * 0.1f, unit(random) * extent };
+			Float3 half = Float3{ 1.0f, 1.0f, 1.0f } * (2.0f + 1.5f * unit(random));
+			bounds[i] = { pack(center - half), pack(center + half) };
+			store.add(bounds[i], uint32_t(i));
+		}
+
+		// 원점에서 한 바퀴 도는 camera 8개 방향의 평균
+		const int views = 8;
+		double cullTime = 0.0, scalarTime = 0.0;
+		FrustumCullStats total;
+		std::vector<uint32_t> visible, reference;
+		for (int v = 0; v < views; ++v) {
+			float angle = 2.0f * float(M_PI) * v / views;
+			Float4x4 viewProjection = projection * lookAt4x4({ 0.0f, 20.0f, 0.0f }, { std::cos(angle), 20.0f, std::sin(angle) }, { 0.0f, 1.0f, 0.0f });
+			FrustumCullStats stats;
+			cullTime += bestOf(3, [&] { stats = store.cull(viewProjection, visible, pool); });
+			scalarTime += bestOf(3, [&] { cullScalar(bounds, viewProjection, reference); });
+			if (visible != reference) {
+				std::printf("mismatch: %zu visible, scalar %zu\n", visible.size(), reference.size());
+			}
+			total.sphereCulled += stats.sphereCulled;
+			total.boxCulled += stats.boxCulled;
+			total.visible += stats.visible;
+		}
+		cullTime /= views;
+		scalarTime /= views;
+		double tested = double(count) * views;
+		std::printf("%10zu %10.3f %12.0f %12.3f %10.1f %10.1f %10.1f\n", count, cullTime, count / cullTime, scalarTime,
+				100.0 * total.sphereCulled / tested, 100.0 * total.boxCulled / tested, 100.0 * total.visible / tested);
+	}
+	return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * gltf-load benchmark
+ *
+ * mesh 수가 다른 .glb scene을 만들어 loadGltf에 걸리는 시간을 잰다.
+ * vertex data는 다시 packing 하지 않으므로 load 시간은 파일 읽기 + JSON parsing 시간과 거의 같아야 한다.
+ * 먼저 stride가 있거나 정렬되지 않은 uint16 index accessor를 다시 packing 한 결과가 맞는지 확인한다.
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "GltfLoader.hpp"
+
+/*
+ * meshCount개의 grid mesh를 가진 glb를 쓴다.
+ * POSITION/NORMAL은 stride 24로 interleave, COLOR_0는 normalized uchar4, index는 uint16.
+ * */
+static void writeScene(const std::string& path, int meshCount, int gridSize)
+{
+	const int vertices = gridSize * gridSize;
+	const int indices = (gridSize - 1) * (gridSize - 1) * 6;
+	std::vector<char> binary;
+	auto append = [&binary](const void* data, size_t size) {
+		binary.insert(binary.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	};
+	std::string bufferViews, accessors, meshes, nodes;
+	for (int m = 0; m < meshCount; ++m) {
+		size_t interleavedOffset = binary.size();
+		for (int y = 0; y < gridSize; ++y) {
+			for (int x = 0; x < gridSize; ++x) {
+				float vertex[6] = { float(x) / gridSize, float(y) / gridSize, 0.0f, 0.0f, 0.0f, 1.0f };
+				append(vertex, sizeof(vertex));
+			}
+		}
+		size_t colorOffset = binary.size();
+		for (int v = 0; v < vertices; ++v) {
+			unsigned char color[4] = { (unsigned char)(m * 37), (unsigned char)(v), 200, 255 };
+			append(color, sizeof(color));
+		}
+		size_t indexOffset = binary.size();
+		for (int y = 0; y + 1 < gridSize; ++y) {
+			for (int x = 0; x + 1 < gridSize; ++x) {
+				uint16_t a = uint16_t(y * gridSize + x), b = uint16_t(a + 1), c = uint16_t(a + gridSize), d = uint16_t(c + 1);
+				uint16_t quad[6] = { a, b, c, b, d, c };
+				append(quad, sizeof(quad));
+			}
+		}
+		int view = m * 3, accessor = m * 4;
+		char text[1024];
+		std::snprintf(text, sizeof(text), "%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%d,\"byteStride\":24},"
+			"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%d},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%d}",
+			m ? "," : "", interleavedOffset, vertices * 24, colorOffset, vertices * 4, indexOffset, indices * 2);
+		bufferViews += text;
+		std::snprintf(text, sizeof(text), "%s{\"bufferView\":%d,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\",\"min\":[0,0,0],\"max\":[1,1,0]},"
+			"{\"bufferView\":%d,\"byteOffset\":12,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\"},"
+			"{\"bufferView\":%d,\"componentType\":5121,\"normalized\":true,\"count\":%d,\"type\":\"VEC4\"},"
+			"{\"bufferView\":%d,\"componentType\":5123,\"count\":%d,\"type\":\"SCALAR\"}",
+			m ? "," : "", view, vertices, view, vertices, view + 1, vertices, view + 2, indices);
+		accessors += text;
+		std::snprintf(text, sizeof(text), "%s{\"name\":\"grid%d\",\"primitives\":[{\"attributes\":{\"POSITION\":%d,\"NORMAL\":%d,\"COLOR_0\":%d},\"indices\":%d}]}",
+			m ? "," : "", m, accessor, accessor + 1, accessor + 2, accessor + 3);
+		meshes += text;
+		std::snprintf(text, sizeof(text), "%s{\"mesh\":%d,\"translation\":[%d,%d,0]}", m ? "," : "", m, m % 64, m / 64);
+		nodes += text;
+	}
+	std::string rootNodes;
+	for (int m = 0; m < meshCount; ++m) {
+		rootNodes += (m ? "," : "") + std::to_string(m);
+	}
+	std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[" + rootNodes + "]}],\"nodes\":[" + nodes +
+		"],\"meshes\":[" + meshes + "],\"accessors\":[" + accessors + "],\"bufferViews\":[" + bufferViews +
+		"],\"buffers\":[{\"byteLength\":" + std::to_string(binary.size()) + "}]}";
+	while (json.size() % 4) json += ' ';
+	while (binary.size() % 4) binary.push_back(0);
+
+	std::ofstream file(path, std::ios::binary);
+	uint32_t header[3] = { 0x46546C67u, 2, uint32_t(12 + 8 + json.size() + 8 + binary.size()) };
+	uint32_t jsonChunk[2] = { uint32_t(json.size()), 0x4E4F534Au };
+	uint32_t binaryChunk[2] = { uint32_t(binary.size()), 0x004E4942u };
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+	file.write(json.data(), std::streamsize(json.size()));
+	file.write(reinterpret_cast<const char*>(binaryChunk), sizeof(binaryChunk));
+	file.write(binary.data(), std::streamsize(binary.size()));
+}
+
+/*
+ * 삼각형 하나의 uint16 index 0 1 2를 byteStride 4, 또는 4 byte 정렬이 아닌 offset 2로 두고 읽는다.
+ * 둘 다 다시 packing 되므로 primitive.indexBuffer를 indexSize씩 읽었을 때 0 1 2여야 한다.
+ * */
+static bool checkRepackedIndices(const std::filesystem::path& directory)
+{
+	const float positions[9] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+	const uint16_t strided[6] = { 0, 0xFFFF, 1, 0xFFFF, 2, 0xFFFF };
+	const uint16_t unaligned[4] = { 0xFFFF, 0, 1, 2 };
+	const struct {
+		const char* name;
+		const void* data;
+		size_t size;
+		const char* view;
+	} cases[] = {
+		{ "strided", strided, sizeof(strided), "\"byteOffset\":36,\"byteLength\":12,\"byteStride\":4" },
+		{ "unaligned", unaligned, sizeof(unaligned), "\"byteOffset\":38,\"byteLength\":6" },
+	};
+	for (const auto& test : cases) {
+		std::string binary(reinterpret_cast<const char*>(positions), sizeof(positions));
+		binary.append(static_cast<const char*>(test.data), test.size);
+		const std::filesystem::path path = directory / (std::string(test.name) + ".glb");
+		std::string json = std::string("{\"asset\":{\"version\":\"2.0\"},\"nodes\":[{\"mesh\":0}],") +
+			"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1}]}]," +
+			"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\",\"min\":[0,0,0],\"max\":[1,1,0]}," +
+			"{\"bufferView\":1,\"componentType\":5123,\"count\":3,\"type\":\"SCALAR\"}]," +
+			"\"bufferViews\":[{\"buffer\":0,\"byteLength\":36},{\"buffer\":0," + test.view + "}]," +
+			"\"buffers\":[{\"byteLength\":" + std::to_string(binary.size()) + "}]}";
+		while (json.size() % 4) json += ' ';
+		while (binary.size() % 4) binary.push_back(0);
+		{
+			std::ofstream file(path, std::ios::binary);
+			uint32_t header[3] = { 0x46546C67u, 2, uint32_t(12 + 8 + json.size() + 8 + binary.size()) };
+			uint32_t jsonChunk[2] = { uint32_t(json.size()), 0x4E4F534Au };
+			uint32_t binaryChunk[2] = { uint32_t(binary.size()), 0x004E4942u };
+			file.write(reinterpret_cast<const char*>(header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+			file.write(json.data(), std::streamsize(json.size()));
+			file.write(reinterpret_cast<const char*>(binaryChunk), sizeof(binaryChunk));
+			file.write(binary.data(), std::streamsize(binary.size()));
+		}
+
+		GltfScene scene;
+		const bool loaded = loadGltf(path.string().c_str(), scene);
+		std::filesystem::remove(path);
+		if (!loaded || scene.meshes.empty() || scene.meshes[0].primitives.empty()) {
+			std::printf("%s uint16 indices: not loaded\n", test.name);
+			return false;
+		}
+		const GltfPrimitive& primitive = scene.meshes[0].primitives[0];
+		const char* indices = scene.buffers[primitive.indexBuffer].data() + primitive.indexBufferOffset;
+		for (uint32_t i = 0; i < 3; ++i) {
+			uint32_t index = 0;
+			std::memcpy(&index, indices + i * primitive.indexSize, primitive.indexSize);
+			if (primitive.indexSize != 2 || primitive.count != 3 || index != i) {
+				std::printf("%s uint16 indices: index %u is %u (indexSize %u)\n", test.name, i, index, primitive.indexSize);
+				return false;
+			}
+		}
+	}
+	std::printf("repacked uint16 indices: ok\n");
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "gltf-load-bench";
+	std::filesystem::create_directories(directory);
+	if (!checkRepackedIndices(directory)) {
+		return 1;
+	}
+	int largest = argc > 1 ? std::atoi(argv[1]) : 4096;
+
+	std::printf("%8s %10s %10s %10s %10s %12s\n", "meshes", "size(MB)", "JSON(KB)", "time(ms)", "MB/s", "repacked(B)");
+	for (int meshCount = 16; meshCount <= largest; meshCount *= 4) {
+		std::string path = (directory / ("scene" + std::to_string(meshCount) + ".glb")).string();
+		writeScene(path, meshCount, 64);
+		double megabytes = double(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+
+		GltfScene scene;
+		double best = 1e30;
+		for (int run = 0; run < 3; ++run) {
+			auto start = std::chrono::steady_clock::now();
+			if (!loadGltf(path.c_str(), scene)) {
+				return 1;
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+		std::ifstream file(path, std::ios::binary);
+		uint32_t jsonLength[4];
+		file.read(reinterpret_cast<char*>(jsonLength), sizeof(jsonLength));
+		std::printf("%8zu %10.2f %10.1f %10.2f %10.1f %12zu\n", scene.draws.size(), megabytes, jsonLength[3] / 1024.0,
+				best, megabytes / (best / 1000.0), scene.repackedBytes);
+		std::filesystem::remove(path);
+	}
+	return 0;
+}
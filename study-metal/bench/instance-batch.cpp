@@ -0,0 +1,48 @@
+/*
+ * instance-batch benchmark
+ *
+ * mesh 64종, pipeline 4종을 쓰는 물체 1만 ~ 100만 개를 무작위 순서로 InstanceBatcher에 넣고
+ * instanced draw로 묶는 시간과 draw call 수를 출력한다. draw call 수는 물체 수가 아니라 (mesh, pipeline) 쌍 수를 따른다.
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "InstanceBatcher.hpp"
+
+int main(int argc, char* argv[])
+{
+	size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+	const uint32_t numberOfMeshes = 64, numberOfPipelines = 4;
+
+	std::printf("%10s %12s %12s %14s\n", "objects", "draw calls", "batch(ms)", "Minstances/s");
+	for (size_t count : { size_t(10000), size_t(100000), size_t(1000000) }) {
+		if (count > largest) {
+			break;
+		}
+		std::mt19937 random(3);
+		std::vector<uint32_t> meshes(count), pipelines(count);
+		std::vector<Float4x4> models(count);
+		for (size_t i = 0; i < count; ++i) {
+			meshes[i] = random() % numberOfMeshes;
+			// pipeline은 mesh의 재질로 정해진다고 본다.
+			pipelines[i] = meshes[i] % numberOfPipelines;
+			models[i] = translation4x4({ float(i % 1000), 0.0f, -float(i / 1000) });
+		}
+
+		InstanceBatcher batcher;
+		batcher.reserve(count);
+		double time = bestOf(3, [&] {
+			batcher.clear();
+			for (size_t i = 0; i < count; ++i) {
+				batcher.add(meshes[i], pipelines[i], models[i], { 1.0f, 1.0f, 1.0f, 1.0f });
+			}
+			batcher.build();
+		});
+		std::printf("%10zu %12zu %12.2f %14.1f\n", count, batcher.batches().size(), time, count / (time * 1000.0));
+	}
+	return 0;
+}
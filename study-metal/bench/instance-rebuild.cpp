@@ -0,0 +1,92 @@
+/*
+ * instance-rebuild benchmark
+ *
+ * 작은 mesh 몇 개를 10만 ~ 100만 개 instance로 흩어 놓고 매 frame transform이 바뀐다고 보고
+ * top-level BVH의 SAH build / Fast(Morton) build / refit 시간과, motion keyframe이 있을 때의 ray 처리량을 출력한다.
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "InstanceBvh.hpp"
+
+// i번째 instance의 frame 시점 transform. 격자 위에서 조금씩 돌고 움직인다.
+static Float4x4 instanceTransform(size_t i, size_t side, float frame)
+{
+	float angle = frame * 0.1f + float(i % 97) * 0.37f;
+	Float4 q = { 0.0f, std::sin(angle * 0.5f), 0.0f, std::cos(angle * 0.5f) };
+	Float3 position = { float(i % side) * 4.0f + std::sin(frame + i) * 0.5f, 0.0f, -float(i / side) * 4.0f };
+	return translation4x4(position) * rotation4x4(q) * scale4x4({ 1.0f, 1.0f + 0.5f * float(i % 3), 1.0f });
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+	MeshData meshes[3];
+	addSphere(meshes[0], { 0.0f, 0.0f, 0.0f }, 1.0f, 8);
+	addSphere(meshes[1], { 0.0f, 0.0f, 0.0f }, 0.7f, 16);
+	addSphere(meshes[2], { 0.0f, 0.0f, 0.0f }, 1.2f, 4);
+	Bvh structures[3];
+	std::vector<const Bvh*> pointers;
+	for (int i = 0; i < 3; ++i) {
+		structures[i].build(triangleGeometryFor(meshes[i]), BvhBuildMode::Sah, pool);
+		pointers.push_back(&structures[i]);
+	}
+
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%10s %10s %10s %10s %12s %14s\n", "instances", "sah(ms)", "fast(ms)", "refit(ms)", "Mrays/s", "motion Mrays/s");
+	for (size_t count : { size_t(100000), size_t(250000), size_t(500000), size_t(1000000) }) {
+		if (count > largest) {
+			break;
+		}
+		const size_t side = size_t(std::sqrt(double(count)));
+		std::vector<InstanceDescriptor> instances(count);
+		for (size_t i = 0; i < count; ++i) {
+			instances[i] = { pack(instanceTransform(i, side, 0.0f)), 0, 0xFF, 0, uint32_t(i % 3) };
+		}
+
+		InstanceBvh bvh;
+		double sah = bestOf(2, [&] { bvh.build(instances.data(), count, pointers, BvhBuildMode::Sah, pool); });
+		double fast = bestOf(2, [&] { bvh.build(instances.data(), count, pointers, BvhBuildMode::Fast, pool); });
+		// 다음 frame: transform만 바뀐다.
+		for (size_t i = 0; i < count; ++i) {
+			instances[i].transformationMatrix = pack(instanceTransform(i, side, 1.0f));
+		}
+		double refit = bestOf(2, [&] { bvh.refit(instances.data(), count, pool); });
+
+		// 위에서 비스듬히 내려다보는 ray
+		const size_t numberOfRays = 1 << 18;
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<Ray> rays(numberOfRays);
+		for (Ray& ray : rays) {
+			Float3 target = { unit(random) * side * 4.0f, 0.0f, -unit(random) * side * 4.0f };
+			Float3 origin = target + Float3{ 10.0f, 30.0f, 10.0f };
+			ray = { pack(origin), 0.0f, pack(normalize(target - origin)), INFINITY };
+		}
+		std::vector<InstanceRayHit> hits(numberOfRays);
+		double trace = bestOf(2, [&] { bvh.intersect(rays.data(), hits.data(), numberOfRays, 0.0f, pool); });
+
+		// 같은 장면을 frame 0, 1 두 keyframe으로 보고 그 사이 시간으로 trace
+		std::vector<MotionInstanceDescriptor> motionInstances(count);
+		std::vector<PackedFloat4x3> motionTransforms(count * 2);
+		for (size_t i = 0; i < count; ++i) {
+			motionInstances[i] = { 0, 0xFF, 0, uint32_t(i % 3), uint32_t(i), uint32_t(i * 2), 2,
+				MotionBorderMode::Clamp, MotionBorderMode::Clamp, 0.0f, 1.0f };
+			motionTransforms[i * 2] = pack(instanceTransform(i, side, 0.0f));
+			motionTransforms[i * 2 + 1] = pack(instanceTransform(i, side, 1.0f));
+		}
+		InstanceBvh motionBvh;
+		motionBvh.build(motionInstances.data(), count, motionTransforms.data(), pointers, BvhBuildMode::Fast, pool);
+		double motionTrace = bestOf(2, [&] { motionBvh.intersect(rays.data(), hits.data(), numberOfRays, 0.5f, pool); });
+
+		std::printf("%10zu %10.2f %10.2f %10.2f %12.2f %14.2f\n", count, sah, fast, refit,
+				numberOfRays / (trace * 1000.0), numberOfRays / (motionTrace * 1000.0));
+	}
+	return 0;
+}
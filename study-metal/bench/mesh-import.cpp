@@ -0,0 +1,188 @@
+/*
+ * mesh-import benchmark
+ *
+ * 크기가 다른 grid mesh를 OBJ / PLY(ascii, binary)로 만들어 두고
+ * importMesh의 처리량(MB/s)을 파일 크기별로 출력한다.
+ * 범위를 벗어난 index나 list 길이가 들어 있는 작은 파일은 importMesh가 거부하는지도 확인한다.
+ * Metal이 필요 없으므로 Linux에서도 `make bench`로 빌드할 수 있다.
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MeshImporter.hpp"
+
+enum class FileKind { Obj, ObjWithNormals, PlyAscii, PlyBinary };
+
+static const char* kindName(FileKind kind)
+{
+	switch (kind) {
+		case FileKind::Obj: return "obj";
+		case FileKind::ObjWithNormals: return "obj v//vn";
+		case FileKind::PlyAscii: return "ply ascii";
+		case FileKind::PlyBinary: return "ply binary";
+	}
+	return "";
+}
+
+// n x n vertex 높이맵 grid를 파일로 쓴다.
+static void writeGrid(const std::string& path, FileKind kind, int n)
+{
+	FILE* file = std::fopen(path.c_str(), "wb");
+	const int numberOfVertices = n * n;
+	const int numberOfFaces = (n - 1) * (n - 1) * 2;
+	auto height = [n](int x, int y) { return 0.1f * std::sin(x * 12.0f / n) * std::cos(y * 9.0f / n); };
+
+	if (kind == FileKind::PlyAscii || kind == FileKind::PlyBinary) {
+		std::fprintf(file, "ply\nformat %s 1.0\ncomment generated by mesh-import benchmark\n",
+				kind == FileKind::PlyAscii ? "ascii" : "binary_little_endian");
+		std::fprintf(file, "element vertex %d\nproperty float x\nproperty float y\nproperty float z\n", numberOfVertices);
+		std::fprintf(file, "property uchar red\nproperty uchar green\nproperty uchar blue\n");
+		std::fprintf(file, "element face %d\nproperty list uchar int vertex_indices\nend_header\n", numberOfFaces);
+	}
+	for (int y = 0; y < n; ++y) {
+		for (int x = 0; x < n; ++x) {
+			float position[3] = { float(x) / n, float(y) / n, height(x, y) };
+			unsigned char color[3] = { (unsigned char)(x * 255 / n), (unsigned char)(y * 255 / n), 128 };
+			if (kind == FileKind::PlyBinary) {
+				std::fwrite(position, sizeof(float), 3, file);
+				std::fwrite(color, 1, 3, file);
+			} else if (kind == FileKind::PlyAscii) {
+				std::fprintf(file, "%.6f %.6f %.6f %d %d %d\n", position[0], position[1], position[2], color[0], color[1], color[2]);
+			} else {
+				std::fprintf(file, "v %.6f %.6f %.6f\n", position[0], position[1], position[2]);
+			}
+		}
+	}
+	if (kind == FileKind::ObjWithNormals) {
+		for (int i = 0; i < numberOfVertices; ++i) {
+			std::fprintf(file, "vn 0.0 0.0 1.0\n");
+		}
+	}
+	for (int y = 0; y + 1 < n; ++y) {
+		for (int x = 0; x + 1 < n; ++x) {
+			int a = y * n + x, b = a + 1, c = a + n, d = c + 1;
+			int triangles[2][3] = { { a, b, c }, { b, d, c } };
+			for (auto& t : triangles) {
+				if (kind == FileKind::PlyBinary) {
+					unsigned char count = 3;
+					std::fwrite(&count, 1, 1, file);
+					std::fwrite(t, sizeof(int), 3, file);
+				} else if (kind == FileKind::PlyAscii) {
+					std::fprintf(file, "3 %d %d %d\n", t[0], t[1], t[2]);
+				} else if (kind == FileKind::ObjWithNormals) {
+					std::fprintf(file, "f %d//%d %d//%d %d//%d\n", t[0] + 1, t[0] + 1, t[1] + 1, t[1] + 1, t[2] + 1, t[2] + 1);
+				} else {
+					std::fprintf(file, "f %d %d %d\n", t[0] + 1, t[1] + 1, t[2] + 1);
+				}
+			}
+		}
+	}
+	std::fclose(file);
+}
+
+// 삼각형 하나짜리 binary PLY. face는 countType 한 개와 int index 3개이고, 값은 그대로 쓴다.
+template <typename Count>
+static void writeBinaryTriangle(const std::string& path, const char* countType, Count count, const int32_t (&indices)[3])
+{
+	FILE* file = std::fopen(path.c_str(), "wb");
+	std::fprintf(file, "ply\nformat binary_little_endian 1.0\nelement vertex 3\nproperty float x\nproperty float y\nproperty float z\n");
+	std::fprintf(file, "element face 1\nproperty list %s int vertex_indices\nend_header\n", countType);
+	const float positions[9] = { 0, 0, 0, 1, 0, 0, 0, 1, 0 };
+	std::fwrite(positions, sizeof(float), 9, file);
+	std::fwrite(&count, sizeof(Count), 1, file);
+	std::fwrite(indices, sizeof(int32_t), 3, file);
+	std::fclose(file);
+}
+
+// vertex 3개와 face 한 줄짜리 OBJ
+static void writeObjTriangle(const std::string& path, const char* face)
+{
+	FILE* file = std::fopen(path.c_str(), "wb");
+	std::fprintf(file, "v 0 0 0\nv 1 0 0\nv 0 1 0\n%s\n", face);
+	std::fclose(file);
+}
+
+// 음수 index, 음수이거나 너무 긴 list, int32_t를 넘는 OBJ index는 변환하기 전에 거부해야 한다.
+static bool checkMalformed(const std::filesystem::path& directory, ThreadPool& pool)
+{
+	const std::string ply = (directory / "malformed.ply").string();
+	const std::string obj = (directory / "malformed.obj").string();
+	struct Case {
+		const char* name;
+		const std::string& path;
+		void (*write)(const std::string&);
+	};
+	const Case cases[] = {
+		{ "negative ply index", ply, [](const std::string& p) { writeBinaryTriangle<uint8_t>(p, "uchar", 3, { 0, -1, 2 }); } },
+		{ "negative ply list count", ply, [](const std::string& p) { writeBinaryTriangle<double>(p, "double", -1.0, { 0, 1, 2 }); } },
+		{ "huge ply list count", ply, [](const std::string& p) { writeBinaryTriangle<double>(p, "double", 1e19, { 0, 1, 2 }); } },
+		// int32_t로 자르면 3이 되는 index
+		{ "wrapping obj index", obj, [](const std::string& p) { writeObjTriangle(p, "f 1 2 4294967299"); } },
+		{ "huge relative obj index", obj, [](const std::string& p) { writeObjTriangle(p, "f -1 -2 -99999999999999999999"); } },
+		{ "zero obj index", obj, [](const std::string& p) { writeObjTriangle(p, "f 1 2 3 0"); } },
+	};
+	bool ok = true;
+	for (const Case& c : cases) {
+		c.write(c.path);
+		MeshData mesh;
+		if (importMesh(c.path.c_str(), mesh, pool)) {
+			std::printf("%s: accepted\n", c.name);
+			ok = false;
+		}
+	}
+	// 같은 형식의 정상 파일은 읽혀야 한다.
+	writeBinaryTriangle<uint8_t>(ply, "uchar", 3, { 0, 1, 2 });
+	writeObjTriangle(obj, "f 1 2 -1");
+	for (const std::string& path : { ply, obj }) {
+		MeshData mesh;
+		if (!importMesh(path.c_str(), mesh, pool) || mesh.indices != std::vector<uint32_t>{ 0, 1, 2 }) {
+			std::printf("valid triangle %s: rejected\n", path.c_str());
+			ok = false;
+		}
+		std::filesystem::remove(path);
+	}
+	std::printf("malformed indices: %s\n", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "mesh-import-bench";
+	std::filesystem::create_directories(directory);
+	int largest = argc > 1 ? std::atoi(argv[1]) : 1024;
+	if (!checkMalformed(directory, pool)) {
+		return 1;
+	}
+
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%-12s %10s %12s %12s %10s\n", "format", "size(MB)", "triangles", "time(ms)", "MB/s");
+	for (FileKind kind : { FileKind::Obj, FileKind::ObjWithNormals, FileKind::PlyAscii, FileKind::PlyBinary }) {
+		for (int n = 128; n <= largest; n *= 2) {
+			std::string path = (directory / ("grid" + std::to_string(n) + "-" + std::to_string(int(kind)) +
+				(kind == FileKind::PlyAscii || kind == FileKind::PlyBinary ? ".ply" : ".obj"))).string();
+			writeGrid(path, kind, n);
+			double megabytes = double(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+
+			double best = 1e30;
+			MeshData mesh;
+			for (int run = 0; run < 3; ++run) {
+				auto start = std::chrono::steady_clock::now();
+				if (!importMesh(path.c_str(), mesh, pool)) {
+					return 1;
+				}
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+				best = std::min(best, elapsed.count());
+			}
+			std::printf("%-12s %10.2f %12zu %12.2f %10.1f\n", kindName(kind), megabytes,
+					mesh.numberOfTriangles(), best, megabytes / (best / 1000.0));
+			std::filesystem::remove(path);
+		}
+	}
+	return 0;
+}
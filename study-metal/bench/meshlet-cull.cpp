@@ -0,0 +1,91 @@
+/*
+ * meshlet-cull benchmark
+ *
+ * CAD scene처럼 잘게 tessellate 된 부품(구, 원기둥)을 격자로 늘어놓고
+ * meshlet build 시간과, 몇 개의 카메라 위치에서 cluster culling이 없앤 삼각형 비율을 출력한다.
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "BenchUtil.hpp"
+#include "Meshlet.hpp"
+
+// 뚜껑이 있는 원기둥
+static void addCylinder(MeshData& mesh, Float3 center, float r, float h, int n)
+{
+	uint32_t base = uint32_t(mesh.positions.size());
+	for (int ring = 0; ring < 2; ++ring) {
+		for (int j = 0; j < n; ++j) {
+			float phi = 2.0f * float(M_PI) * j / n;
+			mesh.positions.push_back(center + Float3{ r * std::cos(phi), ring ? h * 0.5f : -h * 0.5f, r * std::sin(phi) });
+		}
+	}
+	mesh.positions.push_back(center + Float3{ 0.0f, -h * 0.5f, 0.0f });
+	mesh.positions.push_back(center + Float3{ 0.0f, h * 0.5f, 0.0f });
+	uint32_t bottom = base + 2 * n, top = bottom + 1;
+	for (int j = 0; j < n; ++j) {
+		uint32_t a = base + j, b = base + (j + 1) % n, c = a + n, d = b + n;
+		mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d, bottom, a, b, top, d, c });
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	int parts = argc > 1 ? std::atoi(argv[1]) : 32;
+
+	MeshData mesh;
+	for (int z = 0; z < parts; ++z) {
+		for (int x = 0; x < parts; ++x) {
+			Float3 center = { float(x) * 3.0f, 0.0f, -float(z) * 3.0f };
+			if ((x + z) % 2) {
+				addSphere(mesh, center, 1.0f, 48);
+			} else {
+				addCylinder(mesh, center, 1.0f, 2.0f, 512);
+			}
+		}
+	}
+	std::printf("threads: %u\n", pool.size());
+	std::printf("scene: %zu vertices, %zu triangles\n", mesh.numberOfVertices(), mesh.numberOfTriangles());
+
+	MeshletData meshlets;
+	double best = 1e30;
+	for (int run = 0; run < 3; ++run) {
+		auto start = std::chrono::steady_clock::now();
+		buildMeshlets(mesh, meshlets, pool);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	std::printf("build: %zu meshlets, %.1f vertices / %.1f triangles per meshlet, %.2f ms (%.1f Mtri/s)\n",
+			meshlets.meshlets.size(), double(meshlets.vertices.size()) / meshlets.meshlets.size(),
+			double(meshlets.numberOfTriangles()) / meshlets.meshlets.size(), best, mesh.numberOfTriangles() / (best * 1000.0));
+
+	float extent = parts * 3.0f;
+	struct View { const char* name; Float3 eye; Float3 target; };
+	View views[] = {
+		{ "overview", { extent * 0.5f, extent * 0.6f, extent * 0.4f }, { extent * 0.5f, 0.0f, -extent * 0.5f } },
+		{ "corner", { -3.0f, 2.0f, 3.0f }, { extent * 0.3f, 0.0f, -extent * 0.3f } },
+		{ "close-up", { extent * 0.5f, 1.0f, -extent * 0.5f + 4.0f }, { extent * 0.5f, 0.0f, -extent * 0.5f } },
+	};
+	std::printf("%-10s %10s %10s %10s %12s %10s\n", "view", "frustum%", "backface%", "visible%", "triangles", "cull(ms)");
+	std::vector<uint32_t> indices;
+	for (const View& view : views) {
+		Float4x4 viewProjection = perspective4x4(1.0f, 16.0f / 9.0f, 0.1f, extent * 4.0f) * lookAt4x4(view.eye, view.target, { 0.0f, 1.0f, 0.0f });
+		MeshletCullParams params = meshletCullParamsFor(viewProjection, view.eye);
+		MeshletCullStats stats;
+		double cullBest = 1e30;
+		for (int run = 0; run < 5; ++run) {
+			auto start = std::chrono::steady_clock::now();
+			stats = cullMeshlets(meshlets, params, indices, pool);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			cullBest = std::min(cullBest, elapsed.count());
+		}
+		double total = double(meshlets.meshlets.size());
+		std::printf("%-10s %10.1f %10.1f %10.1f %12zu %10.2f\n", view.name,
+				100.0 * stats.frustumCulledMeshlets / total, 100.0 * stats.backfaceCulledMeshlets / total,
+				100.0 * stats.visibleTriangles / stats.totalTriangles, stats.visibleTriangles, cullBest);
+	}
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * mipmap-generate benchmark
+ *
+ * 1 pixel 흑백 줄무늬, noise가 섞인 gradient, alpha test를 쓰는 나뭇잎 무늬를 담은 sRGB RGBA8 image로 mip chain을 만들고
+ *   time     - level 0을 뺀 모든 level을 만드는 시간 (ms), Mpix/s는 level 0 기준
+ *   PSNR     - level 2를 원본에서 linear 공간 면적 평균으로 바로 줄인 기준 image와 비교한 PSNR (dB)
+ *   bright   - 가장 작은 level의 평균 밝기(linear)가 원본과 얼마나 다른지 (%)
+ *   coverage - alpha >= 0.5인 비율이 level 0과 가장 많이 다른 level의 차이 (%p)
+ * 를 gamma 공간에서 2x2를 평균하는 naive box filter와 비교한다. 2의 거듭제곱이 아닌 크기도 잰다.
+ * thread 하나로 만든 결과와 byte 단위로 같은지도 확인한다.
+ * argv[1]은 image의 한 변이다. (기본 2048)
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "MipmapGenerator.hpp"
+
+static TextureData makeImage(uint32_t width, uint32_t height)
+{
+	TextureData image;
+	image.layout = makeTextureLayout(TextureFormatRGBA8Unorm_sRGB, width, height);
+	image.bytes.resize(size_t(image.layout.totalSize()));
+	std::mt19937 random(11);
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			const float u = float(x) / float(width), v = float(y) / float(height);
+			const int noise = int(random() % 9) - 4;
+			uint8_t* pixel = image.data(0) + (size_t(y) * width + x) * 4;
+			// 왼쪽 절반은 1 pixel 흑백 줄무늬. gamma 공간에서 평균하면 128(linear 0.22)로 어두워진다.
+			pixel[0] = x < width / 2 ? ((x + y) & 1 ? 255 : 0) : uint8_t(std::clamp(int(255.0f * u) + noise, 0, 255));
+			pixel[1] = x < width / 2 ? pixel[0] : uint8_t(std::clamp(int(128.0f + 100.0f * std::sin(u * 31.0f + v * 17.0f)) + noise, 0, 255));
+			pixel[2] = uint8_t(std::clamp(int(255.0f * v) + noise, 0, 255));
+			// 가는 잎맥 무늬. 가장자리는 부드럽게 흐려진다.
+			const float vein = std::fabs(std::sin(u * 160.0f + std::sin(v * 40.0f) * 2.0f));
+			pixel[3] = uint8_t(std::clamp(int((0.45f - vein) * 4.0f * 255.0f + 128.0f), 0, 255));
+		}
+	}
+	return image;
+}
+
+// gamma 공간에서 2x2를 평균한다. 홀수 크기의 마지막 줄은 버린다.
+static void naiveMipmaps(const TextureData& source, TextureData& mipmapped)
+{
+	mipmapped.layout = makeTextureLayout(source.layout.format, source.layout.width, source.layout.height, 0);
+	mipmapped.bytes.assign(size_t(mipmapped.layout.totalSize()), 0);
+	std::memcpy(mipmapped.data(0), source.data(0), size_t(source.layout.subresource(0, 0).size));
+	for (uint32_t level = 1; level < mipmapped.layout.levels; ++level) {
+		const TextureSubresource& src = mipmapped.layout.subresource(level - 1, 0);
+		const TextureSubresource& dst = mipmapped.layout.subresource(level, 0);
+		const uint8_t* in = mipmapped.data(level - 1);
+		uint8_t* out = mipmapped.data(level);
+		for (uint32_t y = 0; y < dst.height; ++y) {
+			for (uint32_t x = 0; x < dst.width; ++x) {
+				const uint32_t x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+				const uint32_t y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+				for (int c = 0; c < 4; ++c) {
+					const int sum = in[(y0 * src.width + x0) * 4 + c] + in[(y0 * src.width + x1) * 4 + c] + in[(y1 * src.width + x0) * 4 + c]
+						+ in[(y1 * src.width + x1) * 4 + c];
+					out[(y * dst.width + x) * 4 + c] = uint8_t((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+// 원본 level 0에서 linear 공간 면적 평균으로 바로 줄인 기준 image (8 bit sRGB)
+static std::vector<uint8_t> referenceLevel(const TextureData& source, uint32_t width, uint32_t height)
+{
+	const uint32_t srcWidth = source.layout.width, srcHeight = source.layout.height;
+	const float* toLinear = MipmapDetail::srgbToLinearTable();
+	const double sx = double(srcWidth) / width, sy = double(srcHeight) / height;
+	std::vector<uint8_t> result(size_t(width) * height * 4);
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			double sums[4] = {}, total = 0.0;
+			for (uint32_t j = uint32_t(y * sy); j < std::min(srcHeight, uint32_t(std::ceil((y + 1) * sy))); ++j) {
+				const double wy = std::min(double(j + 1), (y + 1) * sy) - std::max(double(j), y * sy);
+				for (uint32_t i = uint32_t(x * sx); i < std::min(srcWidth, uint32_t(std::ceil((x + 1) * sx))); ++i) {
+					const double w = wy * (std::min(double(i + 1), (x + 1) * sx) - std::max(double(i), x * sx));
+					const uint8_t* pixel = source.data(0) + (size_t(j) * srcWidth + i) * 4;
+					for (int c = 0; c < 3; ++c) {
+						sums[c] += w * toLinear[pixel[c]];
+					}
+					sums[3] += w * pixel[3] / 255.0;
+					total += w;
+				}
+			}
+			uint8_t* out = result.data() + (size_t(y) * width + x) * 4;
+			for (int c = 0; c < 3; ++c) {
+				out[c] = MipmapDetail::srgbEncoder().encode(float(sums[c] / total));
+			}
+			out[3] = MipmapDetail::encodeUnorm(float(sums[3] / total));
+		}
+	}
+	return result;
+}
+
+static double psnr(const uint8_t* a, const uint8_t* b, size_t bytes)
+{
+	double error = 0.0;
+	for (size_t i = 0; i < bytes; ++i) {
+		error += double(int(a[i]) - int(b[i])) * double(int(a[i]) - int(b[i]));
+	}
+	return error == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 * double(bytes) / error);
+}
+
+static double meanLuminance(const uint8_t* pixels, size_t count)
+{
+	const float* toLinear = MipmapDetail::srgbToLinearTable();
+	double sum = 0.0;
+	for (size_t i = 0; i < count; ++i) {
+		sum += 0.2126 * toLinear[pixels[i * 4]] + 0.7152 * toLinear[pixels[i * 4 + 1]] + 0.0722 * toLinear[pixels[i * 4 + 2]];
+	}
+	return sum / double(count);
+}
+
+static double coverage(const uint8_t* pixels, size_t count)
+{
+	size_t covered = 0;
+	for (size_t i = 0; i < count; ++i) {
+		covered += pixels[i * 4 + 3] >= 128 ? 1 : 0;
+	}
+	return double(covered) / double(count);
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	ThreadPool single(1);
+	const uint32_t size = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 2048;
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%11s %18s %10s %10s %10s %11s %13s %8s\n", "size", "filter", "time(ms)", "Mpix/s", "PSNR(dB)", "bright(%)", "coverage(%p)",
+			"match");
+
+	for (uint32_t width : { size, size - size / 3 + 1 }) {
+		const uint32_t height = width / 2 + 1;
+		const TextureData image = makeImage(width, height);
+		const double megapixels = double(width) * height * 1e-6;
+		const double sourceLuminance = meanLuminance(image.data(0), size_t(width) * height);
+		const double sourceCoverage = coverage(image.data(0), size_t(width) * height);
+		const TextureLayout chain = makeTextureLayout(image.layout.format, width, height, 0);
+		const TextureSubresource& compared = chain.subresource(2, 0);
+		const std::vector<uint8_t> reference = referenceLevel(image, compared.width, compared.height);
+		char sizeName[32];
+		std::snprintf(sizeName, sizeof(sizeName), "%ux%u", width, height);
+
+		struct Method {
+			const char* name;
+			bool naive;
+			MipmapOptions options;
+		};
+		MipmapOptions box, kaiser, kaiserCoverage;
+		box.filter = MipFilterBox;
+		kaiserCoverage.alphaReference = 0.5f;
+		for (const Method& method : { Method{ "naive box", true, {} }, Method{ "box", false, box }, Method{ "kaiser", false, kaiser },
+				 Method{ "kaiser+coverage", false, kaiserCoverage } }) {
+			TextureData mipmapped, check;
+			const double time = bestOf(3, [&] {
+				if (method.naive) {
+					naiveMipmaps(image, mipmapped);
+				} else {
+					generateMipmaps(image, mipmapped, method.options, pool);
+				}
+			});
+			const char* match = "-";
+			if (!method.naive) {
+				generateMipmaps(image, check, method.options, single);
+				match = check.bytes == mipmapped.bytes ? "yes" : "NO";
+			}
+			const uint32_t last = mipmapped.layout.levels - 1;
+			const TextureSubresource& smallest = mipmapped.layout.subresource(last, 0);
+			const double bright = (meanLuminance(mipmapped.data(last), size_t(smallest.width) * smallest.height) / sourceLuminance - 1.0) * 100.0;
+			// 1x1 level은 0 / 100%밖에 없으므로 16x16보다 큰 level만 본다.
+			double coverageError = 0.0;
+			for (uint32_t level = 1; level < mipmapped.layout.levels; ++level) {
+				const TextureSubresource& subresource = mipmapped.layout.subresource(level, 0);
+				if (subresource.width * subresource.height >= 256) {
+					const double error = coverage(mipmapped.data(level), size_t(subresource.width) * subresource.height) - sourceCoverage;
+					coverageError = std::fabs(error) > std::fabs(coverageError) ? error : coverageError;
+				}
+			}
+			std::printf("%11s %18s %10.2f %10.1f %10.2f %11.2f %13.2f %8s\n", sizeName, method.name, time, megapixels / time * 1e3,
+					psnr(mipmapped.data(2), reference.data(), reference.size()), bright, coverageError * 100.0, match);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * occlusion-cull benchmark
+ *
+ * 건물(box)이 늘어선 도시를 길 위에서 바라보고 건물을 occluder로 그린 뒤,
+ * 건물 사이에 흩어진 작은 물체 10만 ~ 100만 개의 AABB를 Hi-Z로 검사한다.
+ * occluder raster / pyramid build / test 시간과 가려진 비율을 출력한다.
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "OcclusionCulling.hpp"
+
+// min ~ max box의 12개 삼각형을 추가한다.
+static void addBox(MeshData& mesh, Float3 min, Float3 max)
+{
+	uint32_t base = uint32_t(mesh.positions.size());
+	for (int corner = 0; corner < 8; ++corner) {
+		mesh.positions.push_back({ corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z });
+	}
+	static const uint32_t faces[6][4] = { { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+	for (const uint32_t* face : faces) {
+		mesh.indices.insert(mesh.indices.end(), { base + face[0], base + face[1], base + face[2], base + face[0], base + face[2], base + face[3] });
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+	// 32 x 32 블록, 블록마다 건물 하나. 길 폭은 4.
+	const int blocks = 32;
+	const float blockSize = 16.0f, street = 4.0f;
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	MeshData city;
+	for (int z = 0; z < blocks; ++z) {
+		for (int x = 0; x < blocks; ++x) {
+			Float3 corner = { x * blockSize, 0.0f, -z * blockSize };
+			float height = 10.0f + 40.0f * unit(random);
+			addBox(city, corner + Float3{ street * 0.5f, 0.0f, -blockSize + street * 0.5f },
+					corner + Float3{ blockSize - street * 0.5f, height, -street * 0.5f });
+		}
+	}
+	BvhTriangleGeometry geometry = triangleGeometryFor(city);
+
+	// 도시 가장자리 길 위에서 대각선 방향으로 바라본다.
+	const float extent = blocks * blockSize;
+	Float3 eye = { -4.0f, 6.0f, 4.0f };
+	Float4x4 view = lookAt4x4(eye, { extent * 0.5f, 2.0f, -extent * 0.5f }, { 0.0f, 1.0f, 0.0f });
+	Float4x4 projection = perspective4x4(1.0f, 16.0f / 9.0f, 0.5f, extent * 2.0f);
+	Float4x4 viewProjection = projection * view;
+
+	std::printf("threads: %u\n", pool.size());
+	std::printf("occluders: %zu triangles\n", city.numberOfTriangles());
+
+	OccluderRasterizer rasterizer(256, 144);
+	double rasterTime = bestOf(5, [&] {
+		rasterizer.clear();
+		rasterizer.rasterize(geometry, viewProjection, pool);
+	});
+	DepthPyramid pyramid;
+	double pyramidTime = bestOf(5, [&] { pyramid.build(rasterizer.depth(), rasterizer.width(), rasterizer.height(), pool); });
+	std::printf("raster %ux%u: %.3f ms (%zu triangles on screen), pyramid: %.3f ms, %u levels\n", rasterizer.width(), rasterizer.height(),
+			rasterTime, rasterizer.numberOfRasterizedTriangles(), pyramidTime, pyramid.numberOfLevels());
+
+	// 이전 frame의 GPU depth를 읽어 온 경우와 같은 full resolution pyramid
+	std::vector<float> fullDepth(size_t(1920) * 1080);
+	for (size_t i = 0; i < fullDepth.size(); ++i) {
+		fullDepth[i] = unit(random);
+	}
+	DepthPyramid fullPyramid;
+	double fullPyramidTime = bestOf(5, [&] { fullPyramid.build(fullDepth.data(), 1920, 1080, pool); });
+	std::printf("pyramid 1920x1080: %.3f ms, %u levels\n", fullPyramidTime, fullPyramid.numberOfLevels());
+
+	std::printf("%10s %10s %12s %10s %10s %10s\n", "objects", "test(ms)", "Mboxes/s", "outside%", "occluded%", "visible%");
+	for (size_t count : { size_t(100000), size_t(250000), size_t(1000000) }) {
+		if (count > largest) {
+			break;
+		}
+		// 길 위에 놓인 0.5 ~ 2 크기의 물체
+		std::vector<Aabb> bounds(count);
+		for (Aabb& box : bounds) {
+			float along = unit(random) * extent, across = unit(random) * street - street * 0.5f;
+			Float3 center = unit(random) < 0.5f ? Float3{ along, 0.0f, -std::round(along / blockSize) * blockSize + across }
+				: Float3{ std::round(along / blockSize) * blockSize + across, 0.0f, -along };
+			float size = 0.5f + 1.5f * unit(random);
+			box = { pack(center - Float3{ size * 0.5f, 0.0f, size * 0.5f }), pack(center + Float3{ size * 0.5f, size, size * 0.5f }) };
+		}
+		std::vector<uint8_t> visible(count);
+		OcclusionStats stats;
+		double testTime = bestOf(3, [&] { stats = testOcclusion(pyramid, viewProjection, bounds.data(), count, visible.data(), pool); });
+		std::printf("%10zu %10.2f %12.1f %10.1f %10.1f %10.1f\n", count, testTime, count / (testTime * 1000.0),
+				100.0 * stats.outside / count, 100.0 * stats.occluded / count, 100.0 * stats.visible / count);
+	}
+	return 0;
+}
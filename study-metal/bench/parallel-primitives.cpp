@@ -0,0 +1,128 @@
+/*
+ * parallel-primitives benchmark
+ *
+ * ParallelPrimitives.hpp(CPU 구현)와 ComputePrimitives.hpp(parallel.metal kernel을 CpuComputeEncoder로 dispatch)를
+ * 크기별로 재고 결과가 bit 단위로 같은지 확인한다. 처리량은 초당 key 수(Mkeys/s)이다.
+ *   scan      - exclusive scan
+ *   compact   - flag가 반인 stream compaction
+ *   histogram - 256 bin
+ *   sort      - 32 bit key radix sort. std::stable_sort와도 비교한다.
+ *   pairs     - key-value radix sort
+ * argv[1]은 가장 큰 원소 수이다. (기본 1600만) 그 1/16, 1/4도 잰다.
+ * */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "ComputePrimitives.hpp"
+#include "ParallelPrimitives.hpp"
+
+static void report(const char* name, size_t count, double reference, double kernels, double sortReference, bool match)
+{
+	char sorted[16] = "-";
+	if (sortReference > 0.0) {
+		std::snprintf(sorted, sizeof(sorted), "%.1f", count / sortReference * 1e-3);
+	}
+	std::printf("%10s %10zu %14.1f %16.1f %14s %8s\n", name, count, count / reference * 1e-3, count / kernels * 1e-3, sorted,
+			match ? "yes" : "NO");
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	const size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16000000;
+	CpuComputeEncoder encoder(pool);
+	ComputePrimitives primitives(encoder);
+	std::mt19937 random(17);
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%10s %10s %14s %16s %14s %8s\n", "primitive", "keys", "cpu(Mkeys/s)", "kernel(Mkeys/s)", "std(Mkeys/s)", "match");
+
+	for (size_t count : { largest / 16, largest / 4, largest }) {
+		std::vector<uint32_t> keys(count), values(count), small(count);
+		std::vector<uint8_t> flags(count);
+		for (size_t i = 0; i < count; ++i) {
+			keys[i] = uint32_t(random());
+			values[i] = uint32_t(i);
+			small[i] = keys[i] & 0xFF;
+			flags[i] = uint8_t(random() & 1);
+		}
+		const int runs = 3;
+
+		// scan
+		{
+			std::vector<uint32_t> reference(count), kernels(count);
+			uint32_t referenceTotal = 0, kernelTotal = 0;
+			double cpu = bestOf(runs, [&] { referenceTotal = exclusiveScan(small.data(), reference.data(), count, pool); });
+			double gpu = bestOf(runs, [&] { kernelTotal = primitives.exclusiveScan(small.data(), kernels.data(), count); });
+			report("scan", count, cpu, gpu, 0.0, reference == kernels && referenceTotal == kernelTotal);
+		}
+
+		// compact
+		{
+			std::vector<uint32_t> reference(count), kernels(count);
+			size_t referenceKept = 0, kernelKept = 0;
+			double cpu = bestOf(runs, [&] { referenceKept = compact(keys.data(), flags.data(), count, reference.data(), pool); });
+			double gpu = bestOf(runs, [&] { kernelKept = primitives.compact(keys.data(), flags.data(), count, kernels.data()); });
+			report("compact", count, cpu, gpu, 0.0,
+					referenceKept == kernelKept && std::equal(reference.begin(), reference.begin() + referenceKept, kernels.begin()));
+		}
+
+		// histogram
+		{
+			std::vector<uint32_t> reference(256), kernels(256);
+			double cpu = bestOf(runs, [&] { histogram(small.data(), count, reference.data(), 256, pool); });
+			double gpu = bestOf(runs, [&] { primitives.histogram(small.data(), count, kernels.data(), 256); });
+			report("histogram", count, cpu, gpu, 0.0, reference == kernels);
+		}
+
+		// sort
+		{
+			std::vector<uint32_t> reference, kernels, sorted;
+			double cpu = bestOf(runs, [&] {
+				reference = keys;
+				radixSort(reference, pool);
+			});
+			double gpu = bestOf(runs, [&] {
+				kernels = keys;
+				primitives.radixSort(kernels);
+			});
+			double standard = bestOf(1, [&] {
+				sorted = keys;
+				std::sort(sorted.begin(), sorted.end());
+			});
+			report("sort", count, cpu, gpu, standard, reference == kernels && reference == sorted);
+		}
+
+		// pairs
+		{
+			std::vector<uint32_t> referenceKeys, referenceValues, kernelKeys, kernelValues;
+			double cpu = bestOf(runs, [&] {
+				referenceKeys = keys;
+				referenceValues = values;
+				radixSortPairs(referenceKeys, referenceValues, pool);
+			});
+			double gpu = bestOf(runs, [&] {
+				kernelKeys = keys;
+				kernelValues = values;
+				primitives.radixSortPairs(kernelKeys, kernelValues);
+			});
+			// 같은 key는 원래 순서(value 오름차순)를 지켜야 한다.
+			std::vector<std::pair<uint32_t, uint32_t>> pairs(count);
+			for (size_t i = 0; i < count; ++i) {
+				pairs[i] = { keys[i], values[i] };
+			}
+			double standard = bestOf(1, [&] {
+				std::stable_sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			});
+			bool stable = true;
+			for (size_t i = 0; i < count && stable; ++i) {
+				stable = pairs[i].first == referenceKeys[i] && pairs[i].second == referenceValues[i];
+			}
+			report("pairs", count, cpu, gpu, standard, referenceKeys == kernelKeys && referenceValues == kernelValues && stable);
+		}
+	}
+	return 0;
+}
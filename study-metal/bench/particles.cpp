@@ -0,0 +1,95 @@
+/*
+ * particles benchmark
+ *
+ * ParticleSystem을 10만 ~ 수백만 개로 채우고 frame당 update(생성 + grid 정렬 + 이웃 힘 + 적분), 깊이 정렬,
+ * instance 쓰기 시간을 잰다. cell 하나에 평균 두 개쯤 들어가도록 채운다.
+ * 같은 frame을 thread 하나로 돌린 결과와 bit 단위로 같은지도 확인한다. (난수와 정렬이 thread 수와 상관없다)
+ * argv[1]은 가장 큰 particle 수이다. (기본 200만)
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "BenchUtil.hpp"
+#include "ParticleSystem.hpp"
+
+static ParticleSystem makeSystem(size_t count, float dt)
+{
+	ParticleSystem system(count);
+	ParticleEmitter emitter;
+	// cell 부피의 반에 하나꼴인 구
+	const float cellSize = system.params.interactionRadius;
+	emitter.radius = cellSize * std::cbrt(3.0f * float(count) / (4.0f * 3.14159265f * 2.0f));
+	emitter.velocity = { 0.0f, 0.0f, 0.0f };
+	emitter.velocityJitter = 0.5f;
+	// 첫 frame에 모두 생기고 bench 동안 죽지 않는다.
+	emitter.rate = float(count) / dt;
+	emitter.lifetime = 100.0f;
+	emitter.lifetimeJitter = 0.0f;
+	system.emitters.push_back(emitter);
+	system.params.floorHeight = -emitter.radius;
+	return system;
+}
+
+static bool sameParticles(const ParticleSystem& a, const ParticleSystem& b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+	const ParticleArrays& p = a.particles();
+	const ParticleArrays& q = b.particles();
+	for (auto lanes : { std::make_pair(&p.x, &q.x), std::make_pair(&p.y, &q.y), std::make_pair(&p.z, &q.z),
+			std::make_pair(&p.velocityX, &q.velocityX), std::make_pair(&p.velocityY, &q.velocityY), std::make_pair(&p.velocityZ, &q.velocityZ) }) {
+		if (std::memcmp(lanes.first->data(), lanes.second->data(), a.size() * sizeof(float)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	ThreadPool single(1);
+	const size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+	const float dt = 1.0f / 60.0f;
+	const int frames = 4;
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%10s %12s %14s %12s %14s %14s %8s\n", "particles", "update(ms)", "Mparticles/s", "sort(ms)", "instances(ms)", "neighbours",
+			"match");
+
+	for (size_t count : { size_t(100000), largest / 2, largest }) {
+		ParticleSystem system = makeSystem(count, dt);
+		ParticleSystem reference = makeSystem(count, dt);
+		ParticleUpdateStats stats;
+		// 첫 frame은 생성이 대부분이라 따로 둔다.
+		system.update(dt, pool);
+		reference.update(dt, single);
+		double update = 0.0;
+		bool match = true;
+		for (int frame = 0; frame < frames; ++frame) {
+			update += bestOf(1, [&] { stats = system.update(dt, pool); });
+			reference.update(dt, single);
+			match = match && sameParticles(system, reference);
+		}
+		update /= frames;
+
+		const Float4x4 viewProjection = perspective4x4(1.0f, 1.0f, 0.1f, 100.0f) * translation4x4({ 0.0f, 0.0f, -4.0f });
+		double sort = bestOf(3, [&] { system.sortForBlending(viewProjection, pool); });
+		std::vector<ParticleInstance> instances(system.size());
+		double write = bestOf(3, [&] { system.writeInstances(instances.data(), pool); });
+		// 정렬된 순서가 정말 먼 것부터인지 본다.
+		for (size_t i = 1; i < instances.size() && match; ++i) {
+			auto depthOf = [&](const ParticleInstance& instance) {
+				Float4 clip = viewProjection * Float4{ instance.position.x, instance.position.y, instance.position.z, 1.0f };
+				return clip.z / clip.w;
+			};
+			match = depthOf(instances[i - 1]) >= depthOf(instances[i]);
+		}
+		std::printf("%10zu %12.2f %14.2f %12.2f %14.2f %14.1f %8s\n", stats.alive, update, stats.alive / update * 1e-3, sort, write,
+				double(stats.neighbourCandidates) / std::max<size_t>(1, stats.alive), match ? "yes" : "NO");
+	}
+	return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * pipeline-cache benchmark
+ *
+ *   bench-pipeline-cache [pipeline 하나의 compile 시간(ms)]
+ * material 조합(vertex layout 3 x function constant 16 x blend 2 = 96가지)이 100 frame마다 16개씩 새로 나타나는 장면을
+ * 600 frame 동안 그린다고 보고 frame마다 2000번 pipeline을 찾는다. pipeline은 참조 계수만 있는 가짜이고 compile은
+ * argv[1] ms(기본 5 ms) 동안 기다린다. Metal은 compile을 다른 process(MTLCompilerService)에서 하므로 CPU를 쓰지 않고 기다린다.
+ * 1. frame 시간
+ *      sync       - 없는 pipeline을 그 자리에서 compile (get)
+ *      background - compile을 pool에 걸고 끝날 때까지 그 draw를 건너뛴다 (find)
+ *      prewarmed  - background 실행이 남긴 manifest로 시작 전에 모두 compile 해 둔다
+ * 2. 모두 compile 된 뒤 찾기 처리량. lock 없는 find와 mutex + unordered_map을 thread 수별로 비교한다.
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "PipelineCache.hpp"
+
+static std::atomic<int64_t> gLivePipelines{0};
+static double gCompileMilliseconds = 5.0;
+
+// MTL::RenderPipelineState 대신 쓰는 참조 계수 객체
+class MockPipeline {
+	public:
+		MockPipeline() { ++gLivePipelines; }
+		~MockPipeline() { --gLivePipelines; }
+		void release()
+		{
+			if (_references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				delete this;
+			}
+		}
+
+	private:
+		std::atomic<int> _references{1};
+};
+
+static MockPipeline* compilePipeline(const PipelineKey&)
+{
+	std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(gCompileMilliseconds));
+	return new MockPipeline();
+}
+
+static const uint32_t kPermutations = 96;
+static const uint32_t kFrames = 600;
+static const uint32_t kDrawsPerFrame = 2000;
+
+// p번째 material 조합
+static PipelineKey makeKey(uint32_t p)
+{
+	PipelineKey key;
+	key.vertexFunction = "sceneVertexMain";
+	key.fragmentFunction = "sceneFragmentMain";
+	const uint32_t layout = p % 3, features = p / 3 % 16, blend = p / 48;
+	// position, normal, texcoord + joints / weights
+	key.setAttribute(0, 30, 0, 0);
+	key.setLayout(0, 12);
+	if (layout >= 1) {
+		key.setAttribute(1, 30, 0, 1);
+		key.setLayout(1, 12);
+	}
+	if (layout >= 2) {
+		key.setAttribute(2, 29, 0, 2);
+		key.setAttribute(3, 31, 8, 2);
+		key.setLayout(2, 24);
+	}
+	// vertex color, texture, fog, skinning
+	for (uint32_t i = 0; i < 4; ++i) {
+		key.setConstant(i, bool(features >> i & 1));
+	}
+	PipelineColorAttachment& color = key.colorAttachment(0);
+	color.pixelFormat = 81;
+	if (blend) {
+		color.blendingEnabled = 1;
+		color.sourceRGBBlendFactor = 4;
+		color.destinationRGBBlendFactor = color.destinationAlphaBlendFactor = 5;
+	}
+	key.depthPixelFormat = 252;
+	return key;
+}
+
+struct FrameStats {
+	double worst{0.0};
+	double total{0.0};
+	uint32_t slowFrames{0};
+	uint64_t skippedDraws{0};
+};
+
+// frame f에는 (f / 100 + 1) * 16개의 조합이 보인다.
+template <typename Lookup>
+static FrameStats runFrames(const std::vector<PipelineKey>& keys, Lookup lookup)
+{
+	FrameStats stats;
+	for (uint32_t frame = 0; frame < kFrames; ++frame) {
+		const uint32_t visible = std::min(kPermutations, (frame / 100 + 1) * 16);
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t draw = 0; draw < kDrawsPerFrame; ++draw) {
+			stats.skippedDraws += lookup(keys[(draw * 2654435761u + frame) % visible]) ? 0 : 1;
+		}
+		const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats.worst = std::max(stats.worst, elapsed);
+		stats.total += elapsed;
+		stats.slowFrames += elapsed > 1000.0 / 60.0 ? 1 : 0;
+	}
+	return stats;
+}
+
+static void printFrames(const char* mode, const FrameStats& frames, const PipelineCacheStats& cache, double startup)
+{
+	std::printf("%12s %12.2f %12.3f %10u %10llu %10llu %12.1f\n", mode, frames.worst, frames.total / kFrames, frames.slowFrames,
+			(unsigned long long)frames.skippedDraws, (unsigned long long)cache.compilations, startup);
+}
+
+int main(int argc, char* argv[])
+{
+	gCompileMilliseconds = argc > 1 ? std::atof(argv[1]) : gCompileMilliseconds;
+	// 기계의 core 수와 상관없이 compile을 기다리는 thread 4개
+	ThreadPool compilePool(5);
+	std::vector<PipelineKey> keys;
+	for (uint32_t p = 0; p < kPermutations; ++p) {
+		keys.push_back(makeKey(p));
+	}
+	const char* manifestPath = "/tmp/bench-pipeline-cache.lmpc";
+	std::printf("compile: %.1f ms, %u permutations, %u frames x %u draws\n", gCompileMilliseconds, kPermutations, kFrames, kDrawsPerFrame);
+
+	// 1. frame 시간
+	std::printf("%12s %12s %12s %10s %10s %10s %12s\n", "mode", "worst(ms)", "average(ms)", ">16.7ms", "skipped", "compiled", "startup(ms)");
+	{
+		PipelineCache<MockPipeline> cache(compilePipeline, compilePool);
+		const FrameStats frames = runFrames(keys, [&](const PipelineKey& key) { return cache.get(key); });
+		printFrames("sync", frames, cache.stats(), 0.0);
+	}
+	{
+		PipelineCache<MockPipeline> cache(compilePipeline, compilePool);
+		const FrameStats frames = runFrames(keys, [&](const PipelineKey& key) { return cache.find(key); });
+		cache.wait();
+		printFrames("background", frames, cache.stats(), 0.0);
+		cache.saveManifest(manifestPath);
+	}
+	std::vector<PipelineKey> manifest;
+	{
+		PipelineCache<MockPipeline> cache(compilePipeline, compilePool);
+		auto start = std::chrono::steady_clock::now();
+		if (!loadPipelineManifest(manifestPath, manifest)) {
+			return 1;
+		}
+		cache.prewarm(manifest);
+		cache.wait();
+		const double startup = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		const FrameStats frames = runFrames(keys, [&](const PipelineKey& key) { return cache.find(key); });
+		printFrames("prewarmed", frames, cache.stats(), startup);
+	}
+	// manifest의 key가 원래 key와 byte 단위로 같은지
+	size_t matched = 0;
+	std::vector<uint8_t> a, b;
+	for (const PipelineKey& key : manifest) {
+		key.serialize(a);
+		for (const PipelineKey& original : keys) {
+			original.serialize(b);
+			matched += a == b ? 1 : 0;
+		}
+	}
+	std::printf("manifest: %zu keys, %zu match\n", manifest.size(), matched);
+
+	// 2. 찾기 처리량
+	PipelineCache<MockPipeline> cache(compilePipeline, compilePool);
+	cache.prewarm(keys);
+	cache.wait();
+	std::unordered_map<std::string, MockPipeline*> map;
+	std::mutex mapMutex;
+	for (const PipelineKey& key : keys) {
+		key.serialize(a);
+		map.emplace(std::string(a.begin(), a.end()), cache.find(key));
+	}
+	const size_t lookupsPerThread = 200000;
+	std::printf("\n%8s %16s %16s\n", "threads", "find/ms", "mutex map/ms");
+	for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+		auto measure = [&](auto lookup) {
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> workers;
+			for (unsigned t = 0; t < threads; ++t) {
+				workers.emplace_back([&, t] {
+					for (size_t i = 0; i < lookupsPerThread; ++i) {
+						if (!lookup(keys[(i * 7 + t) % keys.size()])) {
+							std::abort();
+						}
+					}
+				});
+			}
+			for (std::thread& worker : workers) {
+				worker.join();
+			}
+			const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return double(lookupsPerThread * threads) / elapsed;
+		};
+		const double lockFree = measure([&](const PipelineKey& key) { return cache.find(key); });
+		const double locked = measure([&](const PipelineKey& key) {
+			// find와 같이 key를 byte 열로 만들어 찾는다.
+			thread_local std::vector<uint8_t> bytes;
+			key.serialize(bytes);
+			std::lock_guard<std::mutex> lock(mapMutex);
+			return map.find(std::string(bytes.begin(), bytes.end()))->second;
+		});
+		std::printf("%8u %16.0f %16.0f\n", threads, lockFree, locked);
+	}
+	cache.clear();
+	std::printf("\nlive pipelines after clear: %lld\n", (long long)gLivePipelines.load());
+	return gLivePipelines.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+/*
+ * render-queue benchmark
+ *
+ * pipeline 64종, vertex buffer 묶음 4096개를 쓰는 draw 1만 ~ 100만 개를 무작위 순서로 넣고
+ * sort key의 radix sort 시간(std::stable_sort와 비교)과, 정렬 전후 encoder에 실제로 가는 state 변경 수를 출력한다.
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "FilteringEncoder.hpp"
+#include "RecordingEncoder.hpp"
+#include "RenderQueue.hpp"
+
+struct Draw {
+	uint32_t pipeline;
+	uint32_t buffers;
+	float depth;
+};
+
+struct StateChanges {
+	size_t pipelines;
+	size_t bufferBinds;
+};
+
+// draw 하나는 pipeline 하나와 vertex buffer 두 개(위치, 속성)를 묶는다. 같은 state는 encoder까지 가지 않는다.
+static StateChanges encode(const std::vector<Draw>& draws, const std::vector<RenderQueueItem>& order)
+{
+	RecordingEncoder recorder;
+	FilteringRenderEncoder<RecordingEncoder> encoder(&recorder);
+	for (const RenderQueueItem& item : order) {
+		const Draw& draw = draws[item.draw];
+		const void* buffer = reinterpret_cast<const void*>(uintptr_t(draw.buffers + 1));
+		encoder.setRenderPipelineState(reinterpret_cast<const void*>(uintptr_t(draw.pipeline + 1)));
+		encoder.setVertexBuffer(buffer, 0, 0);
+		encoder.setVertexBuffer(buffer, 256, 1);
+		encoder.drawPrimitives(3u, 0u, 36u, 1u);
+	}
+	return { recorder.numberOfCalls(EncoderCallType::SetRenderPipelineState),
+		recorder.numberOfCalls(EncoderCallType::SetVertexBuffer) + recorder.numberOfCalls(EncoderCallType::SetVertexBufferOffset) };
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%10s %10s %12s %14s %14s %14s %14s\n", "draws", "radix(ms)", "stable(ms)", "pipelines", "sorted", "buffer binds", "sorted");
+	for (size_t count : { size_t(10000), size_t(100000), size_t(1000000) }) {
+		if (count > largest) {
+			break;
+		}
+		std::mt19937 random(17);
+		std::uniform_real_distribution<float> depth(0.1f, 1000.0f);
+		std::vector<Draw> draws(count);
+		RenderQueue queue;
+		queue.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			draws[i] = { uint32_t(random() % 64), uint32_t(random() % 4096), depth(random) };
+			queue.push(renderSortKey(draws[i].pipeline, draws[i].buffers, draws[i].depth), i);
+		}
+		std::vector<RenderQueueItem> unsorted = queue.items();
+
+		double radix = bestOf(3, [&] {
+			queue.clear();
+			for (const RenderQueueItem& item : unsorted) {
+				queue.push(item.key, item.draw);
+			}
+			queue.sort(pool);
+		});
+		std::vector<RenderQueueItem> reference = unsorted;
+		double stable = bestOf(3, [&] {
+			reference = unsorted;
+			std::stable_sort(reference.begin(), reference.end(), [](const RenderQueueItem& a, const RenderQueueItem& b) { return a.key < b.key; });
+		});
+		for (size_t i = 0; i < count; ++i) {
+			if (reference[i].draw != queue.items()[i].draw) {
+				std::printf("mismatch at %zu\n", i);
+				break;
+			}
+		}
+
+		StateChanges before = encode(draws, unsorted);
+		StateChanges after = encode(draws, queue.items());
+		std::printf("%10zu %10.2f %12.2f %14zu %14zu %14zu %14zu\n", count, radix, stable,
+				before.pipelines, after.pipelines, before.bufferBinds, after.bufferBinds);
+	}
+	return 0;
+}
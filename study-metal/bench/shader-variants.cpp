@@ -0,0 +1,361 @@
+/*
+ * shader-variants benchmark
+ *
+ *   bench-shader-variants [vertex 수]
+ * shader.metal의 sceneVertexMain / sceneFragmentMain을 CpuComputeEncoder kernel로 옮겨 같은 입력을 두 가지로 그린다.
+ *   uber        - 기능을 uniform(features)으로 받아 thread마다 가른다. attribute는 기능과 상관없이 모두 읽는다. (stage_in)
+ *   specialized - 기능이 template 인자(function constant)라서 꺼진 기능의 attribute 읽기와 계산이 compile 할 때 지워진다.
+ * fragment는 rasterizer 대신 triangle 하나와 barycentric 좌표를 골라 varying을 보간하고, 256x256 texture를 bilinear로 읽는다.
+ * 1. 16가지 variant마다 vertex / fragment 단계 시간과 두 결과가 같은지
+ * 2. attribute 조합이 다른 mesh 8개로 된 장면. enumerateShaderVariants가 고른 variant만 draw 수만큼 그린다.
+ * */
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+
+#include "BenchUtil.hpp"
+#include "ComputeDispatch.hpp"
+#include "ShaderVariants.hpp"
+
+// glTF accessor마다 따로 있는 vertex buffer
+struct SceneVertices {
+	std::vector<Float3> positions;
+	std::vector<Float4> colors;
+	std::vector<Float3> normals;
+	std::vector<Float2> texcoords;
+	std::vector<std::array<uint8_t, 4>> joints;
+	std::vector<Float4> weights;
+};
+
+struct SceneUniforms {
+	Float4x4 viewProjection;
+	Float4x4 model;
+	Float4 instanceColor;
+	Float4 fogColor;
+	float fogStart;
+	float fogEnd;
+	// uber shader가 thread마다 읽는 기능 bit
+	uint32_t features;
+};
+
+struct SceneTexture {
+	static constexpr uint32_t kSize = 256;
+	std::vector<Float4> texels;
+};
+
+// SceneVertexOut
+struct SceneVaryings {
+	Float4 position;
+	Float4 color;
+	Float2 texcoord;
+};
+
+// Features가 kUberShader이면 uber shader이다.
+static const uint32_t kUberShader = ~0u;
+
+template <uint32_t Features>
+struct SceneKernel {
+	const SceneVertices* vertices;
+	const Float4x4* jointMatrices;
+	const SceneTexture* texture;
+	const SceneUniforms* uniforms;
+
+	// function constant. uber shader는 uniform을 읽는다.
+	bool has(uint32_t feature) const { return ((Features == kUberShader ? uniforms->features : Features) & feature) != 0; }
+	// stage_in이 읽는 attribute. uber shader는 꺼진 기능의 attribute도 기본값 buffer에서 읽는다.
+	bool fetches(uint32_t feature) const { return Features == kUberShader || (Features & feature) != 0; }
+};
+
+template <uint32_t Features>
+struct SceneVertexKernel : SceneKernel<Features> {
+	SceneVaryings* out;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		const uint32_t i = thread.positionInGrid.x;
+		const SceneVertices& in = *this->vertices;
+		const SceneUniforms& uniforms = *this->uniforms;
+		Float4 color{ 0.8f, 0.8f, 0.8f, 1.0f };
+		Float2 texcoord{ 0.0f, 0.0f };
+		std::array<uint8_t, 4> joints{};
+		Float4 weights{};
+		if (this->fetches(ShaderFeatureVertexColor)) {
+			color = in.colors[i];
+		}
+		if (this->fetches(ShaderFeatureTexture)) {
+			texcoord = in.texcoords[i];
+		}
+		if (this->fetches(ShaderFeatureSkinning)) {
+			joints = in.joints[i];
+			weights = in.weights[i];
+		}
+
+		Float4 position{ in.positions[i].x, in.positions[i].y, in.positions[i].z, 1.0f };
+		Float4 normal{ in.normals[i].x, in.normals[i].y, in.normals[i].z, 0.0f };
+		if (this->has(ShaderFeatureSkinning)) {
+			Float4 skinnedPosition{}, skinnedNormal{};
+			const float weight[4] = { weights.x, weights.y, weights.z, weights.w };
+			for (int j = 0; j < 4; ++j) {
+				const Float4 p = this->jointMatrices[joints[j]] * position, n = this->jointMatrices[joints[j]] * normal;
+				skinnedPosition = { skinnedPosition.x + weight[j] * p.x, skinnedPosition.y + weight[j] * p.y,
+					skinnedPosition.z + weight[j] * p.z, skinnedPosition.w + weight[j] * p.w };
+				skinnedNormal = { skinnedNormal.x + weight[j] * n.x, skinnedNormal.y + weight[j] * n.y, skinnedNormal.z + weight[j] * n.z, 0.0f };
+			}
+			position = skinnedPosition;
+			normal = skinnedNormal;
+		}
+		const Float4x4 modelViewProjection = uniforms.viewProjection * uniforms.model;
+		SceneVaryings& varyings = out[i];
+		varyings.position = modelViewProjection * position;
+		const Float4 n = modelViewProjection * normal;
+		const float lengthOfNormal = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+		const float shade = 0.3f + 0.7f * (lengthOfNormal > 0.0f ? std::fabs(n.z) / lengthOfNormal : 0.0f);
+		if (!this->has(ShaderFeatureVertexColor)) {
+			color = { 0.8f, 0.8f, 0.8f, 1.0f };
+		}
+		const Float4& tint = uniforms.instanceColor;
+		varyings.color = { color.x * tint.x * shade, color.y * tint.y * shade, color.z * tint.z * shade, color.w * tint.w };
+		varyings.texcoord = this->has(ShaderFeatureTexture) ? texcoord : Float2{ 0.0f, 0.0f };
+	}
+};
+
+template <uint32_t Features>
+struct SceneFragmentKernel : SceneKernel<Features> {
+	const SceneVaryings* varyings;
+	uint32_t triangleCount;
+	Float4* out;
+
+	// repeat, linear filter
+	Float4 sample(Float2 uv) const
+	{
+		const uint32_t size = SceneTexture::kSize;
+		const float x = (uv.x - std::floor(uv.x)) * size - 0.5f, y = (uv.y - std::floor(uv.y)) * size - 0.5f;
+		const float fx = std::floor(x), fy = std::floor(y);
+		const uint32_t x0 = uint32_t(int32_t(fx) + int32_t(size)) % size, y0 = uint32_t(int32_t(fy) + int32_t(size)) % size;
+		const uint32_t x1 = (x0 + 1) % size, y1 = (y0 + 1) % size;
+		const float tx = x - fx, ty = y - fy;
+		const Float4* t = this->texture->texels.data();
+		const Float4 a = t[y0 * size + x0], b = t[y0 * size + x1], c = t[y1 * size + x0], d = t[y1 * size + x1];
+		auto lerp = [](float p, float q, float s) { return p + (q - p) * s; };
+		return { lerp(lerp(a.x, b.x, tx), lerp(c.x, d.x, tx), ty), lerp(lerp(a.y, b.y, tx), lerp(c.y, d.y, tx), ty),
+			lerp(lerp(a.z, b.z, tx), lerp(c.z, d.z, tx), ty), lerp(lerp(a.w, b.w, tx), lerp(c.w, d.w, tx), ty) };
+	}
+
+	void operator()(const ComputeThread& thread) const
+	{
+		const uint32_t i = thread.positionInGrid.x;
+		// 화면의 fragment 대신 triangle 하나 안의 한 점
+		const uint32_t hash = i * 2654435761u;
+		const SceneVaryings* v = varyings + size_t(i % triangleCount) * 3;
+		float u = float(hash >> 24) / 256.0f, w = float(hash >> 16 & 0xFF) / 256.0f;
+		if (u + w > 1.0f) {
+			u = 1.0f - u;
+			w = 1.0f - w;
+		}
+		const float b[3] = { 1.0f - u - w, u, w };
+		Float4 color{}, position{};
+		Float2 texcoord{};
+		for (int k = 0; k < 3; ++k) {
+			color = { color.x + b[k] * v[k].color.x, color.y + b[k] * v[k].color.y, color.z + b[k] * v[k].color.z, color.w + b[k] * v[k].color.w };
+			position = { 0.0f, 0.0f, position.z + b[k] * v[k].position.z, position.w + b[k] * v[k].position.w };
+			texcoord = { texcoord.x + b[k] * v[k].texcoord.x, texcoord.y + b[k] * v[k].texcoord.y };
+		}
+		if (this->has(ShaderFeatureTexture)) {
+			const Float4 texel = sample(texcoord);
+			color = { color.x * texel.x, color.y * texel.y, color.z * texel.z, color.w * texel.w };
+		}
+		if (this->has(ShaderFeatureFog)) {
+			const SceneUniforms& uniforms = *this->uniforms;
+			const float depth = position.w != 0.0f ? position.z / position.w : 0.0f;
+			const float amount = std::min(std::max((depth - uniforms.fogStart) / (uniforms.fogEnd - uniforms.fogStart), 0.0f), 1.0f);
+			color = { color.x + (uniforms.fogColor.x - color.x) * amount, color.y + (uniforms.fogColor.y - color.y) * amount,
+				color.z + (uniforms.fogColor.z - color.z) * amount, color.w };
+		}
+		out[i] = color;
+	}
+};
+
+struct SceneData {
+	SceneVertices vertices;
+	std::vector<Float4x4> jointMatrices;
+	SceneTexture texture;
+	SceneUniforms uniforms;
+	std::vector<SceneVaryings> varyings;
+	std::vector<Float4> fragments;
+};
+
+static SceneData makeSceneData(uint32_t vertexCount)
+{
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f), signedUnit(-1.0f, 1.0f);
+	SceneData data;
+	SceneVertices& v = data.vertices;
+	for (uint32_t i = 0; i < vertexCount; ++i) {
+		v.positions.push_back({ signedUnit(random), signedUnit(random), signedUnit(random) });
+		v.colors.push_back({ unit(random), unit(random), unit(random), 1.0f });
+		v.normals.push_back(normalize(Float3{ signedUnit(random), signedUnit(random), signedUnit(random) + 2.0f }));
+		v.texcoords.push_back({ unit(random) * 4.0f, unit(random) * 4.0f });
+		const float a = unit(random), b = unit(random) * (1.0f - a);
+		v.joints.push_back({ uint8_t(random() % 32), uint8_t(random() % 32), uint8_t(random() % 32), uint8_t(random() % 32) });
+		v.weights.push_back({ a, b, 1.0f - a - b, 0.0f });
+	}
+	for (uint32_t j = 0; j < 32; ++j) {
+		const float angle = float(j) * 0.1f;
+		data.jointMatrices.push_back(translation4x4({ 0.0f, float(j) * 0.01f, 0.0f }) *
+				rotation4x4({ 0.0f, std::sin(angle * 0.5f), 0.0f, std::cos(angle * 0.5f) }));
+	}
+	for (uint32_t i = 0; i < SceneTexture::kSize * SceneTexture::kSize; ++i) {
+		data.texture.texels.push_back({ unit(random), unit(random), unit(random), 1.0f });
+	}
+	SceneUniforms& uniforms = data.uniforms;
+	uniforms.viewProjection = perspective4x4(1.0f, 16.0f / 9.0f, 0.1f, 20.0f) * lookAt4x4({ 0.0f, 1.0f, 4.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+	uniforms.model = identity4x4();
+	uniforms.instanceColor = { 1.0f, 0.9f, 0.8f, 1.0f };
+	uniforms.fogColor = { 0.5f, 0.6f, 0.7f, 1.0f };
+	uniforms.fogStart = 0.9f;
+	uniforms.fogEnd = 1.0f;
+	uniforms.features = 0;
+	data.varyings.resize(vertexCount);
+	data.fragments.resize(size_t(vertexCount) * 2);
+	return data;
+}
+
+// vertexCount개 vertex와 그 2배의 fragment를 그린다. 결과는 data.varyings / data.fragments에 남는다.
+template <uint32_t Features>
+static void drawScene(CpuComputeEncoder& encoder, SceneData& data, uint32_t vertexCount, double* vertexMs, double* fragmentMs)
+{
+	const SceneKernel<Features> base{ &data.vertices, data.jointMatrices.data(), &data.texture, &data.uniforms };
+	SceneVertexKernel<Features> vertexKernel{ base, data.varyings.data() };
+	SceneFragmentKernel<Features> fragmentKernel{ base, data.varyings.data(), vertexCount / 3, data.fragments.data() };
+	auto start = std::chrono::steady_clock::now();
+	encoder.dispatchThreads(vertexKernel, { vertexCount, 1, 1 }, { 64, 1, 1 });
+	auto middle = std::chrono::steady_clock::now();
+	encoder.dispatchThreads(fragmentKernel, { vertexCount * 2, 1, 1 }, { 64, 1, 1 });
+	auto end = std::chrono::steady_clock::now();
+	*vertexMs += std::chrono::duration<double, std::milli>(middle - start).count();
+	*fragmentMs += std::chrono::duration<double, std::milli>(end - middle).count();
+}
+
+using DrawFunction = void (*)(CpuComputeEncoder&, SceneData&, uint32_t, double*, double*);
+
+template <uint32_t... Features>
+static std::array<DrawFunction, sizeof...(Features)> specializedDraws(std::integer_sequence<uint32_t, Features...>)
+{
+	return { { drawScene<Features>... } };
+}
+
+// 두 결과의 가장 큰 차이
+static float maxDifference(const std::vector<Float4>& a, const std::vector<Float4>& b)
+{
+	float difference = 0.0f;
+	for (size_t i = 0; i < a.size(); ++i) {
+		difference = std::max({ difference, std::fabs(a[i].x - b[i].x), std::fabs(a[i].y - b[i].y), std::fabs(a[i].z - b[i].z),
+			std::fabs(a[i].w - b[i].w) });
+	}
+	return difference;
+}
+
+// mesh마다 primitive 하나. attribute가 있는지만 본다.
+static GltfScene makeGltfScene()
+{
+	struct MeshInfo {
+		bool color, texcoord, skinned;
+		uint32_t draws;
+	};
+	const MeshInfo meshes[] = {
+		{ false, true, false, 40 }, { false, true, false, 25 }, { true, true, false, 10 }, { true, false, false, 6 },
+		{ false, false, false, 4 }, { false, true, true, 3 }, { true, true, true, 1 }, { true, false, true, 0 },
+	};
+	GltfScene scene;
+	for (uint32_t m = 0; m < std::size(meshes); ++m) {
+		GltfPrimitive primitive;
+		primitive.accessors[GltfAttributeSlotPosition] = 0;
+		primitive.accessors[GltfAttributeSlotColor] = meshes[m].color ? 0 : -1;
+		primitive.accessors[GltfAttributeSlotTexcoord] = meshes[m].texcoord ? 0 : -1;
+		primitive.skinned = meshes[m].skinned;
+		scene.meshes.push_back({ "mesh" + std::to_string(m), { primitive } });
+		for (uint32_t d = 0; d < meshes[m].draws; ++d) {
+			scene.draws.push_back({ m, identity4x4() });
+		}
+	}
+	return scene;
+}
+
+int main(int argc, char* argv[])
+{
+	const uint32_t vertexCount = (argc > 1 ? uint32_t(std::atoi(argv[1])) : 1u << 18) / 3 * 3;
+	if (vertexCount == 0) {
+		std::fprintf(stderr, "usage: %s [vertex count]\n", argv[0]);
+		return 1;
+	}
+	const std::array<DrawFunction, kShaderVariantCount> specialized = specializedDraws(std::make_integer_sequence<uint32_t, kShaderVariantCount>());
+	CpuComputeEncoder encoder;
+	SceneData data = makeSceneData(vertexCount);
+	std::printf("%u vertices, %u fragments per draw, %u threads\n", vertexCount, vertexCount * 2, ThreadPool::shared().size());
+
+	// 1. variant마다
+	std::printf("%-26s %11s %11s %13s %13s %9s %11s\n", "variant", "uber vs(ms)", "spec vs(ms)", "uber fs(ms)", "spec fs(ms)",
+			"speedup", "difference");
+	double uberTotal = 0.0, specializedTotal = 0.0;
+	float worstDifference = 0.0f;
+	for (uint32_t features = 0; features < kShaderVariantCount; ++features) {
+		data.uniforms.features = features;
+		double uberVertex = 1e30, uberFragment = 1e30, specializedVertex = 1e30, specializedFragment = 1e30;
+		std::vector<Float4> uberFragments;
+		for (int run = 0; run < 5; ++run) {
+			double vertexMs = 0.0, fragmentMs = 0.0;
+			drawScene<kUberShader>(encoder, data, vertexCount, &vertexMs, &fragmentMs);
+			uberVertex = std::min(uberVertex, vertexMs);
+			uberFragment = std::min(uberFragment, fragmentMs);
+		}
+		uberFragments = data.fragments;
+		for (int run = 0; run < 5; ++run) {
+			double vertexMs = 0.0, fragmentMs = 0.0;
+			specialized[features](encoder, data, vertexCount, &vertexMs, &fragmentMs);
+			specializedVertex = std::min(specializedVertex, vertexMs);
+			specializedFragment = std::min(specializedFragment, fragmentMs);
+		}
+		const float difference = maxDifference(uberFragments, data.fragments);
+		worstDifference = std::max(worstDifference, difference);
+		uberTotal += uberVertex + uberFragment;
+		specializedTotal += specializedVertex + specializedFragment;
+		std::printf("%-26s %11.2f %11.2f %13.2f %13.2f %8.2fx %11g\n", shaderVariantName(features).c_str(), uberVertex, specializedVertex,
+				uberFragment, specializedFragment, (uberVertex + uberFragment) / (specializedVertex + specializedFragment), difference);
+	}
+	std::printf("%-26s %24.2f %27.2f %8.2fx\n", "all variants (uber/spec)", uberTotal, specializedTotal, uberTotal / specializedTotal);
+
+	// 2. 장면. draw 하나는 vertex 1/16을 그린다.
+	const GltfScene scene = makeGltfScene();
+	ShaderVariantOptions options;
+	options.texture = options.fog = options.skinning = true;
+	const std::vector<ShaderVariantUsage> variants = enumerateShaderVariants(scene, options);
+	std::printf("\nscene: %zu meshes, %zu draws -> %zu of %u variants\n", scene.meshes.size(), scene.draws.size(), variants.size(), kShaderVariantCount);
+	const uint32_t drawVertices = std::max(3u, vertexCount / 16 / 3 * 3);
+	std::printf("%-26s %12s %10s %12s %12s\n", "variant", "primitives", "draws", "uber(ms)", "spec(ms)");
+	double uberScene = 0.0, specializedScene = 0.0;
+	for (const ShaderVariantUsage& variant : variants) {
+		data.uniforms.features = variant.features;
+		const double uber = bestOf(3, [&] {
+			double vertexMs = 0.0, fragmentMs = 0.0;
+			for (uint32_t d = 0; d < variant.draws; ++d) {
+				drawScene<kUberShader>(encoder, data, drawVertices, &vertexMs, &fragmentMs);
+			}
+		});
+		const double spec = bestOf(3, [&] {
+			double vertexMs = 0.0, fragmentMs = 0.0;
+			for (uint32_t d = 0; d < variant.draws; ++d) {
+				specialized[variant.features](encoder, data, drawVertices, &vertexMs, &fragmentMs);
+			}
+		});
+		uberScene += uber;
+		specializedScene += spec;
+		std::printf("%-26s %12u %10u %12.2f %12.2f\n", shaderVariantName(variant.features).c_str(), variant.primitives, variant.draws, uber, spec);
+	}
+	std::printf("%-26s %23s %12.2f %12.2f (%.2fx)\n", "frame", "", uberScene, specializedScene, uberScene / specializedScene);
+	std::printf("\nworst difference: %g\n", worstDifference);
+	return worstDifference == 0.0f ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+/*
+ * simplify benchmark
+ *
+ * 크기가 다른 높이맵 grid로 LOD chain을 만들고
+ * 초당 없앤 삼각형 수와 LOD마다 남은 삼각형 / 오차를 출력한다.
+ * 같은 높이맵을 UV chart 8x8개로 나눠 seam을 넣은 mesh도 seam이 없는 mesh만큼 줄어드는지 확인한다.
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+
+#include "Simplifier.hpp"
+
+// n x n vertex 높이맵. normal과 color가 있어서 attribute 비용도 함께 계산된다.
+static void makeTerrain(MeshData& mesh, int n)
+{
+	mesh = MeshData();
+	for (int y = 0; y < n; ++y) {
+		for (int x = 0; x < n; ++x) {
+			float h = 0.08f * std::sin(x * 9.0f / n) * std::cos(y * 7.0f / n) + 0.01f * std::sin(x * 61.0f / n + y * 47.0f / n);
+			mesh.positions.push_back({ float(x) / n, float(y) / n, h });
+		}
+	}
+	for (int y = 0; y + 1 < n; ++y) {
+		for (int x = 0; x + 1 < n; ++x) {
+			uint32_t a = y * n + x, b = a + 1, c = a + n, d = c + 1;
+			mesh.indices.insert(mesh.indices.end(), { a, b, c, b, d, c });
+		}
+	}
+	mesh.computeColorsFromNormals();
+}
+
+/*
+ * makeTerrain을 chart x chart개의 UV chart로 나눈다. chart 경계의 vertex는 chart마다 따로 있고 texcoord만 다르다.
+ * 그래서 chart 경계는 모두 seam이고 seam끼리 만나는 점은 seam corner이다.
+ * */
+static void makeSeamedTerrain(MeshData& mesh, int n, int charts)
+{
+	MeshData terrain;
+	makeTerrain(terrain, n);
+	mesh = MeshData();
+	const int cells = (n - 1 + charts - 1) / charts;
+	std::unordered_map<uint64_t, uint32_t> vertices;
+	auto vertexFor = [&](uint32_t v, int chart) {
+		const uint64_t key = uint64_t(v) * uint64_t(charts * charts) + uint64_t(chart);
+		auto inserted = vertices.emplace(key, uint32_t(mesh.positions.size()));
+		if (inserted.second) {
+			mesh.positions.push_back(terrain.positions[v]);
+			mesh.normals.push_back(terrain.normals[v]);
+			mesh.colors.push_back(terrain.colors[v]);
+			// chart마다 atlas의 다른 자리를 쓴다.
+			mesh.texcoords.push_back({ terrain.positions[v].x + float(chart % charts), terrain.positions[v].y + float(chart / charts) });
+		}
+		return inserted.first->second;
+	};
+	for (size_t i = 0; i < terrain.indices.size(); i += 6) {
+		// 사각형의 첫 vertex가 속한 cell로 chart를 정한다.
+		const uint32_t first = terrain.indices[i];
+		const int chart = int(first / n) / cells * charts + int(first % n) / cells;
+		for (size_t k = 0; k < 6; ++k) {
+			mesh.indices.push_back(vertexFor(terrain.indices[i + k], chart));
+		}
+	}
+}
+
+/*
+ * 위치가 같은 vertex를 하나로 보고 삼각형 하나에만 있는 edge를 센다. seam이 벌어지지 않았으면 grid 바깥 경계에만 있다.
+ * */
+static size_t countCracks(const MeshData& mesh, const std::vector<uint32_t>& indices, float gridMax)
+{
+	std::unordered_map<uint64_t, int> edges;
+	auto key = [&](uint32_t v) {
+		const Float3& p = mesh.positions[v];
+		return uint64_t(std::lround(p.x * 4096.0f)) << 16 | uint64_t(std::lround(p.y * 4096.0f));
+	};
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		for (int k = 0; k < 3; ++k) {
+			uint64_t a = key(indices[i + k]), b = key(indices[i + (k + 1) % 3]);
+			++edges[a < b ? a << 32 | b : b << 32 | a];
+		}
+	}
+	auto onBorder = [&](uint64_t p) {
+		const float x = float(p >> 16) / 4096.0f, y = float(p & 0xFFFF) / 4096.0f;
+		return x == 0.0f || y == 0.0f || std::fabs(x - gridMax) < 1e-3f || std::fabs(y - gridMax) < 1e-3f;
+	};
+	size_t cracks = 0;
+	for (const auto& edge : edges) {
+		const uint64_t a = edge.first >> 32, b = edge.first & 0xFFFFFFFFu;
+		if (edge.second == 1 && !(onBorder(a) && onBorder(b))) {
+			++cracks;
+		}
+	}
+	return cracks;
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	int largest = argc > 1 ? std::atoi(argv[1]) : 1024;
+
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%12s %6s %12s %10s %14s\n", "triangles", "LODs", "coarsest", "time(ms)", "collapsed/s");
+	MeshData mesh;
+	MeshLodChain chain;
+	for (int n = 128; n <= largest; n *= 2) {
+		makeTerrain(mesh, n);
+		auto start = std::chrono::steady_clock::now();
+		buildLodChain(mesh, LodChainOptions(), chain, pool);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		// LOD마다 앞 LOD에서 이어서 줄이므로 없앤 삼각형은 원래 수 - 가장 거친 LOD의 수이다.
+		size_t collapsed = mesh.numberOfTriangles() - chain.lods.back().indexCount / 3;
+		std::printf("%12zu %6zu %12u %10.2f %14.0f\n", mesh.numberOfTriangles(), chain.lods.size(),
+				chain.lods.back().indexCount / 3, elapsed.count(), collapsed / (elapsed.count() / 1000.0));
+	}
+
+	std::printf("\nLOD chain of the largest mesh\n%4s %12s %12s\n", "LOD", "triangles", "error");
+	for (size_t i = 0; i < chain.lods.size(); ++i) {
+		std::printf("%4zu %12u %12.6f\n", i, chain.lods[i].indexCount / 3, chain.lods[i].error);
+	}
+
+	// seam vertex는 짝과 함께 seam을 따라 움직이므로 seam 때문에 거의 줄지 않으면 안 된다.
+	MeshData seamed;
+	makeSeamedTerrain(seamed, 256, 8);
+	makeTerrain(mesh, 256);
+	buildLodChain(mesh, LodChainOptions(), chain, pool);
+	const uint32_t unseamedTriangles = chain.lods.back().indexCount / 3;
+	buildLodChain(seamed, LodChainOptions(), chain, pool);
+	const uint32_t seamedTriangles = chain.lods.back().indexCount / 3;
+	const std::vector<uint32_t> coarsest(chain.indices.end() - chain.lods.back().indexCount, chain.indices.end());
+	const size_t cracks = countCracks(seamed, coarsest, 255.0f / 256.0f);
+	const bool ok = seamedTriangles <= unseamedTriangles * 2 && cracks == 0;
+	std::printf("\n8x8 UV charts on a 256x256 grid: %u vertices, coarsest %u triangles (%u without seams, error %.6f), %zu open seam edges %s\n",
+			uint32_t(seamed.positions.size()), seamedTriangles, unseamedTriangles, chain.lods.back().error, cracks, ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
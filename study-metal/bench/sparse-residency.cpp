@@ -0,0 +1,194 @@
+/*
+ * sparse-residency benchmark
+ *
+ * 1. 한 변이 argv[1](기본 65536)인 RGBA8 virtual texture를 깐 바닥 위로 camera가 날아가는 장면을 GPU 없이 흉내 낸다.
+ *    화면 320x180 sample마다 바닥의 uv와 lod를 구해 SparseFeedback에 기록하고, SparseResidency가 tile을 올리고 내린다.
+ *    읽은 tile은 다음 frame에 도착한다고 본다. 예산마다
+ *      hit      - 요청한 tile 중 이미 올라와 있던 비율 (%)
+ *      loads    - frame당 새로 읽은 tile 수, evict는 frame당 내린 tile 수
+ *      MB       - 올라와 있는 평균 / 최대 byte (mip tail 포함)
+ *      feedback - feedback 기록과 수집 시간, update는 residency 갱신 시간 (ms / frame)
+ *    을 잰다. thread 하나로 기록한 feedback으로 돌린 결과와 같은지도 확인한다.
+ * 2. 2048x2048 RGBA8 texture를 .vtex로 /tmp에 쓰고 SparseTileStreamer로 모든 tile을 읽는 속도(MB/s)와 내용이 원본과 같은지 본다.
+ * */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "BenchUtil.hpp"
+#include "SparseTexture.hpp"
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static const uint32_t kScreenWidth = 320;
+static const uint32_t kScreenHeight = 180;
+// 실제 화면은 1920x1080이고 6x6 pixel마다 하나를 기록한다고 본다.
+static const float kPixelsPerSample = 6.0f;
+
+/*
+ * 높이 1.5에서 앞으로 비스듬히 내려다보는 camera. 바닥 64 unit이 texture 한 장이다.
+ * 앞뒤로 오가며 좌우를 둘러본다. 같은 곳을 다시 보므로 예산이 작으면 내렸던 tile을 다시 읽는다.
+ * lod는 옆 sample과의 uv 차이를 실제 pixel 하나로 나눠 구한다.
+ * */
+static void recordFrame(SparseFeedback& feedback, uint32_t frame, uint32_t textureSize, ThreadPool& pool)
+{
+	const float phase = float(frame) * 0.03f;
+	const float angle = 0.8f * std::sin(phase * 0.5f);
+	const float cameraX = 32.0f + 4.0f * std::sin(phase), cameraZ = 32.0f;
+	const float forwardX = std::cos(angle), forwardZ = std::sin(angle);
+	const float height = 1.5f, pitch = 0.35f, aspect = float(kScreenHeight) / float(kScreenWidth);
+	// 화면 좌표(-1 ~ 1)의 ray가 바닥에 닿는 곳의 uv. 수평선 위면 false
+	auto hit = [&](float sx, float sy, float& u, float& v) {
+		const float down = std::sin(pitch) - sy * aspect * std::cos(pitch);
+		if (down <= 0.01f) {
+			return false;
+		}
+		const float forward = std::cos(pitch) + sy * aspect * std::sin(pitch);
+		const float distance = height / down;
+		u = (cameraX + (forwardX * forward - forwardZ * sx) * distance) / 64.0f;
+		v = (cameraZ + (forwardZ * forward + forwardX * sx) * distance) / 64.0f;
+		return true;
+	};
+	const float stepX = 2.0f / (float(kScreenWidth) * kPixelsPerSample), stepY = 2.0f / (float(kScreenHeight) * kPixelsPerSample);
+	pool.parallelFor(kScreenHeight, 8, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; ++y) {
+			const float sy = 1.0f - 2.0f * (float(y) + 0.5f) / float(kScreenHeight);
+			for (uint32_t x = 0; x < kScreenWidth; ++x) {
+				const float sx = 2.0f * (float(x) + 0.5f) / float(kScreenWidth) - 1.0f;
+				float u, v, ux, vx, uy, vy;
+				if (!hit(sx, sy, u, v) || !hit(sx + stepX, sy, ux, vx) || !hit(sx, sy - stepY, uy, vy)) {
+					continue;
+				}
+				const float dx = std::max(std::fabs(ux - u), std::fabs(vx - v)), dy = std::max(std::fabs(uy - u), std::fabs(vy - v));
+				feedback.record(u, v, std::log2(std::max(std::max(dx, dy) * float(textureSize), 1.0f)));
+			}
+		}
+	});
+}
+
+struct SimulationResult {
+	SparseResidencyStats stats;
+	double residentBytes{0.0};
+	double feedbackTime{0.0};
+	double updateTime{0.0};
+	uint64_t checksum{0};
+};
+
+static SimulationResult simulate(const SparseTileLayout& layout, uint64_t budget, uint32_t frames, ThreadPool& pool)
+{
+	SparseFeedback feedback(layout);
+	SparseResidency residency(layout, budget);
+	std::vector<uint32_t> requested, loads, evictions, arriving;
+	SimulationResult result;
+	for (uint32_t frame = 0; frame < frames; ++frame) {
+		// 지난 frame에 읽기 시작한 tile이 도착한다.
+		for (uint32_t key : arriving) {
+			residency.markResident(key);
+		}
+		auto start = std::chrono::steady_clock::now();
+		recordFrame(feedback, frame, layout.width, pool);
+		requested.clear();
+		feedback.collect(requested);
+		result.feedbackTime += millisecondsSince(start);
+		start = std::chrono::steady_clock::now();
+		loads.clear();
+		evictions.clear();
+		residency.update(requested, 256, loads, evictions);
+		result.updateTime += millisecondsSince(start);
+		arriving = loads;
+		result.residentBytes += double(residency.stats().residentBytes);
+		// 처음 몇 frame은 아무것도 없으므로 hit rate에서 뺀다.
+		if (frame == 16) {
+			residency.resetCounters();
+		}
+		for (uint8_t level : residency.residencyMap()) {
+			result.checksum = result.checksum * 31 + level;
+		}
+	}
+	result.stats = residency.stats();
+	result.residentBytes /= frames;
+	result.feedbackTime /= frames;
+	result.updateTime /= frames;
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	ThreadPool single(1);
+	const uint32_t size = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 65536;
+	std::printf("threads: %u\n", pool.size());
+
+	uint32_t tileWidth = 0, tileHeight = 0;
+	defaultSparseTileSize(TextureFormatRGBA8Unorm_sRGB, tileWidth, tileHeight);
+	const SparseTileLayout layout = makeSparseTileLayout(TextureFormatRGBA8Unorm_sRGB, size, size, mipLevelCount(size, size), tileWidth, tileHeight);
+	std::printf("virtual texture %ux%u, %ux%u tiles of %u KB, %u tiles, tail from level %u (%.1f KB), full chain %.0f MB\n", size, size,
+			tileWidth, tileHeight, layout.tileBytes / 1024, layout.tileCount, layout.tailLevel, double(layout.tailBytes) / 1024.0,
+			double(layout.tileCount) * layout.tileBytes / (1024.0 * 1024.0));
+	std::printf("%10s %8s %8s %8s %10s %10s %10s %10s %8s\n", "budget(MB)", "hit(%)", "loads", "evict", "MB(avg)", "MB(peak)", "feedback",
+			"update", "match");
+	const uint32_t frames = 600;
+	for (uint64_t budget : { 16ull, 32ull, 64ull, 128ull }) {
+		const SimulationResult result = simulate(layout, budget << 20, frames, pool);
+		const SimulationResult reference = simulate(layout, budget << 20, frames, single);
+		const bool match = result.checksum == reference.checksum && result.stats.loads == reference.stats.loads;
+		const double counted = double(frames - 17);
+		std::printf("%10llu %8.2f %8.1f %8.1f %10.1f %10.1f %10.3f %10.3f %8s\n", (unsigned long long)budget, result.stats.hitRate() * 100.0,
+				double(result.stats.loads) / counted, double(result.stats.evictions) / counted, result.residentBytes / (1024.0 * 1024.0),
+				double(result.stats.peakBytes) / (1024.0 * 1024.0), result.feedbackTime, result.updateTime, match ? "yes" : "NO");
+	}
+
+	// tile 파일 streaming
+	const uint32_t fileSize = 2048;
+	TextureData source;
+	source.layout = makeTextureLayout(TextureFormatRGBA8Unorm_sRGB, fileSize, fileSize, 0);
+	source.bytes.resize(size_t(source.layout.totalSize()));
+	std::mt19937 random(3);
+	for (size_t i = 0; i + 4 <= source.bytes.size(); i += 4) {
+		const uint32_t value = uint32_t(random());
+		std::memcpy(source.bytes.data() + i, &value, 4);
+	}
+	const char* path = "/tmp/learnmetal-sparse-residency.vtex";
+	const double write = bestOf(1, [&] { writeSparseTexture(path, source, tileWidth, tileHeight); });
+	SparseTextureFile file;
+	if (!file.open(path)) {
+		return 1;
+	}
+	const SparseTileLayout& fileLayout = file.layout();
+	std::vector<uint32_t> keys(fileLayout.tileCount);
+	for (uint32_t index = 0; index < fileLayout.tileCount; ++index) {
+		keys[index] = fileLayout.tileKey(index);
+	}
+	bool match = true;
+	const double stream = bestOf(3, [&] {
+		SparseTileStreamer streamer(file);
+		streamer.request(keys, pool);
+		while (streamer.pending() > 0) {
+			SparseTileData tile;
+			if (!streamer.poll(tile)) {
+				std::this_thread::yield();
+				continue;
+			}
+			// tile의 첫 줄이 원본의 그 자리와 같아야 한다.
+			const TextureSubresource& subresource = source.layout.subresource(sparseTileLevel(tile.key), 0);
+			const uint8_t* expected = source.bytes.data() + subresource.offset + size_t(sparseTileY(tile.key)) * tileHeight * subresource.bytesPerRow
+				+ size_t(sparseTileX(tile.key)) * fileLayout.tileRowBytes;
+			match = match && tile.bytes.size() == fileLayout.tileBytes && std::memcmp(tile.bytes.data(), expected, fileLayout.tileRowBytes) == 0;
+		}
+	});
+	std::vector<uint8_t> tail;
+	match = match && file.readTail(tail)
+		&& std::memcmp(tail.data(), source.bytes.data() + source.layout.subresource(fileLayout.tailLevel, 0).offset, tail.size()) == 0;
+	const double megabytes = double(fileLayout.tileCount) * fileLayout.tileBytes / (1024.0 * 1024.0);
+	std::printf("tile file %ux%u: %u tiles, write %.1f ms, stream %.0f MB/s (%.2f ms), match %s\n", fileSize, fileSize, fileLayout.tileCount,
+			write, megabytes / stream * 1e3, stream, match ? "yes" : "NO");
+	std::remove(path);
+	return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * sprite-batch benchmark
+ *
+ * 1. 글자 크기(8 ~ 32)와 icon 크기(32 ~ 160)가 섞인 사각형 3000개를 1024x1024 page에 넣는다.
+ *    높이 순으로 한 줄씩 채우는 shelf packer와 skyline packer의 page 수(마지막 page는 쓴 높이만큼), 채운 비율, 시간을 비교한다.
+ *    height는 모두 알고 높이 순으로 넣을 때, arrival은 글자처럼 처음 쓸 때마다 하나씩 들어온 순서대로 넣을 때이다.
+ * 2. 그 atlas를 쓰는 sprite 1천 ~ 10만 개(HUD처럼 layer 4개)를 그리는 encode를 RecordingEncoder로 흉내 낸다.
+ *      per element - sprite마다 page를 묶고 vertex 4개를 setVertexBytes로 보내 draw 한다. (지금 HUD의 방식)
+ *      batched     - SpriteBatch로 정렬하고 vertex를 한 buffer에 쓴 뒤 page가 바뀔 때마다 drawIndexedPrimitives 하나
+ *    draw 수, encoder 호출 수, 시간, ms당 sprite 수를 잰다. batched는 layer가 하나일 때(draw = page 수)도 잰다.
+ *    thread 하나로 쓴 vertex와 byte 단위로 같은지, draw 안의 quad가 모두 그 draw의 page를 읽는지 확인한다.
+ * argv[1]은 가장 큰 sprite 수이다. (기본 100000)
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <unordered_set>
+
+#include "BenchUtil.hpp"
+#include "RecordingEncoder.hpp"
+#include "SpriteBatch.hpp"
+
+// 높이가 큰 것부터 왼쪽에서 오른쪽으로 채우고, 넘치면 지금 줄의 가장 높은 것 아래로 새 줄을 시작한다.
+// sorted가 false면 들어온 순서대로 넣는다. (글자를 처음 쓸 때마다 atlas에 더하는 경우)
+static void shelfPack(std::vector<AtlasRect>& rects, uint32_t pageSize, uint32_t padding, bool sorted)
+{
+	std::vector<uint32_t> order(rects.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	if (sorted) {
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return rects[a].height > rects[b].height; });
+	}
+	uint32_t page = 0, x = 0, y = 0, shelfHeight = 0;
+	for (uint32_t index : order) {
+		AtlasRect& rect = rects[index];
+		const uint32_t width = rect.width + 2 * padding, height = rect.height + 2 * padding;
+		if (x + width > pageSize) {
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		if (y + height > pageSize) {
+			++page;
+			x = 0;
+			y = 0;
+			shelfHeight = 0;
+		}
+		rect.page = page;
+		rect.x = x + padding;
+		rect.y = y + padding;
+		x += width;
+		shelfHeight = std::max(shelfHeight, height);
+	}
+}
+
+// 마지막 page는 쓴 높이만큼만 센 page 수
+static double usedPages(const std::vector<AtlasRect>& rects, uint32_t pageSize, uint32_t padding)
+{
+	uint32_t last = 0, height = 0;
+	for (const AtlasRect& rect : rects) {
+		last = std::max(last, rect.page);
+	}
+	for (const AtlasRect& rect : rects) {
+		height = rect.page == last ? std::max(height, rect.y + rect.height + padding) : height;
+	}
+	return double(last) + double(height) / double(pageSize);
+}
+
+static bool overlaps(const std::vector<AtlasRect>& rects, uint32_t pageSize)
+{
+	// 작은 page grid에 칠해 보며 겹치거나 밖으로 나가는지 본다.
+	uint32_t pages = 0;
+	for (const AtlasRect& rect : rects) {
+		pages = std::max(pages, rect.page + 1);
+	}
+	std::vector<uint8_t> covered(size_t(pages) * pageSize * pageSize, 0);
+	for (const AtlasRect& rect : rects) {
+		if (rect.x + rect.width > pageSize || rect.y + rect.height > pageSize) {
+			return true;
+		}
+		for (uint32_t y = rect.y; y < rect.y + rect.height; ++y) {
+			uint8_t* row = covered.data() + (size_t(rect.page) * pageSize + y) * pageSize;
+			for (uint32_t x = rect.x; x < rect.x + rect.width; ++x) {
+				if (row[x]) {
+					return true;
+				}
+				row[x] = 1;
+			}
+		}
+	}
+	return false;
+}
+
+static uint64_t cornerKey(uint32_t page, uint32_t x, uint32_t y)
+{
+	return uint64_t(page) << 40 | uint64_t(x) << 20 | y;
+}
+
+// 회전하지 않는 sprite만 쓰던 예전 HUD처럼 sprite 하나의 vertex를 바로 만든다. (회전은 SpriteBatch와 같은 식)
+static void quadVertices(const Sprite& sprite, const SpriteAtlas& atlas, SpriteVertex* quad)
+{
+	const AtlasRect& rect = atlas.rects[sprite.image];
+	const float u0 = float(rect.x) / float(atlas.pageWidth), u1 = float(rect.x + rect.width) / float(atlas.pageWidth);
+	const float v0 = float(rect.y) / float(atlas.pageHeight), v1 = float(rect.y + rect.height) / float(atlas.pageHeight);
+	const float c = std::cos(sprite.rotation), s = std::sin(sprite.rotation);
+	const float halfWidth = sprite.size.x * 0.5f, halfHeight = sprite.size.y * 0.5f;
+	const float centerX = sprite.position.x + halfWidth, centerY = sprite.position.y + halfHeight;
+	auto corner = [&](float dx, float dy) { return Float2{ centerX + dx * c - dy * s, centerY + dx * s + dy * c }; };
+	quad[0] = { corner(-halfWidth, -halfHeight), { u0, v0 }, sprite.color };
+	quad[1] = { corner(halfWidth, -halfHeight), { u1, v0 }, sprite.color };
+	quad[2] = { corner(-halfWidth, halfHeight), { u0, v1 }, sprite.color };
+	quad[3] = { corner(halfWidth, halfHeight), { u1, v1 }, sprite.color };
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	ThreadPool single(1);
+	const size_t maxSprites = argc > 1 ? size_t(std::strtoul(argv[1], nullptr, 10)) : 100000;
+	std::printf("threads: %u\n", pool.size());
+
+	// atlas packing
+	const uint32_t pageSize = 1024, padding = 1;
+	std::mt19937 random(5);
+	std::vector<AtlasRect> requests(3000);
+	for (size_t i = 0; i < requests.size(); ++i) {
+		const bool icon = i % 10 == 0;
+		requests[i].width = icon ? 32 + random() % 129 : 8 + random() % 25;
+		requests[i].height = icon ? 32 + random() % 129 : 8 + random() % 25;
+	}
+	uint64_t area = 0;
+	for (const AtlasRect& rect : requests) {
+		area += uint64_t(rect.width) * rect.height;
+	}
+	std::printf("%zu rects, %.2f pages of area at %ux%u\n", requests.size(), double(area) / (double(pageSize) * pageSize), pageSize, pageSize);
+	std::printf("%10s %8s %8s %12s %10s %8s\n", "packer", "order", "pages", "occupancy(%)", "time(ms)", "valid");
+	const double pageArea = double(pageSize) * pageSize;
+	std::vector<AtlasRect> packed;
+	for (bool sorted : { true, false }) {
+		std::vector<AtlasRect> rects;
+		const double time = bestOf(5, [&] {
+			rects = requests;
+			shelfPack(rects, pageSize, padding, sorted);
+		});
+		const double pages = usedPages(rects, pageSize, padding);
+		std::printf("%10s %8s %8.2f %12.1f %10.3f %8s\n", "shelf", sorted ? "height" : "arrival", pages, double(area) / (pageArea * pages) * 100.0,
+				time, overlaps(rects, pageSize) ? "NO" : "yes");
+
+		AtlasPacker packer(pageSize, pageSize, padding, 64);
+		size_t inserted = 0;
+		const double skylineTime = bestOf(5, [&] {
+			packer.reset();
+			rects = requests;
+			inserted = 0;
+			if (sorted) {
+				inserted = packer.insertAll(rects);
+				return;
+			}
+			for (AtlasRect& rect : rects) {
+				inserted += packer.insert(rect.width, rect.height, rect) ? 1 : 0;
+			}
+		});
+		const double skylinePages = usedPages(rects, pageSize, padding);
+		std::printf("%10s %8s %8.2f %12.1f %10.3f %8s\n", "skyline", sorted ? "height" : "arrival", skylinePages,
+				double(area) / (pageArea * skylinePages) * 100.0, skylineTime, inserted == requests.size() && !overlaps(rects, pageSize) ? "yes" : "NO");
+		if (sorted) {
+			packed = rects;
+		}
+	}
+	SpriteAtlas atlas;
+	atlas.pageWidth = pageSize;
+	atlas.pageHeight = pageSize;
+	atlas.rects = packed;
+	// (page, 왼쪽 위 texel)마다 image는 하나뿐이다.
+	std::unordered_set<uint64_t> imageCorners;
+	for (const AtlasRect& rect : atlas.rects) {
+		imageCorners.insert(cornerKey(rect.page, rect.x, rect.y));
+	}
+
+	// sprite encode
+	RecordingEncoder encoder;
+	const int pageObjects[64] = {};
+	const int vertexBufferObject = 0;
+	std::vector<SpriteVertex> vertices, check;
+	std::printf("\n%8s %7s %12s %8s %8s %10s %12s %8s\n", "sprites", "layers", "method", "draws", "calls", "time(ms)", "sprites/ms", "match");
+	for (size_t count = 1000; count <= maxSprites; count *= 10) {
+		std::vector<Sprite> sprites(count);
+		for (size_t i = 0; i < count; ++i) {
+			Sprite& sprite = sprites[i];
+			sprite.image = uint32_t(random() % atlas.rects.size());
+			sprite.position = { float(random() % 1920), float(random() % 1080) };
+			sprite.size = { float(atlas.rects[sprite.image].width), float(atlas.rects[sprite.image].height) };
+			sprite.rotation = i % 8 == 0 ? float(random() % 628) * 0.01f : 0.0f;
+			sprite.color = 0xFF000000u | uint32_t(random() & 0xFFFFFF);
+			sprite.layer = int32_t(random() % 4);
+		}
+
+		// 지금 방식: layer 순서로 sprite마다 vertex를 만들어 setVertexBytes로 보낸다.
+		const double naive = bestOf(3, [&] {
+			encoder.clear();
+			SpriteVertex quad[4];
+			for (int layer = 0; layer < 4; ++layer) {
+				for (const Sprite& sprite : sprites) {
+					if (sprite.layer != layer) {
+						continue;
+					}
+					quadVertices(sprite, atlas, quad);
+					encoder.setFragmentBuffer(&pageObjects[atlas.rects[sprite.image].page], 0, 0);
+					encoder.setVertexBytes(quad, sizeof(quad), 0);
+					encoder.drawPrimitives(4, 0, 4);
+				}
+			}
+		});
+		std::printf("%8zu %7d %12s %8zu %8zu %10.3f %12.0f %8s\n", count, 4, "per element", encoder.numberOfCalls(EncoderCallType::DrawPrimitives),
+				encoder.calls().size(), naive, double(count) / naive, "-");
+
+		for (int layers : { 4, 1 }) {
+			SpriteBatch batch(atlas);
+			auto encode = [&](ThreadPool& threads, std::vector<SpriteVertex>& out) {
+				encoder.clear();
+				batch.clear();
+				for (const Sprite& sprite : sprites) {
+					Sprite copy = sprite;
+					copy.layer = layers == 1 ? 0 : sprite.layer;
+					batch.add(copy);
+				}
+				batch.build(threads);
+				out.resize(batch.size() * 4);
+				batch.writeVertices(out.data(), threads);
+				encoder.setVertexBuffer(&vertexBufferObject, 0, 0);
+				for (const SpriteDraw& draw : batch.draws()) {
+					encoder.setFragmentBuffer(&pageObjects[draw.page], 0, 0);
+					encoder.drawIndexedPrimitives(3, draw.indexCount, 1, &vertexBufferObject, draw.firstIndex * sizeof(uint32_t));
+				}
+			};
+			const double time = bestOf(5, [&] { encode(pool, vertices); });
+			const size_t draws = batch.draws().size(), calls = encoder.calls().size();
+			encode(single, check);
+			// draw 안의 quad는 모두 그 draw의 page에 있는 image를 읽어야 한다.
+			bool match = vertices.size() == check.size() && std::memcmp(vertices.data(), check.data(), vertices.size() * sizeof(SpriteVertex)) == 0;
+			for (const SpriteDraw& draw : batch.draws()) {
+				for (uint32_t quad = draw.firstIndex / 6; quad < (draw.firstIndex + draw.indexCount) / 6; ++quad) {
+					const SpriteVertex& corner = vertices[quad * 4];
+					match = match && imageCorners.count(cornerKey(draw.page, uint32_t(corner.texcoord.x * pageSize + 0.5f),
+								uint32_t(corner.texcoord.y * pageSize + 0.5f))) == 1;
+				}
+			}
+			std::printf("%8zu %7d %12s %8zu %8zu %10.3f %12.0f %8s\n", count, layers, "batched", draws, calls, time, double(count) / time,
+					match ? "yes" : "NO");
+		}
+	}
+	return 0;
+}
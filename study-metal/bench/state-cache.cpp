@@ -0,0 +1,174 @@
+/*
+ * state-cache benchmark
+ *
+ *   bench-state-cache [state 하나를 만드는 비용(us)]
+ * material마다 sampler / depth-stencil descriptor를 하나씩 가진 scene을 흉내 낸다. 서로 다른 descriptor는 72 + 6개뿐이다.
+ * state는 참조 계수만 있는 가짜이고 만들 때 argv[1] us(기본 10 us)만큼 바쁘게 기다린다. 실제 비용은 device와 driver마다 다르다.
+ * 1. material 수별로 material마다 state를 만드는 경우와 StateCache로 찾는 경우의 시간과 만든 state 수
+ * 2. 모든 key가 cache에 있을 때 thread 수별 acquire / release 처리량. shard 하나(전체 lock 하나와 같다)와 16개를 비교한다.
+ * 3. 자주 쓰는 key가 몰려 있는 접근에서 capacity별 hit rate와 eviction 수
+ * 끝나고 살아 있는 state가 0개인지 확인한다.
+ * */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "StateCache.hpp"
+
+static std::atomic<int64_t> gLiveStates{0};
+static double gCreateMicroseconds = 10.0;
+
+// MTL::SamplerState 대신 쓰는 참조 계수 객체
+class MockState {
+	public:
+		MockState() { ++gLiveStates; }
+		~MockState() { --gLiveStates; }
+		MockState* retain() { _references.fetch_add(1, std::memory_order_relaxed); return this; }
+		void release()
+		{
+			if (_references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				delete this;
+			}
+		}
+
+	private:
+		std::atomic<int> _references{1};
+};
+
+static void busyWait(double microseconds)
+{
+	auto until = std::chrono::steady_clock::now() + std::chrono::duration<double, std::micro>(microseconds);
+	while (std::chrono::steady_clock::now() < until) {
+	}
+}
+
+// device->newSamplerState 대신
+template <typename Key>
+static MockState* createState(const Key&)
+{
+	busyWait(gCreateMicroseconds);
+	return new MockState();
+}
+
+struct Material {
+	SamplerKey sampler;
+	DepthStencilKey depthStencil;
+};
+
+// filter 2 x mip 3 x address 4 x anisotropy 3 = 72가지 sampler, depth 6가지
+static std::vector<Material> makeMaterials(size_t count, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::vector<Material> materials(count);
+	const uint8_t anisotropy[] = { 1, 4, 16 };
+	const uint8_t depthCompare[] = { StateCompareFunctionLess, StateCompareFunctionLessEqual, StateCompareFunctionAlways };
+	for (Material& material : materials) {
+		const uint32_t sampler = random() % 72, depth = random() % 6;
+		material.sampler.minFilter = material.sampler.magFilter = uint8_t(sampler % 2);
+		material.sampler.mipFilter = uint8_t(sampler / 2 % 3);
+		material.sampler.sAddressMode = material.sampler.tAddressMode = uint8_t(sampler / 6 % 4);
+		material.sampler.maxAnisotropy = anisotropy[sampler / 24];
+		material.depthStencil.depthCompareFunction = depthCompare[depth % 3];
+		material.depthStencil.depthWriteEnabled = uint8_t(depth / 3);
+	}
+	return materials;
+}
+
+template <typename Function>
+static double elapsedMs(Function function)
+{
+	auto start = std::chrono::steady_clock::now();
+	function();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	gCreateMicroseconds = argc > 1 ? std::atof(argv[1]) : gCreateMicroseconds;
+	std::printf("state creation: %.1f us, hardware threads: %u\n", gCreateMicroseconds, std::thread::hardware_concurrency());
+
+	// 1. material마다 만들기 vs cache
+	std::printf("%10s %14s %12s %14s %12s %10s %10s\n", "materials", "uncached(ms)", "created", "cached(ms)", "created", "hits", "speedup");
+	for (size_t count : { 100u, 1000u, 10000u }) {
+		const std::vector<Material> materials = makeMaterials(count, 7);
+		std::vector<MockState*> states(count * 2);
+		const double uncached = elapsedMs([&] {
+			for (size_t i = 0; i < count; ++i) {
+				states[i * 2] = createState(materials[i].sampler);
+				states[i * 2 + 1] = createState(materials[i].depthStencil);
+			}
+		});
+		for (MockState* state : states) {
+			state->release();
+		}
+		StateCache<SamplerKey, MockState> samplers(createState<SamplerKey>);
+		StateCache<DepthStencilKey, MockState> depthStencils(createState<DepthStencilKey>);
+		const double cached = elapsedMs([&] {
+			for (size_t i = 0; i < count; ++i) {
+				states[i * 2] = samplers.acquire(materials[i].sampler);
+				states[i * 2 + 1] = depthStencils.acquire(materials[i].depthStencil);
+			}
+		});
+		for (MockState* state : states) {
+			state->release();
+		}
+		const StateCacheStats a = samplers.stats(), b = depthStencils.stats();
+		std::printf("%10zu %14.2f %12zu %14.2f %12llu %10llu %9.1fx\n", count, uncached, count * 2, cached,
+				(unsigned long long)(a.creations + b.creations), (unsigned long long)(a.hits + b.hits), uncached / cached);
+	}
+
+	// 2. 모두 cache에 있을 때 여러 thread의 lookup
+	const std::vector<Material> materials = makeMaterials(4096, 11);
+	const size_t lookupsPerThread = 200000;
+	std::printf("\n%8s %8s %14s %16s\n", "threads", "shards", "time(ms)", "lookups/ms");
+	for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+		for (size_t shards : { 1u, 16u }) {
+			StateCache<SamplerKey, MockState> cache(createState<SamplerKey>, 1024, shards);
+			for (const Material& material : materials) {
+				cache.acquire(material.sampler)->release();
+			}
+			const double time = elapsedMs([&] {
+				std::vector<std::thread> workers;
+				for (unsigned t = 0; t < threads; ++t) {
+					workers.emplace_back([&, t] {
+						for (size_t i = 0; i < lookupsPerThread; ++i) {
+							cache.acquire(materials[(i * 31 + t * 977) % materials.size()].sampler)->release();
+						}
+					});
+				}
+				for (std::thread& worker : workers) {
+					worker.join();
+				}
+			});
+			std::printf("%8u %8zu %14.2f %16.0f\n", threads, shards, time, double(lookupsPerThread * threads) / time);
+		}
+	}
+
+	// 3. capacity가 서로 다른 key 수보다 작을 때. 앞쪽 key일수록 자주 쓴다.
+	std::printf("\n%10s %10s %10s %12s %12s\n", "capacity", "keys", "hit rate", "creations", "evictions");
+	std::vector<SamplerKey> keys;
+	for (const Material& material : makeMaterials(20000, 13)) {
+		keys.push_back(material.sampler);
+	}
+	std::sort(keys.begin(), keys.end(), [](const SamplerKey& a, const SamplerKey& b) { return std::memcmp(&a, &b, sizeof(SamplerKey)) < 0; });
+	keys.erase(std::unique(keys.begin(), keys.end(), StateKeyEqual<SamplerKey>()), keys.end());
+	for (size_t capacity : { 8u, 32u, 64u, 128u }) {
+		StateCache<SamplerKey, MockState> cache(createState<SamplerKey>, capacity, 4);
+		std::mt19937 random(17);
+		std::geometric_distribution<size_t> skewed(0.08);
+		for (size_t i = 0; i < 20000; ++i) {
+			cache.acquire(keys[skewed(random) % keys.size()])->release();
+		}
+		const StateCacheStats stats = cache.stats();
+		std::printf("%10zu %10zu %9.1f%% %12llu %12llu\n", capacity, keys.size(), 100.0 * stats.hitRate(),
+				(unsigned long long)stats.creations, (unsigned long long)stats.evictions);
+	}
+
+	std::printf("\nlive states after release: %lld\n", (long long)gLiveStates.load());
+	return gLiveStates.load() == 0 ? 0 : 1;
+}
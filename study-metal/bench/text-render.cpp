@@ -0,0 +1,228 @@
+/*
+ * text-render benchmark
+ *
+ *   bench-text-render [font.ttf]
+ * font는 macOS에서만 기본값(Monaco)이 있고 Linux에서는 꼭 주어야 한다. font를 읽지 못하면 1로 끝난다.
+ * 1. argv[1]의 TrueType font로 ASCII MSDF atlas를 만드는 시간을 thread pool과 thread 하나로 재고 결과가 같은지 본다.
+ * 2. glyph마다 8배로 확대해 안팎을 atlas에서 다시 읽고 윤곽선으로 직접 판정한 것과 다른 sample 비율(%)을
+ *    MSDF(rgb 중앙값)와 보통 SDF(alpha)로 비교한다. 모서리가 뭉개지는 정도이다.
+ * 3. frame마다 바뀌는 통계 화면(줄마다 숫자가 다른 문자열)을 glyph 수별로 배치한다.
+ *      layout - TextBatch로 GlyphInstance를 만드는 시간과 glyphs/ms
+ *      raster - 같은 글자를 frame마다 16 pixel로 CPU rasterize(4x4 sample coverage) 할 때
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "BenchUtil.hpp"
+#include "FontAtlas.hpp"
+
+// pixel 좌표(원점 (left, bottom), y 위쪽)로 옮긴 윤곽선의 y 단조 조각
+static std::vector<FontDetail::MonotoneEdge> monotoneEdges(const GlyphOutline& outline, double scale, double left, double bottom)
+{
+	std::vector<FontDetail::MonotoneEdge> edges;
+	for (const std::vector<GlyphEdge>& contour : outline.contours) {
+		for (const GlyphEdge& edge : contour) {
+			FontDetail::appendMonotone(FontDetail::toEdge(edge, scale, left, bottom), edges);
+		}
+	}
+	return edges;
+}
+
+// 높이 y 줄에서 x보다 오른쪽 교점의 winding이 0이 아니면 안쪽이다.
+static bool inside(const std::vector<std::pair<double, int>>& crossings, double x)
+{
+	int winding = 0;
+	for (const std::pair<double, int>& crossing : crossings) {
+		winding += crossing.first > x ? crossing.second : 0;
+	}
+	return winding != 0;
+}
+
+static float sampleChannel(const FontAtlas& atlas, float u, float v, int channel)
+{
+	u -= 0.5f;
+	v -= 0.5f;
+	const int x0 = int(std::floor(u)), y0 = int(std::floor(v));
+	const float fx = u - float(x0), fy = v - float(y0);
+	auto at = [&](int x, int y) {
+		x = std::clamp(x, 0, int(atlas.width) - 1);
+		y = std::clamp(y, 0, int(atlas.height) - 1);
+		return float(atlas.pixels[(size_t(y) * atlas.width + x) * 4 + channel]) / 255.0f;
+	};
+	return (at(x0, y0) * (1.0f - fx) + at(x0 + 1, y0) * fx) * (1.0f - fy) + (at(x0, y0 + 1) * (1.0f - fx) + at(x0 + 1, y0 + 1) * fx) * fy;
+}
+
+/*
+ * glyph 사각형 안을 magnify배 촘촘한 격자로 훑어 atlas의 bilinear 값으로 판정한 안팎과 윤곽선의 판정이 다른 sample 수를 센다.
+ * errors[0]은 MSDF, errors[1]은 SDF
+ * */
+static void reconstructionErrors(const TtfFont& font, const FontAtlas& atlas, uint32_t magnify, uint64_t& samples, uint64_t errors[2])
+{
+	const double scale = atlas.emSize / double(font.unitsPerEm());
+	std::vector<std::pair<double, int>> crossings;
+	for (const FontGlyph& glyph : atlas.glyphs) {
+		GlyphOutline outline;
+		if (glyph.width == 0 || !font.outline(font.glyphIndex(glyph.codepoint), outline)) {
+			continue;
+		}
+		const auto edges = monotoneEdges(outline, scale, double(glyph.left) * atlas.emSize, double(glyph.bottom) * atlas.emSize);
+		for (uint32_t row = 0; row < glyph.height * magnify; ++row) {
+			const double ty = (double(row) + 0.5) / magnify;
+			crossings.clear();
+			FontDetail::appendCrossings(edges, double(glyph.height) - ty, crossings);
+			for (uint32_t column = 0; column < glyph.width * magnify; ++column) {
+				const double tx = (double(column) + 0.5) / magnify;
+				const bool expected = inside(crossings, tx);
+				const float u = float(glyph.x + tx), v = float(glyph.y + ty);
+				const float r = sampleChannel(atlas, u, v, 0), g = sampleChannel(atlas, u, v, 1), b = sampleChannel(atlas, u, v, 2);
+				const float median = std::max(std::min(r, g), std::min(std::max(r, g), b));
+				errors[0] += (median > 0.5f) != expected;
+				errors[1] += (sampleChannel(atlas, u, v, 3) > 0.5f) != expected;
+				++samples;
+			}
+		}
+	}
+}
+
+// 통계 화면 한 장. 줄마다 frame 번호로 숫자가 바뀐다.
+static void makeStatsText(uint32_t frame, size_t lines, std::string& text)
+{
+	text.clear();
+	char line[128];
+	for (size_t i = 0; i < lines; ++i) {
+		std::snprintf(line, sizeof(line), "pass %02zu  gpu %6.3f ms  draws %5u  triangles %8u  visible %5.1f%%\n", i,
+				0.01 * double((frame * 7 + i * 13) % 1700), (frame + uint32_t(i) * 31) % 4096, (frame * 977 + uint32_t(i) * 7919) % 10000000,
+				double((frame + i) % 1000) * 0.1);
+		text += line;
+	}
+}
+
+/*
+ * frame마다 rasterize 하는 쪽: glyph 윤곽선을 pixelSize로 줄여 pixel마다 4x4 sample의 coverage를 낸다.
+ * 윤곽선은 미리 읽어 둔다. (font 파일 parsing은 빼고 잰다)
+ * */
+static size_t rasterizeText(const std::string& text, const std::vector<GlyphOutline>& outlines, const TtfFont& font, float pixelSize,
+		std::vector<uint8_t>& coverage)
+{
+	const double scale = pixelSize / double(font.unitsPerEm());
+	std::vector<std::pair<double, int>> crossings;
+	size_t glyphs = 0;
+	const char* cursor = text.c_str();
+	while (*cursor) {
+		const uint32_t codepoint = decodeUtf8(cursor);
+		if (codepoint < 32 || codepoint >= 127 || outlines[codepoint - 32].empty()) {
+			continue;
+		}
+		const GlyphOutline& outline = outlines[codepoint - 32];
+		const double left = std::floor(outline.xMin * scale), bottom = std::floor(outline.yMin * scale);
+		const uint32_t width = uint32_t(std::ceil(outline.xMax * scale) - left), height = uint32_t(std::ceil(outline.yMax * scale) - bottom);
+		const auto edges = monotoneEdges(outline, scale, left, bottom);
+		coverage.assign(size_t(width) * height, 0);
+		for (uint32_t row = 0; row < height; ++row) {
+			for (uint32_t sampleY = 0; sampleY < 4; ++sampleY) {
+				crossings.clear();
+				FontDetail::appendCrossings(edges, double(height - row) - (double(sampleY) + 0.5) / 4.0, crossings);
+				std::sort(crossings.begin(), crossings.end());
+				// 왼쪽부터 교점을 지나며 winding을 더한다.
+				size_t next = 0;
+				int winding = 0;
+				for (uint32_t sample = 0; sample < width * 4; ++sample) {
+					const double x = (double(sample) + 0.5) / 4.0;
+					for (; next < crossings.size() && crossings[next].first <= x; ++next) {
+						winding += crossings[next].second;
+					}
+					coverage[size_t(row) * width + sample / 4] += winding != 0 ? 15 : 0;
+				}
+			}
+		}
+		++glyphs;
+	}
+	return glyphs;
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	ThreadPool single(1);
+#if defined(__APPLE__)
+	const char* path = argc > 1 ? argv[1] : "/System/Library/Fonts/Monaco.ttf";
+#else
+	const char* path = argc > 1 ? argv[1] : nullptr;
+#endif
+	if (!path) {
+		std::fprintf(stderr, "usage: %s font.ttf (there is no default font outside macOS)\n", argv[0]);
+		return 1;
+	}
+	TtfFont font;
+	if (!font.open(path)) {
+		std::fprintf(stderr, "%s: cannot load the font\n", path);
+		return 1;
+	}
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%s: %u glyphs, %u units per em, %zu kerning pairs\n", path, font.glyphCount(), font.unitsPerEm(), font.kerningPairs().size());
+
+	// 1. atlas 생성
+	std::printf("%8s %8s %10s %12s %12s %8s\n", "em(px)", "range", "atlas", "pool(ms)", "single(ms)", "match");
+	FontAtlas atlas;
+	for (float emSize : { 24.0f, 32.0f, 48.0f }) {
+		FontAtlasOptions options;
+		options.emSize = emSize;
+		FontAtlas reference;
+		const double parallel = bestOf(3, [&] { generateFontAtlas(font, options, atlas, pool); });
+		const double serial = bestOf(1, [&] { generateFontAtlas(font, options, reference, single); });
+		const bool match = atlas.pixels == reference.pixels && atlas.glyphs.size() == reference.glyphs.size();
+		std::printf("%8.0f %8.0f %5ux%-4u %12.2f %12.2f %8s\n", emSize, options.distanceRange, atlas.width, atlas.height, parallel, serial,
+				match ? "yes" : "NO");
+	}
+
+	// 2. 확대했을 때 윤곽선 오차
+	std::printf("\n%8s %10s %12s %12s\n", "em(px)", "magnify", "msdf err(%)", "sdf err(%)");
+	for (float emSize : { 16.0f, 32.0f }) {
+		FontAtlasOptions options;
+		options.emSize = emSize;
+		FontAtlas small;
+		generateFontAtlas(font, options, small, pool);
+		uint64_t samples = 0, errors[2] = {};
+		reconstructionErrors(font, small, 8, samples, errors);
+		std::printf("%8.0f %10u %12.3f %12.3f\n", emSize, 8u, 100.0 * double(errors[0]) / double(samples), 100.0 * double(errors[1]) / double(samples));
+	}
+
+	// 3. frame마다 바뀌는 통계 화면
+	FontAtlasOptions options;
+	generateFontAtlas(font, options, atlas, pool);
+	std::vector<GlyphOutline> outlines(95);
+	for (uint32_t codepoint = 32; codepoint < 127; ++codepoint) {
+		font.outline(font.glyphIndex(codepoint), outlines[codepoint - 32]);
+	}
+	TextBatch batch(atlas);
+	std::string text;
+	std::vector<uint8_t> coverage;
+	std::printf("\n%8s %8s %12s %12s %12s %12s\n", "lines", "glyphs", "layout(ms)", "glyphs/ms", "raster(ms)", "glyphs/ms");
+	for (size_t lines : { 16u, 160u, 1600u }) {
+		uint32_t frame = 0;
+		size_t glyphs = 0;
+		const double layout = bestOf(5, [&] {
+			makeStatsText(frame++, lines, text);
+			batch.clear();
+			glyphs = batch.add(text.c_str(), 8.0f, 24.0f, 16.0f);
+		});
+		std::printf("%8zu %8zu %12.3f %12.0f", lines, glyphs, layout, double(glyphs) / layout);
+		if (lines > 160) {
+			std::printf(" %12s %12s\n", "-", "-");
+			continue;
+		}
+		size_t rasterized = 0;
+		const double raster = bestOf(3, [&] {
+			makeStatsText(frame++, lines, text);
+			rasterized = rasterizeText(text, outlines, font, 16.0f, coverage);
+		});
+		// 같은 문자열의 instance 수와 rasterize 한 glyph 수가 같아야 한다.
+		batch.clear();
+		glyphs = batch.add(text.c_str(), 8.0f, 24.0f, 16.0f);
+		std::printf(" %12.3f %12.0f%s\n", raster, double(rasterized) / raster, rasterized == glyphs ? "" : " (glyph count differs)");
+	}
+	return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * texture-load benchmark
+ *
+ * mip이 모두 있는 RGBA8, BC7 texture를 KTX2 / DDS로 /tmp에 써 두고
+ *   load     - loadTexture로 파일 전체를 읽고 header를 해석하는 시간 (MB/s)
+ *   upload   - subresource마다 bytesPerRow 단위로 staging buffer에 복사하는 시간 (MB/s).
+ *              Metal에서는 이 buffer를 blit copyFromBuffer로 texture에 넘긴다.
+ *   first    - TextureStreamer::open이 64KB 안의 작은 mip을 읽고 돌려줄 때까지의 시간 (ms)
+ *   stream   - 나머지 level을 pool에서 읽어 모두 poll 할 때까지의 시간 (ms)
+ * 을 잰다. 파일은 page cache에 있으므로 disk가 아니라 parsing과 복사 비용이다.
+ * 스트리밍이 작은 level부터 오는지, 읽은 내용이 원본과 같은지도 확인한다.
+ * argv[1]은 가장 큰 texture의 한 변이다. (기본 4096)
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "BenchUtil.hpp"
+#include "TextureLoader.hpp"
+
+// staging buffer에 subresource를 256 byte 정렬로 이어 붙인다. copyFromBuffer의 sourceOffset 조건을 넉넉히 맞춘다.
+static size_t stageTexture(const TextureData& texture, uint8_t* staging)
+{
+	size_t offset = 0;
+	for (const TextureSubresource& subresource : texture.layout.subresources) {
+		const uint8_t* source = texture.bytes.data() + subresource.offset;
+		const size_t rows = size_t(subresource.bytesPerImage / subresource.bytesPerRow) * subresource.depth;
+		for (size_t row = 0; row < rows; ++row) {
+			std::memcpy(staging + offset + row * subresource.bytesPerRow, source + row * subresource.bytesPerRow, subresource.bytesPerRow);
+		}
+		offset = (offset + size_t(subresource.size) + 255) & ~size_t(255);
+	}
+	return offset;
+}
+
+int main(int argc, char* argv[])
+{
+	ThreadPool& pool = ThreadPool::shared();
+	const uint32_t largest = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 4096;
+	std::mt19937 random(5);
+	std::printf("threads: %u\n", pool.size());
+	std::printf("%10s %10s %6s %10s %12s %14s %10s %11s %8s\n", "format", "size", "file", "MB", "load(MB/s)", "upload(MB/s)", "first(ms)",
+			"stream(ms)", "match");
+
+	struct Format {
+		const char* name;
+		TextureFormat format;
+	};
+	for (uint32_t size : { largest / 4, largest / 2, largest }) {
+		for (Format format : { Format{ "RGBA8", TextureFormatRGBA8Unorm_sRGB }, Format{ "BC7", TextureFormatBC7_RGBAUnorm_sRGB } }) {
+			TextureData source;
+			source.layout = makeTextureLayout(format.format, size, size, 0);
+			source.bytes.resize(size_t(source.layout.totalSize()));
+			for (size_t i = 0; i + 4 <= source.bytes.size(); i += 4) {
+				uint32_t value = uint32_t(random());
+				std::memcpy(source.bytes.data() + i, &value, 4);
+			}
+			const double megabytes = double(source.bytes.size()) / (1024.0 * 1024.0);
+
+			for (const char* extension : { "ktx2", "dds" }) {
+				const std::string path = std::string("/tmp/learnmetal-texture-load.") + extension;
+				if (!saveTexture(path.c_str(), source)) {
+					return 1;
+				}
+				TextureData loaded;
+				bool match = true;
+				double load = bestOf(3, [&] { match = loadTexture(path.c_str(), loaded) && match; });
+				for (const TextureSubresource& subresource : source.layout.subresources) {
+					match = match && std::memcmp(loaded.data(subresource.level, subresource.slice), source.bytes.data() + subresource.offset,
+							size_t(subresource.size)) == 0;
+				}
+
+				std::vector<uint8_t> staging(source.bytes.size() + 256 * source.layout.subresources.size());
+				double upload = bestOf(3, [&] { stageTexture(loaded, staging.data()); });
+
+				// 작은 level부터 하나씩 와야 한다.
+				double first = 0.0;
+				double stream = bestOf(3, [&] {
+					auto start = std::chrono::steady_clock::now();
+					TextureStreamer streamer;
+					if (!streamer.open(path.c_str())) {
+						match = false;
+						return;
+					}
+					first = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+					streamer.stream(pool);
+					uint32_t expected = streamer.layout().levels;
+					while (!streamer.finished()) {
+						TextureLevelData level;
+						if (!streamer.poll(level)) {
+							std::this_thread::yield();
+							continue;
+						}
+						match = match && level.level == --expected
+							&& std::memcmp(level.bytes.data(), source.data(level.level), level.bytes.size()) == 0;
+					}
+					match = match && expected == 0;
+				});
+				std::printf("%10s %10u %6s %10.1f %12.0f %14.0f %10.3f %11.2f %8s\n", format.name, size, extension, megabytes, megabytes / load * 1e3,
+						megabytes / upload * 1e3, first, stream, match ? "yes" : "NO");
+				std::remove(path.c_str());
+			}
+		}
+	}
+	return 0;
+}
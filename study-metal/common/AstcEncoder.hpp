@@ -0,0 +1,1501 @@
+/*
+ * AstcEncoder.hpp
+ *
+ * RGBA8 image를 ASTC LDR block(4x4 ~ 12x12)으로 압축하고 다시 푼다. Apple GPU가 가장 잘 읽는 압축 format이다.
+ * block 하나는 128 bit이고
+ *  - block mode: weight grid 크기(block보다 작을 수 있다), weight 양자화 범위, dual plane 여부
+ *  - partition 수와 seed, color endpoint mode(CEM)
+ *  - endpoint 값과 weight를 integer sequence encoding(trit / quint / bit)으로 채운 것
+ * 으로 이루어진다. 쓸 수 있는 조합은 block 크기마다 AstcCodec을 만들 때 미리 늘어놓고 예상 오차 순으로 줄 세운다.
+ *
+ * 압축은 CEM 0(회색), 4(회색 + alpha), 8(RGB), 12(RGBA) 직접 endpoint만 쓴다.
+ *   Fast       - partition 1개, 후보 조합 2개. build server용
+ *   Thorough   - 후보 조합 8개 + alpha가 따로 노는 block은 dual plane 3개 + 2 partition(2-means와 가장 닮은 seed 3개 x 조합 3개)
+ * 후보는 endpoint를 한 번만 맞춰 걸러 내고, 오차가 가장 작은 것(Thorough는 2개)만 endpoint와 weight를 여러 번 다듬는다.
+ * 모든 texel이 같으면 void extent block을 쓴다. HDR은 압축하지 않는다.
+ * 풀 때는 LDR CEM 전부와 partition 1 ~ 4, dual plane, void extent를 읽고 HDR endpoint는 error color(magenta)로 푼다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "TextureLoader.hpp"
+#include "ThreadPool.hpp"
+
+enum AstcQuality : uint32_t {
+	AstcQualityFast = 0,
+	AstcQualityThorough = 1,
+};
+
+// block 크기 하나의 표(weight 보간, partition, block mode)를 들고 block을 압축하고 푼다.
+class AstcCodec {
+	public:
+		AstcCodec(uint32_t blockWidth, uint32_t blockHeight);
+		// block 크기마다 하나씩 만들어 두고 같이 쓴다. 표를 만드는 데 1 ms쯤 걸린다.
+		static const AstcCodec& shared(uint32_t blockWidth, uint32_t blockHeight);
+
+		uint32_t blockWidth() const { return _blockWidth; }
+		uint32_t blockHeight() const { return _blockHeight; }
+
+		// texels는 blockWidth x blockHeight개 RGBA8(행 우선)이다. sRGB면 sRGB format으로 풀었을 때의 오차를 줄인다.
+		void encodeBlock(const uint8_t* texels, uint8_t out[16], AstcQuality quality, bool sRGB = false) const;
+		void decodeBlock(const uint8_t* in, uint8_t* texels, bool sRGB = false) const;
+
+	private:
+		// weight grid 한 크기의 bilinear 보간 표. texel마다 grid 점 4개와 그 비율(합 16)
+		struct Grid {
+			std::vector<std::array<uint8_t, 4>> indices;
+			std::vector<std::array<uint8_t, 4>> factors;
+		};
+		struct Candidate {
+			uint8_t gridWidth;
+			uint8_t gridHeight;
+			uint8_t weightRange;
+			uint8_t colorRange;
+			uint16_t blockMode;
+			float estimate;
+		};
+		// 실제로 압축해 볼 조합. ccs는 dual plane에서 두 번째 weight를 쓰는 채널이고 없으면 -1
+		struct Trial {
+			const Candidate* candidate;
+			int cem;
+			int partitions;
+			int seed;
+			int ccs;
+		};
+		struct Encoding;
+		struct Texels;
+
+		const Grid& grid(uint32_t width, uint32_t height) const { return _grids[width * 13 + height]; }
+		void evaluate(const Texels& texels, const Trial& trial, int iterations, bool sRGB, Encoding& best) const;
+		void bestSeeds(const Texels& texels, int cem, int count, int* seeds) const;
+		void write(const Encoding& encoding, uint8_t out[16]) const;
+
+		uint32_t _blockWidth;
+		uint32_t _blockHeight;
+		std::vector<Grid> _grids;
+		// 2 partition seed마다 partition 1에 속하는 texel의 bit
+		std::vector<std::array<uint64_t, 3>> _partitionMasks;
+		// [CEM 0 / 4 / 8 / 12][partition 수 - 1][dual plane]
+		std::vector<Candidate> _candidates[4][2][2];
+};
+
+bool isAstcTextureFormat(TextureFormat format);
+
+/*
+ * rgba는 width x height RGBA8 image이고 한 줄은 rowPitch byte이다. 가장자리 block은 마지막 texel을 반복해서 채운다.
+ * blocks에는 block 순서(행 우선)로 16 byte씩 쓴다. ASTC LDR / sRGB format이 아니면 이유를 출력하고 false를 반환한다.
+ * */
+bool encodeAstc(TextureFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, uint8_t* blocks,
+		AstcQuality quality = AstcQualityFast, ThreadPool& pool = ThreadPool::shared());
+bool decodeAstc(TextureFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba, size_t rowPitch,
+		ThreadPool& pool = ThreadPool::shared());
+
+// RGBA8 / BGRA8 texture의 모든 subresource를 ASTC로 압축한다. 원본이 sRGB면 ASTC도 sRGB format이 된다.
+bool compressTextureAstc(const TextureData& source, TextureFormat format, TextureData& compressed, AstcQuality quality = AstcQualityFast,
+		ThreadPool& pool = ThreadPool::shared());
+
+#pragma region AstcBits {
+
+namespace AstcDetail {
+
+// integer sequence encoding 범위. 값의 개수가 3 x 2^n(trit), 5 x 2^n(quint), 2^n(bit)이다.
+struct IseRange {
+	uint8_t trits;
+	uint8_t quints;
+	uint8_t bits;
+	uint16_t levels;
+};
+
+constexpr IseRange kIseRanges[21] = {
+	{ 0, 0, 1, 2 }, { 1, 0, 0, 3 }, { 0, 0, 2, 4 }, { 0, 1, 0, 5 }, { 1, 0, 1, 6 }, { 0, 0, 3, 8 }, { 0, 1, 1, 10 },
+	{ 1, 0, 2, 12 }, { 0, 0, 4, 16 }, { 0, 1, 2, 20 }, { 1, 0, 3, 24 }, { 0, 0, 5, 32 }, { 0, 1, 3, 40 }, { 1, 0, 4, 48 },
+	{ 0, 0, 6, 64 }, { 0, 1, 4, 80 }, { 1, 0, 5, 96 }, { 0, 0, 7, 128 }, { 0, 1, 5, 160 }, { 1, 0, 6, 192 }, { 0, 0, 8, 256 },
+};
+
+// weight는 0 ~ 11번 범위, endpoint 값은 4번(0 ~ 5)부터 쓴다.
+constexpr int kWeightRanges = 12;
+constexpr int kFirstColorRange = 4;
+
+inline uint32_t iseBitCount(int range, uint32_t count)
+{
+	const IseRange& ise = kIseRanges[range];
+	return ise.bits * count + (ise.trits ? (8 * count + 4) / 5 : 0) + (ise.quints ? (7 * count + 2) / 3 : 0);
+}
+
+// bits 안에 들어가는 가장 큰 endpoint 범위. 없으면 -1
+inline int colorRangeFor(uint32_t count, int bits)
+{
+	for (int range = 20; range >= kFirstColorRange; --range) {
+		if (int(iseBitCount(range, count)) <= bits) {
+			return range;
+		}
+	}
+	return -1;
+}
+
+// 16 byte block 안의 bit를 64 bit 두 개로 읽고 쓴다. count는 32 이하이다.
+inline void writeBits(uint8_t* out, uint32_t& position, uint32_t value, uint32_t count)
+{
+	uint64_t words[2];
+	std::memcpy(words, out, 16);
+	const uint64_t bits = uint64_t(value) & ((uint64_t(1) << count) - 1);
+	if (position < 64) {
+		words[0] |= bits << position;
+		if (position + count > 64) {
+			words[1] |= bits >> (64 - position);
+		}
+	} else {
+		words[1] |= bits << (position - 64);
+	}
+	std::memcpy(out, words, 16);
+	position += count;
+}
+
+inline uint32_t readBits(const uint8_t* in, uint32_t& position, uint32_t count)
+{
+	uint64_t words[2];
+	std::memcpy(words, in, 16);
+	uint64_t bits;
+	if (position < 64) {
+		bits = words[0] >> position;
+		if (position + count > 64) {
+			bits |= words[1] << (64 - position);
+		}
+	} else {
+		bits = words[1] >> (position - 64);
+	}
+	position += count;
+	return uint32_t(bits & ((uint64_t(1) << count) - 1));
+}
+
+// block의 bit 순서를 뒤집는다. out의 bit i가 in의 bit 127 - i이다.
+inline void reverseBits(const uint8_t* in, uint8_t* out)
+{
+	for (int i = 0; i < 16; ++i) {
+		uint8_t b = in[15 - i];
+		b = uint8_t((b & 0xF0) >> 4 | (b & 0x0F) << 4);
+		b = uint8_t((b & 0xCC) >> 2 | (b & 0x33) << 2);
+		out[i] = uint8_t((b & 0xAA) >> 1 | (b & 0x55) << 1);
+	}
+}
+
+// trit 5개를 8 bit, quint 3개를 7 bit에 담는 표. 인코딩 표는 디코딩 표를 뒤집어 만든다.
+struct IseTables {
+	uint8_t trits[256][5];
+	uint8_t tritBlocks[243];
+	uint8_t quints[128][3];
+	uint8_t quintBlocks[125];
+
+	IseTables()
+	{
+		for (int t = 255; t >= 0; --t) {
+			auto bit = [t](int i) { return (t >> i) & 1; };
+			int c, t3, t4;
+			if (((t >> 2) & 7) == 7) {
+				c = ((t >> 5) & 7) << 2 | (t & 3);
+				t4 = 2;
+				t3 = 2;
+			} else {
+				c = t & 0x1F;
+				if (((t >> 5) & 3) == 3) {
+					t4 = 2;
+					t3 = bit(7);
+				} else {
+					t4 = bit(7);
+					t3 = (t >> 5) & 3;
+				}
+			}
+			int t0, t1, t2;
+			if ((c & 3) == 3) {
+				t2 = 2;
+				t1 = (c >> 4) & 1;
+				t0 = ((c >> 3) & 1) << 1 | (((c >> 2) & 1) & ~((c >> 3) & 1));
+			} else if (((c >> 2) & 3) == 3) {
+				t2 = 2;
+				t1 = 2;
+				t0 = c & 3;
+			} else {
+				t2 = (c >> 4) & 1;
+				t1 = (c >> 2) & 3;
+				t0 = ((c >> 1) & 1) << 1 | ((c & 1) & ~((c >> 1) & 1));
+			}
+			const uint8_t values[5] = { uint8_t(t0), uint8_t(t1), uint8_t(t2), uint8_t(t3), uint8_t(t4) };
+			std::memcpy(trits[t], values, 5);
+			// 같은 값을 내는 block 중 가장 작은 것을 쓴다. 뒤쪽 trit이 0이면 뒤쪽 bit도 0이라 잘린 묶음을 쓸 수 있다.
+			tritBlocks[t0 + 3 * t1 + 9 * t2 + 27 * t3 + 81 * t4] = uint8_t(t);
+		}
+		for (int q = 127; q >= 0; --q) {
+			auto bit = [q](int i) { return (q >> i) & 1; };
+			int q0, q1, q2;
+			if (((q >> 1) & 3) == 3 && ((q >> 5) & 3) == 0) {
+				q2 = bit(0) << 2 | (bit(4) & ~bit(0)) << 1 | (bit(3) & ~bit(0));
+				q1 = 4;
+				q0 = 4;
+			} else {
+				int c;
+				if (((q >> 1) & 3) == 3) {
+					q2 = 4;
+					c = ((q >> 3) & 3) << 3 | (~(q >> 5) & 3) << 1 | bit(0);
+				} else {
+					q2 = (q >> 5) & 3;
+					c = q & 0x1F;
+				}
+				if ((c & 7) == 5) {
+					q1 = 4;
+					q0 = (c >> 3) & 3;
+				} else {
+					q1 = (c >> 3) & 3;
+					q0 = c & 7;
+				}
+			}
+			quints[q][0] = uint8_t(q0);
+			quints[q][1] = uint8_t(q1);
+			quints[q][2] = uint8_t(q2);
+			quintBlocks[q0 + 5 * q1 + 25 * q2] = uint8_t(q);
+		}
+	}
+};
+
+inline const IseTables& iseTables()
+{
+	static const IseTables tables;
+	return tables;
+}
+
+// trit 묶음은 값마다 (bit 부분, T의 2 / 2 / 1 / 2 / 1 bit), quint 묶음은 (bit 부분, Q의 3 / 2 / 2 bit) 순서로 놓인다.
+constexpr uint8_t kTritBits[5] = { 2, 2, 1, 2, 1 };
+constexpr uint8_t kQuintBits[3] = { 3, 2, 2 };
+
+inline void writeIse(uint8_t* out, uint32_t& position, int range, const uint8_t* values, uint32_t count)
+{
+	const IseRange& ise = kIseRanges[range];
+	const uint32_t mask = (1u << ise.bits) - 1;
+	const uint32_t group = ise.trits ? 5 : (ise.quints ? 3 : 1);
+	for (uint32_t first = 0; first < count; first += group) {
+		const uint32_t n = std::min(group, count - first);
+		uint32_t packed = 0;
+		for (uint32_t k = n; k-- > 0;) {
+			packed = packed * (ise.trits ? 3 : 5) + (values[first + k] >> ise.bits);
+		}
+		if (ise.trits) {
+			packed = iseTables().tritBlocks[packed];
+		} else if (ise.quints) {
+			packed = iseTables().quintBlocks[packed];
+		}
+		for (uint32_t k = 0; k < n; ++k) {
+			writeBits(out, position, values[first + k] & mask, ise.bits);
+			const uint32_t extra = ise.trits ? kTritBits[k] : (ise.quints ? kQuintBits[k] : 0);
+			writeBits(out, position, packed & ((1u << extra) - 1), extra);
+			packed >>= extra;
+		}
+	}
+}
+
+inline void readIse(const uint8_t* in, uint32_t& position, int range, uint8_t* values, uint32_t count)
+{
+	const IseRange& ise = kIseRanges[range];
+	const uint32_t group = ise.trits ? 5 : (ise.quints ? 3 : 1);
+	for (uint32_t first = 0; first < count; first += group) {
+		const uint32_t n = std::min(group, count - first);
+		uint32_t packed = 0, shift = 0;
+		uint32_t low[5];
+		for (uint32_t k = 0; k < n; ++k) {
+			low[k] = readBits(in, position, ise.bits);
+			const uint32_t extra = ise.trits ? kTritBits[k] : (ise.quints ? kQuintBits[k] : 0);
+			packed |= readBits(in, position, extra) << shift;
+			shift += extra;
+		}
+		for (uint32_t k = 0; k < n; ++k) {
+			uint32_t high = 0;
+			if (ise.trits) {
+				high = iseTables().trits[packed][k];
+			} else if (ise.quints) {
+				high = iseTables().quints[packed][k];
+			}
+			values[first + k] = uint8_t(high << ise.bits | low[k]);
+		}
+	}
+}
+
+// 값을 bits 폭에서 to 폭으로 bit를 반복해 늘린다.
+inline int replicateBits(int value, int bits, int to)
+{
+	int result = 0;
+	for (int filled = 0; filled < to; filled += bits) {
+		result = result << bits | value;
+	}
+	return result >> ((to + bits - 1) / bits * bits - to);
+}
+
+// weight 값을 0 ~ 64로 푼다.
+inline int unquantizeWeight(int range, int value)
+{
+	const IseRange& ise = kIseRanges[range];
+	int result;
+	if (!ise.trits && !ise.quints) {
+		result = replicateBits(value, ise.bits, 6);
+	} else if (ise.bits == 0) {
+		return value * (ise.trits ? 32 : 16);
+	} else {
+		const int high = value >> ise.bits, low = value & ((1 << ise.bits) - 1);
+		const int a = low & 1 ? 0x7F : 0, rest = low >> 1;
+		int b = 0, c = 0;
+		switch (range) {
+			case 4: c = 50; break;
+			case 6: c = 28; break;
+			case 7: b = rest * 0x45; c = 23; break;
+			case 9: b = rest * 0x42; c = 13; break;
+			default: b = rest << 5 | rest; c = 11; break;
+		}
+		result = ((high * c + b) ^ a);
+		result = (a & 0x20) | (result >> 2);
+	}
+	return result > 32 ? result + 1 : result;
+}
+
+// endpoint 값을 0 ~ 255로 푼다.
+inline int unquantizeColor(int range, int value)
+{
+	const IseRange& ise = kIseRanges[range];
+	if (!ise.trits && !ise.quints) {
+		return replicateBits(value, ise.bits, 8);
+	}
+	const int high = value >> ise.bits, low = value & ((1 << ise.bits) - 1);
+	const int a = low & 1 ? 0x1FF : 0, rest = low >> 1;
+	int b = 0, c = 0;
+	switch (range) {
+		case 4: c = 204; break;
+		case 6: c = 113; break;
+		case 7: b = rest * 0x116; c = 93; break;
+		case 9: b = rest * 0x10C; c = 54; break;
+		case 10: b = rest << 7 | rest << 2 | rest; c = 44; break;
+		case 12: b = rest << 7 | rest << 1 | rest >> 1; c = 26; break;
+		case 13: b = rest << 6 | rest; c = 22; break;
+		case 15: b = rest << 6 | rest >> 1; c = 13; break;
+		case 16: b = rest << 5 | rest >> 2; c = 11; break;
+		case 18: b = rest << 5 | rest >> 3; c = 6; break;
+		default: b = rest << 4 | rest >> 4; c = 5; break;
+	}
+	const int result = (high * c + b) ^ a;
+	return (a & 0x80) | (result >> 2);
+}
+
+// 범위마다 푼 값과, 푼 값이 가장 가까운 양자화 값
+struct QuantTables {
+	uint8_t colors[21][256];
+	uint8_t nearestColor[21][256];
+	uint8_t weights[kWeightRanges][32];
+	uint8_t nearestWeight[kWeightRanges][65];
+
+	QuantTables()
+	{
+		for (int range = 0; range < 21; ++range) {
+			const int levels = kIseRanges[range].levels;
+			for (int v = 0; v < levels; ++v) {
+				colors[range][v] = uint8_t(range >= kFirstColorRange ? unquantizeColor(range, v) : 0);
+				if (range < kWeightRanges) {
+					weights[range][v] = uint8_t(unquantizeWeight(range, v));
+				}
+			}
+			for (int target = 0; target < 256; ++target) {
+				int best = 0;
+				for (int v = 1; v < levels; ++v) {
+					if (std::abs(colors[range][v] - target) < std::abs(colors[range][best] - target)) {
+						best = v;
+					}
+				}
+				nearestColor[range][target] = uint8_t(best);
+			}
+			if (range < kWeightRanges) {
+				for (int target = 0; target <= 64; ++target) {
+					int best = 0;
+					for (int v = 1; v < levels; ++v) {
+						if (std::abs(weights[range][v] - target) < std::abs(weights[range][best] - target)) {
+							best = v;
+						}
+					}
+					nearestWeight[range][target] = uint8_t(best);
+				}
+			}
+		}
+	}
+};
+
+inline const QuantTables& quantTables()
+{
+	static const QuantTables tables;
+	return tables;
+}
+
+struct BlockMode {
+	int gridWidth{0};
+	int gridHeight{0};
+	int weightRange{0};
+	bool dualPlane{false};
+	bool valid{false};
+};
+
+// 11 bit block mode. void extent(하위 9 bit가 0x1FC)는 따로 본다.
+inline BlockMode decodeBlockMode(uint32_t mode)
+{
+	BlockMode result;
+	int r, a = (mode >> 5) & 3, b;
+	bool high = (mode >> 9) & 1;
+	result.dualPlane = (mode >> 10) & 1;
+	if (mode & 3) {
+		r = int((mode & 3) << 1 | ((mode >> 4) & 1));
+		b = (mode >> 7) & 3;
+		switch ((mode >> 2) & 3) {
+			case 0: result.gridWidth = b + 4; result.gridHeight = a + 2; break;
+			case 1: result.gridWidth = b + 8; result.gridHeight = a + 2; break;
+			case 2: result.gridWidth = a + 2; result.gridHeight = b + 8; break;
+			default:
+				if ((mode >> 8) & 1) {
+					result.gridWidth = (b & 1) + 2;
+					result.gridHeight = a + 2;
+				} else {
+					result.gridWidth = a + 2;
+					result.gridHeight = (b & 1) + 6;
+				}
+				break;
+		}
+	} else {
+		r = int(((mode >> 2) & 3) << 1 | ((mode >> 4) & 1));
+		b = (mode >> 9) & 3;
+		switch ((mode >> 7) & 3) {
+			case 0: result.gridWidth = 12; result.gridHeight = a + 2; break;
+			case 1: result.gridWidth = a + 2; result.gridHeight = 12; break;
+			case 2:
+				result.gridWidth = a + 6;
+				result.gridHeight = b + 6;
+				high = false;
+				result.dualPlane = false;
+				break;
+			default:
+				if (a > 1) {
+					return result;
+				}
+				result.gridWidth = a == 0 ? 6 : 10;
+				result.gridHeight = a == 0 ? 10 : 6;
+				break;
+		}
+	}
+	if (r < 2) {
+		return result;
+	}
+	result.weightRange = r - 2 + (high ? 6 : 0);
+	const uint32_t weights = uint32_t(result.gridWidth * result.gridHeight * (result.dualPlane ? 2 : 1));
+	const uint32_t bits = iseBitCount(result.weightRange, weights);
+	result.valid = weights <= 64 && bits >= 24 && bits <= 96;
+	return result;
+}
+
+inline uint32_t hash52(uint32_t p)
+{
+	p ^= p >> 15;
+	p -= p << 17;
+	p += p << 7;
+	p += p << 4;
+	p ^= p >> 5;
+	p += p << 16;
+	p ^= p >> 7;
+	p ^= p >> 3;
+	p ^= p << 6;
+	p ^= p >> 17;
+	return p;
+}
+
+// seed와 texel 위치로 partition을 정하는 ASTC의 hash
+inline int selectPartition(int seed, int x, int y, int partitions, bool smallBlock)
+{
+	if (smallBlock) {
+		x <<= 1;
+		y <<= 1;
+	}
+	seed += (partitions - 1) * 1024;
+	const uint32_t random = hash52(uint32_t(seed));
+	uint32_t seeds[12];
+	const int shifts[12] = { 0, 4, 8, 12, 16, 20, 24, 28, 18, 22, 26, 30 };
+	for (int i = 0; i < 12; ++i) {
+		seeds[i] = (i == 11 ? (random >> 30 | random << 2) : random >> shifts[i]) & 0xF;
+		seeds[i] *= seeds[i];
+	}
+	int shift1, shift2;
+	if (seed & 1) {
+		shift1 = seed & 2 ? 4 : 5;
+		shift2 = partitions == 3 ? 6 : 5;
+	} else {
+		shift1 = partitions == 3 ? 6 : 5;
+		shift2 = seed & 2 ? 4 : 5;
+	}
+	const int shift3 = seed & 0x10 ? shift1 : shift2;
+	for (int i = 0; i < 8; ++i) {
+		seeds[i] >>= (i & 1) ? shift2 : shift1;
+	}
+	for (int i = 8; i < 12; ++i) {
+		seeds[i] >>= shift3;
+	}
+	// 2D block이라 z 항은 0이다.
+	int a = int(seeds[0] * x + seeds[1] * y + (random >> 14)) & 0x3F;
+	int b = int(seeds[2] * x + seeds[3] * y + (random >> 10)) & 0x3F;
+	int c = partitions < 3 ? 0 : int(seeds[4] * x + seeds[5] * y + (random >> 6)) & 0x3F;
+	int d = partitions < 4 ? 0 : int(seeds[6] * x + seeds[7] * y + (random >> 2)) & 0x3F;
+	if (a >= b && a >= c && a >= d) {
+		return 0;
+	}
+	if (b >= c && b >= d) {
+		return 1;
+	}
+	return c >= d ? 2 : 3;
+}
+
+inline void blueContract(int color[4])
+{
+	color[0] = (color[0] + color[2]) >> 1;
+	color[1] = (color[1] + color[2]) >> 1;
+}
+
+inline void bitTransferSigned(int& a, int& b)
+{
+	b = (b >> 1) | (a & 0x80);
+	a = (a >> 1) & 0x3F;
+	if (a & 0x20) {
+		a -= 0x40;
+	}
+}
+
+inline int cemValueCount(int cem)
+{
+	return (cem / 4 + 1) * 2;
+}
+
+/*
+ * 푼 endpoint 값(0 ~ 255)으로 LDR endpoint 두 개를 만든다. HDR mode면 false.
+ * */
+inline bool decodeEndpoints(int cem, const int* v, int e0[4], int e1[4])
+{
+	auto set = [](int* e, int r, int g, int b, int a) {
+		e[0] = std::clamp(r, 0, 255);
+		e[1] = std::clamp(g, 0, 255);
+		e[2] = std::clamp(b, 0, 255);
+		e[3] = std::clamp(a, 0, 255);
+	};
+	switch (cem) {
+		case 0:
+			set(e0, v[0], v[0], v[0], 255);
+			set(e1, v[1], v[1], v[1], 255);
+			return true;
+		case 1: {
+			const int l0 = (v[0] >> 2) | (v[1] & 0xC0);
+			const int l1 = std::min(l0 + (v[1] & 0x3F), 255);
+			set(e0, l0, l0, l0, 255);
+			set(e1, l1, l1, l1, 255);
+			return true;
+		}
+		case 4:
+			set(e0, v[0], v[0], v[0], v[2]);
+			set(e1, v[1], v[1], v[1], v[3]);
+			return true;
+		case 5: {
+			int v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+			bitTransferSigned(v1, v0);
+			bitTransferSigned(v3, v2);
+			set(e0, v0, v0, v0, v2);
+			set(e1, v0 + v1, v0 + v1, v0 + v1, v2 + v3);
+			return true;
+		}
+		case 6:
+			set(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, 255);
+			set(e1, v[0], v[1], v[2], 255);
+			return true;
+		case 8:
+		case 12: {
+			const int a0 = cem == 12 ? v[6] : 255, a1 = cem == 12 ? v[7] : 255;
+			if (v[1] + v[3] + v[5] >= v[0] + v[2] + v[4]) {
+				set(e0, v[0], v[2], v[4], a0);
+				set(e1, v[1], v[3], v[5], a1);
+			} else {
+				set(e0, v[1], v[3], v[5], a1);
+				set(e1, v[0], v[2], v[4], a0);
+				blueContract(e0);
+				blueContract(e1);
+			}
+			return true;
+		}
+		case 9:
+		case 13: {
+			int v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3], v4 = v[4], v5 = v[5];
+			int v6 = cem == 13 ? v[6] : 255, v7 = 0;
+			bitTransferSigned(v1, v0);
+			bitTransferSigned(v3, v2);
+			bitTransferSigned(v5, v4);
+			if (cem == 13) {
+				v7 = v[7];
+				bitTransferSigned(v7, v6);
+			}
+			if (v1 + v3 + v5 >= 0) {
+				set(e0, v0, v2, v4, v6);
+				set(e1, v0 + v1, v2 + v3, v4 + v5, v6 + v7);
+			} else {
+				set(e0, v0 + v1, v2 + v3, v4 + v5, v6 + v7);
+				set(e1, v0, v2, v4, v6);
+				blueContract(e0);
+				blueContract(e1);
+			}
+			return true;
+		}
+		case 10:
+			set(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, v[4]);
+			set(e1, v[0], v[1], v[2], v[5]);
+			return true;
+		default:
+			return false;
+	}
+}
+
+// UNORM16으로 늘린 두 endpoint 사이를 weight(0 ~ 64)로 보간해 8 bit로 돌려준다.
+inline uint8_t interpolate(int e0, int e1, int weight, bool sRGB)
+{
+	const int c0 = sRGB ? (e0 << 8 | 0x80) : e0 * 257;
+	const int c1 = sRGB ? (e1 << 8 | 0x80) : e1 * 257;
+	const int c = (c0 * (64 - weight) + c1 * weight + 32) >> 6;
+	return uint8_t(sRGB ? c >> 8 : (c * 255 + 32767) / 65535);
+}
+
+inline bool isSrgbAstc(TextureFormat format)
+{
+	return format >= TextureFormatASTC_4x4_sRGB && format <= TextureFormatASTC_12x12_sRGB;
+}
+
+} // namespace AstcDetail
+
+#pragma endregion AstcBits }
+
+#pragma region AstcCodec {
+
+struct AstcCodec::Texels {
+	int count;
+	// 0 r, 1 g, 2 b, 3 a
+	float channels[4][144];
+	bool grey;
+	bool opaque;
+};
+
+struct AstcCodec::Encoding {
+	Trial trial{};
+	uint8_t colors[16]{};
+	uint8_t weights[64]{};
+	float error{1e30f};
+};
+
+inline AstcCodec::AstcCodec(uint32_t blockWidth, uint32_t blockHeight)
+	: _blockWidth(blockWidth), _blockHeight(blockHeight), _grids(13 * 13), _partitionMasks(1024)
+{
+	using namespace AstcDetail;
+	const int texels = int(blockWidth * blockHeight);
+	// 스펙의 infill 절차. grid 좌표를 1/16 단위로 구한 뒤 주변 네 점의 비율을 정한다.
+	for (uint32_t gridWidth = 2; gridWidth <= blockWidth; ++gridWidth) {
+		for (uint32_t gridHeight = 2; gridHeight <= blockHeight; ++gridHeight) {
+			Grid& table = _grids[gridWidth * 13 + gridHeight];
+			table.indices.resize(size_t(texels));
+			table.factors.resize(size_t(texels));
+			const int ds = (1024 + int(blockWidth) / 2) / int(blockWidth - 1);
+			const int dt = (1024 + int(blockHeight) / 2) / int(blockHeight - 1);
+			for (int t = 0; t < texels; ++t) {
+				const int s = t % int(blockWidth), u = t / int(blockWidth);
+				const int gs = (ds * s * int(gridWidth - 1) + 32) >> 6;
+				const int gt = (dt * u * int(gridHeight - 1) + 32) >> 6;
+				const int js = gs >> 4, fs = gs & 0xF, jt = gt >> 4, ft = gt & 0xF;
+				const int w11 = (fs * ft + 8) >> 4;
+				const int nextS = std::min(js + 1, int(gridWidth) - 1), nextT = std::min(jt + 1, int(gridHeight) - 1);
+				table.indices[size_t(t)] = { uint8_t(jt * int(gridWidth) + js), uint8_t(jt * int(gridWidth) + nextS),
+					uint8_t(nextT * int(gridWidth) + js), uint8_t(nextT * int(gridWidth) + nextS) };
+				table.factors[size_t(t)] = { uint8_t(16 - fs - ft + w11), uint8_t(fs - w11), uint8_t(ft - w11), uint8_t(w11) };
+			}
+		}
+	}
+	for (int seed = 0; seed < 1024; ++seed) {
+		std::array<uint64_t, 3>& mask = _partitionMasks[size_t(seed)];
+		mask = {};
+		for (int t = 0; t < texels; ++t) {
+			if (selectPartition(seed, t % int(blockWidth), t / int(blockWidth), 2, texels < 31)) {
+				mask[size_t(t >> 6)] |= uint64_t(1) << (t & 63);
+			}
+		}
+	}
+	// 같은 grid / 범위 / dual plane을 내는 block mode 중 처음 것을 쓴다.
+	std::vector<int> modes(13 * 13 * 2 * kWeightRanges, -1);
+	for (uint32_t mode = 0; mode < 2048; ++mode) {
+		const BlockMode decoded = decodeBlockMode(mode);
+		if ((mode & 0x1FF) == 0x1FC || !decoded.valid || decoded.gridWidth > int(blockWidth) || decoded.gridHeight > int(blockHeight)) {
+			continue;
+		}
+		int& slot = modes[size_t(((decoded.gridWidth * 13 + decoded.gridHeight) * 2 + decoded.dualPlane) * kWeightRanges + decoded.weightRange)];
+		if (slot < 0) {
+			slot = int(mode);
+		}
+	}
+	for (int gridWidth = 2; gridWidth <= 12; ++gridWidth) {
+		for (int gridHeight = 2; gridHeight <= 12; ++gridHeight) {
+			for (int dual = 0; dual < 2; ++dual) {
+				for (int weightRange = 0; weightRange < kWeightRanges; ++weightRange) {
+					const int mode = modes[size_t(((gridWidth * 13 + gridHeight) * 2 + dual) * kWeightRanges + weightRange)];
+					if (mode < 0) {
+						continue;
+					}
+					const uint32_t weightBits = iseBitCount(weightRange, uint32_t(gridWidth * gridHeight * (dual + 1)));
+					for (int cemClass = 0; cemClass < 4; ++cemClass) {
+						for (int partitions = 1; partitions <= 2; ++partitions) {
+							const int config = (partitions == 1 ? 17 : 29) + (dual ? 2 : 0);
+							const int colorRange = colorRangeFor(uint32_t((cemClass + 1) * 2 * partitions), 128 - config - int(weightBits));
+							if (colorRange < 0) {
+								continue;
+							}
+							// 예상 오차 = grid를 늘릴 때 잃는 것 + weight 양자화 + endpoint 양자화 (채널당 제곱 오차)
+							const float texelsPerWeight = float(texels) / float(gridWidth * gridHeight);
+							const float weightStep = 96.0f / float(kIseRanges[weightRange].levels - 1);
+							const float colorStep = 255.0f / float(kIseRanges[colorRange].levels - 1);
+							const float estimate = 24.0f * (texelsPerWeight - 1.0f) + (weightStep * weightStep + colorStep * colorStep) / 12.0f;
+							_candidates[cemClass][partitions - 1][dual].push_back({ uint8_t(gridWidth), uint8_t(gridHeight), uint8_t(weightRange),
+								uint8_t(colorRange), uint16_t(mode), estimate });
+						}
+					}
+				}
+			}
+		}
+	}
+	for (auto& byClass : _candidates) {
+		for (auto& byPartitions : byClass) {
+			for (std::vector<Candidate>& list : byPartitions) {
+				std::stable_sort(list.begin(), list.end(), [](const Candidate& a, const Candidate& b) { return a.estimate < b.estimate; });
+			}
+		}
+	}
+}
+
+inline const AstcCodec& AstcCodec::shared(uint32_t blockWidth, uint32_t blockHeight)
+{
+	static std::mutex mutex;
+	static std::map<uint32_t, std::unique_ptr<AstcCodec>> codecs;
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<AstcCodec>& codec = codecs[blockWidth * 16 + blockHeight];
+	if (!codec) {
+		codec = std::make_unique<AstcCodec>(blockWidth, blockHeight);
+	}
+	return *codec;
+}
+
+namespace AstcDetail {
+
+// CEM마다 endpoint를 맞추는 채널. 회색 block은 r 하나로 밝기를 맞춘다.
+inline int cemChannels(int cem, int channels[4])
+{
+	switch (cem) {
+		case 0: channels[0] = 0; return 1;
+		case 4: channels[0] = 0; channels[1] = 3; return 2;
+		case 8: channels[0] = 0; channels[1] = 1; channels[2] = 2; return 3;
+		default: channels[0] = 0; channels[1] = 1; channels[2] = 2; channels[3] = 3; return 4;
+	}
+}
+
+// float endpoint를 CEM의 값 순서대로 양자화한다. RGB 직접 mode는 합이 작은 쪽이 앞에 오도록 뒤집는다. (아니면 blue contraction으로 풀린다)
+inline void quantizeEndpoints(int cem, int range, const float e0[4], const float e1[4], uint8_t* codes)
+{
+	const QuantTables& tables = quantTables();
+	auto quantize = [&](float value) { return tables.nearestColor[range][int(std::clamp(value, 0.0f, 255.0f) + 0.5f)]; };
+	int channels[4];
+	const int count = cemChannels(cem, channels);
+	for (int k = 0; k < count; ++k) {
+		codes[2 * k] = quantize(e0[channels[k]]);
+		codes[2 * k + 1] = quantize(e1[channels[k]]);
+	}
+	if (cem == 8 || cem == 12) {
+		int sums[2] = {};
+		for (int k = 0; k < 3; ++k) {
+			sums[0] += tables.colors[range][codes[2 * k]];
+			sums[1] += tables.colors[range][codes[2 * k + 1]];
+		}
+		if (sums[1] < sums[0]) {
+			for (int k = 0; k < count; ++k) {
+				std::swap(codes[2 * k], codes[2 * k + 1]);
+			}
+		}
+	}
+}
+
+// partition 안 texel의 주성분 방향 양 끝
+inline void fitLine(const float (*channels)[144], int count, const uint8_t* labels, int partition, const int* active, int activeCount,
+		float e0[4], float e1[4])
+{
+	float mean[4] = {}, n = 0.0f;
+	for (int t = 0; t < count; ++t) {
+		if (labels[t] == partition) {
+			for (int k = 0; k < activeCount; ++k) {
+				mean[k] += channels[active[k]][t];
+			}
+			n += 1.0f;
+		}
+	}
+	if (n == 0.0f) {
+		return;
+	}
+	for (int k = 0; k < activeCount; ++k) {
+		mean[k] /= n;
+	}
+	float covariance[4][4] = {};
+	for (int t = 0; t < count; ++t) {
+		if (labels[t] == partition) {
+			float d[4];
+			for (int k = 0; k < activeCount; ++k) {
+				d[k] = channels[active[k]][t] - mean[k];
+			}
+			for (int x = 0; x < activeCount; ++x) {
+				for (int y = 0; y < activeCount; ++y) {
+					covariance[x][y] += d[x] * d[y];
+				}
+			}
+		}
+	}
+	int largest = 0;
+	for (int k = 1; k < activeCount; ++k) {
+		if (covariance[k][k] > covariance[largest][largest]) {
+			largest = k;
+		}
+	}
+	float axis[4] = {};
+	for (int k = 0; k < activeCount; ++k) {
+		axis[k] = covariance[largest][k];
+	}
+	for (int iteration = 0; iteration < 6; ++iteration) {
+		float next[4] = {}, length = 0.0f;
+		for (int x = 0; x < activeCount; ++x) {
+			for (int y = 0; y < activeCount; ++y) {
+				next[x] += covariance[x][y] * axis[y];
+			}
+			length = std::max(length, std::fabs(next[x]));
+		}
+		if (length == 0.0f) {
+			break;
+		}
+		for (int k = 0; k < activeCount; ++k) {
+			axis[k] = next[k] / length;
+		}
+	}
+	float length = 0.0f;
+	for (int k = 0; k < activeCount; ++k) {
+		length += axis[k] * axis[k];
+	}
+	length = std::sqrt(length);
+	if (length == 0.0f) {
+		for (int k = 0; k < activeCount; ++k) {
+			e0[active[k]] = e1[active[k]] = mean[k];
+		}
+		return;
+	}
+	float low = 0.0f, high = 0.0f;
+	for (int t = 0; t < count; ++t) {
+		if (labels[t] == partition) {
+			float projection = 0.0f;
+			for (int k = 0; k < activeCount; ++k) {
+				projection += (channels[active[k]][t] - mean[k]) * axis[k] / length;
+			}
+			low = std::min(low, projection);
+			high = std::max(high, projection);
+		}
+	}
+	for (int k = 0; k < activeCount; ++k) {
+		e0[active[k]] = mean[k] + axis[k] / length * low;
+		e1[active[k]] = mean[k] + axis[k] / length * high;
+	}
+}
+
+// weight(0 ~ 64)가 정해졌을 때 오차 제곱합이 가장 작은 endpoint. 모두 같은 weight면 그대로 둔다.
+inline void fitLeastSquares(const float (*channels)[144], int count, const uint8_t* labels, int partition, const uint8_t* weights,
+		const int* active, int activeCount, float e0[4], float e1[4])
+{
+	float alpha2 = 0.0f, beta2 = 0.0f, alphaBeta = 0.0f, alphaX[4] = {}, betaX[4] = {};
+	for (int t = 0; t < count; ++t) {
+		if (labels[t] == partition) {
+			const float b = float(weights[t]) / 64.0f, a = 1.0f - b;
+			alpha2 += a * a;
+			beta2 += b * b;
+			alphaBeta += a * b;
+			for (int k = 0; k < activeCount; ++k) {
+				alphaX[k] += a * channels[active[k]][t];
+				betaX[k] += b * channels[active[k]][t];
+			}
+		}
+	}
+	const float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+	if (std::fabs(determinant) < 1e-4f) {
+		return;
+	}
+	for (int k = 0; k < activeCount; ++k) {
+		e0[active[k]] = std::clamp((alphaX[k] * beta2 - betaX[k] * alphaBeta) / determinant, 0.0f, 255.0f);
+		e1[active[k]] = std::clamp((betaX[k] * alpha2 - alphaX[k] * alphaBeta) / determinant, 0.0f, 255.0f);
+	}
+}
+
+} // namespace AstcDetail
+
+inline void AstcCodec::evaluate(const Texels& texels, const Trial& trial, int iterations, bool sRGB, Encoding& best) const
+{
+	using namespace AstcDetail;
+	const QuantTables& tables = quantTables();
+	const Candidate& candidate = *trial.candidate;
+	const int cem = trial.cem, partitions = trial.partitions, ccs = trial.ccs;
+	const int count = texels.count;
+	uint8_t labels[144] = {};
+	if (partitions == 2) {
+		const std::array<uint64_t, 3>& mask = _partitionMasks[size_t(trial.seed)];
+		for (int t = 0; t < count; ++t) {
+			labels[t] = uint8_t((mask[size_t(t >> 6)] >> (t & 63)) & 1);
+		}
+	}
+	int channels[4];
+	const int channelCount = cemChannels(cem, channels);
+	// plane마다 맞추는 채널. dual plane이면 ccs 채널만 두 번째 plane이다.
+	const int planes = ccs >= 0 ? 2 : 1;
+	int planeChannels[2][4], planeChannelCount[2] = {};
+	for (int k = 0; k < channelCount; ++k) {
+		const int plane = channels[k] == ccs ? 1 : 0;
+		planeChannels[plane][planeChannelCount[plane]++] = channels[k];
+	}
+	float e0[2][4] = {}, e1[2][4] = {};
+	for (int p = 0; p < partitions; ++p) {
+		for (int plane = 0; plane < planes; ++plane) {
+			fitLine(texels.channels, count, labels, p, planeChannels[plane], planeChannelCount[plane], e0[p], e1[p]);
+		}
+	}
+
+	const Grid& table = grid(candidate.gridWidth, candidate.gridHeight);
+	const int gridCount = candidate.gridWidth * candidate.gridHeight;
+	const bool fullGrid = gridCount == count;
+	const int colorCount = cemValueCount(cem);
+	Encoding encoding;
+	encoding.trial = trial;
+	for (int iteration = 0; iteration < iterations; ++iteration) {
+		int endpoints[2][2][4];
+		for (int p = 0; p < partitions; ++p) {
+			quantizeEndpoints(cem, candidate.colorRange, e0[p], e1[p], encoding.colors + p * colorCount);
+			int values[8];
+			for (int i = 0; i < colorCount; ++i) {
+				values[i] = tables.colors[candidate.colorRange][encoding.colors[p * colorCount + i]];
+			}
+			decodeEndpoints(cem, values, endpoints[p][0], endpoints[p][1]);
+		}
+
+		uint8_t texelWeights[2][144];
+		for (int plane = 0; plane < planes; ++plane) {
+			// 양자화한 endpoint 위로 투영한 이상적인 weight
+			float ideal[144];
+			for (int t = 0; t < count; ++t) {
+				const int* a = endpoints[labels[t]][0];
+				const int* b = endpoints[labels[t]][1];
+				float dot = 0.0f, length = 0.0f;
+				for (int k = 0; k < planeChannelCount[plane]; ++k) {
+					const int c = planeChannels[plane][k];
+					const float d = float(b[c] - a[c]);
+					dot += (texels.channels[c][t] - float(a[c])) * d;
+					length += d * d;
+				}
+				ideal[t] = length > 0.0f ? std::clamp(dot / length, 0.0f, 1.0f) * 64.0f : 0.0f;
+			}
+			// grid가 block보다 작으면 보간 비율을 거꾸로 써서 grid 값을 구하고, 보간한 결과와의 차이로 몇 번 고친다.
+			float gridValues[144];
+			if (fullGrid) {
+				std::copy(ideal, ideal + count, gridValues);
+			} else {
+				float sums[144] = {}, totals[144] = {};
+				for (int t = 0; t < count; ++t) {
+					for (int j = 0; j < 4; ++j) {
+						sums[table.indices[size_t(t)][size_t(j)]] += table.factors[size_t(t)][size_t(j)] * ideal[t];
+						totals[table.indices[size_t(t)][size_t(j)]] += table.factors[size_t(t)][size_t(j)];
+					}
+				}
+				for (int g = 0; g < gridCount; ++g) {
+					gridValues[g] = totals[g] > 0.0f ? sums[g] / totals[g] : 32.0f;
+				}
+				for (int step = 0; step < iterations; ++step) {
+					std::fill(sums, sums + gridCount, 0.0f);
+					for (int t = 0; t < count; ++t) {
+						float value = 0.0f;
+						for (int j = 0; j < 4; ++j) {
+							value += table.factors[size_t(t)][size_t(j)] * gridValues[table.indices[size_t(t)][size_t(j)]];
+						}
+						const float residual = ideal[t] - value / 16.0f;
+						for (int j = 0; j < 4; ++j) {
+							sums[table.indices[size_t(t)][size_t(j)]] += table.factors[size_t(t)][size_t(j)] * residual;
+						}
+					}
+					for (int g = 0; g < gridCount; ++g) {
+						if (totals[g] > 0.0f) {
+							gridValues[g] = std::clamp(gridValues[g] + sums[g] / totals[g], 0.0f, 64.0f);
+						}
+					}
+				}
+			}
+			int unquantized[144];
+			for (int g = 0; g < gridCount; ++g) {
+				const uint8_t code = tables.nearestWeight[candidate.weightRange][int(std::clamp(gridValues[g], 0.0f, 64.0f) + 0.5f)];
+				encoding.weights[g * planes + plane] = code;
+				unquantized[g] = tables.weights[candidate.weightRange][code];
+			}
+			for (int t = 0; t < count; ++t) {
+				if (fullGrid) {
+					texelWeights[plane][t] = uint8_t(unquantized[t]);
+					continue;
+				}
+				int value = 8;
+				for (int j = 0; j < 4; ++j) {
+					value += table.factors[size_t(t)][size_t(j)] * unquantized[table.indices[size_t(t)][size_t(j)]];
+				}
+				texelWeights[plane][t] = uint8_t(value >> 4);
+			}
+		}
+
+		// 디코더와 같은 식으로 풀어서 오차를 잰다.
+		float error = 0.0f;
+		for (int t = 0; t < count; ++t) {
+			const int* a = endpoints[labels[t]][0];
+			const int* b = endpoints[labels[t]][1];
+			for (int c = 0; c < 4; ++c) {
+				const int weight = texelWeights[c == ccs ? 1 : 0][t];
+				const float d = float(interpolate(a[c], b[c], weight, sRGB)) - texels.channels[c][t];
+				error += d * d;
+			}
+		}
+		encoding.error = error;
+		if (error < best.error) {
+			best = encoding;
+		}
+		if (error == 0.0f) {
+			break;
+		}
+		for (int p = 0; p < partitions; ++p) {
+			for (int plane = 0; plane < planes; ++plane) {
+				fitLeastSquares(texels.channels, count, labels, p, texelWeights[plane], planeChannels[plane], planeChannelCount[plane], e0[p], e1[p]);
+			}
+		}
+	}
+}
+
+// 2-means로 texel을 두 무리로 나누고 그 모양과 가장 닮은 partition seed를 고른다.
+inline void AstcCodec::bestSeeds(const Texels& texels, int cem, int count, int* seeds) const
+{
+	using namespace AstcDetail;
+	int channels[4];
+	const int channelCount = cemChannels(cem, channels);
+	uint8_t labels[144] = {};
+	float centers[2][4] = {};
+	fitLine(texels.channels, texels.count, labels, 0, channels, channelCount, centers[0], centers[1]);
+	std::array<uint64_t, 3> clusters{};
+	for (int iteration = 0; iteration < 3; ++iteration) {
+		float sums[2][4] = {}, n[2] = {};
+		clusters = {};
+		for (int t = 0; t < texels.count; ++t) {
+			float distances[2] = {};
+			for (int side = 0; side < 2; ++side) {
+				for (int k = 0; k < channelCount; ++k) {
+					const float d = texels.channels[channels[k]][t] - centers[side][channels[k]];
+					distances[side] += d * d;
+				}
+			}
+			const int side = distances[1] < distances[0] ? 1 : 0;
+			clusters[size_t(t >> 6)] |= uint64_t(side) << (t & 63);
+			for (int k = 0; k < channelCount; ++k) {
+				sums[side][channels[k]] += texels.channels[channels[k]][t];
+			}
+			n[side] += 1.0f;
+		}
+		for (int side = 0; side < 2; ++side) {
+			for (int k = 0; k < channelCount && n[side] > 0.0f; ++k) {
+				centers[side][channels[k]] = sums[side][channels[k]] / n[side];
+			}
+		}
+	}
+	int mismatches[1024];
+	int order[1024];
+	for (int seed = 0; seed < 1024; ++seed) {
+		const std::array<uint64_t, 3>& mask = _partitionMasks[size_t(seed)];
+		int ones = 0, different = 0;
+		for (size_t word = 0; word < 3; ++word) {
+			ones += __builtin_popcountll(mask[word]);
+			different += __builtin_popcountll(mask[word] ^ clusters[word]);
+		}
+		// 한쪽이 비면 partition 1개와 같다. 무리 번호는 바뀌어도 된다.
+		mismatches[seed] = ones == 0 || ones == texels.count ? texels.count + 1 : std::min(different, texels.count - different);
+		order[seed] = seed;
+	}
+	std::partial_sort(order, order + count, order + 1024, [&](int a, int b) { return mismatches[a] < mismatches[b]; });
+	std::copy(order, order + count, seeds);
+}
+
+inline void AstcCodec::write(const Encoding& encoding, uint8_t out[16]) const
+{
+	using namespace AstcDetail;
+	const Trial& trial = encoding.trial;
+	const Candidate& candidate = *trial.candidate;
+	std::memset(out, 0, 16);
+	uint32_t position = 0;
+	writeBits(out, position, candidate.blockMode, 11);
+	writeBits(out, position, uint32_t(trial.partitions - 1), 2);
+	if (trial.partitions == 1) {
+		writeBits(out, position, uint32_t(trial.cem), 4);
+	} else {
+		writeBits(out, position, uint32_t(trial.seed), 10);
+		// CEM selector 00: 모든 partition이 같은 CEM을 쓴다.
+		writeBits(out, position, uint32_t(trial.cem) << 2, 6);
+	}
+	writeIse(out, position, candidate.colorRange, encoding.colors, uint32_t(cemValueCount(trial.cem) * trial.partitions));
+
+	// weight는 block의 끝에서부터 bit 순서를 뒤집어 쓴다.
+	const uint32_t weightCount = uint32_t(candidate.gridWidth * candidate.gridHeight * (trial.ccs >= 0 ? 2 : 1));
+	const uint32_t weightBits = iseBitCount(candidate.weightRange, weightCount);
+	uint8_t weights[16] = {}, reversed[16];
+	uint32_t weightPosition = 0;
+	writeIse(weights, weightPosition, candidate.weightRange, encoding.weights, weightCount);
+	reverseBits(weights, reversed);
+	for (int i = 0; i < 16; ++i) {
+		out[i] |= reversed[i];
+	}
+	if (trial.ccs >= 0) {
+		position = 128 - weightBits - 2;
+		writeBits(out, position, uint32_t(trial.ccs), 2);
+	}
+}
+
+inline void AstcCodec::encodeBlock(const uint8_t* rgba, uint8_t out[16], AstcQuality quality, bool sRGB) const
+{
+	using namespace AstcDetail;
+	Texels texels;
+	texels.count = int(_blockWidth * _blockHeight);
+	texels.grey = true;
+	texels.opaque = true;
+	bool constant = true;
+	for (int t = 0; t < texels.count; ++t) {
+		const uint8_t* texel = rgba + 4 * t;
+		for (int c = 0; c < 4; ++c) {
+			texels.channels[c][t] = texel[c];
+		}
+		texels.grey = texels.grey && texel[0] == texel[1] && texel[1] == texel[2];
+		texels.opaque = texels.opaque && texel[3] == 255;
+		constant = constant && std::memcmp(texel, rgba, 4) == 0;
+	}
+	// void extent: 범위 좌표를 모두 1로 두고 UNORM16 색 하나를 쓴다.
+	if (constant) {
+		const uint64_t header = 0xFFFFFFFFFFFFFDFCull;
+		std::memcpy(out, &header, 8);
+		for (int c = 0; c < 4; ++c) {
+			const uint16_t value = uint16_t(rgba[c] * 257);
+			std::memcpy(out + 8 + 2 * c, &value, 2);
+		}
+		return;
+	}
+	const int cem = texels.grey ? (texels.opaque ? 0 : 4) : (texels.opaque ? 8 : 12);
+	const int cemClass = cem / 4;
+	// 후보를 endpoint 한 번만 맞춰서 걸러 내고, 가장 나은 것 몇 개만 여러 번 다듬는다.
+	Trial trials[24];
+	int trialCount = 0;
+	const std::vector<Candidate>& single = _candidates[cemClass][0][0];
+	for (size_t i = 0; i < std::min(single.size(), size_t(quality == AstcQualityFast ? 2 : 8)); ++i) {
+		trials[trialCount++] = { &single[i], cem, 1, 0, -1 };
+	}
+	if (quality == AstcQualityThorough) {
+		// alpha가 색과 따로 움직이면 alpha에 weight를 하나 더 준다.
+		const std::vector<Candidate>& dual = _candidates[cemClass][0][1];
+		for (size_t i = 0; !texels.opaque && i < std::min(dual.size(), size_t(3)); ++i) {
+			trials[trialCount++] = { &dual[i], cem, 1, 0, 3 };
+		}
+		const std::vector<Candidate>& partitioned = _candidates[cemClass][1][0];
+		if (!partitioned.empty()) {
+			int seeds[3];
+			bestSeeds(texels, cem, 3, seeds);
+			for (int seed : seeds) {
+				for (size_t i = 0; i < std::min(partitioned.size(), size_t(3)); ++i) {
+					trials[trialCount++] = { &partitioned[i], cem, 2, seed, -1 };
+				}
+			}
+		}
+	}
+	Encoding screened[24];
+	int order[24] = {};
+	for (int i = 0; i < trialCount; ++i) {
+		evaluate(texels, trials[i], 1, sRGB, screened[i]);
+		order[i] = i;
+	}
+	const int refined = std::min(trialCount, quality == AstcQualityFast ? 1 : 2);
+	std::partial_sort(order, order + refined, order + trialCount, [&](int x, int y) { return screened[x].error < screened[y].error; });
+	Encoding best = screened[order[0]];
+	for (int i = 0; i < refined && best.error > 0.0f; ++i) {
+		evaluate(texels, trials[order[i]], quality == AstcQualityFast ? 3 : 4, sRGB, best);
+	}
+	write(best, out);
+}
+
+inline void AstcCodec::decodeBlock(const uint8_t* in, uint8_t* rgba, bool sRGB) const
+{
+	using namespace AstcDetail;
+	const int count = int(_blockWidth * _blockHeight);
+	auto fail = [&] {
+		for (int t = 0; t < count; ++t) {
+			rgba[4 * t] = 255;
+			rgba[4 * t + 1] = 0;
+			rgba[4 * t + 2] = 255;
+			rgba[4 * t + 3] = 255;
+		}
+	};
+	uint32_t position = 0;
+	const uint32_t mode = readBits(in, position, 11);
+	if ((mode & 0x1FF) == 0x1FC) {
+		// HDR void extent는 LDR로 풀 수 없다.
+		if (mode & 0x200) {
+			fail();
+			return;
+		}
+		uint8_t color[4];
+		for (int c = 0; c < 4; ++c) {
+			uint16_t value;
+			std::memcpy(&value, in + 8 + 2 * c, 2);
+			color[c] = uint8_t(sRGB ? value >> 8 : (uint32_t(value) * 255 + 32767) / 65535);
+		}
+		for (int t = 0; t < count; ++t) {
+			std::memcpy(rgba + 4 * t, color, 4);
+		}
+		return;
+	}
+	const BlockMode blockMode = decodeBlockMode(mode);
+	if (!blockMode.valid || blockMode.gridWidth > int(_blockWidth) || blockMode.gridHeight > int(_blockHeight)) {
+		fail();
+		return;
+	}
+	const int partitions = int(readBits(in, position, 2)) + 1;
+	const int planes = blockMode.dualPlane ? 2 : 1;
+	const uint32_t weightCount = uint32_t(blockMode.gridWidth * blockMode.gridHeight * planes);
+	const uint32_t weightBits = iseBitCount(blockMode.weightRange, weightCount);
+	if (blockMode.dualPlane && partitions == 4) {
+		fail();
+		return;
+	}
+	int cems[4] = {};
+	int seed = 0;
+	uint32_t extraBits = 0;
+	if (partitions == 1) {
+		cems[0] = int(readBits(in, position, 4));
+	} else {
+		seed = int(readBits(in, position, 10));
+		const uint32_t cemBits = readBits(in, position, 6);
+		const uint32_t selector = cemBits & 3;
+		if (selector == 0) {
+			std::fill(cems, cems + partitions, int(cemBits >> 2));
+		} else {
+			// partition마다 class 1 bit와 mode 2 bit. 4 bit를 넘는 부분은 weight 바로 아래에 있다.
+			extraBits = uint32_t(3 * partitions - 4);
+			uint32_t extraPosition = 128 - weightBits - extraBits;
+			const uint32_t value = (cemBits >> 2) | readBits(in, extraPosition, extraBits) << 4;
+			for (int p = 0; p < partitions; ++p) {
+				const int base = int(selector) - 1 + int((value >> p) & 1);
+				cems[p] = base << 2 | int((value >> (partitions + 2 * p)) & 3);
+			}
+		}
+	}
+	int colorCount = 0;
+	for (int p = 0; p < partitions; ++p) {
+		colorCount += cemValueCount(cems[p]);
+	}
+	const int configBits = int(position + extraBits) + (blockMode.dualPlane ? 2 : 0);
+	const int colorRange = colorRangeFor(uint32_t(colorCount), 128 - int(weightBits) - configBits);
+	if (colorCount > 18 || colorRange < 0) {
+		fail();
+		return;
+	}
+	int ccs = -1;
+	if (blockMode.dualPlane) {
+		uint32_t ccsPosition = 128 - weightBits - extraBits - 2;
+		ccs = int(readBits(in, ccsPosition, 2));
+	}
+	uint8_t colors[18];
+	readIse(in, position, colorRange, colors, uint32_t(colorCount));
+	const QuantTables& tables = quantTables();
+	int endpoints[4][2][4];
+	for (int p = 0, first = 0; p < partitions; first += cemValueCount(cems[p]), ++p) {
+		int values[8];
+		for (int i = 0; i < cemValueCount(cems[p]); ++i) {
+			values[i] = tables.colors[colorRange][colors[first + i]];
+		}
+		if (!decodeEndpoints(cems[p], values, endpoints[p][0], endpoints[p][1])) {
+			fail();
+			return;
+		}
+	}
+
+	uint8_t reversed[16];
+	reverseBits(in, reversed);
+	uint8_t codes[64];
+	uint32_t weightPosition = 0;
+	readIse(reversed, weightPosition, blockMode.weightRange, codes, weightCount);
+	int unquantized[2][64];
+	for (uint32_t i = 0; i < weightCount; ++i) {
+		unquantized[i % uint32_t(planes)][i / uint32_t(planes)] = tables.weights[blockMode.weightRange][codes[i]];
+	}
+	const Grid& table = grid(uint32_t(blockMode.gridWidth), uint32_t(blockMode.gridHeight));
+	const bool smallBlock = count < 31;
+	for (int t = 0; t < count; ++t) {
+		int weights[2] = {};
+		for (int plane = 0; plane < planes; ++plane) {
+			int value = 8;
+			for (int j = 0; j < 4; ++j) {
+				value += table.factors[size_t(t)][size_t(j)] * unquantized[plane][table.indices[size_t(t)][size_t(j)]];
+			}
+			weights[plane] = value >> 4;
+		}
+		int partition = 0;
+		if (partitions == 2) {
+			partition = int((_partitionMasks[size_t(seed)][size_t(t >> 6)] >> (t & 63)) & 1);
+		} else if (partitions > 2) {
+			partition = selectPartition(seed, t % int(_blockWidth), t / int(_blockWidth), partitions, smallBlock);
+		}
+		for (int c = 0; c < 4; ++c) {
+			rgba[4 * t + c] = interpolate(endpoints[partition][0][c], endpoints[partition][1][c], weights[c == ccs ? 1 : 0], sRGB);
+		}
+	}
+}
+
+#pragma endregion AstcCodec }
+
+#pragma region AstcImage {
+
+inline bool isAstcTextureFormat(TextureFormat format)
+{
+	// 세 묶음 모두 6x6 다음 한 자리(191, 209, 227)가 비어 있다.
+	for (uint32_t first : { uint32_t(TextureFormatASTC_4x4_sRGB), uint32_t(TextureFormatASTC_4x4_LDR), uint32_t(TextureFormatASTC_4x4_HDR) }) {
+		if (format >= first && format <= first + 14 && format != first + 5) {
+			return true;
+		}
+	}
+	return false;
+}
+
+namespace AstcDetail {
+
+inline bool checkFormat(TextureFormat format)
+{
+	if (!isAstcTextureFormat(format)) {
+		std::cerr << "ASTC: pixel format " << format << " is not ASTC" << std::endl;
+		return false;
+	}
+	if (format >= TextureFormatASTC_4x4_HDR) {
+		std::cerr << "ASTC: HDR formats are not supported" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+} // namespace AstcDetail
+
+inline bool encodeAstc(TextureFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, uint8_t* blocks,
+		AstcQuality quality, ThreadPool& pool)
+{
+	if (!AstcDetail::checkFormat(format)) {
+		return false;
+	}
+	const TextureFormatInfo info = textureFormatInfo(format);
+	const AstcCodec& codec = AstcCodec::shared(info.blockWidth, info.blockHeight);
+	const bool sRGB = AstcDetail::isSrgbAstc(format);
+	const uint32_t blocksWide = (width + info.blockWidth - 1) / info.blockWidth;
+	const uint32_t blocksHigh = (height + info.blockHeight - 1) / info.blockHeight;
+	pool.parallelFor(blocksHigh, 1, [&](size_t begin, size_t end) {
+		uint8_t texels[144 * 4];
+		for (size_t by = begin; by < end; ++by) {
+			for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+				for (uint32_t t = 0; t < info.blockWidth * info.blockHeight; ++t) {
+					const uint32_t x = std::min(bx * info.blockWidth + t % info.blockWidth, width - 1);
+					const uint32_t y = std::min(uint32_t(by) * info.blockHeight + t / info.blockWidth, height - 1);
+					std::memcpy(texels + 4 * t, rgba + y * rowPitch + x * 4, 4);
+				}
+				codec.encodeBlock(texels, blocks + (by * blocksWide + bx) * 16, quality, sRGB);
+			}
+		}
+	});
+	return true;
+}
+
+inline bool decodeAstc(TextureFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba, size_t rowPitch, ThreadPool& pool)
+{
+	if (!AstcDetail::checkFormat(format)) {
+		return false;
+	}
+	const TextureFormatInfo info = textureFormatInfo(format);
+	const AstcCodec& codec = AstcCodec::shared(info.blockWidth, info.blockHeight);
+	const bool sRGB = AstcDetail::isSrgbAstc(format);
+	const uint32_t blocksWide = (width + info.blockWidth - 1) / info.blockWidth;
+	const uint32_t blocksHigh = (height + info.blockHeight - 1) / info.blockHeight;
+	pool.parallelFor(blocksHigh, 1, [&](size_t begin, size_t end) {
+		uint8_t texels[144 * 4];
+		for (size_t by = begin; by < end; ++by) {
+			for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+				codec.decodeBlock(blocks + (by * blocksWide + bx) * 16, texels, sRGB);
+				for (uint32_t t = 0; t < info.blockWidth * info.blockHeight; ++t) {
+					const uint32_t x = bx * info.blockWidth + t % info.blockWidth, y = uint32_t(by) * info.blockHeight + t / info.blockWidth;
+					if (x < width && y < height) {
+						std::memcpy(rgba + y * rowPitch + x * 4, texels + 4 * t, 4);
+					}
+				}
+			}
+		}
+	});
+	return true;
+}
+
+inline bool compressTextureAstc(const TextureData& source, TextureFormat format, TextureData& compressed, AstcQuality quality, ThreadPool& pool)
+{
+	const TextureLayout& layout = source.layout;
+	const bool bgra = layout.format == TextureFormatBGRA8Unorm || layout.format == TextureFormatBGRA8Unorm_sRGB;
+	const bool sRGB = layout.format == TextureFormatRGBA8Unorm_sRGB || layout.format == TextureFormatBGRA8Unorm_sRGB;
+	if (!bgra && layout.format != TextureFormatRGBA8Unorm && layout.format != TextureFormatRGBA8Unorm_sRGB) {
+		std::cerr << "ASTC: source texture must be RGBA8 or BGRA8" << std::endl;
+		return false;
+	}
+	if (layout.type == TextureType3D) {
+		std::cerr << "ASTC: 3D textures cannot be block compressed" << std::endl;
+		return false;
+	}
+	if (!AstcDetail::checkFormat(format)) {
+		return false;
+	}
+	// sRGB 묶음은 LDR 묶음보다 18 앞에 있다.
+	const bool sRGBFormat = AstcDetail::isSrgbAstc(format);
+	if (sRGB && !sRGBFormat) {
+		format = TextureFormat(format - (TextureFormatASTC_4x4_LDR - TextureFormatASTC_4x4_sRGB));
+	} else if (!sRGB && sRGBFormat) {
+		format = TextureFormat(format + (TextureFormatASTC_4x4_LDR - TextureFormatASTC_4x4_sRGB));
+	}
+	compressed.layout = makeTextureLayout(format, layout.width, layout.height, layout.levels, layout.layers, layout.faces);
+	compressed.bytes.assign(size_t(compressed.layout.totalSize()), 0);
+	std::vector<uint8_t> swizzled;
+	for (const TextureSubresource& subresource : layout.subresources) {
+		const uint8_t* pixels = source.bytes.data() + subresource.offset;
+		if (bgra) {
+			swizzled.assign(pixels, pixels + subresource.size);
+			for (size_t i = 0; i + 4 <= swizzled.size(); i += 4) {
+				std::swap(swizzled[i], swizzled[i + 2]);
+			}
+			pixels = swizzled.data();
+		}
+		encodeAstc(format, pixels, subresource.width, subresource.height, subresource.bytesPerRow,
+				compressed.data(subresource.level, subresource.slice), quality, pool);
+	}
+	return true;
+}
+
+#pragma endregion AstcImage }
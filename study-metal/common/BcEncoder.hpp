@@ -0,0 +1,1246 @@
+/*
+ * BcEncoder.hpp
+ *
+ * RGBA8 image를 BC1 / BC2 / BC3 / BC4 / BC5 / BC7 block으로 압축하고, 확인용으로 다시 푼다.
+ * 4x4 block 하나를 float SoA(BcBlock)로 읽어
+ *  - endpoint는 주성분(PCA) 방향의 양 끝에서 시작해 least squares로 다듬고
+ *  - index는 palette 전체와의 거리를 Lanes8로 8 pixel씩 계산한다. 거리는 정수이므로 "거리 x 16 + index"를
+ *    float 하나로 만들어 min 한 번으로 가장 가까운 index까지 고른다. (2^24 안이라 정확하다)
+ * block 줄은 ThreadPool에서 나누어 압축한다.
+ *
+ * BC7은 mode 6(1 subset RGBA, 4 bit index)과 불투명 block의 mode 1 / 3(2 subset)을 만든다.
+ * 2 subset의 partition은 64개 중 subset별 공분산의 잔차가 작은 것부터 몇 개만 실제로 압축해 본다.
+ * 풀 때는 8개 mode를 모두 읽는다.
+ *
+ * BcQuality
+ *   Fast   - endpoint 한 번 다듬기, BC7은 mode 6만
+ *   Normal - 두 번 다듬기, BC4 6 값 mode, BC7 mode 1 (partition 후보 2개)
+ *   High   - 세 번 다듬기 + endpoint 주변 탐색, BC1 3 색 mode, BC7 mode 1 / 3 (partition 후보 6개)
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "Simd.hpp"
+#include "TextureLoader.hpp"
+#include "ThreadPool.hpp"
+
+enum BcQuality : uint32_t {
+	BcQualityFast = 0,
+	BcQualityNormal = 1,
+	BcQualityHigh = 2,
+};
+
+// 4x4 block 하나. pixel i는 (i % 4, i / 4)이고 값은 0 ~ 255인 정수이다.
+struct BcBlock {
+	alignas(32) float r[16];
+	alignas(32) float g[16];
+	alignas(32) float b[16];
+	alignas(32) float a[16];
+};
+
+bool canEncodeBc(TextureFormat format);
+bool canDecodeBc(TextureFormat format);
+
+/*
+ * rgba는 width x height RGBA8 image이고 한 줄은 rowPitch byte이다. 가장자리 block은 마지막 pixel을 반복해서 채운다.
+ * blocks에는 block 순서(행 우선)로 ceil(width / 4) x ceil(height / 4)개 block을 쓴다.
+ * BC4는 R, BC5는 R, G만 쓴다. 압축할 수 없는 format이면 이유를 출력하고 false를 반환한다.
+ * */
+bool encodeBc(TextureFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, uint8_t* blocks,
+		BcQuality quality = BcQualityNormal, ThreadPool& pool = ThreadPool::shared());
+// BC4는 (R, 0, 0, 255), BC5는 (R, G, 0, 255)로 푼다.
+bool decodeBc(TextureFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba, size_t rowPitch,
+		ThreadPool& pool = ThreadPool::shared());
+
+void encodeBc1Block(const BcBlock& block, uint8_t out[8], BcQuality quality, bool allowTransparent = true);
+void encodeBc2Block(const BcBlock& block, uint8_t out[16], BcQuality quality);
+void encodeBc3Block(const BcBlock& block, uint8_t out[16], BcQuality quality);
+void encodeBc4Block(const float values[16], uint8_t out[8], BcQuality quality);
+void encodeBc5Block(const BcBlock& block, uint8_t out[16], BcQuality quality);
+void encodeBc7Block(const BcBlock& block, uint8_t out[16], BcQuality quality);
+
+// rgba는 pixel 16개(64 byte). BC4 / BC5는 channel 하나씩 stride 4로 쓴다.
+void decodeBc1Block(const uint8_t* in, uint8_t rgba[64], bool fourColorOnly = false);
+void decodeBc2Block(const uint8_t* in, uint8_t rgba[64]);
+void decodeBc3Block(const uint8_t* in, uint8_t rgba[64]);
+void decodeBc4Block(const uint8_t* in, uint8_t* channel);
+void decodeBc7Block(const uint8_t* in, uint8_t rgba[64]);
+
+// channelMask(1 R, 2 G, 4 B, 8 A)의 채널만 비교한 PSNR(dB). 같으면 INFINITY.
+double computePsnr(const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height, size_t rowPitch, uint32_t channelMask = 0x7);
+
+/*
+ * RGBA8 / BGRA8 texture의 모든 subresource를 format으로 압축한다. 원본이 sRGB면 BC1 / 2 / 3 / 7도 sRGB format이 된다.
+ * 3D texture는 압축하지 않는다.
+ * */
+bool compressTexture(const TextureData& source, TextureFormat format, TextureData& compressed, BcQuality quality = BcQualityNormal,
+		ThreadPool& pool = ThreadPool::shared());
+
+#pragma region BcCommon {
+
+namespace BcDetail {
+
+// palette와 pixel 사이 거리의 상한. 4 채널 x 255^2 x 16 + 15 < 2^24
+constexpr float kIndexScale = 16.0f;
+
+/*
+ * planes[0 ... planeCount)의 pixel과 palette(count개, planeCount 채널)의 가장 가까운 index를 고른다.
+ * mask의 pixel만 indices에 쓰고 오차 합을 더한다.
+ * */
+inline float selectIndices(const float* const* planes, int planeCount, const float (*palette)[4], int count, uint16_t mask, uint8_t indices[16])
+{
+	alignas(32) float keys[16];
+	for (int half = 0; half < 2; ++half) {
+		Lanes8 values[4];
+		for (int c = 0; c < planeCount; ++c) {
+			values[c] = Lanes8::load(planes[c] + half * 8);
+		}
+		Lanes8 best = Lanes8::splat(1e30f);
+		for (int k = 0; k < count; ++k) {
+			Lanes8 difference = values[0] - Lanes8::splat(palette[k][0]);
+			Lanes8 error = difference * difference;
+			for (int c = 1; c < planeCount; ++c) {
+				difference = values[c] - Lanes8::splat(palette[k][c]);
+				error = multiplyAdd(difference, difference, error);
+			}
+			best = min(best, multiplyAdd(error, Lanes8::splat(kIndexScale), Lanes8::splat(float(k))));
+		}
+		store(keys + half * 8, best);
+	}
+	float total = 0.0f;
+	for (int i = 0; i < 16; ++i) {
+		if (mask >> i & 1) {
+			uint32_t key = uint32_t(keys[i]);
+			indices[i] = uint8_t(key & 15);
+			total += float(key >> 4);
+		}
+	}
+	return total;
+}
+
+// mask pixel의 평균과 공분산의 가장 큰 고유벡터(power iteration)
+inline void principalAxis(const float* const* planes, int planeCount, uint16_t mask, float mean[4], float axis[4])
+{
+	float count = 0.0f;
+	for (int c = 0; c < 4; ++c) {
+		mean[c] = 0.0f;
+		axis[c] = 0.0f;
+	}
+	for (int i = 0; i < 16; ++i) {
+		if (mask >> i & 1) {
+			for (int c = 0; c < planeCount; ++c) {
+				mean[c] += planes[c][i];
+			}
+			count += 1.0f;
+		}
+	}
+	if (count == 0.0f) {
+		return;
+	}
+	for (int c = 0; c < planeCount; ++c) {
+		mean[c] /= count;
+	}
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; ++i) {
+		if (mask >> i & 1) {
+			float d[4];
+			for (int c = 0; c < planeCount; ++c) {
+				d[c] = planes[c][i] - mean[c];
+			}
+			for (int x = 0; x < planeCount; ++x) {
+				for (int y = x; y < planeCount; ++y) {
+					covariance[x][y] += d[x] * d[y];
+				}
+			}
+		}
+	}
+	// 분산이 가장 큰 채널 방향에서 시작한다.
+	int largest = 0;
+	for (int c = 0; c < planeCount; ++c) {
+		for (int y = 0; y < c; ++y) {
+			covariance[c][y] = covariance[y][c];
+		}
+		if (covariance[c][c] > covariance[largest][largest]) {
+			largest = c;
+		}
+	}
+	float v[4] = {};
+	for (int c = 0; c < planeCount; ++c) {
+		v[c] = covariance[largest][c];
+	}
+	for (int iteration = 0; iteration < 6; ++iteration) {
+		float next[4] = {};
+		float length = 0.0f;
+		for (int x = 0; x < planeCount; ++x) {
+			for (int y = 0; y < planeCount; ++y) {
+				next[x] += covariance[x][y] * v[y];
+			}
+			length = std::max(length, std::fabs(next[x]));
+		}
+		if (length == 0.0f) {
+			break;
+		}
+		for (int c = 0; c < planeCount; ++c) {
+			v[c] = next[c] / length;
+		}
+	}
+	float length = 0.0f;
+	for (int c = 0; c < planeCount; ++c) {
+		length += v[c] * v[c];
+	}
+	length = std::sqrt(length);
+	for (int c = 0; c < planeCount; ++c) {
+		axis[c] = length > 0.0f ? v[c] / length : (c == 0 ? 1.0f : 0.0f);
+	}
+}
+
+// 주성분 방향으로 투영했을 때 양 끝
+inline void axisEndpoints(const float* const* planes, int planeCount, uint16_t mask, float first[4], float second[4])
+{
+	float mean[4], axis[4];
+	principalAxis(planes, planeCount, mask, mean, axis);
+	float low = 0.0f, high = 0.0f;
+	for (int i = 0; i < 16; ++i) {
+		if (mask >> i & 1) {
+			float t = 0.0f;
+			for (int c = 0; c < planeCount; ++c) {
+				t += (planes[c][i] - mean[c]) * axis[c];
+			}
+			low = std::min(low, t);
+			high = std::max(high, t);
+		}
+	}
+	for (int c = 0; c < planeCount; ++c) {
+		first[c] = std::clamp(mean[c] + axis[c] * low, 0.0f, 255.0f);
+		second[c] = std::clamp(mean[c] + axis[c] * high, 0.0f, 255.0f);
+	}
+}
+
+/*
+ * index가 정해졌을 때 오차 제곱합이 가장 작은 두 endpoint. weights[index]는 두 번째 endpoint의 비율이다.
+ * 모든 pixel이 같은 index면 false.
+ * */
+inline bool leastSquares(const float* const* planes, int planeCount, uint16_t mask, const uint8_t indices[16], const float* weights,
+		float first[4], float second[4])
+{
+	float alpha2 = 0.0f, beta2 = 0.0f, alphaBeta = 0.0f;
+	float alphaX[4] = {}, betaX[4] = {};
+	for (int i = 0; i < 16; ++i) {
+		if (mask >> i & 1) {
+			float t = weights[indices[i]];
+			float s = 1.0f - t;
+			alpha2 += s * s;
+			beta2 += t * t;
+			alphaBeta += s * t;
+			for (int c = 0; c < planeCount; ++c) {
+				alphaX[c] += s * planes[c][i];
+				betaX[c] += t * planes[c][i];
+			}
+		}
+	}
+	float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+	if (std::fabs(determinant) < 1e-6f) {
+		return false;
+	}
+	for (int c = 0; c < planeCount; ++c) {
+		first[c] = std::clamp((alphaX[c] * beta2 - betaX[c] * alphaBeta) / determinant, 0.0f, 255.0f);
+		second[c] = std::clamp((betaX[c] * alpha2 - alphaX[c] * alphaBeta) / determinant, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+inline int refinements(BcQuality quality)
+{
+	return quality == BcQualityFast ? 1 : (quality == BcQualityNormal ? 2 : 3);
+}
+
+inline void writeBits(uint8_t* out, uint32_t& position, uint32_t value, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i, ++position) {
+		out[position >> 3] |= uint8_t(((value >> i) & 1) << (position & 7));
+	}
+}
+
+inline uint32_t readBits(const uint8_t* in, uint32_t& position, uint32_t count)
+{
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < count; ++i, ++position) {
+		value |= uint32_t((in[position >> 3] >> (position & 7)) & 1) << i;
+	}
+	return value;
+}
+
+} // namespace BcDetail
+
+#pragma endregion BcCommon }
+
+#pragma region Bc1To5 {
+
+namespace BcDetail {
+
+inline uint16_t quantize565(const float color[3])
+{
+	uint32_t r = uint32_t(std::clamp(color[0] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+	uint32_t g = uint32_t(std::clamp(color[1] * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f));
+	uint32_t b = uint32_t(std::clamp(color[2] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+	return uint16_t(r << 11 | g << 5 | b);
+}
+
+inline void expand565(uint16_t color, int rgb[3])
+{
+	int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+	rgb[0] = r << 3 | r >> 2;
+	rgb[1] = g << 2 | g >> 4;
+	rgb[2] = b << 3 | b >> 2;
+}
+
+// BC1 palette. fourColor면 c0, c1, 2/3, 1/3, 아니면 c0, c1, 1/2, 투명한 검정
+inline void bc1Palette(uint16_t c0, uint16_t c1, bool fourColor, float palette[4][4])
+{
+	int a[3], b[3];
+	expand565(c0, a);
+	expand565(c1, b);
+	for (int c = 0; c < 3; ++c) {
+		palette[0][c] = float(a[c]);
+		palette[1][c] = float(b[c]);
+		if (fourColor) {
+			palette[2][c] = float((2 * a[c] + b[c] + 1) / 3);
+			palette[3][c] = float((a[c] + 2 * b[c] + 1) / 3);
+		} else {
+			palette[2][c] = float((a[c] + b[c] + 1) / 2);
+			palette[3][c] = 0.0f;
+		}
+	}
+	for (int k = 0; k < 4; ++k) {
+		palette[k][3] = fourColor || k < 3 ? 255.0f : 0.0f;
+	}
+}
+
+struct Bc1Candidate {
+	uint16_t c0{0};
+	uint16_t c1{0};
+	uint8_t indices[16]{};
+	float error{1e30f};
+};
+
+/*
+ * float endpoint 두 개를 565로 반올림하고 mask pixel의 index를 고른다.
+ * fourColor면 c0 > c1, 아니면 c0 <= c1이 되도록 순서를 맞춘다. 같으면 모두 index 0이다.
+ * */
+inline void evaluateBc1(const BcBlock& block, uint16_t mask, bool fourColor, const float first[3], const float second[3], Bc1Candidate& best)
+{
+	Bc1Candidate candidate;
+	candidate.c0 = quantize565(first);
+	candidate.c1 = quantize565(second);
+	if ((candidate.c0 < candidate.c1) == fourColor) {
+		std::swap(candidate.c0, candidate.c1);
+	}
+	const float* planes[3] = { block.r, block.g, block.b };
+	if (candidate.c0 == candidate.c1) {
+		float palette[4][4];
+		bc1Palette(candidate.c0, candidate.c1, fourColor, palette);
+		candidate.error = selectIndices(planes, 3, palette, 1, mask, candidate.indices);
+	} else {
+		float palette[4][4];
+		bc1Palette(candidate.c0, candidate.c1, fourColor, palette);
+		candidate.error = selectIndices(planes, 3, palette, fourColor ? 4 : 3, mask, candidate.indices);
+	}
+	if (candidate.error < best.error) {
+		best = candidate;
+	}
+}
+
+inline void bc1Endpoints(uint16_t color, float out[3])
+{
+	int rgb[3];
+	expand565(color, rgb);
+	for (int c = 0; c < 3; ++c) {
+		out[c] = float(rgb[c]);
+	}
+}
+
+// PCA 양 끝에서 시작해 least squares로 다듬고, High면 565 한 칸씩 옮겨 본다.
+inline Bc1Candidate solveBc1(const BcBlock& block, uint16_t mask, bool fourColor, BcQuality quality)
+{
+	static const float kFourWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	static const float kThreeWeights[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+	const float* planes[3] = { block.r, block.g, block.b };
+	Bc1Candidate best;
+	float first[4], second[4];
+	axisEndpoints(planes, 3, mask, first, second);
+	evaluateBc1(block, mask, fourColor, first, second, best);
+	for (int iteration = 0; iteration < refinements(quality) && best.error > 0.0f; ++iteration) {
+		if (!leastSquares(planes, 3, mask, best.indices, fourColor ? kFourWeights : kThreeWeights, first, second)) {
+			break;
+		}
+		float previous = best.error;
+		evaluateBc1(block, mask, fourColor, first, second, best);
+		if (best.error >= previous) {
+			break;
+		}
+	}
+	if (quality == BcQualityHigh) {
+		static const uint16_t kSteps[] = { 1 << 11, 1 << 5, 1 };
+		static const uint16_t kMasks[] = { 31 << 11, 63 << 5, 31 };
+		for (int round = 0; round < 2 && best.error > 0.0f; ++round) {
+			Bc1Candidate start = best;
+			for (int endpoint = 0; endpoint < 2; ++endpoint) {
+				for (int channel = 0; channel < 3; ++channel) {
+					for (int sign = -1; sign <= 1; sign += 2) {
+						uint16_t colors[2] = { start.c0, start.c1 };
+						int field = colors[endpoint] & kMasks[channel];
+						int moved = field + sign * kSteps[channel];
+						if (moved < 0 || moved > kMasks[channel]) {
+							continue;
+						}
+						colors[endpoint] = uint16_t((colors[endpoint] & ~kMasks[channel]) | moved);
+						float a[3], b[3];
+						bc1Endpoints(colors[0], a);
+						bc1Endpoints(colors[1], b);
+						evaluateBc1(block, mask, fourColor, a, b, best);
+					}
+				}
+			}
+		}
+	}
+	return best;
+}
+
+inline void writeBc1(const Bc1Candidate& candidate, uint8_t out[8])
+{
+	uint32_t indices = 0;
+	for (int i = 0; i < 16; ++i) {
+		indices |= uint32_t(candidate.indices[i] & 3) << (2 * i);
+	}
+	std::memcpy(out, &candidate.c0, 2);
+	std::memcpy(out + 2, &candidate.c1, 2);
+	std::memcpy(out + 4, &indices, 4);
+}
+
+// BC4 palette. e0 > e1이면 8 값, 아니면 6 값 + 0, 255
+inline void bc4Palette(int e0, int e1, float palette[8][4])
+{
+	palette[0][0] = float(e0);
+	palette[1][0] = float(e1);
+	if (e0 > e1) {
+		for (int i = 2; i < 8; ++i) {
+			palette[i][0] = float(((8 - i) * e0 + (i - 1) * e1 + 3) / 7);
+		}
+	} else {
+		for (int i = 2; i < 6; ++i) {
+			palette[i][0] = float(((6 - i) * e0 + (i - 1) * e1 + 2) / 5);
+		}
+		palette[6][0] = 0.0f;
+		palette[7][0] = 255.0f;
+	}
+}
+
+struct Bc4Candidate {
+	int e0{0};
+	int e1{0};
+	uint8_t indices[16]{};
+	float error{1e30f};
+};
+
+inline void evaluateBc4(const float values[16], int e0, int e1, Bc4Candidate& best)
+{
+	Bc4Candidate candidate;
+	candidate.e0 = std::clamp(e0, 0, 255);
+	candidate.e1 = std::clamp(e1, 0, 255);
+	float palette[8][4];
+	bc4Palette(candidate.e0, candidate.e1, palette);
+	const float* planes[1] = { values };
+	candidate.error = selectIndices(planes, 1, palette, 8, 0xFFFF, candidate.indices);
+	if (candidate.error < best.error) {
+		best = candidate;
+	}
+}
+
+} // namespace BcDetail
+
+inline void encodeBc1Block(const BcBlock& block, uint8_t out[8], BcQuality quality, bool allowTransparent)
+{
+	using namespace BcDetail;
+	uint16_t opaque = 0;
+	for (int i = 0; i < 16; ++i) {
+		opaque |= uint16_t(block.a[i] >= 128.0f) << i;
+	}
+	Bc1Candidate best;
+	if (!allowTransparent || opaque == 0xFFFF) {
+		best = solveBc1(block, 0xFFFF, true, quality);
+		if (allowTransparent && quality == BcQualityHigh && best.error > 0.0f) {
+			Bc1Candidate three = solveBc1(block, 0xFFFF, false, quality);
+			best = three.error < best.error ? three : best;
+		}
+	} else {
+		// 투명한 pixel은 index 3(투명한 검정)이고 나머지는 3 색 mode로 고른다.
+		if (opaque != 0) {
+			best = solveBc1(block, opaque, false, quality);
+		}
+		for (int i = 0; i < 16; ++i) {
+			if (!(opaque >> i & 1)) {
+				best.indices[i] = 3;
+			}
+		}
+	}
+	writeBc1(best, out);
+}
+
+inline void encodeBc4Block(const float values[16], uint8_t out[8], BcQuality quality)
+{
+	using namespace BcDetail;
+	static const float kEightWeights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+	float low = 255.0f, high = 0.0f, innerLow = 255.0f, innerHigh = 0.0f;
+	for (int i = 0; i < 16; ++i) {
+		low = std::min(low, values[i]);
+		high = std::max(high, values[i]);
+		if (values[i] > 0.0f && values[i] < 255.0f) {
+			innerLow = std::min(innerLow, values[i]);
+			innerHigh = std::max(innerHigh, values[i]);
+		}
+	}
+	Bc4Candidate best;
+	if (low == high) {
+		evaluateBc4(values, int(low), int(low), best);
+	} else {
+		evaluateBc4(values, int(high), int(low), best);
+		const float* planes[1] = { values };
+		for (int iteration = 0; iteration < refinements(quality) && best.error > 0.0f; ++iteration) {
+			float first[4], second[4];
+			if (!leastSquares(planes, 1, 0xFFFF, best.indices, kEightWeights, first, second)) {
+				break;
+			}
+			int e0 = int(first[0] + 0.5f), e1 = int(second[0] + 0.5f);
+			if (e0 < e1) {
+				std::swap(e0, e1);
+			}
+			if (e0 == e1) {
+				e0 < 255 ? ++e0 : --e1;
+			}
+			float previous = best.error;
+			evaluateBc4(values, e0, e1, best);
+			if (best.error >= previous) {
+				break;
+			}
+		}
+		// 0이나 255가 있으면 6 값 mode가 양 끝을 공짜로 준다.
+		if (quality != BcQualityFast && (quality == BcQualityHigh || low == 0.0f || high == 255.0f)) {
+			if (innerLow > innerHigh) {
+				evaluateBc4(values, 0, 0, best);
+			} else {
+				evaluateBc4(values, int(innerLow), int(innerHigh), best);
+			}
+		}
+		if (quality == BcQualityHigh && best.error > 0.0f) {
+			const int e0 = best.e0, e1 = best.e1;
+			for (int d0 = -2; d0 <= 2; ++d0) {
+				for (int d1 = -2; d1 <= 2; ++d1) {
+					// 순서가 뒤집히면 mode가 바뀌므로 같은 mode 안에서만 옮긴다.
+					if ((e0 + d0 > e1 + d1) == (e0 > e1)) {
+						evaluateBc4(values, e0 + d0, e1 + d1, best);
+					}
+				}
+			}
+		}
+	}
+	uint64_t bits = uint64_t(best.e0) | uint64_t(best.e1) << 8;
+	for (int i = 0; i < 16; ++i) {
+		bits |= uint64_t(best.indices[i] & 7) << (16 + 3 * i);
+	}
+	std::memcpy(out, &bits, 8);
+}
+
+inline void encodeBc2Block(const BcBlock& block, uint8_t out[16], BcQuality quality)
+{
+	uint64_t alpha = 0;
+	for (int i = 0; i < 16; ++i) {
+		alpha |= uint64_t(uint32_t(block.a[i] * 15.0f / 255.0f + 0.5f)) << (4 * i);
+	}
+	std::memcpy(out, &alpha, 8);
+	encodeBc1Block(block, out + 8, quality, false);
+}
+
+inline void encodeBc3Block(const BcBlock& block, uint8_t out[16], BcQuality quality)
+{
+	encodeBc4Block(block.a, out, quality);
+	encodeBc1Block(block, out + 8, quality, false);
+}
+
+inline void encodeBc5Block(const BcBlock& block, uint8_t out[16], BcQuality quality)
+{
+	encodeBc4Block(block.r, out, quality);
+	encodeBc4Block(block.g, out + 8, quality);
+}
+
+inline void decodeBc1Block(const uint8_t* in, uint8_t rgba[64], bool fourColorOnly)
+{
+	uint16_t c0, c1;
+	uint32_t indices;
+	std::memcpy(&c0, in, 2);
+	std::memcpy(&c1, in + 2, 2);
+	std::memcpy(&indices, in + 4, 4);
+	float palette[4][4];
+	BcDetail::bc1Palette(c0, c1, fourColorOnly || c0 > c1, palette);
+	for (int i = 0; i < 16; ++i) {
+		const float* color = palette[(indices >> (2 * i)) & 3];
+		for (int c = 0; c < 4; ++c) {
+			rgba[4 * i + c] = uint8_t(color[c]);
+		}
+	}
+}
+
+inline void decodeBc4Block(const uint8_t* in, uint8_t* channel)
+{
+	uint64_t bits = 0;
+	std::memcpy(&bits, in, 8);
+	float palette[8][4];
+	BcDetail::bc4Palette(in[0], in[1], palette);
+	for (int i = 0; i < 16; ++i) {
+		channel[4 * i] = uint8_t(palette[(bits >> (16 + 3 * i)) & 7][0]);
+	}
+}
+
+inline void decodeBc2Block(const uint8_t* in, uint8_t rgba[64])
+{
+	decodeBc1Block(in + 8, rgba, true);
+	uint64_t alpha = 0;
+	std::memcpy(&alpha, in, 8);
+	for (int i = 0; i < 16; ++i) {
+		rgba[4 * i + 3] = uint8_t(((alpha >> (4 * i)) & 15) * 17);
+	}
+}
+
+inline void decodeBc3Block(const uint8_t* in, uint8_t rgba[64])
+{
+	decodeBc1Block(in + 8, rgba, true);
+	decodeBc4Block(in, rgba + 3);
+}
+
+#pragma endregion Bc1To5 }
+
+#pragma region Bc7 {
+
+namespace BcDetail {
+
+struct Bc7Mode {
+	uint8_t subsets;
+	uint8_t partitionBits;
+	uint8_t rotationBits;
+	uint8_t indexSelectionBits;
+	uint8_t colorBits;
+	uint8_t alphaBits;
+	uint8_t endpointPBits;
+	uint8_t sharedPBits;
+	uint8_t indexBits;
+	uint8_t secondaryIndexBits;
+};
+
+constexpr Bc7Mode kBc7Modes[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// bit i가 pixel i의 subset이다.
+constexpr uint16_t kBc7Partitions2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+// 2 bit씩 pixel i의 subset이다.
+constexpr uint32_t kBc7Partitions3[64] = {
+	0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+	0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+	0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+	0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+	0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+	0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+	0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+	0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+};
+
+// subset 0의 anchor는 항상 pixel 0이다.
+constexpr uint8_t kBc7Anchors2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+	15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+	6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+};
+
+constexpr uint8_t kBc7Anchors3First[64] = {
+	3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+	3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+	8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+	3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+};
+
+constexpr uint8_t kBc7Anchors3Second[64] = {
+	15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+	15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+	15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+	15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+};
+
+constexpr uint8_t kBc7Weights2[4] = { 0, 21, 43, 64 };
+constexpr uint8_t kBc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+constexpr uint8_t kBc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+inline const uint8_t* bc7Weights(int indexBits)
+{
+	return indexBits == 2 ? kBc7Weights2 : (indexBits == 3 ? kBc7Weights3 : kBc7Weights4);
+}
+
+inline int bc7Interpolate(int e0, int e1, int weight)
+{
+	return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+// bits(p-bit 포함) 정수를 8 bit로 늘린다.
+inline int bc7Unquantize(int value, int bits)
+{
+	return bits >= 8 ? value : (value << (8 - bits)) | (value >> (2 * bits - 8));
+}
+
+inline int bc7Subset(int subsets, int partition, int pixel)
+{
+	if (subsets == 2) {
+		return (kBc7Partitions2[partition] >> pixel) & 1;
+	}
+	if (subsets == 3) {
+		return (kBc7Partitions3[partition] >> (2 * pixel)) & 3;
+	}
+	return 0;
+}
+
+inline int bc7Anchor(int subsets, int partition, int subset)
+{
+	if (subset == 0) {
+		return 0;
+	}
+	if (subsets == 2) {
+		return kBc7Anchors2[partition];
+	}
+	return subset == 1 ? kBc7Anchors3First[partition] : kBc7Anchors3Second[partition];
+}
+
+// 압축하는 subset 하나. quantized는 p-bit를 뺀 endpoint, pBits[endpoint]
+struct Bc7Subset {
+	int quantized[2][4]{};
+	int pBits[2]{};
+	uint8_t indices[16]{};
+	float error{1e30f};
+};
+
+/*
+ * endpoint 두 개를 mode의 bit 수로 줄이고 index를 고른다. p-bit는 가능한 조합을 모두 해 본다.
+ * channels가 3이면 alpha는 255로 둔다.
+ * */
+inline void evaluateBc7Subset(const BcBlock& block, uint16_t mask, const Bc7Mode& mode, int channels, const float first[4], const float second[4],
+		Bc7Subset& best)
+{
+	const float* planes[4] = { block.r, block.g, block.b, block.a };
+	const bool hasPBits = mode.endpointPBits || mode.sharedPBits;
+	const int combinations = mode.endpointPBits ? 4 : (mode.sharedPBits ? 2 : 1);
+	const uint8_t* weights = bc7Weights(mode.indexBits);
+	const int count = 1 << mode.indexBits;
+	for (int combination = 0; combination < combinations; ++combination) {
+		Bc7Subset candidate;
+		candidate.pBits[0] = mode.endpointPBits ? (combination & 1) : combination;
+		candidate.pBits[1] = mode.endpointPBits ? (combination >> 1) : combination;
+		int endpoints[2][4];
+		for (int e = 0; e < 2; ++e) {
+			const float* source = e == 0 ? first : second;
+			for (int c = 0; c < 4; ++c) {
+				const int bits = c < 3 ? mode.colorBits : (mode.alphaBits ? mode.alphaBits : mode.colorBits);
+				const int total = bits + (hasPBits ? 1 : 0);
+				const float target = (c < channels ? source[c] : 255.0f) * float((1 << total) - 1) / 255.0f;
+				int value;
+				if (hasPBits) {
+					value = std::clamp(int(std::floor((target - float(candidate.pBits[e])) * 0.5f + 0.5f)), 0, (1 << bits) - 1);
+					endpoints[e][c] = bc7Unquantize(value << 1 | candidate.pBits[e], total);
+				} else {
+					value = std::clamp(int(target + 0.5f), 0, (1 << bits) - 1);
+					endpoints[e][c] = bc7Unquantize(value, total);
+				}
+				candidate.quantized[e][c] = value;
+			}
+		}
+		float palette[16][4];
+		for (int k = 0; k < count; ++k) {
+			for (int c = 0; c < 4; ++c) {
+				palette[k][c] = float(bc7Interpolate(endpoints[0][c], endpoints[1][c], weights[k]));
+			}
+		}
+		candidate.error = selectIndices(planes, channels, palette, count, mask, candidate.indices);
+		if (candidate.error < best.error) {
+			best = candidate;
+		}
+	}
+}
+
+inline Bc7Subset solveBc7Subset(const BcBlock& block, uint16_t mask, const Bc7Mode& mode, int channels, BcQuality quality)
+{
+	const float* planes[4] = { block.r, block.g, block.b, block.a };
+	float weights[16];
+	for (int k = 0; k < (1 << mode.indexBits); ++k) {
+		weights[k] = float(bc7Weights(mode.indexBits)[k]) / 64.0f;
+	}
+	Bc7Subset best;
+	float first[4] = { 0.0f, 0.0f, 0.0f, 255.0f }, second[4] = { 0.0f, 0.0f, 0.0f, 255.0f };
+	axisEndpoints(planes, channels, mask, first, second);
+	evaluateBc7Subset(block, mask, mode, channels, first, second, best);
+	for (int iteration = 0; iteration < refinements(quality) && best.error > 0.0f; ++iteration) {
+		if (!leastSquares(planes, channels, mask, best.indices, weights, first, second)) {
+			break;
+		}
+		float previous = best.error;
+		evaluateBc7Subset(block, mask, mode, channels, first, second, best);
+		if (best.error >= previous) {
+			break;
+		}
+	}
+	return best;
+}
+
+/*
+ * 2 subset partition을 subset별 RGB 공분산의 "전체 분산 - 가장 큰 고유값"으로 줄 세운다.
+ * 한 직선 위에 잘 놓이는 partition일수록 endpoint 두 개로 잘 표현된다. 앞에서 count개를 partitions에 쓴다.
+ * */
+inline void rankBc7Partitions(const BcBlock& block, int count, int* partitions)
+{
+	// pixel마다 r, g, b, rr, gg, bb, rg, rb, gb
+	float moments[16][9];
+	float total[9] = {};
+	for (int i = 0; i < 16; ++i) {
+		const float r = block.r[i], g = block.g[i], b = block.b[i];
+		const float values[9] = { r, g, b, r * r, g * g, b * b, r * g, r * b, g * b };
+		for (int m = 0; m < 9; ++m) {
+			moments[i][m] = values[m];
+			total[m] += values[m];
+		}
+	}
+	auto residual = [](const float* sums, float n) {
+		if (n < 2.0f) {
+			return 0.0f;
+		}
+		const float mr = sums[0] / n, mg = sums[1] / n, mb = sums[2] / n;
+		const float c[3][3] = { { sums[3] - n * mr * mr, sums[6] - n * mr * mg, sums[7] - n * mr * mb },
+			{ sums[6] - n * mr * mg, sums[4] - n * mg * mg, sums[8] - n * mg * mb },
+			{ sums[7] - n * mr * mb, sums[8] - n * mg * mb, sums[5] - n * mb * mb } };
+		float v[3] = { 1.0f, 1.0f, 1.0f };
+		float lambda = 0.0f;
+		for (int iteration = 0; iteration < 4; ++iteration) {
+			float next[3];
+			for (int x = 0; x < 3; ++x) {
+				next[x] = c[x][0] * v[0] + c[x][1] * v[1] + c[x][2] * v[2];
+			}
+			float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+			if (length == 0.0f) {
+				return 0.0f;
+			}
+			lambda = length / std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			for (int x = 0; x < 3; ++x) {
+				v[x] = next[x] / length;
+			}
+		}
+		return std::max(0.0f, c[0][0] + c[1][1] + c[2][2] - lambda);
+	};
+	float scores[64];
+	for (int p = 0; p < 64; ++p) {
+		float second[9] = {};
+		float n = 0.0f;
+		for (int i = 0; i < 16; ++i) {
+			if (kBc7Partitions2[p] >> i & 1) {
+				for (int m = 0; m < 9; ++m) {
+					second[m] += moments[i][m];
+				}
+				n += 1.0f;
+			}
+		}
+		float first[9];
+		for (int m = 0; m < 9; ++m) {
+			first[m] = total[m] - second[m];
+		}
+		scores[p] = residual(first, 16.0f - n) + residual(second, n);
+	}
+	int order[64];
+	for (int p = 0; p < 64; ++p) {
+		order[p] = p;
+	}
+	std::partial_sort(order, order + count, order + 64, [&](int a, int b) { return scores[a] < scores[b]; });
+	std::copy(order, order + count, partitions);
+}
+
+struct Bc7Candidate {
+	int mode{-1};
+	int partition{0};
+	Bc7Subset subsets[2];
+	float error{1e30f};
+};
+
+inline Bc7Candidate solveBc7Mode(const BcBlock& block, int modeIndex, int partition, BcQuality quality)
+{
+	const Bc7Mode& mode = kBc7Modes[modeIndex];
+	Bc7Candidate candidate;
+	candidate.mode = modeIndex;
+	candidate.partition = partition;
+	candidate.error = 0.0f;
+	for (int s = 0; s < mode.subsets; ++s) {
+		uint16_t mask = 0xFFFF;
+		if (mode.subsets == 2) {
+			mask = s == 0 ? uint16_t(~kBc7Partitions2[partition]) : kBc7Partitions2[partition];
+		}
+		candidate.subsets[s] = solveBc7Subset(block, mask, mode, mode.alphaBits ? 4 : 3, quality);
+		candidate.error += candidate.subsets[s].error;
+	}
+	return candidate;
+}
+
+inline void writeBc7(Bc7Candidate candidate, uint8_t out[16])
+{
+	const Bc7Mode& mode = kBc7Modes[candidate.mode];
+	const int highBit = 1 << (mode.indexBits - 1);
+	const int maximum = (1 << mode.indexBits) - 1;
+	// anchor index의 가장 높은 bit는 저장하지 않으므로 0이 되도록 endpoint를 뒤집는다.
+	for (int s = 0; s < mode.subsets; ++s) {
+		Bc7Subset& subset = candidate.subsets[s];
+		const int anchor = bc7Anchor(mode.subsets, candidate.partition, s);
+		if (subset.indices[anchor] & highBit) {
+			std::swap(subset.quantized[0], subset.quantized[1]);
+			std::swap(subset.pBits[0], subset.pBits[1]);
+			for (int i = 0; i < 16; ++i) {
+				if (bc7Subset(mode.subsets, candidate.partition, i) == s) {
+					subset.indices[i] = uint8_t(maximum - subset.indices[i]);
+				}
+			}
+		}
+	}
+	std::memset(out, 0, 16);
+	uint32_t position = 0;
+	writeBits(out, position, 1u << candidate.mode, uint32_t(candidate.mode + 1));
+	writeBits(out, position, uint32_t(candidate.partition), mode.partitionBits);
+	for (int c = 0; c < 3; ++c) {
+		for (int s = 0; s < mode.subsets; ++s) {
+			for (int e = 0; e < 2; ++e) {
+				writeBits(out, position, uint32_t(candidate.subsets[s].quantized[e][c]), mode.colorBits);
+			}
+		}
+	}
+	if (mode.alphaBits) {
+		for (int s = 0; s < mode.subsets; ++s) {
+			for (int e = 0; e < 2; ++e) {
+				writeBits(out, position, uint32_t(candidate.subsets[s].quantized[e][3]), mode.alphaBits);
+			}
+		}
+	}
+	for (int s = 0; s < mode.subsets; ++s) {
+		if (mode.endpointPBits) {
+			writeBits(out, position, uint32_t(candidate.subsets[s].pBits[0]), 1);
+			writeBits(out, position, uint32_t(candidate.subsets[s].pBits[1]), 1);
+		} else if (mode.sharedPBits) {
+			writeBits(out, position, uint32_t(candidate.subsets[s].pBits[0]), 1);
+		}
+	}
+	for (int i = 0; i < 16; ++i) {
+		const int s = bc7Subset(mode.subsets, candidate.partition, i);
+		const bool anchor = i == bc7Anchor(mode.subsets, candidate.partition, s);
+		writeBits(out, position, candidate.subsets[s].indices[i], uint32_t(mode.indexBits - (anchor ? 1 : 0)));
+	}
+}
+
+} // namespace BcDetail
+
+inline void encodeBc7Block(const BcBlock& block, uint8_t out[16], BcQuality quality)
+{
+	using namespace BcDetail;
+	Bc7Candidate best = solveBc7Mode(block, 6, 0, quality);
+	bool opaque = true;
+	for (int i = 0; i < 16; ++i) {
+		opaque = opaque && block.a[i] == 255.0f;
+	}
+	// 2 subset mode는 alpha가 없으므로 불투명 block에만 쓴다. pixel당 오차가 1 이하면 더 찾지 않는다.
+	if (quality != BcQualityFast && opaque && best.error > 16.0f) {
+		const int count = quality == BcQualityHigh ? 6 : 2;
+		int partitions[64];
+		rankBc7Partitions(block, count, partitions);
+		for (int k = 0; k < count; ++k) {
+			Bc7Candidate candidate = solveBc7Mode(block, 1, partitions[k], quality);
+			if (candidate.error < best.error) {
+				best = candidate;
+			}
+			if (quality == BcQualityHigh) {
+				candidate = solveBc7Mode(block, 3, partitions[k], quality);
+				if (candidate.error < best.error) {
+					best = candidate;
+				}
+			}
+		}
+	}
+	writeBc7(best, out);
+}
+
+inline void decodeBc7Block(const uint8_t* in, uint8_t rgba[64])
+{
+	using namespace BcDetail;
+	int modeIndex = 0;
+	while (modeIndex < 8 && !(in[0] >> modeIndex & 1)) {
+		++modeIndex;
+	}
+	// 잘못된 block은 투명한 검정이다.
+	if (modeIndex == 8) {
+		std::memset(rgba, 0, 64);
+		return;
+	}
+	const Bc7Mode& mode = kBc7Modes[modeIndex];
+	uint32_t position = uint32_t(modeIndex + 1);
+	const int partition = int(readBits(in, position, mode.partitionBits));
+	const int rotation = int(readBits(in, position, mode.rotationBits));
+	const int indexSelection = int(readBits(in, position, mode.indexSelectionBits));
+	int endpoints[3][2][4];
+	for (int c = 0; c < 3; ++c) {
+		for (int s = 0; s < mode.subsets; ++s) {
+			for (int e = 0; e < 2; ++e) {
+				endpoints[s][e][c] = int(readBits(in, position, mode.colorBits));
+			}
+		}
+	}
+	for (int s = 0; s < mode.subsets; ++s) {
+		for (int e = 0; e < 2; ++e) {
+			endpoints[s][e][3] = mode.alphaBits ? int(readBits(in, position, mode.alphaBits)) : 255;
+		}
+	}
+	int pBits[3][2] = {};
+	for (int s = 0; s < mode.subsets; ++s) {
+		if (mode.endpointPBits) {
+			pBits[s][0] = int(readBits(in, position, 1));
+			pBits[s][1] = int(readBits(in, position, 1));
+		} else if (mode.sharedPBits) {
+			pBits[s][0] = pBits[s][1] = int(readBits(in, position, 1));
+		}
+	}
+	const bool hasPBits = mode.endpointPBits || mode.sharedPBits;
+	for (int s = 0; s < mode.subsets; ++s) {
+		for (int e = 0; e < 2; ++e) {
+			for (int c = 0; c < 4; ++c) {
+				if (c == 3 && !mode.alphaBits) {
+					continue;
+				}
+				const int bits = c < 3 ? mode.colorBits : mode.alphaBits;
+				const int value = hasPBits ? (endpoints[s][e][c] << 1 | pBits[s][e]) : endpoints[s][e][c];
+				endpoints[s][e][c] = bc7Unquantize(value, bits + (hasPBits ? 1 : 0));
+			}
+		}
+	}
+	uint8_t indices[16], secondary[16] = {};
+	for (int i = 0; i < 16; ++i) {
+		const int s = bc7Subset(mode.subsets, partition, i);
+		const bool anchor = i == bc7Anchor(mode.subsets, partition, s);
+		indices[i] = uint8_t(readBits(in, position, uint32_t(mode.indexBits - (anchor ? 1 : 0))));
+	}
+	if (mode.secondaryIndexBits) {
+		for (int i = 0; i < 16; ++i) {
+			secondary[i] = uint8_t(readBits(in, position, uint32_t(mode.secondaryIndexBits - (i == 0 ? 1 : 0))));
+		}
+	}
+	for (int i = 0; i < 16; ++i) {
+		const int s = bc7Subset(mode.subsets, partition, i);
+		int colorIndex = indices[i], colorBits = mode.indexBits;
+		int alphaIndex = indices[i], alphaBits = mode.indexBits;
+		if (mode.secondaryIndexBits) {
+			alphaIndex = secondary[i];
+			alphaBits = mode.secondaryIndexBits;
+			if (indexSelection) {
+				std::swap(colorIndex, alphaIndex);
+				std::swap(colorBits, alphaBits);
+			}
+		}
+		uint8_t* pixel = rgba + 4 * i;
+		for (int c = 0; c < 3; ++c) {
+			pixel[c] = uint8_t(bc7Interpolate(endpoints[s][0][c], endpoints[s][1][c], bc7Weights(colorBits)[colorIndex]));
+		}
+		pixel[3] = uint8_t(bc7Interpolate(endpoints[s][0][3], endpoints[s][1][3], bc7Weights(alphaBits)[alphaIndex]));
+		if (rotation) {
+			std::swap(pixel[3], pixel[rotation - 1]);
+		}
+	}
+}
+
+#pragma endregion Bc7 }
+
+#pragma region BcImage {
+
+inline bool canEncodeBc(TextureFormat format)
+{
+	switch (format) {
+		case TextureFormatBC1_RGBA: case TextureFormatBC1_RGBA_sRGB:
+		case TextureFormatBC2_RGBA: case TextureFormatBC2_RGBA_sRGB:
+		case TextureFormatBC3_RGBA: case TextureFormatBC3_RGBA_sRGB:
+		case TextureFormatBC4_RUnorm:
+		case TextureFormatBC5_RGUnorm:
+		case TextureFormatBC7_RGBAUnorm: case TextureFormatBC7_RGBAUnorm_sRGB:
+			return true;
+		default:
+			return false;
+	}
+}
+
+inline bool canDecodeBc(TextureFormat format)
+{
+	return canEncodeBc(format);
+}
+
+inline bool encodeBc(TextureFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, uint8_t* blocks,
+		BcQuality quality, ThreadPool& pool)
+{
+	if (!canEncodeBc(format)) {
+		std::cerr << "BC: cannot encode pixel format " << format << std::endl;
+		return false;
+	}
+	const uint32_t bytesPerBlock = textureFormatInfo(format).bytesPerBlock;
+	const uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	// 한 조각이 block 256개쯤 되도록 block 줄을 묶는다.
+	const size_t grain = std::max<size_t>(1, 256 / std::max<uint32_t>(1, blocksWide));
+	pool.parallelFor(blocksHigh, grain, [&](size_t begin, size_t end) {
+		BcBlock block;
+		for (size_t by = begin; by < end; ++by) {
+			for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+				for (int i = 0; i < 16; ++i) {
+					const uint32_t x = std::min(bx * 4 + uint32_t(i & 3), width - 1);
+					const uint32_t y = std::min(uint32_t(by) * 4 + uint32_t(i >> 2), height - 1);
+					const uint8_t* pixel = rgba + y * rowPitch + x * 4;
+					block.r[i] = pixel[0];
+					block.g[i] = pixel[1];
+					block.b[i] = pixel[2];
+					block.a[i] = pixel[3];
+				}
+				uint8_t* out = blocks + (by * blocksWide + bx) * bytesPerBlock;
+				switch (format) {
+					case TextureFormatBC1_RGBA: case TextureFormatBC1_RGBA_sRGB: encodeBc1Block(block, out, quality); break;
+					case TextureFormatBC2_RGBA: case TextureFormatBC2_RGBA_sRGB: encodeBc2Block(block, out, quality); break;
+					case TextureFormatBC3_RGBA: case TextureFormatBC3_RGBA_sRGB: encodeBc3Block(block, out, quality); break;
+					case TextureFormatBC4_RUnorm: encodeBc4Block(block.r, out, quality); break;
+					case TextureFormatBC5_RGUnorm: encodeBc5Block(block, out, quality); break;
+					default: encodeBc7Block(block, out, quality); break;
+				}
+			}
+		}
+	});
+	return true;
+}
+
+inline bool decodeBc(TextureFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba, size_t rowPitch, ThreadPool& pool)
+{
+	if (!canDecodeBc(format)) {
+		std::cerr << "BC: cannot decode pixel format " << format << std::endl;
+		return false;
+	}
+	const uint32_t bytesPerBlock = textureFormatInfo(format).bytesPerBlock;
+	const uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	const size_t grain = std::max<size_t>(1, 1024 / std::max<uint32_t>(1, blocksWide));
+	pool.parallelFor(blocksHigh, grain, [&](size_t begin, size_t end) {
+		uint8_t pixels[64];
+		for (size_t by = begin; by < end; ++by) {
+			for (uint32_t bx = 0; bx < blocksWide; ++bx) {
+				const uint8_t* in = blocks + (by * blocksWide + bx) * bytesPerBlock;
+				switch (format) {
+					case TextureFormatBC1_RGBA: case TextureFormatBC1_RGBA_sRGB: decodeBc1Block(in, pixels); break;
+					case TextureFormatBC2_RGBA: case TextureFormatBC2_RGBA_sRGB: decodeBc2Block(in, pixels); break;
+					case TextureFormatBC3_RGBA: case TextureFormatBC3_RGBA_sRGB: decodeBc3Block(in, pixels); break;
+					case TextureFormatBC4_RUnorm:
+					case TextureFormatBC5_RGUnorm:
+						for (int i = 0; i < 16; ++i) {
+							pixels[4 * i + 1] = pixels[4 * i + 2] = 0;
+							pixels[4 * i + 3] = 255;
+						}
+						decodeBc4Block(in, pixels);
+						if (format == TextureFormatBC5_RGUnorm) {
+							decodeBc4Block(in + 8, pixels + 1);
+						}
+						break;
+					default: decodeBc7Block(in, pixels); break;
+				}
+				for (int i = 0; i < 16; ++i) {
+					const uint32_t x = bx * 4 + uint32_t(i & 3), y = uint32_t(by) * 4 + uint32_t(i >> 2);
+					if (x < width && y < height) {
+						std::memcpy(rgba + y * rowPitch + x * 4, pixels + 4 * i, 4);
+					}
+				}
+			}
+		}
+	});
+	return true;
+}
+
+inline double computePsnr(const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height, size_t rowPitch, uint32_t channelMask)
+{
+	double sum = 0.0;
+	size_t samples = 0;
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			for (uint32_t c = 0; c < 4; ++c) {
+				if (channelMask >> c & 1) {
+					double d = double(a[y * rowPitch + x * 4 + c]) - double(b[y * rowPitch + x * 4 + c]);
+					sum += d * d;
+					++samples;
+				}
+			}
+		}
+	}
+	if (sum == 0.0 || samples == 0) {
+		return INFINITY;
+	}
+	return 10.0 * std::log10(255.0 * 255.0 / (sum / double(samples)));
+}
+
+inline bool compressTexture(const TextureData& source, TextureFormat format, TextureData& compressed, BcQuality quality, ThreadPool& pool)
+{
+	const TextureLayout& layout = source.layout;
+	const bool bgra = layout.format == TextureFormatBGRA8Unorm || layout.format == TextureFormatBGRA8Unorm_sRGB;
+	const bool sRGB = layout.format == TextureFormatRGBA8Unorm_sRGB || layout.format == TextureFormatBGRA8Unorm_sRGB;
+	if (!bgra && layout.format != TextureFormatRGBA8Unorm && layout.format != TextureFormatRGBA8Unorm_sRGB) {
+		std::cerr << "BC: source texture must be RGBA8 or BGRA8" << std::endl;
+		return false;
+	}
+	if (layout.type == TextureType3D) {
+		std::cerr << "BC: 3D textures cannot be block compressed" << std::endl;
+		return false;
+	}
+	// sRGB 변형은 unorm 바로 다음 값이다.
+	if (sRGB && (format == TextureFormatBC1_RGBA || format == TextureFormatBC2_RGBA || format == TextureFormatBC3_RGBA || format == TextureFormatBC7_RGBAUnorm)) {
+		format = TextureFormat(format + 1);
+	}
+	if (!canEncodeBc(format)) {
+		std::cerr << "BC: cannot encode pixel format " << format << std::endl;
+		return false;
+	}
+	compressed.layout = makeTextureLayout(format, layout.width, layout.height, layout.levels, layout.layers, layout.faces);
+	compressed.bytes.assign(size_t(compressed.layout.totalSize()), 0);
+	std::vector<uint8_t> swizzled;
+	for (const TextureSubresource& subresource : layout.subresources) {
+		const uint8_t* pixels = source.bytes.data() + subresource.offset;
+		if (bgra) {
+			swizzled.assign(pixels, pixels + subresource.size);
+			for (size_t i = 0; i + 4 <= swizzled.size(); i += 4) {
+				std::swap(swizzled[i], swizzled[i + 2]);
+			}
+			pixels = swizzled.data();
+		}
+		encodeBc(format, pixels, subresource.width, subresource.height, subresource.bytesPerRow,
+				compressed.data(subresource.level, subresource.slice), quality, pool);
+	}
+	return true;
+}
+
+#pragma endregion BcImage }
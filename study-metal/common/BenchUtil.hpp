@@ -0,0 +1,70 @@
+/*
+ * BenchUtil.hpp
+ *
+ * study-metal/bench의 benchmark(와 tools)가 함께 쓰는 시간 재기와 입력 data.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "MeshData.hpp"
+
+// 반지름 r, 분할 수 n인 UV sphere를 center에 추가한다.
+inline void addSphere(MeshData& mesh, Float3 center, float r, int n)
+{
+	uint32_t base = uint32_t(mesh.positions.size());
+	for (int i = 0; i <= n; ++i) {
+		float theta = float(M_PI) * i / n;
+		for (int j = 0; j < 2 * n; ++j) {
+			float phi = float(M_PI) * j / n;
+			mesh.positions.push_back(center + Float3{ r * std::sin(theta) * std::cos(phi), r * std::cos(theta), r * std::sin(theta) * std::sin(phi) });
+		}
+	}
+	for (int i = 0; i < n; ++i) {
+		for (int j = 0; j < 2 * n; ++j) {
+			uint32_t a = base + i * 2 * n + j, b = base + i * 2 * n + (j + 1) % (2 * n);
+			uint32_t c = a + 2 * n, d = b + 2 * n;
+			mesh.indices.insert(mesh.indices.end(), { a, b, c, b, d, c });
+		}
+	}
+}
+
+// function을 runs번 돌려 가장 짧은 시간(ms). 첫 실행의 cache / page fault 비용과 다른 process의 방해를 뺀다.
+template <typename Function>
+inline double bestOf(int runs, Function function)
+{
+	double best = 1e30;
+	for (int run = 0; run < runs; ++run) {
+		auto start = std::chrono::steady_clock::now();
+		function();
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+// texture 압축 benchmark의 size x size RGBA8 image. 부드러운 gradient, 약한 noise, 날카로운 경계와 반투명한 영역을 섞는다.
+inline std::vector<uint8_t> makeImage(uint32_t size)
+{
+	std::vector<uint8_t> image(size_t(size) * size * 4);
+	std::mt19937 random(7);
+	for (uint32_t y = 0; y < size; ++y) {
+		for (uint32_t x = 0; x < size; ++x) {
+			const float u = float(x) / float(size), v = float(y) / float(size);
+			const int noise = int(random() % 9) - 4;
+			uint8_t* pixel = image.data() + (size_t(y) * size + x) * 4;
+			pixel[0] = uint8_t(std::clamp(int(255.0f * u) + noise, 0, 255));
+			pixel[1] = uint8_t(std::clamp(int(128.0f + 100.0f * std::sin(u * 23.0f + v * 11.0f)) + noise, 0, 255));
+			// 32 pixel 체크 무늬와 원
+			pixel[2] = ((x / 32 + y / 32) & 1) ? 200 : 40;
+			const float dx = u - 0.5f, dy = v - 0.5f;
+			pixel[3] = dx * dx + dy * dy < 0.1f ? 255 : uint8_t(std::clamp(int(255.0f * v), 0, 255));
+		}
+	}
+	return image;
+}
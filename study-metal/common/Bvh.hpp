@@ -0,0 +1,930 @@
+/*
+ * Bvh.hpp
+ *
+ * 삼각형 mesh용 CPU BVH. MTL::AccelerationStructureTriangleGeometryDescriptor와 같은
+ * vertex buffer(stride) / index buffer(uint16, uint32)를 그대로 읽으므로 GPU에 올린 데이터로
+ * Linux에서도 picking, occlusion 같은 ray query를 할 수 있다.
+ *
+ * - build: binned SAH로 2진 BVH를 만든 뒤 4-wide BVH로 접는다. 큰 node는 thread pool로 나누어 만든다.
+ *   BvhBuildMode::Fast는 Morton code 순서로 나누어 품질 대신 build 속도를 얻는다.
+ * - refit: vertex만 움직인 경우 구조는 그대로 두고 bounds만 다시 계산한다.
+ * - motion: MTL::AccelerationStructureMotionTriangleGeometryDescriptor처럼 vertex buffer keyframe을 받아
+ *   ray의 시간으로 보간한 삼각형과 교차 검사한다.
+ * - traversal: 한 node의 자식 4개 bounds를 SIMD(SSE / NEON)로 한번에 검사한다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "MathTypes.hpp"
+#include "MeshData.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+// MTL::AccelerationStructureTriangleGeometryDescriptor와 같은 의미의 입력
+struct BvhTriangleGeometry {
+	// vertex마다 처음 12 byte가 float3 위치이다 (MTL::AttributeFormatFloat3).
+	const void* vertexData{nullptr};
+	size_t vertexStride{sizeof(Float3)};
+	// nullptr이면 vertex 3개씩 삼각형 하나
+	const void* indexData{nullptr};
+	// 2 (MTL::IndexTypeUInt16) 또는 4 (MTL::IndexTypeUInt32)
+	size_t indexSize{4};
+	size_t triangleCount{0};
+};
+
+BvhTriangleGeometry triangleGeometryFor(const MeshData& mesh);
+
+// MTL::MotionBorderMode. 시간이 [start, end] 밖일 때 끝 keyframe을 쓸지(Clamp), 사라질지(Vanish)
+enum class MotionBorderMode : uint32_t {
+	Clamp = 0,
+	Vanish = 1,
+};
+
+/*
+ * MTL::AccelerationStructureMotionTriangleGeometryDescriptor와 같은 의미의 입력.
+ * keyframes[i]는 MotionKeyframeData 하나이고 index buffer와 삼각형 수는 모든 keyframe이 같아야 한다.
+ * keyframe은 [motionStartTime, motionEndTime]에 고르게 놓이고 그 사이는 선형 보간한다.
+ * */
+struct BvhMotionTriangleGeometry {
+	const BvhTriangleGeometry* keyframes{nullptr};
+	size_t keyframeCount{0};
+	float motionStartTime{0.0f};
+	float motionEndTime{1.0f};
+	MotionBorderMode motionStartBorderMode{MotionBorderMode::Clamp};
+	MotionBorderMode motionEndBorderMode{MotionBorderMode::Clamp};
+};
+
+// Sah는 traversal이 빠른 tree, Fast는 MTL::AccelerationStructureUsagePreferFastBuild처럼 build가 빠른 tree
+enum class BvhBuildMode {
+	Sah,
+	Fast,
+};
+
+// MPSRayOriginMinDistanceDirectionMaxDistance와 같은 배치
+struct Ray {
+	PackedFloat3 origin;
+	float minDistance;
+	PackedFloat3 direction;
+	float maxDistance;
+};
+
+// MPSIntersectionDistancePrimitiveIndexCoordinates와 같은 배치. 맞지 않으면 distance < 0
+struct RayHit {
+	float distance;
+	uint32_t primitiveIndex;
+	float u, v;
+};
+
+// 자식 4개의 bounds를 SoA로 둔다. count가 0이면 child는 node 번호, 0보다 크면 primitive 구간의 시작이다.
+struct BvhNode4 {
+	float minX[4], minY[4], minZ[4];
+	float maxX[4], maxY[4], maxZ[4];
+	uint32_t child[4];
+	uint32_t count[4];
+};
+
+class Bvh {
+	public:
+		static constexpr uint32_t kEmpty = UINT32_MAX;
+		static constexpr uint32_t kMaxLeafSize = 4;
+
+		bool build(const BvhTriangleGeometry& geometry, BvhBuildMode mode = BvhBuildMode::Sah, ThreadPool& pool = ThreadPool::shared());
+		bool build(const BvhMotionTriangleGeometry& geometry, BvhBuildMode mode = BvhBuildMode::Sah, ThreadPool& pool = ThreadPool::shared());
+		// build 때와 같은 삼각형 수 / index로 vertex만 바뀐 경우
+		bool refit(const BvhTriangleGeometry& geometry, ThreadPool& pool = ThreadPool::shared());
+		bool refit(const BvhMotionTriangleGeometry& geometry, ThreadPool& pool = ThreadPool::shared());
+
+		// 가장 가까운 교차점. time은 motion geometry일 때만 쓰인다.
+		bool intersect(const Ray& ray, RayHit& hit, float time = 0.0f) const;
+		// [minDistance, maxDistance] 안에 아무 삼각형이나 있으면 true (shadow / occlusion ray)
+		bool occluded(const Ray& ray, float time = 0.0f) const;
+		void intersect(const Ray* rays, RayHit* hits, size_t count, float time = 0.0f, ThreadPool& pool = ThreadPool::shared()) const;
+
+		Aabb bounds() const { return _bounds; }
+		size_t numberOfNodes() const { return _nodes.size(); }
+		size_t numberOfTriangles() const { return _primitiveIndices.size(); }
+		size_t numberOfKeyframes() const { return _motion.keyframeCount; }
+
+	private:
+		bool loadTriangles(const BvhMotionTriangleGeometry& geometry, ThreadPool& pool);
+		template <bool AnyHit>
+		bool traverse(const Ray& ray, RayHit& hit, float time) const;
+
+		std::vector<BvhNode4> _nodes;
+		// Möller-Trumbore에 바로 쓰는 (v0, e1, e2) 형태. keyframe마다 BVH 순서로 이어 붙인다.
+		std::vector<Float3> _triangles;
+		// BVH 순서의 삼각형 -> 원래 삼각형 번호
+		std::vector<uint32_t> _primitiveIndices;
+		// keyframes는 쓰지 않고 시간 / 경계 정보만 둔다.
+		BvhMotionTriangleGeometry _motion;
+		Aabb _bounds{};
+};
+
+#pragma region BvhInput {
+
+inline BvhTriangleGeometry triangleGeometryFor(const MeshData& mesh)
+{
+	BvhTriangleGeometry geometry;
+	geometry.vertexData = mesh.positions.data();
+	geometry.vertexStride = sizeof(Float3);
+	geometry.indexData = mesh.indices.empty() ? nullptr : mesh.indices.data();
+	geometry.indexSize = sizeof(uint32_t);
+	geometry.triangleCount = mesh.indices.empty() ? mesh.positions.size() / 3 : mesh.numberOfTriangles();
+	return geometry;
+}
+
+namespace BvhDetail {
+
+inline Float3 vertexAt(const BvhTriangleGeometry& geometry, size_t triangle, int corner)
+{
+	size_t index = triangle * 3 + corner;
+	if (geometry.indexData) {
+		index = geometry.indexSize == 2 ? static_cast<const uint16_t*>(geometry.indexData)[index]
+			: static_cast<const uint32_t*>(geometry.indexData)[index];
+	}
+	float p[3];
+	std::memcpy(p, static_cast<const uint8_t*>(geometry.vertexData) + index * geometry.vertexStride, sizeof(p));
+	return { p[0], p[1], p[2] };
+}
+
+struct Box {
+	Float3 min{ INFINITY, INFINITY, INFINITY };
+	Float3 max{ -INFINITY, -INFINITY, -INFINITY };
+
+	void grow(Float3 p) { min = ::min(min, p); max = ::max(max, p); }
+	void grow(const Box& b) { min = ::min(min, b.min); max = ::max(max, b.max); }
+	float area() const
+	{
+		Float3 d = max - min;
+		return d.x < 0.0f ? 0.0f : 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+};
+
+// 2진 BVH node. count > 0이면 leaf이고 first부터 count개의 reference를 가진다.
+// 안쪽 node의 자식은 first, first + 1이다.
+struct BinaryNode {
+	Box box;
+	uint32_t first;
+	uint32_t count;
+};
+
+// build 중에 직접 옮겨지는 primitive 정보. 번호로 간접 참조하지 않아서 partition이 cache를 덜 놓친다.
+struct Reference {
+	Box box;
+	uint32_t primitive;
+
+	Float3 centroid() const { return (box.min + box.max) * 0.5f; }
+};
+
+constexpr int kBins = 16;
+// 이보다 큰 node는 자식 둘을 나누어 만든다.
+constexpr uint32_t kParallelBuildThreshold = 1 << 14;
+// 이 깊이부터는 SAH 대신 가운데서 잘라 traversal stack이 넘치지 않게 한다.
+constexpr int kMaxSahDepth = 48;
+constexpr int kTraversalStackSize = 256;
+
+class SahBuilder {
+	public:
+		SahBuilder(std::vector<Reference>& references, ThreadPool& pool)
+		: _references(references), _pool(pool), _nodes(std::max<size_t>(references.size() * 2, 1)), _nodeCount(1) {}
+
+		std::vector<BinaryNode>& build()
+		{
+			Box centroidBox;
+			computeBounds(0, uint32_t(_references.size()), _nodes[0].box, centroidBox);
+			buildNode(0, 0, uint32_t(_references.size()), centroidBox, 0);
+			_nodes.resize(_nodeCount.load());
+			return _nodes;
+		}
+
+	private:
+		struct Bin {
+			Box box;
+			uint32_t count{0};
+
+			void grow(const Bin& other)
+			{
+				box.grow(other.box);
+				count += other.count;
+			}
+		};
+		using Bins = Bin[3][kBins];
+
+		struct BinMapping {
+			float origin[3];
+			float scale[3];
+
+			BinMapping(const Box& centroidBox)
+			{
+				Float3 extent = centroidBox.max - centroidBox.min;
+				float size[3] = { extent.x, extent.y, extent.z };
+				float min[3] = { centroidBox.min.x, centroidBox.min.y, centroidBox.min.z };
+				for (int axis = 0; axis < 3; ++axis) {
+					origin[axis] = min[axis];
+					scale[axis] = size[axis] > 0.0f ? kBins / size[axis] : 0.0f;
+				}
+			}
+			int bin(float c, int axis) const { return std::max(0, std::min(kBins - 1, int((c - origin[axis]) * scale[axis]))); }
+		};
+
+		void computeBounds(uint32_t begin, uint32_t end, Box& box, Box& centroidBox) const
+		{
+			for (uint32_t i = begin; i < end; ++i) {
+				box.grow(_references[i].box);
+				centroidBox.grow(_references[i].centroid());
+			}
+		}
+
+		void binReferences(uint32_t begin, uint32_t end, const BinMapping& mapping, Bins& bins) const
+		{
+			for (uint32_t i = begin; i < end; ++i) {
+				const Reference& reference = _references[i];
+				Float3 centroid = reference.centroid();
+				float c[3] = { centroid.x, centroid.y, centroid.z };
+				for (int axis = 0; axis < 3; ++axis) {
+					Bin& bin = bins[axis][mapping.bin(c[axis], axis)];
+					bin.box.grow(reference.box);
+					++bin.count;
+				}
+			}
+		}
+
+		void buildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end, const Box& centroidBox, int depth)
+		{
+			BinaryNode& node = _nodes[nodeIndex];
+			const uint32_t count = end - begin;
+			Float3 extent = centroidBox.max - centroidBox.min;
+			if (count == 1 || (extent.x <= 0.0f && extent.y <= 0.0f && extent.z <= 0.0f && count <= Bvh::kMaxLeafSize)) {
+				makeLeaf(node, begin, count);
+				return;
+			}
+
+			// 1. 세 축 모두 bin에 나눠 담는다. 큰 node는 조각마다 bin을 따로 채운 뒤 합친다.
+			const BinMapping mapping(centroidBox);
+			Bins bins;
+			if (depth >= kMaxSahDepth) {
+				// bin을 비워 두면 아래에서 가운데 자르기로 넘어간다.
+			} else if (count >= kParallelBuildThreshold * 4) {
+				const size_t grain = kParallelBuildThreshold;
+				std::vector<Bin> partial(((count + grain - 1) / grain) * 3 * kBins);
+				_pool.parallelFor(count, grain, [&](size_t first, size_t last) {
+					Bins& local = *reinterpret_cast<Bins*>(&partial[(first / grain) * 3 * kBins]);
+					binReferences(begin + uint32_t(first), begin + uint32_t(last), mapping, local);
+				});
+				for (size_t chunk = 0; chunk < partial.size(); chunk += 3 * kBins) {
+					for (int i = 0; i < 3 * kBins; ++i) {
+						bins[i / kBins][i % kBins].grow(partial[chunk + i]);
+					}
+				}
+			} else {
+				binReferences(begin, end, mapping, bins);
+			}
+
+			// 2. 경계 kBins - 1개 중 SAH 비용이 가장 작은 곳을 고른다.
+			float bestCost = INFINITY;
+			int bestAxis = -1, bestSplit = 0;
+			for (int axis = 0; axis < 3; ++axis) {
+				float rightArea[kBins];
+				uint32_t rightCount[kBins];
+				Box box;
+				uint32_t running = 0;
+				for (int i = kBins - 1; i > 0; --i) {
+					box.grow(bins[axis][i].box);
+					running += bins[axis][i].count;
+					rightArea[i] = box.area();
+					rightCount[i] = running;
+				}
+				box = Box();
+				running = 0;
+				for (int i = 0; i < kBins - 1; ++i) {
+					box.grow(bins[axis][i].box);
+					running += bins[axis][i].count;
+					if (running == 0 || rightCount[i + 1] == 0) {
+						continue;
+					}
+					float cost = box.area() * running + rightArea[i + 1] * rightCount[i + 1];
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = i + 1;
+					}
+				}
+			}
+			// leaf 비용은 삼각형 수 * 면적, 나누면 node 검사 하나(삼각형 하나 정도)가 더 든다.
+			float leafCost = node.box.area() * count;
+			float splitCost = node.box.area() + bestCost;
+			if (count <= Bvh::kMaxLeafSize && leafCost <= splitCost) {
+				makeLeaf(node, begin, count);
+				return;
+			}
+
+			// 3. 나누기. 자식 bounds는 bin을 합쳐서 얻고, centroid bounds는 나누면서 함께 계산한다.
+			// bin으로 나눌 수 없으면 centroid가 가장 넓은 축의 가운데서 자르고 bounds를 다시 계산한다.
+			uint32_t left = _nodeCount.fetch_add(2);
+			node.first = left;
+			node.count = 0;
+			uint32_t middle = begin + count / 2;
+			Box leftBox, rightBox, leftCentroids, rightCentroids;
+			if (bestAxis < 0) {
+				int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+				std::nth_element(_references.begin() + begin, _references.begin() + middle, _references.begin() + end,
+					[axis](const Reference& a, const Reference& b) {
+						Float3 ca = a.centroid(), cb = b.centroid();
+						return axis == 0 ? ca.x < cb.x : axis == 1 ? ca.y < cb.y : ca.z < cb.z;
+					});
+				computeBounds(begin, middle, leftBox, leftCentroids);
+				computeBounds(middle, end, rightBox, rightCentroids);
+			} else {
+				uint32_t i = begin, j = end;
+				while (i < j) {
+					Float3 c = _references[i].centroid();
+					if (mapping.bin(bestAxis == 0 ? c.x : bestAxis == 1 ? c.y : c.z, bestAxis) < bestSplit) {
+						leftCentroids.grow(c);
+						++i;
+					} else {
+						rightCentroids.grow(c);
+						std::swap(_references[i], _references[--j]);
+					}
+				}
+				middle = i;
+				for (int b = 0; b < kBins; ++b) {
+					(b < bestSplit ? leftBox : rightBox).grow(bins[bestAxis][b].box);
+				}
+			}
+			_nodes[left].box = leftBox;
+			_nodes[left + 1].box = rightBox;
+
+			if (count >= kParallelBuildThreshold) {
+				_pool.parallelFor(2, 1, [&](size_t first, size_t last) {
+					for (size_t i = first; i < last; ++i) {
+						if (i == 0) buildNode(left, begin, middle, leftCentroids, depth + 1);
+						else buildNode(left + 1, middle, end, rightCentroids, depth + 1);
+					}
+				});
+			} else {
+				buildNode(left, begin, middle, leftCentroids, depth + 1);
+				buildNode(left + 1, middle, end, rightCentroids, depth + 1);
+			}
+		}
+
+		void makeLeaf(BinaryNode& node, uint32_t begin, uint32_t count)
+		{
+			node.first = begin;
+			node.count = count;
+		}
+
+		std::vector<Reference>& _references;
+		ThreadPool& _pool;
+		std::vector<BinaryNode> _nodes;
+		std::atomic<uint32_t> _nodeCount;
+};
+
+/*
+ * Morton code(축마다 10 bit) 순서로 정렬한 뒤 code가 처음 달라지는 bit에서 나눈다 (LBVH).
+ * SAH를 계산하지 않으므로 instance transform이 매 frame 바뀌는 top-level tree를 다시 만들 때 쓴다.
+ * */
+class MortonBuilder {
+	public:
+		MortonBuilder(std::vector<Reference>& references, ThreadPool& pool)
+		: _references(references), _pool(pool), _nodes(std::max<size_t>(references.size() * 2, 1)), _nodeCount(1) {}
+
+		std::vector<BinaryNode>& build()
+		{
+			const size_t count = _references.size();
+			Box centroidBox;
+			for (const Reference& reference : _references) {
+				centroidBox.grow(reference.centroid());
+			}
+			Float3 extent = centroidBox.max - centroidBox.min;
+			Float3 scale = { extent.x > 0.0f ? 1023.0f / extent.x : 0.0f, extent.y > 0.0f ? 1023.0f / extent.y : 0.0f,
+				extent.z > 0.0f ? 1023.0f / extent.z : 0.0f };
+
+			// 1. code 계산
+			std::vector<uint64_t> keys(count), sorted(count);
+			_pool.parallelFor(count, 1 << 14, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					Float3 c = _references[i].centroid() - centroidBox.min;
+					uint32_t code = spread(uint32_t(c.x * scale.x)) | spread(uint32_t(c.y * scale.y)) << 1 | spread(uint32_t(c.z * scale.z)) << 2;
+					keys[i] = uint64_t(code) << 32 | i;
+				}
+			});
+
+			// 2. 30 bit code를 10 bit씩 세 번 LSD radix sort
+			for (int shift = 32; shift < 62; shift += 10) {
+				uint32_t offsets[1025] = {};
+				for (uint64_t key : keys) {
+					++offsets[(key >> shift & 1023) + 1];
+				}
+				for (int i = 0; i < 1024; ++i) {
+					offsets[i + 1] += offsets[i];
+				}
+				for (uint64_t key : keys) {
+					sorted[offsets[key >> shift & 1023]++] = key;
+				}
+				keys.swap(sorted);
+			}
+			std::vector<Reference> ordered(count);
+			_codes.resize(count);
+			_pool.parallelFor(count, 1 << 14, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					ordered[i] = _references[uint32_t(keys[i])];
+					_codes[i] = uint32_t(keys[i] >> 32);
+				}
+			});
+			_references.swap(ordered);
+
+			buildNode(0, 0, uint32_t(count));
+			_nodes.resize(_nodeCount.load());
+			return _nodes;
+		}
+
+	private:
+		// 10 bit 값의 bit 사이에 0을 두 개씩 끼운다.
+		static uint32_t spread(uint32_t v)
+		{
+			v = std::min(v, 1023u);
+			v = (v | v << 16) & 0x030000FF;
+			v = (v | v << 8) & 0x0300F00F;
+			v = (v | v << 4) & 0x030C30C3;
+			v = (v | v << 2) & 0x09249249;
+			return v;
+		}
+
+		void buildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end)
+		{
+			BinaryNode& node = _nodes[nodeIndex];
+			const uint32_t count = end - begin;
+			uint32_t first = _codes[begin], last = _codes[end - 1];
+			if (count == 1 || (first == last && count <= Bvh::kMaxLeafSize)) {
+				node.first = begin;
+				node.count = count;
+				node.box = Box();
+				for (uint32_t i = begin; i < end; ++i) {
+					node.box.grow(_references[i].box);
+				}
+				return;
+			}
+
+			// code가 모두 같으면 가운데서, 아니면 가장 높은 다른 bit가 1이 되는 첫 위치에서 자른다.
+			uint32_t middle = begin + count / 2;
+			if (first != last) {
+				int bit = 31 - __builtin_clz(first ^ last);
+				uint32_t mask = ~0u << bit;
+				uint32_t prefix = (first & mask) | 1u << bit;
+				middle = uint32_t(std::lower_bound(_codes.begin() + begin, _codes.begin() + end, prefix) - _codes.begin());
+			}
+
+			uint32_t left = _nodeCount.fetch_add(2);
+			node.first = left;
+			node.count = 0;
+			if (count >= kParallelBuildThreshold) {
+				_pool.parallelFor(2, 1, [&](size_t first, size_t last) {
+					for (size_t i = first; i < last; ++i) {
+						if (i == 0) buildNode(left, begin, middle);
+						else buildNode(left + 1, middle, end);
+					}
+				});
+			} else {
+				buildNode(left, begin, middle);
+				buildNode(left + 1, middle, end);
+			}
+			node.box = _nodes[left].box;
+			node.box.grow(_nodes[left + 1].box);
+		}
+
+		std::vector<Reference>& _references;
+		ThreadPool& _pool;
+		std::vector<uint32_t> _codes;
+		std::vector<BinaryNode> _nodes;
+		std::atomic<uint32_t> _nodeCount;
+};
+
+inline void setSlot(BvhNode4& node, int slot, const Box& box, uint32_t child, uint32_t count)
+{
+	node.minX[slot] = box.min.x; node.minY[slot] = box.min.y; node.minZ[slot] = box.min.z;
+	node.maxX[slot] = box.max.x; node.maxY[slot] = box.max.y; node.maxZ[slot] = box.max.z;
+	node.child[slot] = child;
+	node.count[slot] = count;
+}
+
+inline Box slotBox(const BvhNode4& node, int slot)
+{
+	return { { node.minX[slot], node.minY[slot], node.minZ[slot] }, { node.maxX[slot], node.maxY[slot], node.maxZ[slot] } };
+}
+
+// 2진 node 하나를 4-wide node로 접는다. 면적이 가장 큰 안쪽 자식을 펼치면서 자식을 4개까지 모은다.
+inline uint32_t collapse(const std::vector<BinaryNode>& binary, uint32_t index, std::vector<BvhNode4>& nodes)
+{
+	uint32_t children[4] = { binary[index].first, binary[index].first + 1 };
+	int numberOfChildren = 2;
+	while (numberOfChildren < 4) {
+		int widest = -1;
+		float widestArea = -1.0f;
+		for (int i = 0; i < numberOfChildren; ++i) {
+			const BinaryNode& child = binary[children[i]];
+			if (child.count == 0 && child.box.area() > widestArea) {
+				widest = i;
+				widestArea = child.box.area();
+			}
+		}
+		if (widest < 0) {
+			break;
+		}
+		uint32_t opened = children[widest];
+		children[widest] = binary[opened].first;
+		children[numberOfChildren++] = binary[opened].first + 1;
+	}
+
+	uint32_t nodeIndex = uint32_t(nodes.size());
+	nodes.emplace_back();
+	for (int slot = 0; slot < 4; ++slot) {
+		if (slot >= numberOfChildren) {
+			setSlot(nodes[nodeIndex], slot, Box(), Bvh::kEmpty, 0);
+			continue;
+		}
+		const BinaryNode& child = binary[children[slot]];
+		if (child.count > 0) {
+			setSlot(nodes[nodeIndex], slot, child.box, child.first, child.count);
+		} else {
+			// 자식이 부모보다 뒤에 오므로 refit은 뒤에서부터 한 번만 훑으면 된다.
+			uint32_t childIndex = collapse(binary, children[slot], nodes);
+			setSlot(nodes[nodeIndex], slot, child.box, childIndex, 0);
+		}
+	}
+	return nodeIndex;
+}
+
+// 0으로 나누면 slab 계산에 NaN이 생기므로 아주 작은 값으로 바꾼다.
+inline float safeInverse(float d)
+{
+	return 1.0f / (std::fabs(d) > 1e-20f ? d : std::copysign(1e-20f, d));
+}
+
+// references로 4-wide tree를 만들고 references를 leaf 순서로 바꾼다. 전체 bounds를 돌려준다.
+inline Box buildNodes(std::vector<Reference>& references, BvhBuildMode mode, ThreadPool& pool, std::vector<BvhNode4>& nodes)
+{
+	nodes.clear();
+	if (references.empty()) {
+		return Box();
+	}
+	SahBuilder sahBuilder(references, pool);
+	MortonBuilder mortonBuilder(references, pool);
+	std::vector<BinaryNode>& binary = mode == BvhBuildMode::Fast ? mortonBuilder.build() : sahBuilder.build();
+
+	nodes.reserve(binary.size() / 2 + 1);
+	if (binary[0].count > 0) {
+		// primitive가 몇 개뿐이면 leaf 하나짜리 root를 만든다.
+		nodes.emplace_back();
+		setSlot(nodes[0], 0, binary[0].box, binary[0].first, binary[0].count);
+		for (int slot = 1; slot < 4; ++slot) {
+			setSlot(nodes[0], slot, Box(), Bvh::kEmpty, 0);
+		}
+	} else {
+		collapse(binary, 0, nodes);
+	}
+	return binary[0].box;
+}
+
+// leaf slot의 bounds를 새로 채운 뒤 호출한다. 자식이 부모보다 뒤에 있으므로 뒤에서부터 한 번 훑는다.
+inline Box refitInternalNodes(std::vector<BvhNode4>& nodes)
+{
+	for (size_t n = nodes.size(); n-- > 0;) {
+		BvhNode4& node = nodes[n];
+		for (int slot = 0; slot < 4; ++slot) {
+			if (node.count[slot] != 0 || node.child[slot] == Bvh::kEmpty) {
+				continue;
+			}
+			const BvhNode4& child = nodes[node.child[slot]];
+			Box box;
+			for (int c = 0; c < 4; ++c) {
+				if (child.child[c] != Bvh::kEmpty) {
+					box.grow(slotBox(child, c));
+				}
+			}
+			setSlot(node, slot, box, node.child[slot], 0);
+		}
+	}
+	Box root;
+	for (int slot = 0; nodes.size() > 0 && slot < 4; ++slot) {
+		if (nodes[0].child[slot] != Bvh::kEmpty) {
+			root.grow(slotBox(nodes[0], slot));
+		}
+	}
+	return root;
+}
+
+/*
+ * ray가 지나는 leaf마다 leaf(first, count, tMax)를 가까운 순서로 호출한다.
+ * leaf는 찾은 교차점으로 tMax를 줄일 수 있고, true를 돌려주면 traversal을 끝낸다.
+ * */
+template <typename LeafFunction>
+inline void traverseNodes(const std::vector<BvhNode4>& nodes, Float3 origin, Float3 direction, float tMin, float& tMax, LeafFunction&& leaf)
+{
+	if (nodes.empty()) {
+		return;
+	}
+	const Float3 inverse = { safeInverse(direction.x), safeInverse(direction.y), safeInverse(direction.z) };
+	const Lanes4 ox = Lanes4::splat(origin.x), oy = Lanes4::splat(origin.y), oz = Lanes4::splat(origin.z);
+	const Lanes4 ix = Lanes4::splat(inverse.x), iy = Lanes4::splat(inverse.y), iz = Lanes4::splat(inverse.z);
+	const Lanes4 near = Lanes4::splat(tMin);
+
+	// build가 깊이를 kMaxSahDepth + log2(primitive 수)로 제한하므로 node마다 자식 3개를 쌓아도 넘치지 않는다.
+	uint32_t stack[kTraversalStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const BvhNode4& node = nodes[stack[--stackSize]];
+		Lanes4 t0x = (Lanes4::load(node.minX) - ox) * ix, t1x = (Lanes4::load(node.maxX) - ox) * ix;
+		Lanes4 t0y = (Lanes4::load(node.minY) - oy) * iy, t1y = (Lanes4::load(node.maxY) - oy) * iy;
+		Lanes4 t0z = (Lanes4::load(node.minZ) - oz) * iz, t1z = (Lanes4::load(node.maxZ) - oz) * iz;
+		Lanes4 tNear = max(max(min(t0x, t1x), min(t0y, t1y)), max(min(t0z, t1z), near));
+		Lanes4 tFar = min(min(max(t0x, t1x), max(t0y, t1y)), min(max(t0z, t1z), Lanes4::splat(tMax)));
+		int mask = lessEqualMask(tNear, tFar);
+		if (mask == 0) {
+			continue;
+		}
+		float nearDistances[4];
+		store(nearDistances, tNear);
+
+		// 가까운 자식을 먼저 보도록 leaf는 가까운 순서로 검사하고, node는 먼 것부터 stack에 넣는다.
+		int order[4];
+		int numberOfHits = 0;
+		for (int slot = 0; slot < 4; ++slot) {
+			if ((mask >> slot & 1) && node.child[slot] != Bvh::kEmpty) {
+				int i = numberOfHits++;
+				while (i > 0 && nearDistances[order[i - 1]] < nearDistances[slot]) {
+					order[i] = order[i - 1];
+					--i;
+				}
+				order[i] = slot;
+			}
+		}
+		for (int h = numberOfHits; h-- > 0;) {
+			int slot = order[h];
+			if (node.count[slot] == 0) {
+				continue;
+			}
+			if (nearDistances[slot] <= tMax && leaf(node.child[slot], node.count[slot], tMax)) {
+				return;
+			}
+		}
+		for (int h = 0; h < numberOfHits; ++h) {
+			if (node.count[order[h]] == 0 && nearDistances[order[h]] <= tMax) {
+				stack[stackSize++] = node.child[order[h]];
+			}
+		}
+	}
+}
+
+// keyframe 사이 위치. vanished면 그 시간에는 geometry가 없다.
+struct MotionSample {
+	uint32_t keyframe;
+	float fraction;
+	bool vanished;
+};
+
+inline MotionSample motionSample(float time, size_t keyframeCount, float startTime, float endTime,
+		MotionBorderMode startBorderMode, MotionBorderMode endBorderMode)
+{
+	if (keyframeCount <= 1) {
+		return { 0, 0.0f, false };
+	}
+	if ((time < startTime && startBorderMode == MotionBorderMode::Vanish) || (time > endTime && endBorderMode == MotionBorderMode::Vanish)) {
+		return { 0, 0.0f, true };
+	}
+	float position = endTime > startTime ? (time - startTime) / (endTime - startTime) * float(keyframeCount - 1) : 0.0f;
+	position = std::min(std::max(position, 0.0f), float(keyframeCount - 1));
+	uint32_t keyframe = std::min(uint32_t(position), uint32_t(keyframeCount - 2));
+	return { keyframe, position - float(keyframe), false };
+}
+
+// Möller-Trumbore. [tMin, tMax] 안에서 맞으면 hit을 채운다.
+inline bool intersectTriangle(Float3 v0, Float3 e1, Float3 e2, Float3 origin, Float3 direction, float tMin, float tMax,
+		float& distance, float& u, float& v)
+{
+	Float3 p = cross(direction, e2);
+	float determinant = dot(e1, p);
+	if (std::fabs(determinant) < 1e-12f) {
+		return false;
+	}
+	float inverseDeterminant = 1.0f / determinant;
+	Float3 s = origin - v0;
+	u = dot(s, p) * inverseDeterminant;
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+	Float3 q = cross(s, e1);
+	v = dot(direction, q) * inverseDeterminant;
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+	distance = dot(e2, q) * inverseDeterminant;
+	return distance >= tMin && distance <= tMax;
+}
+
+} // namespace BvhDetail
+
+#pragma endregion BvhInput }
+
+#pragma region BvhBuild {
+
+inline bool Bvh::loadTriangles(const BvhMotionTriangleGeometry& geometry, ThreadPool& pool)
+{
+	const size_t count = _primitiveIndices.size();
+	_triangles.resize(geometry.keyframeCount * count * 3);
+	for (size_t k = 0; k < geometry.keyframeCount; ++k) {
+		const BvhTriangleGeometry& keyframe = geometry.keyframes[k];
+		Float3* triangles = _triangles.data() + k * count * 3;
+		pool.parallelFor(count, 1 << 14, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				Float3 v0 = BvhDetail::vertexAt(keyframe, _primitiveIndices[i], 0);
+				Float3 v1 = BvhDetail::vertexAt(keyframe, _primitiveIndices[i], 1);
+				Float3 v2 = BvhDetail::vertexAt(keyframe, _primitiveIndices[i], 2);
+				triangles[i * 3] = v0;
+				triangles[i * 3 + 1] = v1 - v0;
+				triangles[i * 3 + 2] = v2 - v0;
+			}
+		});
+	}
+	return true;
+}
+
+inline bool Bvh::build(const BvhTriangleGeometry& geometry, BvhBuildMode mode, ThreadPool& pool)
+{
+	BvhMotionTriangleGeometry single;
+	single.keyframes = &geometry;
+	single.keyframeCount = 1;
+	return build(single, mode, pool);
+}
+
+inline bool Bvh::build(const BvhMotionTriangleGeometry& geometry, BvhBuildMode mode, ThreadPool& pool)
+{
+	using namespace BvhDetail;
+	_nodes.clear();
+	_triangles.clear();
+	_primitiveIndices.clear();
+	_bounds = {};
+	_motion = BvhMotionTriangleGeometry();
+	if (geometry.keyframeCount == 0) {
+		return true;
+	}
+	const size_t count = geometry.keyframes[0].triangleCount;
+	for (size_t k = 1; k < geometry.keyframeCount; ++k) {
+		if (geometry.keyframes[k].triangleCount != count) {
+			std::cerr << "Bvh: keyframe " << k << " has " << geometry.keyframes[k].triangleCount << " triangles, expected " << count << std::endl;
+			return false;
+		}
+	}
+	if (count == 0) {
+		return true;
+	}
+
+	// motion이면 모든 keyframe의 bounds를 합친다. 선형 보간한 삼각형은 이 안에 있다.
+	std::vector<Reference> references(count);
+	pool.parallelFor(count, 1 << 14, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t) {
+			Box box;
+			for (size_t k = 0; k < geometry.keyframeCount; ++k) {
+				for (int corner = 0; corner < 3; ++corner) {
+					box.grow(vertexAt(geometry.keyframes[k], t, corner));
+				}
+			}
+			references[t] = { box, uint32_t(t) };
+		}
+	});
+
+	Box root = buildNodes(references, mode, pool, _nodes);
+	_bounds = { pack(root.min), pack(root.max) };
+	_primitiveIndices.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		_primitiveIndices[i] = references[i].primitive;
+	}
+	_motion = geometry;
+	_motion.keyframes = nullptr;
+	return loadTriangles(geometry, pool);
+}
+
+inline bool Bvh::refit(const BvhTriangleGeometry& geometry, ThreadPool& pool)
+{
+	BvhMotionTriangleGeometry single;
+	single.keyframes = &geometry;
+	single.keyframeCount = 1;
+	return refit(single, pool);
+}
+
+inline bool Bvh::refit(const BvhMotionTriangleGeometry& geometry, ThreadPool& pool)
+{
+	using namespace BvhDetail;
+	if (_nodes.empty() || geometry.keyframeCount != _motion.keyframeCount || geometry.keyframes[0].triangleCount != _primitiveIndices.size()) {
+		return build(geometry, BvhBuildMode::Sah, pool);
+	}
+	loadTriangles(geometry, pool);
+	_motion = geometry;
+	_motion.keyframes = nullptr;
+
+	// leaf slot은 서로 독립이므로 병렬로, 안쪽 slot은 자식이 뒤에 있으므로 뒤에서부터 채운다.
+	const size_t count = _primitiveIndices.size();
+	pool.parallelFor(_nodes.size(), 1024, [&](size_t begin, size_t end) {
+		for (size_t n = begin; n < end; ++n) {
+			BvhNode4& node = _nodes[n];
+			for (int slot = 0; slot < 4; ++slot) {
+				if (node.count[slot] == 0) {
+					continue;
+				}
+				Box box;
+				for (size_t k = 0; k < geometry.keyframeCount; ++k) {
+					const Float3* triangles = _triangles.data() + k * count * 3;
+					for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; ++i) {
+						box.grow(triangles[i * 3]);
+						box.grow(triangles[i * 3] + triangles[i * 3 + 1]);
+						box.grow(triangles[i * 3] + triangles[i * 3 + 2]);
+					}
+				}
+				setSlot(node, slot, box, node.child[slot], node.count[slot]);
+			}
+		}
+	});
+	Box root = refitInternalNodes(_nodes);
+	_bounds = { pack(root.min), pack(root.max) };
+	return true;
+}
+
+#pragma endregion BvhBuild }
+
+#pragma region BvhTraversal {
+
+template <bool AnyHit>
+inline bool Bvh::traverse(const Ray& ray, RayHit& hit, float time) const
+{
+	using namespace BvhDetail;
+	hit = { -1.0f, kEmpty, 0.0f, 0.0f };
+	if (_nodes.empty()) {
+		return false;
+	}
+	const MotionSample sample = motionSample(time, _motion.keyframeCount, _motion.motionStartTime, _motion.motionEndTime,
+		_motion.motionStartBorderMode, _motion.motionEndBorderMode);
+	if (sample.vanished) {
+		return false;
+	}
+	const size_t count = _primitiveIndices.size();
+	const Float3* from = _triangles.data() + sample.keyframe * count * 3;
+	const Float3* to = sample.fraction > 0.0f ? from + count * 3 : nullptr;
+	const Float3 origin = unpack(ray.origin);
+	const Float3 direction = unpack(ray.direction);
+	float tMax = ray.maxDistance;
+	bool found = false;
+	traverseNodes(_nodes, origin, direction, ray.minDistance, tMax, [&](uint32_t first, uint32_t leafCount, float& maxDistance) {
+		for (uint32_t i = first; i < first + leafCount; ++i) {
+			const Float3* t = from + i * 3;
+			Float3 v0 = t[0], e1 = t[1], e2 = t[2];
+			if (to) {
+				// 꼭짓점이 선형 보간되면 변도 같은 비율로 보간된다.
+				const Float3* u = to + i * 3;
+				v0 = v0 + (u[0] - v0) * sample.fraction;
+				e1 = e1 + (u[1] - e1) * sample.fraction;
+				e2 = e2 + (u[2] - e2) * sample.fraction;
+			}
+			float distance, u, v;
+			if (!intersectTriangle(v0, e1, e2, origin, direction, ray.minDistance, maxDistance, distance, u, v)) {
+				continue;
+			}
+			hit = { distance, _primitiveIndices[i], u, v };
+			found = true;
+			if (AnyHit) {
+				return true;
+			}
+			maxDistance = distance;
+		}
+		return false;
+	});
+	return found;
+}
+
+inline bool Bvh::intersect(const Ray& ray, RayHit& hit, float time) const
+{
+	return traverse<false>(ray, hit, time);
+}
+
+inline bool Bvh::occluded(const Ray& ray, float time) const
+{
+	RayHit hit;
+	return traverse<true>(ray, hit, time);
+}
+
+inline void Bvh::intersect(const Ray* rays, RayHit* hits, size_t count, float time, ThreadPool& pool) const
+{
+	pool.parallelFor(count, 1024, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			intersect(rays[i], hits[i], time);
+		}
+	});
+}
+
+#pragma endregion BvhTraversal }
@@ -0,0 +1,819 @@
+/*
+ * CommandTrace.hpp
+ *
+ * render encoder 호출을 binary trace로 기록하고 다시 재생한다. 실제 frame을 그대로 저장해 두고
+ * Metal 없이(Linux에서도) 호출 열을 재생해서 CPU 쪽 비용을 재거나 성능이 달라진 지점을 찾는 데 쓴다.
+ *
+ * CapturingRenderEncoder가 encoder 앞에 붙어 호출을 그대로 넘기면서 CommandTraceWriter에 기록한다.
+ * pipeline / depth-stencil / sampler state, texture, buffer는 처음 볼 때 작은 번호를 붙이고, frame이 끝날 때
+ * 그 frame에서 쓴 buffer의 내용을 저장한다. 내용이 지난번과 같으면 다시 저장하지 않는다.
+ * (GPU는 commit 뒤에 buffer를 읽으므로 encode 도중이 아니라 frame 끝의 내용이 맞다.)
+ * texture는 번호만 남기고 texel은 저장하지 않는다. 재생에서는 어느 slot에 무엇이 묶였는지만 알 수 있다.
+ *
+ * 파일 배치 (little endian, 정수는 모두 LEB128 varint)
+ *   "LMTRACE\0" | version(u32)
+ *   frame마다: BeginFrame | Define* | BufferContents* | 호출 ... | EndFrame
+ *   - DefineObject: id, kind(u8), 기록할 때의 주소
+ *   - DefineBuffer: id, 기록할 때의 주소
+ *   - BufferContents: id, length, 내용
+ *   - 호출: op(u8)와 인자. setVertexBytes / setFragmentBytes는 내용을 그대로 담는다. viewport는 double 6개.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RecordingEncoder.hpp"
+
+// buffer 내용을 읽는 방법. Metal에서는 MTL::Buffer::contents() / length()이다.
+struct TraceBufferView {
+	const void* contents;
+	size_t length;
+};
+using TraceBufferResolver = TraceBufferView (*)(const void* buffer);
+
+enum class TraceObjectKind : uint8_t {
+	RenderPipelineState,
+	DepthStencilState,
+	Texture,
+	SamplerState,
+};
+
+enum class TraceOp : uint8_t {
+	BeginFrame,
+	EndFrame,
+	DefineObject,
+	DefineBuffer,
+	BufferContents,
+	SetRenderPipelineState,
+	SetDepthStencilState,
+	SetViewport,
+	SetCullMode,
+	SetVertexBuffer,
+	SetVertexBufferOffset,
+	SetVertexBytes,
+	SetFragmentBuffer,
+	SetFragmentBufferOffset,
+	SetFragmentBytes,
+	SetVertexTexture,
+	SetVertexSamplerState,
+	SetFragmentTexture,
+	SetFragmentSamplerState,
+	DrawPrimitives,
+	DrawIndexedPrimitives,
+	Count,
+};
+
+const char* traceOpName(TraceOp op);
+
+class CommandTraceWriter {
+	public:
+		static constexpr uint32_t kVersion = 2;
+		// object / buffer 번호가 없음을 뜻한다. (nullptr를 묶을 때)
+		static constexpr uint32_t kNone = 0;
+
+		CommandTraceWriter() { clear(); }
+		// header만 남기고 지운다.
+		void clear();
+		void setBufferResolver(TraceBufferResolver resolver) { _resolver = resolver; }
+
+		void beginFrame();
+		void endFrame();
+		bool inFrame() const { return _inFrame; }
+		size_t numberOfFrames() const { return _numberOfFrames; }
+
+		// 처음 보는 것이면 번호를 붙이고 Define을 남긴다. nullptr는 kNone이다.
+		uint32_t objectId(TraceObjectKind kind, const void* object);
+		// frame 끝에 내용을 저장할 buffer로 표시한다.
+		uint32_t bufferId(const void* buffer);
+
+		// 호출 하나. 인자는 op마다 정해진 순서이다. (payload는 bytes 호출과 viewport만 쓴다)
+		void writeCall(TraceOp op, std::initializer_list<uint64_t> arguments, const void* payload = nullptr, size_t payloadSize = 0);
+
+		const std::vector<uint8_t>& bytes() const { return _bytes; }
+		bool save(const char* path) const;
+
+	private:
+		struct BufferRecord {
+			uint32_t id;
+			// 마지막으로 저장한 내용
+			uint64_t hash;
+			size_t length;
+			// 이번 frame에서 썼는가
+			bool used;
+			bool saved;
+		};
+
+		static void writeVarint(std::vector<uint8_t>& out, uint64_t value);
+		static uint64_t hashContents(const void* data, size_t size);
+
+		std::vector<uint8_t> _bytes;
+		// frame이 끝날 때 _bytes로 옮긴다.
+		std::vector<uint8_t> _definitions;
+		std::vector<uint8_t> _calls;
+		std::unordered_map<const void*, uint32_t> _objectIds;
+		std::unordered_map<const void*, BufferRecord> _buffers;
+		std::vector<const void*> _usedBuffers;
+		uint32_t _nextId{1};
+		TraceBufferResolver _resolver{nullptr};
+		size_t _numberOfFrames{0};
+		bool _inFrame{false};
+};
+
+/*
+ * Encoder 앞에 붙어 모든 호출을 그대로 넘긴다. writer가 있고 frame 안일 때만 기록한다.
+ * FilteringRenderEncoder<CapturingRenderEncoder<...>>처럼 쓰면 실제로 Metal까지 간 호출만 남는다.
+ * */
+template <class Encoder>
+class CapturingRenderEncoder {
+	public:
+		explicit CapturingRenderEncoder(Encoder* encoder = nullptr) : _encoder(encoder) {}
+
+		void reset(Encoder* encoder) { _encoder = encoder; }
+		// nullptr이면 기록하지 않는다.
+		void setWriter(CommandTraceWriter* writer) { _writer = writer; }
+		Encoder* encoder() const { return _encoder; }
+
+		template <class PipelineState>
+		void setRenderPipelineState(const PipelineState* pipelineState)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetRenderPipelineState, { _writer->objectId(TraceObjectKind::RenderPipelineState, pipelineState) });
+			}
+			_encoder->setRenderPipelineState(pipelineState);
+		}
+		template <class DepthStencilState>
+		void setDepthStencilState(const DepthStencilState* depthStencilState)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetDepthStencilState, { _writer->objectId(TraceObjectKind::DepthStencilState, depthStencilState) });
+			}
+			_encoder->setDepthStencilState(depthStencilState);
+		}
+		template <class Viewport>
+		void setViewport(const Viewport& viewport)
+		{
+			static_assert(sizeof(Viewport) == sizeof(RecordedViewport), "viewport is stored as six doubles");
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetViewport, {}, &viewport, sizeof(viewport));
+			}
+			_encoder->setViewport(viewport);
+		}
+		template <class CullMode>
+		void setCullMode(CullMode cullMode)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetCullMode, { uint64_t(cullMode) });
+			}
+			_encoder->setCullMode(cullMode);
+		}
+
+		template <class Buffer>
+		void setVertexBuffer(const Buffer* buffer, size_t offset, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetVertexBuffer, { _writer->bufferId(buffer), offset, index });
+			}
+			_encoder->setVertexBuffer(buffer, offset, index);
+		}
+		void setVertexBufferOffset(size_t offset, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetVertexBufferOffset, { offset, index });
+			}
+			_encoder->setVertexBufferOffset(offset, index);
+		}
+		void setVertexBytes(const void* bytes, size_t length, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetVertexBytes, { index }, bytes, length);
+			}
+			_encoder->setVertexBytes(bytes, length, index);
+		}
+		template <class Buffer>
+		void setFragmentBuffer(const Buffer* buffer, size_t offset, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetFragmentBuffer, { _writer->bufferId(buffer), offset, index });
+			}
+			_encoder->setFragmentBuffer(buffer, offset, index);
+		}
+		void setFragmentBufferOffset(size_t offset, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetFragmentBufferOffset, { offset, index });
+			}
+			_encoder->setFragmentBufferOffset(offset, index);
+		}
+		void setFragmentBytes(const void* bytes, size_t length, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetFragmentBytes, { index }, bytes, length);
+			}
+			_encoder->setFragmentBytes(bytes, length, index);
+		}
+
+		template <class Texture>
+		void setVertexTexture(const Texture* texture, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetVertexTexture, { _writer->objectId(TraceObjectKind::Texture, texture), index });
+			}
+			_encoder->setVertexTexture(texture, index);
+		}
+		template <class SamplerState>
+		void setVertexSamplerState(const SamplerState* samplerState, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetVertexSamplerState, { _writer->objectId(TraceObjectKind::SamplerState, samplerState), index });
+			}
+			_encoder->setVertexSamplerState(samplerState, index);
+		}
+		template <class Texture>
+		void setFragmentTexture(const Texture* texture, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetFragmentTexture, { _writer->objectId(TraceObjectKind::Texture, texture), index });
+			}
+			_encoder->setFragmentTexture(texture, index);
+		}
+		template <class SamplerState>
+		void setFragmentSamplerState(const SamplerState* samplerState, size_t index)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::SetFragmentSamplerState, { _writer->objectId(TraceObjectKind::SamplerState, samplerState), index });
+			}
+			_encoder->setFragmentSamplerState(samplerState, index);
+		}
+
+		template <class PrimitiveType>
+		void drawPrimitives(PrimitiveType primitiveType, size_t vertexStart, size_t vertexCount, size_t instanceCount = 1)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::DrawPrimitives, { uint64_t(primitiveType), vertexStart, vertexCount, instanceCount });
+			}
+			_encoder->drawPrimitives(primitiveType, vertexStart, vertexCount, instanceCount);
+		}
+		template <class PrimitiveType, class IndexType, class Buffer>
+		void drawIndexedPrimitives(PrimitiveType primitiveType, size_t indexCount, IndexType indexType, const Buffer* indexBuffer,
+				size_t indexBufferOffset, size_t instanceCount = 1)
+		{
+			if (capturing()) {
+				_writer->writeCall(TraceOp::DrawIndexedPrimitives, { uint64_t(primitiveType), indexCount, uint64_t(indexType),
+						_writer->bufferId(indexBuffer), indexBufferOffset, instanceCount });
+			}
+			_encoder->drawIndexedPrimitives(primitiveType, indexCount, indexType, indexBuffer, indexBufferOffset, instanceCount);
+		}
+
+	private:
+		bool capturing() const { return _writer && _writer->inFrame(); }
+
+		Encoder* _encoder;
+		CommandTraceWriter* _writer{nullptr};
+};
+
+// 읽어 들인 trace의 명령 하나
+struct TraceCommand {
+	TraceOp op;
+	// op마다 정해진 순서. writeCall에 넘긴 것과 같다. Define*은 (id, kind 또는 0, 주소)
+	uint64_t arguments[6];
+	// bytes 호출, viewport, BufferContents의 내용 (trace data 안의 위치)
+	size_t payload;
+	size_t payloadSize;
+};
+
+struct TraceFrame {
+	// CommandTrace::commands() 안의 구간. BeginFrame / EndFrame은 들어 있지 않다.
+	size_t firstCommand;
+	size_t numberOfCommands;
+	size_t numberOfDraws;
+	size_t contentBytes;
+};
+
+class CommandTrace {
+	public:
+		bool load(const char* path, std::string& error);
+		// data를 가져가서 읽는다. 실패하면 error에 이유를 남긴다.
+		bool parse(std::vector<uint8_t> data, std::string& error);
+
+		const std::vector<TraceCommand>& commands() const { return _commands; }
+		const std::vector<TraceFrame>& frames() const { return _frames; }
+		const uint8_t* payload(const TraceCommand& command) const { return _data.data() + command.payload; }
+		// 번호는 1부터 numberOfIds() - 1까지 (0은 kNone)
+		size_t numberOfIds() const { return _numberOfIds; }
+		size_t sizeInBytes() const { return _data.size(); }
+
+	private:
+		std::vector<uint8_t> _data;
+		std::vector<TraceCommand> _commands;
+		std::vector<TraceFrame> _frames;
+		size_t _numberOfIds{0};
+};
+
+/*
+ * trace를 RecordingEncoder와 같은 모양의 encoder(정수 인자, const void* handle)로 재생한다.
+ * handle은 기본으로 번호마다 고정된 가짜 값(id << 4)이라서 몇 번을 재생해도 같다. 기록할 때의 주소를 쓸 수도 있다.
+ * replayFrame 중에는 그 frame의 buffer 내용을 contents()에서 읽을 수 있다. (CPU backend용)
+ * trace에는 바뀐 내용만 들어 있으므로 buffer마다 그 frame이나 앞 frame에서 마지막으로 저장된 내용을 찾아 쓴다.
+ * 그래서 frame을 어떤 순서로 재생해도 결과가 같다.
+ * */
+class CommandTraceReplayer {
+	public:
+		explicit CommandTraceReplayer(const CommandTrace& trace, bool originalAddresses = false);
+
+		template <class Encoder>
+		void replayFrame(size_t frame, Encoder& encoder);
+
+		const void* handle(uint64_t id) const { return id < _handles.size() ? _handles[id] : nullptr; }
+		TraceBufferView contents(uint64_t id) const { return id < _contents.size() ? _contents[id] : TraceBufferView{ nullptr, 0 }; }
+
+	private:
+		// buffer 내용이 저장된 frame과 그 내용. frame 순서이다.
+		struct ContentsVersion {
+			size_t frame;
+			TraceBufferView contents;
+		};
+
+		const CommandTrace& _trace;
+		std::vector<const void*> _handles;
+		std::vector<TraceBufferView> _contents;
+		// 번호마다 BufferContents가 나온 frame들
+		std::vector<std::vector<ContentsVersion>> _versions;
+};
+
+#pragma region CommandTraceWriter {
+
+inline const char* traceOpName(TraceOp op)
+{
+	static const char* const names[] = { "BeginFrame", "EndFrame", "DefineObject", "DefineBuffer", "BufferContents",
+		"SetRenderPipelineState", "SetDepthStencilState", "SetViewport", "SetCullMode", "SetVertexBuffer", "SetVertexBufferOffset",
+		"SetVertexBytes", "SetFragmentBuffer", "SetFragmentBufferOffset", "SetFragmentBytes", "SetVertexTexture", "SetVertexSamplerState",
+		"SetFragmentTexture", "SetFragmentSamplerState", "DrawPrimitives", "DrawIndexedPrimitives" };
+	static_assert(sizeof(names) / sizeof(names[0]) == size_t(TraceOp::Count), "every op needs a name");
+	return op < TraceOp::Count ? names[size_t(op)] : "?";
+}
+
+inline void CommandTraceWriter::writeVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80) {
+		out.push_back(uint8_t(value) | 0x80);
+		value >>= 7;
+	}
+	out.push_back(uint8_t(value));
+}
+
+inline uint64_t CommandTraceWriter::hashContents(const void* data, size_t size)
+{
+	// 8 byte 단위로 섞는다. 큰 vertex buffer를 frame마다 비교해야 한다.
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = 0xCBF29CE484222325ull ^ size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+		hash ^= hash >> 32;
+	}
+	for (; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+inline void CommandTraceWriter::clear()
+{
+	_bytes.clear();
+	_bytes.insert(_bytes.end(), { 'L', 'M', 'T', 'R', 'A', 'C', 'E', '\0' });
+	for (int shift = 0; shift < 32; shift += 8) {
+		_bytes.push_back(uint8_t(kVersion >> shift));
+	}
+	_definitions.clear();
+	_calls.clear();
+	_objectIds.clear();
+	_buffers.clear();
+	_usedBuffers.clear();
+	_nextId = 1;
+	_numberOfFrames = 0;
+	_inFrame = false;
+}
+
+inline void CommandTraceWriter::beginFrame()
+{
+	if (_inFrame) {
+		endFrame();
+	}
+	_inFrame = true;
+	_definitions.clear();
+	_calls.clear();
+	_usedBuffers.clear();
+}
+
+inline void CommandTraceWriter::endFrame()
+{
+	if (!_inFrame) {
+		return;
+	}
+	_inFrame = false;
+	_bytes.push_back(uint8_t(TraceOp::BeginFrame));
+	writeVarint(_bytes, _numberOfFrames++);
+	_bytes.insert(_bytes.end(), _definitions.begin(), _definitions.end());
+	for (const void* buffer : _usedBuffers) {
+		BufferRecord& record = _buffers[buffer];
+		record.used = false;
+		TraceBufferView view = _resolver ? _resolver(buffer) : TraceBufferView{ nullptr, 0 };
+		if (!view.contents) {
+			continue;
+		}
+		uint64_t hash = hashContents(view.contents, view.length);
+		if (record.saved && record.hash == hash && record.length == view.length) {
+			continue;
+		}
+		record.hash = hash;
+		record.length = view.length;
+		record.saved = true;
+		_bytes.push_back(uint8_t(TraceOp::BufferContents));
+		writeVarint(_bytes, record.id);
+		writeVarint(_bytes, view.length);
+		const uint8_t* contents = static_cast<const uint8_t*>(view.contents);
+		_bytes.insert(_bytes.end(), contents, contents + view.length);
+	}
+	_bytes.insert(_bytes.end(), _calls.begin(), _calls.end());
+	_bytes.push_back(uint8_t(TraceOp::EndFrame));
+}
+
+inline uint32_t CommandTraceWriter::objectId(TraceObjectKind kind, const void* object)
+{
+	if (!object) {
+		return kNone;
+	}
+	auto [found, inserted] = _objectIds.try_emplace(object, _nextId);
+	if (inserted) {
+		++_nextId;
+		_definitions.push_back(uint8_t(TraceOp::DefineObject));
+		writeVarint(_definitions, found->second);
+		_definitions.push_back(uint8_t(kind));
+		writeVarint(_definitions, uint64_t(uintptr_t(object)));
+	}
+	return found->second;
+}
+
+inline uint32_t CommandTraceWriter::bufferId(const void* buffer)
+{
+	if (!buffer) {
+		return kNone;
+	}
+	auto [found, inserted] = _buffers.try_emplace(buffer, BufferRecord{ _nextId, 0, 0, false, false });
+	BufferRecord& record = found->second;
+	if (inserted) {
+		++_nextId;
+		_definitions.push_back(uint8_t(TraceOp::DefineBuffer));
+		writeVarint(_definitions, record.id);
+		writeVarint(_definitions, uint64_t(uintptr_t(buffer)));
+	}
+	if (!record.used) {
+		record.used = true;
+		_usedBuffers.push_back(buffer);
+	}
+	return record.id;
+}
+
+inline void CommandTraceWriter::writeCall(TraceOp op, std::initializer_list<uint64_t> arguments, const void* payload, size_t payloadSize)
+{
+	_calls.push_back(uint8_t(op));
+	for (uint64_t argument : arguments) {
+		writeVarint(_calls, argument);
+	}
+	if (op == TraceOp::SetViewport) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+		_calls.insert(_calls.end(), bytes, bytes + payloadSize);
+	} else if (op == TraceOp::SetVertexBytes || op == TraceOp::SetFragmentBytes) {
+		writeVarint(_calls, payloadSize);
+		const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+		_calls.insert(_calls.end(), bytes, bytes + payloadSize);
+	}
+}
+
+inline bool CommandTraceWriter::save(const char* path) const
+{
+	FILE* file = std::fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+	bool written = std::fwrite(_bytes.data(), 1, _bytes.size(), file) == _bytes.size();
+	return std::fclose(file) == 0 && written;
+}
+
+#pragma endregion CommandTraceWriter }
+
+#pragma region CommandTrace {
+
+inline bool CommandTrace::load(const char* path, std::string& error)
+{
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		error = std::string("cannot open ") + path;
+		return false;
+	}
+	std::vector<uint8_t> data;
+	uint8_t chunk[1 << 16];
+	size_t n;
+	while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		data.insert(data.end(), chunk, chunk + n);
+	}
+	std::fclose(file);
+	return parse(std::move(data), error);
+}
+
+inline bool CommandTrace::parse(std::vector<uint8_t> data, std::string& error)
+{
+	_data = std::move(data);
+	_commands.clear();
+	_frames.clear();
+	_numberOfIds = 1;
+
+	const uint8_t* bytes = _data.data();
+	const size_t size = _data.size();
+	if (size < 12 || std::memcmp(bytes, "LMTRACE\0", 8) != 0) {
+		error = "not a command trace";
+		return false;
+	}
+	uint32_t version = uint32_t(bytes[8]) | uint32_t(bytes[9]) << 8 | uint32_t(bytes[10]) << 16 | uint32_t(bytes[11]) << 24;
+	if (version != CommandTraceWriter::kVersion) {
+		error = "unsupported trace version " + std::to_string(version);
+		return false;
+	}
+
+	size_t cursor = 12;
+	bool truncated = false;
+	auto varint = [&]() -> uint64_t {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (cursor >= size) {
+				truncated = true;
+				return 0;
+			}
+			uint8_t byte = bytes[cursor++];
+			value |= uint64_t(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				return value;
+			}
+		}
+		truncated = true;
+		return 0;
+	};
+	auto skip = [&](TraceCommand& command, uint64_t length) {
+		if (length > size - cursor) {
+			truncated = true;
+			return;
+		}
+		command.payload = cursor;
+		command.payloadSize = size_t(length);
+		cursor += size_t(length);
+	};
+
+	TraceFrame* frame = nullptr;
+	while (cursor < size && !truncated) {
+		TraceCommand command{};
+		command.op = TraceOp(bytes[cursor++]);
+		int numberOfArguments = 0;
+		switch (command.op) {
+			case TraceOp::BeginFrame:
+				if (frame) {
+					error = "frame " + std::to_string(_frames.size() - 1) + " has no end";
+					return false;
+				}
+				varint();
+				_frames.push_back({ _commands.size(), 0, 0, 0 });
+				frame = &_frames.back();
+				continue;
+			case TraceOp::EndFrame:
+				if (!frame) {
+					error = "EndFrame without BeginFrame";
+					return false;
+				}
+				frame->numberOfCommands = _commands.size() - frame->firstCommand;
+				frame = nullptr;
+				continue;
+			case TraceOp::DefineObject:
+				command.arguments[0] = varint();
+				if (cursor < size) {
+					command.arguments[1] = bytes[cursor++];
+				}
+				command.arguments[2] = varint();
+				break;
+			case TraceOp::DefineBuffer:
+				command.arguments[0] = varint();
+				command.arguments[2] = varint();
+				break;
+			case TraceOp::BufferContents:
+				command.arguments[0] = varint();
+				skip(command, varint());
+				break;
+			case TraceOp::SetViewport:
+				skip(command, sizeof(RecordedViewport));
+				break;
+			case TraceOp::SetVertexBytes:
+			case TraceOp::SetFragmentBytes:
+				command.arguments[0] = varint();
+				skip(command, varint());
+				break;
+			case TraceOp::SetRenderPipelineState:
+			case TraceOp::SetDepthStencilState:
+			case TraceOp::SetCullMode:
+				numberOfArguments = 1;
+				break;
+			case TraceOp::SetVertexBufferOffset:
+			case TraceOp::SetFragmentBufferOffset:
+			case TraceOp::SetVertexTexture:
+			case TraceOp::SetVertexSamplerState:
+			case TraceOp::SetFragmentTexture:
+			case TraceOp::SetFragmentSamplerState:
+				numberOfArguments = 2;
+				break;
+			case TraceOp::SetVertexBuffer:
+			case TraceOp::SetFragmentBuffer:
+				numberOfArguments = 3;
+				break;
+			case TraceOp::DrawPrimitives:
+				numberOfArguments = 4;
+				break;
+			case TraceOp::DrawIndexedPrimitives:
+				numberOfArguments = 6;
+				break;
+			default:
+				error = "unknown op " + std::to_string(int(command.op)) + " at byte " + std::to_string(cursor - 1);
+				return false;
+		}
+		for (int i = 0; i < numberOfArguments; ++i) {
+			command.arguments[i] = varint();
+		}
+		if (!frame) {
+			error = std::string(traceOpName(command.op)) + " outside a frame";
+			return false;
+		}
+		// Metal의 slot은 buffer 31개, texture 128개, sampler 16개이다. 재생하는 encoder가 slot 번호를 그대로 믿어도 되게 여기서 막는다.
+		uint64_t slot = 0;
+		size_t numberOfSlots = 0;
+		switch (command.op) {
+			case TraceOp::SetVertexBuffer:
+			case TraceOp::SetFragmentBuffer:
+				slot = command.arguments[2], numberOfSlots = RecordingEncoder::kMaxBufferSlots;
+				break;
+			case TraceOp::SetVertexBufferOffset:
+			case TraceOp::SetFragmentBufferOffset:
+				slot = command.arguments[1], numberOfSlots = RecordingEncoder::kMaxBufferSlots;
+				break;
+			case TraceOp::SetVertexBytes:
+			case TraceOp::SetFragmentBytes:
+				slot = command.arguments[0], numberOfSlots = RecordingEncoder::kMaxBufferSlots;
+				break;
+			case TraceOp::SetVertexTexture:
+			case TraceOp::SetFragmentTexture:
+				slot = command.arguments[1], numberOfSlots = RecordingEncoder::kMaxTextureSlots;
+				break;
+			case TraceOp::SetVertexSamplerState:
+			case TraceOp::SetFragmentSamplerState:
+				slot = command.arguments[1], numberOfSlots = RecordingEncoder::kMaxSamplerSlots;
+				break;
+			default:
+				break;
+		}
+		if (numberOfSlots && slot >= numberOfSlots) {
+			error = std::string(traceOpName(command.op)) + " has slot index " + std::to_string(slot);
+			return false;
+		}
+		// 번호는 처음 볼 때 1부터 차례로 붙는다.
+		if (command.op == TraceOp::DefineObject || command.op == TraceOp::DefineBuffer) {
+			if (command.arguments[0] != _numberOfIds) {
+				error = "unexpected id " + std::to_string(command.arguments[0]);
+				return false;
+			}
+			++_numberOfIds;
+		}
+		frame->numberOfDraws += command.op == TraceOp::DrawPrimitives || command.op == TraceOp::DrawIndexedPrimitives;
+		frame->contentBytes += command.op == TraceOp::BufferContents ? command.payloadSize : 0;
+		_commands.push_back(command);
+	}
+	if (truncated) {
+		error = "trace is truncated";
+		return false;
+	}
+	if (frame) {
+		error = "last frame has no end";
+		return false;
+	}
+	return true;
+}
+
+#pragma endregion CommandTrace }
+
+#pragma region CommandTraceReplayer {
+
+inline CommandTraceReplayer::CommandTraceReplayer(const CommandTrace& trace, bool originalAddresses)
+: _trace(trace), _handles(trace.numberOfIds(), nullptr), _contents(trace.numberOfIds(), TraceBufferView{ nullptr, 0 })
+{
+	// 가짜 handle은 가리키는 곳이 없는 고정된 값이다. encoder는 비교만 해야 한다.
+	for (size_t id = 1; id < _handles.size(); ++id) {
+		_handles[id] = reinterpret_cast<const void*>(uintptr_t(id) << 4);
+	}
+	if (originalAddresses) {
+		for (const TraceCommand& command : trace.commands()) {
+			if (command.op == TraceOp::DefineObject || command.op == TraceOp::DefineBuffer) {
+				_handles[command.arguments[0]] = reinterpret_cast<const void*>(uintptr_t(command.arguments[2]));
+			}
+		}
+	}
+	_versions.resize(trace.numberOfIds());
+	for (size_t frame = 0; frame < trace.frames().size(); ++frame) {
+		const TraceFrame& range = trace.frames()[frame];
+		for (size_t c = range.firstCommand; c < range.firstCommand + range.numberOfCommands; ++c) {
+			const TraceCommand& command = trace.commands()[c];
+			if (command.op == TraceOp::BufferContents && command.arguments[0] < _versions.size()) {
+				_versions[command.arguments[0]].push_back({ frame, { trace.payload(command), command.payloadSize } });
+			}
+		}
+	}
+}
+
+template <class Encoder>
+void CommandTraceReplayer::replayFrame(size_t frame, Encoder& encoder)
+{
+	const TraceFrame& range = _trace.frames()[frame];
+	const TraceCommand* commands = _trace.commands().data() + range.firstCommand;
+	// 앞 frame을 재생했는지와 상관없이 이 frame까지 마지막으로 저장된 내용으로 맞춘다. 아직 나오지 않은 buffer는 비어 있다.
+	for (size_t id = 1; id < _versions.size(); ++id) {
+		const std::vector<ContentsVersion>& versions = _versions[id];
+		auto next = std::upper_bound(versions.begin(), versions.end(), frame,
+				[](size_t f, const ContentsVersion& version) { return f < version.frame; });
+		_contents[id] = next == versions.begin() ? TraceBufferView{ nullptr, 0 } : std::prev(next)->contents;
+	}
+	for (size_t c = 0; c < range.numberOfCommands; ++c) {
+		const TraceCommand& command = commands[c];
+		const uint64_t* a = command.arguments;
+		switch (command.op) {
+			case TraceOp::SetRenderPipelineState:
+				encoder.setRenderPipelineState(handle(a[0]));
+				break;
+			case TraceOp::SetDepthStencilState:
+				encoder.setDepthStencilState(handle(a[0]));
+				break;
+			case TraceOp::SetViewport: {
+				RecordedViewport viewport;
+				std::memcpy(&viewport, _trace.payload(command), sizeof(viewport));
+				encoder.setViewport(viewport);
+				break;
+			}
+			case TraceOp::SetCullMode:
+				encoder.setCullMode(uint32_t(a[0]));
+				break;
+			case TraceOp::SetVertexBuffer:
+				encoder.setVertexBuffer(handle(a[0]), a[1], a[2]);
+				break;
+			case TraceOp::SetVertexBufferOffset:
+				encoder.setVertexBufferOffset(a[0], a[1]);
+				break;
+			case TraceOp::SetVertexBytes:
+				encoder.setVertexBytes(_trace.payload(command), command.payloadSize, a[0]);
+				break;
+			case TraceOp::SetFragmentBuffer:
+				encoder.setFragmentBuffer(handle(a[0]), a[1], a[2]);
+				break;
+			case TraceOp::SetFragmentBufferOffset:
+				encoder.setFragmentBufferOffset(a[0], a[1]);
+				break;
+			case TraceOp::SetFragmentBytes:
+				encoder.setFragmentBytes(_trace.payload(command), command.payloadSize, a[0]);
+				break;
+			case TraceOp::SetVertexTexture:
+				encoder.setVertexTexture(handle(a[0]), a[1]);
+				break;
+			case TraceOp::SetVertexSamplerState:
+				encoder.setVertexSamplerState(handle(a[0]), a[1]);
+				break;
+			case TraceOp::SetFragmentTexture:
+				encoder.setFragmentTexture(handle(a[0]), a[1]);
+				break;
+			case TraceOp::SetFragmentSamplerState:
+				encoder.setFragmentSamplerState(handle(a[0]), a[1]);
+				break;
+			case TraceOp::DrawPrimitives:
+				encoder.drawPrimitives(uint32_t(a[0]), a[1], a[2], a[3]);
+				break;
+			case TraceOp::DrawIndexedPrimitives:
+				encoder.drawIndexedPrimitives(uint32_t(a[0]), a[1], uint32_t(a[2]), handle(a[3]), a[4], a[5]);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+#pragma endregion CommandTraceReplayer }
@@ -0,0 +1,224 @@
+/*
+ * ComputeDispatch.hpp
+ *
+ * compute kernel을 GPU 없이 thread pool에서 돌린다. 같은 알고리즘을 Linux에서 검증하고 잴 수 있다.
+ * kernel은 MSL처럼 thread 하나의 일을 적은 C++ 함수 객체이다. ComputeThread로
+ * thread_position_in_grid, thread_position_in_threadgroup, threadgroup_position_in_grid와
+ * threadgroup memory([[threadgroup(n)]])를 받는다.
+ *
+ *   struct Kernel {
+ *       // threadgroup_barrier로 나뉜 구간 수. 없으면 1이다.
+ *       static constexpr uint32_t kNumberOfPhases = 2;
+ *       void operator()(const ComputeThread& thread) const; // thread.phase가 몇 번째 구간인지 알려 준다.
+ *   };
+ *
+ * threadgroup 하나는 worker 하나가 맡아 구간마다 group의 모든 thread를 차례로 돌린다. 그래서 한 구간이
+ * 모든 thread에서 끝난 뒤에 다음 구간이 시작하고, 구간 경계가 threadgroup_barrier와 같은 뜻이 된다.
+ * 지역 변수는 구간을 넘어가지 못하므로 barrier 너머로 넘길 값은 threadgroup memory에 둔다.
+ * threadgroup memory는 worker마다 하나인 arena에서 group마다 잘라 쓴다. Metal처럼 초기화되지 않는다.
+ * */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+struct Uint3 {
+	uint32_t x, y, z;
+};
+
+inline uint64_t volumeOf(Uint3 size) { return uint64_t(size.x) * size.y * size.z; }
+
+class ComputeThread {
+	public:
+		// thread_position_in_grid
+		Uint3 positionInGrid;
+		// thread_position_in_threadgroup
+		Uint3 positionInThreadgroup;
+		// threadgroup_position_in_grid
+		Uint3 threadgroupPositionInGrid;
+		// thread_index_in_threadgroup
+		uint32_t indexInThreadgroup;
+		// threads_per_threadgroup, threads_per_grid. grid 끝의 group에서는 threadsPerThreadgroup이 더 작다.
+		Uint3 threadsPerThreadgroup;
+		Uint3 threadsPerGrid;
+		// threadgroup_barrier로 나뉜 몇 번째 구간인가
+		uint32_t phase;
+
+		// [[threadgroup(index)]]. group 안의 모든 thread가 같은 곳을 본다.
+		template <class T>
+		T* threadgroupMemory(size_t index) const { return reinterpret_cast<T*>(_threadgroupMemory[index]); }
+
+	private:
+		friend class CpuComputeEncoder;
+		unsigned char* const* _threadgroupMemory{nullptr};
+};
+
+/*
+ * MTL::ComputeCommandEncoder를 흉내 낸 CPU encoder. pipeline과 buffer 대신 kernel 객체를 넘긴다.
+ * dispatch는 모든 threadgroup이 끝나야 반환한다. (encoder 하나가 끝난 것과 같다)
+ * */
+class CpuComputeEncoder {
+	public:
+		static constexpr uint32_t kMaxTotalThreadsPerThreadgroup = 1024;
+		static constexpr size_t kMaxThreadgroupMemoryLength = 32 * 1024;
+		static constexpr size_t kMaxThreadgroupMemoryIndices = 31;
+
+		explicit CpuComputeEncoder(ThreadPool& pool = ThreadPool::shared()) : _pool(pool) {}
+
+		// setThreadgroupMemoryLength와 같다. Metal처럼 16 byte 단위로 올린다.
+		bool setThreadgroupMemoryLength(size_t length, size_t index);
+
+		// threadgroup 수로 dispatch 한다.
+		template <class Kernel>
+		bool dispatchThreadgroups(const Kernel& kernel, Uint3 threadgroupsPerGrid, Uint3 threadsPerThreadgroup);
+		// thread 수로 dispatch 한다. 마지막 group에서 grid 밖의 thread는 부르지 않는다. (non-uniform threadgroup)
+		// 그런 group에서는 thread.threadsPerThreadgroup과 indexInThreadgroup이 실제로 있는 thread 기준이다.
+		template <class Kernel>
+		bool dispatchThreads(const Kernel& kernel, Uint3 threadsPerGrid, Uint3 threadsPerThreadgroup);
+
+		// 지금까지 dispatch한 threadgroup / thread 수
+		uint64_t numberOfThreadgroups() const { return _numberOfThreadgroups; }
+		uint64_t numberOfThreads() const { return _numberOfThreads; }
+
+	private:
+		template <class Kernel, class = void>
+		struct PhasesOf {
+			static constexpr uint32_t value = 1;
+		};
+		template <class Kernel>
+		struct PhasesOf<Kernel, std::void_t<decltype(Kernel::kNumberOfPhases)>> {
+			static constexpr uint32_t value = Kernel::kNumberOfPhases;
+		};
+
+		template <class Kernel>
+		bool dispatch(const Kernel& kernel, Uint3 threadgroupsPerGrid, Uint3 threadsPerThreadgroup, Uint3 threadsPerGrid);
+		// 호출한 thread의 arena. group 하나가 쓰는 동안 다른 group이 쓰지 않는다.
+		static std::vector<unsigned char>& arena();
+
+		ThreadPool& _pool;
+		size_t _threadgroupMemoryLengths[kMaxThreadgroupMemoryIndices]{};
+		uint64_t _numberOfThreadgroups{0};
+		uint64_t _numberOfThreads{0};
+};
+
+#pragma region CpuComputeEncoder {
+
+inline bool CpuComputeEncoder::setThreadgroupMemoryLength(size_t length, size_t index)
+{
+	if (index >= kMaxThreadgroupMemoryIndices) {
+		std::cerr << "threadgroup memory index " << index << " is out of range" << std::endl;
+		return false;
+	}
+	_threadgroupMemoryLengths[index] = (length + 15) & ~size_t(15);
+	return true;
+}
+
+inline std::vector<unsigned char>& CpuComputeEncoder::arena()
+{
+	thread_local std::vector<unsigned char> storage;
+	return storage;
+}
+
+template <class Kernel>
+bool CpuComputeEncoder::dispatchThreadgroups(const Kernel& kernel, Uint3 threadgroupsPerGrid, Uint3 threadsPerThreadgroup)
+{
+	Uint3 threadsPerGrid = { threadgroupsPerGrid.x * threadsPerThreadgroup.x, threadgroupsPerGrid.y * threadsPerThreadgroup.y,
+		threadgroupsPerGrid.z * threadsPerThreadgroup.z };
+	return dispatch(kernel, threadgroupsPerGrid, threadsPerThreadgroup, threadsPerGrid);
+}
+
+template <class Kernel>
+bool CpuComputeEncoder::dispatchThreads(const Kernel& kernel, Uint3 threadsPerGrid, Uint3 threadsPerThreadgroup)
+{
+	if (volumeOf(threadsPerThreadgroup) == 0) {
+		std::cerr << "threads per threadgroup must not be zero" << std::endl;
+		return false;
+	}
+	Uint3 threadgroupsPerGrid = { (threadsPerGrid.x + threadsPerThreadgroup.x - 1) / threadsPerThreadgroup.x,
+		(threadsPerGrid.y + threadsPerThreadgroup.y - 1) / threadsPerThreadgroup.y,
+		(threadsPerGrid.z + threadsPerThreadgroup.z - 1) / threadsPerThreadgroup.z };
+	return dispatch(kernel, threadgroupsPerGrid, threadsPerThreadgroup, threadsPerGrid);
+}
+
+template <class Kernel>
+bool CpuComputeEncoder::dispatch(const Kernel& kernel, Uint3 threadgroupsPerGrid, Uint3 threadsPerThreadgroup, Uint3 threadsPerGrid)
+{
+	constexpr uint32_t numberOfPhases = PhasesOf<Kernel>::value;
+	static_assert(numberOfPhases > 0, "a kernel needs at least one phase");
+
+	const uint64_t threadsPerGroup = volumeOf(threadsPerThreadgroup);
+	if (threadsPerGroup == 0 || threadsPerGroup > kMaxTotalThreadsPerThreadgroup) {
+		std::cerr << "threads per threadgroup (" << threadsPerGroup << ") must be in [1, " << kMaxTotalThreadsPerThreadgroup << "]" << std::endl;
+		return false;
+	}
+	size_t offsets[kMaxThreadgroupMemoryIndices];
+	size_t arenaSize = 0;
+	for (size_t index = 0; index < kMaxThreadgroupMemoryIndices; ++index) {
+		offsets[index] = arenaSize;
+		arenaSize += _threadgroupMemoryLengths[index];
+	}
+	if (arenaSize > kMaxThreadgroupMemoryLength) {
+		std::cerr << "threadgroup memory (" << arenaSize << " bytes) exceeds " << kMaxThreadgroupMemoryLength << " bytes" << std::endl;
+		return false;
+	}
+	const uint64_t numberOfGroups = volumeOf(threadgroupsPerGrid);
+	if (numberOfGroups == 0) {
+		return true;
+	}
+	_numberOfThreadgroups += numberOfGroups;
+	_numberOfThreads += volumeOf(threadsPerGrid);
+
+	// group 하나는 작을 수 있으므로 worker마다 여러 group을 묶어 준다.
+	const size_t grainSize = std::max<size_t>(1, size_t(numberOfGroups / (uint64_t(_pool.size()) * 8)));
+	_pool.parallelFor(size_t(numberOfGroups), grainSize, [&](size_t firstGroup, size_t lastGroup) {
+		std::vector<unsigned char>& storage = arena();
+		// 16 byte 정렬을 맞추기 위해 여유를 둔다.
+		if (storage.size() < arenaSize + 16) {
+			storage.resize(arenaSize + 16);
+		}
+		unsigned char* base = storage.data() + ((16 - uintptr_t(storage.data()) % 16) % 16);
+		unsigned char* memory[kMaxThreadgroupMemoryIndices];
+		for (size_t index = 0; index < kMaxThreadgroupMemoryIndices; ++index) {
+			memory[index] = _threadgroupMemoryLengths[index] ? base + offsets[index] : nullptr;
+		}
+
+		ComputeThread thread;
+		thread.threadsPerGrid = threadsPerGrid;
+		thread._threadgroupMemory = memory;
+		for (size_t group = firstGroup; group < lastGroup; ++group) {
+			const Uint3 groupPosition = { uint32_t(group % threadgroupsPerGrid.x), uint32_t(group / threadgroupsPerGrid.x % threadgroupsPerGrid.y),
+				uint32_t(group / (uint64_t(threadgroupsPerGrid.x) * threadgroupsPerGrid.y)) };
+			const Uint3 origin = { groupPosition.x * threadsPerThreadgroup.x, groupPosition.y * threadsPerThreadgroup.y,
+				groupPosition.z * threadsPerThreadgroup.z };
+			// 이 group에서 grid 안에 있는 thread 범위. MSL처럼 threads_per_threadgroup도 이 크기가 된다.
+			const Uint3 extent = { std::min(threadsPerThreadgroup.x, threadsPerGrid.x - origin.x),
+				std::min(threadsPerThreadgroup.y, threadsPerGrid.y - origin.y), std::min(threadsPerThreadgroup.z, threadsPerGrid.z - origin.z) };
+			thread.threadgroupPositionInGrid = groupPosition;
+			thread.threadsPerThreadgroup = extent;
+			for (uint32_t phase = 0; phase < numberOfPhases; ++phase) {
+				thread.phase = phase;
+				for (uint32_t z = 0; z < extent.z; ++z) {
+					for (uint32_t y = 0; y < extent.y; ++y) {
+						thread.indexInThreadgroup = (z * extent.y + y) * extent.x;
+						thread.positionInThreadgroup = { 0, y, z };
+						thread.positionInGrid = { origin.x, origin.y + y, origin.z + z };
+						for (uint32_t x = 0; x < extent.x; ++x) {
+							kernel(static_cast<const ComputeThread&>(thread));
+							++thread.indexInThreadgroup;
+							++thread.positionInThreadgroup.x;
+							++thread.positionInGrid.x;
+						}
+					}
+				}
+			}
+		}
+	});
+	return true;
+}
+
+#pragma endregion CpuComputeEncoder }
@@ -0,0 +1,436 @@
+/*
+ * ComputePrimitives.hpp
+ *
+ * build/parallel.metal의 compute kernel을 C++로 옮긴 것과, 그것을 CpuComputeEncoder로 dispatch 하는 순서.
+ * kernel 하나가 MSL kernel 하나에 대응하고 threadgroup_barrier 자리가 구간(phase) 경계이다.
+ * MSL에서는 barrier 너머로 지역 변수를 들고 가지만 여기서는 구간마다 다시 읽는다.
+ * dispatch 순서와 buffer 배치는 Metal에서 같은 일을 할 때와 같으므로 GPU 경로를 Linux에서 검증하는 데 쓴다.
+ * 결과는 ParallelPrimitives.hpp의 CPU 구현과 bit 단위로 같다.
+ *
+ * threadgroup 하나는 thread 256개 x 4개 = 1024개를 맡는다. thread는 연속된 4개를 맡아서 block 안의 순서를 지킨다.
+ *   scan       : block마다 scan + block 합 -> block 합을 다시 scan (재귀) -> block offset 더하기
+ *   compaction : flag -> 0 / 1 -> scan -> 남는 것만 scatter
+ *   histogram  : threadgroup마다 threadgroup memory에 세고 -> bin마다 group 합
+ *   radix sort : 4 bit씩 8 pass. block별 digit 개수 -> (digit, block) 순서로 scan -> block 안에서 stable rank를 구해 scatter
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "ComputeDispatch.hpp"
+
+namespace ComputePrimitivesDetail {
+
+constexpr uint32_t kThreads = 256;
+constexpr uint32_t kItemsPerThread = 4;
+constexpr uint32_t kBlockSize = kThreads * kItemsPerThread;
+// log2(kThreads). Hillis-Steele scan의 단계 수
+constexpr uint32_t kScanSteps = 8;
+constexpr uint32_t kRadixBits = 4;
+constexpr uint32_t kRadixDigits = 1 << kRadixBits;
+// threadgroup memory 32 KB에 들어가는 bin 수
+constexpr uint32_t kMaxHistogramBins = 8192;
+constexpr uint32_t kHistogramGroups = 64;
+
+// partial[2][kThreads]를 ping-pong 하는 Hillis-Steele inclusive scan의 한 단계. 끝나면 partial[0]에 있다.
+inline void scanStep(uint32_t* partial, uint32_t step, uint32_t t)
+{
+	const uint32_t offset = 1u << step;
+	const uint32_t* source = partial + (step & 1) * kThreads;
+	uint32_t* destination = partial + ((step + 1) & 1) * kThreads;
+	destination[t] = source[t] + (t >= offset ? source[t - offset] : 0);
+}
+
+// parallel.metal: scanBlocks. threadgroup(0) = uint[2 * kThreads]
+struct ScanBlocksKernel {
+	static constexpr uint32_t kNumberOfPhases = kScanSteps + 2;
+
+	const uint32_t* input;
+	uint32_t* output;
+	uint32_t* blockSums;
+	size_t count;
+
+	uint32_t sumOfThread(size_t first) const
+	{
+		uint32_t sum = 0;
+		for (size_t i = first; i < std::min(first + kItemsPerThread, count); ++i) {
+			sum += input[i];
+		}
+		return sum;
+	}
+
+	void operator()(const ComputeThread& thread) const
+	{
+		uint32_t* partial = thread.threadgroupMemory<uint32_t>(0);
+		const uint32_t t = thread.indexInThreadgroup;
+		const size_t first = size_t(thread.threadgroupPositionInGrid.x) * kBlockSize + size_t(t) * kItemsPerThread;
+		if (thread.phase == 0) {
+			partial[t] = sumOfThread(first);
+		} else if (thread.phase <= kScanSteps) {
+			scanStep(partial, thread.phase - 1, t);
+		} else {
+			uint32_t running = partial[t] - sumOfThread(first);
+			for (size_t i = first; i < std::min(first + kItemsPerThread, count); ++i) {
+				const uint32_t value = input[i];
+				output[i] = running;
+				running += value;
+			}
+			if (t == kThreads - 1) {
+				blockSums[thread.threadgroupPositionInGrid.x] = partial[t];
+			}
+		}
+	}
+};
+
+// parallel.metal: addBlockOffsets
+struct AddBlockOffsetsKernel {
+	uint32_t* data;
+	const uint32_t* blockOffsets;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		data[thread.positionInGrid.x] += blockOffsets[thread.positionInGrid.x / kBlockSize];
+	}
+};
+
+// parallel.metal: flagsToPositions
+struct FlagsToPositionsKernel {
+	const uint8_t* flags;
+	uint32_t* positions;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		positions[thread.positionInGrid.x] = flags[thread.positionInGrid.x] != 0;
+	}
+};
+
+// parallel.metal: scatterFlagged
+struct ScatterFlaggedKernel {
+	const uint32_t* values;
+	const uint8_t* flags;
+	const uint32_t* positions;
+	uint32_t* output;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		const uint32_t i = thread.positionInGrid.x;
+		if (flags[i]) {
+			output[positions[i]] = values[i];
+		}
+	}
+};
+
+/*
+ * parallel.metal: histogramBlocks. threadgroup(0) = atomic_uint[numberOfBins]
+ * group마다 연속된 itemsPerGroup개를 센다. MSL은 threadgroup atomic으로 올리고,
+ * 여기서는 group의 thread가 한 worker에서 차례로 돌므로 그냥 더한다.
+ * */
+struct HistogramBlocksKernel {
+	static constexpr uint32_t kNumberOfPhases = 3;
+
+	const uint32_t* values;
+	uint32_t* blockHistograms;
+	size_t count;
+	uint32_t numberOfBins;
+	size_t itemsPerGroup;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		uint32_t* bins = thread.threadgroupMemory<uint32_t>(0);
+		const uint32_t t = thread.indexInThreadgroup;
+		const uint32_t threads = thread.threadsPerThreadgroup.x;
+		const uint32_t group = thread.threadgroupPositionInGrid.x;
+		if (thread.phase == 0) {
+			for (uint32_t bin = t; bin < numberOfBins; bin += threads) {
+				bins[bin] = 0;
+			}
+		} else if (thread.phase == 1) {
+			const size_t end = std::min(count, (size_t(group) + 1) * itemsPerGroup);
+			for (size_t i = size_t(group) * itemsPerGroup + t; i < end; i += threads) {
+				const uint32_t value = values[i];
+				if (value < numberOfBins) {
+					++bins[value];
+				}
+			}
+		} else {
+			for (uint32_t bin = t; bin < numberOfBins; bin += threads) {
+				blockHistograms[size_t(group) * numberOfBins + bin] = bins[bin];
+			}
+		}
+	}
+};
+
+// parallel.metal: reduceHistograms. thread 하나가 bin 하나
+struct ReduceHistogramsKernel {
+	const uint32_t* blockHistograms;
+	uint32_t* bins;
+	uint32_t numberOfBins;
+	uint32_t numberOfGroups;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		const uint32_t bin = thread.positionInGrid.x;
+		uint32_t sum = 0;
+		for (uint32_t group = 0; group < numberOfGroups; ++group) {
+			sum += blockHistograms[size_t(group) * numberOfBins + bin];
+		}
+		bins[bin] = sum;
+	}
+};
+
+// parallel.metal: radixCount. threadgroup(0) = atomic_uint[kRadixDigits]. blockCounts는 [digit][block] 순서이다.
+struct RadixCountKernel {
+	static constexpr uint32_t kNumberOfPhases = 3;
+
+	const uint32_t* keys;
+	uint32_t* blockCounts;
+	size_t count;
+	uint32_t shift;
+	uint32_t numberOfBlocks;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		uint32_t* bins = thread.threadgroupMemory<uint32_t>(0);
+		const uint32_t t = thread.indexInThreadgroup;
+		const uint32_t block = thread.threadgroupPositionInGrid.x;
+		if (thread.phase == 0) {
+			if (t < kRadixDigits) {
+				bins[t] = 0;
+			}
+		} else if (thread.phase == 1) {
+			const size_t first = size_t(block) * kBlockSize + size_t(t) * kItemsPerThread;
+			for (size_t i = first; i < std::min(first + kItemsPerThread, count); ++i) {
+				++bins[(keys[i] >> shift) & (kRadixDigits - 1)];
+			}
+		} else if (t < kRadixDigits) {
+			blockCounts[size_t(t) * numberOfBlocks + block] = bins[t];
+		}
+	}
+};
+
+/*
+ * parallel.metal: radixScatter.
+ *   threadgroup(0) = uint[kRadixDigits * kThreads] counts[digit][thread]
+ *   threadgroup(1) = uint[2 * kThreads]
+ *   threadgroup(2) = uint[kRadixDigits]
+ * counts를 (digit, thread) 순서로 exclusive scan 하면 block 안의 stable rank가 된다.
+ * (더 작은 digit의 수 + 같은 digit인데 앞 thread가 맡은 수)
+ * digitOffsets는 RadixCountKernel의 blockCounts를 scan 한 것이다.
+ * */
+struct RadixScatterKernel {
+	static constexpr uint32_t kNumberOfPhases = kScanSteps + 4;
+
+	const uint32_t* keysIn;
+	uint32_t* keysOut;
+	// key만 정렬하면 nullptr
+	const uint32_t* valuesIn;
+	uint32_t* valuesOut;
+	const uint32_t* digitOffsets;
+	size_t count;
+	uint32_t shift;
+	uint32_t numberOfBlocks;
+
+	void operator()(const ComputeThread& thread) const
+	{
+		uint32_t* counts = thread.threadgroupMemory<uint32_t>(0);
+		uint32_t* partial = thread.threadgroupMemory<uint32_t>(1);
+		uint32_t* digitStart = thread.threadgroupMemory<uint32_t>(2);
+		const uint32_t t = thread.indexInThreadgroup;
+		const uint32_t block = thread.threadgroupPositionInGrid.x;
+		const size_t first = size_t(block) * kBlockSize + size_t(t) * kItemsPerThread;
+		const size_t last = std::min(first + kItemsPerThread, count);
+		// thread t의 구간. flat counts의 [t * kRadixDigits, (t + 1) * kRadixDigits)
+		uint32_t* segment = counts + t * kRadixDigits;
+		if (thread.phase == 0) {
+			// 자기 열(counts[*][t])만 건드리므로 barrier 없이 지우고 센다.
+			for (uint32_t digit = 0; digit < kRadixDigits; ++digit) {
+				counts[digit * kThreads + t] = 0;
+			}
+			for (size_t i = first; i < last; ++i) {
+				++counts[((keysIn[i] >> shift) & (kRadixDigits - 1)) * kThreads + t];
+			}
+		} else if (thread.phase == 1) {
+			uint32_t sum = 0;
+			for (uint32_t e = 0; e < kRadixDigits; ++e) {
+				sum += segment[e];
+			}
+			partial[t] = sum;
+		} else if (thread.phase <= kScanSteps + 1) {
+			scanStep(partial, thread.phase - 2, t);
+		} else if (thread.phase == kScanSteps + 2) {
+			uint32_t sum = 0;
+			for (uint32_t e = 0; e < kRadixDigits; ++e) {
+				sum += segment[e];
+			}
+			uint32_t running = partial[t] - sum;
+			for (uint32_t e = 0; e < kRadixDigits; ++e) {
+				const uint32_t n = segment[e];
+				segment[e] = running;
+				running += n;
+			}
+			// counts[digit][0]이 이 구간의 첫 칸이면 그 digit이 block 안에서 시작하는 자리이다.
+			if (t % (kThreads / kRadixDigits) == 0) {
+				digitStart[t / (kThreads / kRadixDigits)] = segment[0];
+			}
+		} else {
+			for (size_t i = first; i < last; ++i) {
+				const uint32_t key = keysIn[i];
+				const uint32_t digit = (key >> shift) & (kRadixDigits - 1);
+				const uint32_t local = counts[digit * kThreads + t]++;
+				const uint32_t position = digitOffsets[size_t(digit) * numberOfBlocks + block] + local - digitStart[digit];
+				keysOut[position] = key;
+				if (valuesIn) {
+					valuesOut[position] = valuesIn[i];
+				}
+			}
+		}
+	}
+};
+
+} // namespace ComputePrimitivesDetail
+
+/*
+ * 위 kernel을 Metal에서와 같은 순서로 dispatch 한다. 중간 buffer는 다시 쓴다.
+ * ParallelPrimitives.hpp의 함수와 같은 결과를 낸다. histogram은 bin이 kMaxHistogramBins 이하여야 한다.
+ * */
+class ComputePrimitives {
+	public:
+		explicit ComputePrimitives(CpuComputeEncoder& encoder) : _encoder(encoder) {}
+
+		uint32_t exclusiveScan(const uint32_t* input, uint32_t* output, size_t count);
+		size_t compact(const uint32_t* values, const uint8_t* flags, size_t count, uint32_t* output);
+		bool histogram(const uint32_t* values, size_t count, uint32_t* bins, uint32_t numberOfBins);
+		void radixSort(std::vector<uint32_t>& keys);
+		void radixSortPairs(std::vector<uint32_t>& keys, std::vector<uint32_t>& values);
+
+	private:
+		// level 단계의 block 합 buffer를 써서 scan 한다. 전체 합을 돌려준다.
+		uint32_t scan(const uint32_t* input, uint32_t* output, size_t count, size_t level);
+		void sort(std::vector<uint32_t>& keys, std::vector<uint32_t>* values);
+		void setThreadgroupMemory(size_t length0, size_t length1 = 0, size_t length2 = 0);
+
+		CpuComputeEncoder& _encoder;
+		std::vector<std::vector<uint32_t>> _blockSums;
+		std::vector<uint32_t> _positions;
+		std::vector<uint32_t> _blockCounts;
+		std::vector<uint32_t> _blockHistograms;
+		std::vector<uint32_t> _keyScratch;
+		std::vector<uint32_t> _valueScratch;
+};
+
+#pragma region ComputePrimitives {
+
+inline void ComputePrimitives::setThreadgroupMemory(size_t length0, size_t length1, size_t length2)
+{
+	_encoder.setThreadgroupMemoryLength(length0, 0);
+	_encoder.setThreadgroupMemoryLength(length1, 1);
+	_encoder.setThreadgroupMemoryLength(length2, 2);
+}
+
+inline uint32_t ComputePrimitives::scan(const uint32_t* input, uint32_t* output, size_t count, size_t level)
+{
+	using namespace ComputePrimitivesDetail;
+	if (count == 0) {
+		return 0;
+	}
+	const uint32_t blocks = uint32_t((count + kBlockSize - 1) / kBlockSize);
+	if (_blockSums.size() <= level) {
+		_blockSums.resize(level + 1);
+	}
+	_blockSums[level].resize(blocks);
+	uint32_t* blockSums = _blockSums[level].data();
+	setThreadgroupMemory(2 * kThreads * sizeof(uint32_t));
+	_encoder.dispatchThreadgroups(ScanBlocksKernel{ input, output, blockSums, count }, { blocks, 1, 1 }, { kThreads, 1, 1 });
+	if (blocks == 1) {
+		return blockSums[0];
+	}
+	// block 합을 제자리에서 scan 하면 각 block의 시작 offset이 된다.
+	const uint32_t total = scan(blockSums, blockSums, blocks, level + 1);
+	_encoder.dispatchThreads(AddBlockOffsetsKernel{ output, blockSums }, { uint32_t(count), 1, 1 }, { kThreads, 1, 1 });
+	return total;
+}
+
+inline uint32_t ComputePrimitives::exclusiveScan(const uint32_t* input, uint32_t* output, size_t count)
+{
+	return scan(input, output, count, 0);
+}
+
+inline size_t ComputePrimitives::compact(const uint32_t* values, const uint8_t* flags, size_t count, uint32_t* output)
+{
+	using namespace ComputePrimitivesDetail;
+	if (count == 0) {
+		return 0;
+	}
+	_positions.resize(count);
+	_encoder.dispatchThreads(FlagsToPositionsKernel{ flags, _positions.data() }, { uint32_t(count), 1, 1 }, { kThreads, 1, 1 });
+	const uint32_t kept = scan(_positions.data(), _positions.data(), count, 0);
+	_encoder.dispatchThreads(ScatterFlaggedKernel{ values, flags, _positions.data(), output }, { uint32_t(count), 1, 1 }, { kThreads, 1, 1 });
+	return kept;
+}
+
+inline bool ComputePrimitives::histogram(const uint32_t* values, size_t count, uint32_t* bins, uint32_t numberOfBins)
+{
+	using namespace ComputePrimitivesDetail;
+	if (numberOfBins == 0 || numberOfBins > kMaxHistogramBins) {
+		std::cerr << "histogram needs 1 to " << kMaxHistogramBins << " bins, not " << numberOfBins << std::endl;
+		return false;
+	}
+	// group마다 block 단위로 연속된 구간을 준다.
+	const size_t blocks = std::max<size_t>(1, (count + kBlockSize - 1) / kBlockSize);
+	const uint32_t groups = uint32_t(std::min<size_t>(kHistogramGroups, blocks));
+	const size_t itemsPerGroup = (blocks + groups - 1) / groups * kBlockSize;
+	_blockHistograms.resize(size_t(groups) * numberOfBins);
+	setThreadgroupMemory(numberOfBins * sizeof(uint32_t));
+	_encoder.dispatchThreadgroups(HistogramBlocksKernel{ values, _blockHistograms.data(), count, numberOfBins, itemsPerGroup },
+			{ groups, 1, 1 }, { kThreads, 1, 1 });
+	_encoder.dispatchThreads(ReduceHistogramsKernel{ _blockHistograms.data(), bins, numberOfBins, groups }, { numberOfBins, 1, 1 },
+			{ kThreads, 1, 1 });
+	return true;
+}
+
+inline void ComputePrimitives::sort(std::vector<uint32_t>& keys, std::vector<uint32_t>* values)
+{
+	using namespace ComputePrimitivesDetail;
+	const size_t count = keys.size();
+	if (count < 2) {
+		return;
+	}
+	const uint32_t blocks = uint32_t((count + kBlockSize - 1) / kBlockSize);
+	_keyScratch.resize(count);
+	_valueScratch.resize(values ? count : 0);
+	_blockCounts.resize(size_t(kRadixDigits) * blocks);
+	uint32_t* sourceKeys = keys.data();
+	uint32_t* destinationKeys = _keyScratch.data();
+	uint32_t* sourceValues = values ? values->data() : nullptr;
+	uint32_t* destinationValues = values ? _valueScratch.data() : nullptr;
+	for (uint32_t shift = 0; shift < 32; shift += kRadixBits) {
+		setThreadgroupMemory(kRadixDigits * sizeof(uint32_t));
+		_encoder.dispatchThreadgroups(RadixCountKernel{ sourceKeys, _blockCounts.data(), count, shift, blocks }, { blocks, 1, 1 },
+				{ kThreads, 1, 1 });
+		scan(_blockCounts.data(), _blockCounts.data(), _blockCounts.size(), 0);
+		setThreadgroupMemory(kRadixDigits * kThreads * sizeof(uint32_t), 2 * kThreads * sizeof(uint32_t), kRadixDigits * sizeof(uint32_t));
+		_encoder.dispatchThreadgroups(RadixScatterKernel{ sourceKeys, destinationKeys, sourceValues, destinationValues, _blockCounts.data(),
+				count, shift, blocks }, { blocks, 1, 1 }, { kThreads, 1, 1 });
+		std::swap(sourceKeys, destinationKeys);
+		std::swap(sourceValues, destinationValues);
+	}
+	// pass 수가 짝수라서 결과는 원래 buffer에 있다.
+	static_assert((32 / kRadixBits) % 2 == 0, "an odd number of passes would leave the result in the scratch buffer");
+	setThreadgroupMemory(0);
+}
+
+inline void ComputePrimitives::radixSort(std::vector<uint32_t>& keys)
+{
+	sort(keys, nullptr);
+}
+
+inline void ComputePrimitives::radixSortPairs(std::vector<uint32_t>& keys, std::vector<uint32_t>& values)
+{
+	sort(keys, &values);
+}
+
+#pragma endregion ComputePrimitives }
@@ -0,0 +1,356 @@
+/*
+ * FilteringEncoder.hpp
+ *
+ * MTL::RenderCommandEncoder 앞에 두는 wrapper. 마지막으로 묶은 pipeline state, depth-stencil state,
+ * vertex / fragment buffer와 offset, texture, sampler state, viewport, cull mode를 기억하고 이미 같은 값이면 호출을 버린다.
+ * Metal 호출은 하나하나가 objc_msgSend이므로 encoder까지 가지 않는 것만으로 draw당 CPU 비용이 준다.
+ * 같은 buffer에서 offset만 바뀌면 setVertexBufferOffset / setFragmentBufferOffset으로 바꿔 보낸다.
+ *
+ * Encoder는 template이라서 Linux에서는 RecordingEncoder(mock)를 넣어 걸러진 호출을 확인할 수 있다.
+ * encoder를 새로 만들면 묶인 state를 모르므로 reset()으로 알려 준다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+struct EncoderFilterStats {
+	// wrapper로 들어온 state 설정 호출 수
+	size_t stateCalls{0};
+	// 이미 같은 state라서 버린 수
+	size_t filtered{0};
+	// buffer가 같아서 offset만 바꾼 수
+	size_t offsetOnly{0};
+	size_t pipelineFiltered{0};
+	size_t bufferFiltered{0};
+	// texture와 sampler state
+	size_t textureFiltered{0};
+	size_t draws{0};
+
+	size_t forwarded() const { return stateCalls - filtered; }
+};
+
+template <class Encoder>
+class FilteringRenderEncoder {
+	public:
+		static constexpr size_t kMaxBufferSlots = 31;
+		static constexpr size_t kMaxTextureSlots = 128;
+		static constexpr size_t kMaxSamplerSlots = 16;
+
+		explicit FilteringRenderEncoder(Encoder* encoder = nullptr) { reset(encoder); }
+
+		// 새 encoder로 바꾸고 기억한 state를 지운다. 통계는 그대로 둔다.
+		void reset(Encoder* encoder);
+		void resetStats() { _stats = EncoderFilterStats(); }
+		Encoder* encoder() const { return _encoder; }
+		const EncoderFilterStats& stats() const { return _stats; }
+
+		template <class PipelineState>
+		void setRenderPipelineState(const PipelineState* pipelineState);
+		template <class DepthStencilState>
+		void setDepthStencilState(const DepthStencilState* depthStencilState);
+		template <class Viewport>
+		void setViewport(const Viewport& viewport);
+		template <class CullMode>
+		void setCullMode(CullMode cullMode);
+
+		template <class Buffer>
+		void setVertexBuffer(const Buffer* buffer, size_t offset, size_t index);
+		void setVertexBufferOffset(size_t offset, size_t index);
+		// 내용을 비교하지 않고 항상 보낸다. 그 slot은 무엇이 묶였는지 모르게 된다.
+		void setVertexBytes(const void* bytes, size_t length, size_t index);
+		template <class Buffer>
+		void setFragmentBuffer(const Buffer* buffer, size_t offset, size_t index);
+		void setFragmentBufferOffset(size_t offset, size_t index);
+		void setFragmentBytes(const void* bytes, size_t length, size_t index);
+
+		template <class Texture>
+		void setVertexTexture(const Texture* texture, size_t index);
+		template <class SamplerState>
+		void setVertexSamplerState(const SamplerState* samplerState, size_t index);
+		template <class Texture>
+		void setFragmentTexture(const Texture* texture, size_t index);
+		template <class SamplerState>
+		void setFragmentSamplerState(const SamplerState* samplerState, size_t index);
+
+		// draw 호출은 걸러지지 않고 그대로 간다.
+		template <class... Arguments>
+		void drawPrimitives(Arguments... arguments)
+		{
+			++_stats.draws;
+			_encoder->drawPrimitives(arguments...);
+		}
+		template <class... Arguments>
+		void drawIndexedPrimitives(Arguments... arguments)
+		{
+			++_stats.draws;
+			_encoder->drawIndexedPrimitives(arguments...);
+		}
+
+	private:
+		struct BufferSlot {
+			const void* buffer;
+			size_t offset;
+			// setBytes로 채웠거나 아직 아무것도 묶지 않았으면 false
+			bool known;
+		};
+		enum class Stage { Vertex, Fragment };
+
+		template <class Buffer>
+		void setBuffer(Stage stage, const Buffer* buffer, size_t offset, size_t index);
+		void setBufferOffset(Stage stage, size_t offset, size_t index);
+		// 값이 바뀌었으면 기억하고 true
+		bool changed(const void*& bound, const void* object);
+		// slot 범위 밖이면 기억하지 않고 항상 보낸다.
+		bool resourceChanged(const void** slots, size_t numberOfSlots, size_t index, const void* object);
+
+		Encoder* _encoder{nullptr};
+		const void* _pipelineState;
+		const void* _depthStencilState;
+		BufferSlot _vertexBuffers[kMaxBufferSlots];
+		BufferSlot _fragmentBuffers[kMaxBufferSlots];
+		const void* _vertexTextures[kMaxTextureSlots];
+		const void* _vertexSamplerStates[kMaxSamplerSlots];
+		const void* _fragmentTextures[kMaxTextureSlots];
+		const void* _fragmentSamplerStates[kMaxSamplerSlots];
+		// MTL::Viewport는 double 6개(48 byte)이다.
+		unsigned char _viewport[64];
+		bool _viewportKnown;
+		int64_t _cullMode;
+		bool _cullModeKnown;
+		EncoderFilterStats _stats;
+};
+
+#pragma region FilteringRenderEncoder {
+
+template <class Encoder>
+void FilteringRenderEncoder<Encoder>::reset(Encoder* encoder)
+{
+	_encoder = encoder;
+	_pipelineState = nullptr;
+	_depthStencilState = nullptr;
+	for (size_t i = 0; i < kMaxBufferSlots; ++i) {
+		_vertexBuffers[i] = { nullptr, 0, false };
+		_fragmentBuffers[i] = { nullptr, 0, false };
+	}
+	std::fill(std::begin(_vertexTextures), std::end(_vertexTextures), nullptr);
+	std::fill(std::begin(_vertexSamplerStates), std::end(_vertexSamplerStates), nullptr);
+	std::fill(std::begin(_fragmentTextures), std::end(_fragmentTextures), nullptr);
+	std::fill(std::begin(_fragmentSamplerStates), std::end(_fragmentSamplerStates), nullptr);
+	_viewportKnown = false;
+	_cullModeKnown = false;
+}
+
+template <class Encoder>
+bool FilteringRenderEncoder<Encoder>::changed(const void*& bound, const void* object)
+{
+	++_stats.stateCalls;
+	if (bound == object && object) {
+		++_stats.filtered;
+		return false;
+	}
+	bound = object;
+	return true;
+}
+
+template <class Encoder>
+template <class PipelineState>
+void FilteringRenderEncoder<Encoder>::setRenderPipelineState(const PipelineState* pipelineState)
+{
+	if (changed(_pipelineState, pipelineState)) {
+		_encoder->setRenderPipelineState(pipelineState);
+	} else {
+		++_stats.pipelineFiltered;
+	}
+}
+
+template <class Encoder>
+template <class DepthStencilState>
+void FilteringRenderEncoder<Encoder>::setDepthStencilState(const DepthStencilState* depthStencilState)
+{
+	if (changed(_depthStencilState, depthStencilState)) {
+		_encoder->setDepthStencilState(depthStencilState);
+	}
+}
+
+template <class Encoder>
+template <class Viewport>
+void FilteringRenderEncoder<Encoder>::setViewport(const Viewport& viewport)
+{
+	static_assert(sizeof(Viewport) <= sizeof(_viewport), "viewport does not fit the shadow state");
+	++_stats.stateCalls;
+	if (_viewportKnown && std::memcmp(_viewport, &viewport, sizeof(Viewport)) == 0) {
+		++_stats.filtered;
+		return;
+	}
+	std::memcpy(_viewport, &viewport, sizeof(Viewport));
+	_viewportKnown = true;
+	_encoder->setViewport(viewport);
+}
+
+template <class Encoder>
+template <class CullMode>
+void FilteringRenderEncoder<Encoder>::setCullMode(CullMode cullMode)
+{
+	++_stats.stateCalls;
+	if (_cullModeKnown && _cullMode == int64_t(cullMode)) {
+		++_stats.filtered;
+		return;
+	}
+	_cullMode = int64_t(cullMode);
+	_cullModeKnown = true;
+	_encoder->setCullMode(cullMode);
+}
+
+template <class Encoder>
+template <class Buffer>
+void FilteringRenderEncoder<Encoder>::setBuffer(Stage stage, const Buffer* buffer, size_t offset, size_t index)
+{
+	++_stats.stateCalls;
+	BufferSlot* slot = index < kMaxBufferSlots ? (stage == Stage::Vertex ? _vertexBuffers : _fragmentBuffers) + index : nullptr;
+	if (slot && slot->known && slot->buffer == buffer && buffer) {
+		if (slot->offset == offset) {
+			++_stats.filtered;
+			++_stats.bufferFiltered;
+			return;
+		}
+		// buffer를 다시 묶는 것보다 offset만 바꾸는 쪽이 싸다.
+		slot->offset = offset;
+		++_stats.offsetOnly;
+		if (stage == Stage::Vertex) {
+			_encoder->setVertexBufferOffset(offset, index);
+		} else {
+			_encoder->setFragmentBufferOffset(offset, index);
+		}
+		return;
+	}
+	if (slot) {
+		*slot = { buffer, offset, true };
+	}
+	if (stage == Stage::Vertex) {
+		_encoder->setVertexBuffer(buffer, offset, index);
+	} else {
+		_encoder->setFragmentBuffer(buffer, offset, index);
+	}
+}
+
+template <class Encoder>
+void FilteringRenderEncoder<Encoder>::setBufferOffset(Stage stage, size_t offset, size_t index)
+{
+	++_stats.stateCalls;
+	BufferSlot* slot = index < kMaxBufferSlots ? (stage == Stage::Vertex ? _vertexBuffers : _fragmentBuffers) + index : nullptr;
+	if (slot && slot->known && slot->offset == offset) {
+		++_stats.filtered;
+		++_stats.bufferFiltered;
+		return;
+	}
+	if (slot) {
+		slot->offset = offset;
+	}
+	if (stage == Stage::Vertex) {
+		_encoder->setVertexBufferOffset(offset, index);
+	} else {
+		_encoder->setFragmentBufferOffset(offset, index);
+	}
+}
+
+template <class Encoder>
+template <class Buffer>
+void FilteringRenderEncoder<Encoder>::setVertexBuffer(const Buffer* buffer, size_t offset, size_t index)
+{
+	setBuffer(Stage::Vertex, buffer, offset, index);
+}
+
+template <class Encoder>
+void FilteringRenderEncoder<Encoder>::setVertexBufferOffset(size_t offset, size_t index)
+{
+	setBufferOffset(Stage::Vertex, offset, index);
+}
+
+template <class Encoder>
+void FilteringRenderEncoder<Encoder>::setVertexBytes(const void* bytes, size_t length, size_t index)
+{
+	++_stats.stateCalls;
+	if (index < kMaxBufferSlots) {
+		_vertexBuffers[index].known = false;
+	}
+	_encoder->setVertexBytes(bytes, length, index);
+}
+
+template <class Encoder>
+template <class Buffer>
+void FilteringRenderEncoder<Encoder>::setFragmentBuffer(const Buffer* buffer, size_t offset, size_t index)
+{
+	setBuffer(Stage::Fragment, buffer, offset, index);
+}
+
+template <class Encoder>
+void FilteringRenderEncoder<Encoder>::setFragmentBufferOffset(size_t offset, size_t index)
+{
+	setBufferOffset(Stage::Fragment, offset, index);
+}
+
+template <class Encoder>
+void FilteringRenderEncoder<Encoder>::setFragmentBytes(const void* bytes, size_t length, size_t index)
+{
+	++_stats.stateCalls;
+	if (index < kMaxBufferSlots) {
+		_fragmentBuffers[index].known = false;
+	}
+	_encoder->setFragmentBytes(bytes, length, index);
+}
+
+template <class Encoder>
+bool FilteringRenderEncoder<Encoder>::resourceChanged(const void** slots, size_t numberOfSlots, size_t index, const void* object)
+{
+	if (index >= numberOfSlots) {
+		++_stats.stateCalls;
+		return true;
+	}
+	if (changed(slots[index], object)) {
+		return true;
+	}
+	++_stats.textureFiltered;
+	return false;
+}
+
+template <class Encoder>
+template <class Texture>
+void FilteringRenderEncoder<Encoder>::setVertexTexture(const Texture* texture, size_t index)
+{
+	if (resourceChanged(_vertexTextures, kMaxTextureSlots, index, texture)) {
+		_encoder->setVertexTexture(texture, index);
+	}
+}
+
+template <class Encoder>
+template <class SamplerState>
+void FilteringRenderEncoder<Encoder>::setVertexSamplerState(const SamplerState* samplerState, size_t index)
+{
+	if (resourceChanged(_vertexSamplerStates, kMaxSamplerSlots, index, samplerState)) {
+		_encoder->setVertexSamplerState(samplerState, index);
+	}
+}
+
+template <class Encoder>
+template <class Texture>
+void FilteringRenderEncoder<Encoder>::setFragmentTexture(const Texture* texture, size_t index)
+{
+	if (resourceChanged(_fragmentTextures, kMaxTextureSlots, index, texture)) {
+		_encoder->setFragmentTexture(texture, index);
+	}
+}
+
+template <class Encoder>
+template <class SamplerState>
+void FilteringRenderEncoder<Encoder>::setFragmentSamplerState(const SamplerState* samplerState, size_t index)
+{
+	if (resourceChanged(_fragmentSamplerStates, kMaxSamplerSlots, index, samplerState)) {
+		_encoder->setFragmentSamplerState(samplerState, index);
+	}
+}
+
+#pragma endregion FilteringRenderEncoder }
@@ -0,0 +1,1270 @@
+/*
+ * FontAtlas.hpp
+ *
+ * 화면 글자(frame 시간, counter)를 frame마다 CPU에서 rasterize 하지 않고, 미리 만든 MSDF(multi-channel signed distance field) atlas로 그린다.
+ *  - TtfFont: TrueType(glyf) 파일의 head, hhea, maxp, cmap(format 4, 12), hmtx, loca / glyf(복합 glyph 포함), kern(format 0)만 읽는
+ *    작은 parser. CFF outline(.otf)과 GPOS kerning은 읽지 않는다.
+ *  - generateFontAtlas: 윤곽선의 edge를 모서리마다 색(R, G, B 중 둘)을 바꿔 칠하고, texel마다 채널별로 그 색의 가장 가까운 edge까지의
+ *    signed pseudo-distance를 쓴다. 세 채널의 중앙값이 0.5인 곳이 윤곽선이라 확대해도 모서리가 날카롭게 남는다.
+ *    alpha에는 보통의 SDF를 넣는다. glyph는 ThreadPool에서 나눠 만들고 SpriteBatch.hpp의 AtlasPacker로 한 장에 모은다.
+ *  - .mfnt 파일: header + glyph 표 + kerning 표 + RGBA8 atlas
+ *  - TextBatch: UTF-8 문자열을 kerning과 줄바꿈을 넣어 배치하고 glyph마다 GlyphInstance 하나를 만든다.
+ *    shader는 instance마다 사각형 하나를 그린다. (build/shader.metal의 textVertexMain)
+ * Metal 호출은 01-primitive의 TextPass에 있다. (tools/font-atlas, bench/text-render)
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MathTypes.hpp"
+#include "SpriteBatch.hpp"
+#include "ThreadPool.hpp"
+
+// font 단위(y가 위쪽) 윤곽선의 edge 하나. 직선이면 control은 쓰지 않는다.
+struct GlyphEdge {
+	Float2 p0;
+	Float2 control;
+	Float2 p1;
+	bool curve{false};
+	// 이 edge의 distance를 쓰는 채널 (1: R, 2: G, 4: B)
+	uint8_t color{7};
+};
+
+struct GlyphOutline {
+	// 닫힌 윤곽선마다 이어진 edge들
+	std::vector<std::vector<GlyphEdge>> contours;
+	// font 단위 bounds (control point 포함). 윤곽선이 없으면(공백) 모두 0
+	float xMin{0.0f};
+	float yMin{0.0f};
+	float xMax{0.0f};
+	float yMax{0.0f};
+
+	bool empty() const { return contours.empty(); }
+};
+
+class TtfFont {
+	public:
+		// 실패하면 이유를 출력하고 false를 반환한다.
+		bool open(const char* path);
+		bool load(std::vector<uint8_t> bytes);
+
+		// cmap에 없으면 0 (.notdef)
+		uint32_t glyphIndex(uint32_t codepoint) const;
+		// font 단위 윤곽선. 복합 glyph는 부품을 변환해 합친다. glyph 자료가 깨졌으면 false
+		bool outline(uint32_t glyph, GlyphOutline& out) const;
+		int32_t advance(uint32_t glyph) const;
+		// kern table format 0의 (왼쪽, 오른쪽) glyph 쌍. key는 left << 16 | right이고 key 순서이다.
+		const std::vector<std::pair<uint32_t, int32_t>>& kerningPairs() const { return _kerning; }
+
+		uint32_t unitsPerEm() const { return _unitsPerEm; }
+		int32_t ascender() const { return _ascender; }
+		int32_t descender() const { return _descender; }
+		int32_t lineGap() const { return _lineGap; }
+		uint32_t glyphCount() const { return _glyphCount; }
+
+	private:
+		// 범위를 벗어나면 0을 읽는다. 깨진 파일도 읽는 쪽에서 크기를 다시 보면 된다.
+		uint8_t u8(size_t offset) const { return offset < _bytes.size() ? _bytes[offset] : 0; }
+		uint16_t u16(size_t offset) const { return uint16_t(u8(offset) << 8 | u8(offset + 1)); }
+		int16_t i16(size_t offset) const { return int16_t(u16(offset)); }
+		uint32_t u32(size_t offset) const { return uint32_t(u16(offset)) << 16 | u16(offset + 2); }
+		bool glyphRange(uint32_t glyph, size_t& begin, size_t& end) const;
+		// transform은 x' = t[0] x + t[2] y + t[4], y' = t[1] x + t[3] y + t[5]
+		bool appendOutline(uint32_t glyph, const float transform[6], int depth, GlyphOutline& out) const;
+
+		std::vector<uint8_t> _bytes;
+		uint32_t _unitsPerEm{0};
+		int32_t _ascender{0};
+		int32_t _descender{0};
+		int32_t _lineGap{0};
+		uint32_t _glyphCount{0};
+		uint32_t _metricCount{0};
+		bool _longLoca{false};
+		size_t _hmtx{0};
+		size_t _loca{0};
+		size_t _glyf{0};
+		size_t _glyfLength{0};
+		// 고른 cmap subtable
+		size_t _cmap{0};
+		uint32_t _cmapFormat{0};
+		std::vector<std::pair<uint32_t, int32_t>> _kerning;
+};
+
+struct FontGlyph {
+	uint32_t codepoint;
+	// em 단위
+	float advance;
+	// baseline의 pen 위치에서 본 사각형의 em 단위 bounds. y는 위쪽이다. distance field 여백을 포함한다.
+	float left;
+	float bottom;
+	float right;
+	float top;
+	// atlas texel 사각형. 윤곽선이 없는 glyph(공백)는 0
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct FontKerning {
+	// left << 32 | right (codepoint)
+	uint64_t pair;
+	// em 단위
+	float value;
+};
+
+struct FontAtlas {
+	// atlas에서 1 em의 texel 수
+	float emSize{0.0f};
+	// distance field가 0 ~ 1로 표현하는 폭 (texel)
+	float distanceRange{0.0f};
+	// em 단위
+	float ascender{0.0f};
+	float descender{0.0f};
+	float lineHeight{0.0f};
+	uint32_t width{0};
+	uint32_t height{0};
+	// RGBA8. rgb는 MSDF, a는 SDF
+	std::vector<uint8_t> pixels;
+	// codepoint 순서
+	std::vector<FontGlyph> glyphs;
+	// pair 순서
+	std::vector<FontKerning> kerning;
+
+	const FontGlyph* glyph(uint32_t codepoint) const;
+	float kern(uint32_t left, uint32_t right) const;
+};
+
+struct FontAtlasOptions {
+	float emSize{32.0f};
+	float distanceRange{4.0f};
+	// 비어 있으면 ASCII 32 ~ 126
+	std::vector<uint32_t> codepoints;
+	// atlas 한 변의 최대 texel. 128부터 두 배씩 키워 들어가는 가장 작은 정사각형을 쓴다.
+	uint32_t maxSize{4096};
+};
+
+// 실패하면(들어가지 않는 atlas, 깨진 glyph) 이유를 출력하고 false를 반환한다.
+bool generateFontAtlas(const TtfFont& font, const FontAtlasOptions& options, FontAtlas& atlas, ThreadPool& pool = ThreadPool::shared());
+bool saveFontAtlas(const char* path, const FontAtlas& atlas);
+bool loadFontAtlas(const char* path, FontAtlas& atlas);
+
+// UTF-8 한 글자를 읽고 text를 다음 글자로 옮긴다. 잘못된 byte는 U+FFFD이다.
+uint32_t decodeUtf8(const char*& text);
+
+// build/shader.metal의 GlyphInstance와 같은 32 byte 배치
+struct GlyphInstance {
+	// 화면 pixel 좌표. 왼쪽 위가 (0, 0)이고 y는 아래로 커진다. position은 사각형의 왼쪽 위이다.
+	Float2 position;
+	Float2 size;
+	// atlas texel 사각형 (x, y, width, height)
+	uint16_t atlasRect[4];
+	// RGBA8. r이 가장 낮은 byte
+	uint32_t color;
+	// 화면 pixel로 잰 distanceRange. shader가 윤곽선을 1 pixel 폭으로 부드럽게 하는 데 쓴다.
+	float screenRange;
+};
+
+static_assert(sizeof(GlyphInstance) == 32, "GlyphInstance must match the MSL layout");
+
+class TextBatch {
+	public:
+		// atlas는 가리키기만 하므로 이 객체보다 오래 있어야 한다.
+		explicit TextBatch(const FontAtlas& atlas) : _atlas(&atlas) {}
+
+		void clear() { _instances.clear(); }
+		// (x, y)는 첫 줄 baseline의 왼쪽 끝이다. '\n'에서 줄을 바꾼다. pixelSize는 1 em의 화면 pixel 수이다.
+		// atlas에 없는 글자는 '?'로 그린다. 만든 instance 수를 반환한다.
+		size_t add(const char* text, float x, float y, float pixelSize, uint32_t color = 0xFFFFFFFFu);
+		// 가장 긴 줄의 pen 이동 폭과 줄 수 * 줄 높이 (pixel)
+		Float2 measure(const char* text, float pixelSize) const;
+		const std::vector<GlyphInstance>& instances() const { return _instances; }
+
+	private:
+		const FontAtlas* _atlas;
+		std::vector<GlyphInstance> _instances;
+};
+
+namespace FontDetail {
+
+const uint32_t kMagic = 0x4E464D4C; // "LMFN"
+const uint32_t kVersion = 1;
+
+inline bool fail(const std::string& message)
+{
+	std::cerr << "font: " << message << std::endl;
+	return false;
+}
+
+inline uint32_t tag(const char* name) { return uint32_t(uint8_t(name[0])) << 24 | uint32_t(uint8_t(name[1])) << 16 | uint32_t(uint8_t(name[2])) << 8 | uint8_t(name[3]); }
+
+// 거리 계산은 pixel 좌표의 double로 한다. float로는 긴 edge 끝에서 가까운 점을 찾는 3차 방정식이 흔들린다.
+struct Vec2 {
+	double x;
+	double y;
+};
+
+inline Vec2 operator+(Vec2 a, Vec2 b) { return { a.x + b.x, a.y + b.y }; }
+inline Vec2 operator-(Vec2 a, Vec2 b) { return { a.x - b.x, a.y - b.y }; }
+inline Vec2 operator*(Vec2 a, double s) { return { a.x * s, a.y * s }; }
+inline double dot(Vec2 a, Vec2 b) { return a.x * b.x + a.y * b.y; }
+inline double cross(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
+inline double length(Vec2 a) { return std::sqrt(dot(a, a)); }
+inline Vec2 normalize(Vec2 a)
+{
+	const double l = length(a);
+	return l > 0.0 ? a * (1.0 / l) : Vec2{ 0.0, 0.0 };
+}
+
+const uint8_t kRed = 1, kGreen = 2, kBlue = 4;
+const uint8_t kCyan = kGreen | kBlue, kMagenta = kRed | kBlue, kYellow = kRed | kGreen, kWhite = kRed | kGreen | kBlue;
+
+struct Edge {
+	Vec2 p0;
+	Vec2 control;
+	Vec2 p1;
+	bool curve;
+	uint8_t color;
+
+	Vec2 point(double t) const
+	{
+		if (!curve) {
+			return p0 + (p1 - p0) * t;
+		}
+		const Vec2 ab = control - p0, br = p1 - control - ab;
+		return p0 + ab * (2.0 * t) + br * (t * t);
+	}
+	// control이 끝점과 겹쳐 미분이 0이면 현 방향을 쓴다.
+	Vec2 direction(double t) const
+	{
+		if (!curve) {
+			return p1 - p0;
+		}
+		const Vec2 tangent = (control - p0) * (1.0 - t) + (p1 - control) * t;
+		return dot(tangent, tangent) > 0.0 ? tangent : p1 - p0;
+	}
+};
+
+inline Edge toEdge(const GlyphEdge& edge, double scale, double offsetX, double offsetY)
+{
+	auto convert = [&](Float2 point) { return Vec2{ point.x * scale - offsetX, point.y * scale - offsetY }; };
+	return { convert(edge.p0), convert(edge.control), convert(edge.p1), edge.curve, edge.color };
+}
+
+// a x^2 + b x + c = 0. 근의 수, 모든 x가 근이면 -1
+inline int solveQuadratic(double roots[2], double a, double b, double c)
+{
+	if (a == 0.0 || std::fabs(b) > 1e12 * std::fabs(a)) {
+		if (b == 0.0) {
+			return c == 0.0 ? -1 : 0;
+		}
+		roots[0] = -c / b;
+		return 1;
+	}
+	double discriminant = b * b - 4.0 * a * c;
+	if (discriminant > 0.0) {
+		discriminant = std::sqrt(discriminant);
+		roots[0] = (-b + discriminant) / (2.0 * a);
+		roots[1] = (-b - discriminant) / (2.0 * a);
+		return 2;
+	}
+	if (discriminant == 0.0) {
+		roots[0] = -b / (2.0 * a);
+		return 1;
+	}
+	return 0;
+}
+
+// a x^3 + b x^2 + c x + d = 0 (Cardano / 삼각함수 해)
+inline int solveCubic(double roots[3], double a, double b, double c, double d)
+{
+	if (a == 0.0 || std::fabs(b / a) >= 1e6) {
+		return solveQuadratic(roots, b, c, d);
+	}
+	const double bn = b / a, cn = c / a, dn = d / a;
+	const double q = (bn * bn - 3.0 * cn) / 9.0;
+	const double r = (bn * (2.0 * bn * bn - 9.0 * cn) + 27.0 * dn) / 54.0;
+	const double q3 = q * q * q;
+	const double shift = bn / 3.0;
+	if (r * r < q3) {
+		const double angle = std::acos(std::clamp(r / std::sqrt(q3), -1.0, 1.0));
+		const double scale = -2.0 * std::sqrt(q);
+		roots[0] = scale * std::cos(angle / 3.0) - shift;
+		roots[1] = scale * std::cos((angle + 2.0 * M_PI) / 3.0) - shift;
+		roots[2] = scale * std::cos((angle - 2.0 * M_PI) / 3.0) - shift;
+		return 3;
+	}
+	const double u = (r < 0.0 ? 1.0 : -1.0) * std::cbrt(std::fabs(r) + std::sqrt(r * r - q3));
+	const double v = u == 0.0 ? 0.0 : q / u;
+	roots[0] = u + v - shift;
+	if (u == v || std::fabs(u - v) < 1e-12 * std::fabs(u + v)) {
+		roots[1] = -0.5 * (u + v) - shift;
+		return 2;
+	}
+	return 1;
+}
+
+// p에서 edge까지의 거리. distance의 부호는 edge 진행 방향의 왼쪽이 +이다.
+// orthogonality는 가장 가까운 점에서 edge와 p 방향이 이루는 각의 |cos|로, 거리가 같은 두 edge(공유한 끝점) 중 고를 때 쓴다.
+struct EdgeDistance {
+	double distance{HUGE_VAL};
+	double orthogonality{1.0};
+	// 가장 가까운 점의 매개변수 (0 ~ 1)
+	double t{0.0};
+};
+
+inline bool closer(const EdgeDistance& a, const EdgeDistance& b)
+{
+	const double da = std::fabs(a.distance), db = std::fabs(b.distance);
+	return da < db || (da == db && a.orthogonality < b.orthogonality);
+}
+
+inline EdgeDistance edgeDistance(const Edge& edge, Vec2 p)
+{
+	double candidates[5] = { 0.0, 1.0 };
+	int count = 2;
+	if (!edge.curve) {
+		const Vec2 ab = edge.p1 - edge.p0;
+		const double lengthSquared = dot(ab, ab);
+		if (lengthSquared > 0.0) {
+			const double t = dot(p - edge.p0, ab) / lengthSquared;
+			if (t > 0.0 && t < 1.0) {
+				candidates[count++] = t;
+			}
+		}
+	} else {
+		// (B(t) - p)·B'(t) = 0
+		const Vec2 qa = edge.p0 - p, ab = edge.control - edge.p0, br = edge.p1 - edge.control - ab;
+		double roots[3];
+		const int rootCount = solveCubic(roots, dot(br, br), 3.0 * dot(ab, br), 2.0 * dot(ab, ab) + dot(qa, br), dot(qa, ab));
+		for (int i = 0; i < rootCount; ++i) {
+			if (roots[i] > 0.0 && roots[i] < 1.0) {
+				candidates[count++] = roots[i];
+			}
+		}
+	}
+	EdgeDistance best;
+	double bestSquared = HUGE_VAL;
+	for (int i = 0; i < count; ++i) {
+		const Vec2 offset = p - edge.point(candidates[i]);
+		const double squared = dot(offset, offset);
+		if (squared < bestSquared) {
+			bestSquared = squared;
+			best.t = candidates[i];
+		}
+	}
+	const Vec2 direction = normalize(edge.direction(best.t));
+	const Vec2 offset = p - edge.point(best.t);
+	const double distance = std::sqrt(bestSquared);
+	best.distance = cross(direction, offset) >= 0.0 ? distance : -distance;
+	// 안쪽 점에서는 offset이 edge에 수직이다.
+	best.orthogonality = best.t > 0.0 && best.t < 1.0 ? 0.0 : std::fabs(dot(direction, normalize(offset)));
+	return best;
+}
+
+// 끝점이 가장 가까우면서 p가 끝점 너머에 있으면 edge를 접선 방향으로 늘인 직선까지의 거리를 쓴다.
+// 모서리 양쪽 edge의 채널이 서로 다른 직선으로 이어지므로 중앙값이 모서리에서 뾰족하게 만난다.
+inline double pseudoDistance(const Edge& edge, Vec2 p, const EdgeDistance& nearest)
+{
+	if (nearest.t <= 0.0) {
+		const Vec2 direction = normalize(edge.direction(0.0)), offset = p - edge.p0;
+		if (dot(offset, direction) < 0.0) {
+			const double perpendicular = cross(direction, offset);
+			if (std::fabs(perpendicular) <= std::fabs(nearest.distance)) {
+				return perpendicular;
+			}
+		}
+	} else if (nearest.t >= 1.0) {
+		const Vec2 direction = normalize(edge.direction(1.0)), offset = p - edge.p1;
+		if (dot(offset, direction) > 0.0) {
+			const double perpendicular = cross(direction, offset);
+			if (std::fabs(perpendicular) <= std::fabs(nearest.distance)) {
+				return perpendicular;
+			}
+		}
+	}
+	return nearest.distance;
+}
+
+// y로 단조인 조각. 수평선과 만나는 점을 찾을 때 쓴다.
+struct MonotoneEdge {
+	Vec2 p0;
+	Vec2 control;
+	Vec2 p1;
+	bool curve;
+};
+
+// y 극값에서 곡선을 나눠 어느 조각이든 수평선과 한 번만 만나게 한다.
+inline void appendMonotone(const Edge& edge, std::vector<MonotoneEdge>& out)
+{
+	if (edge.curve) {
+		const double denominator = edge.p0.y - 2.0 * edge.control.y + edge.p1.y;
+		const double t = denominator != 0.0 ? (edge.p0.y - edge.control.y) / denominator : -1.0;
+		if (t > 0.0 && t < 1.0) {
+			const Vec2 left = edge.p0 + (edge.control - edge.p0) * t, right = edge.control + (edge.p1 - edge.control) * t;
+			const Vec2 middle = left + (right - left) * t;
+			out.push_back({ edge.p0, left, middle, true });
+			out.push_back({ middle, right, edge.p1, true });
+			return;
+		}
+	}
+	out.push_back({ edge.p0, edge.control, edge.p1, edge.curve });
+}
+
+// 수평선 y와의 교점 x와 방향(위로 가면 +1)을 crossings에 더한다. y가 끝점과 같을 때는 아래 끝만 센다.
+inline void appendCrossings(const std::vector<MonotoneEdge>& edges, double y, std::vector<std::pair<double, int>>& crossings)
+{
+	for (const MonotoneEdge& edge : edges) {
+		if ((edge.p0.y <= y) == (edge.p1.y <= y)) {
+			continue;
+		}
+		double t;
+		if (!edge.curve) {
+			t = (y - edge.p0.y) / (edge.p1.y - edge.p0.y);
+		} else {
+			double roots[2];
+			const int count = solveQuadratic(roots, edge.p0.y - 2.0 * edge.control.y + edge.p1.y, 2.0 * (edge.control.y - edge.p0.y),
+					edge.p0.y - y);
+			t = 0.5;
+			double bestError = HUGE_VAL;
+			for (int i = 0; i < count; ++i) {
+				const double error = std::max(-roots[i], roots[i] - 1.0);
+				if (error < bestError) {
+					bestError = error;
+					t = std::clamp(roots[i], 0.0, 1.0);
+				}
+			}
+		}
+		const double x = edge.curve ? (edge.p0.x * (1.0 - t) * (1.0 - t) + 2.0 * edge.control.x * t * (1.0 - t) + edge.p1.x * t * t)
+			: edge.p0.x + (edge.p1.x - edge.p0.x) * t;
+		crossings.push_back({ x, edge.p1.y > edge.p0.y ? 1 : -1 });
+	}
+}
+
+inline bool isCorner(Vec2 a, Vec2 b)
+{
+	// 3 radian보다 급하게 꺾이면(약 8도 이상) 모서리이다.
+	const double crossThreshold = std::sin(3.0);
+	return dot(a, b) <= 0.0 || std::fabs(cross(a, b)) > crossThreshold;
+}
+
+inline GlyphEdge splitHalf(const GlyphEdge& edge, bool second)
+{
+	auto mix = [](Float2 a, Float2 b) { return Float2{ 0.5f * (a.x + b.x), 0.5f * (a.y + b.y) }; };
+	GlyphEdge half = edge;
+	if (!edge.curve) {
+		const Float2 middle = mix(edge.p0, edge.p1);
+		(second ? half.p0 : half.p1) = middle;
+		return half;
+	}
+	const Float2 left = mix(edge.p0, edge.control), right = mix(edge.control, edge.p1), middle = mix(left, right);
+	if (second) {
+		half.p0 = middle;
+		half.control = right;
+	} else {
+		half.control = left;
+		half.p1 = middle;
+	}
+	return half;
+}
+
+inline Vec2 startDirection(const GlyphEdge& edge)
+{
+	Vec2 direction{ double(edge.control.x) - edge.p0.x, double(edge.control.y) - edge.p0.y };
+	if (!edge.curve || dot(direction, direction) == 0.0) {
+		direction = { double(edge.p1.x) - edge.p0.x, double(edge.p1.y) - edge.p0.y };
+	}
+	return normalize(direction);
+}
+
+inline Vec2 endDirection(const GlyphEdge& edge)
+{
+	Vec2 direction{ double(edge.p1.x) - edge.control.x, double(edge.p1.y) - edge.control.y };
+	if (!edge.curve || dot(direction, direction) == 0.0) {
+		direction = { double(edge.p1.x) - edge.p0.x, double(edge.p1.y) - edge.p0.y };
+	}
+	return normalize(direction);
+}
+
+/*
+ * 모서리에서 만나는 두 edge는 채널 하나만 같도록 색을 바꾼다. 매끈한 윤곽선(모서리 없음)은 모두 흰색(보통 SDF)이다.
+ * 모서리가 하나뿐인 윤곽선(물방울)은 edge를 셋 이상으로 나눠 cyan, white, magenta로 칠한다.
+ * 나머지는 모서리마다 cyan -> magenta -> yellow로 돌리고, 마지막 구간은 첫 구간과도 다른 색을 고른다.
+ * */
+inline void colorEdges(GlyphOutline& outline)
+{
+	for (std::vector<GlyphEdge>& edges : outline.contours) {
+		std::vector<size_t> corners;
+		for (size_t i = 0; i < edges.size(); ++i) {
+			if (isCorner(endDirection(edges[(i + edges.size() - 1) % edges.size()]), startDirection(edges[i]))) {
+				corners.push_back(i);
+			}
+		}
+		if (corners.empty()) {
+			for (GlyphEdge& edge : edges) {
+				edge.color = kWhite;
+			}
+			continue;
+		}
+		if (corners.size() == 1) {
+			size_t corner = corners[0];
+			while (edges.size() < 3) {
+				std::vector<GlyphEdge> split;
+				for (const GlyphEdge& edge : edges) {
+					split.push_back(splitHalf(edge, false));
+					split.push_back(splitHalf(edge, true));
+				}
+				edges.swap(split);
+				corner *= 2;
+			}
+			const uint8_t colors[3] = { kCyan, kWhite, kMagenta };
+			for (size_t k = 0; k < edges.size(); ++k) {
+				edges[(corner + k) % edges.size()].color = colors[3 * k / edges.size()];
+			}
+			continue;
+		}
+		const uint8_t colors[3] = { kCyan, kMagenta, kYellow };
+		size_t current = 0, next = 1;
+		for (size_t k = 0; k < edges.size(); ++k) {
+			const size_t i = (corners[0] + k) % edges.size();
+			if (k > 0 && next < corners.size() && i == corners[next]) {
+				current = (current + 1) % 3;
+				// 마지막 구간은 첫 구간(cyan)과 모서리를 공유한다.
+				if (next == corners.size() - 1 && current == 0) {
+					current = 1;
+				}
+				++next;
+			}
+			edges[i].color = colors[current];
+		}
+	}
+}
+
+/*
+ * 색을 칠한 outline을 (left, bottom) pixel 원점, scale(pixel / font 단위)로 width x height RGBA8 image에 쓴다.
+ * 채널 중앙값의 부호가 실제 안팎(nonzero winding)과 다른 texel은 세 채널을 SDF로 덮는다. (edge 색이 만든 가짜 윤곽선 제거)
+ * */
+inline void rasterizeMsdf(const GlyphOutline& outline, double scale, double left, double bottom, double range, uint32_t width, uint32_t height,
+		uint8_t* pixels)
+{
+	std::vector<Edge> edges;
+	std::vector<MonotoneEdge> monotone;
+	double area = 0.0;
+	for (const std::vector<GlyphEdge>& contour : outline.contours) {
+		for (const GlyphEdge& glyphEdge : contour) {
+			const Edge edge = toEdge(glyphEdge, scale, left, bottom);
+			edges.push_back(edge);
+			appendMonotone(edge, monotone);
+			const Vec2 control = edge.curve ? edge.control : (edge.p0 + edge.p1) * 0.5;
+			area += 2.0 * cross(edge.p0, control) + 2.0 * cross(control, edge.p1) + cross(edge.p0, edge.p1);
+		}
+	}
+	// TrueType 바깥 윤곽선은 시계 방향이라 안쪽이 진행 방향의 오른쪽이다. 반대로 그린 font도 안쪽이 +가 되게 맞춘다.
+	const double orientation = area < 0.0 ? -1.0 : 1.0;
+	auto encode = [range](double distance) { return uint8_t(std::clamp(0.5 + distance / range, 0.0, 1.0) * 255.0 + 0.5); };
+	std::vector<std::pair<double, int>> crossings;
+	for (uint32_t row = 0; row < height; ++row) {
+		const double y = double(height - row) - 0.5;
+		crossings.clear();
+		appendCrossings(monotone, y, crossings);
+		for (uint32_t column = 0; column < width; ++column) {
+			const Vec2 p{ double(column) + 0.5, y };
+			int winding = 0;
+			for (const std::pair<double, int>& crossing : crossings) {
+				winding += crossing.first > p.x ? crossing.second : 0;
+			}
+			EdgeDistance nearest, channels[3];
+			const Edge* channelEdges[3] = {};
+			for (const Edge& edge : edges) {
+				const EdgeDistance distance = edgeDistance(edge, p);
+				if (closer(distance, nearest)) {
+					nearest = distance;
+				}
+				for (int channel = 0; channel < 3; ++channel) {
+					if ((edge.color >> channel & 1) && closer(distance, channels[channel])) {
+						channels[channel] = distance;
+						channelEdges[channel] = &edge;
+					}
+				}
+			}
+			const double trueDistance = winding != 0 ? std::fabs(nearest.distance) : -std::fabs(nearest.distance);
+			double values[3];
+			for (int channel = 0; channel < 3; ++channel) {
+				values[channel] = channelEdges[channel] ? orientation * pseudoDistance(*channelEdges[channel], p, channels[channel]) : trueDistance;
+			}
+			const double median = std::max(std::min(values[0], values[1]), std::min(std::max(values[0], values[1]), values[2]));
+			if ((median > 0.0) != (trueDistance > 0.0)) {
+				values[0] = values[1] = values[2] = trueDistance;
+			}
+			uint8_t* pixel = pixels + (size_t(row) * width + column) * 4;
+			pixel[0] = encode(values[0]);
+			pixel[1] = encode(values[1]);
+			pixel[2] = encode(values[2]);
+			pixel[3] = encode(trueDistance);
+		}
+	}
+}
+
+} // namespace FontDetail
+
+#pragma region TtfFont {
+
+inline bool TtfFont::open(const char* path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return FontDetail::fail(std::string("file not found: ") + path);
+	}
+	std::vector<uint8_t> bytes(size_t(file.tellg()));
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(bytes.data()), std::streamsize(bytes.size()))) {
+		return FontDetail::fail(std::string("failed to read: ") + path);
+	}
+	if (!load(std::move(bytes))) {
+		return FontDetail::fail(std::string("not a TrueType font: ") + path);
+	}
+	return true;
+}
+
+inline bool TtfFont::load(std::vector<uint8_t> bytes)
+{
+	using FontDetail::tag;
+	_bytes = std::move(bytes);
+	_kerning.clear();
+	const uint32_t version = u32(0);
+	if (version != 0x00010000 && version != tag("true")) {
+		return FontDetail::fail(version == tag("OTTO") ? "CFF outlines are not supported" : "unknown sfnt version");
+	}
+	size_t head = 0, hhea = 0, maxp = 0, cmap = 0, kern = 0;
+	const uint32_t tableCount = u16(4);
+	for (uint32_t table = 0; table < tableCount; ++table) {
+		const size_t record = 12 + size_t(table) * 16;
+		const uint32_t name = u32(record), offset = u32(record + 8), length = u32(record + 12);
+		if (uint64_t(offset) + length > _bytes.size()) {
+			return FontDetail::fail("table extends past the end of the file");
+		}
+		if (name == tag("head")) {
+			head = offset;
+		} else if (name == tag("hhea")) {
+			hhea = offset;
+		} else if (name == tag("maxp")) {
+			maxp = offset;
+		} else if (name == tag("cmap")) {
+			cmap = offset;
+		} else if (name == tag("hmtx")) {
+			_hmtx = offset;
+		} else if (name == tag("loca")) {
+			_loca = offset;
+		} else if (name == tag("glyf")) {
+			_glyf = offset;
+			_glyfLength = length;
+		} else if (name == tag("kern")) {
+			kern = offset;
+		}
+	}
+	if (!head || !hhea || !maxp || !cmap || !_hmtx || !_loca || !_glyf) {
+		return FontDetail::fail("missing head, hhea, maxp, cmap, hmtx, loca or glyf table");
+	}
+	_unitsPerEm = u16(head + 18);
+	_longLoca = i16(head + 50) != 0;
+	_glyphCount = u16(maxp + 4);
+	_ascender = i16(hhea + 4);
+	_descender = i16(hhea + 6);
+	_lineGap = i16(hhea + 8);
+	_metricCount = u16(hhea + 34);
+	// unitsPerEm은 16 ~ 16384이다.
+	if (_unitsPerEm < 16 || _unitsPerEm > 16384 || _metricCount == 0) {
+		return FontDetail::fail("invalid head or hhea table");
+	}
+
+	// Unicode 전체(format 12)를 먼저, 없으면 BMP(format 4)
+	int bestScore = 0;
+	const uint32_t encodingCount = u16(cmap + 2);
+	for (uint32_t encoding = 0; encoding < encodingCount; ++encoding) {
+		const size_t record = cmap + 4 + size_t(encoding) * 8;
+		const uint32_t platform = u16(record), specific = u16(record + 2);
+		const size_t subtable = cmap + u32(record + 4);
+		const uint32_t format = u16(subtable);
+		const bool unicode = platform == 0 || (platform == 3 && (specific == 1 || specific == 10));
+		const int score = !unicode ? 0 : format == 12 ? 2 : format == 4 ? 1 : 0;
+		if (score > bestScore) {
+			bestScore = score;
+			_cmap = subtable;
+			_cmapFormat = format;
+		}
+	}
+	if (bestScore == 0) {
+		return FontDetail::fail("no Unicode cmap (format 4 or 12)");
+	}
+
+	if (kern && u16(kern) == 0) {
+		size_t subtable = kern + 4;
+		const uint32_t subtableCount = u16(kern + 2);
+		for (uint32_t i = 0; i < subtableCount && subtable + 6 <= _bytes.size(); ++i) {
+			const uint32_t length = u16(subtable + 2), coverage = u16(subtable + 4);
+			// format 0, 가로쓰기, 최솟값 아님, cross-stream 아님
+			if ((coverage >> 8) == 0 && (coverage & 0x7) == 0x1) {
+				const uint32_t pairCount = u16(subtable + 6);
+				for (uint32_t pair = 0; pair < pairCount; ++pair) {
+					const size_t entry = subtable + 14 + size_t(pair) * 6;
+					_kerning.push_back({ u32(entry), i16(entry + 4) });
+				}
+			}
+			subtable += std::max(length, 6u);
+		}
+		std::sort(_kerning.begin(), _kerning.end());
+	}
+	return true;
+}
+
+inline uint32_t TtfFont::glyphIndex(uint32_t codepoint) const
+{
+	if (_cmapFormat == 12) {
+		const uint32_t groupCount = u32(_cmap + 12);
+		uint32_t low = 0, high = groupCount;
+		while (low < high) {
+			const uint32_t middle = (low + high) / 2;
+			const size_t group = _cmap + 16 + size_t(middle) * 12;
+			if (codepoint > u32(group + 4)) {
+				low = middle + 1;
+			} else if (codepoint < u32(group)) {
+				high = middle;
+			} else {
+				return u32(group + 8) + codepoint - u32(group);
+			}
+		}
+		return 0;
+	}
+	if (codepoint > 0xFFFF) {
+		return 0;
+	}
+	const uint32_t segmentCount = u16(_cmap + 6) / 2;
+	const size_t endCodes = _cmap + 14, startCodes = endCodes + size_t(segmentCount) * 2 + 2;
+	const size_t deltas = startCodes + size_t(segmentCount) * 2, rangeOffsets = deltas + size_t(segmentCount) * 2;
+	for (uint32_t segment = 0; segment < segmentCount; ++segment) {
+		if (codepoint > u16(endCodes + segment * 2)) {
+			continue;
+		}
+		const uint32_t start = u16(startCodes + segment * 2);
+		if (codepoint < start) {
+			return 0;
+		}
+		const uint32_t delta = u16(deltas + segment * 2), rangeOffset = u16(rangeOffsets + segment * 2);
+		if (rangeOffset == 0) {
+			return (codepoint + delta) & 0xFFFF;
+		}
+		// idRangeOffset은 자기 자리에서 glyphIdArray까지의 byte 거리이다.
+		const uint32_t glyph = u16(rangeOffsets + segment * 2 + rangeOffset + (codepoint - start) * 2);
+		return glyph == 0 ? 0 : (glyph + delta) & 0xFFFF;
+	}
+	return 0;
+}
+
+inline int32_t TtfFont::advance(uint32_t glyph) const
+{
+	return u16(_hmtx + size_t(std::min(glyph, _metricCount - 1)) * 4);
+}
+
+inline bool TtfFont::glyphRange(uint32_t glyph, size_t& begin, size_t& end) const
+{
+	if (glyph >= _glyphCount) {
+		return false;
+	}
+	const size_t first = _longLoca ? u32(_loca + size_t(glyph) * 4) : size_t(u16(_loca + size_t(glyph) * 2)) * 2;
+	const size_t last = _longLoca ? u32(_loca + size_t(glyph) * 4 + 4) : size_t(u16(_loca + size_t(glyph) * 2 + 2)) * 2;
+	if (first > last || last > _glyfLength) {
+		return false;
+	}
+	begin = _glyf + first;
+	end = _glyf + last;
+	return true;
+}
+
+inline bool TtfFont::outline(uint32_t glyph, GlyphOutline& out) const
+{
+	out = GlyphOutline();
+	const float identity[6] = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+	if (!appendOutline(glyph, identity, 0, out)) {
+		out = GlyphOutline();
+		return false;
+	}
+	bool first = true;
+	auto include = [&](Float2 point) {
+		out.xMin = first ? point.x : std::min(out.xMin, point.x);
+		out.yMin = first ? point.y : std::min(out.yMin, point.y);
+		out.xMax = first ? point.x : std::max(out.xMax, point.x);
+		out.yMax = first ? point.y : std::max(out.yMax, point.y);
+		first = false;
+	};
+	for (const std::vector<GlyphEdge>& contour : out.contours) {
+		for (const GlyphEdge& edge : contour) {
+			include(edge.p0);
+			include(edge.p1);
+			if (edge.curve) {
+				include(edge.control);
+			}
+		}
+	}
+	return true;
+}
+
+inline bool TtfFont::appendOutline(uint32_t glyph, const float transform[6], int depth, GlyphOutline& out) const
+{
+	size_t begin, end;
+	if (depth > 8 || !glyphRange(glyph, begin, end)) {
+		return false;
+	}
+	if (begin == end) {
+		return true;
+	}
+	const int32_t contourCount = i16(begin);
+	auto apply = [transform](float x, float y) {
+		return Float2{ transform[0] * x + transform[2] * y + transform[4], transform[1] * x + transform[3] * y + transform[5] };
+	};
+	if (contourCount < 0) {
+		// 복합 glyph: 부품 glyph마다 flags, index, 위치, 선택적인 2x2 변환
+		size_t offset = begin + 10;
+		for (bool more = true; more;) {
+			if (offset + 4 > end) {
+				return false;
+			}
+			const uint32_t flags = u16(offset), component = u16(offset + 2);
+			offset += 4;
+			float dx = 0.0f, dy = 0.0f;
+			if (flags & 0x1) {
+				dx = i16(offset);
+				dy = i16(offset + 2);
+				offset += 4;
+			} else {
+				dx = int8_t(u8(offset));
+				dy = int8_t(u8(offset + 1));
+				offset += 2;
+			}
+			// 점을 맞춰 붙이는 방식(ARGS_ARE_XY_VALUES가 없음)은 드물어서 위치를 0으로 둔다.
+			if (!(flags & 0x2)) {
+				dx = dy = 0.0f;
+			}
+			float local[6] = { 1.0f, 0.0f, 0.0f, 1.0f, dx, dy };
+			auto f2dot14 = [this](size_t at) { return float(i16(at)) / 16384.0f; };
+			if (flags & 0x8) {
+				local[0] = local[3] = f2dot14(offset);
+				offset += 2;
+			} else if (flags & 0x40) {
+				local[0] = f2dot14(offset);
+				local[3] = f2dot14(offset + 2);
+				offset += 4;
+			} else if (flags & 0x80) {
+				local[0] = f2dot14(offset);
+				local[1] = f2dot14(offset + 2);
+				local[2] = f2dot14(offset + 4);
+				local[3] = f2dot14(offset + 6);
+				offset += 8;
+			}
+			const float combined[6] = {
+				transform[0] * local[0] + transform[2] * local[1], transform[1] * local[0] + transform[3] * local[1],
+				transform[0] * local[2] + transform[2] * local[3], transform[1] * local[2] + transform[3] * local[3],
+				transform[0] * local[4] + transform[2] * local[5] + transform[4], transform[1] * local[4] + transform[3] * local[5] + transform[5],
+			};
+			if (!appendOutline(component, combined, depth + 1, out)) {
+				return false;
+			}
+			more = (flags & 0x20) != 0;
+		}
+		return true;
+	}
+
+	const size_t endPoints = begin + 10;
+	const uint32_t pointCount = contourCount > 0 ? uint32_t(u16(endPoints + size_t(contourCount - 1) * 2)) + 1 : 0;
+	size_t offset = endPoints + size_t(contourCount) * 2;
+	offset += 2 + u16(offset);
+	// flag의 bit 3은 다음 byte만큼 같은 flag를 되풀이한다.
+	std::vector<uint8_t> flags;
+	flags.reserve(pointCount);
+	while (flags.size() < pointCount) {
+		if (offset >= end) {
+			return false;
+		}
+		const uint8_t flag = u8(offset++);
+		const uint32_t repeat = (flag & 0x8) ? u8(offset++) : 0;
+		flags.insert(flags.end(), std::min<size_t>(repeat + 1, pointCount - flags.size()), flag);
+	}
+	std::vector<float> xs(pointCount), ys(pointCount);
+	// 좌표는 앞 점과의 차이이다. short이면 1 byte와 부호 bit, 아니면 같음 bit가 없을 때 2 byte
+	for (int axis = 0; axis < 2; ++axis) {
+		const uint8_t shortBit = axis == 0 ? 0x2 : 0x4, sameBit = axis == 0 ? 0x10 : 0x20;
+		std::vector<float>& values = axis == 0 ? xs : ys;
+		int32_t value = 0;
+		for (uint32_t point = 0; point < pointCount; ++point) {
+			const uint8_t flag = flags[point];
+			if (flag & shortBit) {
+				const int32_t delta = u8(offset++);
+				value += (flag & sameBit) ? delta : -delta;
+			} else if (!(flag & sameBit)) {
+				value += i16(offset);
+				offset += 2;
+			}
+			values[point] = float(value);
+		}
+	}
+	if (offset > end) {
+		return false;
+	}
+
+	uint32_t first = 0;
+	for (int32_t contour = 0; contour < contourCount; ++contour) {
+		const uint32_t last = u16(endPoints + size_t(contour) * 2);
+		if (last < first || last >= pointCount) {
+			return false;
+		}
+		const uint32_t count = last - first + 1;
+		if (count < 2) {
+			first = last + 1;
+			continue;
+		}
+		std::vector<GlyphEdge> edges;
+		auto point = [&](uint32_t i) { return apply(xs[first + i], ys[first + i]); };
+		auto onCurve = [&](uint32_t i) { return (flags[first + i] & 0x1) != 0; };
+		auto middle = [](Float2 a, Float2 b) { return Float2{ 0.5f * (a.x + b.x), 0.5f * (a.y + b.y) }; };
+		Float2 current, control{};
+		bool hasControl = false;
+		auto emit = [&](Float2 next, bool on) {
+			if (!on) {
+				if (hasControl) {
+					// 연달은 off-curve 점 사이에는 on-curve 점이 숨어 있다.
+					const Float2 implied = middle(control, next);
+					edges.push_back({ current, control, implied, true });
+					current = implied;
+				}
+				control = next;
+				hasControl = true;
+				return;
+			}
+			if (hasControl) {
+				edges.push_back({ current, control, next, true });
+			} else if (next.x != current.x || next.y != current.y) {
+				edges.push_back({ current, middle(current, next), next, false });
+			}
+			current = next;
+			hasControl = false;
+		};
+		// on-curve 점에서 시작한다. 모두 off-curve면 첫 두 점의 가운데에서 시작한다.
+		uint32_t start = 0;
+		while (start < count && !onCurve(start)) {
+			++start;
+		}
+		Float2 origin;
+		if (start < count) {
+			origin = current = point(start);
+			for (uint32_t k = 1; k < count; ++k) {
+				emit(point((start + k) % count), onCurve((start + k) % count));
+			}
+		} else {
+			origin = current = middle(point(count - 1), point(0));
+			for (uint32_t i = 0; i < count; ++i) {
+				emit(point(i), false);
+			}
+		}
+		emit(origin, true);
+		if (!edges.empty()) {
+			out.contours.push_back(std::move(edges));
+		}
+		first = last + 1;
+	}
+	return true;
+}
+
+#pragma endregion TtfFont }
+
+#pragma region FontAtlas {
+
+inline const FontGlyph* FontAtlas::glyph(uint32_t codepoint) const
+{
+	auto it = std::lower_bound(glyphs.begin(), glyphs.end(), codepoint, [](const FontGlyph& glyph, uint32_t value) { return glyph.codepoint < value; });
+	return it != glyphs.end() && it->codepoint == codepoint ? &*it : nullptr;
+}
+
+inline float FontAtlas::kern(uint32_t left, uint32_t right) const
+{
+	const uint64_t pair = uint64_t(left) << 32 | right;
+	auto it = std::lower_bound(kerning.begin(), kerning.end(), pair, [](const FontKerning& kerning, uint64_t value) { return kerning.pair < value; });
+	return it != kerning.end() && it->pair == pair ? it->value : 0.0f;
+}
+
+inline bool generateFontAtlas(const TtfFont& font, const FontAtlasOptions& options, FontAtlas& atlas, ThreadPool& pool)
+{
+	std::vector<uint32_t> codepoints = options.codepoints;
+	if (codepoints.empty()) {
+		for (uint32_t codepoint = 32; codepoint < 127; ++codepoint) {
+			codepoints.push_back(codepoint);
+		}
+	}
+	std::sort(codepoints.begin(), codepoints.end());
+	codepoints.erase(std::unique(codepoints.begin(), codepoints.end()), codepoints.end());
+
+	atlas = FontAtlas();
+	atlas.emSize = options.emSize;
+	atlas.distanceRange = options.distanceRange;
+	const double unitsPerEm = double(font.unitsPerEm()), scale = options.emSize / unitsPerEm;
+	atlas.ascender = float(font.ascender() / unitsPerEm);
+	atlas.descender = float(font.descender() / unitsPerEm);
+	atlas.lineHeight = float((font.ascender() - font.descender() + font.lineGap()) / unitsPerEm);
+	atlas.glyphs.resize(codepoints.size());
+	std::vector<SpriteImage> images(codepoints.size());
+	std::vector<uint8_t> broken(codepoints.size(), 0);
+	pool.parallelFor(codepoints.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const uint32_t glyphIndex = font.glyphIndex(codepoints[i]);
+			FontGlyph& glyph = atlas.glyphs[i];
+			glyph = FontGlyph{ codepoints[i], float(font.advance(glyphIndex) / unitsPerEm), 0.0f, 0.0f, 0.0f, 0.0f, 0, 0, 0, 0 };
+			GlyphOutline outline;
+			if (!font.outline(glyphIndex, outline)) {
+				broken[i] = 1;
+				continue;
+			}
+			if (outline.empty()) {
+				continue;
+			}
+			FontDetail::colorEdges(outline);
+			// 윤곽선 둘레로 distanceRange의 절반씩 여백을 두고 pixel 격자에 맞춘다.
+			const double margin = 0.5 * options.distanceRange;
+			const double left = std::floor(outline.xMin * scale - margin), bottom = std::floor(outline.yMin * scale - margin);
+			const double right = std::ceil(outline.xMax * scale + margin), top = std::ceil(outline.yMax * scale + margin);
+			if (right - left > options.maxSize || top - bottom > options.maxSize) {
+				broken[i] = 1;
+				continue;
+			}
+			SpriteImage& image = images[i];
+			image.width = uint32_t(right - left);
+			image.height = uint32_t(top - bottom);
+			image.pixels.resize(size_t(image.width) * image.height * 4);
+			FontDetail::rasterizeMsdf(outline, scale, left, bottom, options.distanceRange, image.width, image.height, image.pixels.data());
+			glyph.left = float(left / options.emSize);
+			glyph.bottom = float(bottom / options.emSize);
+			glyph.right = float(right / options.emSize);
+			glyph.top = float(top / options.emSize);
+		}
+	});
+	for (size_t i = 0; i < codepoints.size(); ++i) {
+		if (broken[i]) {
+			return FontDetail::fail("glyph for U+" + std::to_string(codepoints[i]) + " is broken");
+		}
+	}
+
+	// 윤곽선이 있는 glyph만 모아 들어가는 가장 작은 정사각형 한 장에 pack 한다.
+	std::vector<SpriteImage> packed;
+	std::vector<size_t> packedGlyphs;
+	for (size_t i = 0; i < images.size(); ++i) {
+		if (images[i].width > 0) {
+			packed.push_back(std::move(images[i]));
+			packedGlyphs.push_back(i);
+		}
+	}
+	uint32_t size = 128;
+	for (; size <= options.maxSize; size *= 2) {
+		std::vector<AtlasRect> rects(packed.size());
+		for (size_t i = 0; i < packed.size(); ++i) {
+			rects[i].width = packed[i].width;
+			rects[i].height = packed[i].height;
+		}
+		AtlasPacker packer(size, size, 1, 1);
+		if (packer.insertAll(rects) == rects.size()) {
+			break;
+		}
+	}
+	SpriteAtlas sprites;
+	if (size > options.maxSize || !buildSpriteAtlas(packed, size, size, 1, 1, sprites)) {
+		return FontDetail::fail(std::to_string(packed.size()) + " glyphs do not fit in " + std::to_string(options.maxSize) + "x"
+				+ std::to_string(options.maxSize));
+	}
+	atlas.width = size;
+	atlas.height = size;
+	atlas.pixels = sprites.pages.empty() ? std::vector<uint8_t>(size_t(size) * size * 4, 0) : std::move(sprites.pages[0]);
+	for (size_t i = 0; i < packedGlyphs.size(); ++i) {
+		FontGlyph& glyph = atlas.glyphs[packedGlyphs[i]];
+		const AtlasRect& rect = sprites.rects[i];
+		glyph.x = rect.x;
+		glyph.y = rect.y;
+		glyph.width = rect.width;
+		glyph.height = rect.height;
+	}
+
+	// kern table은 glyph 쌍이므로 고른 codepoint의 쌍으로 바꾼다.
+	std::unordered_multimap<uint32_t, uint32_t> glyphCodepoints;
+	for (uint32_t codepoint : codepoints) {
+		glyphCodepoints.insert({ font.glyphIndex(codepoint), codepoint });
+	}
+	for (const std::pair<uint32_t, int32_t>& pair : font.kerningPairs()) {
+		auto lefts = glyphCodepoints.equal_range(pair.first >> 16);
+		for (auto left = lefts.first; left != lefts.second; ++left) {
+			auto rights = glyphCodepoints.equal_range(pair.first & 0xFFFF);
+			for (auto right = rights.first; right != rights.second; ++right) {
+				atlas.kerning.push_back({ uint64_t(left->second) << 32 | right->second, float(pair.second / unitsPerEm) });
+			}
+		}
+	}
+	std::sort(atlas.kerning.begin(), atlas.kerning.end(), [](const FontKerning& a, const FontKerning& b) { return a.pair < b.pair; });
+	return true;
+}
+
+inline bool saveFontAtlas(const char* path, const FontAtlas& atlas)
+{
+	using namespace FontDetail;
+	const uint32_t header[] = { kMagic, kVersion, uint32_t(atlas.glyphs.size()), uint32_t(atlas.kerning.size()), atlas.width, atlas.height };
+	const float metrics[] = { atlas.emSize, atlas.distanceRange, atlas.ascender, atlas.descender, atlas.lineHeight };
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(metrics), sizeof(metrics));
+	out.write(reinterpret_cast<const char*>(atlas.glyphs.data()), std::streamsize(atlas.glyphs.size() * sizeof(FontGlyph)));
+	out.write(reinterpret_cast<const char*>(atlas.kerning.data()), std::streamsize(atlas.kerning.size() * sizeof(FontKerning)));
+	out.write(reinterpret_cast<const char*>(atlas.pixels.data()), std::streamsize(atlas.pixels.size()));
+	return bool(out) || fail(std::string("failed to write: ") + path);
+}
+
+inline bool loadFontAtlas(const char* path, FontAtlas& atlas)
+{
+	using namespace FontDetail;
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return fail(std::string("file not found: ") + path);
+	}
+	uint32_t header[6] = {};
+	float metrics[5] = {};
+	if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != kMagic || header[1] != kVersion) {
+		return fail(std::string("not a font atlas: ") + path);
+	}
+	// 크기가 말이 안 되면 읽기 전에 거른다.
+	if (header[2] > (1u << 21) || header[3] > (1u << 24) || header[4] > 16384 || header[5] > 16384) {
+		return fail(std::string("font atlas header is invalid: ") + path);
+	}
+	atlas = FontAtlas();
+	atlas.glyphs.resize(header[2]);
+	atlas.kerning.resize(header[3]);
+	atlas.width = header[4];
+	atlas.height = header[5];
+	atlas.pixels.resize(size_t(atlas.width) * atlas.height * 4);
+	file.read(reinterpret_cast<char*>(metrics), sizeof(metrics));
+	file.read(reinterpret_cast<char*>(atlas.glyphs.data()), std::streamsize(atlas.glyphs.size() * sizeof(FontGlyph)));
+	file.read(reinterpret_cast<char*>(atlas.kerning.data()), std::streamsize(atlas.kerning.size() * sizeof(FontKerning)));
+	file.read(reinterpret_cast<char*>(atlas.pixels.data()), std::streamsize(atlas.pixels.size()));
+	if (!file) {
+		atlas = FontAtlas();
+		return fail(std::string("font atlas is truncated: ") + path);
+	}
+	atlas.emSize = metrics[0];
+	atlas.distanceRange = metrics[1];
+	atlas.ascender = metrics[2];
+	atlas.descender = metrics[3];
+	atlas.lineHeight = metrics[4];
+	return true;
+}
+
+#pragma endregion FontAtlas }
+
+#pragma region TextBatch {
+
+inline uint32_t decodeUtf8(const char*& text)
+{
+	const uint8_t lead = uint8_t(*text++);
+	if (lead < 0x80) {
+		return lead;
+	}
+	const int extra = lead >= 0xF8 ? -1 : lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+	if (extra < 0) {
+		return 0xFFFD;
+	}
+	uint32_t codepoint = lead & (0x3F >> extra);
+	for (int i = 0; i < extra; ++i) {
+		const uint8_t next = uint8_t(*text);
+		if ((next & 0xC0) != 0x80) {
+			return 0xFFFD;
+		}
+		codepoint = codepoint << 6 | (next & 0x3F);
+		++text;
+	}
+	return codepoint;
+}
+
+inline size_t TextBatch::add(const char* text, float x, float y, float pixelSize, uint32_t color)
+{
+	const FontAtlas& atlas = *_atlas;
+	const FontGlyph* fallback = atlas.glyph('?');
+	const float screenRange = std::max(atlas.distanceRange * pixelSize / std::max(atlas.emSize, 1.0f), 1.0f);
+	const size_t first = _instances.size();
+	float penX = x, baseline = y;
+	uint32_t previous = 0;
+	while (*text) {
+		const uint32_t codepoint = decodeUtf8(text);
+		if (codepoint == '\n') {
+			penX = x;
+			baseline += atlas.lineHeight * pixelSize;
+			previous = 0;
+			continue;
+		}
+		const FontGlyph* glyph = atlas.glyph(codepoint);
+		if (!glyph) {
+			glyph = fallback;
+		}
+		if (!glyph) {
+			continue;
+		}
+		if (previous) {
+			penX += atlas.kern(previous, glyph->codepoint) * pixelSize;
+		}
+		if (glyph->width > 0) {
+			GlyphInstance instance;
+			instance.position = { penX + glyph->left * pixelSize, baseline - glyph->top * pixelSize };
+			instance.size = { (glyph->right - glyph->left) * pixelSize, (glyph->top - glyph->bottom) * pixelSize };
+			instance.atlasRect[0] = uint16_t(glyph->x);
+			instance.atlasRect[1] = uint16_t(glyph->y);
+			instance.atlasRect[2] = uint16_t(glyph->width);
+			instance.atlasRect[3] = uint16_t(glyph->height);
+			instance.color = color;
+			instance.screenRange = screenRange;
+			_instances.push_back(instance);
+		}
+		penX += glyph->advance * pixelSize;
+		previous = glyph->codepoint;
+	}
+	return _instances.size() - first;
+}
+
+inline Float2 TextBatch::measure(const char* text, float pixelSize) const
+{
+	const FontAtlas& atlas = *_atlas;
+	const FontGlyph* fallback = atlas.glyph('?');
+	float width = 0.0f, penX = 0.0f;
+	uint32_t lines = 1, previous = 0;
+	while (*text) {
+		const uint32_t codepoint = decodeUtf8(text);
+		if (codepoint == '\n') {
+			width = std::max(width, penX);
+			penX = 0.0f;
+			++lines;
+			previous = 0;
+			continue;
+		}
+		const FontGlyph* glyph = atlas.glyph(codepoint);
+		if (!glyph) {
+			glyph = fallback;
+		}
+		if (!glyph) {
+			continue;
+		}
+		if (previous) {
+			penX += atlas.kern(previous, glyph->codepoint) * pixelSize;
+		}
+		penX += glyph->advance * pixelSize;
+		previous = glyph->codepoint;
+	}
+	return { std::max(width, penX), float(lines) * atlas.lineHeight * pixelSize };
+}
+
+#pragma endregion TextBatch }
@@ -0,0 +1,732 @@
+/*
+ * GltfLoader.hpp
+ *
+ * glTF 2.0 (.gltf + .bin, .glb) loader.
+ * vertex data를 다시 packing 하지 않고 glTF buffer를 통째로 page 정렬된 메모리에 읽어 두고,
+ * primitive마다 "어느 buffer의 어느 offset을 어떤 format으로 읽는지"만 만들어 둔다.
+ * 01-primitive는 buffer를 MTL::Buffer로 감싸고(newBufferWithBytesNoCopy) 이 정보로 MTL::VertexDescriptor를 만든다.
+ * Metal의 정렬 조건(stride, offset이 4의 배수)을 만족하지 못하는 accessor만 예외적으로 복사한다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Json.hpp"
+#include "MathTypes.hpp"
+
+enum GltfComponentType : uint32_t {
+	GltfComponentTypeByte = 5120,
+	GltfComponentTypeUnsignedByte = 5121,
+	GltfComponentTypeShort = 5122,
+	GltfComponentTypeUnsignedShort = 5123,
+	GltfComponentTypeUnsignedInt = 5125,
+	GltfComponentTypeFloat = 5126,
+};
+
+// Vertex attributes the renderer understands. The value is the [[attribute(n)]] index in shader.metal.
+enum GltfAttributeSlot : uint32_t {
+	GltfAttributeSlotPosition = 0,
+	GltfAttributeSlotColor = 1,
+	GltfAttributeSlotNormal = 2,
+	GltfAttributeSlotTexcoord = 3,
+	GltfAttributeSlotCount = 4,
+};
+
+/*
+ * glTF buffer 하나의 내용.
+ * Apple silicon의 page 크기(16KB)에 맞춰 할당하므로 MTL::Device::newBuffer(pointer, length, ...) no-copy 조건을 만족한다.
+ * */
+class GltfBufferStorage {
+	public:
+		static constexpr size_t kPageSize = 16384;
+
+		bool allocate(size_t byteLength);
+		char* data() { return _pData.get(); }
+		const char* data() const { return _pData.get(); }
+		size_t byteLength() const { return _byteLength; }
+		// Page 단위로 올림한 크기. no-copy MTL::Buffer의 length로 쓴다.
+		size_t allocationSize() const { return _allocationSize; }
+
+	private:
+		struct Free {
+			void operator()(char* p) const { std::free(p); }
+		};
+		std::unique_ptr<char, Free> _pData;
+		size_t _byteLength{0};
+		size_t _allocationSize{0};
+};
+
+struct GltfBufferView {
+	uint32_t buffer{0};
+	size_t byteOffset{0};
+	size_t byteLength{0};
+	// 0 means tightly packed.
+	size_t byteStride{0};
+};
+
+struct GltfAccessor {
+	int32_t bufferView{-1};
+	size_t byteOffset{0};
+	uint32_t componentType{GltfComponentTypeFloat};
+	uint32_t numberOfComponents{1};
+	bool normalized{false};
+	size_t count{0};
+	bool hasBounds{false};
+	Float3 boundsMin{ 0.0f, 0.0f, 0.0f };
+	Float3 boundsMax{ 0.0f, 0.0f, 0.0f };
+
+	size_t elementSize() const;
+};
+
+struct GltfVertexAttribute {
+	uint32_t slot;
+	uint32_t accessor;
+	// Index into GltfPrimitive::layouts, which is also the vertex buffer index.
+	uint32_t layout;
+	size_t offset;
+};
+
+struct GltfVertexBufferLayout {
+	uint32_t buffer;
+	size_t bufferOffset;
+	size_t stride;
+};
+
+struct GltfPrimitive {
+	int32_t accessors[GltfAttributeSlotCount]{ -1, -1, -1, -1 };
+	int32_t indices{-1};
+	// glTF primitive mode. 4 = TRIANGLES
+	uint32_t mode{4};
+
+	// loadGltf가 채우는 binding 정보
+	std::vector<GltfVertexAttribute> attributes;
+	std::vector<GltfVertexBufferLayout> layouts;
+	uint32_t indexBuffer{0};
+	size_t indexBufferOffset{0};
+	// 2 (uint16) or 4 (uint32). 0 for non-indexed primitives.
+	uint32_t indexSize{0};
+	// Number of indices, or vertices when the primitive is not indexed.
+	size_t count{0};
+	// 같은 key를 가진 primitive는 같은 vertex descriptor(=같은 pipeline)를 쓴다.
+	std::string layoutKey;
+	// JOINTS_0과 WEIGHTS_0이 있다. skin은 아직 읽지 않으므로 bind pose로 그린다.
+	bool skinned{false};
+};
+
+struct GltfMesh {
+	std::string name;
+	std::vector<GltfPrimitive> primitives;
+};
+
+// One mesh instance in the scene graph, already flattened to a world matrix.
+struct GltfDraw {
+	uint32_t mesh;
+	Float4x4 world;
+};
+
+struct GltfScene {
+	std::vector<GltfBufferStorage> buffers;
+	std::vector<GltfBufferView> bufferViews;
+	std::vector<GltfAccessor> accessors;
+	std::vector<GltfMesh> meshes;
+	std::vector<GltfDraw> draws;
+	Float3 boundsMin{ 0.0f, 0.0f, 0.0f };
+	Float3 boundsMax{ 0.0f, 0.0f, 0.0f };
+	// Metal 정렬 조건 때문에 따로 복사한 byte 수. 보통 0이다.
+	size_t repackedBytes{0};
+};
+
+// .gltf 또는 .glb 파일을 읽는다. 실패하면 이유를 출력하고 false를 반환한다.
+bool loadGltf(const char* path, GltfScene& scene);
+
+#pragma region GltfBufferStorage {
+
+inline bool GltfBufferStorage::allocate(size_t byteLength)
+{
+	_byteLength = byteLength;
+	_allocationSize = std::max<size_t>((byteLength + kPageSize - 1) / kPageSize * kPageSize, kPageSize);
+	_pData.reset(static_cast<char*>(std::aligned_alloc(kPageSize, _allocationSize)));
+	if (!_pData) {
+		return false;
+	}
+	// padding은 GPU가 읽을 수 있으므로 0으로 채워 둔다.
+	std::memset(_pData.get() + byteLength, 0, _allocationSize - byteLength);
+	return true;
+}
+
+inline size_t GltfAccessor::elementSize() const
+{
+	size_t componentSize = componentType == GltfComponentTypeByte || componentType == GltfComponentTypeUnsignedByte ? 1
+		: componentType == GltfComponentTypeShort || componentType == GltfComponentTypeUnsignedShort ? 2 : 4;
+	return componentSize * numberOfComponents;
+}
+
+#pragma endregion GltfBufferStorage }
+
+#pragma region GltfLoader {
+
+namespace GltfDetail {
+
+inline bool fail(const std::string& message)
+{
+	std::cerr << "glTF: " << message << std::endl;
+	return false;
+}
+
+/*
+ * byteOffset, count 같은 0 이상의 정수 property를 읽는다. 없으면 fallback이다.
+ * 음수, 소수, 2^53보다 큰 값은 size_t로 바꾸면 엉뚱한 크기가 되므로 false를 반환한다.
+ * */
+inline bool readSize(const JsonValue& value, size_t fallback, size_t& out)
+{
+	if (value.isNull()) {
+		out = fallback;
+		return true;
+	}
+	if (!value.isNumber() || !(value.number >= 0.0) || value.number > 9007199254740992.0 || value.number != std::floor(value.number)) {
+		return false;
+	}
+	out = size_t(value.number);
+	return true;
+}
+
+inline bool isComponentType(uint32_t componentType)
+{
+	return (componentType >= GltfComponentTypeByte && componentType <= GltfComponentTypeUnsignedShort) ||
+		componentType == GltfComponentTypeUnsignedInt || componentType == GltfComponentTypeFloat;
+}
+
+inline int base64Value(char c)
+{
+	if (c >= 'A' && c <= 'Z') return c - 'A';
+	if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+	if (c >= '0' && c <= '9') return c - '0' + 52;
+	if (c == '+' || c == '-') return 62;
+	if (c == '/' || c == '_') return 63;
+	return -1;
+}
+
+// "data:...;base64,XXXX" 형식의 embedded buffer
+inline bool decodeDataUri(const std::string& uri, size_t byteLength, GltfBufferStorage& storage)
+{
+	size_t comma = uri.find(',');
+	if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos) {
+		return fail("unsupported data URI");
+	}
+	if (!storage.allocate(byteLength)) {
+		return fail("out of memory");
+	}
+	size_t written = 0;
+	uint32_t accumulator = 0;
+	int bits = 0;
+	for (size_t i = comma + 1; i < uri.size() && written < byteLength; ++i) {
+		int value = base64Value(uri[i]);
+		if (value < 0) {
+			continue;
+		}
+		accumulator = (accumulator << 6) | uint32_t(value);
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			storage.data()[written++] = char((accumulator >> bits) & 0xFF);
+		}
+	}
+	return written == byteLength || fail("data URI is shorter than byteLength");
+}
+
+inline bool readExternalBuffer(const std::filesystem::path& path, size_t byteLength, GltfBufferStorage& storage)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return fail("buffer not found: " + path.string());
+	}
+	if (!storage.allocate(byteLength)) {
+		return fail("out of memory");
+	}
+	file.read(storage.data(), std::streamsize(byteLength));
+	return size_t(file.gcount()) == byteLength || fail("buffer is shorter than byteLength: " + path.string());
+}
+
+inline std::string percentDecode(const std::string& uri)
+{
+	std::string out;
+	for (size_t i = 0; i < uri.size(); ++i) {
+		if (uri[i] == '%' && i + 2 < uri.size()) {
+			out += char(std::strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+			i += 2;
+		} else {
+			out += uri[i];
+		}
+	}
+	return out;
+}
+
+inline Float4x4 nodeMatrix(const JsonValue& node)
+{
+	const JsonValue& matrix = node["matrix"];
+	if (matrix.size() == 16) {
+		Float4x4 m;
+		float* values = &m.columns[0].x;
+		for (size_t i = 0; i < 16; ++i) {
+			values[i] = float(matrix[i].asNumber());
+		}
+		return m;
+	}
+	const JsonValue& t = node["translation"];
+	const JsonValue& r = node["rotation"];
+	const JsonValue& s = node["scale"];
+	Float3 translation{ float(t[0].asNumber()), float(t[1].asNumber()), float(t[2].asNumber()) };
+	Float4 rotation{ float(r[0].asNumber()), float(r[1].asNumber()), float(r[2].asNumber()), float(r[3].asNumber(1.0)) };
+	Float3 scale{ float(s[0].asNumber(1.0)), float(s[1].asNumber(1.0)), float(s[2].asNumber(1.0)) };
+	return translation4x4(translation) * rotation4x4(rotation) * scale4x4(scale);
+}
+
+inline uint32_t componentsForType(const std::string& type)
+{
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	// MAT 타입은 vertex attribute로 쓰지 않는다.
+	return 0;
+}
+
+inline int32_t slotForSemantic(const std::string& semantic)
+{
+	if (semantic == "POSITION") return GltfAttributeSlotPosition;
+	if (semantic == "COLOR_0") return GltfAttributeSlotColor;
+	if (semantic == "NORMAL") return GltfAttributeSlotNormal;
+	if (semantic == "TEXCOORD_0") return GltfAttributeSlotTexcoord;
+	return -1;
+}
+
+/*
+ * accessor 하나를 새 buffer로 복사해서 buffer에 그 번호를 넣는다. 메모리가 모자라면 false
+ * vertex attribute는 각 원소를 4 byte 배수 stride로 늘린다.
+ * index는 Metal이 index 크기 그대로 빈틈없이 읽으므로 elementSize로 붙여 쓰고, unsigned byte는 uint16으로 넓힌다.
+ * */
+inline bool repackAccessor(GltfScene& scene, const GltfAccessor& accessor, bool isIndex, uint32_t& buffer, size_t& stride)
+{
+	const GltfBufferView& view = scene.bufferViews[accessor.bufferView];
+	const char* source = scene.buffers[view.buffer].data() + view.byteOffset + accessor.byteOffset;
+	size_t sourceStride = view.byteStride ? view.byteStride : accessor.elementSize();
+	const bool toUInt16 = isIndex && accessor.componentType == GltfComponentTypeUnsignedByte;
+	stride = toUInt16 ? 2 : isIndex ? accessor.elementSize() : (accessor.elementSize() + 3) / 4 * 4;
+
+	GltfBufferStorage storage;
+	if (!storage.allocate(accessor.count * stride)) {
+		return fail("out of memory");
+	}
+	std::memset(storage.data(), 0, accessor.count * stride);
+	for (size_t i = 0; i < accessor.count; ++i) {
+		if (toUInt16) {
+			uint16_t index = uint8_t(source[i * sourceStride]);
+			std::memcpy(storage.data() + i * 2, &index, 2);
+		} else {
+			std::memcpy(storage.data() + i * stride, source + i * sourceStride, accessor.elementSize());
+		}
+	}
+	scene.repackedBytes += accessor.count * stride;
+	scene.buffers.push_back(std::move(storage));
+	buffer = uint32_t(scene.buffers.size() - 1);
+	return true;
+}
+
+/*
+ * index accessor가 unsigned byte / short / int의 SCALAR이고 모든 값이 vertexCount보다 작은지 본다.
+ * 범위를 벗어난 index로 그리면 GPU가 vertex buffer 밖을 읽는다.
+ * */
+inline bool indicesInRange(const GltfScene& scene, const GltfAccessor& accessor, size_t vertexCount)
+{
+	if (accessor.numberOfComponents != 1 || (accessor.componentType != GltfComponentTypeUnsignedByte &&
+				accessor.componentType != GltfComponentTypeUnsignedShort && accessor.componentType != GltfComponentTypeUnsignedInt)) {
+		return false;
+	}
+	const GltfBufferView& view = scene.bufferViews[accessor.bufferView];
+	const char* source = scene.buffers[view.buffer].data() + view.byteOffset + accessor.byteOffset;
+	const size_t size = accessor.elementSize();
+	const size_t sourceStride = view.byteStride ? view.byteStride : size;
+	for (size_t i = 0; i < accessor.count; ++i) {
+		uint32_t index = 0;
+		if (size == 1) {
+			index = uint8_t(source[i * sourceStride]);
+		} else if (size == 2) {
+			uint16_t value;
+			std::memcpy(&value, source + i * sourceStride, 2);
+			index = value;
+		} else {
+			std::memcpy(&index, source + i * sourceStride, 4);
+		}
+		if (index >= vertexCount) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * primitive의 attribute를 vertex buffer layout으로 묶는다.
+ *  - byteStride가 있는 bufferView는 interleaved이므로 bufferView 하나가 layout 하나가 되고 accessor offset이 attribute offset이 된다.
+ *  - tightly packed accessor는 각자 layout을 가지고 offset을 buffer offset에 더한다.
+ *  - offset이나 stride가 4 byte 정렬이 아니면 Metal vertex descriptor에 쓸 수 없으므로 repackAccessor로 복사한다.
+ * 복사할 메모리가 없으면 false를 반환한다.
+ * */
+inline bool bindPrimitive(GltfScene& scene, GltfPrimitive& primitive)
+{
+	primitive.attributes.clear();
+	primitive.layouts.clear();
+	std::vector<int32_t> layoutForView(scene.bufferViews.size(), -1);
+	for (uint32_t slot = 0; slot < GltfAttributeSlotCount; ++slot) {
+		if (primitive.accessors[slot] < 0) {
+			continue;
+		}
+		const GltfAccessor& accessor = scene.accessors[primitive.accessors[slot]];
+		const GltfBufferView& view = scene.bufferViews[accessor.bufferView];
+		GltfVertexAttribute attribute{ slot, uint32_t(primitive.accessors[slot]), 0, 0 };
+		if (view.byteStride && view.byteStride % 4 == 0 && view.byteOffset % 4 == 0 && accessor.byteOffset % 4 == 0 &&
+				accessor.byteOffset < view.byteStride) {
+			if (layoutForView[accessor.bufferView] < 0) {
+				layoutForView[accessor.bufferView] = int32_t(primitive.layouts.size());
+				primitive.layouts.push_back({ view.buffer, view.byteOffset, view.byteStride });
+			}
+			attribute.layout = uint32_t(layoutForView[accessor.bufferView]);
+			attribute.offset = accessor.byteOffset;
+		} else if (!view.byteStride && accessor.elementSize() % 4 == 0 && (view.byteOffset + accessor.byteOffset) % 4 == 0) {
+			attribute.layout = uint32_t(primitive.layouts.size());
+			primitive.layouts.push_back({ view.buffer, view.byteOffset + accessor.byteOffset, accessor.elementSize() });
+		} else {
+			uint32_t buffer = 0;
+			size_t stride = 0;
+			if (!repackAccessor(scene, accessor, false, buffer, stride)) {
+				return false;
+			}
+			attribute.layout = uint32_t(primitive.layouts.size());
+			primitive.layouts.push_back({ buffer, 0, stride });
+		}
+		primitive.attributes.push_back(attribute);
+	}
+
+	if (primitive.indices >= 0) {
+		const GltfAccessor& accessor = scene.accessors[primitive.indices];
+		const GltfBufferView& view = scene.bufferViews[accessor.bufferView];
+		size_t offset = view.byteOffset + accessor.byteOffset;
+		primitive.count = accessor.count;
+		// Metal에는 8bit index가 없고, index buffer offset은 4 byte 정렬이어야 하며, index 사이에 빈틈이 없어야 한다.
+		if (accessor.componentType == GltfComponentTypeUnsignedByte || (view.byteStride && view.byteStride != accessor.elementSize()) ||
+				offset % 4 != 0) {
+			size_t stride = 0;
+			if (!repackAccessor(scene, accessor, true, primitive.indexBuffer, stride)) {
+				return false;
+			}
+			primitive.indexBufferOffset = 0;
+			primitive.indexSize = uint32_t(stride);
+		} else {
+			primitive.indexBuffer = view.buffer;
+			primitive.indexBufferOffset = offset;
+			primitive.indexSize = uint32_t(accessor.elementSize());
+		}
+	} else {
+		// index가 없으면 가장 짧은 attribute까지만 그린다.
+		primitive.count = SIZE_MAX;
+		for (const GltfVertexAttribute& attribute : primitive.attributes) {
+			primitive.count = std::min(primitive.count, scene.accessors[attribute.accessor].count);
+		}
+	}
+
+	primitive.layoutKey.clear();
+	for (const GltfVertexAttribute& attribute : primitive.attributes) {
+		const GltfAccessor& accessor = scene.accessors[attribute.accessor];
+		primitive.layoutKey += std::to_string(attribute.slot) + ":" + std::to_string(accessor.componentType) + "x" +
+			std::to_string(accessor.numberOfComponents) + (accessor.normalized ? "n" : "") + "@" +
+			std::to_string(attribute.layout) + "+" + std::to_string(attribute.offset) + ";";
+	}
+	for (const GltfVertexBufferLayout& layout : primitive.layouts) {
+		primitive.layoutKey += "/" + std::to_string(layout.stride);
+	}
+	return true;
+}
+
+inline void addDraws(GltfScene& scene, const JsonValue& nodes, size_t nodeIndex, const Float4x4& parent, int depth)
+{
+	// 잘못된 파일의 순환 참조를 막는다.
+	if (depth > 64 || nodeIndex >= nodes.size()) {
+		return;
+	}
+	const JsonValue& node = nodes[nodeIndex];
+	Float4x4 world = parent * nodeMatrix(node);
+	int64_t mesh = node["mesh"].asInt(-1);
+	if (mesh >= 0 && size_t(mesh) < scene.meshes.size()) {
+		scene.draws.push_back({ uint32_t(mesh), world });
+	}
+	const JsonValue& children = node["children"];
+	for (size_t i = 0; i < children.size(); ++i) {
+		addDraws(scene, nodes, size_t(children[i].asInt(-1)), world, depth + 1);
+	}
+}
+
+inline bool readGlb(const char* path, std::string& json, GltfBufferStorage& binary, bool& hasBinary)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return fail(std::string("file not found: ") + path);
+	}
+	uint32_t header[3];
+	if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != 0x46546C67u || header[1] != 2) {
+		return fail("not a glTF 2.0 binary");
+	}
+	hasBinary = false;
+	size_t offset = sizeof(header);
+	while (offset + 8 <= header[2]) {
+		uint32_t chunk[2];
+		if (!file.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+			return fail("truncated chunk header");
+		}
+		offset += 8;
+		if (chunk[1] == 0x4E4F534Au) { // "JSON"
+			json.resize(chunk[0]);
+			file.read(&json[0], chunk[0]);
+		} else if (chunk[1] == 0x004E4942u && !hasBinary) { // "BIN"
+			// BIN chunk는 정렬된 메모리에 바로 읽어서 그대로 GPU buffer가 된다.
+			if (!binary.allocate(chunk[0])) {
+				return fail("out of memory");
+			}
+			file.read(binary.data(), chunk[0]);
+			hasBinary = true;
+		} else {
+			file.seekg(chunk[0], std::ios::cur);
+		}
+		if (!file) {
+			return fail("truncated chunk");
+		}
+		offset += chunk[0];
+	}
+	return !json.empty() || fail("missing JSON chunk");
+}
+
+} // namespace GltfDetail
+
+inline bool loadGltf(const char* path, GltfScene& scene)
+{
+	using namespace GltfDetail;
+
+	scene = GltfScene();
+	std::filesystem::path filePath(path);
+	std::string extension = filePath.extension().string();
+	std::string text;
+	GltfBufferStorage glbBinary;
+	bool hasGlbBinary = false;
+	if (extension == ".glb" || extension == ".GLB") {
+		if (!readGlb(path, text, glbBinary, hasGlbBinary)) {
+			return false;
+		}
+	} else {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return fail(std::string("file not found: ") + path);
+		}
+		text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	JsonValue document;
+	std::string error;
+	if (!parseJson(text.data(), text.size(), document, error)) {
+		return fail(error);
+	}
+	if (document["asset"]["version"].asString().compare(0, 1, "2") != 0) {
+		return fail("only glTF 2.0 is supported");
+	}
+
+	// Buffers
+	const JsonValue& buffers = document["buffers"];
+	for (size_t i = 0; i < buffers.size(); ++i) {
+		const JsonValue& buffer = buffers[i];
+		size_t byteLength = 0;
+		if (!readSize(buffer["byteLength"], 0, byteLength)) {
+			return fail("buffer " + std::to_string(i) + " has an invalid byteLength");
+		}
+		GltfBufferStorage storage;
+		if (!buffer.contains("uri")) {
+			if (i != 0 || !hasGlbBinary || glbBinary.byteLength() < byteLength) {
+				return fail("buffer without uri needs a GLB BIN chunk");
+			}
+			storage = std::move(glbBinary);
+		} else {
+			const std::string& uri = buffer["uri"].asString();
+			bool ok = uri.compare(0, 5, "data:") == 0 ? decodeDataUri(uri, byteLength, storage)
+				: readExternalBuffer(filePath.parent_path() / percentDecode(uri), byteLength, storage);
+			if (!ok) {
+				return false;
+			}
+		}
+		scene.buffers.push_back(std::move(storage));
+	}
+
+	// Buffer views
+	const JsonValue& bufferViews = document["bufferViews"];
+	for (size_t i = 0; i < bufferViews.size(); ++i) {
+		const JsonValue& json = bufferViews[i];
+		GltfBufferView view;
+		view.buffer = uint32_t(json["buffer"].asInt(-1));
+		if (!readSize(json["byteOffset"], 0, view.byteOffset) || !readSize(json["byteLength"], 0, view.byteLength) ||
+				!readSize(json["byteStride"], 0, view.byteStride)) {
+			return fail("bufferView " + std::to_string(i) + " has an invalid size");
+		}
+		// 더하면 넘칠 수 있으므로 빼서 비교한다.
+		if (view.buffer >= scene.buffers.size() || view.byteOffset > scene.buffers[view.buffer].byteLength() ||
+				view.byteLength > scene.buffers[view.buffer].byteLength() - view.byteOffset) {
+			return fail("bufferView " + std::to_string(i) + " is out of range");
+		}
+		scene.bufferViews.push_back(view);
+	}
+
+	// Accessors
+	const JsonValue& accessors = document["accessors"];
+	for (size_t i = 0; i < accessors.size(); ++i) {
+		const JsonValue& json = accessors[i];
+		GltfAccessor accessor;
+		accessor.bufferView = int32_t(json["bufferView"].asInt(-1));
+		accessor.componentType = uint32_t(json["componentType"].asInt());
+		accessor.numberOfComponents = componentsForType(json["type"].asString());
+		accessor.normalized = json["normalized"].asBool();
+		if (!readSize(json["byteOffset"], 0, accessor.byteOffset) || !readSize(json["count"], 0, accessor.count)) {
+			return fail("accessor " + std::to_string(i) + " has an invalid byteOffset or count");
+		}
+		if (!isComponentType(accessor.componentType)) {
+			return fail("accessor " + std::to_string(i) + " has an invalid componentType");
+		}
+		const JsonValue& boundsMin = json["min"];
+		const JsonValue& boundsMax = json["max"];
+		if (boundsMin.size() >= 3 && boundsMax.size() >= 3) {
+			accessor.hasBounds = true;
+			accessor.boundsMin = { float(boundsMin[0].asNumber()), float(boundsMin[1].asNumber()), float(boundsMin[2].asNumber()) };
+			accessor.boundsMax = { float(boundsMax[0].asNumber()), float(boundsMax[1].asNumber()), float(boundsMax[2].asNumber()) };
+		}
+		if (accessor.bufferView >= 0) {
+			if (size_t(accessor.bufferView) >= scene.bufferViews.size()) {
+				return fail("accessor " + std::to_string(i) + " has an invalid bufferView");
+			}
+			const GltfBufferView& view = scene.bufferViews[accessor.bufferView];
+			// 마지막 원소의 끝이 view 안에 있어야 한다. 큰 count가 곱셈에서 넘치지 않도록 나눠서 비교한다.
+			const size_t size = accessor.elementSize();
+			const size_t stride = view.byteStride ? view.byteStride : size;
+			if (accessor.count > 0 && (accessor.byteOffset > view.byteLength || size > view.byteLength - accessor.byteOffset ||
+						(stride > 0 && accessor.count - 1 > (view.byteLength - accessor.byteOffset - size) / stride))) {
+				return fail("accessor " + std::to_string(i) + " is out of range");
+			}
+		}
+		scene.accessors.push_back(accessor);
+	}
+
+	// Meshes
+	const JsonValue& meshes = document["meshes"];
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		GltfMesh mesh;
+		mesh.name = meshes[m]["name"].asString();
+		const JsonValue& primitives = meshes[m]["primitives"];
+		for (size_t p = 0; p < primitives.size(); ++p) {
+			const JsonValue& json = primitives[p];
+			GltfPrimitive primitive;
+			primitive.mode = uint32_t(json["mode"].asInt(4));
+			primitive.indices = int32_t(json["indices"].asInt(-1));
+			const JsonValue& attributes = json["attributes"];
+			for (size_t a = 0; a < attributes.keys.size(); ++a) {
+				int32_t slot = slotForSemantic(attributes.keys[a]);
+				if (slot >= 0) {
+					primitive.accessors[slot] = int32_t(attributes.values[a].asInt(-1));
+				}
+			}
+			primitive.skinned = attributes.contains("JOINTS_0") && attributes.contains("WEIGHTS_0");
+			// sparse accessor와 bufferView가 없는 accessor는 zero-copy로 binding 할 수 없으므로 건너뛴다.
+			// MAT 타입(numberOfComponents 0)은 vertex format이 없다.
+			bool usable = primitive.accessors[GltfAttributeSlotPosition] >= 0 && primitive.mode != 2 && primitive.mode != 6;
+			for (int32_t accessor : primitive.accessors) {
+				usable = usable && (accessor < 0 || (size_t(accessor) < scene.accessors.size() &&
+					scene.accessors[accessor].bufferView >= 0 && scene.accessors[accessor].numberOfComponents > 0 &&
+					!accessors[size_t(accessor)].contains("sparse")));
+			}
+			usable = usable && (primitive.indices < 0 || (size_t(primitive.indices) < scene.accessors.size() &&
+				scene.accessors[primitive.indices].bufferView >= 0));
+			if (!usable) {
+				std::cerr << "glTF: skipped unsupported primitive " << p << " of mesh " << m << std::endl;
+				continue;
+			}
+			// 모든 attribute가 vertex 수만큼 있어야 하므로 가장 짧은 accessor가 vertex 수이다.
+			size_t vertexCount = SIZE_MAX;
+			for (int32_t accessor : primitive.accessors) {
+				if (accessor >= 0) {
+					vertexCount = std::min(vertexCount, scene.accessors[accessor].count);
+				}
+			}
+			if (primitive.indices >= 0 && !indicesInRange(scene, scene.accessors[primitive.indices], vertexCount)) {
+				std::cerr << "glTF: skipped primitive " << p << " of mesh " << m << " with invalid indices" << std::endl;
+				continue;
+			}
+			if (!bindPrimitive(scene, primitive)) {
+				std::cerr << "glTF: skipped primitive " << p << " of mesh " << m << " that could not be bound" << std::endl;
+				continue;
+			}
+			mesh.primitives.push_back(std::move(primitive));
+		}
+		scene.meshes.push_back(std::move(mesh));
+	}
+
+	// Scene graph
+	const JsonValue& nodes = document["nodes"];
+	const JsonValue& scenes = document["scenes"];
+	const JsonValue& roots = scenes[size_t(document["scene"].asInt(0))]["nodes"];
+	if (roots.size() > 0) {
+		for (size_t i = 0; i < roots.size(); ++i) {
+			addDraws(scene, nodes, size_t(roots[i].asInt(-1)), identity4x4(), 0);
+		}
+	} else {
+		// scene이 없으면 부모가 없는 모든 node를 그린다.
+		std::vector<bool> isChild(nodes.size(), false);
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			const JsonValue& children = nodes[i]["children"];
+			for (size_t c = 0; c < children.size(); ++c) {
+				size_t child = size_t(children[c].asInt(-1));
+				if (child < isChild.size()) isChild[child] = true;
+			}
+		}
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			if (!isChild[i]) addDraws(scene, nodes, i, identity4x4(), 0);
+		}
+	}
+
+	// Scene bounds from the POSITION accessor min/max, which the spec requires.
+	scene.boundsMin = { INFINITY, INFINITY, INFINITY };
+	scene.boundsMax = { -INFINITY, -INFINITY, -INFINITY };
+	for (const GltfDraw& draw : scene.draws) {
+		for (const GltfPrimitive& primitive : scene.meshes[draw.mesh].primitives) {
+			const GltfAccessor& position = scene.accessors[primitive.accessors[GltfAttributeSlotPosition]];
+			if (!position.hasBounds) {
+				continue;
+			}
+			for (int corner = 0; corner < 8; ++corner) {
+				Float3 p{ corner & 1 ? position.boundsMax.x : position.boundsMin.x,
+					corner & 2 ? position.boundsMax.y : position.boundsMin.y,
+					corner & 4 ? position.boundsMax.z : position.boundsMin.z };
+				p = transformPoint(draw.world, p);
+				scene.boundsMin = min(scene.boundsMin, p);
+				scene.boundsMax = max(scene.boundsMax, p);
+			}
+		}
+	}
+	if (scene.draws.empty()) {
+		return fail(std::string("no drawable meshes in ") + path);
+	}
+	return true;
+}
+
+#pragma endregion GltfLoader }
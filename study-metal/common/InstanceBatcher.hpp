@@ -0,0 +1,141 @@
+/*
+ * InstanceBatcher.hpp
+ *
+ * 물체마다 draw call을 하나씩 쓰는 대신 같은 mesh / pipeline으로 그리는 물체를 모아
+ * instanced draw 하나(drawPrimitives / drawIndexedPrimitives의 instanceCount)로 만든다.
+ * 물체별 transform과 색은 InstanceData 배열로 모여 MTL::VertexStepFunctionPerInstance buffer에 그대로 복사된다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "MathTypes.hpp"
+
+// per-instance vertex buffer 한 칸. shader에서는 attribute 4개(float4 column)와 색 하나로 읽는다.
+struct InstanceData {
+	Float4x4 model;
+	Float4 color;
+};
+
+static_assert(sizeof(InstanceData) == 80, "InstanceData is copied into a per-instance vertex buffer as is");
+
+struct InstanceBatch {
+	uint32_t mesh;
+	uint32_t pipeline;
+	// InstanceBatcher::instances() 안의 구간
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+};
+
+class InstanceBatcher {
+	public:
+		void clear();
+		void reserve(size_t count);
+		// mesh, pipeline은 호출하는 쪽이 정한 번호이다. 같은 쌍은 한 batch가 된다.
+		void add(uint32_t mesh, uint32_t pipeline, const Float4x4& model, Float4 color = { 1.0f, 1.0f, 1.0f, 1.0f });
+		/*
+		 * 모은 instance를 batch별로 연속되게 다시 놓는다. batch는 pipeline, mesh 순서로 정렬되어
+		 * pipeline state를 바꾸는 횟수가 가장 적다. batch 안에서는 add 순서를 지킨다.
+		 * */
+		void build();
+
+		const std::vector<InstanceBatch>& batches() const { return _batches; }
+		const std::vector<InstanceData>& instances() const { return _instances; }
+		size_t numberOfInstances() const { return _instances.size(); }
+
+	private:
+		static uint64_t keyFor(uint32_t mesh, uint32_t pipeline) { return uint64_t(pipeline) << 32 | mesh; }
+		static constexpr int kCacheBits = 10;
+		static constexpr size_t kCacheSize = size_t(1) << kCacheBits;
+
+		std::vector<uint64_t> _keys;
+		std::vector<InstanceData> _pending;
+		std::vector<InstanceBatch> _batches;
+		std::vector<InstanceData> _instances;
+		// build 사이에 다시 쓴다.
+		std::unordered_map<uint64_t, uint32_t> _batchOfKey;
+		std::vector<uint32_t> _batchOfInstance;
+};
+
+#pragma region InstanceBatcher {
+
+inline void InstanceBatcher::clear()
+{
+	_keys.clear();
+	_pending.clear();
+	_batches.clear();
+	_instances.clear();
+}
+
+inline void InstanceBatcher::reserve(size_t count)
+{
+	_keys.reserve(count);
+	_pending.reserve(count);
+	_instances.reserve(count);
+	_batchOfInstance.reserve(count);
+}
+
+inline void InstanceBatcher::add(uint32_t mesh, uint32_t pipeline, const Float4x4& model, Float4 color)
+{
+	_keys.push_back(keyFor(mesh, pipeline));
+	_pending.push_back({ model, color });
+}
+
+inline void InstanceBatcher::build()
+{
+	// 1. key마다 batch를 만들고 instance 수를 센다. 보통 (mesh, pipeline) 쌍은 수백 개 이하라서
+	// key의 hash로 고르는 작은 cache가 거의 항상 맞고 map은 처음 보는 key에만 쓴다.
+	_batches.clear();
+	_batchOfKey.clear();
+	_batchOfInstance.resize(_keys.size());
+	struct CacheEntry {
+		uint64_t key{UINT64_MAX};
+		uint32_t batch{0};
+	};
+	CacheEntry cache[kCacheSize];
+	for (size_t i = 0; i < _keys.size(); ++i) {
+		const uint64_t key = _keys[i];
+		CacheEntry& entry = cache[(key * 0x9E3779B97F4A7C15ull) >> (64 - kCacheBits)];
+		if (entry.key != key) {
+			auto [found, inserted] = _batchOfKey.try_emplace(key, uint32_t(_batches.size()));
+			if (inserted) {
+				_batches.push_back({ uint32_t(key), uint32_t(key >> 32), 0, 0 });
+			}
+			entry = { key, found->second };
+		}
+		_batchOfInstance[i] = entry.batch;
+		++_batches[entry.batch].instanceCount;
+	}
+
+	// 2. batch를 (pipeline, mesh) 순서로 놓고 시작 위치를 정한다.
+	std::vector<uint32_t> order(_batches.size());
+	for (uint32_t b = 0; b < order.size(); ++b) {
+		order[b] = b;
+	}
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return keyFor(_batches[a].mesh, _batches[a].pipeline) < keyFor(_batches[b].mesh, _batches[b].pipeline);
+	});
+	std::vector<InstanceBatch> sorted(_batches.size());
+	std::vector<uint32_t> cursor(_batches.size());
+	uint32_t offset = 0;
+	for (uint32_t rank = 0; rank < order.size(); ++rank) {
+		sorted[rank] = _batches[order[rank]];
+		sorted[rank].firstInstance = offset;
+		cursor[order[rank]] = offset;
+		offset += sorted[rank].instanceCount;
+	}
+	_batches.swap(sorted);
+
+	// 3. counting sort처럼 instance를 batch 구간에 흩어 놓는다.
+	_instances.resize(_pending.size());
+	for (size_t i = 0; i < _pending.size(); ++i) {
+		_instances[cursor[_batchOfInstance[i]]++] = _pending[i];
+	}
+	_keys.clear();
+	_pending.clear();
+}
+
+#pragma endregion InstanceBatcher }
@@ -0,0 +1,387 @@
+/*
+ * InstanceBvh.hpp
+ *
+ * instance(top-level) BVH. MTL::InstanceAccelerationStructureDescriptor처럼 instance descriptor 배열과
+ * instancedAccelerationStructures(= Bvh 목록)를 받아, instance마다 ray를 object 공간으로 옮겨 Bvh로 검사한다.
+ *
+ * - descriptor는 MTL::AccelerationStructureInstanceDescriptor / MotionInstanceDescriptor와 같은 byte 배치라서
+ *   GPU instance buffer에 쓸 데이터를 그대로 넘길 수 있다.
+ * - motion instance는 motionTransforms 배열의 keyframe 행렬을 ray 시간으로 선형 보간한다.
+ * - transform만 바뀐 frame은 refit(구조 유지) 또는 BvhBuildMode::Fast(Morton) rebuild로 빠르게 다시 만든다.
+ * */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.hpp"
+
+// MTL::AccelerationStructureInstanceDescriptor
+struct InstanceDescriptor {
+	PackedFloat4x3 transformationMatrix;
+	uint32_t options;
+	uint32_t mask;
+	uint32_t intersectionFunctionTableOffset;
+	uint32_t accelerationStructureIndex;
+};
+
+// MTL::AccelerationStructureMotionInstanceDescriptor. 행렬은 motionTransforms[start, start + count)에 있다.
+struct MotionInstanceDescriptor {
+	uint32_t options;
+	uint32_t mask;
+	uint32_t intersectionFunctionTableOffset;
+	uint32_t accelerationStructureIndex;
+	uint32_t userID;
+	uint32_t motionTransformsStartIndex;
+	uint32_t motionTransformsCount;
+	MotionBorderMode motionStartBorderMode;
+	MotionBorderMode motionEndBorderMode;
+	float motionStartTime;
+	float motionEndTime;
+};
+
+static_assert(sizeof(InstanceDescriptor) == 64, "InstanceDescriptor must match MTL::AccelerationStructureInstanceDescriptor");
+static_assert(sizeof(MotionInstanceDescriptor) == 44, "MotionInstanceDescriptor must match MTL::AccelerationStructureMotionInstanceDescriptor");
+
+// MPSIntersectionDistancePrimitiveIndexInstanceIndexCoordinates와 같은 배치. 맞지 않으면 distance < 0
+struct InstanceRayHit {
+	float distance;
+	uint32_t primitiveIndex;
+	uint32_t instanceIndex;
+	float u, v;
+};
+
+class InstanceBvh {
+	public:
+		// structures[accelerationStructureIndex]가 instance의 geometry이다. build 뒤에도 살아 있어야 한다.
+		bool build(const InstanceDescriptor* instances, size_t count, const std::vector<const Bvh*>& structures,
+				BvhBuildMode mode = BvhBuildMode::Sah, ThreadPool& pool = ThreadPool::shared());
+		bool build(const MotionInstanceDescriptor* instances, size_t count, const PackedFloat4x3* motionTransforms,
+				const std::vector<const Bvh*>& structures, BvhBuildMode mode = BvhBuildMode::Sah, ThreadPool& pool = ThreadPool::shared());
+		// build 때와 같은 instance 목록에서 transform만 바뀐 경우. tree 모양은 그대로 두고 bounds만 다시 계산한다.
+		bool refit(const InstanceDescriptor* instances, size_t count, ThreadPool& pool = ThreadPool::shared());
+		bool refit(const MotionInstanceDescriptor* instances, size_t count, const PackedFloat4x3* motionTransforms,
+				ThreadPool& pool = ThreadPool::shared());
+
+		// mask는 MSL intersector의 instance mask와 같이 instance.mask & mask가 0이면 건너뛴다.
+		bool intersect(const Ray& ray, InstanceRayHit& hit, float time = 0.0f, uint32_t mask = 0xFF) const;
+		bool occluded(const Ray& ray, float time = 0.0f, uint32_t mask = 0xFF) const;
+		void intersect(const Ray* rays, InstanceRayHit* hits, size_t count, float time = 0.0f, ThreadPool& pool = ThreadPool::shared()) const;
+
+		Aabb bounds() const { return _bounds; }
+		size_t numberOfNodes() const { return _nodes.size(); }
+		size_t numberOfInstances() const { return _instances.size(); }
+
+	private:
+		// BVH 순서로 둔 instance
+		struct Instance {
+			uint32_t index;
+			uint32_t structure;
+			uint32_t mask;
+			uint32_t transformCount;
+			// transformCount == 1이면 _worldToObject[index]를, 아니면 _transforms[firstTransform..]를 보간해서 쓴다.
+			uint32_t firstTransform;
+			MotionBorderMode startBorderMode, endBorderMode;
+			float startTime, endTime;
+		};
+
+		bool loadInstances(const InstanceDescriptor* instances, const MotionInstanceDescriptor* motionInstances, size_t count,
+				const PackedFloat4x3* motionTransforms, ThreadPool& pool);
+		BvhDetail::Box instanceBox(const Instance& instance) const;
+		// _instances를 BVH 순서로 바꾸며 tree를 만든다.
+		void buildNodes(BvhBuildMode mode, ThreadPool& pool);
+		// leaf bounds를 instanceBox로 다시 채운다.
+		void refitNodes(ThreadPool& pool);
+		template <bool AnyHit>
+		bool traverse(const Ray& ray, InstanceRayHit& hit, float time, uint32_t mask) const;
+
+		std::vector<BvhNode4> _nodes;
+		std::vector<Instance> _instances;
+		// object -> world keyframe 행렬. 정지한 instance는 하나, motion instance는 motionTransformsCount개
+		std::vector<Float4x4> _transforms;
+		// 정지한 instance의 world -> object 행렬 (원래 instance 번호 순서)
+		std::vector<Float4x4> _worldToObject;
+		std::vector<const Bvh*> _structures;
+		Aabb _bounds{};
+};
+
+#pragma region InstanceBvhBuild {
+
+namespace InstanceBvhDetail {
+
+// 변환한 box의 bounds (Arvo). 꼭짓점 8개를 변환하는 것과 같은 결과를 행렬 원소의 절댓값으로 계산한다.
+inline BvhDetail::Box transformBox(const Float4x4& m, const Aabb& box)
+{
+	Float3 center = (unpack(box.min) + unpack(box.max)) * 0.5f;
+	Float3 half = (unpack(box.max) - unpack(box.min)) * 0.5f;
+	Float3 c = transformPoint(m, center);
+	Float3 e = {
+		std::fabs(m.columns[0].x) * half.x + std::fabs(m.columns[1].x) * half.y + std::fabs(m.columns[2].x) * half.z,
+		std::fabs(m.columns[0].y) * half.x + std::fabs(m.columns[1].y) * half.y + std::fabs(m.columns[2].y) * half.z,
+		std::fabs(m.columns[0].z) * half.x + std::fabs(m.columns[1].z) * half.y + std::fabs(m.columns[2].z) * half.z,
+	};
+	return { c - e, c + e };
+}
+
+inline Float4x4 lerp(const Float4x4& a, const Float4x4& b, float t)
+{
+	Float4x4 m;
+	for (int c = 0; c < 4; ++c) {
+		m.columns[c] = { a.columns[c].x + (b.columns[c].x - a.columns[c].x) * t, a.columns[c].y + (b.columns[c].y - a.columns[c].y) * t,
+			a.columns[c].z + (b.columns[c].z - a.columns[c].z) * t, a.columns[c].w + (b.columns[c].w - a.columns[c].w) * t };
+	}
+	return m;
+}
+
+} // namespace InstanceBvhDetail
+
+inline bool InstanceBvh::loadInstances(const InstanceDescriptor* instances, const MotionInstanceDescriptor* motionInstances, size_t count,
+		const PackedFloat4x3* motionTransforms, ThreadPool& pool)
+{
+	// motion instance는 keyframe 수가 instance마다 다르므로 시작 위치를 먼저 정한다.
+	std::vector<uint32_t> firstTransforms(count);
+	uint32_t numberOfTransforms = 0;
+	for (size_t i = 0; i < count; ++i) {
+		uint32_t structure = instances ? instances[i].accelerationStructureIndex : motionInstances[i].accelerationStructureIndex;
+		if (structure >= _structures.size() || !_structures[structure]) {
+			std::cerr << "InstanceBvh: instance " << i << " refers to missing acceleration structure " << structure << std::endl;
+			return false;
+		}
+		firstTransforms[i] = numberOfTransforms;
+		numberOfTransforms += instances ? 1 : std::max(1u, motionInstances[i].motionTransformsCount);
+	}
+	_transforms.resize(numberOfTransforms);
+	_worldToObject.resize(count);
+	_instances.resize(count);
+	pool.parallelFor(count, 1 << 12, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			Instance& instance = _instances[i];
+			instance.index = uint32_t(i);
+			instance.firstTransform = firstTransforms[i];
+			if (instances) {
+				const InstanceDescriptor& descriptor = instances[i];
+				instance.structure = descriptor.accelerationStructureIndex;
+				instance.mask = descriptor.mask;
+				instance.transformCount = 1;
+				instance.startBorderMode = instance.endBorderMode = MotionBorderMode::Clamp;
+				instance.startTime = instance.endTime = 0.0f;
+				_transforms[instance.firstTransform] = unpack(descriptor.transformationMatrix);
+			} else {
+				const MotionInstanceDescriptor& descriptor = motionInstances[i];
+				instance.structure = descriptor.accelerationStructureIndex;
+				instance.mask = descriptor.mask;
+				instance.transformCount = std::max(1u, descriptor.motionTransformsCount);
+				instance.startBorderMode = descriptor.motionStartBorderMode;
+				instance.endBorderMode = descriptor.motionEndBorderMode;
+				instance.startTime = descriptor.motionStartTime;
+				instance.endTime = descriptor.motionEndTime;
+				for (uint32_t k = 0; k < instance.transformCount; ++k) {
+					_transforms[instance.firstTransform + k] = descriptor.motionTransformsCount
+						? unpack(motionTransforms[descriptor.motionTransformsStartIndex + k]) : identity4x4();
+				}
+			}
+			_worldToObject[i] = inverseAffine4x4(_transforms[instance.firstTransform]);
+		}
+	});
+	return true;
+}
+
+// 모든 keyframe에서 변환한 bounds의 합. 행렬을 선형 보간해도 변환된 점은 keyframe 점들의 선형 결합이라 이 안에 있다.
+inline BvhDetail::Box InstanceBvh::instanceBox(const Instance& instance) const
+{
+	BvhDetail::Box box;
+	const Aabb local = _structures[instance.structure]->bounds();
+	if (_structures[instance.structure]->numberOfTriangles() == 0) {
+		// 빈 geometry도 build가 centroid를 계산할 수 있게 instance 원점 한 점으로 둔다.
+		box.grow(transformPoint(_transforms[instance.firstTransform], { 0.0f, 0.0f, 0.0f }));
+		return box;
+	}
+	for (uint32_t k = 0; k < instance.transformCount; ++k) {
+		box.grow(InstanceBvhDetail::transformBox(_transforms[instance.firstTransform + k], local));
+	}
+	return box;
+}
+
+inline void InstanceBvh::buildNodes(BvhBuildMode mode, ThreadPool& pool)
+{
+	using namespace BvhDetail;
+	const size_t count = _instances.size();
+	std::vector<Reference> references(count);
+	pool.parallelFor(count, 1 << 12, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			references[i] = { instanceBox(_instances[i]), uint32_t(i) };
+		}
+	});
+	Box root = BvhDetail::buildNodes(references, mode, pool, _nodes);
+	_bounds = { pack(root.min), pack(root.max) };
+
+	std::vector<Instance> ordered(count);
+	for (size_t i = 0; i < count; ++i) {
+		ordered[i] = _instances[references[i].primitive];
+	}
+	_instances.swap(ordered);
+}
+
+inline void InstanceBvh::refitNodes(ThreadPool& pool)
+{
+	using namespace BvhDetail;
+	pool.parallelFor(_nodes.size(), 1024, [&](size_t begin, size_t end) {
+		for (size_t n = begin; n < end; ++n) {
+			BvhNode4& node = _nodes[n];
+			for (int slot = 0; slot < 4; ++slot) {
+				if (node.count[slot] == 0) {
+					continue;
+				}
+				Box box;
+				for (uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; ++i) {
+					box.grow(instanceBox(_instances[i]));
+				}
+				setSlot(node, slot, box, node.child[slot], node.count[slot]);
+			}
+		}
+	});
+	Box root = refitInternalNodes(_nodes);
+	_bounds = { pack(root.min), pack(root.max) };
+}
+
+inline bool InstanceBvh::build(const InstanceDescriptor* instances, size_t count, const std::vector<const Bvh*>& structures,
+		BvhBuildMode mode, ThreadPool& pool)
+{
+	_structures = structures;
+	_nodes.clear();
+	_bounds = {};
+	if (!loadInstances(instances, nullptr, count, nullptr, pool)) {
+		_instances.clear();
+		return false;
+	}
+	buildNodes(mode, pool);
+	return true;
+}
+
+inline bool InstanceBvh::build(const MotionInstanceDescriptor* instances, size_t count, const PackedFloat4x3* motionTransforms,
+		const std::vector<const Bvh*>& structures, BvhBuildMode mode, ThreadPool& pool)
+{
+	_structures = structures;
+	_nodes.clear();
+	_bounds = {};
+	if (!loadInstances(nullptr, instances, count, motionTransforms, pool)) {
+		_instances.clear();
+		return false;
+	}
+	buildNodes(mode, pool);
+	return true;
+}
+
+inline bool InstanceBvh::refit(const InstanceDescriptor* instances, size_t count, ThreadPool& pool)
+{
+	// motion instance로 만든 tree는 행렬 위치가 번호와 다를 수 있으므로 다시 만든다.
+	if (_nodes.empty() || count != _instances.size() || _transforms.size() != count) {
+		return build(instances, count, _structures, BvhBuildMode::Fast, pool);
+	}
+	// BVH 순서는 유지하고 행렬만 원래 번호 자리에 다시 읽는다.
+	pool.parallelFor(count, 1 << 12, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const Instance& instance = _instances[i];
+			const InstanceDescriptor& descriptor = instances[instance.index];
+			_transforms[instance.index] = unpack(descriptor.transformationMatrix);
+			_worldToObject[instance.index] = inverseAffine4x4(_transforms[instance.index]);
+		}
+	});
+	refitNodes(pool);
+	return true;
+}
+
+inline bool InstanceBvh::refit(const MotionInstanceDescriptor* instances, size_t count, const PackedFloat4x3* motionTransforms, ThreadPool& pool)
+{
+	if (_nodes.empty() || count != _instances.size()) {
+		return build(instances, count, motionTransforms, _structures, BvhBuildMode::Fast, pool);
+	}
+	std::vector<Instance> ordered = _instances;
+	if (!loadInstances(nullptr, instances, count, motionTransforms, pool)) {
+		return false;
+	}
+	// loadInstances는 원래 번호 순서로 채우므로 BVH 순서로 되돌린다.
+	for (Instance& instance : ordered) {
+		instance = _instances[instance.index];
+	}
+	_instances.swap(ordered);
+	refitNodes(pool);
+	return true;
+}
+
+#pragma endregion InstanceBvhBuild }
+
+#pragma region InstanceBvhTraversal {
+
+template <bool AnyHit>
+inline bool InstanceBvh::traverse(const Ray& ray, InstanceRayHit& hit, float time, uint32_t mask) const
+{
+	using namespace BvhDetail;
+	hit = { -1.0f, Bvh::kEmpty, Bvh::kEmpty, 0.0f, 0.0f };
+	const Float3 origin = unpack(ray.origin);
+	const Float3 direction = unpack(ray.direction);
+	float tMax = ray.maxDistance;
+	bool found = false;
+	traverseNodes(_nodes, origin, direction, ray.minDistance, tMax, [&](uint32_t first, uint32_t count, float& maxDistance) {
+		for (uint32_t i = first; i < first + count; ++i) {
+			const Instance& instance = _instances[i];
+			if ((instance.mask & mask) == 0) {
+				continue;
+			}
+			Float4x4 worldToObject;
+			if (instance.transformCount == 1) {
+				worldToObject = _worldToObject[instance.index];
+			} else {
+				MotionSample sample = motionSample(time, instance.transformCount, instance.startTime, instance.endTime,
+					instance.startBorderMode, instance.endBorderMode);
+				if (sample.vanished) {
+					continue;
+				}
+				const Float4x4* keyframes = &_transforms[instance.firstTransform + sample.keyframe];
+				worldToObject = inverseAffine4x4(InstanceBvhDetail::lerp(keyframes[0], keyframes[1], sample.fraction));
+			}
+			// direction을 정규화하지 않으므로 object 공간의 distance가 world 공간과 같다.
+			Ray local = { pack(transformPoint(worldToObject, origin)), ray.minDistance,
+				pack(transformDirection(worldToObject, direction)), maxDistance };
+			const Bvh& structure = *_structures[instance.structure];
+			if (AnyHit) {
+				if (structure.occluded(local, time)) {
+					hit.instanceIndex = instance.index;
+					found = true;
+					return true;
+				}
+				continue;
+			}
+			RayHit localHit;
+			if (structure.intersect(local, localHit, time)) {
+				hit = { localHit.distance, localHit.primitiveIndex, instance.index, localHit.u, localHit.v };
+				maxDistance = localHit.distance;
+				found = true;
+			}
+		}
+		return false;
+	});
+	return found;
+}
+
+inline bool InstanceBvh::intersect(const Ray& ray, InstanceRayHit& hit, float time, uint32_t mask) const
+{
+	return traverse<false>(ray, hit, time, mask);
+}
+
+inline bool InstanceBvh::occluded(const Ray& ray, float time, uint32_t mask) const
+{
+	InstanceRayHit hit;
+	return traverse<true>(ray, hit, time, mask);
+}
+
+inline void InstanceBvh::intersect(const Ray* rays, InstanceRayHit* hits, size_t count, float time, ThreadPool& pool) const
+{
+	pool.parallelFor(count, 1024, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			intersect(rays[i], hits[i], time);
+		}
+	});
+}
+
+#pragma endregion InstanceBvhTraversal }
@@ -0,0 +1,352 @@
+/*
+ * Json.hpp
+ *
+ * glTF 같은 asset 파일을 읽기 위한 작은 JSON DOM parser.
+ * 외부 라이브러리 없이 RFC 8259의 모든 값을 읽지만, 파일 크기는 수 MB 수준을 가정한다.
+ * */
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct JsonValue {
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	Type type{Type::Null};
+	bool boolean{false};
+	double number{0.0};
+	std::string string;
+	// Array는 values만, Object는 keys와 values를 같은 순서로 쓴다.
+	std::vector<std::string> keys;
+	std::vector<JsonValue> values;
+
+	bool isNull() const { return type == Type::Null; }
+	bool isNumber() const { return type == Type::Number; }
+	bool isString() const { return type == Type::String; }
+	bool isArray() const { return type == Type::Array; }
+	bool isObject() const { return type == Type::Object; }
+
+	size_t size() const { return values.size(); }
+	// 없는 key나 범위를 벗어난 index는 null 값을 돌려주므로 연달아 접근해도 안전하다.
+	const JsonValue& operator[](const char* key) const;
+	const JsonValue& operator[](size_t index) const;
+	// 0 literal이 const char*와 모호하지 않도록 int도 받는다.
+	const JsonValue& operator[](int index) const { return (*this)[size_t(index)]; }
+	bool contains(const char* key) const { return !(*this)[key].isNull(); }
+
+	double asNumber(double fallback = 0.0) const { return type == Type::Number ? number : fallback; }
+	int64_t asInt(int64_t fallback = 0) const { return type == Type::Number ? int64_t(number) : fallback; }
+	bool asBool(bool fallback = false) const { return type == Type::Bool ? boolean : fallback; }
+	const std::string& asString() const { return string; }
+
+	static const JsonValue& null();
+};
+
+// text를 parsing 해서 out에 넣는다. 실패하면 error에 위치와 이유를 적고 false를 반환한다.
+bool parseJson(const char* text, size_t length, JsonValue& out, std::string& error);
+
+#pragma region JsonValue {
+
+inline const JsonValue& JsonValue::null()
+{
+	static const JsonValue value;
+	return value;
+}
+
+inline const JsonValue& JsonValue::operator[](const char* key) const
+{
+	if (type != Type::Object) {
+		return null();
+	}
+	for (size_t i = 0; i < keys.size(); ++i) {
+		if (keys[i] == key) {
+			return values[i];
+		}
+	}
+	return null();
+}
+
+inline const JsonValue& JsonValue::operator[](size_t index) const
+{
+	return type == Type::Array && index < values.size() ? values[index] : null();
+}
+
+#pragma endregion JsonValue }
+
+#pragma region JsonParser {
+
+namespace JsonDetail {
+
+class Parser {
+	public:
+		Parser(const char* text, size_t length) : _p(text), _begin(text), _end(text + length) {}
+
+		bool parseDocument(JsonValue& out, std::string& error)
+		{
+			bool ok = parseValue(out, 0);
+			skipSpaces();
+			if (ok && _p != _end) {
+				ok = fail("trailing characters");
+			}
+			if (!ok) {
+				error = "JSON error at offset " + std::to_string(_errorOffset) + ": " + _error;
+			}
+			return ok;
+		}
+
+	private:
+		// 악의적인 파일이 stack을 넘치게 하지 않도록 중첩 깊이를 제한한다.
+		static constexpr int kMaxDepth = 256;
+
+		bool fail(const char* message)
+		{
+			if (_error.empty()) {
+				_error = message;
+				_errorOffset = size_t(_p - _begin);
+			}
+			return false;
+		}
+
+		void skipSpaces()
+		{
+			while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r')) {
+				++_p;
+			}
+		}
+
+		bool consume(const char* word)
+		{
+			size_t length = std::strlen(word);
+			if (size_t(_end - _p) < length || std::memcmp(_p, word, length) != 0) {
+				return fail("invalid literal");
+			}
+			_p += length;
+			return true;
+		}
+
+		bool parseValue(JsonValue& out, int depth)
+		{
+			if (depth > kMaxDepth) {
+				return fail("nesting too deep");
+			}
+			skipSpaces();
+			if (_p == _end) {
+				return fail("unexpected end");
+			}
+			switch (*_p) {
+				case '{': return parseObject(out, depth);
+				case '[': return parseArray(out, depth);
+				case '"': out.type = JsonValue::Type::String; return parseString(out.string);
+				case 't': out.type = JsonValue::Type::Bool; out.boolean = true; return consume("true");
+				case 'f': out.type = JsonValue::Type::Bool; out.boolean = false; return consume("false");
+				case 'n': out.type = JsonValue::Type::Null; return consume("null");
+				default: return parseNumber(out);
+			}
+		}
+
+		bool parseObject(JsonValue& out, int depth)
+		{
+			out.type = JsonValue::Type::Object;
+			++_p;
+			skipSpaces();
+			if (_p < _end && *_p == '}') {
+				++_p;
+				return true;
+			}
+			for (;;) {
+				skipSpaces();
+				if (_p == _end || *_p != '"') {
+					return fail("expected object key");
+				}
+				out.keys.emplace_back();
+				if (!parseString(out.keys.back())) {
+					return false;
+				}
+				skipSpaces();
+				if (_p == _end || *_p != ':') {
+					return fail("expected ':'");
+				}
+				++_p;
+				out.values.emplace_back();
+				if (!parseValue(out.values.back(), depth + 1)) {
+					return false;
+				}
+				skipSpaces();
+				if (_p < _end && *_p == ',') {
+					++_p;
+				} else if (_p < _end && *_p == '}') {
+					++_p;
+					return true;
+				} else {
+					return fail("expected ',' or '}'");
+				}
+			}
+		}
+
+		bool parseArray(JsonValue& out, int depth)
+		{
+			out.type = JsonValue::Type::Array;
+			++_p;
+			skipSpaces();
+			if (_p < _end && *_p == ']') {
+				++_p;
+				return true;
+			}
+			for (;;) {
+				out.values.emplace_back();
+				if (!parseValue(out.values.back(), depth + 1)) {
+					return false;
+				}
+				skipSpaces();
+				if (_p < _end && *_p == ',') {
+					++_p;
+				} else if (_p < _end && *_p == ']') {
+					++_p;
+					return true;
+				} else {
+					return fail("expected ',' or ']'");
+				}
+			}
+		}
+
+		bool parseHex4(uint32_t& code)
+		{
+			if (_end - _p < 4) {
+				return fail("truncated \\u escape");
+			}
+			code = 0;
+			for (int i = 0; i < 4; ++i, ++_p) {
+				char c = *_p;
+				code <<= 4;
+				if (c >= '0' && c <= '9') code |= uint32_t(c - '0');
+				else if (c >= 'a' && c <= 'f') code |= uint32_t(c - 'a' + 10);
+				else if (c >= 'A' && c <= 'F') code |= uint32_t(c - 'A' + 10);
+				else return fail("invalid \\u escape");
+			}
+			return true;
+		}
+
+		static void appendUtf8(std::string& out, uint32_t code)
+		{
+			if (code < 0x80) {
+				out += char(code);
+			} else if (code < 0x800) {
+				out += char(0xC0 | (code >> 6));
+				out += char(0x80 | (code & 0x3F));
+			} else if (code < 0x10000) {
+				out += char(0xE0 | (code >> 12));
+				out += char(0x80 | ((code >> 6) & 0x3F));
+				out += char(0x80 | (code & 0x3F));
+			} else {
+				out += char(0xF0 | (code >> 18));
+				out += char(0x80 | ((code >> 12) & 0x3F));
+				out += char(0x80 | ((code >> 6) & 0x3F));
+				out += char(0x80 | (code & 0x3F));
+			}
+		}
+
+		bool parseString(std::string& out)
+		{
+			++_p;
+			for (;;) {
+				// escape가 없는 구간은 한번에 복사한다.
+				const char* run = _p;
+				while (_p < _end && *_p != '"' && *_p != '\\' && static_cast<unsigned char>(*_p) >= 0x20) {
+					++_p;
+				}
+				out.append(run, _p);
+				if (_p == _end) {
+					return fail("unterminated string");
+				}
+				if (*_p == '"') {
+					++_p;
+					return true;
+				}
+				if (*_p != '\\') {
+					return fail("control character in string");
+				}
+				++_p;
+				if (_p == _end) {
+					return fail("unterminated string");
+				}
+				char escape = *_p++;
+				switch (escape) {
+					case '"': out += '"'; break;
+					case '\\': out += '\\'; break;
+					case '/': out += '/'; break;
+					case 'b': out += '\b'; break;
+					case 'f': out += '\f'; break;
+					case 'n': out += '\n'; break;
+					case 'r': out += '\r'; break;
+					case 't': out += '\t'; break;
+					case 'u': {
+						uint32_t code;
+						if (!parseHex4(code)) {
+							return false;
+						}
+						// UTF-16 surrogate pair
+						if (code >= 0xD800 && code < 0xDC00 && _end - _p >= 6 && _p[0] == '\\' && _p[1] == 'u') {
+							_p += 2;
+							uint32_t low;
+							if (!parseHex4(low)) {
+								return false;
+							}
+							code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+						}
+						appendUtf8(out, code);
+						break;
+					}
+					default:
+						return fail("invalid escape");
+				}
+			}
+		}
+
+		bool parseNumber(JsonValue& out)
+		{
+			const char* start = _p;
+			if (_p < _end && *_p == '-') ++_p;
+			while (_p < _end && ((*_p >= '0' && *_p <= '9') || *_p == '.' || *_p == 'e' || *_p == 'E' || *_p == '+' || *_p == '-')) {
+				++_p;
+			}
+			if (_p == start) {
+				return fail("unexpected character");
+			}
+			// strtod는 null로 끝나는 문자열이 필요하므로 숫자 부분만 복사한다.
+			char digits[64];
+			size_t length = size_t(_p - start);
+			if (length >= sizeof(digits)) {
+				return fail("number too long");
+			}
+			std::memcpy(digits, start, length);
+			digits[length] = '\0';
+			char* parsedEnd = nullptr;
+			out.type = JsonValue::Type::Number;
+			out.number = std::strtod(digits, &parsedEnd);
+			if (parsedEnd != digits + length) {
+				_p = start;
+				return fail("invalid number");
+			}
+			return true;
+		}
+
+		const char* _p;
+		const char* _begin;
+		const char* _end;
+		std::string _error;
+		size_t _errorOffset{0};
+};
+
+} // namespace JsonDetail
+
+inline bool parseJson(const char* text, size_t length, JsonValue& out, std::string& error)
+{
+	out = JsonValue();
+	JsonDetail::Parser parser(text, length);
+	return parser.parseDocument(out, error);
+}
+
+#pragma endregion JsonParser }
@@ -0,0 +1,209 @@
+/*
+ * MathTypes.hpp
+ *
+ * simd/simd.h는 Apple 플랫폼에만 있으므로 Linux에서도 빌드되는 공용 코드는 이 타입들을 쓴다.
+ * Float3는 simd::float3, MSL float3와 같은 16 byte 크기/정렬이라서 MTL::Buffer로 그대로 memcpy 할 수 있다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+struct Float2 {
+	float x, y;
+};
+
+struct alignas(16) Float3 {
+	float x, y, z;
+};
+
+struct alignas(16) Float4 {
+	float x, y, z, w;
+};
+
+// Column-major like simd::float4x4 and MSL float4x4.
+struct Float4x4 {
+	Float4 columns[4];
+};
+
+// MTL::PackedFloat3, MTL::AxisAlignedBoundingBox와 같은 12 / 24 byte 배치 (acceleration structure용)
+struct PackedFloat3 {
+	float x, y, z;
+};
+
+struct Aabb {
+	PackedFloat3 min;
+	PackedFloat3 max;
+};
+
+// MTL::PackedFloat4x3. 마지막 행(0, 0, 0, 1)을 뺀 column-major affine 변환 (instance transform용)
+struct PackedFloat4x3 {
+	PackedFloat3 columns[4];
+};
+
+static_assert(sizeof(Float3) == 16, "Float3 must match the simd::float3 layout");
+static_assert(sizeof(Float4x4) == 64, "Float4x4 must match the simd::float4x4 layout");
+static_assert(sizeof(PackedFloat3) == 12 && sizeof(Aabb) == 24, "Aabb must match MTL::AxisAlignedBoundingBox");
+static_assert(sizeof(PackedFloat4x3) == 48, "PackedFloat4x3 must match MTL::PackedFloat4x3");
+
+inline Float3 unpack(PackedFloat3 p) { return { p.x, p.y, p.z }; }
+inline PackedFloat3 pack(Float3 p) { return { p.x, p.y, p.z }; }
+
+#pragma region Float3 operators {
+
+inline Float3 operator+(Float3 a, Float3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Float3 operator-(Float3 a, Float3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Float3 operator*(Float3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+inline Float3 operator*(float s, Float3 a) { return a * s; }
+inline Float3& operator+=(Float3& a, Float3 b) { a = a + b; return a; }
+
+inline float dot(Float3 a, Float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Float3 cross(Float3 a, Float3 b)
+{
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+inline float length(Float3 a) { return std::sqrt(dot(a, a)); }
+inline Float3 normalize(Float3 a)
+{
+	float len = length(a);
+	return len > 0.0f ? a * (1.0f / len) : Float3{ 0.0f, 0.0f, 0.0f };
+}
+inline Float3 min(Float3 a, Float3 b) { return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) }; }
+inline Float3 max(Float3 a, Float3 b) { return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) }; }
+
+#pragma endregion Float3 operators }
+
+#pragma region Float4x4 {
+
+inline Float4x4 identity4x4()
+{
+	return { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } };
+}
+
+inline Float4 operator*(const Float4x4& m, Float4 v)
+{
+	const Float4* c = m.columns;
+	return { c[0].x * v.x + c[1].x * v.y + c[2].x * v.z + c[3].x * v.w,
+		c[0].y * v.x + c[1].y * v.y + c[2].y * v.z + c[3].y * v.w,
+		c[0].z * v.x + c[1].z * v.y + c[2].z * v.z + c[3].z * v.w,
+		c[0].w * v.x + c[1].w * v.y + c[2].w * v.z + c[3].w * v.w };
+}
+
+inline Float4x4 operator*(const Float4x4& a, const Float4x4& b)
+{
+	return { { a * b.columns[0], a * b.columns[1], a * b.columns[2], a * b.columns[3] } };
+}
+
+inline Float3 transformPoint(const Float4x4& m, Float3 p)
+{
+	Float4 r = m * Float4{ p.x, p.y, p.z, 1.0f };
+	return { r.x, r.y, r.z };
+}
+
+inline Float3 transformDirection(const Float4x4& m, Float3 d)
+{
+	Float4 r = m * Float4{ d.x, d.y, d.z, 0.0f };
+	return { r.x, r.y, r.z };
+}
+
+inline Float4x4 translation4x4(Float3 t)
+{
+	Float4x4 m = identity4x4();
+	m.columns[3] = { t.x, t.y, t.z, 1.0f };
+	return m;
+}
+
+inline Float4x4 scale4x4(Float3 s)
+{
+	return { { { s.x, 0, 0, 0 }, { 0, s.y, 0, 0 }, { 0, 0, s.z, 0 }, { 0, 0, 0, 1 } } };
+}
+
+// Rotation from a unit quaternion (x, y, z, w).
+inline Float4x4 rotation4x4(Float4 q)
+{
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	return { { { 1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0 },
+		{ 2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0 },
+		{ 2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0 },
+		{ 0, 0, 0, 1 } } };
+}
+
+inline Float4x4 unpack(const PackedFloat4x3& m)
+{
+	const PackedFloat3* c = m.columns;
+	return { { { c[0].x, c[0].y, c[0].z, 0 }, { c[1].x, c[1].y, c[1].z, 0 }, { c[2].x, c[2].y, c[2].z, 0 }, { c[3].x, c[3].y, c[3].z, 1 } } };
+}
+
+inline PackedFloat4x3 pack(const Float4x4& m)
+{
+	const Float4* c = m.columns;
+	return { { { c[0].x, c[0].y, c[0].z }, { c[1].x, c[1].y, c[1].z }, { c[2].x, c[2].y, c[2].z }, { c[3].x, c[3].y, c[3].z } } };
+}
+
+// Inverse of an affine matrix (last row 0, 0, 0, 1). A singular 3x3 part gives a zero matrix.
+inline Float4x4 inverseAffine4x4(const Float4x4& m)
+{
+	Float3 a = { m.columns[0].x, m.columns[0].y, m.columns[0].z };
+	Float3 b = { m.columns[1].x, m.columns[1].y, m.columns[1].z };
+	Float3 c = { m.columns[2].x, m.columns[2].y, m.columns[2].z };
+	Float3 t = { m.columns[3].x, m.columns[3].y, m.columns[3].z };
+	// 역행렬의 행은 열끼리의 외적 / 행렬식
+	Float3 r0 = cross(b, c), r1 = cross(c, a), r2 = cross(a, b);
+	float determinant = dot(a, r0);
+	float s = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+	r0 = r0 * s; r1 = r1 * s; r2 = r2 * s;
+	return { { { r0.x, r1.x, r2.x, 0 }, { r0.y, r1.y, r2.y, 0 }, { r0.z, r1.z, r2.z, 0 },
+		{ -dot(r0, t), -dot(r1, t), -dot(r2, t), 1 } } };
+}
+
+/*
+ * Right-handed view matrix (camera looks down -Z), same convention as glTF.
+ * */
+inline Float4x4 lookAt4x4(Float3 eye, Float3 target, Float3 up)
+{
+	Float3 z = normalize(eye - target);
+	Float3 x = normalize(cross(up, z));
+	Float3 y = cross(z, x);
+	return { { { x.x, y.x, z.x, 0 }, { x.y, y.y, z.y, 0 }, { x.z, y.z, z.z, 0 },
+		{ -dot(x, eye), -dot(y, eye), -dot(z, eye), 1 } } };
+}
+
+// Right-handed perspective projection into Metal clip space (depth in [0, 1]).
+inline Float4x4 perspective4x4(float fovyRadians, float aspect, float nearZ, float farZ)
+{
+	float ys = 1.0f / std::tan(fovyRadians * 0.5f);
+	float xs = ys / aspect;
+	float zs = farZ / (nearZ - farZ);
+	return { { { xs, 0, 0, 0 }, { 0, ys, 0, 0 }, { 0, 0, zs, -1 }, { 0, 0, nearZ * zs, 0 } } };
+}
+
+/*
+ * Clip volume의 6개 평면 (left, right, bottom, top, near, far).
+ * 각 평면은 (normal, d)이고 dot(normal, p) + d >= 0 이면 안쪽이다. normal은 정규화되어 있다.
+ * */
+inline void extractFrustumPlanes(const Float4x4& viewProjection, Float4 planes[6])
+{
+	const Float4* c = viewProjection.columns;
+	Float4 row0 = { c[0].x, c[1].x, c[2].x, c[3].x };
+	Float4 row1 = { c[0].y, c[1].y, c[2].y, c[3].y };
+	Float4 row2 = { c[0].z, c[1].z, c[2].z, c[3].z };
+	Float4 row3 = { c[0].w, c[1].w, c[2].w, c[3].w };
+	auto add = [](Float4 a, Float4 b, float s) { return Float4{ a.x + b.x * s, a.y + b.y * s, a.z + b.z * s, a.w + b.w * s }; };
+	planes[0] = add(row3, row0, 1.0f);
+	planes[1] = add(row3, row0, -1.0f);
+	planes[2] = add(row3, row1, 1.0f);
+	planes[3] = add(row3, row1, -1.0f);
+	// Metal의 depth 범위가 [0, 1]이므로 near 평면은 row2 하나로 정해진다.
+	planes[4] = row2;
+	planes[5] = add(row3, row2, -1.0f);
+	for (int i = 0; i < 6; ++i) {
+		float len = length(Float3{ planes[i].x, planes[i].y, planes[i].z });
+		float inv = len > 0.0f ? 1.0f / len : 0.0f;
+		planes[i] = { planes[i].x * inv, planes[i].y * inv, planes[i].z * inv, planes[i].w * inv };
+	}
+}
+
+#pragma endregion Float4x4 }
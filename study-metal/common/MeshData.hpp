@@ -0,0 +1,101 @@
+/*
+ * MeshData.hpp
+ *
+ * GPU에 올리기 전의 CPU쪽 mesh.
+ * 01-primitive의 Mesh(MTL::Buffer 묶음)는 이 데이터를 그대로 복사해서 만든다.
+ * */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MathTypes.hpp"
+#include "ThreadPool.hpp"
+
+struct MeshData {
+	std::vector<Float3> positions;
+	// Optional per-vertex attributes. Either empty or the same size as positions.
+	std::vector<Float3> normals;
+	std::vector<Float3> colors;
+	std::vector<Float2> texcoords;
+	// Triangle list.
+	std::vector<uint32_t> indices;
+
+	size_t numberOfVertices() const { return positions.size(); }
+	size_t numberOfTriangles() const { return indices.size() / 3; }
+
+	void computeBounds(Float3& boundsMin, Float3& boundsMax) const;
+	// Area-weighted vertex normals from the triangle list.
+	void computeVertexNormals();
+	// 색 정보가 없는 mesh도 형태가 보이도록 normal을 색으로 쓴다.
+	void computeColorsFromNormals();
+	/*
+	 * 아직 카메라가 없으므로 mesh를 clip space 안으로 옮긴다.
+	 * 비율을 유지한 채 x, y는 [-0.5, 0.5], z는 [0, 1] 범위에 들어간다.
+	 * */
+	void fitToClipVolume();
+};
+
+#pragma region MeshData {
+
+inline void MeshData::computeBounds(Float3& boundsMin, Float3& boundsMax) const
+{
+	boundsMin = { INFINITY, INFINITY, INFINITY };
+	boundsMax = { -INFINITY, -INFINITY, -INFINITY };
+	for (const Float3& p : positions) {
+		boundsMin = min(boundsMin, p);
+		boundsMax = max(boundsMax, p);
+	}
+}
+
+inline void MeshData::computeVertexNormals()
+{
+	normals.assign(positions.size(), Float3{ 0.0f, 0.0f, 0.0f });
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		// cross product의 길이가 삼각형 넓이의 2배이므로 정규화하지 않고 더하면 넓이 가중치가 된다.
+		Float3 n = cross(positions[b] - positions[a], positions[c] - positions[a]);
+		normals[a] += n;
+		normals[b] += n;
+		normals[c] += n;
+	}
+	ThreadPool::shared().parallelFor(normals.size(), 1 << 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			normals[i] = normalize(normals[i]);
+		}
+	});
+}
+
+inline void MeshData::computeColorsFromNormals()
+{
+	if (normals.size() != positions.size()) {
+		computeVertexNormals();
+	}
+	colors.resize(normals.size());
+	ThreadPool::shared().parallelFor(normals.size(), 1 << 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			colors[i] = normals[i] * 0.5f + Float3{ 0.5f, 0.5f, 0.5f };
+		}
+	});
+}
+
+inline void MeshData::fitToClipVolume()
+{
+	if (positions.empty()) {
+		return;
+	}
+	Float3 boundsMin, boundsMax;
+	computeBounds(boundsMin, boundsMax);
+	Float3 center = (boundsMin + boundsMax) * 0.5f;
+	Float3 extent = boundsMax - boundsMin;
+	float largest = std::max(extent.x, std::max(extent.y, extent.z));
+	float scale = largest > 0.0f ? 1.0f / largest : 1.0f;
+	ThreadPool::shared().parallelFor(positions.size(), 1 << 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			Float3 p = (positions[i] - center) * scale;
+			positions[i] = { p.x, p.y, p.z + 0.5f };
+		}
+	});
+}
+
+#pragma endregion MeshData }
@@ -0,0 +1,1263 @@
+/*
+ * MeshImporter.hpp
+ *
+ * OBJ, PLY(ascii / binary) 파일을 읽어 MeshData를 만든다.
+ * 수천만 개 삼각형 규모의 scan mesh를 다루기 위해
+ *  - 파일을 줄 단위 경계에 맞춘 chunk로 나누어 ThreadPool에서 병렬로 parsing 하고
+ *  - 숫자는 8자리씩 한번에 읽는 SWAR(SIMD within a register) parser로 변환하며
+ *  - 중복 vertex는 hash로 찾아 shard 별로 병렬로 합친다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "MeshData.hpp"
+#include "ThreadPool.hpp"
+
+// 파일 확장자(.obj / .ply)를 보고 알맞은 importer를 고른다. 실패하면 이유를 출력하고 false를 반환한다.
+bool importMesh(const char* path, MeshData& mesh, ThreadPool& pool = ThreadPool::shared());
+bool importObj(const char* path, MeshData& mesh, ThreadPool& pool = ThreadPool::shared());
+bool importPly(const char* path, MeshData& mesh, ThreadPool& pool = ThreadPool::shared());
+
+/*
+ * 같은 key를 가진 item들에 같은 id를 준다. hash(i)는 64bit hash, equal(i, j)는 두 item이 같은지 비교한다.
+ * remap[i]는 item i의 새 id, representatives[id]는 그 id를 대표하는 item 번호가 된다.
+ * */
+template <class Hash, class Equal>
+void deduplicate(size_t count, Hash hash, Equal equal,
+		std::vector<uint32_t>& remap, std::vector<uint32_t>& representatives, ThreadPool& pool);
+
+// Welds vertices whose attributes are bitwise identical and rewrites the index buffer.
+void deduplicateVertices(MeshData& mesh, ThreadPool& pool = ThreadPool::shared());
+
+#pragma region FastParse {
+
+namespace MeshImporterDetail {
+
+// File contents followed by zero padding, so the SWAR parser may read 8 bytes past the end.
+constexpr size_t kReadPadding = 16;
+
+inline bool readFile(const char* path, std::vector<char>& bytes, size_t& size)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		std::cerr << "File not found: " << path << std::endl;
+		return false;
+	}
+	size = size_t(file.tellg());
+	bytes.assign(size + kReadPadding, '\0');
+	file.seekg(0);
+	file.read(bytes.data(), std::streamsize(size));
+	if (size_t(file.gcount()) != size) {
+		std::cerr << "Failed to read: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+inline bool isDigit(char c) { return unsigned(c - '0') < 10; }
+
+inline const char* skipSpaces(const char* p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\r') {
+		++p;
+	}
+	return p;
+}
+
+inline const char* skipLine(const char* p, const char* end)
+{
+	const char* newline = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+	return newline ? newline + 1 : end;
+}
+
+// p부터 8 byte가 모두 '0'~'9'인지 한번에 검사한다.
+inline bool isEightDigits(uint64_t chunk)
+{
+	return ((chunk & 0xF0F0F0F0F0F0F0F0ull) |
+			(((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+// Converts 8 ASCII digits (little endian load) to their integer value with three multiplies.
+inline uint32_t parseEightDigits(uint64_t chunk)
+{
+	chunk -= 0x3030303030303030ull;
+	chunk = (chunk * 10) + (chunk >> 8);
+	chunk = (((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+			(((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+	return uint32_t(chunk);
+}
+
+// Accumulates a run of digits into mantissa. Returns the number of digits consumed.
+inline int parseDigits(const char*& p, uint64_t& mantissa, int& droppedDigits)
+{
+	const char* start = p;
+	for (;;) {
+		uint64_t chunk;
+		std::memcpy(&chunk, p, sizeof(chunk));
+		if (!isEightDigits(chunk) || mantissa >= 100000000000ull) {
+			break;
+		}
+		mantissa = mantissa * 100000000ull + parseEightDigits(chunk);
+		p += 8;
+	}
+	while (isDigit(*p)) {
+		// 19자리를 넘는 숫자는 float 정밀도에 영향이 없으므로 버리고 자릿수만 기억한다.
+		if (mantissa < 1000000000000000000ull) {
+			mantissa = mantissa * 10 + uint64_t(*p - '0');
+		} else {
+			++droppedDigits;
+		}
+		++p;
+	}
+	return int(p - start);
+}
+
+/*
+ * 공백을 건너뛰고 실수 하나를 읽는다. 숫자가 없으면 false를 반환하고 p는 그대로 둔다.
+ * 가수가 2^53 이하이고 10의 지수가 22 이하이면(대부분의 mesh 파일) 정확한 double 연산 한번으로 끝나고,
+ * 나머지 경우는 strtod로 넘긴다.
+ * */
+inline bool parseReal(const char*& p, double& out)
+{
+	static const double kPowersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	const char* start = skipSpaces(p);
+	const char* q = start;
+	bool negative = false;
+	if (*q == '-' || *q == '+') {
+		negative = *q == '-';
+		++q;
+	}
+	uint64_t mantissa = 0;
+	int droppedDigits = 0;
+	int integerDigits = parseDigits(q, mantissa, droppedDigits);
+	int exponent = droppedDigits;
+	int fractionDigits = 0;
+	if (*q == '.') {
+		++q;
+		int ignored = 0;
+		fractionDigits = parseDigits(q, mantissa, ignored);
+		exponent -= fractionDigits - ignored;
+	}
+	if (integerDigits + fractionDigits == 0) {
+		// "nan", "inf" 같은 표기만 strtod에 맡긴다. strtod는 줄바꿈도 건너뛰므로 다른 글자는 바로 실패 처리한다.
+		if (std::tolower(static_cast<unsigned char>(*q)) != 'n' && std::tolower(static_cast<unsigned char>(*q)) != 'i') {
+			return false;
+		}
+		char* parsedEnd = nullptr;
+		out = std::strtod(start, &parsedEnd);
+		if (parsedEnd == start) {
+			return false;
+		}
+		p = parsedEnd;
+		return true;
+	}
+	if (*q == 'e' || *q == 'E') {
+		const char* e = q + 1;
+		bool negativeExponent = false;
+		if (*e == '-' || *e == '+') {
+			negativeExponent = *e == '-';
+			++e;
+		}
+		if (isDigit(*e)) {
+			int value = 0;
+			while (isDigit(*e)) {
+				value = value < 10000 ? value * 10 + (*e - '0') : value;
+				++e;
+			}
+			exponent += negativeExponent ? -value : value;
+			q = e;
+		}
+	}
+	if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+		double value = double(mantissa);
+		value = exponent < 0 ? value / kPowersOfTen[-exponent] : value * kPowersOfTen[exponent];
+		out = negative ? -value : value;
+		p = q;
+		return true;
+	}
+	char* parsedEnd = nullptr;
+	out = std::strtod(start, &parsedEnd);
+	p = parsedEnd;
+	return true;
+}
+
+inline bool parseFloat(const char*& p, float& out)
+{
+	double value;
+	if (!parseReal(p, value)) {
+		return false;
+	}
+	out = float(value);
+	return true;
+}
+
+inline bool parseInt(const char*& p, int64_t& out)
+{
+	const char* q = skipSpaces(p);
+	bool negative = false;
+	if (*q == '-' || *q == '+') {
+		negative = *q == '-';
+		++q;
+	}
+	uint64_t value = 0;
+	int droppedDigits = 0;
+	if (parseDigits(q, value, droppedDigits) == 0) {
+		return false;
+	}
+	// int64_t로 나타낼 수 없는 값은 끝 값으로 잘라 둔다. 범위 확인은 호출하는 쪽에서 한다.
+	if (droppedDigits > 0 || value > uint64_t(INT64_MAX)) {
+		value = uint64_t(INT64_MAX);
+	}
+	out = negative ? -int64_t(value) : int64_t(value);
+	p = q;
+	return true;
+}
+
+inline uint64_t hashCombine(uint64_t seed, uint64_t value)
+{
+	// splitmix64 finalizer
+	value += seed + 0x9E3779B97F4A7C15ull;
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+/*
+ * 파일을 대략 같은 크기의 chunk로 자르되 경계는 항상 줄의 시작에 오도록 맞춘다.
+ * 결과는 chunk 시작 offset들이며 마지막 원소는 size이다.
+ * */
+inline std::vector<size_t> splitLines(const char* data, size_t begin, size_t size, size_t numberOfChunks)
+{
+	std::vector<size_t> bounds{ begin };
+	size_t chunkSize = std::max<size_t>((size - begin) / std::max<size_t>(numberOfChunks, 1), 1);
+	for (size_t i = 1; i < numberOfChunks; ++i) {
+		size_t offset = std::max(bounds.back(), begin + i * chunkSize);
+		if (offset >= size) {
+			break;
+		}
+		offset = size_t(skipLine(data + offset, data + size) - data);
+		if (offset >= size) {
+			break;
+		}
+		if (offset > bounds.back()) {
+			bounds.push_back(offset);
+		}
+	}
+	bounds.push_back(size);
+	return bounds;
+}
+
+inline size_t chunkCountFor(size_t bytes, ThreadPool& pool)
+{
+	// 너무 작게 자르면 chunk마다 vector를 만드는 비용이 커지므로 최소 1MB 단위로 나눈다.
+	size_t bySize = bytes / (1 << 20) + 1;
+	return std::min<size_t>(bySize, size_t(pool.size()) * 4);
+}
+
+} // namespace MeshImporterDetail
+
+#pragma endregion FastParse }
+
+#pragma region Deduplicate {
+
+template <class Hash, class Equal>
+void deduplicate(size_t count, Hash hash, Equal equal,
+		std::vector<uint32_t>& remap, std::vector<uint32_t>& representatives, ThreadPool& pool)
+{
+	const size_t grain = 1 << 16;
+	const size_t numberOfBlocks = (count + grain - 1) / grain;
+	unsigned shardBits = 0;
+	while ((1u << shardBits) < pool.size() * 2 && shardBits < 8) {
+		++shardBits;
+	}
+	const size_t numberOfShards = size_t(1) << shardBits;
+
+	// 1. hash를 계산하면서 block마다 shard 별 item 수를 센다.
+	std::vector<uint64_t> hashes(count);
+	std::vector<uint32_t> blockCounts(numberOfBlocks * numberOfShards, 0);
+	pool.parallelFor(count, grain, [&](size_t begin, size_t end) {
+		uint32_t* counts = &blockCounts[(begin / grain) * numberOfShards];
+		for (size_t i = begin; i < end; ++i) {
+			hashes[i] = hash(i);
+			++counts[shardBits ? hashes[i] >> (64 - shardBits) : 0];
+		}
+	});
+
+	// 2. Counting sort of item ids by shard so that every shard owns a contiguous range.
+	std::vector<size_t> shardBegin(numberOfShards + 1, 0);
+	std::vector<uint32_t> blockOffsets(blockCounts.size());
+	size_t running = 0;
+	for (size_t shard = 0; shard < numberOfShards; ++shard) {
+		shardBegin[shard] = running;
+		for (size_t block = 0; block < numberOfBlocks; ++block) {
+			blockOffsets[block * numberOfShards + shard] = uint32_t(running);
+			running += blockCounts[block * numberOfShards + shard];
+		}
+	}
+	shardBegin[numberOfShards] = running;
+	std::vector<uint32_t> sorted(count);
+	pool.parallelFor(count, grain, [&](size_t begin, size_t end) {
+		uint32_t* offsets = &blockOffsets[(begin / grain) * numberOfShards];
+		for (size_t i = begin; i < end; ++i) {
+			sorted[offsets[shardBits ? hashes[i] >> (64 - shardBits) : 0]++] = uint32_t(i);
+		}
+	});
+
+	// 3. shard마다 독립된 open addressing table로 중복을 찾는다. shard끼리는 겹치는 key가 없다.
+	remap.resize(count);
+	std::vector<std::vector<uint32_t>> shardUnique(numberOfShards);
+	pool.parallelFor(numberOfShards, 1, [&](size_t shardFirst, size_t shardLast) {
+		for (size_t shard = shardFirst; shard < shardLast; ++shard) {
+			size_t first = shardBegin[shard], last = shardBegin[shard + 1];
+			size_t capacity = 16;
+			while (capacity < (last - first) * 2) {
+				capacity <<= 1;
+			}
+			std::vector<uint32_t> table(capacity, UINT32_MAX);
+			std::vector<uint32_t>& unique = shardUnique[shard];
+			for (size_t k = first; k < last; ++k) {
+				uint32_t item = sorted[k];
+				size_t slot = size_t(hashes[item]) & (capacity - 1);
+				for (;;) {
+					uint32_t localId = table[slot];
+					if (localId == UINT32_MAX) {
+						table[slot] = uint32_t(unique.size());
+						remap[item] = uint32_t(unique.size());
+						unique.push_back(item);
+						break;
+					}
+					uint32_t other = unique[localId];
+					if (hashes[other] == hashes[item] && equal(other, item)) {
+						remap[item] = localId;
+						break;
+					}
+					slot = (slot + 1) & (capacity - 1);
+				}
+			}
+		}
+	});
+
+	// 4. shard 별 id를 전체 id로 바꾼다.
+	std::vector<uint32_t> shardBase(numberOfShards + 1, 0);
+	for (size_t shard = 0; shard < numberOfShards; ++shard) {
+		shardBase[shard + 1] = shardBase[shard] + uint32_t(shardUnique[shard].size());
+	}
+	representatives.resize(shardBase[numberOfShards]);
+	pool.parallelFor(numberOfShards, 1, [&](size_t shardFirst, size_t shardLast) {
+		for (size_t shard = shardFirst; shard < shardLast; ++shard) {
+			const std::vector<uint32_t>& unique = shardUnique[shard];
+			std::copy(unique.begin(), unique.end(), representatives.begin() + shardBase[shard]);
+			for (size_t k = shardBegin[shard]; k < shardBegin[shard + 1]; ++k) {
+				remap[sorted[k]] += shardBase[shard];
+			}
+		}
+	});
+}
+
+inline void deduplicateVertices(MeshData& mesh, ThreadPool& pool)
+{
+	using MeshImporterDetail::hashCombine;
+
+	auto bits = [](float value) {
+		uint32_t b;
+		std::memcpy(&b, &value, sizeof(b));
+		return b;
+	};
+	const bool hasNormals = mesh.normals.size() == mesh.positions.size();
+	const bool hasColors = mesh.colors.size() == mesh.positions.size();
+	const bool hasTexcoords = mesh.texcoords.size() == mesh.positions.size();
+	auto hash = [&](size_t i) {
+		const Float3& p = mesh.positions[i];
+		uint64_t h = hashCombine(hashCombine(hashCombine(0, bits(p.x)), bits(p.y)), bits(p.z));
+		if (hasNormals) {
+			h = hashCombine(hashCombine(hashCombine(h, bits(mesh.normals[i].x)), bits(mesh.normals[i].y)), bits(mesh.normals[i].z));
+		}
+		if (hasColors) {
+			h = hashCombine(hashCombine(hashCombine(h, bits(mesh.colors[i].x)), bits(mesh.colors[i].y)), bits(mesh.colors[i].z));
+		}
+		if (hasTexcoords) {
+			h = hashCombine(hashCombine(h, bits(mesh.texcoords[i].x)), bits(mesh.texcoords[i].y));
+		}
+		return h;
+	};
+	auto same3 = [&](const Float3& a, const Float3& b) {
+		return bits(a.x) == bits(b.x) && bits(a.y) == bits(b.y) && bits(a.z) == bits(b.z);
+	};
+	auto equal = [&](size_t a, size_t b) {
+		return same3(mesh.positions[a], mesh.positions[b]) &&
+			(!hasNormals || same3(mesh.normals[a], mesh.normals[b])) &&
+			(!hasColors || same3(mesh.colors[a], mesh.colors[b])) &&
+			(!hasTexcoords || (bits(mesh.texcoords[a].x) == bits(mesh.texcoords[b].x) &&
+				bits(mesh.texcoords[a].y) == bits(mesh.texcoords[b].y)));
+	};
+
+	std::vector<uint32_t> remap, representatives;
+	deduplicate(mesh.positions.size(), hash, equal, remap, representatives, pool);
+	if (representatives.size() == mesh.positions.size()) {
+		return;
+	}
+
+	MeshData welded;
+	welded.positions.resize(representatives.size());
+	if (hasNormals) welded.normals.resize(representatives.size());
+	if (hasColors) welded.colors.resize(representatives.size());
+	if (hasTexcoords) welded.texcoords.resize(representatives.size());
+	pool.parallelFor(representatives.size(), 1 << 16, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v) {
+			uint32_t source = representatives[v];
+			welded.positions[v] = mesh.positions[source];
+			if (hasNormals) welded.normals[v] = mesh.normals[source];
+			if (hasColors) welded.colors[v] = mesh.colors[source];
+			if (hasTexcoords) welded.texcoords[v] = mesh.texcoords[source];
+		}
+	});
+	welded.indices.resize(mesh.indices.size());
+	pool.parallelFor(mesh.indices.size(), 1 << 16, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			welded.indices[i] = remap[mesh.indices[i]];
+		}
+	});
+	mesh = std::move(welded);
+}
+
+#pragma endregion Deduplicate }
+
+#pragma region ObjImporter {
+
+namespace MeshImporterDetail {
+
+// Face corner as v/vt/vn indices, 0-based. -1 means the attribute is absent.
+struct ObjCorner {
+	int32_t position, texcoord, normal;
+};
+
+struct ObjChunk {
+	std::vector<Float3> positions;
+	std::vector<Float3> colors;
+	std::vector<Float3> normals;
+	std::vector<Float2> texcoords;
+	std::vector<ObjCorner> corners;
+	/*
+	 * 음수(상대) index는 chunk 앞에 vertex가 몇 개 있는지 알아야 풀 수 있다.
+	 * chunk 기준 index를 우선 저장하고 corners 안의 위치(corner * 3 + 성분)를 기록해 두었다가 나중에 보정한다.
+	 * */
+	std::vector<uint32_t> relativeFixups;
+	bool malformed{false};
+	// 0이거나 int32_t를 넘는 index가 있었다. 잘못된 줄로 건너뛰지 않고 import 전체를 실패시킨다.
+	bool indexOutOfRange{false};
+};
+
+/*
+ * OBJ index 하나를 0부터 세는 index로 읽는다. 숫자가 없으면 false를 반환한다.
+ * 0이거나 int32_t를 넘는 index는 outOfRange를 세우고 false를 반환한다. 상대 index는 앞 chunk의 vertex를 가리키면 음수가 되고,
+ * 절대 index는 전체 vertex 수를 아직 모르므로 여기서는 int32_t 범위만 보고 나머지는 chunk를 합칠 때 확인한다.
+ * */
+inline bool parseObjIndex(const char*& p, int32_t& index, size_t localCount, bool& relative, bool& outOfRange)
+{
+	int64_t value;
+	if (!parseInt(p, value)) {
+		return false;
+	}
+	relative = value < 0;
+	const int64_t resolved = relative ? int64_t(localCount) + value : value - 1;
+	if (value == 0 || resolved < -int64_t(INT32_MAX) || resolved > int64_t(INT32_MAX)) {
+		outOfRange = true;
+		return false;
+	}
+	index = int32_t(resolved);
+	return true;
+}
+
+inline void parseObjChunk(const char* p, const char* end, ObjChunk& chunk)
+{
+	std::vector<ObjCorner> polygon;
+	while (p < end) {
+		p = skipSpaces(p);
+		if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+			p += 2;
+			Float3 position, color;
+			if (parseFloat(p, position.x) && parseFloat(p, position.y) && parseFloat(p, position.z)) {
+				chunk.positions.push_back(position);
+				// "v x y z r g b" 형식의 vertex color 확장
+				if (parseFloat(p, color.x) && parseFloat(p, color.y) && parseFloat(p, color.z)) {
+					chunk.colors.resize(chunk.positions.size() - 1, Float3{ 1.0f, 1.0f, 1.0f });
+					chunk.colors.push_back(color);
+				}
+			} else {
+				chunk.malformed = true;
+			}
+		} else if (p[0] == 'v' && p[1] == 'n') {
+			p += 2;
+			Float3 normal;
+			if (parseFloat(p, normal.x) && parseFloat(p, normal.y) && parseFloat(p, normal.z)) {
+				chunk.normals.push_back(normal);
+			} else {
+				chunk.malformed = true;
+			}
+		} else if (p[0] == 'v' && p[1] == 't') {
+			p += 2;
+			Float2 texcoord{ 0.0f, 0.0f };
+			if (parseFloat(p, texcoord.x)) {
+				parseFloat(p, texcoord.y);
+				chunk.texcoords.push_back(texcoord);
+			} else {
+				chunk.malformed = true;
+			}
+		} else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			p += 2;
+			polygon.clear();
+			std::vector<uint32_t> fixups;
+			for (;;) {
+				ObjCorner corner{ -1, -1, -1 };
+				bool relative = false;
+				if (!parseObjIndex(p, corner.position, chunk.positions.size(), relative, chunk.indexOutOfRange)) {
+					break;
+				}
+				if (relative) fixups.push_back(uint32_t(polygon.size() * 3 + 0));
+				if (*p == '/') {
+					++p;
+					if (*p != '/') {
+						if (!parseObjIndex(p, corner.texcoord, chunk.texcoords.size(), relative, chunk.indexOutOfRange)) {
+							chunk.malformed = true;
+						} else if (relative) {
+							fixups.push_back(uint32_t(polygon.size() * 3 + 1));
+						}
+					}
+					if (*p == '/') {
+						++p;
+						if (!parseObjIndex(p, corner.normal, chunk.normals.size(), relative, chunk.indexOutOfRange)) {
+							chunk.malformed = true;
+						} else if (relative) {
+							fixups.push_back(uint32_t(polygon.size() * 3 + 2));
+						}
+					}
+				}
+				polygon.push_back(corner);
+			}
+			if (polygon.size() < 3) {
+				chunk.malformed = true;
+			} else {
+				// Fan triangulation. fixup 위치는 polygon 기준이므로 삼각형으로 펼칠 때 다시 계산한다.
+				for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+					const size_t triangleCorners[3] = { 0, i, i + 1 };
+					for (size_t k = 0; k < 3; ++k) {
+						size_t source = triangleCorners[k];
+						for (uint32_t fixup : fixups) {
+							if (fixup / 3 == source) {
+								chunk.relativeFixups.push_back(uint32_t(chunk.corners.size() * 3 + fixup % 3));
+							}
+						}
+						chunk.corners.push_back(polygon[source]);
+					}
+				}
+			}
+		}
+		// 주석, 그룹, 재질 등 나머지 줄은 무시한다.
+		p = skipLine(p, end);
+	}
+}
+
+} // namespace MeshImporterDetail
+
+inline bool importObj(const char* path, MeshData& mesh, ThreadPool& pool)
+{
+	using namespace MeshImporterDetail;
+
+	std::vector<char> bytes;
+	size_t size = 0;
+	if (!readFile(path, bytes, size)) {
+		return false;
+	}
+	const char* data = bytes.data();
+
+	// 1. chunk 별로 병렬 parsing
+	std::vector<size_t> bounds = splitLines(data, 0, size, chunkCountFor(size, pool));
+	const size_t numberOfChunks = bounds.size() - 1;
+	std::vector<ObjChunk> chunks(numberOfChunks);
+	pool.parallelFor(numberOfChunks, 1, [&](size_t first, size_t last) {
+		for (size_t c = first; c < last; ++c) {
+			parseObjChunk(data + bounds[c], data + bounds[c + 1], chunks[c]);
+		}
+	});
+
+	// 2. chunk 마다 앞쪽에 있는 attribute 수를 누적해서 상대 index를 절대 index로 바꾼다.
+	struct Bases { size_t positions, normals, texcoords, corners; };
+	std::vector<Bases> bases(numberOfChunks + 1, Bases{ 0, 0, 0, 0 });
+	bool hasColors = false;
+	for (size_t c = 0; c < numberOfChunks; ++c) {
+		if (chunks[c].indexOutOfRange) {
+			std::cerr << "Face index out of range in " << path << std::endl;
+			return false;
+		}
+		if (chunks[c].malformed) {
+			std::cerr << "Skipped malformed lines in " << path << std::endl;
+		}
+		hasColors = hasColors || !chunks[c].colors.empty();
+		bases[c + 1] = { bases[c].positions + chunks[c].positions.size(),
+			bases[c].normals + chunks[c].normals.size(),
+			bases[c].texcoords + chunks[c].texcoords.size(),
+			bases[c].corners + chunks[c].corners.size() };
+	}
+	const Bases totals = bases[numberOfChunks];
+	if (totals.positions == 0 || totals.corners == 0) {
+		std::cerr << "No triangles in " << path << std::endl;
+		return false;
+	}
+
+	std::vector<Float3> positions(totals.positions), normals(totals.normals), colors;
+	std::vector<Float2> texcoords(totals.texcoords);
+	std::vector<ObjCorner> corners(totals.corners);
+	if (hasColors) {
+		colors.resize(totals.positions);
+	}
+	std::atomic<bool> outOfRange{false};
+	std::atomic<bool> usesAttributes{false};
+	pool.parallelFor(numberOfChunks, 1, [&](size_t first, size_t last) {
+		for (size_t c = first; c < last; ++c) {
+			ObjChunk& chunk = chunks[c];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + bases[c].positions);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + bases[c].normals);
+			std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + bases[c].texcoords);
+			if (hasColors) {
+				chunk.colors.resize(chunk.positions.size(), Float3{ 1.0f, 1.0f, 1.0f });
+				std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + bases[c].positions);
+			}
+			bool attributes = false, bad = false;
+			for (uint32_t fixup : chunk.relativeFixups) {
+				int32_t* component = &chunk.corners[fixup / 3].position + fixup % 3;
+				size_t base = fixup % 3 == 0 ? bases[c].positions : fixup % 3 == 1 ? bases[c].texcoords : bases[c].normals;
+				const int64_t resolved = int64_t(*component) + int64_t(base);
+				if (resolved < 0 || resolved > int64_t(INT32_MAX)) {
+					bad = true;
+				} else {
+					*component = int32_t(resolved);
+				}
+			}
+			for (const ObjCorner& corner : chunk.corners) {
+				bad = bad || corner.position < 0 || size_t(corner.position) >= totals.positions ||
+					size_t(corner.texcoord + 1) > totals.texcoords || size_t(corner.normal + 1) > totals.normals;
+				attributes = attributes || corner.texcoord >= 0 || corner.normal >= 0;
+			}
+			std::copy(chunk.corners.begin(), chunk.corners.end(), corners.begin() + bases[c].corners);
+			chunk = ObjChunk();
+			if (bad) outOfRange = true;
+			if (attributes) usesAttributes = true;
+		}
+	});
+	if (outOfRange) {
+		std::cerr << "Face index out of range in " << path << std::endl;
+		return false;
+	}
+
+	mesh = MeshData();
+	if (!usesAttributes) {
+		// v 만 참조하는 face: 이미 index가 공유되어 있으므로 중복 제거가 필요 없다.
+		mesh.positions = std::move(positions);
+		mesh.colors = std::move(colors);
+		mesh.indices.resize(corners.size());
+		pool.parallelFor(corners.size(), 1 << 16, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				mesh.indices[i] = uint32_t(corners[i].position);
+			}
+		});
+		return true;
+	}
+
+	// 3. v/vt/vn 조합이 같은 corner를 하나의 vertex로 합친다.
+	std::vector<uint32_t> remap, representatives;
+	deduplicate(corners.size(),
+		[&](size_t i) {
+			const ObjCorner& k = corners[i];
+			return hashCombine(hashCombine(hashCombine(0, uint32_t(k.position)), uint32_t(k.texcoord)), uint32_t(k.normal));
+		},
+		[&](size_t a, size_t b) {
+			return corners[a].position == corners[b].position &&
+				corners[a].texcoord == corners[b].texcoord && corners[a].normal == corners[b].normal;
+		},
+		remap, representatives, pool);
+
+	const bool hasNormals = !normals.empty();
+	const bool hasTexcoords = !texcoords.empty();
+	const size_t numberOfVertices = representatives.size();
+	mesh.positions.resize(numberOfVertices);
+	if (hasNormals) mesh.normals.resize(numberOfVertices);
+	if (hasTexcoords) mesh.texcoords.resize(numberOfVertices);
+	if (hasColors) mesh.colors.resize(numberOfVertices);
+	pool.parallelFor(numberOfVertices, 1 << 16, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v) {
+			const ObjCorner& corner = corners[representatives[v]];
+			mesh.positions[v] = positions[corner.position];
+			if (hasNormals) mesh.normals[v] = corner.normal >= 0 ? normals[corner.normal] : Float3{ 0.0f, 0.0f, 0.0f };
+			if (hasTexcoords) mesh.texcoords[v] = corner.texcoord >= 0 ? texcoords[corner.texcoord] : Float2{ 0.0f, 0.0f };
+			if (hasColors) mesh.colors[v] = colors[corner.position];
+		}
+	});
+	mesh.indices = std::move(remap);
+	return true;
+}
+
+#pragma endregion ObjImporter }
+
+#pragma region PlyImporter {
+
+namespace MeshImporterDetail {
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+struct PlyProperty {
+	std::string name;
+	PlyType type{PlyType::Invalid};
+	// list 속성이면 type은 원소의 type이고 countType은 개수의 type이다.
+	bool isList{false};
+	PlyType countType{PlyType::Invalid};
+	size_t offset{0};
+};
+
+struct PlyElement {
+	std::string name;
+	size_t count{0};
+	std::vector<PlyProperty> properties;
+	// Byte size of one record in binary files, when no list properties are present.
+	size_t stride{0};
+	bool hasLists{false};
+};
+
+enum class PlyFormat { Ascii, BinaryLittleEndian, BinaryBigEndian };
+
+inline PlyType plyTypeFromName(const std::string& name)
+{
+	if (name == "char" || name == "int8") return PlyType::Int8;
+	if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+	if (name == "short" || name == "int16") return PlyType::Int16;
+	if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+	if (name == "int" || name == "int32") return PlyType::Int32;
+	if (name == "uint" || name == "uint32") return PlyType::UInt32;
+	if (name == "float" || name == "float32") return PlyType::Float32;
+	if (name == "double" || name == "float64") return PlyType::Float64;
+	return PlyType::Invalid;
+}
+
+inline size_t plyTypeSize(PlyType type)
+{
+	switch (type) {
+		case PlyType::Int8: case PlyType::UInt8: return 1;
+		case PlyType::Int16: case PlyType::UInt16: return 2;
+		case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+		case PlyType::Float64: return 8;
+		default: return 0;
+	}
+}
+
+inline bool plyTypeIsInteger(PlyType type)
+{
+	return type != PlyType::Float32 && type != PlyType::Float64;
+}
+
+template <class T>
+inline T loadPly(const char* p, bool swap)
+{
+	unsigned char raw[sizeof(T)];
+	std::memcpy(raw, p, sizeof(T));
+	if (swap) {
+		std::reverse(raw, raw + sizeof(T));
+	}
+	T value;
+	std::memcpy(&value, raw, sizeof(T));
+	return value;
+}
+
+inline double readPlyBinary(const char* p, PlyType type, bool swap)
+{
+	switch (type) {
+		case PlyType::Int8: return double(int8_t(*p));
+		case PlyType::UInt8: return double(uint8_t(*p));
+		case PlyType::Int16: return double(loadPly<int16_t>(p, swap));
+		case PlyType::UInt16: return double(loadPly<uint16_t>(p, swap));
+		case PlyType::Int32: return double(loadPly<int32_t>(p, swap));
+		case PlyType::UInt32: return double(loadPly<uint32_t>(p, swap));
+		case PlyType::Float32: return double(loadPly<float>(p, swap));
+		case PlyType::Float64: return loadPly<double>(p, swap);
+		default: return 0.0;
+	}
+}
+
+// list 길이나 vertex index로 읽은 값을 T로 옮긴다. 음수이거나 T의 범위를 넘거나 정수가 아니면 false.
+template <typename T>
+inline bool plyToUnsigned(double value, T& out)
+{
+	if (!(value >= 0.0 && value < double(std::numeric_limits<T>::max()) + 1.0) || value != double(uint64_t(value))) {
+		return false;
+	}
+	out = T(value);
+	return true;
+}
+
+// vertex element 안에서 MeshData로 옮길 속성들의 위치. 없으면 -1.
+struct PlyVertexLayout {
+	int position[3]{ -1, -1, -1 };
+	int normal[3]{ -1, -1, -1 };
+	int color[3]{ -1, -1, -1 };
+	int texcoord[2]{ -1, -1 };
+	// uchar 색은 [0, 255]이므로 정규화한다.
+	float colorScale{1.0f};
+
+	bool hasNormals() const { return normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0; }
+	bool hasColors() const { return color[0] >= 0 && color[1] >= 0 && color[2] >= 0; }
+	bool hasTexcoords() const { return texcoord[0] >= 0 && texcoord[1] >= 0; }
+};
+
+inline PlyVertexLayout plyVertexLayout(const PlyElement& element)
+{
+	PlyVertexLayout layout;
+	for (size_t i = 0; i < element.properties.size(); ++i) {
+		const std::string& name = element.properties[i].name;
+		int index = int(i);
+		if (name == "x") layout.position[0] = index;
+		else if (name == "y") layout.position[1] = index;
+		else if (name == "z") layout.position[2] = index;
+		else if (name == "nx") layout.normal[0] = index;
+		else if (name == "ny") layout.normal[1] = index;
+		else if (name == "nz") layout.normal[2] = index;
+		else if (name == "red" || name == "r") layout.color[0] = index;
+		else if (name == "green" || name == "g") layout.color[1] = index;
+		else if (name == "blue" || name == "b") layout.color[2] = index;
+		else if (name == "s" || name == "u" || name == "texture_u") layout.texcoord[0] = index;
+		else if (name == "t" || name == "v" || name == "texture_v") layout.texcoord[1] = index;
+	}
+	if (layout.hasColors() && plyTypeIsInteger(element.properties[layout.color[0]].type)) {
+		layout.colorScale = 1.0f / 255.0f;
+	}
+	return layout;
+}
+
+inline void storePlyVertex(const PlyVertexLayout& layout, const double* values, size_t v, MeshData& mesh)
+{
+	mesh.positions[v] = { float(values[layout.position[0]]), float(values[layout.position[1]]), float(values[layout.position[2]]) };
+	if (layout.hasNormals()) {
+		mesh.normals[v] = { float(values[layout.normal[0]]), float(values[layout.normal[1]]), float(values[layout.normal[2]]) };
+	}
+	if (layout.hasColors()) {
+		mesh.colors[v] = Float3{ float(values[layout.color[0]]), float(values[layout.color[1]]), float(values[layout.color[2]]) } * layout.colorScale;
+	}
+	if (layout.hasTexcoords()) {
+		mesh.texcoords[v] = { float(values[layout.texcoord[0]]), float(values[layout.texcoord[1]]) };
+	}
+}
+
+inline bool parsePlyHeader(const char* data, size_t size, PlyFormat& format, std::vector<PlyElement>& elements, size_t& bodyOffset)
+{
+	const char* p = data;
+	const char* end = data + size;
+	if (size < 4 || std::strncmp(p, "ply", 3) != 0) {
+		return false;
+	}
+	p = skipLine(p, end);
+	bool hasFormat = false;
+	while (p < end) {
+		const char* lineEnd = skipLine(p, end);
+		std::string line(p, lineEnd);
+		while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+			line.pop_back();
+		}
+		p = lineEnd;
+		std::vector<std::string> words;
+		size_t position = 0;
+		while (position < line.size()) {
+			size_t wordStart = line.find_first_not_of(" \t", position);
+			if (wordStart == std::string::npos) break;
+			size_t wordEnd = line.find_first_of(" \t", wordStart);
+			if (wordEnd == std::string::npos) wordEnd = line.size();
+			words.push_back(line.substr(wordStart, wordEnd - wordStart));
+			position = wordEnd;
+		}
+		if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+			continue;
+		}
+		if (words[0] == "end_header") {
+			bodyOffset = size_t(p - data);
+			return hasFormat;
+		}
+		if (words[0] == "format" && words.size() >= 2) {
+			hasFormat = true;
+			if (words[1] == "ascii") format = PlyFormat::Ascii;
+			else if (words[1] == "binary_little_endian") format = PlyFormat::BinaryLittleEndian;
+			else if (words[1] == "binary_big_endian") format = PlyFormat::BinaryBigEndian;
+			else return false;
+		} else if (words[0] == "element" && words.size() >= 3) {
+			PlyElement element;
+			element.name = words[1];
+			element.count = size_t(std::strtoull(words[2].c_str(), nullptr, 10));
+			elements.push_back(element);
+		} else if (words[0] == "property" && !elements.empty()) {
+			PlyProperty property;
+			PlyElement& element = elements.back();
+			if (words.size() >= 5 && words[1] == "list") {
+				property.isList = true;
+				property.countType = plyTypeFromName(words[2]);
+				property.type = plyTypeFromName(words[3]);
+				property.name = words[4];
+				element.hasLists = true;
+			} else if (words.size() >= 3) {
+				property.type = plyTypeFromName(words[1]);
+				property.name = words[2];
+			}
+			if (property.type == PlyType::Invalid || (property.isList && property.countType == PlyType::Invalid)) {
+				return false;
+			}
+			property.offset = element.stride;
+			element.stride += property.isList ? 0 : plyTypeSize(property.type);
+			element.properties.push_back(property);
+		}
+	}
+	return false;
+}
+
+/*
+ * header의 element 수를 남은 body byte로 담을 수 있는지 본다. 할당하기 전에 불러서 망가진 header가 큰 메모리를 잡지 못하게 한다.
+ * binary record는 list가 비어 있어도 고정 크기 property와 list 길이만큼은 있고, ASCII record는 값 하나와 줄바꿈으로 2 byte 이상이다.
+ * */
+inline bool plyElementsFit(const std::vector<PlyElement>& elements, PlyFormat format, size_t remaining)
+{
+	for (const PlyElement& element : elements) {
+		size_t recordSize = 2;
+		if (format != PlyFormat::Ascii) {
+			recordSize = element.stride;
+			for (const PlyProperty& property : element.properties) {
+				recordSize += property.isList ? plyTypeSize(property.countType) : 0;
+			}
+			recordSize = std::max<size_t>(recordSize, 1);
+		}
+		if (element.count > remaining / recordSize) {
+			return false;
+		}
+		remaining -= element.count * recordSize;
+	}
+	return true;
+}
+
+inline void appendFan(const std::vector<uint32_t>& polygon, std::vector<uint32_t>& indices)
+{
+	for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+		indices.push_back(polygon[0]);
+		indices.push_back(polygon[i]);
+		indices.push_back(polygon[i + 1]);
+	}
+}
+
+/*
+ * Binary body를 element 순서대로 읽는다.
+ * 고정 크기 vertex record와 "모두 삼각형"인 face list는 offset을 바로 계산할 수 있으므로 병렬로 decode 한다.
+ * */
+inline bool parsePlyBinary(const char* data, size_t size, size_t offset, bool swap,
+		const std::vector<PlyElement>& elements, MeshData& mesh, ThreadPool& pool)
+{
+	const char* end = data + size;
+	for (const PlyElement& element : elements) {
+		const bool isVertex = element.name == "vertex";
+		const bool isFace = element.name == "face";
+		if (isVertex && !element.hasLists) {
+			if (element.stride && element.count > (size - offset) / element.stride) {
+				return false;
+			}
+			PlyVertexLayout layout = plyVertexLayout(element);
+			const char* records = data + offset;
+			pool.parallelFor(element.count, 1 << 15, [&](size_t begin, size_t last) {
+				std::vector<double> values(element.properties.size());
+				for (size_t v = begin; v < last; ++v) {
+					const char* record = records + v * element.stride;
+					for (size_t k = 0; k < element.properties.size(); ++k) {
+						values[k] = readPlyBinary(record + element.properties[k].offset, element.properties[k].type, swap);
+					}
+					storePlyVertex(layout, values.data(), v, mesh);
+				}
+			});
+			offset += element.count * element.stride;
+			continue;
+		}
+
+		const PlyProperty* indexList = nullptr;
+		if (isFace) {
+			for (const PlyProperty& property : element.properties) {
+				if (property.isList && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+					indexList = &property;
+				}
+			}
+		}
+		// 빠른 경로: face element가 index list 하나뿐이고 모든 face가 삼각형인 경우
+		if (indexList && element.properties.size() == 1 && element.count > 0) {
+			const size_t countSize = plyTypeSize(indexList->countType);
+			const size_t indexSize = plyTypeSize(indexList->type);
+			const size_t stride = countSize + 3 * indexSize;
+			const char* records = data + offset;
+			std::atomic<bool> allTriangles{element.count <= (size - offset) / stride};
+			if (allTriangles) {
+				pool.parallelFor(element.count, 1 << 16, [&](size_t begin, size_t last) {
+					for (size_t f = begin; f < last && allTriangles; ++f) {
+						if (readPlyBinary(records + f * stride, indexList->countType, swap) != 3.0) {
+							allTriangles = false;
+						}
+					}
+				});
+			}
+			if (allTriangles) {
+				mesh.indices.resize(element.count * 3);
+				std::atomic<bool> badIndex{false};
+				pool.parallelFor(element.count, 1 << 16, [&](size_t begin, size_t last) {
+					for (size_t f = begin; f < last; ++f) {
+						const char* record = records + f * stride + countSize;
+						for (size_t k = 0; k < 3; ++k) {
+							if (!plyToUnsigned(readPlyBinary(record + k * indexSize, indexList->type, swap), mesh.indices[f * 3 + k])) {
+								badIndex = true;
+							}
+						}
+					}
+				});
+				if (badIndex) return false;
+				offset += element.count * stride;
+				continue;
+			}
+		}
+
+		// 일반 경로: record 크기가 가변이므로 순서대로 읽는다.
+		PlyVertexLayout layout = plyVertexLayout(element);
+		std::vector<double> values(element.properties.size());
+		std::vector<uint32_t> polygon;
+		for (size_t r = 0; r < element.count; ++r) {
+			for (size_t k = 0; k < element.properties.size(); ++k) {
+				const PlyProperty& property = element.properties[k];
+				if (!property.isList) {
+					if (data + offset + plyTypeSize(property.type) > end) return false;
+					values[k] = readPlyBinary(data + offset, property.type, swap);
+					offset += plyTypeSize(property.type);
+					continue;
+				}
+				if (data + offset + plyTypeSize(property.countType) > end) return false;
+				size_t count = 0;
+				if (!plyToUnsigned(readPlyBinary(data + offset, property.countType, swap), count)) return false;
+				offset += plyTypeSize(property.countType);
+				// count * 크기가 넘치지 않도록 남은 byte 수를 나누어 비교한다.
+				if (plyTypeSize(property.type) > 0 && count > size_t(end - (data + offset)) / plyTypeSize(property.type)) return false;
+				if (&property == indexList) {
+					polygon.resize(count);
+					for (size_t i = 0; i < count; ++i) {
+						if (!plyToUnsigned(readPlyBinary(data + offset + i * plyTypeSize(property.type), property.type, swap), polygon[i])) {
+							return false;
+						}
+					}
+					appendFan(polygon, mesh.indices);
+				}
+				offset += count * plyTypeSize(property.type);
+			}
+			if (isVertex) {
+				storePlyVertex(layout, values.data(), r, mesh);
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * ASCII body는 한 줄이 record 하나이다.
+ * chunk 별로 줄 수를 먼저 세어 각 chunk의 첫 줄 번호를 구하면, 줄 번호만으로 어떤 element인지 알 수 있으므로
+ * 모든 chunk를 병렬로 parsing 할 수 있다.
+ * */
+inline bool parsePlyAscii(const char* data, size_t size, size_t offset,
+		const std::vector<PlyElement>& elements, MeshData& mesh, ThreadPool& pool)
+{
+	std::vector<size_t> bounds = splitLines(data, offset, size, chunkCountFor(size - offset, pool));
+	const size_t numberOfChunks = bounds.size() - 1;
+	std::vector<size_t> firstLine(numberOfChunks + 1, 0);
+	pool.parallelFor(numberOfChunks, 1, [&](size_t first, size_t last) {
+		for (size_t c = first; c < last; ++c) {
+			size_t lines = 0;
+			for (const char* p = data + bounds[c]; p < data + bounds[c + 1]; p = skipLine(p, data + bounds[c + 1])) {
+				++lines;
+			}
+			firstLine[c + 1] = lines;
+		}
+	});
+	for (size_t c = 0; c < numberOfChunks; ++c) {
+		firstLine[c + 1] += firstLine[c];
+	}
+
+	std::vector<size_t> elementFirstLine(elements.size() + 1, 0);
+	for (size_t e = 0; e < elements.size(); ++e) {
+		elementFirstLine[e + 1] = elementFirstLine[e] + elements[e].count;
+	}
+	if (firstLine[numberOfChunks] < elementFirstLine[elements.size()]) {
+		return false;
+	}
+
+	std::vector<PlyVertexLayout> layouts;
+	for (const PlyElement& element : elements) {
+		layouts.push_back(plyVertexLayout(element));
+	}
+	std::vector<std::vector<uint32_t>> chunkIndices(numberOfChunks);
+	std::atomic<bool> malformed{false};
+	pool.parallelFor(numberOfChunks, 1, [&](size_t first, size_t last) {
+		std::vector<uint32_t> polygon;
+		std::vector<double> values;
+		for (size_t c = first; c < last; ++c) {
+			size_t line = firstLine[c];
+			size_t e = 0;
+			const char* chunkEnd = data + bounds[c + 1];
+			for (const char* p = data + bounds[c]; p < chunkEnd; p = skipLine(p, chunkEnd), ++line) {
+				while (e < elements.size() && line >= elementFirstLine[e + 1]) {
+					++e;
+				}
+				if (e == elements.size()) {
+					break;
+				}
+				const PlyElement& element = elements[e];
+				const bool isVertex = element.name == "vertex";
+				const bool isFace = element.name == "face";
+				if (!isVertex && !isFace) {
+					continue;
+				}
+				values.assign(element.properties.size(), 0.0);
+				const char* q = p;
+				for (size_t k = 0; k < element.properties.size(); ++k) {
+					const PlyProperty& property = element.properties[k];
+					if (!property.isList) {
+						if (!parseReal(q, values[k])) malformed = true;
+						continue;
+					}
+					int64_t count = 0;
+					if (!parseInt(q, count) || count < 0) {
+						malformed = true;
+						break;
+					}
+					const bool isIndexList = isFace && (property.name == "vertex_indices" || property.name == "vertex_index");
+					polygon.clear();
+					for (int64_t i = 0; i < count; ++i) {
+						int64_t index = 0;
+						double ignored;
+						if (isIndexList ? !parseInt(q, index) : !parseReal(q, ignored)) {
+							malformed = true;
+							break;
+						}
+						if (isIndexList && (index < 0 || index > int64_t(UINT32_MAX))) {
+							malformed = true;
+							break;
+						}
+						if (isIndexList) polygon.push_back(uint32_t(index));
+					}
+					if (isIndexList) appendFan(polygon, chunkIndices[c]);
+				}
+				if (isVertex) {
+					storePlyVertex(layouts[e], values.data(), line - elementFirstLine[e], mesh);
+				}
+			}
+		}
+	});
+	if (malformed) {
+		return false;
+	}
+
+	std::vector<size_t> indexBase(numberOfChunks + 1, 0);
+	for (size_t c = 0; c < numberOfChunks; ++c) {
+		indexBase[c + 1] = indexBase[c] + chunkIndices[c].size();
+	}
+	mesh.indices.resize(indexBase[numberOfChunks]);
+	pool.parallelFor(numberOfChunks, 1, [&](size_t first, size_t last) {
+		for (size_t c = first; c < last; ++c) {
+			std::copy(chunkIndices[c].begin(), chunkIndices[c].end(), mesh.indices.begin() + indexBase[c]);
+		}
+	});
+	return true;
+}
+
+} // namespace MeshImporterDetail
+
+inline bool importPly(const char* path, MeshData& mesh, ThreadPool& pool)
+{
+	using namespace MeshImporterDetail;
+
+	std::vector<char> bytes;
+	size_t size = 0;
+	if (!readFile(path, bytes, size)) {
+		return false;
+	}
+	PlyFormat format = PlyFormat::Ascii;
+	std::vector<PlyElement> elements;
+	size_t bodyOffset = 0;
+	if (!parsePlyHeader(bytes.data(), size, format, elements, bodyOffset)) {
+		std::cerr << "Invalid PLY header: " << path << std::endl;
+		return false;
+	}
+	if (!plyElementsFit(elements, format, size - bodyOffset)) {
+		std::cerr << "PLY element counts exceed the file size: " << path << std::endl;
+		return false;
+	}
+
+	mesh = MeshData();
+	for (const PlyElement& element : elements) {
+		if (element.name != "vertex") {
+			continue;
+		}
+		PlyVertexLayout layout = plyVertexLayout(element);
+		if (layout.position[0] < 0 || layout.position[1] < 0 || layout.position[2] < 0) {
+			std::cerr << "PLY vertex element has no x/y/z: " << path << std::endl;
+			return false;
+		}
+		mesh.positions.resize(element.count);
+		if (layout.hasNormals()) mesh.normals.resize(element.count);
+		if (layout.hasColors()) mesh.colors.resize(element.count);
+		if (layout.hasTexcoords()) mesh.texcoords.resize(element.count);
+	}
+
+	bool parsed = format == PlyFormat::Ascii
+		? parsePlyAscii(bytes.data(), size, bodyOffset, elements, mesh, pool)
+		: parsePlyBinary(bytes.data(), size, bodyOffset, format == PlyFormat::BinaryBigEndian, elements, mesh, pool);
+	if (!parsed) {
+		std::cerr << "Truncated or malformed PLY body: " << path << std::endl;
+		return false;
+	}
+	for (uint32_t index : mesh.indices) {
+		if (index >= mesh.positions.size()) {
+			std::cerr << "Face index out of range in " << path << std::endl;
+			return false;
+		}
+	}
+	if (mesh.indices.empty()) {
+		std::cerr << "No triangles in " << path << std::endl;
+		return false;
+	}
+	// scan 데이터는 같은 점이 여러 번 저장되어 있는 경우가 많다.
+	deduplicateVertices(mesh, pool);
+	return true;
+}
+
+#pragma endregion PlyImporter }
+
+inline bool importMesh(const char* path, MeshData& mesh, ThreadPool& pool)
+{
+	std::string extension = path;
+	size_t dot = extension.find_last_of('.');
+	extension = dot == std::string::npos ? std::string() : extension.substr(dot);
+	for (char& c : extension) {
+		c = char(std::tolower(static_cast<unsigned char>(c)));
+	}
+	if (extension == ".obj") {
+		return importObj(path, mesh, pool);
+	}
+	if (extension == ".ply") {
+		return importPly(path, mesh, pool);
+	}
+	std::cerr << "Unsupported mesh format: " << path << std::endl;
+	return false;
+}
@@ -0,0 +1,594 @@
+/*
+ * Meshlet.hpp
+ *
+ * Indexed mesh를 작은 cluster(meshlet)로 나누고, cluster 단위로 frustum / backface culling을 한다.
+ * 한 meshlet은 최대 64개의 vertex와 124개의 삼각형을 가진다 (mesh shader에서 흔히 쓰는 크기).
+ * 삼각형은 meshlet 안의 local vertex 번호(uint8) 3개로 저장한다.
+ *
+ * buildMeshlets는 load 할 때 바로 돌릴 수 있을 만큼 빠르지만,
+ * saveMeshlets / loadMeshlets로 결과를 파일에 두고 다시 쓸 수도 있다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "MathTypes.hpp"
+#include "MeshData.hpp"
+#include "ThreadPool.hpp"
+
+constexpr uint32_t kMeshletMaxVertices = 64;
+constexpr uint32_t kMeshletMaxTriangles = 124;
+
+// GPU buffer로 그대로 올릴 수 있도록 16 byte 단위로 배치한다. (48 bytes)
+struct Meshlet {
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	// xyz: center, w: radius
+	Float4 boundingSphere;
+	// xyz: 모든 삼각형 normal을 감싸는 cone의 축, w: sin(cone 반각). 1이면 backface culling을 하지 않는다.
+	Float4 normalCone;
+};
+
+static_assert(sizeof(Meshlet) == 48, "Meshlet is uploaded to the GPU as is");
+
+struct MeshletData {
+	std::vector<Meshlet> meshlets;
+	// meshlet.vertexOffset부터 vertexCount개: 원래 mesh의 vertex index
+	std::vector<uint32_t> vertices;
+	// meshlet.triangleOffset부터 triangleCount * 3개: meshlet 안의 local vertex index
+	std::vector<uint8_t> triangles;
+
+	size_t numberOfTriangles() const { return triangles.size() / 3; }
+};
+
+struct MeshletCullParams {
+	Float4 frustumPlanes[6];
+	// 원근 투영이면 cameraPosition, 직교 투영이면 viewDirection(카메라가 보는 방향)으로 backface를 판정한다.
+	bool orthographic{false};
+	Float3 cameraPosition{ 0.0f, 0.0f, 0.0f };
+	Float3 viewDirection{ 0.0f, 0.0f, -1.0f };
+	bool frustumCulling{true};
+	bool backfaceCulling{true};
+};
+
+struct MeshletCullStats {
+	size_t visibleMeshlets{0};
+	size_t frustumCulledMeshlets{0};
+	size_t backfaceCulledMeshlets{0};
+	size_t visibleTriangles{0};
+	size_t totalTriangles{0};
+};
+
+// mesh.indices(triangle list)로 meshlet을 만든다. bounds는 mesh.positions로 계산한다.
+void buildMeshlets(const MeshData& mesh, MeshletData& out, ThreadPool& pool = ThreadPool::shared());
+/*
+ * 보이는 meshlet의 삼각형만 원래 vertex index로 풀어서 indices에 쓴다 (triangle list).
+ * indices는 meshlets.numberOfTriangles() * 3 크기로 늘어나지만 앞의 visibleTriangles * 3개만 유효하다.
+ * */
+MeshletCullStats cullMeshlets(const MeshletData& meshlets, const MeshletCullParams& params,
+		std::vector<uint32_t>& indices, ThreadPool& pool = ThreadPool::shared());
+MeshletCullParams meshletCullParamsFor(const Float4x4& viewProjection, Float3 cameraPosition);
+
+/*
+ * Offline으로 만든 meshlet을 저장하고 읽는다. 같은 기계에서 쓰는 cache이므로 native endian으로 쓴다.
+ * loadMeshlets는 원래 mesh의 vertex / 삼각형 수가 다르면 실패한다.
+ * */
+bool saveMeshlets(const char* path, const MeshletData& meshlets, size_t numberOfVertices);
+bool loadMeshlets(const char* path, MeshletData& meshlets, size_t numberOfVertices, size_t numberOfTriangles);
+
+#pragma region MeshletBuilder {
+
+namespace MeshletDetail {
+
+inline Float3 triangleCentroid(const MeshData& mesh, size_t t)
+{
+	const uint32_t* v = &mesh.indices[t * 3];
+	return (mesh.positions[v[0]] + mesh.positions[v[1]] + mesh.positions[v[2]]) * (1.0f / 3.0f);
+}
+
+/*
+ * 연속된 삼각형 범위 하나로 meshlet을 만든다.
+ * 범위 안에서만 쓰는 vertex 번호(local id)로 adjacency를 따로 만들기 때문에
+ * 여러 범위를 동시에 만들어도 공유하는 상태가 없다.
+ * */
+class RangeBuilder {
+	public:
+		RangeBuilder(const MeshData& mesh, size_t begin, size_t end) : _mesh(mesh), _begin(begin), _end(end) {}
+
+		/*
+		 * 현재 meshlet의 vertex를 공유하는 삼각형 중 새 vertex가 가장 적게 필요한 것을 고른다.
+		 * 같으면 남은 이웃이 적은 vertex를 쓰는 삼각형을 먼저 골라 vertex를 빨리 닫는다.
+		 * 이웃이 없으면 가까운 다음 삼각형으로 넘어가거나 meshlet을 닫는다.
+		 * */
+		void build(MeshletData& out)
+		{
+			buildAdjacency();
+			const size_t numberOfTriangles = _end - _begin;
+			std::vector<uint8_t> emitted(numberOfTriangles, 0);
+			size_t cursor = 0;
+			uint32_t last = UINT32_MAX;
+			for (;;) {
+				uint32_t best = UINT32_MAX;
+				if (last != UINT32_MAX) {
+					best = bestNeighbor(&_corners[last * 3], 3);
+				}
+				if (best == UINT32_MAX && _vertexCount > 0) {
+					best = bestNeighbor(_localVertices, _vertexCount);
+				}
+				if (best == UINT32_MAX) {
+					while (cursor < numberOfTriangles && emitted[cursor]) {
+						++cursor;
+					}
+					if (cursor == numberOfTriangles) {
+						break;
+					}
+					// 떨어진 조각이다. 가까이 있으면 같은 meshlet에 넣고, 멀면 새 meshlet을 시작한다.
+					best = uint32_t(cursor);
+					if (_triangleCount > 0) {
+						Float3 center = _centroidSum * (1.0f / float(_triangleCount));
+						if (!fits(best) || length(triangleCentroid(_mesh, _begin + best) - center) > 2.0f * _radius) {
+							flush(out);
+						}
+					}
+				}
+				add(best);
+				emitted[best] = 1;
+				last = best;
+				if (_triangleCount == kMeshletMaxTriangles || _vertexCount == kMeshletMaxVertices) {
+					flush(out);
+					last = UINT32_MAX;
+				}
+			}
+			flush(out);
+		}
+
+	private:
+		static constexpr uint8_t kNotInMeshlet = 0xFF;
+
+		// 삼각형 corner마다 local vertex id를 붙이고 local id -> 삼각형 목록(CSR)을 만든다.
+		void buildAdjacency()
+		{
+			const size_t numberOfCorners = (_end - _begin) * 3;
+			const uint32_t* indices = &_mesh.indices[_begin * 3];
+			std::vector<uint32_t> order(numberOfCorners);
+			uint32_t lowest = UINT32_MAX, highest = 0;
+			for (size_t i = 0; i < numberOfCorners; ++i) {
+				lowest = std::min(lowest, indices[i]);
+				highest = std::max(highest, indices[i]);
+			}
+			// 한 범위가 쓰는 vertex 번호는 보통 좁은 구간에 모여 있으므로 counting sort로 묶는다.
+			size_t span = size_t(highest - lowest) + 1;
+			if (span <= numberOfCorners * 4) {
+				std::vector<uint32_t> starts(span + 1, 0);
+				for (size_t i = 0; i < numberOfCorners; ++i) {
+					++starts[indices[i] - lowest + 1];
+				}
+				for (size_t v = 0; v < span; ++v) {
+					starts[v + 1] += starts[v];
+				}
+				for (size_t i = 0; i < numberOfCorners; ++i) {
+					order[starts[indices[i] - lowest]++] = uint32_t(i);
+				}
+			} else {
+				for (size_t i = 0; i < numberOfCorners; ++i) {
+					order[i] = uint32_t(i);
+				}
+				std::sort(order.begin(), order.end(), [indices](uint32_t a, uint32_t b) { return indices[a] < indices[b]; });
+			}
+
+			_corners.resize(numberOfCorners);
+			_globalVertices.clear();
+			_offsets.clear();
+			_adjacency.resize(numberOfCorners);
+			for (size_t i = 0; i < numberOfCorners; ++i) {
+				if (i == 0 || indices[order[i]] != indices[order[i - 1]]) {
+					_globalVertices.push_back(indices[order[i]]);
+					_offsets.push_back(uint32_t(i));
+				}
+				_corners[order[i]] = uint32_t(_globalVertices.size() - 1);
+				_adjacency[i] = order[i] / 3;
+			}
+			_offsets.push_back(uint32_t(numberOfCorners));
+			_liveCounts.resize(_globalVertices.size());
+			for (size_t v = 0; v < _globalVertices.size(); ++v) {
+				_liveCounts[v] = _offsets[v + 1] - _offsets[v];
+			}
+			_slots.assign(_globalVertices.size(), kNotInMeshlet);
+		}
+
+		// 삼각형을 넣으려면 새로 필요한 vertex 수. 같은 vertex가 두 번 나오는 퇴화 삼각형도 센다.
+		int cost(uint32_t triangle) const
+		{
+			const uint32_t* v = &_corners[triangle * 3];
+			int extra = _slots[v[0]] == kNotInMeshlet;
+			extra += v[1] != v[0] && _slots[v[1]] == kNotInMeshlet;
+			extra += v[2] != v[0] && v[2] != v[1] && _slots[v[2]] == kNotInMeshlet;
+			return extra;
+		}
+
+		bool fits(uint32_t triangle) const
+		{
+			return _triangleCount < kMeshletMaxTriangles && _vertexCount + uint32_t(cost(triangle)) <= kMeshletMaxVertices;
+		}
+
+		uint32_t bestNeighbor(const uint32_t* vertices, uint32_t count) const
+		{
+			uint32_t best = UINT32_MAX;
+			uint32_t bestScore = UINT32_MAX;
+			for (uint32_t i = 0; i < count; ++i) {
+				uint32_t vertex = vertices[i];
+				for (uint32_t a = _offsets[vertex]; a < _offsets[vertex] + _liveCounts[vertex]; ++a) {
+					uint32_t triangle = _adjacency[a];
+					if (!fits(triangle)) {
+						continue;
+					}
+					const uint32_t* v = &_corners[triangle * 3];
+					uint32_t score = uint32_t(cost(triangle)) * 1024
+						+ std::min<uint32_t>(_liveCounts[v[0]] + _liveCounts[v[1]] + _liveCounts[v[2]], 1023);
+					if (score < bestScore) {
+						best = triangle;
+						bestScore = score;
+					}
+				}
+			}
+			return best;
+		}
+
+		void add(uint32_t triangle)
+		{
+			const uint32_t* v = &_corners[triangle * 3];
+			for (int k = 0; k < 3; ++k) {
+				if (_slots[v[k]] == kNotInMeshlet) {
+					_slots[v[k]] = uint8_t(_vertexCount);
+					_localVertices[_vertexCount++] = v[k];
+				}
+				_triangles[_triangleCount * 3 + k] = _slots[v[k]];
+			}
+			++_triangleCount;
+			// 다 쓴 삼각형은 adjacency 목록의 뒤로 보내서 다시 보지 않는다.
+			// 퇴화 삼각형은 같은 vertex를 두 번 지나지만 두 번째에는 이미 빠져 있다.
+			for (int k = 0; k < 3; ++k) {
+				uint32_t begin = _offsets[v[k]];
+				uint32_t& live = _liveCounts[v[k]];
+				for (uint32_t a = begin; a < begin + live; ++a) {
+					if (_adjacency[a] == triangle) {
+						std::swap(_adjacency[a], _adjacency[begin + live - 1]);
+						--live;
+						break;
+					}
+				}
+			}
+			Float3 centroid = triangleCentroid(_mesh, _begin + triangle);
+			_centroidSum += centroid;
+			Float3 center = _centroidSum * (1.0f / float(_triangleCount));
+			for (int k = 0; k < 3; ++k) {
+				_radius = std::max(_radius, length(_mesh.positions[_globalVertices[v[k]]] - center));
+			}
+		}
+
+		void flush(MeshletData& out)
+		{
+			if (_triangleCount == 0) {
+				return;
+			}
+			Meshlet meshlet = {};
+			meshlet.vertexOffset = uint32_t(out.vertices.size());
+			meshlet.triangleOffset = uint32_t(out.triangles.size());
+			meshlet.vertexCount = _vertexCount;
+			meshlet.triangleCount = _triangleCount;
+			out.meshlets.push_back(meshlet);
+			for (uint32_t i = 0; i < _vertexCount; ++i) {
+				out.vertices.push_back(_globalVertices[_localVertices[i]]);
+				_slots[_localVertices[i]] = kNotInMeshlet;
+			}
+			out.triangles.insert(out.triangles.end(), _triangles, _triangles + _triangleCount * 3);
+			_vertexCount = 0;
+			_triangleCount = 0;
+			_centroidSum = { 0.0f, 0.0f, 0.0f };
+			_radius = 0.0f;
+		}
+
+		const MeshData& _mesh;
+		size_t _begin;
+		size_t _end;
+		// corner(삼각형 * 3 + k) -> local vertex id
+		std::vector<uint32_t> _corners;
+		// local vertex id -> mesh의 vertex index
+		std::vector<uint32_t> _globalVertices;
+		// local vertex id마다 _adjacency[_offsets[v], _offsets[v] + _liveCounts[v])가 아직 쓰지 않은 삼각형
+		std::vector<uint32_t> _offsets;
+		std::vector<uint32_t> _liveCounts;
+		std::vector<uint32_t> _adjacency;
+		// local vertex id -> 현재 meshlet 안의 번호
+		std::vector<uint8_t> _slots;
+
+		// 채우는 중인 meshlet
+		uint32_t _localVertices[kMeshletMaxVertices];
+		uint8_t _triangles[kMeshletMaxTriangles * 3];
+		uint32_t _vertexCount{0};
+		uint32_t _triangleCount{0};
+		Float3 _centroidSum{ 0.0f, 0.0f, 0.0f };
+		float _radius{0.0f};
+};
+
+// Ritter의 근사 bounding sphere와 normal cone
+inline void computeBounds(const MeshData& mesh, const MeshletData& data, Meshlet& meshlet)
+{
+	const uint32_t* vertices = &data.vertices[meshlet.vertexOffset];
+	auto position = [&](uint32_t i) { return mesh.positions[vertices[i]]; };
+
+	Float3 a = position(0), b = a;
+	for (uint32_t i = 1; i < meshlet.vertexCount; ++i) {
+		if (length(position(i) - position(0)) > length(a - position(0))) a = position(i);
+	}
+	for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+		if (length(position(i) - a) > length(b - a)) b = position(i);
+	}
+	Float3 center = (a + b) * 0.5f;
+	float radius = length(b - a) * 0.5f;
+	for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+		float distance = length(position(i) - center);
+		if (distance > radius) {
+			float grown = (radius + distance) * 0.5f;
+			center = center + (position(i) - center) * ((grown - radius) / distance);
+			radius = grown;
+		}
+	}
+	meshlet.boundingSphere = { center.x, center.y, center.z, radius };
+
+	const uint8_t* triangles = &data.triangles[meshlet.triangleOffset];
+	Float3 normals[kMeshletMaxTriangles];
+	uint32_t numberOfNormals = 0;
+	Float3 axis = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+		Float3 p0 = position(triangles[t * 3]), p1 = position(triangles[t * 3 + 1]), p2 = position(triangles[t * 3 + 2]);
+		Float3 n = cross(p1 - p0, p2 - p0);
+		if (dot(n, n) > 0.0f) {
+			normals[numberOfNormals] = normalize(n);
+			axis += normals[numberOfNormals++];
+		}
+	}
+	// 퇴화 삼각형뿐이거나 normal이 넓게 퍼져 있으면 cone으로 culling 하지 않는다.
+	meshlet.normalCone = { 0.0f, 0.0f, 0.0f, 1.0f };
+	if (numberOfNormals == 0 || length(axis) < 1e-6f) {
+		return;
+	}
+	axis = normalize(axis);
+	float minDot = 1.0f;
+	for (uint32_t i = 0; i < numberOfNormals; ++i) {
+		minDot = std::min(minDot, dot(normals[i], axis));
+	}
+	if (minDot <= 0.0f) {
+		return;
+	}
+	// 모든 normal이 축에서 반각 alpha 안에 있으면 시선과 축의 각도가 90 - alpha보다 작을 때 전부 뒷면이다.
+	meshlet.normalCone = { axis.x, axis.y, axis.z, std::sqrt(1.0f - minDot * minDot) };
+}
+
+} // namespace MeshletDetail
+
+inline void buildMeshlets(const MeshData& mesh, MeshletData& out, ThreadPool& pool)
+{
+	using namespace MeshletDetail;
+	out = MeshletData();
+	const size_t numberOfTriangles = mesh.numberOfTriangles();
+	if (numberOfTriangles == 0) {
+		return;
+	}
+	// 삼각형 순서는 보통 공간적으로 이어져 있으므로 연속된 범위로 나누어 범위마다 따로 만든다.
+	// 경계에서만 meshlet이 조금 덜 채워진다.
+	const size_t rangeSize = std::max<size_t>(1 << 15, (numberOfTriangles + pool.size() * 4 - 1) / (pool.size() * 4));
+	const size_t numberOfRanges = (numberOfTriangles + rangeSize - 1) / rangeSize;
+	std::vector<MeshletData> ranges(numberOfRanges);
+	pool.parallelFor(numberOfRanges, 1, [&](size_t first, size_t last) {
+		for (size_t r = first; r < last; ++r) {
+			size_t begin = r * rangeSize;
+			RangeBuilder builder(mesh, begin, std::min(begin + rangeSize, numberOfTriangles));
+			builder.build(ranges[r]);
+		}
+	});
+
+	for (MeshletData& range : ranges) {
+		uint32_t vertexBase = uint32_t(out.vertices.size());
+		uint32_t triangleBase = uint32_t(out.triangles.size());
+		for (Meshlet meshlet : range.meshlets) {
+			meshlet.vertexOffset += vertexBase;
+			meshlet.triangleOffset += triangleBase;
+			out.meshlets.push_back(meshlet);
+		}
+		out.vertices.insert(out.vertices.end(), range.vertices.begin(), range.vertices.end());
+		out.triangles.insert(out.triangles.end(), range.triangles.begin(), range.triangles.end());
+	}
+	pool.parallelFor(out.meshlets.size(), 1024, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			computeBounds(mesh, out, out.meshlets[i]);
+		}
+	});
+}
+
+#pragma endregion MeshletBuilder }
+
+#pragma region MeshletCulling {
+
+inline MeshletCullParams meshletCullParamsFor(const Float4x4& viewProjection, Float3 cameraPosition)
+{
+	MeshletCullParams params;
+	extractFrustumPlanes(viewProjection, params.frustumPlanes);
+	params.cameraPosition = cameraPosition;
+	return params;
+}
+
+inline MeshletCullStats cullMeshlets(const MeshletData& data, const MeshletCullParams& params,
+		std::vector<uint32_t>& indices, ThreadPool& pool)
+{
+	enum : uint8_t { Visible, FrustumCulled, BackfaceCulled };
+	const size_t numberOfMeshlets = data.meshlets.size();
+	const size_t grainSize = 4096;
+	const size_t numberOfChunks = (numberOfMeshlets + grainSize - 1) / grainSize;
+	std::vector<uint8_t> result(numberOfMeshlets);
+	// chunk마다 보이는 삼각형 수를 세고, prefix sum으로 출력 위치를 정한 뒤 다시 병렬로 쓴다.
+	std::vector<size_t> chunkTriangles(numberOfChunks + 1, 0);
+
+	pool.parallelFor(numberOfMeshlets, grainSize, [&](size_t begin, size_t end) {
+		size_t visibleTriangles = 0;
+		for (size_t i = begin; i < end; ++i) {
+			const Meshlet& meshlet = data.meshlets[i];
+			Float3 center = { meshlet.boundingSphere.x, meshlet.boundingSphere.y, meshlet.boundingSphere.z };
+			float radius = meshlet.boundingSphere.w;
+			uint8_t state = Visible;
+			if (params.frustumCulling) {
+				for (const Float4& plane : params.frustumPlanes) {
+					if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) {
+						state = FrustumCulled;
+						break;
+					}
+				}
+			}
+			if (state == Visible && params.backfaceCulling && meshlet.normalCone.w < 1.0f) {
+				Float3 axis = { meshlet.normalCone.x, meshlet.normalCone.y, meshlet.normalCone.z };
+				float cutoff = meshlet.normalCone.w;
+				if (params.orthographic) {
+					if (dot(params.viewDirection, axis) >= cutoff) {
+						state = BackfaceCulled;
+					}
+				} else {
+					Float3 toCenter = center - params.cameraPosition;
+					if (dot(toCenter, axis) >= cutoff * length(toCenter) + radius) {
+						state = BackfaceCulled;
+					}
+				}
+			}
+			result[i] = state;
+			if (state == Visible) {
+				visibleTriangles += meshlet.triangleCount;
+			}
+		}
+		chunkTriangles[begin / grainSize + 1] = visibleTriangles;
+	});
+	for (size_t c = 0; c < numberOfChunks; ++c) {
+		chunkTriangles[c + 1] += chunkTriangles[c];
+	}
+
+	indices.resize(data.numberOfTriangles() * 3);
+	pool.parallelFor(numberOfMeshlets, grainSize, [&](size_t begin, size_t end) {
+		uint32_t* out = indices.data() + chunkTriangles[begin / grainSize] * 3;
+		for (size_t i = begin; i < end; ++i) {
+			if (result[i] != Visible) {
+				continue;
+			}
+			const Meshlet& meshlet = data.meshlets[i];
+			const uint32_t* vertices = &data.vertices[meshlet.vertexOffset];
+			const uint8_t* triangles = &data.triangles[meshlet.triangleOffset];
+			for (uint32_t k = 0; k < meshlet.triangleCount * 3; ++k) {
+				*out++ = vertices[triangles[k]];
+			}
+		}
+	});
+
+	MeshletCullStats stats;
+	stats.totalTriangles = data.numberOfTriangles();
+	stats.visibleTriangles = chunkTriangles[numberOfChunks];
+	for (uint8_t state : result) {
+		stats.visibleMeshlets += state == Visible;
+		stats.frustumCulledMeshlets += state == FrustumCulled;
+		stats.backfaceCulledMeshlets += state == BackfaceCulled;
+	}
+	return stats;
+}
+
+#pragma endregion MeshletCulling }
+
+#pragma region MeshletFile {
+
+namespace MeshletDetail {
+
+struct FileHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t numberOfVertices;
+	uint64_t numberOfMeshlets;
+	uint64_t numberOfMeshletVertices;
+	uint64_t numberOfTriangleBytes;
+};
+
+constexpr char kFileMagic[4] = { 'M', 'S', 'H', 'L' };
+constexpr uint32_t kFileVersion = 1;
+
+} // namespace MeshletDetail
+
+inline bool saveMeshlets(const char* path, const MeshletData& meshlets, size_t numberOfVertices)
+{
+	using namespace MeshletDetail;
+	FILE* file = std::fopen(path, "wb");
+	if (!file) {
+		std::cerr << "Cannot write meshlets: " << path << std::endl;
+		return false;
+	}
+	FileHeader header = {};
+	std::memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+	header.version = kFileVersion;
+	header.numberOfVertices = numberOfVertices;
+	header.numberOfMeshlets = meshlets.meshlets.size();
+	header.numberOfMeshletVertices = meshlets.vertices.size();
+	header.numberOfTriangleBytes = meshlets.triangles.size();
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+		&& std::fwrite(meshlets.meshlets.data(), sizeof(Meshlet), meshlets.meshlets.size(), file) == meshlets.meshlets.size()
+		&& std::fwrite(meshlets.vertices.data(), sizeof(uint32_t), meshlets.vertices.size(), file) == meshlets.vertices.size()
+		&& std::fwrite(meshlets.triangles.data(), 1, meshlets.triangles.size(), file) == meshlets.triangles.size();
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok) {
+		std::cerr << "Cannot write meshlets: " << path << std::endl;
+	}
+	return ok;
+}
+
+inline bool loadMeshlets(const char* path, MeshletData& meshlets, size_t numberOfVertices, size_t numberOfTriangles)
+{
+	using namespace MeshletDetail;
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	FileHeader header;
+	bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+		&& std::memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) == 0
+		&& header.version == kFileVersion
+		&& header.numberOfVertices == numberOfVertices
+		&& header.numberOfTriangleBytes == numberOfTriangles * 3;
+	if (ok) {
+		meshlets.meshlets.resize(header.numberOfMeshlets);
+		meshlets.vertices.resize(header.numberOfMeshletVertices);
+		meshlets.triangles.resize(header.numberOfTriangleBytes);
+		ok = std::fread(meshlets.meshlets.data(), sizeof(Meshlet), meshlets.meshlets.size(), file) == meshlets.meshlets.size()
+			&& std::fread(meshlets.vertices.data(), sizeof(uint32_t), meshlets.vertices.size(), file) == meshlets.vertices.size()
+			&& std::fread(meshlets.triangles.data(), 1, meshlets.triangles.size(), file) == meshlets.triangles.size();
+	}
+	std::fclose(file);
+	// 잘못된 파일이 범위 밖을 가리키지 않는지 확인한다.
+	for (size_t i = 0; ok && i < meshlets.meshlets.size(); ++i) {
+		const Meshlet& meshlet = meshlets.meshlets[i];
+		ok = meshlet.vertexCount <= kMeshletMaxVertices && meshlet.triangleCount <= kMeshletMaxTriangles
+			&& uint64_t(meshlet.vertexOffset) + meshlet.vertexCount <= meshlets.vertices.size()
+			&& uint64_t(meshlet.triangleOffset) + meshlet.triangleCount * 3 <= meshlets.triangles.size();
+		for (uint32_t t = 0; ok && t < meshlet.triangleCount * 3; ++t) {
+			ok = meshlets.triangles[meshlet.triangleOffset + t] < meshlet.vertexCount;
+		}
+	}
+	for (size_t i = 0; ok && i < meshlets.vertices.size(); ++i) {
+		ok = meshlets.vertices[i] < numberOfVertices;
+	}
+	if (!ok) {
+		meshlets = MeshletData();
+	}
+	return ok;
+}
+
+#pragma endregion MeshletFile }
@@ -0,0 +1,390 @@
+/*
+ * MipmapGenerator.hpp
+ *
+ * RGBA8 / BGRA8 texture의 level 0으로 mip chain을 만든다.
+ *  - sRGB format이면 색을 linear로 바꿔서 거르고 다시 sRGB로 돌린다. gamma 공간에서 평균하면 밝고 어두운 무늬가 어두워진다.
+ *  - filter는 box(원본 면적 평균)와 Kaiser(창을 씌운 sinc, 폭 3)이다. 둘 다 level마다 polyphase tap을 미리 구하므로
+ *    홀수 / 2의 거듭제곱이 아닌 크기도 원본 면적대로 거른다. (5 -> 2면 dst pixel 하나가 원본 2.5개를 덮는다)
+ *  - 가로로 거른 뒤 세로로 거르고, 행마다 ThreadPool로 나눈다. 가로는 RGBA 한 pixel을 Lanes4, 세로는 한 줄을 Lanes8로 더한다.
+ *  - 다음 level은 양자화하지 않은 float level에서 만든다.
+ *  - alphaReference를 주면 level 0에서 alpha >= alphaReference인 texel의 비율(alpha test coverage)을 모든 level에서 유지하도록
+ *    level마다 alpha에 배율을 곱한다. 그냥 줄이면 먼 거리의 나뭇잎이 점점 얇아져 사라진다.
+ *
+ * 실행 중에 만든 render target처럼 CPU에 내용이 없는 texture는 blit encoder의 generateMipmaps로 GPU에서 만든다.
+ * canBlitGenerateMipmaps가 그 format이 가능한지 알려 준다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "Simd.hpp"
+#include "TextureLoader.hpp"
+#include "ThreadPool.hpp"
+
+enum MipFilter : uint32_t {
+	MipFilterBox,
+	MipFilterKaiser,
+};
+
+struct MipmapOptions {
+	MipFilter filter{MipFilterKaiser};
+	// 0보다 크면 level 0의 alpha test coverage(alpha >= alphaReference인 비율)를 모든 level에서 유지한다.
+	float alphaReference{0.0f};
+	// 가장자리 너머를 반대편에서 읽는다. 반복해서 까는 texture용. 아니면 가장자리 texel을 늘인다.
+	bool wrap{false};
+	// 만들 level 수. 0이면 1x1까지 만든다.
+	uint32_t levels{0};
+};
+
+/*
+ * source의 level 0(모든 slice)으로 mip chain을 만들어 mipmapped에 담는다. 원본의 나머지 level은 쓰지 않는다.
+ * RGBA8 / BGRA8(sRGB 포함) 2D / array / cube texture만 받는다. 아니면 이유를 출력하고 false를 반환한다.
+ * */
+bool generateMipmaps(const TextureData& source, TextureData& mipmapped, const MipmapOptions& options = {},
+		ThreadPool& pool = ThreadPool::shared());
+
+/*
+ * RGBA float image(linear, 한 pixel 4개) 하나를 dstWidth x dstHeight로 거른다. dst는 dstWidth * dstHeight * 4개이다.
+ * 결과는 [0, 1]로 자른다.
+ * */
+void downsampleLinear(const float* src, uint32_t srcWidth, uint32_t srcHeight, float* dst, uint32_t dstWidth, uint32_t dstHeight,
+		MipFilter filter, bool wrap, ThreadPool& pool = ThreadPool::shared());
+
+// linear RGBA float image에서 alpha >= reference인 pixel의 비율
+float alphaCoverage(const float* rgba, size_t pixels, float reference);
+// alpha에 곱했을 때 coverage가 target이 되는 배율
+float alphaCoverageScale(const float* rgba, size_t pixels, float reference, float target);
+
+// blit encoder의 generateMipmaps를 쓸 수 있는 format인지. 색을 그릴 수 있고 filtering이 되는 압축하지 않은 format이어야 한다.
+bool canBlitGenerateMipmaps(TextureFormat format);
+
+namespace MipmapDetail {
+
+// 8 bit sRGB -> linear
+inline const float* srgbToLinearTable()
+{
+	static const std::vector<float> table = [] {
+		std::vector<float> values(256);
+		for (int i = 0; i < 256; ++i) {
+			const double c = i / 255.0;
+			values[size_t(i)] = float(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+		}
+		return values;
+	}();
+	return table.data();
+}
+
+/*
+ * linear -> 8 bit sRGB. sRGB 값 k와 k + 1의 경계(k + 0.5를 linear로 바꾼 값)를 모두 구해 두고,
+ * linear 값을 4096칸으로 나눈 표에서 시작한 뒤 경계를 몇 개 넘는다. pow 없이 정확히 반올림한 값이 나온다.
+ * */
+struct SrgbEncoder {
+	float thresholds[256];
+	uint8_t starts[4097];
+
+	SrgbEncoder()
+	{
+		for (int k = 0; k < 255; ++k) {
+			const double c = (k + 0.5) / 255.0;
+			thresholds[k] = float(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+		}
+		thresholds[255] = 2.0f;
+		int k = 0;
+		for (int i = 0; i <= 4096; ++i) {
+			while (thresholds[k] <= float(i) / 4096.0f) {
+				++k;
+			}
+			starts[i] = uint8_t(k);
+		}
+	}
+
+	uint8_t encode(float linear) const
+	{
+		linear = std::clamp(linear, 0.0f, 1.0f);
+		int k = starts[int(linear * 4096.0f)];
+		while (thresholds[k] <= linear) {
+			++k;
+		}
+		return uint8_t(k);
+	}
+};
+
+inline const SrgbEncoder& srgbEncoder()
+{
+	static const SrgbEncoder encoder;
+	return encoder;
+}
+
+inline uint8_t encodeUnorm(float value)
+{
+	return uint8_t(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+inline double besselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; ++k) {
+		term *= (x * 0.5 / k) * (x * 0.5 / k);
+		sum += term;
+	}
+	return sum;
+}
+
+// Kaiser 창(alpha 4)을 씌운 sinc. x는 dst pixel 단위, 폭 3 밖은 0이다.
+const float kKaiserWidth = 3.0f;
+
+inline float kaiser(float x)
+{
+	const double t = x / kKaiserWidth;
+	if (std::fabs(t) >= 1.0) {
+		return 0.0f;
+	}
+	const double pi = 3.14159265358979323846;
+	const double sinc = x == 0.0f ? 1.0 : std::sin(pi * x) / (pi * x);
+	return float(sinc * besselI0(4.0 * std::sqrt(1.0 - t * t)) / besselI0(4.0));
+}
+
+/*
+ * 한 축의 polyphase tap. dst pixel i는 indices / weights의 [i * taps, (i + 1) * taps)를 쓴다.
+ * 가장자리는 index를 미리 clamp / wrap 해 두고, 남는 tap은 weight 0이다.
+ * */
+struct FilterTaps {
+	uint32_t taps{0};
+	std::vector<uint32_t> indices;
+	std::vector<float> weights;
+};
+
+inline FilterTaps buildTaps(uint32_t srcSize, uint32_t dstSize, MipFilter filter, bool wrap)
+{
+	const float scale = float(srcSize) / float(dstSize);
+	// dst pixel 하나가 덮는 원본 반지름
+	const float radius = filter == MipFilterBox ? scale * 0.5f : kKaiserWidth * scale;
+	auto weightOf = [&](int j, float center) {
+		if (filter == MipFilterBox) {
+			// [j, j + 1]과 dst pixel이 덮는 구간이 겹치는 길이
+			return std::max(0.0f, std::min(float(j + 1), center + radius) - std::max(float(j), center - radius));
+		}
+		return kaiser((float(j) + 0.5f - center) / scale);
+	};
+	// weight가 0이 아닌 가장 긴 구간을 tap 수로 쓴다. 2배로 줄이면 box는 2개, Kaiser는 12개이다.
+	const int span = int(std::ceil(2.0f * radius)) + 2;
+	std::vector<int> firsts(dstSize);
+	FilterTaps result;
+	for (uint32_t i = 0; i < dstSize; ++i) {
+		const float center = (float(i) + 0.5f) * scale;
+		int first = int(std::floor(center - radius)), last = first + span - 1;
+		while (first < last && weightOf(first, center) == 0.0f) {
+			++first;
+		}
+		while (last > first && weightOf(last, center) == 0.0f) {
+			--last;
+		}
+		firsts[i] = first;
+		result.taps = std::max(result.taps, uint32_t(last - first + 1));
+	}
+	result.indices.assign(size_t(dstSize) * result.taps, 0);
+	result.weights.assign(size_t(dstSize) * result.taps, 0.0f);
+	for (uint32_t i = 0; i < dstSize; ++i) {
+		const float center = (float(i) + 0.5f) * scale;
+		float total = 0.0f;
+		for (uint32_t k = 0; k < result.taps; ++k) {
+			const int j = firsts[i] + int(k);
+			const int index = wrap ? ((j % int(srcSize)) + int(srcSize)) % int(srcSize) : std::clamp(j, 0, int(srcSize) - 1);
+			const float weight = weightOf(j, center);
+			result.indices[size_t(i) * result.taps + k] = uint32_t(index);
+			result.weights[size_t(i) * result.taps + k] = weight;
+			total += weight;
+		}
+		for (uint32_t k = 0; k < result.taps; ++k) {
+			result.weights[size_t(i) * result.taps + k] /= total;
+		}
+	}
+	return result;
+}
+
+inline bool isRgba8(TextureFormat format)
+{
+	return format == TextureFormatRGBA8Unorm || format == TextureFormatRGBA8Unorm_sRGB || format == TextureFormatBGRA8Unorm
+		|| format == TextureFormatBGRA8Unorm_sRGB;
+}
+
+} // namespace MipmapDetail
+
+#pragma region MipmapGenerator {
+
+inline void downsampleLinear(const float* src, uint32_t srcWidth, uint32_t srcHeight, float* dst, uint32_t dstWidth, uint32_t dstHeight,
+		MipFilter filter, bool wrap, ThreadPool& pool)
+{
+	using namespace MipmapDetail;
+	const FilterTaps horizontal = buildTaps(srcWidth, dstWidth, filter, wrap);
+	const FilterTaps vertical = buildTaps(srcHeight, dstHeight, filter, wrap);
+	// 가로로 먼저 줄이면 세로 pass가 읽는 양이 줄어든다.
+	std::vector<float> rows(size_t(srcHeight) * dstWidth * 4);
+	pool.parallelFor(srcHeight, 16, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; ++y) {
+			const float* in = src + y * srcWidth * 4;
+			float* out = rows.data() + y * dstWidth * 4;
+			for (uint32_t x = 0; x < dstWidth; ++x) {
+				const uint32_t* indices = horizontal.indices.data() + size_t(x) * horizontal.taps;
+				const float* weights = horizontal.weights.data() + size_t(x) * horizontal.taps;
+				Lanes4 sum = Lanes4::splat(0.0f);
+				for (uint32_t k = 0; k < horizontal.taps; ++k) {
+					sum = sum + Lanes4::load(in + size_t(indices[k]) * 4) * Lanes4::splat(weights[k]);
+				}
+				store(out + size_t(x) * 4, sum);
+			}
+		}
+	});
+	const size_t floats = size_t(dstWidth) * 4;
+	pool.parallelFor(dstHeight, 8, [&](size_t begin, size_t end) {
+		const Lanes8 zero = Lanes8::splat(0.0f), one = Lanes8::splat(1.0f);
+		for (size_t y = begin; y < end; ++y) {
+			const uint32_t* indices = vertical.indices.data() + y * vertical.taps;
+			const float* weights = vertical.weights.data() + y * vertical.taps;
+			float* out = dst + y * floats;
+			size_t i = 0;
+			for (; i + 8 <= floats; i += 8) {
+				Lanes8 sum = zero;
+				for (uint32_t k = 0; k < vertical.taps; ++k) {
+					sum = multiplyAdd(Lanes8::load(rows.data() + size_t(indices[k]) * floats + i), Lanes8::splat(weights[k]), sum);
+				}
+				store(out + i, min(max(sum, zero), one));
+			}
+			// 폭이 1인 level은 4개만 남는다.
+			for (; i < floats; ++i) {
+				float sum = 0.0f;
+				for (uint32_t k = 0; k < vertical.taps; ++k) {
+					sum += rows[size_t(indices[k]) * floats + i] * weights[k];
+				}
+				out[i] = std::clamp(sum, 0.0f, 1.0f);
+			}
+		}
+	});
+}
+
+inline float alphaCoverage(const float* rgba, size_t pixels, float reference)
+{
+	size_t covered = 0;
+	for (size_t i = 0; i < pixels; ++i) {
+		covered += rgba[i * 4 + 3] >= reference ? 1 : 0;
+	}
+	return pixels ? float(covered) / float(pixels) : 0.0f;
+}
+
+/*
+ * coverage가 target이 되려면 alpha의 위에서 target 비율째 값 t가 reference에 닿아야 한다. 배율은 reference / t이다.
+ * alpha를 4096칸 histogram으로 세고 위에서부터 더해 t를 찾는다.
+ * */
+inline float alphaCoverageScale(const float* rgba, size_t pixels, float reference, float target)
+{
+	if (target <= 0.0f) {
+		return 1.0f;
+	}
+	const int bins = 4096;
+	std::vector<uint32_t> histogram(bins, 0);
+	for (size_t i = 0; i < pixels; ++i) {
+		++histogram[size_t(std::min(int(rgba[i * 4 + 3] * bins), bins - 1))];
+	}
+	const double wanted = double(target) * double(pixels);
+	double covered = 0.0;
+	for (int bin = bins - 1; bin >= 0; --bin) {
+		const double above = covered;
+		covered += histogram[size_t(bin)];
+		if (covered >= wanted && histogram[size_t(bin)] > 0) {
+			// 이 bin을 넣을지 뺄지 target에 더 가까운 쪽을 고른다. 넣으면 bin의 아래쪽 경계가 reference에 닿게 한다.
+			const int edge = covered - wanted <= wanted - above ? bin : bin + 1;
+			return reference / std::max(float(edge) / float(bins), 1.0f / float(bins));
+		}
+	}
+	return 1.0f;
+}
+
+inline bool generateMipmaps(const TextureData& source, TextureData& mipmapped, const MipmapOptions& options, ThreadPool& pool)
+{
+	using namespace MipmapDetail;
+	const TextureLayout& layout = source.layout;
+	if (!isRgba8(layout.format) || layout.type == TextureType3D) {
+		std::cerr << "mipmap: source texture must be a 2D RGBA8 or BGRA8 texture" << std::endl;
+		return false;
+	}
+	const bool sRGB = layout.format == TextureFormatRGBA8Unorm_sRGB || layout.format == TextureFormatBGRA8Unorm_sRGB;
+	const uint32_t maxLevels = mipLevelCount(layout.width, layout.height);
+	const uint32_t levels = options.levels == 0 ? maxLevels : std::min(options.levels, maxLevels);
+	mipmapped.layout = makeTextureLayout(layout.format, layout.width, layout.height, levels, layout.layers, layout.faces);
+	mipmapped.layout.type = layout.type;
+	mipmapped.bytes.assign(size_t(mipmapped.layout.totalSize()), 0);
+	const float* toLinear = srgbToLinearTable();
+	const SrgbEncoder& encoder = srgbEncoder();
+
+	std::vector<float> current, next;
+	for (uint32_t slice = 0; slice < layout.slices(); ++slice) {
+		const TextureSubresource& top = layout.subresource(0, slice);
+		std::memcpy(mipmapped.data(0, slice), source.data(0, slice), size_t(top.size));
+		current.resize(size_t(top.width) * top.height * 4);
+		const uint8_t* pixels = source.data(0, slice);
+		pool.parallelFor(top.height, 16, [&](size_t begin, size_t end) {
+			for (size_t y = begin; y < end; ++y) {
+				for (size_t x = 0; x < top.width; ++x) {
+					const uint8_t* in = pixels + y * top.bytesPerRow + x * 4;
+					float* out = current.data() + (y * top.width + x) * 4;
+					for (int c = 0; c < 3; ++c) {
+						out[c] = sRGB ? toLinear[in[c]] : float(in[c]) / 255.0f;
+					}
+					out[3] = float(in[3]) / 255.0f;
+				}
+			}
+		});
+		const float target = options.alphaReference > 0.0f ? alphaCoverage(current.data(), size_t(top.width) * top.height, options.alphaReference) : 0.0f;
+
+		uint32_t width = top.width, height = top.height;
+		for (uint32_t level = 1; level < levels; ++level) {
+			const TextureSubresource& subresource = mipmapped.layout.subresource(level, slice);
+			next.resize(size_t(subresource.width) * subresource.height * 4);
+			downsampleLinear(current.data(), width, height, next.data(), subresource.width, subresource.height, options.filter, options.wrap, pool);
+			// 배율은 8 bit로 쓸 때만 곱하고, 다음 level은 곱하지 않은 alpha로 만든다.
+			const float alphaScale = options.alphaReference > 0.0f
+				? alphaCoverageScale(next.data(), size_t(subresource.width) * subresource.height, options.alphaReference, target)
+				: 1.0f;
+			uint8_t* out = mipmapped.data(level, slice);
+			pool.parallelFor(subresource.height, 16, [&](size_t begin, size_t end) {
+				for (size_t y = begin; y < end; ++y) {
+					for (size_t x = 0; x < subresource.width; ++x) {
+						const float* in = next.data() + (y * subresource.width + x) * 4;
+						uint8_t* texel = out + y * subresource.bytesPerRow + x * 4;
+						for (int c = 0; c < 3; ++c) {
+							texel[c] = sRGB ? encoder.encode(in[c]) : encodeUnorm(in[c]);
+						}
+						texel[3] = encodeUnorm(in[3] * alphaScale);
+					}
+				}
+			});
+			std::swap(current, next);
+			width = subresource.width;
+			height = subresource.height;
+		}
+	}
+	return true;
+}
+
+inline bool canBlitGenerateMipmaps(TextureFormat format)
+{
+	switch (format) {
+		case TextureFormatR8Unorm:
+		case TextureFormatRG8Unorm:
+		case TextureFormatRGBA8Unorm:
+		case TextureFormatRGBA8Unorm_sRGB:
+		case TextureFormatBGRA8Unorm:
+		case TextureFormatBGRA8Unorm_sRGB:
+		case TextureFormatRGBA16Float:
+			return true;
+		default:
+			return false;
+	}
+}
+
+#pragma endregion MipmapGenerator }
@@ -0,0 +1,346 @@
+/*
+ * OcclusionCulling.hpp
+ *
+ * Hierarchical Z(Hi-Z) occlusion culling.
+ *
+ * 1. OccluderRasterizer: 큰 물체(벽, 건물)의 삼각형을 낮은 해상도 depth buffer에 software로 그린다.
+ *    pixel을 완전히 덮는 삼각형만, 그 pixel 안에서 가장 먼 depth로 쓰므로 실제보다 더 가리는 일은 없다.
+ *    이전 frame의 GPU depth를 읽어 올 수 있으면 이 단계 대신 그 depth를 쓴다.
+ * 2. DepthPyramid: depth를 mip 단계마다 2x2의 최댓값(가장 먼 값)으로 줄인다.
+ * 3. testOcclusion: 물체의 AABB를 화면에 투영한 사각형을 2x2 texel 이하로 덮는 단계에서 읽어
+ *    AABB의 가장 가까운 depth가 그보다 멀면 가려졌다고 본다. 투영은 SIMD로 4개씩 한다.
+ *
+ * depth는 Metal clip space와 같이 [0, 1]이고 작을수록 가깝다 (CompareFunctionLess).
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.hpp"
+#include "MathTypes.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+class DepthPyramid {
+	public:
+		// depth는 width * height, 0번 행이 화면 위쪽이다.
+		void build(const float* depth, uint32_t width, uint32_t height, ThreadPool& pool = ThreadPool::shared());
+
+		uint32_t numberOfLevels() const { return uint32_t(_levels.size()); }
+		uint32_t width(uint32_t level = 0) const { return _widths[level]; }
+		uint32_t height(uint32_t level = 0) const { return _heights[level]; }
+		float at(uint32_t level, uint32_t x, uint32_t y) const { return _levels[level][size_t(y) * _widths[level] + x]; }
+		// level 0 pixel 사각형 [x0, x1] x [y0, y1]을 덮는 texel들 중 가장 먼 depth
+		float farthestDepth(int32_t x0, int32_t y0, int32_t x1, int32_t y1) const;
+
+	private:
+		std::vector<std::vector<float>> _levels;
+		std::vector<uint32_t> _widths;
+		std::vector<uint32_t> _heights;
+};
+
+class OccluderRasterizer {
+	public:
+		explicit OccluderRasterizer(uint32_t width = 256, uint32_t height = 128);
+
+		// 모든 pixel을 가장 먼 depth(1)로 되돌린다.
+		void clear();
+		// geometry의 삼각형을 modelViewProjection으로 clip space에 옮겨 그린다. 앞뒷면 모두 그린다.
+		void rasterize(const BvhTriangleGeometry& geometry, const Float4x4& modelViewProjection, ThreadPool& pool = ThreadPool::shared());
+
+		uint32_t width() const { return _width; }
+		uint32_t height() const { return _height; }
+		const float* depth() const { return _depth.data(); }
+		size_t numberOfRasterizedTriangles() const { return _numberOfRasterizedTriangles; }
+
+	private:
+		// 화면 좌표로 옮긴 삼각형. edge 함수 a*x + b*y + c >= 0이 안쪽이 되도록 방향을 맞춘다.
+		struct ScreenTriangle {
+			float edgeA[3], edgeB[3], edgeC[3];
+			// depth = zA * x + zB * y + zC
+			float zA, zB, zC;
+			int32_t minX, minY, maxX, maxY;
+		};
+
+		uint32_t _width;
+		uint32_t _height;
+		std::vector<float> _depth;
+		std::vector<ScreenTriangle> _triangles;
+		size_t _numberOfRasterizedTriangles{0};
+};
+
+struct OcclusionStats {
+	size_t tested{0};
+	// 화면 밖에 있어서 그리지 않는 수
+	size_t outside{0};
+	size_t occluded{0};
+	size_t visible{0};
+};
+
+/*
+ * bounds[i]가 보이면 visible[i] = 1, 가려졌거나 화면 밖이면 0.
+ * viewProjection은 pyramid를 만든 depth와 같은 변환이어야 한다.
+ * */
+OcclusionStats testOcclusion(const DepthPyramid& pyramid, const Float4x4& viewProjection, const Aabb* bounds, size_t count,
+		uint8_t* visible, ThreadPool& pool = ThreadPool::shared());
+
+#pragma region DepthPyramid {
+
+inline void DepthPyramid::build(const float* depth, uint32_t width, uint32_t height, ThreadPool& pool)
+{
+	_levels.clear();
+	_widths.clear();
+	_heights.clear();
+	if (width == 0 || height == 0) {
+		return;
+	}
+	_levels.emplace_back(depth, depth + size_t(width) * height);
+	_widths.push_back(width);
+	_heights.push_back(height);
+	// 홀수 크기는 올림으로 줄이고 마지막 texel이 남은 한 줄을 함께 덮는다.
+	while (width > 1 || height > 1) {
+		uint32_t nextWidth = std::max(1u, (width + 1) / 2), nextHeight = std::max(1u, (height + 1) / 2);
+		const std::vector<float>& source = _levels.back();
+		std::vector<float> level(size_t(nextWidth) * nextHeight);
+		pool.parallelFor(nextHeight, std::max<size_t>(1, 4096 / nextWidth), [&](size_t begin, size_t end) {
+			for (size_t y = begin; y < end; ++y) {
+				size_t y0 = std::min<size_t>(y * 2, height - 1), y1 = std::min<size_t>(y * 2 + 1, height - 1);
+				for (size_t x = 0; x < nextWidth; ++x) {
+					size_t x0 = std::min<size_t>(x * 2, width - 1), x1 = std::min<size_t>(x * 2 + 1, width - 1);
+					level[y * nextWidth + x] = std::max(std::max(source[y0 * width + x0], source[y0 * width + x1]),
+						std::max(source[y1 * width + x0], source[y1 * width + x1]));
+				}
+			}
+		});
+		_levels.push_back(std::move(level));
+		_widths.push_back(width = nextWidth);
+		_heights.push_back(height = nextHeight);
+	}
+}
+
+inline float DepthPyramid::farthestDepth(int32_t x0, int32_t y0, int32_t x1, int32_t y1) const
+{
+	// 사각형이 texel 2개 이하로 들어오는 가장 세밀한 단계를 고른다.
+	uint32_t level = 0;
+	while (level + 1 < _levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+		++level;
+	}
+	int32_t lastX = int32_t(_widths[level]) - 1, lastY = int32_t(_heights[level]) - 1;
+	int32_t tx0 = std::min(x0 >> level, lastX), tx1 = std::min(x1 >> level, lastX);
+	int32_t ty0 = std::min(y0 >> level, lastY), ty1 = std::min(y1 >> level, lastY);
+	float farthest = 0.0f;
+	for (int32_t y = ty0; y <= ty1; ++y) {
+		for (int32_t x = tx0; x <= tx1; ++x) {
+			farthest = std::max(farthest, at(level, x, y));
+		}
+	}
+	return farthest;
+}
+
+#pragma endregion DepthPyramid }
+
+#pragma region OccluderRasterizer {
+
+inline OccluderRasterizer::OccluderRasterizer(uint32_t width, uint32_t height)
+: _width(std::max(1u, width)), _height(std::max(1u, height)), _depth(size_t(_width) * _height, 1.0f)
+{
+}
+
+inline void OccluderRasterizer::clear()
+{
+	std::fill(_depth.begin(), _depth.end(), 1.0f);
+	_numberOfRasterizedTriangles = 0;
+}
+
+inline void OccluderRasterizer::rasterize(const BvhTriangleGeometry& geometry, const Float4x4& modelViewProjection, ThreadPool& pool)
+{
+	const size_t count = geometry.triangleCount;
+	const float halfWidth = _width * 0.5f, halfHeight = _height * 0.5f;
+
+	// 1. 삼각형 setup. near plane에 걸치거나 화면을 벗어난 삼각형은 빼도 더 가리는 일이 없으므로 버린다.
+	_triangles.resize(count);
+	std::vector<uint8_t> kept(count);
+	pool.parallelFor(count, 1 << 12, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t) {
+			kept[t] = 0;
+			float x[3], y[3], z[3];
+			bool behind = false;
+			for (int corner = 0; corner < 3; ++corner) {
+				Float3 p = BvhDetail::vertexAt(geometry, t, corner);
+				Float4 clip = modelViewProjection * Float4{ p.x, p.y, p.z, 1.0f };
+				if (clip.w <= 1e-6f || clip.z < 0.0f) {
+					behind = true;
+					break;
+				}
+				float inverseW = 1.0f / clip.w;
+				// NDC y는 위쪽이 +이므로 행 번호로 바꿀 때 뒤집는다.
+				x[corner] = (clip.x * inverseW + 1.0f) * halfWidth;
+				y[corner] = (1.0f - clip.y * inverseW) * halfHeight;
+				z[corner] = clip.z * inverseW;
+			}
+			if (behind) {
+				continue;
+			}
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (std::fabs(area) < 1e-8f) {
+				continue;
+			}
+			ScreenTriangle& triangle = _triangles[t];
+			float sign = area > 0.0f ? 1.0f : -1.0f;
+			for (int e = 0; e < 3; ++e) {
+				int a = e, b = (e + 1) % 3;
+				triangle.edgeA[e] = sign * (y[a] - y[b]);
+				triangle.edgeB[e] = sign * (x[b] - x[a]);
+				triangle.edgeC[e] = sign * (x[a] * y[b] - x[b] * y[a]);
+			}
+			// depth 평면
+			float inverseArea = 1.0f / area;
+			triangle.zA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * inverseArea;
+			triangle.zB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * inverseArea;
+			triangle.zC = z[0] - triangle.zA * x[0] - triangle.zB * y[0];
+			triangle.minX = std::max(0, int32_t(std::floor(std::min({ x[0], x[1], x[2] }))));
+			triangle.minY = std::max(0, int32_t(std::floor(std::min({ y[0], y[1], y[2] }))));
+			triangle.maxX = std::min(int32_t(_width) - 1, int32_t(std::ceil(std::max({ x[0], x[1], x[2] }))));
+			triangle.maxY = std::min(int32_t(_height) - 1, int32_t(std::ceil(std::max({ y[0], y[1], y[2] }))));
+			kept[t] = triangle.minX <= triangle.maxX && triangle.minY <= triangle.maxY;
+		}
+	});
+	size_t numberOfTriangles = 0;
+	for (size_t t = 0; t < count; ++t) {
+		if (kept[t]) {
+			_triangles[numberOfTriangles++] = _triangles[t];
+		}
+	}
+	_triangles.resize(numberOfTriangles);
+	_numberOfRasterizedTriangles += numberOfTriangles;
+
+	// 2. 화면을 가로 띠로 나누어 띠마다 모든 삼각형을 그린다. 띠끼리 pixel을 공유하지 않으므로 lock이 없다.
+	const size_t bandHeight = 8;
+	pool.parallelFor((_height + bandHeight - 1) / bandHeight, 1, [&](size_t firstBand, size_t lastBand) {
+		const int32_t bandTop = int32_t(firstBand * bandHeight), bandBottom = std::min(int32_t(lastBand * bandHeight), int32_t(_height)) - 1;
+		for (const ScreenTriangle& triangle : _triangles) {
+			int32_t top = std::max(triangle.minY, bandTop), bottom = std::min(triangle.maxY, bandBottom);
+			if (top > bottom) {
+				continue;
+			}
+			// pixel 전체가 안쪽인지 보려면 중심에서 edge 기울기의 절반만큼 여유를 둔다.
+			float margin[3];
+			for (int e = 0; e < 3; ++e) {
+				margin[e] = 0.5f * (std::fabs(triangle.edgeA[e]) + std::fabs(triangle.edgeB[e]));
+			}
+			// pixel 안에서 가장 먼 depth
+			float zMargin = 0.5f * (std::fabs(triangle.zA) + std::fabs(triangle.zB));
+			for (int32_t y = top; y <= bottom; ++y) {
+				// 각 edge 식을 x에 대해 풀어 이 행에서 pixel 중심이 들어가는 구간만 돈다.
+				float cy = y + 0.5f, left = float(triangle.minX), right = float(triangle.maxX);
+				for (int e = 0; e < 3; ++e) {
+					float rest = margin[e] - triangle.edgeB[e] * cy - triangle.edgeC[e];
+					if (triangle.edgeA[e] > 0.0f) {
+						left = std::max(left, std::ceil(rest / triangle.edgeA[e] - 0.5f));
+					} else if (triangle.edgeA[e] < 0.0f) {
+						right = std::min(right, std::floor(rest / triangle.edgeA[e] - 0.5f));
+					} else if (rest > 0.0f) {
+						right = left - 1.0f;
+					}
+				}
+				if (!(left <= right)) {
+					continue;
+				}
+				float* row = _depth.data() + size_t(y) * _width;
+				float z = triangle.zA * (left + 0.5f) + triangle.zB * cy + triangle.zC + zMargin;
+				for (int32_t x = int32_t(left); x <= int32_t(right); ++x, z += triangle.zA) {
+					row[x] = std::min(row[x], z);
+				}
+			}
+		}
+	});
+}
+
+#pragma endregion OccluderRasterizer }
+
+#pragma region OcclusionTest {
+
+inline OcclusionStats testOcclusion(const DepthPyramid& pyramid, const Float4x4& viewProjection, const Aabb* bounds, size_t count,
+		uint8_t* visible, ThreadPool& pool)
+{
+	OcclusionStats stats;
+	stats.tested = count;
+	if (pyramid.numberOfLevels() == 0) {
+		std::fill(visible, visible + count, uint8_t(1));
+		stats.visible = count;
+		return stats;
+	}
+	const float width = float(pyramid.width()), height = float(pyramid.height());
+	const size_t grain = 1 << 12;
+	std::vector<OcclusionStats> partial((count + grain - 1) / grain);
+	pool.parallelFor(count, grain, [&](size_t begin, size_t end) {
+		OcclusionStats& local = partial[begin / grain];
+		const Float4* m = viewProjection.columns;
+		for (size_t first = begin; first < end; first += 4) {
+			const size_t lanes = std::min<size_t>(4, end - first);
+			// 4개 box를 SoA로 모은다. 남는 lane은 첫 box를 반복한다.
+			float boxes[6][4];
+			for (size_t lane = 0; lane < 4; ++lane) {
+				const Aabb& box = bounds[first + (lane < lanes ? lane : 0)];
+				boxes[0][lane] = box.min.x; boxes[1][lane] = box.min.y; boxes[2][lane] = box.min.z;
+				boxes[3][lane] = box.max.x; boxes[4][lane] = box.max.y; boxes[5][lane] = box.max.z;
+			}
+			Lanes4 minX = Lanes4::splat(INFINITY), minY = Lanes4::splat(INFINITY), minZ = Lanes4::splat(INFINITY);
+			Lanes4 maxX = Lanes4::splat(-INFINITY), maxY = Lanes4::splat(-INFINITY), minW = Lanes4::splat(INFINITY);
+			for (int corner = 0; corner < 8; ++corner) {
+				Lanes4 x = Lanes4::load(boxes[corner & 1 ? 3 : 0]);
+				Lanes4 y = Lanes4::load(boxes[corner & 2 ? 4 : 1]);
+				Lanes4 z = Lanes4::load(boxes[corner & 4 ? 5 : 2]);
+				Lanes4 clipX = Lanes4::splat(m[0].x) * x + Lanes4::splat(m[1].x) * y + Lanes4::splat(m[2].x) * z + Lanes4::splat(m[3].x);
+				Lanes4 clipY = Lanes4::splat(m[0].y) * x + Lanes4::splat(m[1].y) * y + Lanes4::splat(m[2].y) * z + Lanes4::splat(m[3].y);
+				Lanes4 clipZ = Lanes4::splat(m[0].z) * x + Lanes4::splat(m[1].z) * y + Lanes4::splat(m[2].z) * z + Lanes4::splat(m[3].z);
+				Lanes4 clipW = Lanes4::splat(m[0].w) * x + Lanes4::splat(m[1].w) * y + Lanes4::splat(m[2].w) * z + Lanes4::splat(m[3].w);
+				minW = min(minW, clipW);
+				// w가 0 이하인 corner는 아래에서 box 전체를 보이는 것으로 처리하므로 나눈 값은 쓰이지 않는다.
+				Lanes4 inverseW = Lanes4::splat(1.0f) / max(clipW, Lanes4::splat(1e-6f));
+				Lanes4 ndcX = clipX * inverseW, ndcY = clipY * inverseW;
+				minX = min(minX, ndcX); maxX = max(maxX, ndcX);
+				minY = min(minY, ndcY); maxY = max(maxY, ndcY);
+				minZ = min(minZ, clipZ * inverseW);
+			}
+			float nearW[4], left[4], right[4], bottom[4], top[4], nearest[4];
+			store(nearW, minW);
+			store(left, minX); store(right, maxX);
+			store(bottom, minY); store(top, maxY);
+			store(nearest, minZ);
+
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				uint8_t& result = visible[first + lane];
+				// camera 평면에 걸치면 투영이 뒤집히므로 보인다고 본다.
+				if (nearW[lane] <= 1e-6f || nearest[lane] <= 0.0f) {
+					result = 1;
+					++local.visible;
+					continue;
+				}
+				if (right[lane] < -1.0f || left[lane] > 1.0f || top[lane] < -1.0f || bottom[lane] > 1.0f || nearest[lane] > 1.0f) {
+					result = 0;
+					++local.outside;
+					continue;
+				}
+				// NDC -> pixel. 행 번호는 위에서부터 센다.
+				int32_t x0 = std::max(0, int32_t((left[lane] + 1.0f) * 0.5f * width));
+				int32_t x1 = std::min(int32_t(width) - 1, int32_t((right[lane] + 1.0f) * 0.5f * width));
+				int32_t y0 = std::max(0, int32_t((1.0f - top[lane]) * 0.5f * height));
+				int32_t y1 = std::min(int32_t(height) - 1, int32_t((1.0f - bottom[lane]) * 0.5f * height));
+				result = nearest[lane] <= pyramid.farthestDepth(x0, y0, x1, y1);
+				++(result ? local.visible : local.occluded);
+			}
+		}
+	});
+	for (const OcclusionStats& local : partial) {
+		stats.outside += local.outside;
+		stats.occluded += local.occluded;
+		stats.visible += local.visible;
+	}
+	return stats;
+}
+
+#pragma endregion OcclusionTest }
@@ -0,0 +1,284 @@
+/*
+ * ParallelPrimitives.hpp
+ *
+ * 병렬 기본 연산의 CPU 구현. exclusive scan, stream compaction, histogram, radix sort(key / key-value).
+ * ComputePrimitives.hpp(build/parallel.metal의 compute kernel)와 bit 단위로 같은 결과를 내는 기준이다.
+ * 정수 덧셈은 순서와 상관없이 같고(2^32로 감싸짐), compaction과 sort는 stable하므로 답이 하나뿐이다.
+ *
+ * 모두 thread pool에서 구간별로 나눠 (1) 구간마다 세고 (2) 구간 사이의 prefix를 구한 뒤 (3) 다시 구간마다 쓴다.
+ * scan의 구간 안 prefix는 SSE2 / NEON으로 4개씩 구한다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+#if SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+// output[i] = input[0] + ... + input[i - 1]. input과 output이 같아도 된다. 전체 합을 돌려준다.
+uint32_t exclusiveScan(const uint32_t* input, uint32_t* output, size_t count, ThreadPool& pool = ThreadPool::shared());
+// flags[i]가 0이 아닌 values[i]만 순서대로 output에 모은다. 모은 수를 돌려준다.
+size_t compact(const uint32_t* values, const uint8_t* flags, size_t count, uint32_t* output, ThreadPool& pool = ThreadPool::shared());
+// bins[v]에 v의 개수를 센다. numberOfBins 이상인 값은 세지 않는다.
+void histogram(const uint32_t* values, size_t count, uint32_t* bins, uint32_t numberOfBins, ThreadPool& pool = ThreadPool::shared());
+// 오름차순 LSD radix sort. 같은 key는 원래 순서를 지킨다.
+void radixSort(std::vector<uint32_t>& keys, ThreadPool& pool = ThreadPool::shared());
+void radixSortPairs(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, ThreadPool& pool = ThreadPool::shared());
+
+// float를 uint32_t 순서로 바꾼다. 음수까지 숫자 순서와 같다. (NaN은 끝으로 간다)
+inline uint32_t sortableFloatBits(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+#pragma region ParallelPrimitives {
+
+namespace ParallelPrimitivesDetail {
+
+// 구간 하나가 너무 작으면 구간 사이를 합치는 비용이 더 크다.
+inline size_t numberOfChunks(size_t count, ThreadPool& pool)
+{
+	return std::max<size_t>(1, std::min<size_t>(size_t(pool.size()) * 4, count / 16384));
+}
+
+// 구간 안의 exclusive scan. offset에서 시작한다.
+inline void scanChunk(const uint32_t* input, uint32_t* output, size_t count, uint32_t offset)
+{
+	size_t i = 0;
+#if SIMD_SSE
+	__m128i carry = _mm_set1_epi32(int(offset));
+	for (; i + 4 <= count; i += 4) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+		// inclusive prefix: x + (x << 1 lane) + (x << 2 lanes)
+		__m128i inclusive = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+		inclusive = _mm_add_epi32(inclusive, _mm_slli_si128(inclusive, 8));
+		__m128i exclusive = _mm_add_epi32(carry, _mm_sub_epi32(inclusive, x));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), exclusive);
+		carry = _mm_add_epi32(carry, _mm_shuffle_epi32(inclusive, _MM_SHUFFLE(3, 3, 3, 3)));
+	}
+	offset = uint32_t(_mm_cvtsi128_si32(carry));
+#elif SIMD_NEON
+	const uint32x4_t zero = vdupq_n_u32(0);
+	uint32x4_t carry = vdupq_n_u32(offset);
+	for (; i + 4 <= count; i += 4) {
+		uint32x4_t x = vld1q_u32(input + i);
+		uint32x4_t inclusive = vaddq_u32(x, vextq_u32(zero, x, 3));
+		inclusive = vaddq_u32(inclusive, vextq_u32(zero, inclusive, 2));
+		vst1q_u32(output + i, vaddq_u32(carry, vsubq_u32(inclusive, x)));
+		carry = vaddq_u32(carry, vdupq_n_u32(vgetq_lane_u32(inclusive, 3)));
+	}
+	offset = vgetq_lane_u32(carry, 0);
+#endif
+	for (; i < count; ++i) {
+		uint32_t value = input[i];
+		output[i] = offset;
+		offset += value;
+	}
+}
+
+inline uint32_t sumChunk(const uint32_t* input, size_t count)
+{
+	// 4개로 나눠 더하면 compiler가 vector 덧셈으로 바꾼다.
+	uint32_t sums[4] = {};
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		sums[0] += input[i];
+		sums[1] += input[i + 1];
+		sums[2] += input[i + 2];
+		sums[3] += input[i + 3];
+	}
+	for (; i < count; ++i) {
+		sums[0] += input[i];
+	}
+	return sums[0] + sums[1] + sums[2] + sums[3];
+}
+
+/*
+ * 8 bit씩 4번 도는 LSD radix sort. 구간별 histogram -> (digit, 구간) 순서의 prefix -> scatter.
+ * 모든 key가 같은 digit을 갖는 pass는 건너뛴다. values가 nullptr이면 key만 옮긴다.
+ * */
+inline void radixSort(std::vector<uint32_t>& keys, std::vector<uint32_t>* values, ThreadPool& pool)
+{
+	constexpr int kBits = 8;
+	constexpr size_t kRadix = size_t(1) << kBits;
+	const size_t count = keys.size();
+	if (count < 2) {
+		return;
+	}
+	uint32_t allOr = 0, allAnd = ~0u;
+	for (uint32_t key : keys) {
+		allOr |= key;
+		allAnd &= key;
+	}
+	const uint32_t differing = allOr ^ allAnd;
+
+	const size_t chunks = numberOfChunks(count, pool);
+	const size_t chunkSize = (count + chunks - 1) / chunks;
+	std::vector<uint32_t> histograms(chunks * kRadix);
+	std::vector<uint32_t> keyScratch(count), valueScratch(values ? count : 0);
+	uint32_t* sourceKeys = keys.data();
+	uint32_t* destinationKeys = keyScratch.data();
+	uint32_t* sourceValues = values ? values->data() : nullptr;
+	uint32_t* destinationValues = values ? valueScratch.data() : nullptr;
+	for (int shift = 0; shift < 32; shift += kBits) {
+		if (((differing >> shift) & (kRadix - 1)) == 0) {
+			continue;
+		}
+		pool.parallelFor(chunks, 1, [&](size_t first, size_t last) {
+			for (size_t chunk = first; chunk < last; ++chunk) {
+				uint32_t* histogram = histograms.data() + chunk * kRadix;
+				std::fill(histogram, histogram + kRadix, 0u);
+				const size_t end = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < end; ++i) {
+					++histogram[(sourceKeys[i] >> shift) & (kRadix - 1)];
+				}
+			}
+		});
+		uint32_t offset = 0;
+		for (size_t digit = 0; digit < kRadix; ++digit) {
+			for (size_t chunk = 0; chunk < chunks; ++chunk) {
+				uint32_t& slot = histograms[chunk * kRadix + digit];
+				uint32_t n = slot;
+				slot = offset;
+				offset += n;
+			}
+		}
+		pool.parallelFor(chunks, 1, [&](size_t first, size_t last) {
+			for (size_t chunk = first; chunk < last; ++chunk) {
+				uint32_t* cursor = histograms.data() + chunk * kRadix;
+				const size_t end = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < end; ++i) {
+					const uint32_t position = cursor[(sourceKeys[i] >> shift) & (kRadix - 1)]++;
+					destinationKeys[position] = sourceKeys[i];
+					if (sourceValues) {
+						destinationValues[position] = sourceValues[i];
+					}
+				}
+			}
+		});
+		std::swap(sourceKeys, destinationKeys);
+		std::swap(sourceValues, destinationValues);
+	}
+	if (sourceKeys != keys.data()) {
+		keys.swap(keyScratch);
+		if (values) {
+			values->swap(valueScratch);
+		}
+	}
+}
+
+} // namespace ParallelPrimitivesDetail
+
+inline uint32_t exclusiveScan(const uint32_t* input, uint32_t* output, size_t count, ThreadPool& pool)
+{
+	using namespace ParallelPrimitivesDetail;
+	const size_t chunks = numberOfChunks(count, pool);
+	const size_t chunkSize = (count + chunks - 1) / chunks;
+	std::vector<uint32_t> offsets(chunks + 1, 0);
+	pool.parallelFor(chunks, 1, [&](size_t first, size_t last) {
+		for (size_t chunk = first; chunk < last; ++chunk) {
+			const size_t begin = std::min(count, chunk * chunkSize);
+			offsets[chunk + 1] = sumChunk(input + begin, std::min(count, begin + chunkSize) - begin);
+		}
+	});
+	for (size_t chunk = 0; chunk < chunks; ++chunk) {
+		offsets[chunk + 1] += offsets[chunk];
+	}
+	pool.parallelFor(chunks, 1, [&](size_t first, size_t last) {
+		for (size_t chunk = first; chunk < last; ++chunk) {
+			const size_t begin = std::min(count, chunk * chunkSize);
+			scanChunk(input + begin, output + begin, std::min(count, begin + chunkSize) - begin, offsets[chunk]);
+		}
+	});
+	return offsets[chunks];
+}
+
+inline size_t compact(const uint32_t* values, const uint8_t* flags, size_t count, uint32_t* output, ThreadPool& pool)
+{
+	using namespace ParallelPrimitivesDetail;
+	const size_t chunks = numberOfChunks(count, pool);
+	const size_t chunkSize = (count + chunks - 1) / chunks;
+	std::vector<size_t> offsets(chunks + 1, 0);
+	pool.parallelFor(chunks, 1, [&](size_t first, size_t last) {
+		for (size_t chunk = first; chunk < last; ++chunk) {
+			const size_t end = std::min(count, (chunk + 1) * chunkSize);
+			size_t kept = 0;
+			for (size_t i = chunk * chunkSize; i < end; ++i) {
+				kept += flags[i] != 0;
+			}
+			offsets[chunk + 1] = kept;
+		}
+	});
+	for (size_t chunk = 0; chunk < chunks; ++chunk) {
+		offsets[chunk + 1] += offsets[chunk];
+	}
+	pool.parallelFor(chunks, 1, [&](size_t first, size_t last) {
+		for (size_t chunk = first; chunk < last; ++chunk) {
+			const size_t end = std::min(count, (chunk + 1) * chunkSize);
+			uint32_t* cursor = output + offsets[chunk];
+			for (size_t i = chunk * chunkSize; i < end; ++i) {
+				if (flags[i]) {
+					*cursor++ = values[i];
+				}
+			}
+		}
+	});
+	return offsets[chunks];
+}
+
+inline void histogram(const uint32_t* values, size_t count, uint32_t* bins, uint32_t numberOfBins, ThreadPool& pool)
+{
+	using namespace ParallelPrimitivesDetail;
+	const size_t chunks = numberOfChunks(count, pool);
+	const size_t chunkSize = (count + chunks - 1) / chunks;
+	// 같은 bin을 연달아 올리면 store -> load가 기다리므로 구간마다 histogram 4벌을 번갈아 쓴다.
+	// 범위 밖의 값은 분기 없이 각 벌의 마지막 칸(numberOfBins)에 버린다.
+	const size_t stride = size_t(numberOfBins) + 1;
+	std::vector<uint32_t> partial(chunks * 4 * stride);
+	pool.parallelFor(chunks, 1, [&](size_t first, size_t last) {
+		for (size_t chunk = first; chunk < last; ++chunk) {
+			uint32_t* copies = partial.data() + chunk * 4 * stride;
+			const size_t end = std::min(count, (chunk + 1) * chunkSize);
+			size_t i = chunk * chunkSize;
+			for (; i + 4 <= end; i += 4) {
+				for (size_t lane = 0; lane < 4; ++lane) {
+					++copies[lane * stride + std::min(values[i + lane], numberOfBins)];
+				}
+			}
+			for (; i < end; ++i) {
+				++copies[std::min(values[i], numberOfBins)];
+			}
+		}
+	});
+	pool.parallelFor(numberOfBins, 1024, [&](size_t first, size_t last) {
+		for (size_t bin = first; bin < last; ++bin) {
+			uint32_t sum = 0;
+			for (size_t copy = 0; copy < chunks * 4; ++copy) {
+				sum += partial[copy * stride + bin];
+			}
+			bins[bin] = sum;
+		}
+	});
+}
+
+inline void radixSort(std::vector<uint32_t>& keys, ThreadPool& pool)
+{
+	ParallelPrimitivesDetail::radixSort(keys, nullptr, pool);
+}
+
+inline void radixSortPairs(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, ThreadPool& pool)
+{
+	ParallelPrimitivesDetail::radixSort(keys, &values, pool);
+}
+
+#pragma endregion ParallelPrimitives }
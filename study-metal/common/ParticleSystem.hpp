@@ -0,0 +1,448 @@
+/*
+ * ParticleSystem.hpp
+ *
+ * Particle 생성, 시뮬레이션, alpha blending을 위한 깊이 정렬. 수백만 개까지 thread pool에서 돈다.
+ * 성분마다 따로 연속된 배열(SoA)에 두고 frame마다
+ *   1. emitter가 비율만큼 새 particle을 끝에 붙인다. (난수는 일련번호의 hash라서 thread 수와 상관없이 같다)
+ *   2. 위치를 uniform grid cell의 key(Morton code를 table 크기로 자른 것)로 바꿔 radix sort 하고 그 순서로 배열을 다시 놓는다.
+ *      죽은 것은 끝으로 가서 빠진다. 같은 cell의 particle이 연속되므로 cell마다 [시작, 끝)만 알면 된다.
+ *   3. 둘레 27개 cell의 particle을 모아 Lanes8로 8개씩 밀어내는 힘을 더하고, 중력 / 저항 / 바닥과 함께 적분한다.
+ * 그리기 전에 viewProjection의 깊이로 먼 것부터 정렬하고 그 순서로 ParticleInstance를 채운다.
+ * 밀어내는 힘은 interactionRadius 안에서 (r^2 - d^2) * d 이라 sqrt가 필요 없고 경계에서 0이 된다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "MathTypes.hpp"
+#include "ParallelPrimitives.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+struct ParticleEmitter {
+	// position을 중심으로 radius 구 안에서 생긴다.
+	Float3 position{0.0f, 0.0f, 0.0f};
+	float radius{0.05f};
+	// 처음 속도. velocityJitter 반지름의 구 안에서 흔든다.
+	Float3 velocity{0.0f, 1.0f, 0.0f};
+	float velocityJitter{0.2f};
+	// 초당 생성 수
+	float rate{1000.0f};
+	float lifetime{2.0f};
+	float lifetimeJitter{0.5f};
+	Float4 color{1.0f, 1.0f, 1.0f, 1.0f};
+	float size{0.01f};
+};
+
+struct ParticleSimulationParams {
+	Float3 gravity{0.0f, -9.8f, 0.0f};
+	// 초당 속도가 줄어드는 비율
+	float drag{0.1f};
+	// grid cell의 크기이자 서로 밀어내는 거리
+	float interactionRadius{0.05f};
+	float stiffness{2000.0f};
+	// 이보다 아래로 내려가면 튕긴다.
+	float floorHeight{-1.0f};
+	float restitution{0.5f};
+};
+
+struct ParticleUpdateStats {
+	size_t emitted{0};
+	size_t expired{0};
+	size_t alive{0};
+	// 거리를 잰 이웃 후보 수의 합
+	size_t neighbourCandidates{0};
+};
+
+// GPU로 보내는 instance 하나. build/shader.metal의 ParticleInstance와 같은 20 byte 배치
+struct ParticleInstance {
+	PackedFloat3 position;
+	float size;
+	// RGBA8. r이 가장 낮은 byte (unpack_unorm4x8_to_float)
+	uint32_t color;
+};
+
+static_assert(sizeof(ParticleInstance) == 20, "ParticleInstance must match the MSL layout");
+
+struct ParticleArrays {
+	std::vector<float> x, y, z, velocityX, velocityY, velocityZ, age, lifetime, size;
+	std::vector<uint32_t> color;
+
+	void resize(size_t count);
+};
+
+class ParticleSystem {
+	public:
+		explicit ParticleSystem(size_t capacity);
+
+		std::vector<ParticleEmitter> emitters;
+		ParticleSimulationParams params;
+
+		// dt초만큼 생성, 정렬, 시뮬레이션을 한다.
+		ParticleUpdateStats update(float dt, ThreadPool& pool = ThreadPool::shared());
+		// viewProjection의 깊이(z / w)가 먼 것부터 drawOrder()를 만든다.
+		void sortForBlending(const Float4x4& viewProjection, ThreadPool& pool = ThreadPool::shared());
+		// drawOrder() 순서로 instances[0, size())를 채운다. update 뒤에 정렬하지 않았으면 cell 순서이다. 나이가 들수록 alpha가 줄어든다.
+		void writeInstances(ParticleInstance* instances, ThreadPool& pool = ThreadPool::shared()) const;
+
+		size_t size() const { return _count; }
+		size_t capacity() const { return _capacity; }
+		// [0, size())가 grid cell 순서로 놓여 있다.
+		const ParticleArrays& particles() const { return _current; }
+		const std::vector<uint32_t>& drawOrder() const { return _drawOrder; }
+
+	private:
+		static constexpr uint32_t kDead = 0xFFFFFFFFu;
+		static constexpr uint32_t kEmptyCell = 0xFFFFFFFFu;
+		// particle 하나가 보는 이웃 후보 수의 상한. 한 곳에 몰려도 비용이 폭발하지 않는다.
+		static constexpr size_t kMaxNeighbours = 192;
+
+		size_t emit(float dt);
+		void sortIntoCells(ThreadPool& pool);
+		size_t simulate(float dt, ThreadPool& pool);
+		// cell 좌표의 Morton code를 table 크기로 자른 것. 가까운 cell이 table과 배열에서도 가깝다.
+		// 멀리 떨어진 cell이 같은 칸에 겹칠 수 있지만 거리로 다시 거른다.
+		uint32_t cellKey(int32_t x, int32_t y, int32_t z) const;
+
+		size_t _capacity;
+		size_t _count{0};
+		// 지금까지 생성한 수. 난수의 seed이다.
+		uint32_t _serial{0};
+		std::vector<float> _emitCarry;
+		// 8개씩 읽을 수 있도록 capacity를 8의 배수로 올린 길이
+		ParticleArrays _current, _next;
+		std::vector<uint32_t> _keys, _order;
+		// table 크기는 2의 거듭제곱. cellKey -> [start, end)
+		uint32_t _tableMask{0};
+		std::vector<uint32_t> _cellStart, _cellEnd;
+		std::vector<uint32_t> _depthKeys, _drawOrder;
+		// update 뒤에 sortForBlending을 불렀는가
+		bool _sortedForBlending{false};
+};
+
+#pragma region ParticleSystem {
+
+namespace particle_system_detail {
+
+inline uint32_t hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7FEB352Du;
+	x ^= x >> 15;
+	x *= 0x846CA68Bu;
+	x ^= x >> 16;
+	return x;
+}
+
+// [0, 1)
+inline float random(uint32_t& state)
+{
+	state = hash(state + 0x9E3779B9u);
+	return float(state >> 8) * (1.0f / 16777216.0f);
+}
+
+inline Float3 randomInUnitSphere(uint32_t& state)
+{
+	for (;;) {
+		Float3 p = { random(state) * 2.0f - 1.0f, random(state) * 2.0f - 1.0f, random(state) * 2.0f - 1.0f };
+		if (dot(p, p) <= 1.0f) {
+			return p;
+		}
+	}
+}
+
+inline uint32_t packColor(Float4 color)
+{
+	auto channel = [](float c) { return uint32_t(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f); };
+	return channel(color.x) | channel(color.y) << 8 | channel(color.z) << 16 | channel(color.w) << 24;
+}
+
+// 낮은 10 bit를 3칸마다 하나씩 펼친다. (Morton code)
+inline uint32_t spreadBits(uint32_t v)
+{
+	v &= 0x3FFu;
+	v = (v | v << 16) & 0x030000FFu;
+	v = (v | v << 8) & 0x0300F00Fu;
+	v = (v | v << 4) & 0x030C30C3u;
+	v = (v | v << 2) & 0x09249249u;
+	return v;
+}
+
+inline int32_t cellOf(float position, float inverseCellSize)
+{
+	return int32_t(std::floor(position * inverseCellSize));
+}
+
+} // namespace particle_system_detail
+
+inline void ParticleArrays::resize(size_t count)
+{
+	for (std::vector<float>* lane : { &x, &y, &z, &velocityX, &velocityY, &velocityZ, &age, &lifetime, &size }) {
+		lane->resize(count, 0.0f);
+	}
+	color.resize(count, 0);
+}
+
+inline ParticleSystem::ParticleSystem(size_t capacity)
+: _capacity(capacity)
+{
+	const size_t padded = (capacity + 7) & ~size_t(7);
+	_current.resize(padded);
+	_next.resize(padded);
+}
+
+inline uint32_t ParticleSystem::cellKey(int32_t x, int32_t y, int32_t z) const
+{
+	using particle_system_detail::spreadBits;
+	return (spreadBits(uint32_t(x)) | spreadBits(uint32_t(y)) << 1 | spreadBits(uint32_t(z)) << 2) & _tableMask;
+}
+
+inline size_t ParticleSystem::emit(float dt)
+{
+	using namespace particle_system_detail;
+	_emitCarry.resize(emitters.size(), 0.0f);
+	size_t emitted = 0;
+	for (size_t e = 0; e < emitters.size(); ++e) {
+		const ParticleEmitter& emitter = emitters[e];
+		_emitCarry[e] += emitter.rate * dt;
+		const size_t wanted = size_t(_emitCarry[e]);
+		_emitCarry[e] -= float(wanted);
+		const size_t count = std::min(wanted, _capacity - _count);
+		const uint32_t color = packColor(emitter.color);
+		for (size_t k = 0; k < count; ++k) {
+			uint32_t state = hash(_serial++);
+			const Float3 offset = randomInUnitSphere(state) * emitter.radius;
+			const Float3 jitter = randomInUnitSphere(state) * emitter.velocityJitter;
+			const size_t i = _count++;
+			_current.x[i] = emitter.position.x + offset.x;
+			_current.y[i] = emitter.position.y + offset.y;
+			_current.z[i] = emitter.position.z + offset.z;
+			_current.velocityX[i] = emitter.velocity.x + jitter.x;
+			_current.velocityY[i] = emitter.velocity.y + jitter.y;
+			_current.velocityZ[i] = emitter.velocity.z + jitter.z;
+			_current.age[i] = 0.0f;
+			_current.lifetime[i] = std::max(1e-3f, emitter.lifetime + (random(state) * 2.0f - 1.0f) * emitter.lifetimeJitter);
+			_current.size[i] = emitter.size;
+			_current.color[i] = color;
+		}
+		emitted += count;
+	}
+	return emitted;
+}
+
+inline void ParticleSystem::sortIntoCells(ThreadPool& pool)
+{
+	using namespace particle_system_detail;
+	const size_t count = _count;
+	// 차지한 cell 수보다 넉넉해야 서로 다른 cell이 같은 칸에 덜 겹친다.
+	uint32_t tableSize = 1024;
+	while (tableSize < 2 * count && tableSize < (1u << 30)) {
+		tableSize <<= 1;
+	}
+	_tableMask = tableSize - 1;
+	const float inverseCellSize = 1.0f / params.interactionRadius;
+	_keys.resize(count);
+	_order.resize(count);
+	pool.parallelFor(count, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			_order[i] = uint32_t(i);
+			_keys[i] = _current.age[i] < _current.lifetime[i] ? cellKey(cellOf(_current.x[i], inverseCellSize),
+					cellOf(_current.y[i], inverseCellSize), cellOf(_current.z[i], inverseCellSize)) : kDead;
+		}
+	});
+	radixSortPairs(_keys, _order, pool);
+	pool.parallelFor(count, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const uint32_t j = _order[i];
+			_next.x[i] = _current.x[j];
+			_next.y[i] = _current.y[j];
+			_next.z[i] = _current.z[j];
+			_next.velocityX[i] = _current.velocityX[j];
+			_next.velocityY[i] = _current.velocityY[j];
+			_next.velocityZ[i] = _current.velocityZ[j];
+			_next.age[i] = _current.age[j];
+			_next.lifetime[i] = _current.lifetime[j];
+			_next.size[i] = _current.size[j];
+			_next.color[i] = _current.color[j];
+		}
+	});
+	std::swap(_current, _next);
+	_count = size_t(std::lower_bound(_keys.begin(), _keys.end(), kDead) - _keys.begin());
+
+	_cellStart.assign(tableSize, kEmptyCell);
+	_cellEnd.resize(tableSize);
+	pool.parallelFor(_count, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const uint32_t key = _keys[i];
+			if (i == 0 || _keys[i - 1] != key) {
+				_cellStart[key] = uint32_t(i);
+			}
+			if (i + 1 == _count || _keys[i + 1] != key) {
+				_cellEnd[key] = uint32_t(i + 1);
+			}
+		}
+	});
+}
+
+inline size_t ParticleSystem::simulate(float dt, ThreadPool& pool)
+{
+	using namespace particle_system_detail;
+	const ParticleSimulationParams p = params;
+	const float radius = p.interactionRadius;
+	const float inverseCellSize = 1.0f / radius;
+	const float forceScale = p.stiffness / (radius * radius);
+	const float damping = 1.0f / (1.0f + p.drag * dt);
+	// 이웃 후보를 8의 배수로 채우는 먼 위치. 거리 제곱이 radius^2보다 커서 힘이 0이 된다.
+	const float far = 1e18f;
+	std::atomic<size_t> candidates{0};
+	pool.parallelFor(_count, 1024, [&](size_t begin, size_t end) {
+		// 8개씩 읽을 수 있도록 끝을 먼 위치로 채울 자리를 둔다.
+		alignas(32) float neighbourX[kMaxNeighbours + 8], neighbourY[kMaxNeighbours + 8], neighbourZ[kMaxNeighbours + 8];
+		size_t tested = 0, numberOfNeighbours = 0, padded = 0;
+		bool gathered = false;
+		int32_t lastX = 0, lastY = 0, lastZ = 0;
+		for (size_t i = begin; i < end; ++i) {
+			const float x = _current.x[i], y = _current.y[i], z = _current.z[i];
+			const int32_t cellX = cellOf(x, inverseCellSize), cellY = cellOf(y, inverseCellSize), cellZ = cellOf(z, inverseCellSize);
+			// 같은 cell의 particle은 연속되어 있고 이웃 후보도 같으므로 cell이 바뀔 때만 다시 모은다.
+			if (!gathered || cellX != lastX || cellY != lastY || cellZ != lastZ) {
+				gathered = true;
+				lastX = cellX;
+				lastY = cellY;
+				lastZ = cellZ;
+				// table이 1024칸 이상이면 축마다 8 cell 이상 떨어져야 겹치므로 27개 cell의 key는 서로 다르다.
+				// 축마다 세 좌표를 먼저 펼쳐 두고 27개 key는 OR로 만든다.
+				uint32_t spreadX[3], spreadY[3], spreadZ[3];
+				for (int32_t d = 0; d < 3; ++d) {
+					spreadX[d] = spreadBits(uint32_t(cellX + d - 1));
+					spreadY[d] = spreadBits(uint32_t(cellY + d - 1)) << 1;
+					spreadZ[d] = spreadBits(uint32_t(cellZ + d - 1)) << 2;
+				}
+				numberOfNeighbours = 0;
+				for (int32_t dz = 0; dz < 3; ++dz) {
+					for (int32_t dy = 0; dy < 3; ++dy) {
+						for (int32_t dx = 0; dx < 3; ++dx) {
+							const uint32_t cell = (spreadX[dx] | spreadY[dy] | spreadZ[dz]) & _tableMask;
+							const uint32_t start = _cellStart[cell];
+							if (start == kEmptyCell) {
+								continue;
+							}
+							const uint32_t stop = _cellEnd[cell];
+							const size_t n = std::min<size_t>(stop - start, kMaxNeighbours - numberOfNeighbours);
+							std::copy_n(&_current.x[start], n, neighbourX + numberOfNeighbours);
+							std::copy_n(&_current.y[start], n, neighbourY + numberOfNeighbours);
+							std::copy_n(&_current.z[start], n, neighbourZ + numberOfNeighbours);
+							numberOfNeighbours += n;
+						}
+					}
+				}
+				padded = (numberOfNeighbours + 7) & ~size_t(7);
+				std::fill(neighbourX + numberOfNeighbours, neighbourX + padded, far);
+				std::fill(neighbourY + numberOfNeighbours, neighbourY + padded, far);
+				std::fill(neighbourZ + numberOfNeighbours, neighbourZ + padded, far);
+			}
+			tested += numberOfNeighbours;
+
+			// 자기 자신은 거리가 0이라 힘이 0이다.
+			const Lanes8 px = Lanes8::splat(x), py = Lanes8::splat(y), pz = Lanes8::splat(z);
+			const Lanes8 radiusSquared = Lanes8::splat(radius * radius), zero = Lanes8::splat(0.0f);
+			Lanes8 forceX = zero, forceY = zero, forceZ = zero;
+			for (size_t k = 0; k < padded; k += 8) {
+				const Lanes8 offsetX = px - Lanes8::load(neighbourX + k);
+				const Lanes8 offsetY = py - Lanes8::load(neighbourY + k);
+				const Lanes8 offsetZ = pz - Lanes8::load(neighbourZ + k);
+				const Lanes8 distanceSquared = multiplyAdd(offsetX, offsetX, multiplyAdd(offsetY, offsetY, offsetZ * offsetZ));
+				const Lanes8 weight = max(radiusSquared - distanceSquared, zero);
+				forceX = multiplyAdd(offsetX, weight, forceX);
+				forceY = multiplyAdd(offsetY, weight, forceY);
+				forceZ = multiplyAdd(offsetZ, weight, forceZ);
+			}
+			float lanesX[8], lanesY[8], lanesZ[8];
+			store(lanesX, forceX);
+			store(lanesY, forceY);
+			store(lanesZ, forceZ);
+			float sumX = 0.0f, sumY = 0.0f, sumZ = 0.0f;
+			for (int lane = 0; lane < 8; ++lane) {
+				sumX += lanesX[lane];
+				sumY += lanesY[lane];
+				sumZ += lanesZ[lane];
+			}
+
+			float velocityX = (_current.velocityX[i] + (p.gravity.x + sumX * forceScale) * dt) * damping;
+			float velocityY = (_current.velocityY[i] + (p.gravity.y + sumY * forceScale) * dt) * damping;
+			float velocityZ = (_current.velocityZ[i] + (p.gravity.z + sumZ * forceScale) * dt) * damping;
+			float nextY = y + velocityY * dt;
+			if (nextY < p.floorHeight) {
+				nextY = p.floorHeight;
+				velocityY = velocityY < 0.0f ? -velocityY * p.restitution : velocityY;
+			}
+			_next.x[i] = x + velocityX * dt;
+			_next.y[i] = nextY;
+			_next.z[i] = z + velocityZ * dt;
+			_next.velocityX[i] = velocityX;
+			_next.velocityY[i] = velocityY;
+			_next.velocityZ[i] = velocityZ;
+			_next.age[i] = _current.age[i] + dt;
+			_next.lifetime[i] = _current.lifetime[i];
+			_next.size[i] = _current.size[i];
+			_next.color[i] = _current.color[i];
+		}
+		candidates += tested;
+	});
+	std::swap(_current, _next);
+	return candidates;
+}
+
+inline ParticleUpdateStats ParticleSystem::update(float dt, ThreadPool& pool)
+{
+	ParticleUpdateStats stats;
+	stats.emitted = emit(dt);
+	const size_t before = _count;
+	sortIntoCells(pool);
+	stats.expired = before - _count;
+	stats.neighbourCandidates = simulate(dt, pool);
+	stats.alive = _count;
+	_sortedForBlending = false;
+	return stats;
+}
+
+inline void ParticleSystem::sortForBlending(const Float4x4& viewProjection, ThreadPool& pool)
+{
+	const Float4* c = viewProjection.columns;
+	const Float4 rowZ = { c[0].z, c[1].z, c[2].z, c[3].z };
+	const Float4 rowW = { c[0].w, c[1].w, c[2].w, c[3].w };
+	_depthKeys.resize(_count);
+	_drawOrder.resize(_count);
+	pool.parallelFor(_count, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const float x = _current.x[i], y = _current.y[i], z = _current.z[i];
+			const float clipZ = rowZ.x * x + rowZ.y * y + rowZ.z * z + rowZ.w;
+			const float clipW = rowW.x * x + rowW.y * y + rowW.z * z + rowW.w;
+			// 먼 것이 먼저 오도록 뒤집는다. 같은 깊이는 cell 순서를 지킨다.
+			_depthKeys[i] = ~sortableFloatBits(clipZ / clipW);
+			_drawOrder[i] = uint32_t(i);
+		}
+	});
+	radixSortPairs(_depthKeys, _drawOrder, pool);
+	_sortedForBlending = true;
+}
+
+inline void ParticleSystem::writeInstances(ParticleInstance* instances, ThreadPool& pool) const
+{
+	// 정렬하지 않았으면 cell 순서 그대로 쓴다.
+	const bool sorted = _sortedForBlending;
+	pool.parallelFor(_count, 4096, [&](size_t begin, size_t end) {
+		for (size_t k = begin; k < end; ++k) {
+			const uint32_t i = sorted ? _drawOrder[k] : uint32_t(k);
+			const float fade = std::max(0.0f, 1.0f - _current.age[i] / _current.lifetime[i]);
+			const uint32_t alpha = uint32_t(float(_current.color[i] >> 24) * fade + 0.5f);
+			instances[k] = { { _current.x[i], _current.y[i], _current.z[i] }, _current.size[i], (_current.color[i] & 0x00FFFFFFu) | alpha << 24 };
+		}
+	});
+}
+
+#pragma endregion ParticleSystem }
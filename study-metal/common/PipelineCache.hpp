@@ -0,0 +1,685 @@
+/*
+ * PipelineCache.hpp
+ *
+ * render pipeline state를 descriptor 내용(permutation key)으로 찾는 cache.
+ *  - PipelineKey: MTL::RenderPipelineDescriptor에서 state를 가르는 값을 모두 담는다. function 이름, function constant
+ *    (MTL::FunctionConstantValues), vertex descriptor, color attachment의 pixel format과 blend state, depth / stencil format.
+ *    serialize는 index 순서로 늘어놓은 byte 열이고 hash, 비교, manifest 저장에 그대로 쓴다.
+ *  - PipelineCache: 찾기는 lock 없이 open addressing table을 읽는다. table은 커질 때만 새로 만들어 바꿔 끼우고
+ *    이전 table은 cache가 없어질 때까지 둔다. 없는 key는 자리만 잡고 ThreadPool에서 compile 하며 그동안 nullptr을 돌려준다.
+ *    만든 state는 cache가 없어질 때까지 살아 있으므로 찾은 pointer를 참조 없이 써도 된다.
+ *  - .lmpc manifest: compile 된 key 목록. 다음 실행에서 읽어 prewarm 하면 처음 보는 material 조합이 나와도 frame이 멈추지 않는다.
+ * Metal 호출(key -> descriptor -> state)은 01-primitive에 있고, 여기 있는 것은 GPU 없이 돌아간다. (bench/pipeline-cache)
+ * 필드의 값은 같은 이름의 MTL:: enum 값과 같다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+// MTL::DataType 중 function constant로 쓰는 것
+enum PipelineDataType : uint32_t {
+	PipelineDataTypeFloat = 3,
+	PipelineDataTypeInt = 29,
+	PipelineDataTypeUInt = 33,
+	PipelineDataTypeBool = 53,
+};
+
+struct PipelineFunctionConstant {
+	uint32_t index;
+	uint32_t dataType;
+	// 값의 bit. bool은 0 / 1
+	uint32_t value;
+};
+
+// MTL::VertexAttributeDescriptor
+struct PipelineVertexAttribute {
+	uint32_t index;
+	uint32_t format;
+	uint32_t offset;
+	uint32_t bufferIndex;
+};
+
+// MTL::VertexBufferLayoutDescriptor
+struct PipelineVertexLayout {
+	uint32_t index;
+	uint32_t stride;
+	// MTL::VertexStepFunction (Constant = 0, PerVertex = 1, PerInstance = 2)
+	uint32_t stepFunction{1};
+	uint32_t stepRate{1};
+};
+
+// MTL::RenderPipelineColorAttachmentDescriptor. 기본값은 Metal과 같다. (blending 없음, source One, destination Zero)
+struct PipelineColorAttachment {
+	uint32_t pixelFormat{0};
+	uint8_t blendingEnabled{0};
+	uint8_t rgbBlendOperation{0};
+	uint8_t alphaBlendOperation{0};
+	uint8_t writeMask{0xF};
+	uint8_t sourceRGBBlendFactor{1};
+	uint8_t sourceAlphaBlendFactor{1};
+	uint8_t destinationRGBBlendFactor{0};
+	uint8_t destinationAlphaBlendFactor{0};
+};
+
+struct PipelineKey {
+	static constexpr uint32_t kMaxColorAttachments = 8;
+	static constexpr uint32_t kMaxVertexSlots = 31;
+
+	std::string vertexFunction;
+	std::string fragmentFunction;
+	// index 순서, index마다 하나
+	std::vector<PipelineFunctionConstant> constants;
+	// 비어 있으면 vertex descriptor를 붙이지 않는다.
+	std::vector<PipelineVertexAttribute> attributes;
+	std::vector<PipelineVertexLayout> layouts;
+	// colorAttachments[i]가 attachment i이다.
+	std::vector<PipelineColorAttachment> colorAttachments;
+	uint32_t depthPixelFormat{0};
+	uint32_t stencilPixelFormat{0};
+	uint32_t sampleCount{1};
+	uint8_t alphaToCoverageEnabled{0};
+	// MTL::PrimitiveTopologyClass
+	uint8_t inputPrimitiveTopology{0};
+
+	void setConstant(uint32_t index, bool value) { setConstantBits(index, PipelineDataTypeBool, value ? 1 : 0); }
+	void setConstant(uint32_t index, int32_t value) { setConstantBits(index, PipelineDataTypeInt, uint32_t(value)); }
+	void setConstant(uint32_t index, float value);
+	void setConstantBits(uint32_t index, uint32_t dataType, uint32_t bits);
+	// 같은 index가 있으면 바꾼다.
+	void setAttribute(uint32_t index, uint32_t format, uint32_t offset, uint32_t bufferIndex);
+	void setLayout(uint32_t index, uint32_t stride, uint32_t stepFunction = 1, uint32_t stepRate = 1);
+	PipelineColorAttachment& colorAttachment(uint32_t index);
+
+	// 4 byte 단위 little endian. 길이는 항상 4의 배수이다.
+	void serialize(std::vector<uint8_t>& bytes) const;
+	static bool deserialize(const uint8_t* data, size_t size, PipelineKey& key);
+};
+
+struct PipelineCacheStats {
+	uint64_t hits{0};
+	// 처음 본 key. compile을 건다.
+	uint64_t misses{0};
+	// compile 중이라 nullptr을 돌려준 찾기
+	uint64_t pendingLookups{0};
+	uint64_t compilations{0};
+	uint64_t failures{0};
+	uint64_t prewarmed{0};
+	uint64_t size{0};
+	// compile에 든 시간의 합 (thread마다 더한다)
+	double compileMilliseconds{0.0};
+};
+
+/*
+ * State는 release()가 있는 참조 계수 객체이다. (MTL::RenderPipelineState)
+ * compile은 +1 참조의 새 state를 돌려준다. 실패하면 nullptr이고 그 key는 다시 compile 하지 않는다.
+ * compile은 pool의 thread에서 불리므로 여러 thread에서 불려도 되어야 한다.
+ * */
+template <typename State>
+class PipelineCache {
+	public:
+		using CompileFunction = std::function<State*(const PipelineKey&)>;
+
+		explicit PipelineCache(CompileFunction compile, ThreadPool& pool = ThreadPool::shared(), size_t initialCapacity = 256);
+		// 남은 compile을 기다린 뒤 모두 놓는다.
+		~PipelineCache();
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache& operator=(const PipelineCache&) = delete;
+
+		// lock 없이 찾는다. 처음 보는 key면 compile을 걸고, compile이 끝나기 전에는 nullptr을 돌려준다.
+		State* find(const PipelineKey& key);
+		// compile이 끝날 때까지 기다려 돌려준다. pool의 작업 안에서 부르지 않는다.
+		State* get(const PipelineKey& key);
+		// 없는 key의 compile을 모두 건다. 기다리지 않는다.
+		void prewarm(const std::vector<PipelineKey>& keys);
+		// 걸어 둔 compile이 모두 끝날 때까지 기다린다.
+		void wait();
+		// 남은 compile을 기다린 뒤 모든 state를 놓는다. 이전에 돌려준 pointer는 쓸 수 없다. 다른 thread가 찾는 중에 부르지 않는다.
+		void clear();
+		PipelineCacheStats stats() const;
+
+		// compile에 성공한 key를 .lmpc 파일로 쓴다.
+		bool saveManifest(const char* path) const;
+
+	private:
+		enum EntryStatus : uint8_t { EntryStatusPending, EntryStatusReady, EntryStatusFailed };
+		struct Entry {
+			uint64_t hash;
+			std::vector<uint8_t> bytes;
+			PipelineKey key;
+			std::atomic<State*> state{nullptr};
+			std::atomic<uint8_t> status{EntryStatusPending};
+		};
+		// 크기는 2의 거듭제곱. 빈 자리는 nullptr이고 한 번 채운 자리는 바뀌지 않는다.
+		struct Table {
+			size_t mask;
+			std::unique_ptr<std::atomic<Entry*>[]> slots;
+		};
+
+		Entry* lookup(uint64_t hash, const std::vector<uint8_t>& bytes) const;
+		// 없으면 만들어 compile을 건다. created는 새로 만들었는지
+		Entry* insert(const PipelineKey& key, uint64_t hash, const std::vector<uint8_t>& bytes, bool& created);
+		void place(Table& table, Entry* entry);
+		void compileEntry(Entry* entry);
+
+		CompileFunction _compile;
+		ThreadPool& _pool;
+		std::atomic<Table*> _table{nullptr};
+		// 바꿔 끼운 table도 여기 남는다. 읽는 thread가 아직 들고 있을 수 있다.
+		std::vector<std::unique_ptr<Table>> _tables;
+		std::vector<std::unique_ptr<Entry>> _entries;
+		mutable std::mutex _insertMutex;
+
+		mutable std::mutex _pendingMutex;
+		std::condition_variable _compiled;
+		size_t _pending{0};
+
+		std::atomic<uint64_t> _hits{0};
+		std::atomic<uint64_t> _misses{0};
+		std::atomic<uint64_t> _pendingLookups{0};
+		std::atomic<uint64_t> _compilations{0};
+		std::atomic<uint64_t> _failures{0};
+		std::atomic<uint64_t> _prewarmed{0};
+		std::atomic<uint64_t> _compileMicroseconds{0};
+};
+
+// .lmpc 파일의 key 목록을 읽는다.
+bool loadPipelineManifest(const char* path, std::vector<PipelineKey>& keys);
+
+namespace PipelineDetail {
+
+const uint32_t kMagic = 0x43504D4C; // "LMPC"
+const uint32_t kVersion = 1;
+const uint32_t kMaxKeyBytes = 1 << 16;
+const uint32_t kMaxNameLength = 1024;
+
+inline bool fail(const std::string& message)
+{
+	std::cerr << "pipeline cache: " << message << std::endl;
+	return false;
+}
+
+inline size_t paddedLength(size_t length) { return (length + 3) & ~size_t(3); }
+
+inline uint8_t* put(uint8_t* p, uint32_t value)
+{
+	p[0] = uint8_t(value);
+	p[1] = uint8_t(value >> 8);
+	p[2] = uint8_t(value >> 16);
+	p[3] = uint8_t(value >> 24);
+	return p + 4;
+}
+
+inline uint8_t* putString(uint8_t* p, const std::string& text)
+{
+	p = put(p, uint32_t(text.size()));
+	std::memcpy(p, text.data(), text.size());
+	std::memset(p + text.size(), 0, paddedLength(text.size()) - text.size());
+	return p + paddedLength(text.size());
+}
+
+inline void put(std::vector<uint8_t>& bytes, uint32_t value)
+{
+	bytes.resize(bytes.size() + 4);
+	put(bytes.data() + bytes.size() - 4, value);
+}
+
+// key byte 열의 hash. StateCache의 hashStateKey와 같은 방식이지만 key가 길어서 8 byte씩 섞는다.
+inline uint64_t hashKeyBytes(const std::vector<uint8_t>& bytes)
+{
+	uint64_t hash = 0xCBF29CE484222325ull ^ bytes.size();
+	size_t i = 0;
+	for (; i + 8 <= bytes.size(); i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes.data() + i, 8);
+		hash = (hash ^ word) * 0x100000001B3ull;
+		hash ^= hash >> 29;
+	}
+	if (i < bytes.size()) {
+		uint32_t word;
+		std::memcpy(&word, bytes.data() + i, 4);
+		hash = (hash ^ word) * 0x100000001B3ull;
+	}
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+	return hash ^ (hash >> 31);
+}
+
+// 끝을 넘어 읽으면 ok가 false가 되고 0을 돌려준다.
+struct Reader {
+	const uint8_t* data;
+	size_t size;
+	size_t offset{0};
+	bool ok{true};
+
+	uint32_t get()
+	{
+		if (offset + 4 > size) {
+			ok = false;
+			return 0;
+		}
+		const uint8_t* p = data + offset;
+		offset += 4;
+		return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+	}
+
+	std::string getString()
+	{
+		const uint32_t length = get();
+		if (!ok || length > kMaxNameLength || offset + length > size) {
+			ok = false;
+			return std::string();
+		}
+		std::string text(reinterpret_cast<const char*>(data + offset), length);
+		offset += (length + 3) & ~3u;
+		return text;
+	}
+};
+
+// index 순서를 유지하며 넣거나 바꾼다.
+template <typename Item>
+void setByIndex(std::vector<Item>& items, const Item& item)
+{
+	auto found = std::lower_bound(items.begin(), items.end(), item, [](const Item& a, const Item& b) { return a.index < b.index; });
+	if (found != items.end() && found->index == item.index) {
+		*found = item;
+	} else {
+		items.insert(found, item);
+	}
+}
+
+} // namespace PipelineDetail
+
+#pragma region PipelineKey {
+
+inline void PipelineKey::setConstant(uint32_t index, float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, 4);
+	setConstantBits(index, PipelineDataTypeFloat, bits);
+}
+
+inline void PipelineKey::setConstantBits(uint32_t index, uint32_t dataType, uint32_t bits)
+{
+	PipelineDetail::setByIndex(constants, PipelineFunctionConstant{ index, dataType, bits });
+}
+
+inline void PipelineKey::setAttribute(uint32_t index, uint32_t format, uint32_t offset, uint32_t bufferIndex)
+{
+	PipelineDetail::setByIndex(attributes, PipelineVertexAttribute{ index, format, offset, bufferIndex });
+}
+
+inline void PipelineKey::setLayout(uint32_t index, uint32_t stride, uint32_t stepFunction, uint32_t stepRate)
+{
+	PipelineDetail::setByIndex(layouts, PipelineVertexLayout{ index, stride, stepFunction, stepRate });
+}
+
+inline PipelineColorAttachment& PipelineKey::colorAttachment(uint32_t index)
+{
+	if (colorAttachments.size() <= index) {
+		colorAttachments.resize(index + 1);
+	}
+	return colorAttachments[index];
+}
+
+inline void PipelineKey::serialize(std::vector<uint8_t>& bytes) const
+{
+	using PipelineDetail::put;
+	using PipelineDetail::paddedLength;
+	// 뒤쪽의 쓰지 않는 attachment는 key를 가르지 않는다.
+	size_t colorCount = colorAttachments.size();
+	while (colorCount > 0 && colorAttachments[colorCount - 1].pixelFormat == 0) {
+		--colorCount;
+	}
+	// 찾을 때마다 부르므로 크기를 먼저 정하고 한 번에 쓴다.
+	bytes.resize(8 + paddedLength(vertexFunction.size()) + paddedLength(fragmentFunction.size()) + 4 + constants.size() * 12 + 4 +
+			attributes.size() * 16 + 4 + layouts.size() * 16 + 4 + colorCount * 12 + 16);
+	uint8_t* p = PipelineDetail::putString(bytes.data(), vertexFunction);
+	p = PipelineDetail::putString(p, fragmentFunction);
+	p = put(p, uint32_t(constants.size()));
+	for (const PipelineFunctionConstant& constant : constants) {
+		p = put(put(put(p, constant.index), constant.dataType), constant.value);
+	}
+	p = put(p, uint32_t(attributes.size()));
+	for (const PipelineVertexAttribute& attribute : attributes) {
+		p = put(put(put(put(p, attribute.index), attribute.format), attribute.offset), attribute.bufferIndex);
+	}
+	p = put(p, uint32_t(layouts.size()));
+	for (const PipelineVertexLayout& layout : layouts) {
+		p = put(put(put(put(p, layout.index), layout.stride), layout.stepFunction), layout.stepRate);
+	}
+	p = put(p, uint32_t(colorCount));
+	for (size_t i = 0; i < colorCount; ++i) {
+		const PipelineColorAttachment& color = colorAttachments[i];
+		p = put(p, color.pixelFormat);
+		p = put(p, uint32_t(color.blendingEnabled) | uint32_t(color.rgbBlendOperation) << 8 | uint32_t(color.alphaBlendOperation) << 16 |
+				uint32_t(color.writeMask) << 24);
+		p = put(p, uint32_t(color.sourceRGBBlendFactor) | uint32_t(color.sourceAlphaBlendFactor) << 8 |
+				uint32_t(color.destinationRGBBlendFactor) << 16 | uint32_t(color.destinationAlphaBlendFactor) << 24);
+	}
+	p = put(put(put(p, depthPixelFormat), stencilPixelFormat), sampleCount);
+	put(p, uint32_t(alphaToCoverageEnabled) | uint32_t(inputPrimitiveTopology) << 8);
+}
+
+inline bool PipelineKey::deserialize(const uint8_t* data, size_t size, PipelineKey& key)
+{
+	PipelineDetail::Reader reader{ data, size };
+	key = PipelineKey();
+	key.vertexFunction = reader.getString();
+	key.fragmentFunction = reader.getString();
+	const uint32_t constantCount = reader.get();
+	for (uint32_t i = 0; i < constantCount && reader.ok && constantCount <= size / 12; ++i) {
+		const uint32_t index = reader.get(), dataType = reader.get(), value = reader.get();
+		key.setConstantBits(index, dataType, value);
+	}
+	const uint32_t attributeCount = reader.get();
+	for (uint32_t i = 0; i < attributeCount && reader.ok && attributeCount <= kMaxVertexSlots; ++i) {
+		const uint32_t index = reader.get(), format = reader.get(), offset = reader.get(), bufferIndex = reader.get();
+		key.setAttribute(index, format, offset, bufferIndex);
+	}
+	const uint32_t layoutCount = reader.get();
+	for (uint32_t i = 0; i < layoutCount && reader.ok && layoutCount <= kMaxVertexSlots; ++i) {
+		const uint32_t index = reader.get(), stride = reader.get(), stepFunction = reader.get(), stepRate = reader.get();
+		key.setLayout(index, stride, stepFunction, stepRate);
+	}
+	const uint32_t colorCount = reader.get();
+	for (uint32_t i = 0; i < colorCount && reader.ok && colorCount <= kMaxColorAttachments; ++i) {
+		PipelineColorAttachment& color = key.colorAttachment(i);
+		color.pixelFormat = reader.get();
+		const uint32_t blend = reader.get(), factors = reader.get();
+		color.blendingEnabled = uint8_t(blend);
+		color.rgbBlendOperation = uint8_t(blend >> 8);
+		color.alphaBlendOperation = uint8_t(blend >> 16);
+		color.writeMask = uint8_t(blend >> 24);
+		color.sourceRGBBlendFactor = uint8_t(factors);
+		color.sourceAlphaBlendFactor = uint8_t(factors >> 8);
+		color.destinationRGBBlendFactor = uint8_t(factors >> 16);
+		color.destinationAlphaBlendFactor = uint8_t(factors >> 24);
+	}
+	key.depthPixelFormat = reader.get();
+	key.stencilPixelFormat = reader.get();
+	key.sampleCount = reader.get();
+	const uint32_t flags = reader.get();
+	key.alphaToCoverageEnabled = uint8_t(flags);
+	key.inputPrimitiveTopology = uint8_t(flags >> 8);
+	// 개수가 상한을 넘었거나 남는 byte가 있으면 깨진 key이다.
+	return reader.ok && constantCount == key.constants.size() && attributeCount == key.attributes.size() && layoutCount == key.layouts.size() &&
+		colorCount == key.colorAttachments.size() && reader.offset == size;
+}
+
+#pragma endregion PipelineKey }
+
+#pragma region PipelineCache {
+
+template <typename State>
+PipelineCache<State>::PipelineCache(CompileFunction compile, ThreadPool& pool, size_t initialCapacity)
+: _compile(std::move(compile)), _pool(pool)
+{
+	size_t capacity = 16;
+	while (capacity < initialCapacity * 2) {
+		capacity *= 2;
+	}
+	Table* table = new Table{ capacity - 1, std::unique_ptr<std::atomic<Entry*>[]>(new std::atomic<Entry*>[capacity]) };
+	for (size_t i = 0; i < capacity; ++i) {
+		table->slots[i].store(nullptr, std::memory_order_relaxed);
+	}
+	_tables.emplace_back(table);
+	_table.store(table, std::memory_order_release);
+}
+
+template <typename State>
+PipelineCache<State>::~PipelineCache()
+{
+	clear();
+}
+
+template <typename State>
+typename PipelineCache<State>::Entry* PipelineCache<State>::lookup(uint64_t hash, const std::vector<uint8_t>& bytes) const
+{
+	const Table* table = _table.load(std::memory_order_acquire);
+	for (size_t slot = size_t(hash) & table->mask;; slot = (slot + 1) & table->mask) {
+		Entry* entry = table->slots[slot].load(std::memory_order_acquire);
+		if (!entry) {
+			return nullptr;
+		}
+		if (entry->hash == hash && entry->bytes == bytes) {
+			return entry;
+		}
+	}
+}
+
+template <typename State>
+void PipelineCache<State>::place(Table& table, Entry* entry)
+{
+	size_t slot = size_t(entry->hash) & table.mask;
+	while (table.slots[slot].load(std::memory_order_relaxed)) {
+		slot = (slot + 1) & table.mask;
+	}
+	table.slots[slot].store(entry, std::memory_order_release);
+}
+
+template <typename State>
+typename PipelineCache<State>::Entry* PipelineCache<State>::insert(const PipelineKey& key, uint64_t hash, const std::vector<uint8_t>& bytes,
+		bool& created)
+{
+	Entry* entry = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(_insertMutex);
+		created = false;
+		// lock을 기다리는 동안 다른 thread가 넣었을 수 있다.
+		if ((entry = lookup(hash, bytes))) {
+			return entry;
+		}
+		Table* table = _table.load(std::memory_order_relaxed);
+		// 반 넘게 차면 두 배 table로 옮긴다. 읽는 thread는 이전 table에서 못 찾으면 여기로 와서 다시 찾는다.
+		if ((_entries.size() + 1) * 2 > table->mask + 1) {
+			const size_t capacity = (table->mask + 1) * 2;
+			Table* grown = new Table{ capacity - 1, std::unique_ptr<std::atomic<Entry*>[]>(new std::atomic<Entry*>[capacity]) };
+			for (size_t i = 0; i < capacity; ++i) {
+				grown->slots[i].store(nullptr, std::memory_order_relaxed);
+			}
+			for (const std::unique_ptr<Entry>& existing : _entries) {
+				place(*grown, existing.get());
+			}
+			_tables.emplace_back(grown);
+			_table.store(grown, std::memory_order_release);
+			table = grown;
+		}
+		entry = new Entry();
+		entry->hash = hash;
+		entry->bytes = bytes;
+		entry->key = key;
+		_entries.emplace_back(entry);
+		place(*table, entry);
+		created = true;
+	}
+	{
+		std::lock_guard<std::mutex> lock(_pendingMutex);
+		++_pending;
+	}
+	// thread가 하나뿐인 pool에서는 여기서 바로 compile 된다. 그래서 lock을 놓은 뒤에 건다.
+	_pool.submit([this, entry] { compileEntry(entry); });
+	return entry;
+}
+
+template <typename State>
+void PipelineCache<State>::compileEntry(Entry* entry)
+{
+	auto start = std::chrono::steady_clock::now();
+	State* state = _compile(entry->key);
+	const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	_compileMicroseconds.fetch_add(uint64_t(elapsed.count()), std::memory_order_relaxed);
+	(state ? _compilations : _failures).fetch_add(1, std::memory_order_relaxed);
+	entry->state.store(state, std::memory_order_release);
+	entry->status.store(state ? EntryStatusReady : EntryStatusFailed, std::memory_order_release);
+	std::lock_guard<std::mutex> lock(_pendingMutex);
+	--_pending;
+	_compiled.notify_all();
+}
+
+template <typename State>
+State* PipelineCache<State>::find(const PipelineKey& key)
+{
+	// thread마다 buffer를 다시 써서 찾을 때 할당하지 않는다.
+	thread_local std::vector<uint8_t> bytes;
+	key.serialize(bytes);
+	const uint64_t hash = PipelineDetail::hashKeyBytes(bytes);
+	Entry* entry = lookup(hash, bytes);
+	if (!entry) {
+		bool created = false;
+		entry = insert(key, hash, bytes, created);
+		(created ? _misses : _hits).fetch_add(1, std::memory_order_relaxed);
+	} else {
+		_hits.fetch_add(1, std::memory_order_relaxed);
+	}
+	State* state = entry->state.load(std::memory_order_acquire);
+	if (!state && entry->status.load(std::memory_order_acquire) == EntryStatusPending) {
+		_pendingLookups.fetch_add(1, std::memory_order_relaxed);
+	}
+	return state;
+}
+
+template <typename State>
+State* PipelineCache<State>::get(const PipelineKey& key)
+{
+	if (State* state = find(key)) {
+		return state;
+	}
+	std::vector<uint8_t> bytes;
+	key.serialize(bytes);
+	Entry* entry = lookup(PipelineDetail::hashKeyBytes(bytes), bytes);
+	std::unique_lock<std::mutex> lock(_pendingMutex);
+	_compiled.wait(lock, [entry] { return entry->status.load(std::memory_order_acquire) != EntryStatusPending; });
+	return entry->state.load(std::memory_order_acquire);
+}
+
+template <typename State>
+void PipelineCache<State>::prewarm(const std::vector<PipelineKey>& keys)
+{
+	std::vector<uint8_t> bytes;
+	for (const PipelineKey& key : keys) {
+		key.serialize(bytes);
+		const uint64_t hash = PipelineDetail::hashKeyBytes(bytes);
+		bool created = false;
+		if (!lookup(hash, bytes)) {
+			insert(key, hash, bytes, created);
+		}
+		_prewarmed.fetch_add(created ? 1 : 0, std::memory_order_relaxed);
+	}
+}
+
+template <typename State>
+void PipelineCache<State>::wait()
+{
+	std::unique_lock<std::mutex> lock(_pendingMutex);
+	_compiled.wait(lock, [this] { return _pending == 0; });
+}
+
+template <typename State>
+void PipelineCache<State>::clear()
+{
+	wait();
+	std::lock_guard<std::mutex> lock(_insertMutex);
+	for (const std::unique_ptr<Entry>& entry : _entries) {
+		if (State* state = entry->state.load(std::memory_order_relaxed)) {
+			state->release();
+		}
+	}
+	_entries.clear();
+	// 빈 table 하나만 남긴다.
+	Table* table = _table.load(std::memory_order_relaxed);
+	for (size_t i = 0; i <= table->mask; ++i) {
+		table->slots[i].store(nullptr, std::memory_order_relaxed);
+	}
+	for (std::unique_ptr<Table>& owned : _tables) {
+		if (owned.get() == table) {
+			owned.swap(_tables.front());
+		}
+	}
+	_tables.resize(1);
+}
+
+template <typename State>
+PipelineCacheStats PipelineCache<State>::stats() const
+{
+	PipelineCacheStats stats;
+	stats.hits = _hits.load(std::memory_order_relaxed);
+	stats.misses = _misses.load(std::memory_order_relaxed);
+	stats.pendingLookups = _pendingLookups.load(std::memory_order_relaxed);
+	stats.compilations = _compilations.load(std::memory_order_relaxed);
+	stats.failures = _failures.load(std::memory_order_relaxed);
+	stats.prewarmed = _prewarmed.load(std::memory_order_relaxed);
+	stats.compileMilliseconds = double(_compileMicroseconds.load(std::memory_order_relaxed)) / 1000.0;
+	std::lock_guard<std::mutex> lock(_insertMutex);
+	stats.size = _entries.size();
+	return stats;
+}
+
+template <typename State>
+bool PipelineCache<State>::saveManifest(const char* path) const
+{
+	using namespace PipelineDetail;
+	std::vector<const Entry*> ready;
+	{
+		std::lock_guard<std::mutex> lock(_insertMutex);
+		for (const std::unique_ptr<Entry>& entry : _entries) {
+			if (entry->status.load(std::memory_order_acquire) == EntryStatusReady) {
+				ready.push_back(entry.get());
+			}
+		}
+	}
+	std::vector<uint8_t> bytes;
+	put(bytes, kMagic);
+	put(bytes, kVersion);
+	put(bytes, uint32_t(ready.size()));
+	for (const Entry* entry : ready) {
+		put(bytes, uint32_t(entry->bytes.size()));
+		bytes.insert(bytes.end(), entry->bytes.begin(), entry->bytes.end());
+	}
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+	return bool(out) || fail(std::string("failed to write: ") + path);
+}
+
+#pragma endregion PipelineCache }
+
+inline bool loadPipelineManifest(const char* path, std::vector<PipelineKey>& keys)
+{
+	using namespace PipelineDetail;
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return fail(std::string("file not found: ") + path);
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	Reader reader{ data.data(), data.size() };
+	if (reader.get() != kMagic || reader.get() != kVersion) {
+		return fail(std::string("not a pipeline manifest: ") + path);
+	}
+	const uint32_t count = reader.get();
+	keys.clear();
+	for (uint32_t i = 0; i < count && reader.ok; ++i) {
+		const uint32_t size = reader.get();
+		PipelineKey key;
+		if (!reader.ok || size > kMaxKeyBytes || reader.offset + size > data.size() ||
+				!PipelineKey::deserialize(data.data() + reader.offset, size, key)) {
+			return fail(std::string("pipeline manifest is corrupt: ") + path);
+		}
+		reader.offset += size;
+		keys.push_back(std::move(key));
+	}
+	return reader.ok || fail(std::string("pipeline manifest is truncated: ") + path);
+}
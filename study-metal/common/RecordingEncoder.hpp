@@ -0,0 +1,284 @@
+/*
+ * RecordingEncoder.hpp
+ *
+ * MTL::RenderCommandEncoder와 같은 이름의 함수를 가진 mock. Metal 없이 FilteringRenderEncoder 같은
+ * encoder wrapper를 돌려 보기 위해 쓴다. 들어온 호출을 순서대로 기록하고, 묶인 state를 흉내 내서
+ * draw마다 그 순간의 state hash를 남긴다. 걸러진 호출 열과 걸러지지 않은 호출 열의 draw hash가 같으면
+ * GPU가 보는 결과도 같다.
+ * */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// MTL::Viewport와 같은 배치
+struct RecordedViewport {
+	double originX, originY, width, height, znear, zfar;
+};
+
+enum class EncoderCallType : uint8_t {
+	SetRenderPipelineState,
+	SetDepthStencilState,
+	SetViewport,
+	SetCullMode,
+	SetVertexBuffer,
+	SetVertexBufferOffset,
+	SetVertexBytes,
+	SetFragmentBuffer,
+	SetFragmentBufferOffset,
+	SetFragmentBytes,
+	SetVertexTexture,
+	SetVertexSamplerState,
+	SetFragmentTexture,
+	SetFragmentSamplerState,
+	DrawPrimitives,
+	DrawIndexedPrimitives,
+};
+
+struct EncoderCall {
+	EncoderCallType type;
+	const void* object;
+	// 호출마다 뜻이 다르다. buffer: (offset, index), texture / sampler: (index), draw: (primitive type, count, instance count)
+	uint64_t arguments[3];
+	// draw 호출일 때 묶여 있던 state의 hash
+	uint64_t stateHash;
+};
+
+class RecordingEncoder {
+	public:
+		static constexpr size_t kMaxBufferSlots = 31;
+		static constexpr size_t kMaxTextureSlots = 128;
+		static constexpr size_t kMaxSamplerSlots = 16;
+
+		void clear();
+		const std::vector<EncoderCall>& calls() const { return _calls; }
+		size_t numberOfCalls(EncoderCallType type) const;
+		// draw 호출의 stateHash만 순서대로
+		std::vector<uint64_t> drawStateHashes() const;
+
+		void setRenderPipelineState(const void* pipelineState);
+		void setDepthStencilState(const void* depthStencilState);
+		void setViewport(const RecordedViewport& viewport);
+		void setCullMode(uint32_t cullMode);
+		void setVertexBuffer(const void* buffer, uint64_t offset, uint64_t index);
+		void setVertexBufferOffset(uint64_t offset, uint64_t index);
+		void setVertexBytes(const void* bytes, uint64_t length, uint64_t index);
+		void setFragmentBuffer(const void* buffer, uint64_t offset, uint64_t index);
+		void setFragmentBufferOffset(uint64_t offset, uint64_t index);
+		void setFragmentBytes(const void* bytes, uint64_t length, uint64_t index);
+		void setVertexTexture(const void* texture, uint64_t index);
+		void setVertexSamplerState(const void* samplerState, uint64_t index);
+		void setFragmentTexture(const void* texture, uint64_t index);
+		void setFragmentSamplerState(const void* samplerState, uint64_t index);
+		void drawPrimitives(uint32_t primitiveType, uint64_t vertexStart, uint64_t vertexCount, uint64_t instanceCount = 1);
+		void drawIndexedPrimitives(uint32_t primitiveType, uint64_t indexCount, uint32_t indexType, const void* indexBuffer,
+				uint64_t indexBufferOffset, uint64_t instanceCount = 1);
+
+	private:
+		struct Slot {
+			const void* buffer;
+			uint64_t offset;
+			// setBytes로 채운 내용의 hash. buffer가 nullptr일 때만 쓴다.
+			uint64_t bytesHash;
+		};
+
+		void record(EncoderCallType type, const void* object, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0);
+		uint64_t stateHash() const;
+		static uint64_t hashBytes(uint64_t hash, const void* data, size_t size);
+		// slot에 object를 묶고 _resourceHash를 고친다. table은 slot 종류마다 다른 번호이다.
+		void bindResource(const void** slots, uint64_t table, uint64_t index, const void* object);
+
+		std::vector<EncoderCall> _calls;
+		const void* _pipelineState{nullptr};
+		const void* _depthStencilState{nullptr};
+		RecordedViewport _viewport{};
+		uint64_t _viewportHash{0};
+		uint32_t _cullMode{0};
+		Slot _vertexBuffers[kMaxBufferSlots]{};
+		Slot _fragmentBuffers[kMaxBufferSlots]{};
+		const void* _vertexTextures[kMaxTextureSlots]{};
+		const void* _vertexSamplerStates[kMaxSamplerSlots]{};
+		const void* _fragmentTextures[kMaxTextureSlots]{};
+		const void* _fragmentSamplerStates[kMaxSamplerSlots]{};
+		// 묶인 texture / sampler의 hash. slot이 200개가 넘어서 draw마다 훑지 않고 묶을 때 XOR로 고친다.
+		uint64_t _resourceHash{0};
+};
+
+#pragma region RecordingEncoder {
+
+inline void RecordingEncoder::clear()
+{
+	*this = RecordingEncoder();
+}
+
+inline size_t RecordingEncoder::numberOfCalls(EncoderCallType type) const
+{
+	size_t count = 0;
+	for (const EncoderCall& call : _calls) {
+		count += call.type == type;
+	}
+	return count;
+}
+
+inline std::vector<uint64_t> RecordingEncoder::drawStateHashes() const
+{
+	std::vector<uint64_t> hashes;
+	for (const EncoderCall& call : _calls) {
+		if (call.type == EncoderCallType::DrawPrimitives || call.type == EncoderCallType::DrawIndexedPrimitives) {
+			hashes.push_back(call.stateHash);
+		}
+	}
+	return hashes;
+}
+
+inline void RecordingEncoder::record(EncoderCallType type, const void* object, uint64_t a, uint64_t b, uint64_t c)
+{
+	_calls.push_back({ type, object, { a, b, c }, 0 });
+}
+
+// FNV-1a
+inline uint64_t RecordingEncoder::hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+inline uint64_t RecordingEncoder::stateHash() const
+{
+	// 8 byte 단위로 섞는다. draw마다 부르므로 byte 단위 FNV보다 빨라야 한다.
+	uint64_t hash = 0xCBF29CE484222325ull;
+	auto mix = [&hash](uint64_t word) { hash = (hash ^ word) * 0x100000001B3ull; hash ^= hash >> 29; };
+	mix(uint64_t(uintptr_t(_pipelineState)));
+	mix(uint64_t(uintptr_t(_depthStencilState)));
+	mix(_viewportHash);
+	mix(_cullMode);
+	mix(_resourceHash);
+	for (const Slot* slots : { _vertexBuffers, _fragmentBuffers }) {
+		for (size_t i = 0; i < kMaxBufferSlots; ++i) {
+			mix(uint64_t(uintptr_t(slots[i].buffer)));
+			mix(slots[i].offset);
+			mix(slots[i].bytesHash);
+		}
+	}
+	return hash;
+}
+
+inline void RecordingEncoder::setRenderPipelineState(const void* pipelineState)
+{
+	record(EncoderCallType::SetRenderPipelineState, pipelineState);
+	_pipelineState = pipelineState;
+}
+
+inline void RecordingEncoder::setDepthStencilState(const void* depthStencilState)
+{
+	record(EncoderCallType::SetDepthStencilState, depthStencilState);
+	_depthStencilState = depthStencilState;
+}
+
+inline void RecordingEncoder::setViewport(const RecordedViewport& viewport)
+{
+	record(EncoderCallType::SetViewport, nullptr);
+	_viewport = viewport;
+	_viewportHash = hashBytes(0xCBF29CE484222325ull, &viewport, sizeof(viewport));
+}
+
+inline void RecordingEncoder::setCullMode(uint32_t cullMode)
+{
+	record(EncoderCallType::SetCullMode, nullptr, cullMode);
+	_cullMode = cullMode;
+}
+
+inline void RecordingEncoder::setVertexBuffer(const void* buffer, uint64_t offset, uint64_t index)
+{
+	record(EncoderCallType::SetVertexBuffer, buffer, offset, index);
+	_vertexBuffers[index] = { buffer, offset, 0 };
+}
+
+inline void RecordingEncoder::setVertexBufferOffset(uint64_t offset, uint64_t index)
+{
+	record(EncoderCallType::SetVertexBufferOffset, nullptr, offset, index);
+	_vertexBuffers[index].offset = offset;
+}
+
+inline void RecordingEncoder::setVertexBytes(const void* bytes, uint64_t length, uint64_t index)
+{
+	record(EncoderCallType::SetVertexBytes, nullptr, length, index);
+	_vertexBuffers[index] = { nullptr, 0, hashBytes(0xCBF29CE484222325ull, bytes, length) };
+}
+
+inline void RecordingEncoder::setFragmentBuffer(const void* buffer, uint64_t offset, uint64_t index)
+{
+	record(EncoderCallType::SetFragmentBuffer, buffer, offset, index);
+	_fragmentBuffers[index] = { buffer, offset, 0 };
+}
+
+inline void RecordingEncoder::setFragmentBufferOffset(uint64_t offset, uint64_t index)
+{
+	record(EncoderCallType::SetFragmentBufferOffset, nullptr, offset, index);
+	_fragmentBuffers[index].offset = offset;
+}
+
+inline void RecordingEncoder::setFragmentBytes(const void* bytes, uint64_t length, uint64_t index)
+{
+	record(EncoderCallType::SetFragmentBytes, nullptr, length, index);
+	_fragmentBuffers[index] = { nullptr, 0, hashBytes(0xCBF29CE484222325ull, bytes, length) };
+}
+
+inline void RecordingEncoder::bindResource(const void** slots, uint64_t table, uint64_t index, const void* object)
+{
+	// 빈 slot은 0이므로 아무것도 묶지 않은 상태와 nullptr를 묶은 상태가 같다.
+	auto slotHash = [table, index](const void* bound) -> uint64_t {
+		if (!bound) {
+			return 0;
+		}
+		uint64_t hash = (uint64_t(uintptr_t(bound)) ^ (table << 56 | index)) * 0x9E3779B97F4A7C15ull;
+		return hash ^ hash >> 31;
+	};
+	_resourceHash ^= slotHash(slots[index]) ^ slotHash(object);
+	slots[index] = object;
+}
+
+inline void RecordingEncoder::setVertexTexture(const void* texture, uint64_t index)
+{
+	record(EncoderCallType::SetVertexTexture, texture, index);
+	bindResource(_vertexTextures, 0, index, texture);
+}
+
+inline void RecordingEncoder::setVertexSamplerState(const void* samplerState, uint64_t index)
+{
+	record(EncoderCallType::SetVertexSamplerState, samplerState, index);
+	bindResource(_vertexSamplerStates, 1, index, samplerState);
+}
+
+inline void RecordingEncoder::setFragmentTexture(const void* texture, uint64_t index)
+{
+	record(EncoderCallType::SetFragmentTexture, texture, index);
+	bindResource(_fragmentTextures, 2, index, texture);
+}
+
+inline void RecordingEncoder::setFragmentSamplerState(const void* samplerState, uint64_t index)
+{
+	record(EncoderCallType::SetFragmentSamplerState, samplerState, index);
+	bindResource(_fragmentSamplerStates, 3, index, samplerState);
+}
+
+inline void RecordingEncoder::drawPrimitives(uint32_t primitiveType, uint64_t vertexStart, uint64_t vertexCount, uint64_t instanceCount)
+{
+	record(EncoderCallType::DrawPrimitives, nullptr, primitiveType, vertexCount, instanceCount);
+	_calls.back().stateHash = hashBytes(stateHash(), &vertexStart, sizeof(vertexStart));
+}
+
+inline void RecordingEncoder::drawIndexedPrimitives(uint32_t primitiveType, uint64_t indexCount, uint32_t indexType, const void* indexBuffer,
+		uint64_t indexBufferOffset, uint64_t instanceCount)
+{
+	record(EncoderCallType::DrawIndexedPrimitives, indexBuffer, primitiveType, indexCount, instanceCount);
+	uint64_t hash = hashBytes(stateHash(), &indexType, sizeof(indexType));
+	_calls.back().stateHash = hashBytes(hash, &indexBufferOffset, sizeof(indexBufferOffset));
+}
+
+#pragma endregion RecordingEncoder }
@@ -0,0 +1,133 @@
+/*
+ * RenderQueue.hpp
+ *
+ * 한 frame의 draw를 64 bit sort key로 모아 정렬한 뒤 encode 하기 위한 queue.
+ * key 배치: [63..52] pipeline (12 bit) | [51..32] vertex buffer 묶음 (20 bit) | [31..0] depth
+ * 같은 pipeline끼리, 그 안에서 같은 buffer끼리 붙어 있어서 encoder가 state를 바꾸는 횟수가 줄어든다.
+ * (이미 묶인 state를 다시 보내지 않는 일은 FilteringEncoder.hpp가 한다.)
+ * depth는 float bit를 그대로 쓰므로 (0 이상이면) 숫자 순서와 같다. 불투명한 물체는 앞에서 뒤로 그린다.
+ *
+ * 정렬은 11 bit씩 6번 도는 LSD radix sort이고 각 pass는 thread pool에서 구간별 histogram -> scatter로 나눈다.
+ * 모든 key가 같은 값을 갖는 자리의 pass는 건너뛴다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+enum class DepthOrder {
+	FrontToBack,
+	BackToFront,
+};
+
+struct RenderQueueItem {
+	uint64_t key;
+	// 호출하는 쪽의 draw 번호
+	uint32_t draw;
+};
+
+inline uint64_t renderSortKey(uint32_t pipeline, uint32_t buffers, float depth, DepthOrder order = DepthOrder::FrontToBack)
+{
+	uint32_t depthBits;
+	depth = std::max(depth, 0.0f);
+	std::memcpy(&depthBits, &depth, sizeof(depthBits));
+	if (order == DepthOrder::BackToFront) {
+		depthBits = ~depthBits;
+	}
+	return uint64_t(pipeline & 0xFFF) << 52 | uint64_t(buffers & 0xFFFFF) << 32 | depthBits;
+}
+
+inline uint32_t pipelineOfSortKey(uint64_t key) { return uint32_t(key >> 52); }
+inline uint32_t buffersOfSortKey(uint64_t key) { return uint32_t(key >> 32) & 0xFFFFF; }
+
+class RenderQueue {
+	public:
+		void clear() { _items.clear(); }
+		void reserve(size_t count) { _items.reserve(count); }
+		void push(uint64_t key, uint32_t draw) { _items.push_back({ key, draw }); }
+		// key 오름차순으로 정렬한다. 같은 key는 push 순서를 지킨다.
+		void sort(ThreadPool& pool = ThreadPool::shared());
+
+		const std::vector<RenderQueueItem>& items() const { return _items; }
+		size_t size() const { return _items.size(); }
+
+	private:
+		static constexpr int kRadixBits = 11;
+		static constexpr size_t kRadix = size_t(1) << kRadixBits;
+		static constexpr uint64_t kRadixMask = kRadix - 1;
+
+		std::vector<RenderQueueItem> _items;
+		std::vector<RenderQueueItem> _scratch;
+};
+
+#pragma region RenderQueue {
+
+inline void RenderQueue::sort(ThreadPool& pool)
+{
+	const size_t count = _items.size();
+	if (count < 2) {
+		return;
+	}
+	_scratch.resize(count);
+	// 구간이 너무 작으면 histogram을 합치는 비용이 더 크다.
+	const size_t numberOfBlocks = std::max<size_t>(1, std::min<size_t>(pool.size() * 4, count / 4096));
+	const size_t blockSize = (count + numberOfBlocks - 1) / numberOfBlocks;
+	std::vector<uint32_t> histograms(numberOfBlocks * kRadix);
+
+	// 어느 bit가 key마다 다른지 보고 모두 같은 자리의 pass는 건너뛴다.
+	uint64_t allOr = 0, allAnd = ~uint64_t(0);
+	for (const RenderQueueItem& item : _items) {
+		allOr |= item.key;
+		allAnd &= item.key;
+	}
+	const uint64_t differing = allOr ^ allAnd;
+
+	RenderQueueItem* source = _items.data();
+	RenderQueueItem* destination = _scratch.data();
+	for (int shift = 0; shift < 64; shift += kRadixBits) {
+		if (((differing >> shift) & kRadixMask) == 0) {
+			continue;
+		}
+		// 1. 구간별 histogram
+		pool.parallelFor(numberOfBlocks, 1, [&](size_t firstBlock, size_t lastBlock) {
+			for (size_t block = firstBlock; block < lastBlock; ++block) {
+				uint32_t* histogram = histograms.data() + block * kRadix;
+				std::fill(histogram, histogram + kRadix, 0u);
+				const size_t end = std::min(count, (block + 1) * blockSize);
+				for (size_t i = block * blockSize; i < end; ++i) {
+					++histogram[(source[i].key >> shift) & kRadixMask];
+				}
+			}
+		});
+		// 2. (digit, block) 순서의 prefix sum이 각 구간이 쓰기 시작할 위치이다. stable하게 된다.
+		uint32_t offset = 0;
+		for (size_t digit = 0; digit < kRadix; ++digit) {
+			for (size_t block = 0; block < numberOfBlocks; ++block) {
+				uint32_t& slot = histograms[block * kRadix + digit];
+				uint32_t n = slot;
+				slot = offset;
+				offset += n;
+			}
+		}
+		// 3. scatter
+		pool.parallelFor(numberOfBlocks, 1, [&](size_t firstBlock, size_t lastBlock) {
+			for (size_t block = firstBlock; block < lastBlock; ++block) {
+				uint32_t* cursor = histograms.data() + block * kRadix;
+				const size_t end = std::min(count, (block + 1) * blockSize);
+				for (size_t i = block * blockSize; i < end; ++i) {
+					destination[cursor[(source[i].key >> shift) & kRadixMask]++] = source[i];
+				}
+			}
+		});
+		std::swap(source, destination);
+	}
+	if (source != _items.data()) {
+		_items.swap(_scratch);
+	}
+}
+
+#pragma endregion RenderQueue }
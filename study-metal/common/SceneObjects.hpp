@@ -0,0 +1,210 @@
+/*
+ * SceneObjects.hpp
+ *
+ * Scene에 놓인 물체들의 bounds를 structure-of-arrays로 들고 있는 store.
+ * 물체 하나의 bounding sphere와 AABB가 성분마다 따로 연속된 배열에 있어서 frustum culling이
+ * 8개씩(Lanes8) 한 번에 읽는다. 먼저 sphere로 6개 평면을 검사하고, 남은 것만 AABB로 다시 검사한다.
+ * 결과는 보이는 물체 번호만 모은 목록이다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "MathTypes.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+struct FrustumCullStats {
+	size_t tested{0};
+	// sphere 검사에서 떨어진 수
+	size_t sphereCulled{0};
+	// sphere는 걸치지만 AABB 검사에서 떨어진 수
+	size_t boxCulled{0};
+	size_t visible{0};
+};
+
+class SceneObjectStore {
+	public:
+		// 물체를 추가하고 번호를 반환한다. bounding sphere는 AABB를 감싸는 구로 정한다.
+		uint32_t add(const Aabb& bounds, uint32_t userData = 0);
+		void setBounds(uint32_t object, const Aabb& bounds);
+		// 마지막 물체를 object 자리로 옮긴다. 옮겨진 물체는 userData로 찾는다.
+		void remove(uint32_t object);
+		void clear();
+		void reserve(size_t count);
+
+		size_t size() const { return _userData.size(); }
+		uint32_t userData(uint32_t object) const { return _userData[object]; }
+		Aabb bounds(uint32_t object) const;
+
+		/*
+		 * viewProjection의 frustum과 겹치는 물체 번호를 visible에 오름차순으로 채운다.
+		 * 경계에 걸친 물체는 보이는 것으로 본다.
+		 * */
+		FrustumCullStats cull(const Float4x4& viewProjection, std::vector<uint32_t>& visible, ThreadPool& pool = ThreadPool::shared()) const;
+
+	private:
+		void write(uint32_t object, const Aabb& bounds);
+
+		// 길이는 size()를 8의 배수로 올린 값. 남는 자리는 반지름이 -inf라서 항상 떨어진다.
+		std::vector<float> _centerX, _centerY, _centerZ, _radius;
+		std::vector<float> _minX, _minY, _minZ, _maxX, _maxY, _maxZ;
+		std::vector<uint32_t> _userData;
+};
+
+#pragma region SceneObjectStore {
+
+inline uint32_t SceneObjectStore::add(const Aabb& bounds, uint32_t userData)
+{
+	uint32_t object = uint32_t(_userData.size());
+	_userData.push_back(userData);
+	size_t padded = (_userData.size() + 7) & ~size_t(7);
+	if (_radius.size() < padded) {
+		for (std::vector<float>* lane : { &_centerX, &_centerY, &_centerZ, &_minX, &_minY, &_minZ, &_maxX, &_maxY, &_maxZ }) {
+			lane->resize(padded, 0.0f);
+		}
+		_radius.resize(padded, -INFINITY);
+	}
+	write(object, bounds);
+	return object;
+}
+
+inline void SceneObjectStore::setBounds(uint32_t object, const Aabb& bounds)
+{
+	write(object, bounds);
+}
+
+inline void SceneObjectStore::remove(uint32_t object)
+{
+	uint32_t last = uint32_t(_userData.size() - 1);
+	if (object != last) {
+		write(object, bounds(last));
+		_userData[object] = _userData[last];
+	}
+	_radius[last] = -INFINITY;
+	_userData.pop_back();
+}
+
+inline void SceneObjectStore::clear()
+{
+	for (std::vector<float>* lane : { &_centerX, &_centerY, &_centerZ, &_radius, &_minX, &_minY, &_minZ, &_maxX, &_maxY, &_maxZ }) {
+		lane->clear();
+	}
+	_userData.clear();
+}
+
+inline void SceneObjectStore::reserve(size_t count)
+{
+	size_t padded = (count + 7) & ~size_t(7);
+	for (std::vector<float>* lane : { &_centerX, &_centerY, &_centerZ, &_radius, &_minX, &_minY, &_minZ, &_maxX, &_maxY, &_maxZ }) {
+		lane->reserve(padded);
+	}
+	_userData.reserve(count);
+}
+
+inline Aabb SceneObjectStore::bounds(uint32_t object) const
+{
+	return { { _minX[object], _minY[object], _minZ[object] }, { _maxX[object], _maxY[object], _maxZ[object] } };
+}
+
+inline void SceneObjectStore::write(uint32_t object, const Aabb& bounds)
+{
+	Float3 min = unpack(bounds.min), max = unpack(bounds.max);
+	Float3 center = (min + max) * 0.5f;
+	_centerX[object] = center.x;
+	_centerY[object] = center.y;
+	_centerZ[object] = center.z;
+	_radius[object] = length(max - center);
+	_minX[object] = min.x;
+	_minY[object] = min.y;
+	_minZ[object] = min.z;
+	_maxX[object] = max.x;
+	_maxY[object] = max.y;
+	_maxZ[object] = max.z;
+}
+
+inline FrustumCullStats SceneObjectStore::cull(const Float4x4& viewProjection, std::vector<uint32_t>& visible, ThreadPool& pool) const
+{
+	FrustumCullStats stats;
+	stats.tested = size();
+	visible.resize(size());
+	if (size() == 0) {
+		return stats;
+	}
+	Float4 planes[6];
+	extractFrustumPlanes(viewProjection, planes);
+
+	// 조각마다 visible의 자기 구간 앞쪽에 쓰고, 끝나면 앞으로 당겨 붙인다.
+	const size_t numberOfBlocks = (size() + 7) / 8;
+	const size_t grain = 1 << 10;
+	struct Chunk {
+		FrustumCullStats stats;
+		size_t count{0};
+	};
+	std::vector<Chunk> chunks((numberOfBlocks + grain - 1) / grain);
+	pool.parallelFor(numberOfBlocks, grain, [&](size_t begin, size_t end) {
+		Chunk& chunk = chunks[begin / grain];
+		uint32_t* output = visible.data() + begin * 8;
+		for (size_t block = begin; block < end; ++block) {
+			const size_t first = block * 8;
+			const int lanes = int(std::min<size_t>(8, size() - first));
+			const int valid = (1 << lanes) - 1;
+
+			// 1. sphere: 모든 평면에서 dot(n, c) + d >= -r
+			Lanes8 centerX = Lanes8::load(_centerX.data() + first);
+			Lanes8 centerY = Lanes8::load(_centerY.data() + first);
+			Lanes8 centerZ = Lanes8::load(_centerZ.data() + first);
+			Lanes8 negativeRadius = Lanes8::splat(0.0f) - Lanes8::load(_radius.data() + first);
+			int inside = valid;
+			for (int p = 0; p < 6 && inside; ++p) {
+				const Float4& plane = planes[p];
+				Lanes8 distance = multiplyAdd(Lanes8::splat(plane.x), centerX,
+					multiplyAdd(Lanes8::splat(plane.y), centerY, multiplyAdd(Lanes8::splat(plane.z), centerZ, Lanes8::splat(plane.w))));
+				inside &= lessEqualMask(negativeRadius, distance);
+			}
+			chunk.stats.sphereCulled += lanes - __builtin_popcount(inside);
+
+			// 2. AABB: 평면 normal 방향으로 가장 먼 꼭짓점(p-vertex)이 안쪽에 있어야 한다.
+			// normal 부호는 평면마다 정해지므로 min / max 배열 중 하나를 고르기만 하면 된다.
+			if (inside) {
+				int boxInside = inside;
+				for (int p = 0; p < 6 && boxInside; ++p) {
+					const Float4& plane = planes[p];
+					Lanes8 x = Lanes8::load((plane.x >= 0.0f ? _maxX : _minX).data() + first);
+					Lanes8 y = Lanes8::load((plane.y >= 0.0f ? _maxY : _minY).data() + first);
+					Lanes8 z = Lanes8::load((plane.z >= 0.0f ? _maxZ : _minZ).data() + first);
+					Lanes8 distance = multiplyAdd(Lanes8::splat(plane.x), x,
+						multiplyAdd(Lanes8::splat(plane.y), y, multiplyAdd(Lanes8::splat(plane.z), z, Lanes8::splat(plane.w))));
+					boxInside &= lessEqualMask(Lanes8::splat(0.0f), distance);
+				}
+				chunk.stats.boxCulled += __builtin_popcount(inside) - __builtin_popcount(boxInside);
+				inside = boxInside;
+			}
+
+			// 3. 살아남은 lane의 번호를 차례로 쓴다.
+			while (inside) {
+				int lane = __builtin_ctz(unsigned(inside));
+				inside &= inside - 1;
+				output[chunk.count++] = uint32_t(first + lane);
+			}
+		}
+	});
+
+	size_t written = 0;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		const Chunk& chunk = chunks[i];
+		const uint32_t* source = visible.data() + i * grain * 8;
+		std::copy(source, source + chunk.count, visible.data() + written);
+		written += chunk.count;
+		stats.sphereCulled += chunk.stats.sphereCulled;
+		stats.boxCulled += chunk.stats.boxCulled;
+	}
+	visible.resize(written);
+	stats.visible = written;
+	return stats;
+}
+
+#pragma endregion SceneObjectStore }
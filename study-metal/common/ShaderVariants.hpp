@@ -0,0 +1,123 @@
+/*
+ * ShaderVariants.hpp
+ *
+ * scene shader의 기능을 function constant로 정해 기능 조합(variant)마다 따로 compile 한다.
+ *  - ShaderFeature: vertex color, texture, fog, skinning. bit 번호가 shader.metal의 [[function_constant(n)]] 번호이다.
+ *    꺼진 기능의 attribute, texture 읽기, 계산은 compiler가 지우므로 shader 안에서 uniform으로 갈라지지 않는다.
+ *  - setShaderVariant: variant의 function constant를 PipelineKey에 넣는다. variant마다 key가 다르므로 PipelineCache가
+ *    variant마다 MTL::Function을 specialize 하고 .lmpc manifest에도 variant 그대로 남는다.
+ *  - enumerateShaderVariants: scene에서 실제로 그리는 primitive의 attribute와 renderer가 켠 기능으로 나올 수 있는
+ *    variant만 고른다. 16가지를 모두 compile 하지 않고 이것만 prewarm 한다. (tools/shader-variants)
+ * 여기 있는 것은 GPU 없이 돌아간다. CPU에서 uber shader와 variant를 비교하는 것은 bench/shader-variants이다.
+ * */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GltfLoader.hpp"
+#include "PipelineCache.hpp"
+
+enum ShaderFeature : uint32_t {
+	ShaderFeatureVertexColor = 1 << 0,
+	ShaderFeatureTexture = 1 << 1,
+	ShaderFeatureFog = 1 << 2,
+	ShaderFeatureSkinning = 1 << 3,
+};
+
+static const uint32_t kShaderFeatureCount = 4;
+static const uint32_t kShaderVariantCount = 1 << kShaderFeatureCount;
+
+// renderer가 켤 수 있는 기능. primitive에 attribute가 있어도 여기서 꺼져 있으면 쓰지 않는다.
+struct ShaderVariantOptions {
+	// scene에 입힐 base color texture가 있다.
+	bool texture{false};
+	bool fog{false};
+	// joint 행렬을 올린다.
+	bool skinning{false};
+};
+
+// 한 variant를 쓰는 primitive 수와 draw 수. draw 수는 그 primitive를 가진 mesh가 scene에 놓인 횟수의 합이다.
+struct ShaderVariantUsage {
+	uint32_t features;
+	uint32_t primitives;
+	uint32_t draws;
+};
+
+// "color+texture"처럼 켜진 기능 이름을 잇는다. 아무것도 없으면 "base"
+std::string shaderVariantName(uint32_t features);
+void setShaderVariant(PipelineKey& key, uint32_t features);
+uint32_t shaderVariantOf(const GltfPrimitive& primitive, const ShaderVariantOptions& options);
+// scene.draws가 가리키는 mesh의 primitive만 센다. features 순서로 정렬되어 있다.
+std::vector<ShaderVariantUsage> enumerateShaderVariants(const GltfScene& scene, const ShaderVariantOptions& options);
+
+#pragma region ShaderVariants {
+
+inline std::string shaderVariantName(uint32_t features)
+{
+	static const char* const names[kShaderFeatureCount] = { "color", "texture", "fog", "skinning" };
+	std::string name;
+	for (uint32_t i = 0; i < kShaderFeatureCount; ++i) {
+		if (features & (1u << i)) {
+			name += name.empty() ? names[i] : std::string("+") + names[i];
+		}
+	}
+	return name.empty() ? "base" : name;
+}
+
+// 꺼진 기능도 false로 넣는다. 값이 없는 function constant는 compile 할 때 오류가 된다.
+inline void setShaderVariant(PipelineKey& key, uint32_t features)
+{
+	for (uint32_t i = 0; i < kShaderFeatureCount; ++i) {
+		key.setConstant(i, bool(features & (1u << i)));
+	}
+}
+
+inline uint32_t shaderVariantOf(const GltfPrimitive& primitive, const ShaderVariantOptions& options)
+{
+	uint32_t features = 0;
+	if (primitive.accessors[GltfAttributeSlotColor] >= 0) {
+		features |= ShaderFeatureVertexColor;
+	}
+	if (options.texture && primitive.accessors[GltfAttributeSlotTexcoord] >= 0) {
+		features |= ShaderFeatureTexture;
+	}
+	if (options.fog) {
+		features |= ShaderFeatureFog;
+	}
+	if (options.skinning && primitive.skinned) {
+		features |= ShaderFeatureSkinning;
+	}
+	return features;
+}
+
+inline std::vector<ShaderVariantUsage> enumerateShaderVariants(const GltfScene& scene, const ShaderVariantOptions& options)
+{
+	std::vector<uint32_t> drawsOfMesh(scene.meshes.size(), 0);
+	for (const GltfDraw& draw : scene.draws) {
+		if (draw.mesh < drawsOfMesh.size()) {
+			++drawsOfMesh[draw.mesh];
+		}
+	}
+	ShaderVariantUsage usage[kShaderVariantCount] = {};
+	for (size_t m = 0; m < scene.meshes.size(); ++m) {
+		if (drawsOfMesh[m] == 0) {
+			continue;
+		}
+		for (const GltfPrimitive& primitive : scene.meshes[m].primitives) {
+			ShaderVariantUsage& variant = usage[shaderVariantOf(primitive, options)];
+			++variant.primitives;
+			variant.draws += drawsOfMesh[m];
+		}
+	}
+	std::vector<ShaderVariantUsage> variants;
+	for (uint32_t features = 0; features < kShaderVariantCount; ++features) {
+		if (usage[features].primitives) {
+			variants.push_back({ features, usage[features].primitives, usage[features].draws });
+		}
+	}
+	return variants;
+}
+
+#pragma endregion ShaderVariants }
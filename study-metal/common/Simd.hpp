@@ -0,0 +1,125 @@
+/*
+ * Simd.hpp
+ *
+ * float 4개를 한번에 계산하는 최소한의 SIMD wrapper. x86은 SSE, arm64(Apple silicon)는 NEON,
+ * 나머지는 scalar로 같은 결과를 낸다. BVH traversal, occlusion test처럼 4개씩 묶어 처리하는 곳에서 쓴다.
+ *
+ * Lanes8은 8개씩 처리한다. AVX2로 빌드하면(-mavx2) 256 bit register 하나, 아니면 Lanes4 두 개이다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SIMD_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_AVX2 1
+#endif
+
+#pragma region Lanes4 {
+
+#if SIMD_SSE
+struct Lanes4 {
+	__m128 v;
+	static Lanes4 load(const float* p) { return { _mm_loadu_ps(p) }; }
+	static Lanes4 splat(float f) { return { _mm_set1_ps(f) }; }
+};
+inline Lanes4 operator+(Lanes4 a, Lanes4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Lanes4 operator-(Lanes4 a, Lanes4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Lanes4 operator*(Lanes4 a, Lanes4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Lanes4 operator/(Lanes4 a, Lanes4 b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Lanes4 min(Lanes4 a, Lanes4 b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Lanes4 max(Lanes4 a, Lanes4 b) { return { _mm_max_ps(a.v, b.v) }; }
+// a <= b인 lane의 bit mask
+inline int lessEqualMask(Lanes4 a, Lanes4 b) { return _mm_movemask_ps(_mm_cmple_ps(a.v, b.v)); }
+inline void store(float* p, Lanes4 a) { _mm_storeu_ps(p, a.v); }
+#elif SIMD_NEON
+struct Lanes4 {
+	float32x4_t v;
+	static Lanes4 load(const float* p) { return { vld1q_f32(p) }; }
+	static Lanes4 splat(float f) { return { vdupq_n_f32(f) }; }
+};
+inline Lanes4 operator+(Lanes4 a, Lanes4 b) { return { vaddq_f32(a.v, b.v) }; }
+inline Lanes4 operator-(Lanes4 a, Lanes4 b) { return { vsubq_f32(a.v, b.v) }; }
+inline Lanes4 operator*(Lanes4 a, Lanes4 b) { return { vmulq_f32(a.v, b.v) }; }
+inline Lanes4 operator/(Lanes4 a, Lanes4 b) { return { vdivq_f32(a.v, b.v) }; }
+inline Lanes4 min(Lanes4 a, Lanes4 b) { return { vminq_f32(a.v, b.v) }; }
+inline Lanes4 max(Lanes4 a, Lanes4 b) { return { vmaxq_f32(a.v, b.v) }; }
+inline int lessEqualMask(Lanes4 a, Lanes4 b)
+{
+	static const int32_t shifts[4] = { 0, 1, 2, 3 };
+	uint32x4_t bits = vshrq_n_u32(vcleq_f32(a.v, b.v), 31);
+	return int(vaddvq_u32(vshlq_u32(bits, vld1q_s32(shifts))));
+}
+inline void store(float* p, Lanes4 a) { vst1q_f32(p, a.v); }
+#else
+struct Lanes4 {
+	float v[4];
+	static Lanes4 load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+	static Lanes4 splat(float f) { return { { f, f, f, f } }; }
+};
+inline Lanes4 operator+(Lanes4 a, Lanes4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+inline Lanes4 operator-(Lanes4 a, Lanes4 b) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+inline Lanes4 operator*(Lanes4 a, Lanes4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+inline Lanes4 operator/(Lanes4 a, Lanes4 b) { return { { a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3] } }; }
+inline Lanes4 min(Lanes4 a, Lanes4 b) { return { { std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]), std::min(a.v[3], b.v[3]) } }; }
+inline Lanes4 max(Lanes4 a, Lanes4 b) { return { { std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2]), std::max(a.v[3], b.v[3]) } }; }
+inline int lessEqualMask(Lanes4 a, Lanes4 b)
+{
+	return (a.v[0] <= b.v[0]) | (a.v[1] <= b.v[1]) << 1 | (a.v[2] <= b.v[2]) << 2 | (a.v[3] <= b.v[3]) << 3;
+}
+inline void store(float* p, Lanes4 a) { std::memcpy(p, a.v, sizeof(a.v)); }
+#endif
+
+#pragma endregion Lanes4 }
+
+#pragma region Lanes8 {
+
+#if SIMD_AVX2
+struct Lanes8 {
+	__m256 v;
+	static Lanes8 load(const float* p) { return { _mm256_loadu_ps(p) }; }
+	static Lanes8 splat(float f) { return { _mm256_set1_ps(f) }; }
+};
+inline Lanes8 operator+(Lanes8 a, Lanes8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Lanes8 operator-(Lanes8 a, Lanes8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Lanes8 operator*(Lanes8 a, Lanes8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Lanes8 min(Lanes8 a, Lanes8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Lanes8 max(Lanes8 a, Lanes8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+// a * b + c
+inline Lanes8 multiplyAdd(Lanes8 a, Lanes8 b, Lanes8 c)
+{
+#if defined(__FMA__)
+	return { _mm256_fmadd_ps(a.v, b.v, c.v) };
+#else
+	return a * b + c;
+#endif
+}
+inline int lessEqualMask(Lanes8 a, Lanes8 b) { return _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+inline void store(float* p, Lanes8 a) { _mm256_storeu_ps(p, a.v); }
+#else
+struct Lanes8 {
+	Lanes4 low, high;
+	static Lanes8 load(const float* p) { return { Lanes4::load(p), Lanes4::load(p + 4) }; }
+	static Lanes8 splat(float f) { return { Lanes4::splat(f), Lanes4::splat(f) }; }
+};
+inline Lanes8 operator+(Lanes8 a, Lanes8 b) { return { a.low + b.low, a.high + b.high }; }
+inline Lanes8 operator-(Lanes8 a, Lanes8 b) { return { a.low - b.low, a.high - b.high }; }
+inline Lanes8 operator*(Lanes8 a, Lanes8 b) { return { a.low * b.low, a.high * b.high }; }
+inline Lanes8 min(Lanes8 a, Lanes8 b) { return { min(a.low, b.low), min(a.high, b.high) }; }
+inline Lanes8 max(Lanes8 a, Lanes8 b) { return { max(a.low, b.low), max(a.high, b.high) }; }
+inline Lanes8 multiplyAdd(Lanes8 a, Lanes8 b, Lanes8 c) { return a * b + c; }
+inline int lessEqualMask(Lanes8 a, Lanes8 b) { return lessEqualMask(a.low, b.low) | lessEqualMask(a.high, b.high) << 4; }
+inline void store(float* p, Lanes8 a) { store(p, a.low); store(p + 4, a.high); }
+#endif
+
+#pragma endregion Lanes8 }
@@ -0,0 +1,710 @@
+/*
+ * Simplifier.hpp
+ *
+ * Quadric error metric(Garland & Heckbert)을 쓰는 edge collapse 단순화와 LOD chain.
+ * vertex는 새로 만들지 않고 기존 vertex로 합치기 때문에 모든 LOD가 같은 vertex buffer를 쓰고
+ * normal, color, texcoord 같은 attribute도 그대로 남는다. attribute 차이는 collapse 순서를 정하는 비용에만 더하고
+ * LOD 오차는 위치 quadric으로만 잰다. UV / normal seam의 vertex는 같은 위치의 짝과 함께 seam을 따라 옮긴다.
+ *
+ * 한 pass에서 모든 edge의 비용을 병렬로 계산하고, 싼 것부터 서로 겹치지 않는 collapse를 적용한다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "MathTypes.hpp"
+#include "MeshData.hpp"
+#include "MeshImporter.hpp"
+#include "ThreadPool.hpp"
+
+struct SimplifyOptions {
+	// 이 수 이하의 index가 되면 멈춘다.
+	size_t targetIndexCount{0};
+	// mesh 크기에 대한 상대 오차(위치만). 이보다 큰 collapse는 하지 않는다.
+	float targetError{0.01f};
+	// collapse 순서를 정할 때 normal / color / texcoord 차이(제곱)에 주는 가중치. 위치 오차는 mesh 크기를 1로 둔 거리의 제곱이다.
+	float attributeWeight{0.01f};
+};
+
+// 한 LOD는 MeshLodChain::indices의 [indexOffset, indexOffset + indexCount) 구간이다.
+struct MeshLod {
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	// 원래 mesh에서 벗어난 최대 거리 (mesh 좌표계). attribute 차이는 들어가지 않는다.
+	float error;
+};
+
+struct MeshLodChain {
+	std::vector<uint32_t> indices;
+	// lods[0]은 원래 mesh이고 뒤로 갈수록 거칠어진다.
+	std::vector<MeshLod> lods;
+};
+
+struct LodChainOptions {
+	size_t maxLods{8};
+	// LOD마다 삼각형 수를 이 비율로 줄인다.
+	float reduction{0.5f};
+	// 삼각형이 이만큼 남으면 더 만들지 않는다.
+	size_t minTriangles{64};
+	// 가장 거친 LOD까지 허용하는 mesh 크기에 대한 상대 오차
+	float maxError{0.1f};
+	float attributeWeight{0.01f};
+};
+
+/*
+ * indices(mesh의 vertex를 가리키는 triangle list)를 단순화해서 out에 쓴다.
+ * 반환값은 결과의 위치 오차 (mesh 좌표계의 거리).
+ * */
+float simplifyMesh(const MeshData& mesh, const std::vector<uint32_t>& indices, const SimplifyOptions& options,
+		std::vector<uint32_t>& out, ThreadPool& pool = ThreadPool::shared());
+void buildLodChain(const MeshData& mesh, const LodChainOptions& options, MeshLodChain& chain,
+		ThreadPool& pool = ThreadPool::shared());
+
+/*
+ * 화면에서 오차가 maxPixelError 이하인 가장 거친 LOD를 고른다.
+ * pixelsPerUnit은 mesh 좌표계의 길이 1이 화면에서 몇 pixel인지이다 (lodPixelsPerUnit).
+ * */
+size_t selectLod(const std::vector<MeshLod>& lods, float pixelsPerUnit, float maxPixelError = 1.0f);
+// 원근 투영이면 projectionScaleY = projection[1][1], distance = 카메라와의 거리. 직교 투영이면 distance = 1.
+float lodPixelsPerUnit(float projectionScaleY, float viewportHeight, float distance);
+/*
+ * instance 하나의 lodPixelsPerUnit. projection[1][1], view space에서 bounds(mesh 좌표의 중심과 반지름)의 가장 가까운 점까지의 거리,
+ * modelView의 가장 큰 축 배율을 쓴다. 직교 투영(projection[3][3] == 1)이면 거리는 1이다.
+ * */
+float instancePixelsPerUnit(const Float4x4& projection, const Float4x4& modelView, Float3 boundsCenter, float boundsRadius,
+		float viewportHeight);
+
+#pragma region Quadric {
+
+namespace SimplifierDetail {
+
+// 대칭 4x4 행렬 [A b; b^T c]. error(p) = p^T A p + 2 b.p + c
+struct Quadric {
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	// 이 quadric에 모인 면적. attribute 비용의 가중치로 쓴다.
+	double area;
+};
+
+inline Quadric planeQuadric(Float3 n, float d, double weight)
+{
+	return { weight * n.x * n.x, weight * n.x * n.y, weight * n.x * n.z, weight * n.y * n.y, weight * n.y * n.z,
+		weight * n.z * n.z, weight * n.x * d, weight * n.y * d, weight * n.z * d, weight * d * d, weight };
+}
+
+inline void add(Quadric& q, const Quadric& r)
+{
+	q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02; q.a11 += r.a11; q.a12 += r.a12; q.a22 += r.a22;
+	q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+	q.c += r.c;
+	q.area += r.area;
+}
+
+inline double evaluate(const Quadric& q, Float3 p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double value = q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + q.a11 * y * y + 2 * q.a12 * y * z + q.a22 * z * z
+		+ 2 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+	return std::max(value, 0.0);
+}
+
+} // namespace SimplifierDetail
+
+#pragma endregion Quadric }
+
+#pragma region Simplifier {
+
+namespace SimplifierDetail {
+
+enum VertexKind : uint8_t {
+	Manifold,
+	// 열린 경계 위의 vertex. 경계 edge를 따라서만 움직인다.
+	Border,
+	// 같은 위치에 attribute만 다른 vertex(wedge)가 있다. seam edge를 따라서만, 같은 위치의 vertex와 함께 움직인다.
+	Seam,
+	// 경계가 갈라지거나 경계 위에 seam이 있는 점, 또는 wedge가 너무 많은 점. 지우지 않는다.
+	Locked,
+};
+
+struct Collapse {
+	uint32_t from;
+	uint32_t to;
+	// collapse 순서를 정하는 비용. 위치 오차 + attribute 비용
+	float cost;
+	// 위치 quadric만의 오차 (정규화된 좌표에서 거리의 제곱). 오차 한계와 LOD 오차는 이것으로 정한다.
+	float error;
+};
+
+// seam vertex와 함께 옮기는 같은 위치의 vertex 수의 상한
+static constexpr size_t kMaxWedgeSize = 8;
+static constexpr uint32_t kNoVertex = UINT32_MAX;
+
+// vertex -> 삼각형 (CSR)
+inline void buildAdjacency(size_t numberOfVertices, const std::vector<uint32_t>& indices,
+		std::vector<uint32_t>& offsets, std::vector<uint32_t>& triangles)
+{
+	offsets.assign(numberOfVertices + 1, 0);
+	for (uint32_t v : indices) {
+		++offsets[v + 1];
+	}
+	for (size_t v = 0; v < numberOfVertices; ++v) {
+		offsets[v + 1] += offsets[v];
+	}
+	std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+	triangles.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i) {
+		triangles[cursor[indices[i]]++] = uint32_t(i / 3);
+	}
+}
+
+/*
+ * 한 번 만든 quadric과 vertex 분류를 유지하면서 simplify를 여러 번 부를 수 있다.
+ * LOD chain은 같은 Simplifier로 목표를 점점 낮추며 만들기 때문에 오차도 처음 mesh 기준으로 누적된다.
+ * */
+class Simplifier {
+	public:
+		Simplifier(const MeshData& mesh, const std::vector<uint32_t>& indices, float attributeWeight, ThreadPool& pool)
+		: _mesh(mesh), _attributeWeight(attributeWeight), _pool(pool), _indices(indices)
+		{
+			if (_mesh.positions.empty() || _indices.empty()) {
+				return;
+			}
+			normalizePositions();
+			weldPositions();
+			classifyVertices(_indices);
+			buildQuadrics(_indices);
+		}
+
+		const std::vector<uint32_t>& indices() const { return _indices; }
+
+		// 반환값은 지금까지 한 collapse의 최대 위치 오차 (mesh 좌표계의 거리)
+		float simplify(size_t targetIndexCount, float targetError)
+		{
+			// 오차는 정규화된 좌표에서 거리의 제곱으로 계산된다.
+			const double errorLimit = double(targetError) * targetError;
+			std::vector<Collapse> collapses;
+			while (_indices.size() > targetIndexCount) {
+				buildAdjacency(_mesh.positions.size(), _indices, _offsets, _triangles);
+				resetRemap();
+				collectCollapses(_indices, errorLimit, collapses);
+				if (collapses.empty()) {
+					break;
+				}
+				size_t trianglesToRemove = (_indices.size() - targetIndexCount) / 3;
+				if (applyCollapses(_indices, collapses, trianglesToRemove, _resultError) == 0) {
+					break;
+				}
+				compact(_indices);
+			}
+			return float(std::sqrt(_resultError) * _extent);
+		}
+
+	private:
+		void normalizePositions()
+		{
+			Float3 boundsMin, boundsMax;
+			_mesh.computeBounds(boundsMin, boundsMax);
+			Float3 size = boundsMax - boundsMin;
+			_extent = std::max(size.x, std::max(size.y, size.z));
+			float scale = _extent > 0.0f ? 1.0f / _extent : 1.0f;
+			_positions.resize(_mesh.positions.size());
+			_pool.parallelFor(_positions.size(), 1 << 16, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					_positions[i] = (_mesh.positions[i] - boundsMin) * scale;
+				}
+			});
+		}
+
+		// 위치가 같은 vertex를 묶는다. attribute만 다른 vertex가 있으면 seam이다.
+		void weldPositions()
+		{
+			auto bits = [](float f) { uint32_t u; std::memcpy(&u, &f, 4); return u; };
+			auto hash = [&](size_t i) {
+				const Float3& p = _mesh.positions[i];
+				using MeshImporterDetail::hashCombine;
+				return hashCombine(hashCombine(hashCombine(0, bits(p.x)), bits(p.y)), bits(p.z));
+			};
+			auto equal = [&](size_t i, size_t j) {
+				const Float3& a = _mesh.positions[i];
+				const Float3& b = _mesh.positions[j];
+				return a.x == b.x && a.y == b.y && a.z == b.z;
+			};
+			std::vector<uint32_t> representatives;
+			deduplicate(_mesh.positions.size(), hash, equal, _wedges, representatives, _pool);
+			_wedgeSizes.assign(representatives.size(), 0);
+			// 같은 위치의 vertex를 고리로 잇는다.
+			std::vector<uint32_t> first(representatives.size(), kNoVertex), last(representatives.size(), kNoVertex);
+			_wedgeNext.resize(_wedges.size());
+			for (uint32_t v = 0; v < _wedges.size(); ++v) {
+				uint32_t wedge = _wedges[v];
+				++_wedgeSizes[wedge];
+				if (last[wedge] == kNoVertex) {
+					first[wedge] = v;
+				} else {
+					_wedgeNext[last[wedge]] = v;
+				}
+				last[wedge] = v;
+			}
+			for (size_t wedge = 0; wedge < first.size(); ++wedge) {
+				_wedgeNext[last[wedge]] = first[wedge];
+			}
+		}
+
+		void classifyVertices(const std::vector<uint32_t>& indices)
+		{
+			// 위치 기준 edge를 세어서 한 번만 나오면 경계이다.
+			std::vector<uint64_t> edges;
+			edges.reserve(indices.size());
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				for (int k = 0; k < 3; ++k) {
+					uint64_t a = _wedges[indices[i + k]], b = _wedges[indices[i + (k + 1) % 3]];
+					edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			std::vector<uint8_t> borderCount(_wedgeSizes.size(), 0);
+			for (size_t i = 0; i < edges.size();) {
+				size_t j = i;
+				while (j < edges.size() && edges[j] == edges[i]) {
+					++j;
+				}
+				if (j - i == 1) {
+					uint32_t a = uint32_t(edges[i] >> 32), b = uint32_t(edges[i]);
+					borderCount[a] = uint8_t(std::min(borderCount[a] + 1, 255));
+					borderCount[b] = uint8_t(std::min(borderCount[b] + 1, 255));
+				}
+				i = j;
+			}
+			_kinds.resize(_mesh.positions.size());
+			for (size_t v = 0; v < _kinds.size(); ++v) {
+				uint32_t wedge = _wedges[v];
+				if (_wedgeSizes[wedge] > 1) {
+					// seam이 꺾이는 corner는 짝을 찾지 못하므로 pairWedges가 막는다.
+					_kinds[v] = borderCount[wedge] == 0 && _wedgeSizes[wedge] <= kMaxWedgeSize ? Seam : Locked;
+				} else if (borderCount[wedge] == 0) {
+					_kinds[v] = Manifold;
+				} else {
+					// 경계가 한 줄로 지나가는 점만 경계를 따라 움직일 수 있다.
+					_kinds[v] = borderCount[wedge] == 2 ? Border : Locked;
+				}
+			}
+		}
+
+		// 지금 indices에서 vertex a와 b를 함께 가진 삼각형이 하나뿐이면 열린 edge이다. 경계와 seam의 edge가 그렇다.
+		bool isOpenEdge(const std::vector<uint32_t>& indices, uint32_t a, uint32_t b) const
+		{
+			int count = 0;
+			for (uint32_t i = _offsets[a]; i < _offsets[a + 1]; ++i) {
+				const uint32_t* t = &indices[_triangles[i] * 3];
+				count += t[0] == b || t[1] == b || t[2] == b;
+			}
+			return count == 1;
+		}
+
+		// 위치 기준으로 a와 b를 함께 가진 삼각형이 하나뿐이면 경계 edge이다.
+		bool isBorderEdge(const std::vector<uint32_t>& indices, uint32_t a, uint32_t b) const
+		{
+			const uint32_t wedge = _wedges[b];
+			int count = 0;
+			uint32_t v = a;
+			do {
+				for (uint32_t i = _offsets[v]; i < _offsets[v + 1]; ++i) {
+					const uint32_t* t = &indices[_triangles[i] * 3];
+					count += _wedges[t[0]] == wedge || _wedges[t[1]] == wedge || _wedges[t[2]] == wedge;
+				}
+				v = _wedgeNext[v];
+			} while (v != a);
+			return count == 1;
+		}
+
+		/*
+		 * from을 to로 옮길 때 같이 옮길 (vertex, 목적지) 쌍을 pairs에 채운다. seam이 아니면 (from, to) 하나이다.
+		 * seam이면 from과 같은 위치의 vertex마다, to와 같은 위치의 vertex 중 열린 edge로 이어진 것이 목적지이다.
+		 * 짝이 없는 vertex가 있으면 seam이 꺾이는 corner이므로 false를 반환한다. 삼각형이 없는 vertex는 옮기지 않는다.
+		 * */
+		bool pairWedges(const std::vector<uint32_t>& indices, uint32_t from, uint32_t to, uint32_t (&pairs)[kMaxWedgeSize][2],
+				size_t& count) const
+		{
+			pairs[0][0] = from;
+			pairs[0][1] = to;
+			count = 1;
+			if (_kinds[from] != Seam) {
+				return true;
+			}
+			const uint32_t wedge = _wedges[to];
+			for (uint32_t v = _wedgeNext[from]; v != from; v = _wedgeNext[v]) {
+				if (_offsets[v] == _offsets[v + 1]) {
+					continue;
+				}
+				uint32_t target = kNoVertex;
+				for (uint32_t i = _offsets[v]; i < _offsets[v + 1] && target == kNoVertex; ++i) {
+					const uint32_t* t = &indices[_triangles[i] * 3];
+					for (int k = 0; k < 3; ++k) {
+						if (_wedges[t[k]] == wedge && isOpenEdge(indices, v, t[k])) {
+							target = t[k];
+							break;
+						}
+					}
+				}
+				if (target == kNoVertex) {
+					return false;
+				}
+				pairs[count][0] = v;
+				pairs[count][1] = target;
+				++count;
+			}
+			return true;
+		}
+
+		// 삼각형 평면 quadric을 면적 가중치로 모으고, 경계 edge에는 수직 평면을 더해서 경계가 줄어들지 않게 한다.
+		void buildQuadrics(const std::vector<uint32_t>& indices)
+		{
+			buildAdjacency(_mesh.positions.size(), indices, _offsets, _triangles);
+			_quadrics.assign(_mesh.positions.size(), Quadric{});
+			_pool.parallelFor(_mesh.positions.size(), 1 << 12, [&](size_t begin, size_t end) {
+				for (size_t v = begin; v < end; ++v) {
+					Quadric& q = _quadrics[v];
+					for (uint32_t a = _offsets[v]; a < _offsets[v + 1]; ++a) {
+						const uint32_t* t = &indices[_triangles[a] * 3];
+						Float3 p0 = _positions[t[0]], p1 = _positions[t[1]], p2 = _positions[t[2]];
+						Float3 n = cross(p1 - p0, p2 - p0);
+						float area2 = length(n);
+						if (area2 <= 0.0f) {
+							continue;
+						}
+						n = n * (1.0f / area2);
+						add(q, planeQuadric(n, -dot(n, p0), area2 * 0.5));
+						if (_kinds[v] == Manifold) {
+							continue;
+						}
+						for (int k = 0; k < 3; ++k) {
+							uint32_t a0 = t[k], a1 = t[(k + 1) % 3];
+							// 경계와 seam 모두 열린 edge이다. seam도 곧게 남도록 같은 평면을 더한다.
+							if ((a0 == v || a1 == v) && isOpenEdge(indices, a0, a1)) {
+								Float3 edge = _positions[a1] - _positions[a0];
+								Float3 m = normalize(cross(edge, n));
+								// 경계는 면보다 훨씬 눈에 띄므로 큰 가중치를 준다.
+								Quadric border = planeQuadric(m, -dot(m, _positions[a0]), dot(edge, edge) * 10.0);
+								border.area = 0.0;
+								add(q, border);
+							}
+						}
+					}
+				}
+			});
+		}
+
+		float attributeDistance(uint32_t a, uint32_t b) const
+		{
+			float distance = 0.0f;
+			if (_mesh.normals.size() == _mesh.positions.size()) {
+				Float3 d = _mesh.normals[a] - _mesh.normals[b];
+				distance += dot(d, d);
+			}
+			if (_mesh.colors.size() == _mesh.positions.size()) {
+				Float3 d = _mesh.colors[a] - _mesh.colors[b];
+				distance += dot(d, d);
+			}
+			if (_mesh.texcoords.size() == _mesh.positions.size()) {
+				float dx = _mesh.texcoords[a].x - _mesh.texcoords[b].x;
+				float dy = _mesh.texcoords[a].y - _mesh.texcoords[b].y;
+				distance += dx * dx + dy * dy;
+			}
+			return distance;
+		}
+
+		bool canCollapse(const std::vector<uint32_t>& indices, uint32_t from, uint32_t to) const
+		{
+			switch (_kinds[from]) {
+				case Manifold: return true;
+				case Border: return _kinds[to] != Manifold && isBorderEdge(indices, from, to);
+				case Seam: return isOpenEdge(indices, from, to);
+				default: return false;
+			}
+		}
+
+		// 면적으로 나눈 quadric 오차 (정규화된 좌표에서 거리의 제곱)
+		double positionError(uint32_t from, uint32_t to) const
+		{
+			const Quadric& q = _quadrics[from];
+			return evaluate(q, _positions[to]) / std::max(q.area, 1e-12);
+		}
+
+		/*
+		 * 함께 옮기는 쌍을 모두 더한 비용과, 그중 가장 큰 위치 오차로 collapse를 만든다.
+		 * seam의 짝을 찾지 못하면 false
+		 * */
+		bool evaluateCollapse(const std::vector<uint32_t>& indices, uint32_t from, uint32_t to, Collapse& collapse) const
+		{
+			uint32_t pairs[kMaxWedgeSize][2];
+			size_t count = 0;
+			if (!pairWedges(indices, from, to, pairs, count)) {
+				return false;
+			}
+			double cost = 0.0, error = 0.0;
+			for (size_t i = 0; i < count; ++i) {
+				const double pairError = positionError(pairs[i][0], pairs[i][1]);
+				cost += pairError + _attributeWeight * attributeDistance(pairs[i][0], pairs[i][1]);
+				error = std::max(error, pairError);
+			}
+			collapse = { from, to, float(cost), float(error) };
+			return true;
+		}
+
+		/*
+		 * vertex마다 가장 싼 collapse 하나를 후보로 만든다.
+		 * 뒤집히는 collapse는 싸더라도 매 pass 다시 뽑히지 않도록 여기서 미리 빼고 다음으로 싼 것을 본다.
+		 * */
+		void collectCollapses(const std::vector<uint32_t>& indices, double errorLimit, std::vector<Collapse>& collapses)
+		{
+			const size_t numberOfVertices = _mesh.positions.size();
+			std::vector<Collapse> candidates(numberOfVertices);
+			_pool.parallelFor(numberOfVertices, 1 << 12, [&](size_t begin, size_t end) {
+				std::vector<Collapse> options;
+				for (size_t v = begin; v < end; ++v) {
+					candidates[v] = { uint32_t(v), uint32_t(v), INFINITY, INFINITY };
+					if (_kinds[v] == Locked || (_kinds[v] == Seam && !isFirstInWedge(uint32_t(v)))) {
+						continue;
+					}
+					// seam은 같은 위치의 vertex가 같이 움직이므로 그중 첫 vertex가 모든 짝의 edge를 보고 후보 하나를 낸다.
+					options.clear();
+					uint32_t s = uint32_t(v);
+					do {
+						for (uint32_t a = _offsets[s]; a < _offsets[s + 1]; ++a) {
+							const uint32_t* t = &indices[_triangles[a] * 3];
+							for (int k = 0; k < 3; ++k) {
+								Collapse option;
+								if (t[k] != s && canCollapse(indices, s, t[k]) && evaluateCollapse(indices, s, t[k], option)) {
+									options.push_back(option);
+								}
+							}
+						}
+						s = _kinds[v] == Seam ? _wedgeNext[s] : uint32_t(v);
+					} while (s != v);
+					std::sort(options.begin(), options.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+					for (const Collapse& option : options) {
+						if (option.error > errorLimit) {
+							continue;
+						}
+						if (!flips(indices, option.from, option.to)) {
+							candidates[v] = option;
+							break;
+						}
+					}
+				}
+			});
+			collapses.clear();
+			for (const Collapse& c : candidates) {
+				if (c.error <= errorLimit) {
+					collapses.push_back(c);
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+		}
+
+		void resetRemap()
+		{
+			_remap.resize(_mesh.positions.size());
+			for (size_t v = 0; v < _remap.size(); ++v) {
+				_remap[v] = uint32_t(v);
+			}
+		}
+
+		bool isFirstInWedge(uint32_t v) const
+		{
+			for (uint32_t s = _wedgeNext[v]; s != v; s = _wedgeNext[s]) {
+				if (s < v) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// from을 to로 (seam이면 같은 위치의 vertex를 모두 짝에게로) 옮겼을 때 주변 삼각형이 뒤집히는지 확인한다.
+		bool flips(const std::vector<uint32_t>& indices, uint32_t from, uint32_t to) const
+		{
+			uint32_t pairs[kMaxWedgeSize][2];
+			size_t count = 0;
+			if (!pairWedges(indices, from, to, pairs, count)) {
+				return true;
+			}
+			for (size_t i = 0; i < count; ++i) {
+				if (flipsTriangles(indices, pairs[i][0], pairs[i][1])) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool flipsTriangles(const std::vector<uint32_t>& indices, uint32_t from, uint32_t to) const
+		{
+			for (uint32_t a = _offsets[from]; a < _offsets[from + 1]; ++a) {
+				const uint32_t* t = &indices[_triangles[a] * 3];
+				uint32_t v[3] = { _remap[t[0]], _remap[t[1]], _remap[t[2]] };
+				if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2] || v[0] == to || v[1] == to || v[2] == to) {
+					continue;
+				}
+				Float3 before = cross(_positions[v[1]] - _positions[v[0]], _positions[v[2]] - _positions[v[0]]);
+				for (uint32_t& x : v) {
+					if (x == from) {
+						x = to;
+					}
+				}
+				Float3 after = cross(_positions[v[1]] - _positions[v[0]], _positions[v[2]] - _positions[v[0]]);
+				if (dot(before, after) <= 0.0f) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		size_t applyCollapses(const std::vector<uint32_t>& indices, const std::vector<Collapse>& collapses,
+				size_t trianglesToRemove, double& resultError)
+		{
+			_locked.assign(_mesh.positions.size(), 0);
+
+			// 한 pass에서 너무 비싼 collapse까지 가지 않도록, 필요한 수 근처의 비용을 기준으로 자른다.
+			// 목표에 거의 다 왔으면 pass를 여러 번 돌지 않도록 자르지 않는다.
+			size_t needed = std::min(collapses.size() - 1, trianglesToRemove / 2);
+			float costLimit = trianglesToRemove * 100 < indices.size() / 3 ? INFINITY : collapses[needed].cost * 1.5f;
+			size_t applied = 0;
+			size_t removed = 0;
+			for (const Collapse& c : collapses) {
+				if (removed >= trianglesToRemove || (c.cost > costLimit && applied > 0)) {
+					break;
+				}
+				uint32_t pairs[kMaxWedgeSize][2];
+				size_t count = 0;
+				if (!pairWedges(indices, c.from, c.to, pairs, count)) {
+					continue;
+				}
+				bool locked = false;
+				for (size_t i = 0; i < count; ++i) {
+					locked = locked || _locked[pairs[i][0]] || _locked[pairs[i][1]];
+				}
+				// 같은 pass의 앞선 collapse로 주변이 바뀌었을 수 있으므로 뒤집힘은 다시 확인한다.
+				if (locked || flips(indices, c.from, c.to)) {
+					continue;
+				}
+				for (size_t i = 0; i < count; ++i) {
+					_remap[pairs[i][0]] = pairs[i][1];
+					_locked[pairs[i][0]] = _locked[pairs[i][1]] = 1;
+					add(_quadrics[pairs[i][1]], _quadrics[pairs[i][0]]);
+				}
+				resultError = std::max(resultError, double(c.error));
+				// 경계 edge는 삼각형 하나, 안쪽 edge는 둘, seam edge는 짝마다 하나를 없앤다.
+				removed += _kinds[c.from] == Manifold ? 2 : _kinds[c.from] == Border ? 1 : count;
+				++applied;
+			}
+			return applied;
+		}
+
+		void compact(std::vector<uint32_t>& indices)
+		{
+			size_t write = 0;
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				uint32_t a = _remap[indices[i]], b = _remap[indices[i + 1]], c = _remap[indices[i + 2]];
+				if (a != b && b != c && a != c) {
+					indices[write++] = a;
+					indices[write++] = b;
+					indices[write++] = c;
+				}
+			}
+			indices.resize(write);
+		}
+
+		const MeshData& _mesh;
+		float _attributeWeight;
+		ThreadPool& _pool;
+		std::vector<uint32_t> _indices;
+		double _resultError{0.0};
+
+		// [0, 1]로 정규화한 위치와 원래 크기
+		std::vector<Float3> _positions;
+		float _extent{1.0f};
+		// vertex -> 같은 위치의 vertex 묶음 번호
+		std::vector<uint32_t> _wedges;
+		std::vector<uint32_t> _wedgeSizes;
+		// 같은 위치의 다음 vertex. 묶음마다 고리를 이룬다.
+		std::vector<uint32_t> _wedgeNext;
+		std::vector<VertexKind> _kinds;
+		std::vector<Quadric> _quadrics;
+		// pass마다 다시 만드는 상태
+		std::vector<uint32_t> _offsets;
+		std::vector<uint32_t> _triangles;
+		std::vector<uint32_t> _remap;
+		std::vector<uint8_t> _locked;
+};
+
+} // namespace SimplifierDetail
+
+inline float simplifyMesh(const MeshData& mesh, const std::vector<uint32_t>& indices, const SimplifyOptions& options,
+		std::vector<uint32_t>& out, ThreadPool& pool)
+{
+	SimplifierDetail::Simplifier simplifier(mesh, indices, options.attributeWeight, pool);
+	float error = simplifier.simplify(options.targetIndexCount, options.targetError);
+	out = simplifier.indices();
+	return error;
+}
+
+inline void buildLodChain(const MeshData& mesh, const LodChainOptions& options, MeshLodChain& chain, ThreadPool& pool)
+{
+	chain.indices = mesh.indices;
+	chain.lods.assign(1, MeshLod{ 0, uint32_t(mesh.indices.size()), 0.0f });
+
+	SimplifierDetail::Simplifier simplifier(mesh, mesh.indices, options.attributeWeight, pool);
+	while (chain.lods.size() < options.maxLods && simplifier.indices().size() / 3 > options.minTriangles) {
+		size_t previousSize = simplifier.indices().size();
+		float error = simplifier.simplify(size_t(previousSize / 3 * options.reduction) * 3, options.maxError);
+		// 거의 줄지 않았으면 오차 한계에 닿은 것이다.
+		if (simplifier.indices().size() > previousSize * 0.9) {
+			break;
+		}
+		const std::vector<uint32_t>& indices = simplifier.indices();
+		chain.lods.push_back(MeshLod{ uint32_t(chain.indices.size()), uint32_t(indices.size()), error });
+		chain.indices.insert(chain.indices.end(), indices.begin(), indices.end());
+	}
+}
+
+#pragma endregion Simplifier }
+
+#pragma region LodSelection {
+
+inline float lodPixelsPerUnit(float projectionScaleY, float viewportHeight, float distance)
+{
+	return 0.5f * viewportHeight * projectionScaleY / std::max(distance, 1e-6f);
+}
+
+inline float instancePixelsPerUnit(const Float4x4& projection, const Float4x4& modelView, Float3 boundsCenter, float boundsRadius,
+		float viewportHeight)
+{
+	const Float4* c = modelView.columns;
+	const float scale = std::sqrt(std::max({ c[0].x * c[0].x + c[0].y * c[0].y + c[0].z * c[0].z,
+				c[1].x * c[1].x + c[1].y * c[1].y + c[1].z * c[1].z, c[2].x * c[2].x + c[2].y * c[2].y + c[2].z * c[2].z }));
+	float distance = 1.0f;
+	if (projection.columns[3].w != 1.0f) {
+		// 카메라는 -z를 본다. bounds 안에 들어와 있으면 가장 정밀한 LOD가 되도록 아주 가깝게 둔다.
+		const Float3 center = transformPoint(modelView, boundsCenter);
+		distance = std::max(-center.z - boundsRadius * scale, 1e-3f);
+	}
+	return lodPixelsPerUnit(projection.columns[1].y, viewportHeight, distance) * scale;
+}
+
+inline size_t selectLod(const std::vector<MeshLod>& lods, float pixelsPerUnit, float maxPixelError)
+{
+	size_t selected = 0;
+	for (size_t i = 1; i < lods.size(); ++i) {
+		if (lods[i].error * pixelsPerUnit > maxPixelError) {
+			break;
+		}
+		selected = i;
+	}
+	return selected;
+}
+
+#pragma endregion LodSelection }
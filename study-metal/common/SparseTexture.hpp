@@ -0,0 +1,699 @@
+/*
+ * SparseTexture.hpp
+ *
+ * virtual texture: 아주 큰 texture를 tile 단위로 필요한 것만 GPU 메모리에 올린다.
+ *  - SparseTileLayout: level마다의 tile grid. tile 하나는 GPU sparse page 하나(기본 16 KB)이다.
+ *    한 변이라도 tile보다 작아지는 level부터는 mip tail로 묶어 처음부터 끝까지 올려 둔다. (MTL::Texture::firstMipmapInTail)
+ *  - .vtex 파일: header + tile(level, 행 순서, 모두 같은 크기) + mip tail. tile 하나를 seek 한 번으로 읽는다.
+ *  - SparseFeedback: 화면을 그리면서 읽은 tile을 tile마다 1 bit로 표시한다. shader는 같은 배치의 buffer에 atomic_fetch_or로 쓴다.
+ *  - SparseResidency: feedback으로 받은 tile을 LRU로 관리한다. 정해진 byte 예산이 차면 이번 frame에 쓰지 않은 가장 오래된 tile을 내린다.
+ *    없는 tile은 부모(더 작은 level)까지 같이 요청해 작은 level부터 읽는다. level 0 tile마다 부모까지 모두 올라와 있는
+ *    가장 정밀한 level을 residency map으로 유지하고, shader는 이 값을 min_lod_clamp로 써서 비어 있는 page를 읽지 않는다.
+ *  - SparseTileStreamer: 요청한 tile을 ThreadPool에서 읽어 두면 renderer가 frame마다 꺼내 map / blit 한다.
+ * Metal 호출(sparse heap, resource state encoder)은 01-primitive에 있고, 여기 있는 것은 GPU 없이 돌아간다. (bench/sparse-residency)
+ * */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "TextureLoader.hpp"
+#include "ThreadPool.hpp"
+
+// tile key: level 4 bit, y 14 bit, x 14 bit
+inline uint32_t sparseTileKey(uint32_t level, uint32_t x, uint32_t y) { return level << 28 | y << 14 | x; }
+inline uint32_t sparseTileLevel(uint32_t key) { return key >> 28; }
+inline uint32_t sparseTileX(uint32_t key) { return key & 0x3FFF; }
+inline uint32_t sparseTileY(uint32_t key) { return (key >> 14) & 0x3FFF; }
+
+struct SparseTileLayout {
+	TextureFormat format{TextureFormatInvalid};
+	uint32_t width{0};
+	uint32_t height{0};
+	uint32_t levels{0};
+	// texel 단위
+	uint32_t tileWidth{0};
+	uint32_t tileHeight{0};
+	// tile 하나의 byte 수. 가장자리 tile도 같은 크기로 저장한다.
+	uint32_t tileBytes{0};
+	uint32_t tileRowBytes{0};
+	// 이 level부터는 mip tail이다. levels와 같으면 tail이 없다.
+	uint32_t tailLevel{0};
+	uint64_t tailBytes{0};
+	uint32_t tileCount{0};
+	// tail 앞의 level마다
+	std::vector<uint32_t> tilesWide;
+	std::vector<uint32_t> tilesHigh;
+	std::vector<uint32_t> firstTile;
+
+	uint32_t levelWidth(uint32_t level) const { return std::max(1u, width >> level); }
+	uint32_t levelHeight(uint32_t level) const { return std::max(1u, height >> level); }
+	// tail에 있거나 grid 밖이면 tileCount
+	uint32_t tileIndex(uint32_t key) const;
+	uint32_t tileKey(uint32_t index) const;
+};
+
+/*
+ * tileWidth x tileHeight texel tile로 나눈 layout. tile 크기는 format의 block 크기의 배수여야 한다.
+ * 2D texture 한 장만 다룬다. 맞지 않으면 format이 TextureFormatInvalid인 layout을 반환한다.
+ * */
+SparseTileLayout makeSparseTileLayout(TextureFormat format, uint32_t width, uint32_t height, uint32_t levels, uint32_t tileWidth,
+		uint32_t tileHeight);
+// page 하나(pageBytes)에 들어가는 가장 정사각형에 가까운 tile. Metal의 sparseTileSize와 같다. (RGBA8 64x64, BC7 128x128)
+void defaultSparseTileSize(TextureFormat format, uint32_t& tileWidth, uint32_t& tileHeight, uint32_t pageBytes = 16384);
+
+// mip이 모두 있는 2D texture를 .vtex로 저장한다. 실패하면 이유를 출력하고 false를 반환한다.
+bool writeSparseTexture(const char* path, const TextureData& texture, uint32_t tileWidth, uint32_t tileHeight);
+
+class SparseTextureFile {
+	public:
+		bool open(const char* path);
+		const SparseTileLayout& layout() const { return _layout; }
+		// tile 하나(layout.tileBytes)를 읽는다. 여러 thread에서 불러도 된다.
+		bool readTile(uint32_t key, uint8_t* out) const;
+		// mip tail 전체. tailLevel부터 makeTextureLayout의 subresource 순서로 이어져 있다.
+		bool readTail(std::vector<uint8_t>& out) const;
+
+	private:
+		std::string _path;
+		SparseTileLayout _layout;
+		mutable std::mutex _mutex;
+		mutable std::ifstream _file;
+};
+
+/*
+ * tile index마다 1 bit. words를 주면 그 memory(예: shared MTL::Buffer의 contents)에 쓰고 읽는다.
+ * 그 memory는 wordCount(layout)개이고 처음에 0이어야 한다. layout은 가리키기만 하므로 이 객체보다 오래 있어야 한다.
+ * */
+class SparseFeedback {
+	public:
+		explicit SparseFeedback(const SparseTileLayout& layout, uint32_t* words = nullptr);
+		static size_t wordCount(const SparseTileLayout& layout) { return (size_t(layout.tileCount) + 31) / 32; }
+
+		// 여러 thread에서 불러도 된다. tail level이면 아무것도 하지 않는다.
+		void recordTile(uint32_t level, uint32_t x, uint32_t y);
+		// uv는 texture 좌표(반복), lod는 sample하는 mip level이다. trilinear면 더 작은 level은 부모로 따라 올라온다.
+		void record(float u, float v, float lod);
+		// 표시된 tile key를 keys 뒤에 붙이고 지운다.
+		void collect(std::vector<uint32_t>& keys);
+		uint32_t* words() { return _words; }
+
+	private:
+		const SparseTileLayout* _layout;
+		std::vector<uint32_t> _storage;
+		uint32_t* _words;
+};
+
+struct SparseResidencyStats {
+	// feedback으로 받은 tile 수(frame마다 중복 없이)와 그중 이미 올라와 있던 수
+	uint64_t requests{0};
+	uint64_t hits{0};
+	// 읽기 시작한 tile, 자리를 비우려고 내린 tile
+	uint64_t loads{0};
+	uint64_t evictions{0};
+	// 예산이나 frame당 읽기 한도 때문에 다음 frame으로 미룬 tile
+	uint64_t deferred{0};
+	// 올라왔거나 읽고 있는 tile과 그 byte 수(mip tail 포함)
+	uint32_t residentTiles{0};
+	uint64_t residentBytes{0};
+	uint64_t peakBytes{0};
+
+	double hitRate() const { return requests ? double(hits) / double(requests) : 1.0; }
+};
+
+class SparseResidency {
+	public:
+		// budgetBytes는 mip tail을 포함한 예산이다. 나머지를 tile 크기로 나눈 만큼 tile을 둔다. layout은 이 객체보다 오래 있어야 한다.
+		SparseResidency(const SparseTileLayout& layout, uint64_t budgetBytes);
+
+		/*
+		 * frame마다 feedback으로 받은 tile key로 부른다.
+		 * loads에는 새로 읽을 tile을 작은 level부터 maxLoads개까지 넣는다. 자리는 지금 잡으므로 부르는 쪽은 tile을 map 하고 읽은 뒤
+		 * markResident로 알린다. evictions에는 자리를 비우려고 내린 tile을 넣는다. GPU에서는 unmap 한다.
+		 * */
+		void update(const std::vector<uint32_t>& requested, uint32_t maxLoads, std::vector<uint32_t>& loads, std::vector<uint32_t>& evictions);
+		void markResident(uint32_t key);
+		// 읽지 못한 tile의 자리를 돌려준다.
+		void cancelLoad(uint32_t key);
+		bool isResident(uint32_t key) const;
+
+		// level 0 tile grid(tilesWide[0] x tilesHigh[0], 행 순서)마다 쓸 수 있는 가장 정밀한 level. tile이 없으면 tailLevel
+		const std::vector<uint8_t>& residencyMap() const { return _residencyMap; }
+		// 마지막으로 부른 뒤 residencyMap이 바뀌었는지
+		bool takeResidencyMapChanged();
+		const SparseResidencyStats& stats() const { return _stats; }
+		// 누적 count만 지운다. 올라와 있는 tile과 peak는 그대로 둔다.
+		void resetCounters();
+		uint32_t capacityTiles() const { return _capacity; }
+
+	private:
+		enum TileState : uint8_t { TileStateEmpty, TileStateLoading, TileStateResident };
+		// LRU는 index로 잇는 list이고 _tiles[tileCount]가 머리이다. next 쪽이 최근에 쓴 것이다.
+		struct Tile {
+			uint32_t previous;
+			uint32_t next;
+			uint64_t lastUsed;
+			TileState state;
+		};
+
+		void unlink(uint32_t index);
+		void pushMostRecent(uint32_t index);
+		bool evictOne(std::vector<uint32_t>& evictions);
+		void refreshResidencyMap(uint32_t key);
+		void updateBytes();
+
+		const SparseTileLayout* _layout;
+		uint32_t _capacity{0};
+		uint64_t _frame{0};
+		std::vector<Tile> _tiles;
+		uint32_t _loading{0};
+		uint32_t _resident{0};
+		std::vector<uint8_t> _residencyMap;
+		bool _residencyMapChanged{true};
+		SparseResidencyStats _stats;
+		std::vector<uint32_t> _missing;
+};
+
+struct SparseTileData {
+	uint32_t key{0};
+	// 읽지 못했으면 비어 있다.
+	std::vector<uint8_t> bytes;
+};
+
+/*
+ * 요청한 tile을 요청 순서대로 pool에서 읽는다. 작업 하나가 tile 몇 개를 읽고 남은 것은 새 작업으로 넘긴다.
+ * poll은 읽힌 tile을 하나씩 꺼낸다.
+ * */
+class SparseTileStreamer {
+	public:
+		explicit SparseTileStreamer(const SparseTextureFile& file) : _file(file) {}
+		~SparseTileStreamer();
+		SparseTileStreamer(const SparseTileStreamer&) = delete;
+		SparseTileStreamer& operator=(const SparseTileStreamer&) = delete;
+
+		void request(const std::vector<uint32_t>& keys, ThreadPool& pool = ThreadPool::shared());
+		bool poll(SparseTileData& tile);
+		// 요청했지만 아직 꺼내지 않은 tile 수
+		size_t pending() const;
+
+	private:
+		void streamTiles(ThreadPool* pPool);
+
+		const SparseTextureFile& _file;
+		mutable std::mutex _mutex;
+		std::condition_variable _idle;
+		std::deque<uint32_t> _queue;
+		std::deque<SparseTileData> _ready;
+		size_t _reading{0};
+		bool _taskInFlight{false};
+		std::atomic<bool> _cancel{false};
+};
+
+namespace SparseDetail {
+
+constexpr uint32_t kMagic = TextureDetail::fourCC('L', 'M', 'V', 'T');
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 64;
+// 한 작업이 읽는 tile 수. 1 thread pool에서는 submit이 바로 실행되므로 재귀 깊이를 이만큼 줄인다.
+constexpr size_t kTilesPerTask = 16;
+
+inline uint64_t tileOffset(const SparseTileLayout& layout, uint32_t index) { return kHeaderSize + uint64_t(index) * layout.tileBytes; }
+inline uint64_t tailOffset(const SparseTileLayout& layout) { return tileOffset(layout, layout.tileCount); }
+
+} // namespace SparseDetail
+
+#pragma region SparseTileLayout {
+
+inline uint32_t SparseTileLayout::tileIndex(uint32_t key) const
+{
+	const uint32_t level = sparseTileLevel(key), x = sparseTileX(key), y = sparseTileY(key);
+	if (level >= tailLevel || x >= tilesWide[level] || y >= tilesHigh[level]) {
+		return tileCount;
+	}
+	return firstTile[level] + y * tilesWide[level] + x;
+}
+
+inline uint32_t SparseTileLayout::tileKey(uint32_t index) const
+{
+	const uint32_t level = uint32_t(std::upper_bound(firstTile.begin(), firstTile.end(), index) - firstTile.begin()) - 1;
+	const uint32_t local = index - firstTile[level];
+	return sparseTileKey(level, local % tilesWide[level], local / tilesWide[level]);
+}
+
+inline SparseTileLayout makeSparseTileLayout(TextureFormat format, uint32_t width, uint32_t height, uint32_t levels, uint32_t tileWidth,
+		uint32_t tileHeight)
+{
+	const TextureFormatInfo info = textureFormatInfo(format);
+	SparseTileLayout layout;
+	if (info.bytesPerBlock == 0 || tileWidth == 0 || tileHeight == 0 || tileWidth % info.blockWidth || tileHeight % info.blockHeight
+			|| levels == 0 || width > (tileWidth << 14) || height > (tileHeight << 14)) {
+		return layout;
+	}
+	layout.format = format;
+	layout.width = width;
+	layout.height = height;
+	layout.levels = levels;
+	layout.tileWidth = tileWidth;
+	layout.tileHeight = tileHeight;
+	layout.tileRowBytes = tileWidth / info.blockWidth * info.bytesPerBlock;
+	layout.tileBytes = layout.tileRowBytes * (tileHeight / info.blockHeight);
+	layout.tailLevel = 0;
+	while (layout.tailLevel < levels && layout.levelWidth(layout.tailLevel) >= tileWidth && layout.levelHeight(layout.tailLevel) >= tileHeight) {
+		layout.tilesWide.push_back((layout.levelWidth(layout.tailLevel) + tileWidth - 1) / tileWidth);
+		layout.tilesHigh.push_back((layout.levelHeight(layout.tailLevel) + tileHeight - 1) / tileHeight);
+		layout.firstTile.push_back(layout.tileCount);
+		layout.tileCount += layout.tilesWide.back() * layout.tilesHigh.back();
+		++layout.tailLevel;
+	}
+	// key에 level은 4 bit이다. 65536x65536 RGBA8도 tail 앞은 11 level이다.
+	if (layout.tailLevel > 16) {
+		return SparseTileLayout();
+	}
+	// makeTextureLayout은 Metal의 16384 제한에 걸리므로 tail 크기는 직접 더한다. subresource는 빈틈없이 이어져 있다.
+	for (uint32_t level = layout.tailLevel; level < levels; ++level) {
+		const uint64_t blocksWide = (layout.levelWidth(level) + info.blockWidth - 1) / info.blockWidth;
+		const uint64_t blocksHigh = (layout.levelHeight(level) + info.blockHeight - 1) / info.blockHeight;
+		layout.tailBytes += blocksWide * blocksHigh * info.bytesPerBlock;
+	}
+	return layout;
+}
+
+inline void defaultSparseTileSize(TextureFormat format, uint32_t& tileWidth, uint32_t& tileHeight, uint32_t pageBytes)
+{
+	const TextureFormatInfo info = textureFormatInfo(format);
+	uint32_t blocks = info.bytesPerBlock ? pageBytes / info.bytesPerBlock : 0;
+	uint32_t wide = 1, high = 1;
+	// 넓이를 먼저 두 배로 늘린다. 2048 block이면 64 x 32이다.
+	while (wide * high * 2 <= blocks) {
+		if (wide <= high) {
+			wide *= 2;
+		} else {
+			high *= 2;
+		}
+	}
+	tileWidth = wide * info.blockWidth;
+	tileHeight = high * info.blockHeight;
+}
+
+#pragma endregion SparseTileLayout }
+
+#pragma region SparseTextureFile {
+
+inline bool writeSparseTexture(const char* path, const TextureData& texture, uint32_t tileWidth, uint32_t tileHeight)
+{
+	using namespace SparseDetail;
+	const TextureLayout& source = texture.layout;
+	if (source.type != TextureType2D || source.slices() != 1) {
+		return TextureDetail::fail("virtual texture must be a single 2D texture");
+	}
+	const SparseTileLayout layout = makeSparseTileLayout(source.format, source.width, source.height, source.levels, tileWidth, tileHeight);
+	if (layout.format == TextureFormatInvalid) {
+		return TextureDetail::fail("tile size " + std::to_string(tileWidth) + "x" + std::to_string(tileHeight) + " does not fit the format");
+	}
+	const TextureFormatInfo info = textureFormatInfo(source.format);
+	std::vector<uint8_t> file(size_t(tailOffset(layout) + layout.tailBytes), 0);
+	const uint32_t header[] = { kMagic, kVersion, uint32_t(layout.format), layout.width, layout.height, layout.levels, layout.tileWidth,
+		layout.tileHeight };
+	std::memcpy(file.data(), header, sizeof(header));
+	// tile은 block 행 단위로 복사한다. 가장자리 tile의 texture 밖 부분은 0으로 남긴다.
+	const uint32_t blockRows = tileHeight / info.blockHeight;
+	for (uint32_t index = 0; index < layout.tileCount; ++index) {
+		const uint32_t key = layout.tileKey(index);
+		const TextureSubresource& subresource = source.subresource(sparseTileLevel(key), 0);
+		const uint8_t* pixels = texture.bytes.data() + subresource.offset;
+		const uint32_t rowOffset = sparseTileX(key) * layout.tileRowBytes;
+		const uint32_t rowBytes = std::min(layout.tileRowBytes, subresource.bytesPerRow - rowOffset);
+		const uint32_t firstRow = sparseTileY(key) * blockRows;
+		const uint32_t levelRows = uint32_t(subresource.bytesPerImage / subresource.bytesPerRow);
+		uint8_t* out = file.data() + tileOffset(layout, index);
+		for (uint32_t row = 0; row < blockRows && firstRow + row < levelRows; ++row) {
+			std::memcpy(out + size_t(row) * layout.tileRowBytes, pixels + size_t(firstRow + row) * subresource.bytesPerRow + rowOffset, rowBytes);
+		}
+	}
+	if (layout.tailLevel < layout.levels) {
+		std::memcpy(file.data() + tailOffset(layout), texture.bytes.data() + source.subresource(layout.tailLevel, 0).offset, size_t(layout.tailBytes));
+	}
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(file.data()), std::streamsize(file.size()));
+	return bool(out) || TextureDetail::fail(std::string("failed to write: ") + path);
+}
+
+inline bool SparseTextureFile::open(const char* path)
+{
+	using namespace SparseDetail;
+	std::lock_guard<std::mutex> lock(_mutex);
+	_file = std::ifstream(path, std::ios::binary | std::ios::ate);
+	if (!_file) {
+		return TextureDetail::fail(std::string("file not found: ") + path);
+	}
+	const uint64_t fileSize = uint64_t(_file.tellg());
+	uint32_t header[8] = {};
+	if (fileSize < kHeaderSize || !TextureDetail::readRange(_file, 0, sizeof(header), reinterpret_cast<uint8_t*>(header))) {
+		return TextureDetail::fail(std::string("failed to read: ") + path);
+	}
+	if (header[0] != kMagic || header[1] != kVersion) {
+		return TextureDetail::fail(std::string("not a virtual texture: ") + path);
+	}
+	_layout = makeSparseTileLayout(TextureFormat(header[2]), header[3], header[4], header[5], header[6], header[7]);
+	if (_layout.format == TextureFormatInvalid || fileSize < tailOffset(_layout) + _layout.tailBytes) {
+		return TextureDetail::fail(std::string("virtual texture is truncated or invalid: ") + path);
+	}
+	_path = path;
+	return true;
+}
+
+inline bool SparseTextureFile::readTile(uint32_t key, uint8_t* out) const
+{
+	const uint32_t index = _layout.tileIndex(key);
+	if (index == _layout.tileCount) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+	_file.clear();
+	return TextureDetail::readRange(_file, SparseDetail::tileOffset(_layout, index), _layout.tileBytes, out);
+}
+
+inline bool SparseTextureFile::readTail(std::vector<uint8_t>& out) const
+{
+	out.resize(size_t(_layout.tailBytes));
+	std::lock_guard<std::mutex> lock(_mutex);
+	_file.clear();
+	return TextureDetail::readRange(_file, SparseDetail::tailOffset(_layout), _layout.tailBytes, out.data());
+}
+
+#pragma endregion SparseTextureFile }
+
+#pragma region SparseFeedback {
+
+inline SparseFeedback::SparseFeedback(const SparseTileLayout& layout, uint32_t* words) : _layout(&layout), _words(words)
+{
+	if (!_words) {
+		_storage.assign(wordCount(layout), 0);
+		_words = _storage.data();
+	}
+}
+
+inline void SparseFeedback::recordTile(uint32_t level, uint32_t x, uint32_t y)
+{
+	const uint32_t index = _layout->tileIndex(sparseTileKey(level, x, y));
+	if (index == _layout->tileCount) {
+		return;
+	}
+	const uint32_t bit = 1u << (index & 31);
+	// 이미 표시된 tile은 atomic 없이 넘어간다. 화면의 대부분은 이 경우이다.
+	if ((__atomic_load_n(&_words[index >> 5], __ATOMIC_RELAXED) & bit) == 0) {
+		__atomic_fetch_or(&_words[index >> 5], bit, __ATOMIC_RELAXED);
+	}
+}
+
+inline void SparseFeedback::record(float u, float v, float lod)
+{
+	const uint32_t level = uint32_t(std::clamp(lod, 0.0f, float(_layout->levels - 1)));
+	if (level >= _layout->tailLevel) {
+		return;
+	}
+	u -= std::floor(u);
+	v -= std::floor(v);
+	const uint32_t x = std::min(uint32_t(u * float(_layout->levelWidth(level))), _layout->levelWidth(level) - 1) / _layout->tileWidth;
+	const uint32_t y = std::min(uint32_t(v * float(_layout->levelHeight(level))), _layout->levelHeight(level) - 1) / _layout->tileHeight;
+	recordTile(level, x, y);
+}
+
+inline void SparseFeedback::collect(std::vector<uint32_t>& keys)
+{
+	const size_t count = wordCount(*_layout);
+	for (size_t word = 0; word < count; ++word) {
+		uint32_t bits = __atomic_exchange_n(&_words[word], 0u, __ATOMIC_RELAXED);
+		while (bits) {
+			const uint32_t index = uint32_t(word * 32) + uint32_t(__builtin_ctz(bits));
+			keys.push_back(_layout->tileKey(index));
+			bits &= bits - 1;
+		}
+	}
+}
+
+#pragma endregion SparseFeedback }
+
+#pragma region SparseResidency {
+
+inline SparseResidency::SparseResidency(const SparseTileLayout& layout, uint64_t budgetBytes)
+	: _layout(&layout), _tiles(size_t(layout.tileCount) + 1)
+{
+	_capacity = budgetBytes > layout.tailBytes && layout.tileBytes ? uint32_t(std::min<uint64_t>((budgetBytes - layout.tailBytes) / layout.tileBytes,
+				layout.tileCount)) : 0;
+	for (Tile& tile : _tiles) {
+		tile = { layout.tileCount, layout.tileCount, 0, TileStateEmpty };
+	}
+	if (layout.tailLevel > 0) {
+		_residencyMap.assign(size_t(layout.tilesWide[0]) * layout.tilesHigh[0], uint8_t(layout.tailLevel));
+	}
+	updateBytes();
+}
+
+inline void SparseResidency::unlink(uint32_t index)
+{
+	Tile& tile = _tiles[index];
+	_tiles[tile.previous].next = tile.next;
+	_tiles[tile.next].previous = tile.previous;
+}
+
+inline void SparseResidency::pushMostRecent(uint32_t index)
+{
+	const uint32_t head = _layout->tileCount;
+	Tile& tile = _tiles[index];
+	tile.previous = _tiles[head].previous;
+	tile.next = head;
+	_tiles[tile.previous].next = index;
+	_tiles[head].previous = index;
+}
+
+inline void SparseResidency::updateBytes()
+{
+	_stats.residentTiles = _resident + _loading;
+	_stats.residentBytes = uint64_t(_stats.residentTiles) * _layout->tileBytes + _layout->tailBytes;
+	_stats.peakBytes = std::max(_stats.peakBytes, _stats.residentBytes);
+}
+
+inline bool SparseResidency::evictOne(std::vector<uint32_t>& evictions)
+{
+	// head의 next가 가장 오래 쓰지 않은 tile이다. 이번 frame에 쓴 tile은 list 뒤쪽에만 있으므로 첫 tile만 보면 된다.
+	const uint32_t head = _layout->tileCount;
+	const uint32_t oldest = _tiles[head].next;
+	if (oldest == head || _tiles[oldest].lastUsed == _frame) {
+		return false;
+	}
+	unlink(oldest);
+	_tiles[oldest].state = TileStateEmpty;
+	--_resident;
+	++_stats.evictions;
+	const uint32_t key = _layout->tileKey(oldest);
+	evictions.push_back(key);
+	refreshResidencyMap(key);
+	return true;
+}
+
+inline void SparseResidency::update(const std::vector<uint32_t>& requested, uint32_t maxLoads, std::vector<uint32_t>& loads,
+		std::vector<uint32_t>& evictions)
+{
+	const SparseTileLayout& layout = *_layout;
+	++_frame;
+	_missing.clear();
+	for (uint32_t key : requested) {
+		uint32_t index = layout.tileIndex(key);
+		if (index == layout.tileCount) {
+			continue;
+		}
+		++_stats.requests;
+		_stats.hits += _tiles[index].state == TileStateResident ? 1 : 0;
+		// 부모 쪽으로 올라가며 쓴 것으로 표시한다. 부모가 자식보다 나중에 표시되므로 LRU가 자식을 먼저 내린다.
+		uint32_t x = sparseTileX(key), y = sparseTileY(key);
+		for (uint32_t level = sparseTileLevel(key); level < layout.tailLevel; ++level, x >>= 1, y >>= 1) {
+			index = layout.tileIndex(sparseTileKey(level, std::min(x, layout.tilesWide[level] - 1), std::min(y, layout.tilesHigh[level] - 1)));
+			Tile& tile = _tiles[index];
+			if (tile.lastUsed == _frame) {
+				break;
+			}
+			tile.lastUsed = _frame;
+			if (tile.state == TileStateResident) {
+				unlink(index);
+				pushMostRecent(index);
+			} else if (tile.state == TileStateEmpty) {
+				_missing.push_back(index);
+			}
+		}
+	}
+	// 작은 level(큰 index)부터 읽는다. 부모가 있어야 자식이 residency map에 드러난다.
+	std::sort(_missing.begin(), _missing.end(), [](uint32_t a, uint32_t b) { return a > b; });
+	for (uint32_t index : _missing) {
+		if (loads.size() >= maxLoads || (_resident + _loading >= _capacity && !evictOne(evictions))) {
+			++_stats.deferred;
+			continue;
+		}
+		_tiles[index].state = TileStateLoading;
+		++_loading;
+		++_stats.loads;
+		loads.push_back(layout.tileKey(index));
+	}
+	updateBytes();
+}
+
+inline void SparseResidency::markResident(uint32_t key)
+{
+	const uint32_t index = _layout->tileIndex(key);
+	if (index == _layout->tileCount || _tiles[index].state != TileStateLoading) {
+		return;
+	}
+	_tiles[index].state = TileStateResident;
+	--_loading;
+	++_resident;
+	pushMostRecent(index);
+	refreshResidencyMap(key);
+	updateBytes();
+}
+
+inline void SparseResidency::cancelLoad(uint32_t key)
+{
+	const uint32_t index = _layout->tileIndex(key);
+	if (index == _layout->tileCount || _tiles[index].state != TileStateLoading) {
+		return;
+	}
+	_tiles[index].state = TileStateEmpty;
+	--_loading;
+	updateBytes();
+}
+
+inline bool SparseResidency::isResident(uint32_t key) const
+{
+	const uint32_t index = _layout->tileIndex(key);
+	return index != _layout->tileCount && _tiles[index].state == TileStateResident;
+}
+
+// key가 덮는 level 0 tile마다 tail부터 내려오며 부모가 모두 있는 가장 정밀한 level을 다시 구한다.
+inline void SparseResidency::refreshResidencyMap(uint32_t key)
+{
+	const SparseTileLayout& layout = *_layout;
+	const uint32_t level = sparseTileLevel(key);
+	const uint32_t wide = layout.tilesWide[0], high = layout.tilesHigh[0];
+	const uint32_t x0 = sparseTileX(key) << level, y0 = sparseTileY(key) << level;
+	const uint32_t x1 = std::min(wide, (sparseTileX(key) + 1) << level), y1 = std::min(high, (sparseTileY(key) + 1) << level);
+	for (uint32_t y = y0; y < y1; ++y) {
+		for (uint32_t x = x0; x < x1; ++x) {
+			uint32_t finest = layout.tailLevel;
+			while (finest > 0) {
+				const uint32_t l = finest - 1;
+				const uint32_t index = layout.tileIndex(sparseTileKey(l, std::min(x >> l, layout.tilesWide[l] - 1), std::min(y >> l, layout.tilesHigh[l] - 1)));
+				if (_tiles[index].state != TileStateResident) {
+					break;
+				}
+				finest = l;
+			}
+			_residencyMap[size_t(y) * wide + x] = uint8_t(finest);
+		}
+	}
+	_residencyMapChanged = true;
+}
+
+inline bool SparseResidency::takeResidencyMapChanged()
+{
+	const bool changed = _residencyMapChanged;
+	_residencyMapChanged = false;
+	return changed;
+}
+
+inline void SparseResidency::resetCounters()
+{
+	_stats.requests = 0;
+	_stats.hits = 0;
+	_stats.loads = 0;
+	_stats.evictions = 0;
+	_stats.deferred = 0;
+}
+
+#pragma endregion SparseResidency }
+
+#pragma region SparseTileStreamer {
+
+inline SparseTileStreamer::~SparseTileStreamer()
+{
+	_cancel = true;
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this] { return !_taskInFlight; });
+}
+
+inline void SparseTileStreamer::request(const std::vector<uint32_t>& keys, ThreadPool& pool)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queue.insert(_queue.end(), keys.begin(), keys.end());
+		if (_taskInFlight || _queue.empty()) {
+			return;
+		}
+		_taskInFlight = true;
+	}
+	ThreadPool* pPool = &pool;
+	pool.submit([this, pPool] { streamTiles(pPool); });
+}
+
+inline void SparseTileStreamer::streamTiles(ThreadPool* pPool)
+{
+	for (size_t i = 0; i < SparseDetail::kTilesPerTask; ++i) {
+		SparseTileData data;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_queue.empty() || _cancel) {
+				break;
+			}
+			data.key = _queue.front();
+			_queue.pop_front();
+			++_reading;
+		}
+		data.bytes.resize(_file.layout().tileBytes);
+		if (!_file.readTile(data.key, data.bytes.data())) {
+			data.bytes.clear();
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_ready.push_back(std::move(data));
+		--_reading;
+	}
+	bool next = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		next = !_queue.empty() && !_cancel;
+		if (!next) {
+			_taskInFlight = false;
+			_idle.notify_all();
+		}
+	}
+	if (next) {
+		pPool->submit([this, pPool] { streamTiles(pPool); });
+	}
+}
+
+inline bool SparseTileStreamer::poll(SparseTileData& tile)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_ready.empty()) {
+		return false;
+	}
+	tile = std::move(_ready.front());
+	_ready.pop_front();
+	return true;
+}
+
+inline size_t SparseTileStreamer::pending() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _queue.size() + _reading + _ready.size();
+}
+
+#pragma endregion SparseTileStreamer }
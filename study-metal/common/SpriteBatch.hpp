@@ -0,0 +1,426 @@
+/*
+ * SpriteBatch.hpp
+ *
+ * UI / sprite를 atlas 한 장(page)당 draw 하나로 그린다.
+ *  - AtlasPacker: skyline bottom-left packer. page마다 위쪽 윤곽선(skyline)만 들고 있다가 새 사각형을 윤곽선 위에
+ *    놓았을 때 윗변이 가장 낮은 자리에 둔다. page가 차면 다음 page를 연다.
+ *  - buildSpriteAtlas: RGBA8 image들을 큰 것부터 pack 해서 page image를 만든다. image 둘레 padding에는 가장자리 texel을 늘려 채워
+ *    linear filter가 옆 image를 섞지 않는다.
+ *  - SpriteBatch: frame마다 add 한 sprite를 (layer, page)로 안정 정렬(radix sort)하고 quad마다 vertex 4개를 하나의 interleaved
+ *    stream으로 쓴다. page가 바뀌는 곳에서만 draw를 나누므로 layer가 달라도 같은 page면 draw 하나이다.
+ *    index는 quad 순서대로 고정이므로 한 번 만든 index buffer를 계속 쓴다.
+ * Metal 호출은 01-primitive의 SpritePass에 있다. (bench/sprite-batch)
+ * */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MathTypes.hpp"
+#include "ParallelPrimitives.hpp"
+#include "ThreadPool.hpp"
+
+// atlas 안의 texel 사각형. padding은 밖에 있다.
+struct AtlasRect {
+	uint32_t page{0};
+	uint32_t x{0};
+	uint32_t y{0};
+	uint32_t width{0};
+	uint32_t height{0};
+};
+
+class AtlasPacker {
+	public:
+		// 사각형마다 둘레에 padding texel을 더 잡는다. (이웃과는 2 * padding 떨어진다) page는 maxPages개까지 연다.
+		AtlasPacker(uint32_t pageWidth, uint32_t pageHeight, uint32_t padding = 1, uint32_t maxPages = 16);
+
+		// 열린 page를 앞에서부터 보고 들어가는 첫 page에 넣는다. 어디에도 들어가지 않으면 false
+		bool insert(uint32_t width, uint32_t height, AtlasRect& rect);
+		// rects의 width / height를 높이가 큰 것부터 넣고 page / x / y를 채운다. 넣지 못한 것은 width와 height가 0이 된다.
+		// 넣은 수를 돌려준다.
+		size_t insertAll(std::vector<AtlasRect>& rects);
+		void reset();
+
+		uint32_t pageWidth() const { return _pageWidth; }
+		uint32_t pageHeight() const { return _pageHeight; }
+		uint32_t pageCount() const { return uint32_t(_skylines.size()); }
+		// 넣은 사각형(padding 제외) 넓이 / 연 page 넓이
+		double occupancy() const;
+
+	private:
+		// x부터 width만큼의 윤곽선 높이가 y이다. x 순서로 page 너비를 빈틈없이 덮는다.
+		struct SkylineNode {
+			uint32_t x;
+			uint32_t y;
+			uint32_t width;
+		};
+
+		// node index부터 width를 덮는 윤곽선의 가장 높은 곳. 넘치면 false
+		bool fit(const std::vector<SkylineNode>& skyline, size_t index, uint32_t width, uint32_t height, uint32_t& y) const;
+		bool insertInto(uint32_t page, uint32_t width, uint32_t height, AtlasRect& rect);
+		void openPage();
+
+		uint32_t _pageWidth;
+		uint32_t _pageHeight;
+		uint32_t _padding;
+		uint32_t _maxPages;
+		std::vector<std::vector<SkylineNode>> _skylines;
+		uint64_t _usedArea{0};
+};
+
+// RGBA8, 행 사이에 빈틈이 없다.
+struct SpriteImage {
+	uint32_t width{0};
+	uint32_t height{0};
+	std::vector<uint8_t> pixels;
+};
+
+struct SpriteAtlas {
+	uint32_t pageWidth{0};
+	uint32_t pageHeight{0};
+	// image 번호마다
+	std::vector<AtlasRect> rects;
+	// RGBA8 page image
+	std::vector<std::vector<uint8_t>> pages;
+	double occupancy{0.0};
+};
+
+// 실패하면(page가 모자라거나 page보다 큰 image) 이유를 출력하고 false를 반환한다.
+bool buildSpriteAtlas(const std::vector<SpriteImage>& images, uint32_t pageWidth, uint32_t pageHeight, uint32_t padding, uint32_t maxPages,
+		SpriteAtlas& atlas);
+
+// GPU로 보내는 vertex. build/shader.metal의 SpriteVertex와 같은 20 byte 배치
+struct SpriteVertex {
+	Float2 position;
+	Float2 texcoord;
+	// RGBA8. r이 가장 낮은 byte (unpack_unorm4x8_to_float)
+	uint32_t color;
+};
+
+static_assert(sizeof(SpriteVertex) == 20, "SpriteVertex must match the MSL layout");
+
+struct Sprite {
+	// 화면 pixel 좌표. 왼쪽 위가 (0, 0)이고 y는 아래로 커진다. position은 회전하기 전 사각형의 왼쪽 위이다.
+	Float2 position{0.0f, 0.0f};
+	Float2 size{0.0f, 0.0f};
+	// 가운데를 축으로 시계 방향 radian
+	float rotation{0.0f};
+	uint32_t color{0xFFFFFFFFu};
+	// SpriteAtlas::rects의 번호
+	uint32_t image{0};
+	// 작은 layer부터 그린다. 같은 layer 안에서는 add 한 순서를 page 순서 다음으로 지킨다. (-32768 ~ 32767)
+	int32_t layer{0};
+};
+
+// 같은 atlas page를 읽는 연속된 quad들. drawIndexedPrimitives 하나이다.
+struct SpriteDraw {
+	uint32_t page;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+class SpriteBatch {
+	public:
+		// atlas는 가리키기만 하므로 이 객체보다 오래 있어야 한다.
+		explicit SpriteBatch(const SpriteAtlas& atlas) : _atlas(&atlas) {}
+
+		void clear() { _sprites.clear(); }
+		void add(const Sprite& sprite) { _sprites.push_back(sprite); }
+		size_t size() const { return _sprites.size(); }
+
+		// (layer, page)로 정렬하고 draws()를 만든다.
+		void build(ThreadPool& pool = ThreadPool::shared());
+		// build 순서로 vertices[0, 4 * size())를 채운다. thread마다 나눠 쓰므로 GPU buffer에 바로 써도 된다.
+		void writeVertices(SpriteVertex* vertices, ThreadPool& pool = ThreadPool::shared()) const;
+		const std::vector<SpriteDraw>& draws() const { return _draws; }
+
+		// quad i는 vertex 4i(왼쪽 위), 4i+1(오른쪽 위), 4i+2(왼쪽 아래), 4i+3(오른쪽 아래)이다.
+		static void writeQuadIndices(uint32_t* indices, size_t quadCount);
+
+	private:
+		const SpriteAtlas* _atlas;
+		std::vector<Sprite> _sprites;
+		std::vector<uint32_t> _keys;
+		std::vector<uint32_t> _order;
+		std::vector<SpriteDraw> _draws;
+};
+
+namespace SpriteDetail {
+
+inline bool fail(const std::string& message)
+{
+	std::cerr << "sprite: " << message << std::endl;
+	return false;
+}
+
+// image를 page의 (x, y)에 쓰고 둘레 padding texel에 가장자리를 늘려 쓴다.
+inline void blitExtruded(const SpriteImage& image, uint8_t* page, uint32_t pageWidth, uint32_t pageHeight, uint32_t x, uint32_t y,
+		uint32_t padding)
+{
+	const int32_t left = int32_t(x) - int32_t(padding), top = int32_t(y) - int32_t(padding);
+	const int32_t right = int32_t(std::min(pageWidth, x + image.width + padding));
+	const int32_t bottom = int32_t(std::min(pageHeight, y + image.height + padding));
+	for (int32_t row = std::max(top, 0); row < bottom; ++row) {
+		const int32_t sourceRow = std::clamp(row - int32_t(y), 0, int32_t(image.height) - 1);
+		const uint8_t* source = image.pixels.data() + size_t(sourceRow) * image.width * 4;
+		uint8_t* destination = page + size_t(row) * pageWidth * 4;
+		for (int32_t column = std::max(left, 0); column < right; ++column) {
+			const int32_t sourceColumn = std::clamp(column - int32_t(x), 0, int32_t(image.width) - 1);
+			std::memcpy(destination + size_t(column) * 4, source + size_t(sourceColumn) * 4, 4);
+		}
+	}
+}
+
+} // namespace SpriteDetail
+
+#pragma region AtlasPacker {
+
+inline AtlasPacker::AtlasPacker(uint32_t pageWidth, uint32_t pageHeight, uint32_t padding, uint32_t maxPages)
+	: _pageWidth(pageWidth), _pageHeight(pageHeight), _padding(padding), _maxPages(maxPages)
+{
+}
+
+inline void AtlasPacker::reset()
+{
+	_skylines.clear();
+	_usedArea = 0;
+}
+
+inline double AtlasPacker::occupancy() const
+{
+	return _skylines.empty() ? 0.0 : double(_usedArea) / (double(_pageWidth) * _pageHeight * _skylines.size());
+}
+
+inline void AtlasPacker::openPage()
+{
+	_skylines.push_back({ SkylineNode{ 0, 0, _pageWidth } });
+}
+
+inline bool AtlasPacker::fit(const std::vector<SkylineNode>& skyline, size_t index, uint32_t width, uint32_t height, uint32_t& y) const
+{
+	const uint32_t x = skyline[index].x;
+	if (x + width > _pageWidth) {
+		return false;
+	}
+	y = 0;
+	for (; index < skyline.size() && skyline[index].x < x + width; ++index) {
+		y = std::max(y, skyline[index].y);
+		if (y + height > _pageHeight) {
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool AtlasPacker::insertInto(uint32_t page, uint32_t width, uint32_t height, AtlasRect& rect)
+{
+	std::vector<SkylineNode>& skyline = _skylines[page];
+	// 둘레의 padding까지 한 덩어리로 잡는다. 그래야 이웃 image의 가장자리 texel을 늘려 쓴 곳과 겹치지 않는다.
+	const uint32_t paddedWidth = width + 2 * _padding, paddedHeight = height + 2 * _padding;
+	size_t best = skyline.size();
+	uint32_t bestTop = UINT32_MAX, bestWidth = UINT32_MAX, bestY = 0;
+	for (size_t i = 0; i < skyline.size(); ++i) {
+		uint32_t y;
+		if (!fit(skyline, i, paddedWidth, paddedHeight, y)) {
+			continue;
+		}
+		// 윗변이 가장 낮은 곳, 같으면 더 좁은 윤곽선 위(버리는 틈이 적음)
+		if (y + paddedHeight < bestTop || (y + paddedHeight == bestTop && skyline[i].width < bestWidth)) {
+			best = i;
+			bestTop = y + paddedHeight;
+			bestWidth = skyline[i].width;
+			bestY = y;
+		}
+	}
+	if (best == skyline.size()) {
+		return false;
+	}
+	const uint32_t x = skyline[best].x;
+	rect = { page, x + _padding, bestY + _padding, width, height };
+	_usedArea += uint64_t(width) * height;
+
+	// 새 윤곽선을 넣고 그 밑에 깔린 부분을 잘라 낸다.
+	skyline.insert(skyline.begin() + best, SkylineNode{ x, bestTop, paddedWidth });
+	const uint32_t end = x + paddedWidth;
+	size_t next = best + 1;
+	while (next < skyline.size() && skyline[next].x < end) {
+		SkylineNode& node = skyline[next];
+		if (node.x + node.width <= end) {
+			skyline.erase(skyline.begin() + next);
+			continue;
+		}
+		node.width -= end - node.x;
+		node.x = end;
+		break;
+	}
+	// 높이가 같은 이웃을 합친다.
+	for (size_t i = 0; i + 1 < skyline.size();) {
+		if (skyline[i].y == skyline[i + 1].y) {
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		} else {
+			++i;
+		}
+	}
+	return true;
+}
+
+inline bool AtlasPacker::insert(uint32_t width, uint32_t height, AtlasRect& rect)
+{
+	if (width == 0 || height == 0 || width + 2 * _padding > _pageWidth || height + 2 * _padding > _pageHeight) {
+		return false;
+	}
+	for (uint32_t page = 0; page < pageCount(); ++page) {
+		if (insertInto(page, width, height, rect)) {
+			return true;
+		}
+	}
+	if (pageCount() >= _maxPages) {
+		return false;
+	}
+	openPage();
+	return insertInto(pageCount() - 1, width, height, rect);
+}
+
+inline size_t AtlasPacker::insertAll(std::vector<AtlasRect>& rects)
+{
+	std::vector<uint32_t> order(rects.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	// 높은 것부터 놓아야 윤곽선에 생기는 턱이 적다.
+	// 같은 크기는 번호 순서를 지킨다.
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		if (rects[a].height != rects[b].height) {
+			return rects[a].height > rects[b].height;
+		}
+		return rects[a].width != rects[b].width ? rects[a].width > rects[b].width : a < b;
+	});
+	size_t inserted = 0;
+	for (uint32_t index : order) {
+		AtlasRect& rect = rects[index];
+		if (insert(rect.width, rect.height, rect)) {
+			++inserted;
+		} else {
+			rect = AtlasRect();
+		}
+	}
+	return inserted;
+}
+
+#pragma endregion AtlasPacker }
+
+#pragma region SpriteAtlas {
+
+inline bool buildSpriteAtlas(const std::vector<SpriteImage>& images, uint32_t pageWidth, uint32_t pageHeight, uint32_t padding,
+		uint32_t maxPages, SpriteAtlas& atlas)
+{
+	atlas = SpriteAtlas();
+	atlas.pageWidth = pageWidth;
+	atlas.pageHeight = pageHeight;
+	atlas.rects.resize(images.size());
+	for (size_t i = 0; i < images.size(); ++i) {
+		if (images[i].pixels.size() != size_t(images[i].width) * images[i].height * 4) {
+			return SpriteDetail::fail("image " + std::to_string(i) + " is not " + std::to_string(images[i].width) + "x"
+					+ std::to_string(images[i].height) + " RGBA8");
+		}
+		atlas.rects[i].width = images[i].width;
+		atlas.rects[i].height = images[i].height;
+	}
+	AtlasPacker packer(pageWidth, pageHeight, padding, maxPages);
+	if (packer.insertAll(atlas.rects) != images.size()) {
+		return SpriteDetail::fail(std::to_string(images.size()) + " images do not fit in " + std::to_string(maxPages) + " pages of "
+				+ std::to_string(pageWidth) + "x" + std::to_string(pageHeight));
+	}
+	atlas.occupancy = packer.occupancy();
+	atlas.pages.assign(packer.pageCount(), std::vector<uint8_t>(size_t(pageWidth) * pageHeight * 4, 0));
+	for (size_t i = 0; i < images.size(); ++i) {
+		const AtlasRect& rect = atlas.rects[i];
+		SpriteDetail::blitExtruded(images[i], atlas.pages[rect.page].data(), pageWidth, pageHeight, rect.x, rect.y, padding);
+	}
+	return true;
+}
+
+#pragma endregion SpriteAtlas }
+
+#pragma region SpriteBatch {
+
+inline void SpriteBatch::build(ThreadPool& pool)
+{
+	const size_t count = _sprites.size();
+	_keys.resize(count);
+	_order.resize(count);
+	// 위 16 bit는 layer, 아래 16 bit는 page. radix sort는 stable하므로 같은 key는 add 순서대로 남는다.
+	pool.parallelFor(count, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const Sprite& sprite = _sprites[i];
+			const uint32_t layer = uint32_t(std::clamp(sprite.layer, -32768, 32767) + 32768);
+			const uint32_t page = sprite.image < _atlas->rects.size() ? _atlas->rects[sprite.image].page : 0;
+			_keys[i] = layer << 16 | std::min(page, 0xFFFFu);
+			_order[i] = uint32_t(i);
+		}
+	});
+	radixSortPairs(_keys, _order, pool);
+	_draws.clear();
+	for (size_t i = 0; i < count; ++i) {
+		const uint32_t page = _keys[i] & 0xFFFFu;
+		if (_draws.empty() || _draws.back().page != page) {
+			_draws.push_back({ page, uint32_t(i * 6), 0 });
+		}
+		_draws.back().indexCount += 6;
+	}
+}
+
+inline void SpriteBatch::writeVertices(SpriteVertex* vertices, ThreadPool& pool) const
+{
+	const SpriteAtlas& atlas = *_atlas;
+	const float inverseWidth = 1.0f / float(std::max(1u, atlas.pageWidth)), inverseHeight = 1.0f / float(std::max(1u, atlas.pageHeight));
+	pool.parallelFor(_order.size(), 2048, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const Sprite& sprite = _sprites[_order[i]];
+			const AtlasRect rect = sprite.image < atlas.rects.size() ? atlas.rects[sprite.image] : AtlasRect();
+			const float u0 = float(rect.x) * inverseWidth, u1 = float(rect.x + rect.width) * inverseWidth;
+			const float v0 = float(rect.y) * inverseHeight, v1 = float(rect.y + rect.height) * inverseHeight;
+			SpriteVertex* quad = vertices + i * 4;
+			if (sprite.rotation == 0.0f) {
+				const float x0 = sprite.position.x, x1 = sprite.position.x + sprite.size.x;
+				const float y0 = sprite.position.y, y1 = sprite.position.y + sprite.size.y;
+				quad[0] = { { x0, y0 }, { u0, v0 }, sprite.color };
+				quad[1] = { { x1, y0 }, { u1, v0 }, sprite.color };
+				quad[2] = { { x0, y1 }, { u0, v1 }, sprite.color };
+				quad[3] = { { x1, y1 }, { u1, v1 }, sprite.color };
+				continue;
+			}
+			// y가 아래로 커지므로 이 회전은 화면에서 시계 방향이다.
+			const float c = std::cos(sprite.rotation), s = std::sin(sprite.rotation);
+			const float halfWidth = sprite.size.x * 0.5f, halfHeight = sprite.size.y * 0.5f;
+			const float centerX = sprite.position.x + halfWidth, centerY = sprite.position.y + halfHeight;
+			auto corner = [&](float dx, float dy) { return Float2{ centerX + dx * c - dy * s, centerY + dx * s + dy * c }; };
+			quad[0] = { corner(-halfWidth, -halfHeight), { u0, v0 }, sprite.color };
+			quad[1] = { corner(halfWidth, -halfHeight), { u1, v0 }, sprite.color };
+			quad[2] = { corner(-halfWidth, halfHeight), { u0, v1 }, sprite.color };
+			quad[3] = { corner(halfWidth, halfHeight), { u1, v1 }, sprite.color };
+		}
+	});
+}
+
+inline void SpriteBatch::writeQuadIndices(uint32_t* indices, size_t quadCount)
+{
+	for (size_t quad = 0; quad < quadCount; ++quad) {
+		const uint32_t vertex = uint32_t(quad * 4);
+		uint32_t* out = indices + quad * 6;
+		out[0] = vertex;
+		out[1] = vertex + 1;
+		out[2] = vertex + 2;
+		out[3] = vertex + 2;
+		out[4] = vertex + 1;
+		out[5] = vertex + 3;
+	}
+}
+
+#pragma endregion SpriteBatch }
@@ -0,0 +1,287 @@
+/*
+ * StateCache.hpp
+ *
+ * sampler / depth-stencil state를 descriptor 내용으로 찾는 cache. 같은 내용의 descriptor는 device에서 한 번만 만든다.
+ *  - SamplerKey, DepthStencilKey: MTL::SamplerDescriptor / MTL::DepthStencilDescriptor의 값을 padding 없이 담은 POD.
+ *    byte 그대로 hash 하고 비교한다. 기본값은 Metal descriptor의 기본값과 같다.
+ *  - StateCache: key의 hash로 shard를 고르고 shard마다 mutex, hash map, LRU list를 따로 둔다. 전체를 덮는 lock은 없다.
+ *    없는 key는 그 shard의 lock을 쥔 채로 만들므로 여러 thread가 같은 key를 동시에 찾아도 한 번만 만든다.
+ *    shard가 차면 가장 오래 쓰지 않은 state의 cache 쪽 참조를 놓는다.
+ * Metal 호출(key -> descriptor -> state)은 01-primitive에 있고, 여기 있는 것은 GPU 없이 돌아간다. (bench/state-cache)
+ * enum 값은 같은 이름의 MTL:: enum 값과 같다.
+ * */
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+enum StateCompareFunction : uint8_t {
+	StateCompareFunctionNever = 0,
+	StateCompareFunctionLess = 1,
+	StateCompareFunctionEqual = 2,
+	StateCompareFunctionLessEqual = 3,
+	StateCompareFunctionGreater = 4,
+	StateCompareFunctionNotEqual = 5,
+	StateCompareFunctionGreaterEqual = 6,
+	StateCompareFunctionAlways = 7,
+};
+
+// MTL::SamplerMinMagFilter
+enum SamplerFilter : uint8_t {
+	SamplerFilterNearest = 0,
+	SamplerFilterLinear = 1,
+};
+
+// MTL::SamplerMipFilter
+enum SamplerMipFilter : uint8_t {
+	SamplerMipFilterNotMipmapped = 0,
+	SamplerMipFilterNearest = 1,
+	SamplerMipFilterLinear = 2,
+};
+
+enum SamplerAddressMode : uint8_t {
+	SamplerAddressModeClampToEdge = 0,
+	SamplerAddressModeMirrorClampToEdge = 1,
+	SamplerAddressModeRepeat = 2,
+	SamplerAddressModeMirrorRepeat = 3,
+	SamplerAddressModeClampToZero = 4,
+	SamplerAddressModeClampToBorderColor = 5,
+};
+
+enum StencilOperation : uint8_t {
+	StencilOperationKeep = 0,
+	StencilOperationZero = 1,
+	StencilOperationReplace = 2,
+	StencilOperationIncrementClamp = 3,
+	StencilOperationDecrementClamp = 4,
+	StencilOperationInvert = 5,
+	StencilOperationIncrementWrap = 6,
+	StencilOperationDecrementWrap = 7,
+};
+
+// MTL::SamplerDescriptor. label은 state를 구분하지 않으므로 넣지 않는다.
+struct SamplerKey {
+	float lodMinClamp{0.0f};
+	float lodMaxClamp{FLT_MAX};
+	uint8_t minFilter{SamplerFilterNearest};
+	uint8_t magFilter{SamplerFilterNearest};
+	uint8_t mipFilter{SamplerMipFilterNotMipmapped};
+	uint8_t maxAnisotropy{1};
+	uint8_t sAddressMode{SamplerAddressModeClampToEdge};
+	uint8_t tAddressMode{SamplerAddressModeClampToEdge};
+	uint8_t rAddressMode{SamplerAddressModeClampToEdge};
+	// MTL::SamplerBorderColor (TransparentBlack = 0, OpaqueBlack = 1, OpaqueWhite = 2)
+	uint8_t borderColor{0};
+	uint8_t normalizedCoordinates{1};
+	uint8_t lodAverage{0};
+	uint8_t compareFunction{StateCompareFunctionNever};
+	uint8_t supportArgumentBuffers{0};
+};
+static_assert(sizeof(SamplerKey) == 20, "SamplerKey must have no padding");
+
+// MTL::StencilDescriptor
+struct StencilKey {
+	uint32_t readMask{0xFFFFFFFF};
+	uint32_t writeMask{0xFFFFFFFF};
+	uint8_t compareFunction{StateCompareFunctionAlways};
+	uint8_t stencilFailureOperation{StencilOperationKeep};
+	uint8_t depthFailureOperation{StencilOperationKeep};
+	uint8_t depthStencilPassOperation{StencilOperationKeep};
+};
+static_assert(sizeof(StencilKey) == 12, "StencilKey must have no padding");
+
+// MTL::DepthStencilDescriptor. stencil은 enabled일 때만 descriptor에 붙인다.
+struct DepthStencilKey {
+	StencilKey frontFaceStencil;
+	StencilKey backFaceStencil;
+	uint8_t depthCompareFunction{StateCompareFunctionAlways};
+	uint8_t depthWriteEnabled{0};
+	uint8_t frontFaceStencilEnabled{0};
+	uint8_t backFaceStencilEnabled{0};
+};
+static_assert(sizeof(DepthStencilKey) == 28, "DepthStencilKey must have no padding");
+
+// key를 4 byte 단위로 섞는다. 모든 key의 크기는 4의 배수이다.
+inline uint64_t hashStateKey(const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = 0xCBF29CE484222325ull ^ size;
+	for (size_t i = 0; i + 4 <= size; i += 4) {
+		uint32_t word;
+		std::memcpy(&word, bytes + i, 4);
+		hash = (hash ^ word) * 0x100000001B3ull;
+		hash ^= hash >> 29;
+	}
+	// splitmix64 finalizer. 위쪽 bit는 shard, 아래쪽 bit는 map bucket에 쓴다.
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+	return hash ^ (hash >> 31);
+}
+
+template <typename Key>
+struct StateKeyHash {
+	size_t operator()(const Key& key) const { return size_t(hashStateKey(&key, sizeof(Key))); }
+};
+
+template <typename Key>
+struct StateKeyEqual {
+	bool operator()(const Key& a, const Key& b) const { return std::memcmp(&a, &b, sizeof(Key)) == 0; }
+};
+
+struct StateCacheStats {
+	uint64_t hits{0};
+	uint64_t creations{0};
+	uint64_t evictions{0};
+	// 지금 cache에 있는 state 수
+	uint64_t size{0};
+
+	double hitRate() const { return hits + creations ? double(hits) / double(hits + creations) : 0.0; }
+};
+
+/*
+ * Key는 padding 없는 POD, State는 retain() / release()가 있는 참조 계수 객체이다. (MTL::SamplerState, MTL::DepthStencilState)
+ * create는 +1 참조의 새 state를 돌려준다. (device->newSamplerState) 실패하면 nullptr이고 cache에 넣지 않는다.
+ * capacity는 전체 상한이고 shard마다 똑같이 나눈다.
+ * */
+template <typename Key, typename State>
+class StateCache {
+	public:
+		using CreateFunction = std::function<State*(const Key&)>;
+
+		explicit StateCache(CreateFunction create, size_t capacity = 1024, size_t shardCount = 16);
+		~StateCache();
+		StateCache(const StateCache&) = delete;
+		StateCache& operator=(const StateCache&) = delete;
+
+		// key의 state를 +1 참조로 돌려준다. 부르는 쪽이 release 한다. (new... 함수와 같다) 여러 thread에서 불러도 된다.
+		State* acquire(const Key& key);
+		// 가지고 있는 state를 모두 놓는다. 밖에서 쥔 참조는 그대로 살아 있다.
+		void clear();
+		StateCacheStats stats() const;
+		// 누적 count만 지운다. 들어 있는 state는 그대로 둔다.
+		void resetStats();
+		size_t shardCount() const { return _shards.size(); }
+
+	private:
+		struct Entry {
+			Key key;
+			State* state;
+		};
+		// list의 앞쪽이 최근에 쓴 것이다.
+		struct Shard {
+			mutable std::mutex mutex;
+			std::list<Entry> lru;
+			std::unordered_map<Key, typename std::list<Entry>::iterator, StateKeyHash<Key>, StateKeyEqual<Key>> entries;
+			uint64_t hits{0};
+			uint64_t creations{0};
+			uint64_t evictions{0};
+		};
+
+		Shard& shardFor(const Key& key);
+
+		CreateFunction _create;
+		size_t _shardCapacity;
+		std::vector<std::unique_ptr<Shard>> _shards;
+};
+
+#pragma region StateCache {
+
+template <typename Key, typename State>
+StateCache<Key, State>::StateCache(CreateFunction create, size_t capacity, size_t shardCount)
+: _create(std::move(create))
+{
+	shardCount = shardCount ? shardCount : 1;
+	_shardCapacity = capacity > shardCount ? (capacity + shardCount - 1) / shardCount : 1;
+	for (size_t i = 0; i < shardCount; ++i) {
+		_shards.emplace_back(new Shard());
+	}
+}
+
+template <typename Key, typename State>
+StateCache<Key, State>::~StateCache()
+{
+	clear();
+}
+
+template <typename Key, typename State>
+typename StateCache<Key, State>::Shard& StateCache<Key, State>::shardFor(const Key& key)
+{
+	return *_shards[size_t(hashStateKey(&key, sizeof(Key)) >> 40) % _shards.size()];
+}
+
+template <typename Key, typename State>
+State* StateCache<Key, State>::acquire(const Key& key)
+{
+	Shard& shard = shardFor(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto found = shard.entries.find(key);
+	if (found != shard.entries.end()) {
+		shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+		++shard.hits;
+		found->second->state->retain();
+		return found->second->state;
+	}
+	// 같은 shard의 다른 lookup은 기다리지만 같은 key를 두 번 만들지는 않는다.
+	State* state = _create(key);
+	if (!state) {
+		return nullptr;
+	}
+	++shard.creations;
+	if (shard.entries.size() >= _shardCapacity) {
+		Entry& oldest = shard.lru.back();
+		oldest.state->release();
+		shard.entries.erase(oldest.key);
+		shard.lru.pop_back();
+		++shard.evictions;
+	}
+	shard.lru.push_front({ key, state });
+	shard.entries.emplace(key, shard.lru.begin());
+	state->retain();
+	return state;
+}
+
+template <typename Key, typename State>
+void StateCache<Key, State>::clear()
+{
+	for (std::unique_ptr<Shard>& shard : _shards) {
+		std::lock_guard<std::mutex> lock(shard->mutex);
+		for (Entry& entry : shard->lru) {
+			entry.state->release();
+		}
+		shard->lru.clear();
+		shard->entries.clear();
+	}
+}
+
+template <typename Key, typename State>
+StateCacheStats StateCache<Key, State>::stats() const
+{
+	StateCacheStats stats;
+	for (const std::unique_ptr<Shard>& shard : _shards) {
+		std::lock_guard<std::mutex> lock(shard->mutex);
+		stats.hits += shard->hits;
+		stats.creations += shard->creations;
+		stats.evictions += shard->evictions;
+		stats.size += shard->entries.size();
+	}
+	return stats;
+}
+
+template <typename Key, typename State>
+void StateCache<Key, State>::resetStats()
+{
+	for (std::unique_ptr<Shard>& shard : _shards) {
+		std::lock_guard<std::mutex> lock(shard->mutex);
+		shard->hits = shard->creations = shard->evictions = 0;
+	}
+}
+
+#pragma endregion StateCache }
@@ -0,0 +1,1004 @@
+/*
+ * TextureLoader.hpp
+ *
+ * KTX2, DDS texture container를 읽고 쓴다.
+ * header만 보고 level / slice마다 "파일의 어디에 몇 byte가 어떤 배치로 있는지"(TextureSubresource)를 만들어 두므로
+ * 01-primitive는 그대로 MTL::TextureDescriptor를 채우고 replaceRegion / blit copyFromBuffer로 올릴 수 있다.
+ * TextureFormat의 값은 MTL::PixelFormat, TextureType의 값은 MTL::TextureType과 같다.
+ *
+ * 큰 texture는 TextureStreamer로 작은 mip부터 읽는다. 가장 작은 level들은 open에서 바로 읽어 곧장 그릴 수 있게 하고,
+ * 나머지는 ThreadPool에서 작은 것부터 읽어 두면 renderer가 frame마다 꺼내 올린다.
+ * supercompression(Basis, zstd)은 지원하지 않는다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+enum TextureFormat : uint32_t {
+	TextureFormatInvalid = 0,
+	TextureFormatR8Unorm = 10,
+	TextureFormatRG8Unorm = 30,
+	TextureFormatRGBA8Unorm = 70,
+	TextureFormatRGBA8Unorm_sRGB = 71,
+	TextureFormatBGRA8Unorm = 80,
+	TextureFormatBGRA8Unorm_sRGB = 81,
+	TextureFormatRGBA16Float = 115,
+	TextureFormatRGBA32Float = 125,
+	TextureFormatBC1_RGBA = 130,
+	TextureFormatBC1_RGBA_sRGB = 131,
+	TextureFormatBC2_RGBA = 132,
+	TextureFormatBC2_RGBA_sRGB = 133,
+	TextureFormatBC3_RGBA = 134,
+	TextureFormatBC3_RGBA_sRGB = 135,
+	TextureFormatBC4_RUnorm = 140,
+	TextureFormatBC4_RSnorm = 141,
+	TextureFormatBC5_RGUnorm = 142,
+	TextureFormatBC5_RGSnorm = 143,
+	TextureFormatBC6H_RGBFloat = 150,
+	TextureFormatBC6H_RGBUfloat = 151,
+	TextureFormatBC7_RGBAUnorm = 152,
+	TextureFormatBC7_RGBAUnorm_sRGB = 153,
+	TextureFormatASTC_4x4_sRGB = 186,
+	TextureFormatASTC_5x4_sRGB = 187,
+	TextureFormatASTC_5x5_sRGB = 188,
+	TextureFormatASTC_6x5_sRGB = 189,
+	TextureFormatASTC_6x6_sRGB = 190,
+	TextureFormatASTC_8x5_sRGB = 192,
+	TextureFormatASTC_8x6_sRGB = 193,
+	TextureFormatASTC_8x8_sRGB = 194,
+	TextureFormatASTC_10x5_sRGB = 195,
+	TextureFormatASTC_10x6_sRGB = 196,
+	TextureFormatASTC_10x8_sRGB = 197,
+	TextureFormatASTC_10x10_sRGB = 198,
+	TextureFormatASTC_12x10_sRGB = 199,
+	TextureFormatASTC_12x12_sRGB = 200,
+	TextureFormatASTC_4x4_LDR = 204,
+	TextureFormatASTC_5x4_LDR = 205,
+	TextureFormatASTC_5x5_LDR = 206,
+	TextureFormatASTC_6x5_LDR = 207,
+	TextureFormatASTC_6x6_LDR = 208,
+	TextureFormatASTC_8x5_LDR = 210,
+	TextureFormatASTC_8x6_LDR = 211,
+	TextureFormatASTC_8x8_LDR = 212,
+	TextureFormatASTC_10x5_LDR = 213,
+	TextureFormatASTC_10x6_LDR = 214,
+	TextureFormatASTC_10x8_LDR = 215,
+	TextureFormatASTC_10x10_LDR = 216,
+	TextureFormatASTC_12x10_LDR = 217,
+	TextureFormatASTC_12x12_LDR = 218,
+	TextureFormatASTC_4x4_HDR = 222,
+	TextureFormatASTC_5x4_HDR = 223,
+	TextureFormatASTC_5x5_HDR = 224,
+	TextureFormatASTC_6x5_HDR = 225,
+	TextureFormatASTC_6x6_HDR = 226,
+	TextureFormatASTC_8x5_HDR = 228,
+	TextureFormatASTC_8x6_HDR = 229,
+	TextureFormatASTC_8x8_HDR = 230,
+	TextureFormatASTC_10x5_HDR = 231,
+	TextureFormatASTC_10x6_HDR = 232,
+	TextureFormatASTC_10x8_HDR = 233,
+	TextureFormatASTC_10x10_HDR = 234,
+	TextureFormatASTC_12x10_HDR = 235,
+	TextureFormatASTC_12x12_HDR = 236,
+};
+
+enum TextureType : uint32_t {
+	TextureType2D = 2,
+	TextureType2DArray = 3,
+	TextureTypeCube = 5,
+	TextureTypeCubeArray = 6,
+	TextureType3D = 7,
+};
+
+// 압축하지 않은 format은 1x1 block이다. 모르는 format은 bytesPerBlock이 0이다.
+struct TextureFormatInfo {
+	uint32_t blockWidth;
+	uint32_t blockHeight;
+	uint32_t bytesPerBlock;
+};
+
+TextureFormatInfo textureFormatInfo(TextureFormat format);
+bool isCompressedTextureFormat(TextureFormat format);
+// width x height x depth에서 1x1x1까지의 level 수
+uint32_t mipLevelCount(uint32_t width, uint32_t height, uint32_t depth = 1);
+
+// level 하나의 slice 하나. 3D texture는 depth 장을 한 subresource로 다룬다.
+struct TextureSubresource {
+	uint32_t level;
+	// layer * faces + face
+	uint32_t slice;
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	// block 한 줄, 한 장의 byte 수. replaceRegion / copyFromBuffer에 그대로 넘긴다.
+	uint32_t bytesPerRow;
+	uint64_t bytesPerImage;
+	// 파일(TextureData에서는 bytes) 안의 위치와 크기
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct TextureLayout {
+	TextureFormat format{TextureFormatInvalid};
+	TextureType type{TextureType2D};
+	uint32_t width{0};
+	uint32_t height{0};
+	uint32_t depth{1};
+	// cube array면 cube 수
+	uint32_t layers{1};
+	uint32_t faces{1};
+	uint32_t levels{1};
+	// subresources[level * slices() + slice]
+	std::vector<TextureSubresource> subresources;
+
+	uint32_t slices() const { return layers * faces; }
+	const TextureSubresource& subresource(uint32_t level, uint32_t slice) const { return subresources[level * slices() + slice]; }
+	// level 하나의 모든 slice
+	uint64_t levelSize(uint32_t level) const { return subresource(level, 0).size * slices(); }
+	uint64_t totalSize() const;
+};
+
+/*
+ * 빈 파일에 쓸 layout. subresource는 level 순서, 그 안에서 slice 순서로 빈틈없이 이어 붙인다.
+ * levels가 0이면 1x1까지 모두 만든다.
+ * */
+TextureLayout makeTextureLayout(TextureFormat format, uint32_t width, uint32_t height, uint32_t levels = 1,
+		uint32_t layers = 1, uint32_t faces = 1, uint32_t depth = 1);
+
+// 파일 하나를 통째로 읽은 texture. subresource의 offset은 bytes 안의 위치이다.
+struct TextureData {
+	TextureLayout layout;
+	std::vector<uint8_t> bytes;
+
+	uint8_t* data(uint32_t level, uint32_t slice = 0) { return bytes.data() + layout.subresource(level, slice).offset; }
+	const uint8_t* data(uint32_t level, uint32_t slice = 0) const { return bytes.data() + layout.subresource(level, slice).offset; }
+};
+
+/*
+ * 파일 앞부분(bytes, size)으로 KTX2 / DDS header를 읽어 layout을 채운다. subresource의 offset은 파일 안의 위치이다.
+ * 모든 subresource가 fileSize 안에 있는지까지 확인한다. 실패하면 이유를 출력하고 false를 반환한다.
+ * */
+bool parseTextureHeader(const uint8_t* bytes, size_t size, uint64_t fileSize, TextureLayout& layout);
+bool parseKtx2(const uint8_t* bytes, size_t size, uint64_t fileSize, TextureLayout& layout);
+bool parseDds(const uint8_t* bytes, size_t size, uint64_t fileSize, TextureLayout& layout);
+
+// 파일 전체를 읽는다. 실패하면 이유를 출력하고 false를 반환한다.
+bool loadTexture(const char* path, TextureData& texture);
+
+// 확장자(.ktx2 / .dds)를 보고 저장한다. DDS는 ASTC를 담을 수 없다.
+bool saveTexture(const char* path, const TextureData& texture);
+bool encodeKtx2(const TextureData& texture, std::vector<uint8_t>& file);
+bool encodeDds(const TextureData& texture, std::vector<uint8_t>& file);
+
+// level 하나의 모든 slice. slice s는 bytes의 s * subresource(level, s).size 부터이다.
+struct TextureLevelData {
+	uint32_t level{0};
+	std::vector<uint8_t> bytes;
+};
+
+/*
+ * mip을 작은 level부터 읽는다.
+ * open은 header와, 가장 작은 level부터 합쳐서 initialBytes 안에 드는 level들(적어도 하나)을 바로 읽는다.
+ * stream은 나머지를 작은 것부터 하나씩 pool에서 읽는다. level 하나를 읽을 때마다 다음 level을 새 작업으로 넘기므로
+ * 큰 파일을 읽는 동안에도 worker를 오래 붙잡지 않는다.
+ * poll은 읽힌 level을 읽힌 순서(작은 것부터)대로 하나씩 꺼낸다. 꺼낸 level까지 올렸으면 그 level이 가장 정밀한 resident level이다.
+ * */
+class TextureStreamer {
+	public:
+		TextureStreamer() = default;
+		~TextureStreamer();
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		bool open(const char* path, uint64_t initialBytes = 64 * 1024);
+		void stream(ThreadPool& pool = ThreadPool::shared());
+		bool poll(TextureLevelData& level);
+		// 모든 level을 꺼냈거나 읽다가 실패했다.
+		bool finished() const;
+		const TextureLayout& layout() const { return _layout; }
+
+	private:
+		bool readLevel(uint32_t level, TextureLevelData& data) const;
+		void streamLevel(uint32_t level, ThreadPool* pPool);
+
+		std::string _path;
+		TextureLayout _layout;
+		// 다음에 읽을 level + 1. level은 큰 번호(작은 mip)부터 읽으므로 0이면 모두 읽기 시작했다.
+		uint32_t _nextLevel{0};
+		mutable std::mutex _mutex;
+		std::condition_variable _idle;
+		std::deque<TextureLevelData> _ready;
+		uint32_t _levelsPolled{0};
+		uint32_t _tasksInFlight{0};
+		std::atomic<bool> _cancel{false};
+		bool _failed{false};
+};
+
+#pragma region TextureFormat {
+
+inline TextureFormatInfo textureFormatInfo(TextureFormat format)
+{
+	switch (format) {
+		case TextureFormatR8Unorm: return { 1, 1, 1 };
+		case TextureFormatRG8Unorm: return { 1, 1, 2 };
+		case TextureFormatRGBA8Unorm:
+		case TextureFormatRGBA8Unorm_sRGB:
+		case TextureFormatBGRA8Unorm:
+		case TextureFormatBGRA8Unorm_sRGB: return { 1, 1, 4 };
+		case TextureFormatRGBA16Float: return { 1, 1, 8 };
+		case TextureFormatRGBA32Float: return { 1, 1, 16 };
+		case TextureFormatBC1_RGBA:
+		case TextureFormatBC1_RGBA_sRGB:
+		case TextureFormatBC4_RUnorm:
+		case TextureFormatBC4_RSnorm: return { 4, 4, 8 };
+		case TextureFormatBC2_RGBA:
+		case TextureFormatBC2_RGBA_sRGB:
+		case TextureFormatBC3_RGBA:
+		case TextureFormatBC3_RGBA_sRGB:
+		case TextureFormatBC5_RGUnorm:
+		case TextureFormatBC5_RGSnorm:
+		case TextureFormatBC6H_RGBFloat:
+		case TextureFormatBC6H_RGBUfloat:
+		case TextureFormatBC7_RGBAUnorm:
+		case TextureFormatBC7_RGBAUnorm_sRGB: return { 4, 4, 16 };
+		default: break;
+	}
+	// ASTC는 sRGB / LDR / HDR 세 묶음이 같은 block 크기 순서로 놓여 있고 block은 모두 16 byte이다.
+	static const uint8_t kAstcBlocks[][2] = { { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 0, 0 }, { 8, 5 }, { 8, 6 }, { 8, 8 },
+		{ 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } };
+	for (uint32_t first : { uint32_t(TextureFormatASTC_4x4_sRGB), uint32_t(TextureFormatASTC_4x4_LDR), uint32_t(TextureFormatASTC_4x4_HDR) }) {
+		if (format >= first && format < first + 15 && kAstcBlocks[format - first][0] != 0) {
+			return { kAstcBlocks[format - first][0], kAstcBlocks[format - first][1], 16 };
+		}
+	}
+	return { 1, 1, 0 };
+}
+
+inline bool isCompressedTextureFormat(TextureFormat format)
+{
+	return textureFormatInfo(format).blockWidth > 1;
+}
+
+inline uint32_t mipLevelCount(uint32_t width, uint32_t height, uint32_t depth)
+{
+	uint32_t largest = std::max({ width, height, depth, 1u });
+	uint32_t levels = 1;
+	while (largest >>= 1) {
+		++levels;
+	}
+	return levels;
+}
+
+inline uint64_t TextureLayout::totalSize() const
+{
+	uint64_t total = 0;
+	for (const TextureSubresource& subresource : subresources) {
+		total += subresource.size;
+	}
+	return total;
+}
+
+namespace TextureDetail {
+
+inline bool fail(const std::string& message)
+{
+	std::cerr << "texture: " << message << std::endl;
+	return false;
+}
+
+inline uint32_t read32(const uint8_t* p)
+{
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+inline uint64_t read64(const uint8_t* p)
+{
+	uint64_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+inline void write32(std::vector<uint8_t>& out, size_t offset, uint32_t value)
+{
+	std::memcpy(out.data() + offset, &value, sizeof(value));
+}
+
+inline void write64(std::vector<uint8_t>& out, size_t offset, uint64_t value)
+{
+	std::memcpy(out.data() + offset, &value, sizeof(value));
+}
+
+// format, 크기, level / layer / face 수를 검사하고 offset 0인 subresource를 만든다.
+inline bool buildSubresources(TextureLayout& layout)
+{
+	const TextureFormatInfo info = textureFormatInfo(layout.format);
+	if (info.bytesPerBlock == 0) {
+		return fail("unsupported pixel format");
+	}
+	if (layout.width == 0 || layout.height == 0 || layout.depth == 0 || layout.layers == 0 || (layout.faces != 1 && layout.faces != 6)) {
+		return fail("invalid texture size");
+	}
+	if (layout.width > 16384 || layout.height > 16384 || layout.depth > 2048 || layout.layers > 2048) {
+		return fail("texture is larger than 16384 x 16384 x 2048");
+	}
+	if (layout.faces == 6 && (layout.width != layout.height || layout.depth != 1)) {
+		return fail("cube faces must be square");
+	}
+	if (layout.depth > 1 && (layout.layers != 1 || isCompressedTextureFormat(layout.format))) {
+		return fail("3D textures cannot be arrays or block compressed here");
+	}
+	if (layout.levels == 0 || layout.levels > mipLevelCount(layout.width, layout.height, layout.depth)) {
+		return fail("invalid mip level count " + std::to_string(layout.levels));
+	}
+	if (layout.depth > 1) {
+		layout.type = TextureType3D;
+	} else if (layout.faces == 6) {
+		layout.type = layout.layers > 1 ? TextureTypeCubeArray : TextureTypeCube;
+	} else {
+		layout.type = layout.layers > 1 ? TextureType2DArray : TextureType2D;
+	}
+
+	layout.subresources.clear();
+	layout.subresources.reserve(size_t(layout.levels) * layout.slices());
+	for (uint32_t level = 0; level < layout.levels; ++level) {
+		TextureSubresource subresource{};
+		subresource.level = level;
+		subresource.width = std::max(1u, layout.width >> level);
+		subresource.height = std::max(1u, layout.height >> level);
+		subresource.depth = std::max(1u, layout.depth >> level);
+		uint32_t blocksWide = (subresource.width + info.blockWidth - 1) / info.blockWidth;
+		uint32_t blocksHigh = (subresource.height + info.blockHeight - 1) / info.blockHeight;
+		subresource.bytesPerRow = blocksWide * info.bytesPerBlock;
+		subresource.bytesPerImage = uint64_t(subresource.bytesPerRow) * blocksHigh;
+		subresource.size = subresource.bytesPerImage * subresource.depth;
+		for (uint32_t slice = 0; slice < layout.slices(); ++slice) {
+			subresource.slice = slice;
+			layout.subresources.push_back(subresource);
+		}
+	}
+	return true;
+}
+
+inline bool checkFileSize(const TextureLayout& layout, uint64_t fileSize)
+{
+	for (const TextureSubresource& subresource : layout.subresources) {
+		if (subresource.offset > fileSize || subresource.size > fileSize - subresource.offset) {
+			return fail("file is truncated (level " + std::to_string(subresource.level) + ")");
+		}
+	}
+	return true;
+}
+
+// vkFormat - TextureFormat
+struct VkFormatEntry {
+	uint32_t vkFormat;
+	TextureFormat format;
+};
+
+inline const std::vector<VkFormatEntry>& vkFormats()
+{
+	static const std::vector<VkFormatEntry> table = [] {
+		std::vector<VkFormatEntry> entries = {
+			{ 9, TextureFormatR8Unorm },
+			{ 16, TextureFormatRG8Unorm },
+			{ 37, TextureFormatRGBA8Unorm },
+			{ 43, TextureFormatRGBA8Unorm_sRGB },
+			{ 44, TextureFormatBGRA8Unorm },
+			{ 50, TextureFormatBGRA8Unorm_sRGB },
+			{ 97, TextureFormatRGBA16Float },
+			{ 109, TextureFormatRGBA32Float },
+			{ 133, TextureFormatBC1_RGBA },
+			{ 134, TextureFormatBC1_RGBA_sRGB },
+			{ 135, TextureFormatBC2_RGBA },
+			{ 136, TextureFormatBC2_RGBA_sRGB },
+			{ 137, TextureFormatBC3_RGBA },
+			{ 138, TextureFormatBC3_RGBA_sRGB },
+			{ 139, TextureFormatBC4_RUnorm },
+			{ 140, TextureFormatBC4_RSnorm },
+			{ 141, TextureFormatBC5_RGUnorm },
+			{ 142, TextureFormatBC5_RGSnorm },
+			{ 143, TextureFormatBC6H_RGBUfloat },
+			{ 144, TextureFormatBC6H_RGBFloat },
+			{ 145, TextureFormatBC7_RGBAUnorm },
+			{ 146, TextureFormatBC7_RGBAUnorm_sRGB },
+		};
+		// VK_FORMAT_ASTC_4x4_UNORM_BLOCK(157)부터 block 크기마다 UNORM, SRGB 순서이다.
+		// HDR은 VK_EXT_texture_compression_astc_hdr의 SFLOAT(1000066000...)이다.
+		static const TextureFormat kLdr[] = { TextureFormatASTC_4x4_LDR, TextureFormatASTC_5x4_LDR, TextureFormatASTC_5x5_LDR,
+			TextureFormatASTC_6x5_LDR, TextureFormatASTC_6x6_LDR, TextureFormatASTC_8x5_LDR, TextureFormatASTC_8x6_LDR,
+			TextureFormatASTC_8x8_LDR, TextureFormatASTC_10x5_LDR, TextureFormatASTC_10x6_LDR, TextureFormatASTC_10x8_LDR,
+			TextureFormatASTC_10x10_LDR, TextureFormatASTC_12x10_LDR, TextureFormatASTC_12x12_LDR };
+		static const TextureFormat kSrgb[] = { TextureFormatASTC_4x4_sRGB, TextureFormatASTC_5x4_sRGB, TextureFormatASTC_5x5_sRGB,
+			TextureFormatASTC_6x5_sRGB, TextureFormatASTC_6x6_sRGB, TextureFormatASTC_8x5_sRGB, TextureFormatASTC_8x6_sRGB,
+			TextureFormatASTC_8x8_sRGB, TextureFormatASTC_10x5_sRGB, TextureFormatASTC_10x6_sRGB, TextureFormatASTC_10x8_sRGB,
+			TextureFormatASTC_10x10_sRGB, TextureFormatASTC_12x10_sRGB, TextureFormatASTC_12x12_sRGB };
+		static const TextureFormat kHdr[] = { TextureFormatASTC_4x4_HDR, TextureFormatASTC_5x4_HDR, TextureFormatASTC_5x5_HDR,
+			TextureFormatASTC_6x5_HDR, TextureFormatASTC_6x6_HDR, TextureFormatASTC_8x5_HDR, TextureFormatASTC_8x6_HDR,
+			TextureFormatASTC_8x8_HDR, TextureFormatASTC_10x5_HDR, TextureFormatASTC_10x6_HDR, TextureFormatASTC_10x8_HDR,
+			TextureFormatASTC_10x10_HDR, TextureFormatASTC_12x10_HDR, TextureFormatASTC_12x12_HDR };
+		for (uint32_t i = 0; i < 14; ++i) {
+			entries.push_back({ 157 + 2 * i, kLdr[i] });
+			entries.push_back({ 158 + 2 * i, kSrgb[i] });
+			entries.push_back({ 1000066000 + i, kHdr[i] });
+		}
+		return entries;
+	}();
+	return table;
+}
+
+// DXGI_FORMAT - TextureFormat
+struct DxgiFormatEntry {
+	uint32_t dxgiFormat;
+	TextureFormat format;
+};
+
+inline const DxgiFormatEntry* dxgiFormats(size_t& count)
+{
+	static const DxgiFormatEntry kEntries[] = {
+		{ 2, TextureFormatRGBA32Float },
+		{ 10, TextureFormatRGBA16Float },
+		{ 28, TextureFormatRGBA8Unorm },
+		{ 29, TextureFormatRGBA8Unorm_sRGB },
+		{ 49, TextureFormatRG8Unorm },
+		{ 61, TextureFormatR8Unorm },
+		{ 71, TextureFormatBC1_RGBA },
+		{ 72, TextureFormatBC1_RGBA_sRGB },
+		{ 74, TextureFormatBC2_RGBA },
+		{ 75, TextureFormatBC2_RGBA_sRGB },
+		{ 77, TextureFormatBC3_RGBA },
+		{ 78, TextureFormatBC3_RGBA_sRGB },
+		{ 80, TextureFormatBC4_RUnorm },
+		{ 81, TextureFormatBC4_RSnorm },
+		{ 83, TextureFormatBC5_RGUnorm },
+		{ 84, TextureFormatBC5_RGSnorm },
+		{ 87, TextureFormatBGRA8Unorm },
+		{ 91, TextureFormatBGRA8Unorm_sRGB },
+		{ 95, TextureFormatBC6H_RGBUfloat },
+		{ 96, TextureFormatBC6H_RGBFloat },
+		{ 98, TextureFormatBC7_RGBAUnorm },
+		{ 99, TextureFormatBC7_RGBAUnorm_sRGB },
+	};
+	count = sizeof(kEntries) / sizeof(kEntries[0]);
+	return kEntries;
+}
+
+inline TextureFormat formatOfVk(uint32_t vkFormat)
+{
+	for (const VkFormatEntry& entry : vkFormats()) {
+		if (entry.vkFormat == vkFormat) {
+			return entry.format;
+		}
+	}
+	return TextureFormatInvalid;
+}
+
+inline uint32_t vkOfFormat(TextureFormat format)
+{
+	for (const VkFormatEntry& entry : vkFormats()) {
+		if (entry.format == format) {
+			return entry.vkFormat;
+		}
+	}
+	return 0;
+}
+
+inline TextureFormat formatOfDxgi(uint32_t dxgiFormat)
+{
+	size_t count = 0;
+	const DxgiFormatEntry* entries = dxgiFormats(count);
+	for (size_t i = 0; i < count; ++i) {
+		if (entries[i].dxgiFormat == dxgiFormat) {
+			return entries[i].format;
+		}
+	}
+	return TextureFormatInvalid;
+}
+
+inline uint32_t dxgiOfFormat(TextureFormat format)
+{
+	size_t count = 0;
+	const DxgiFormatEntry* entries = dxgiFormats(count);
+	for (size_t i = 0; i < count; ++i) {
+		if (entries[i].format == format) {
+			return entries[i].dxgiFormat;
+		}
+	}
+	return 0;
+}
+
+constexpr uint32_t fourCC(char a, char b, char c, char d)
+{
+	return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+}
+
+constexpr uint8_t kKtx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+constexpr size_t kKtx2HeaderSize = 80;
+constexpr size_t kKtx2LevelIndexEntrySize = 24;
+constexpr size_t kDdsHeaderSize = 128;
+constexpr size_t kDdsDx10HeaderSize = 20;
+// TextureStreamer가 header를 찾으려고 처음 읽는 크기. KTX2 level index 32개도 충분히 들어간다.
+constexpr size_t kHeaderReadSize = 4096;
+
+inline bool readRange(std::ifstream& file, uint64_t offset, uint64_t size, uint8_t* out)
+{
+	file.seekg(std::streamoff(offset));
+	file.read(reinterpret_cast<char*>(out), std::streamsize(size));
+	return uint64_t(file.gcount()) == size;
+}
+
+} // namespace TextureDetail
+
+inline TextureLayout makeTextureLayout(TextureFormat format, uint32_t width, uint32_t height, uint32_t levels,
+		uint32_t layers, uint32_t faces, uint32_t depth)
+{
+	TextureLayout layout;
+	layout.format = format;
+	layout.width = width;
+	layout.height = height;
+	layout.depth = depth;
+	layout.layers = layers;
+	layout.faces = faces;
+	layout.levels = levels == 0 ? mipLevelCount(width, height, depth) : levels;
+	if (!TextureDetail::buildSubresources(layout)) {
+		return TextureLayout();
+	}
+	uint64_t offset = 0;
+	for (TextureSubresource& subresource : layout.subresources) {
+		subresource.offset = offset;
+		offset += subresource.size;
+	}
+	return layout;
+}
+
+#pragma endregion TextureFormat }
+
+#pragma region TextureParsing {
+
+/*
+ * KTX2: identifier(12) + header(68) + level index(levelCount x 24) + DFD + KVD + SGD + level data.
+ * level 안에는 layer, face, z 순서로 image가 이어져 있다. 파일에는 보통 작은 level이 앞에 있지만 index를 따른다.
+ * */
+inline bool parseKtx2(const uint8_t* bytes, size_t size, uint64_t fileSize, TextureLayout& layout)
+{
+	using namespace TextureDetail;
+	if (size < kKtx2HeaderSize || std::memcmp(bytes, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0) {
+		return fail("not a KTX2 file");
+	}
+	const uint32_t vkFormat = read32(bytes + 12);
+	const uint32_t levelCount = read32(bytes + 40);
+	if (read32(bytes + 44) != 0) {
+		return fail("KTX2 supercompression is not supported");
+	}
+	layout = TextureLayout();
+	layout.format = formatOfVk(vkFormat);
+	if (layout.format == TextureFormatInvalid) {
+		return fail("unsupported KTX2 vkFormat " + std::to_string(vkFormat));
+	}
+	// 0은 1D / 2D, array가 아님을 뜻한다. levelCount 0은 "불러온 쪽에서 mip을 만들라"는 뜻이고 level은 하나만 있다.
+	layout.width = read32(bytes + 20);
+	layout.height = std::max(1u, read32(bytes + 24));
+	layout.depth = std::max(1u, read32(bytes + 28));
+	layout.layers = std::max(1u, read32(bytes + 32));
+	layout.faces = read32(bytes + 36);
+	layout.levels = std::max(1u, levelCount);
+	if (!buildSubresources(layout)) {
+		return false;
+	}
+	if (size < kKtx2HeaderSize + layout.levels * kKtx2LevelIndexEntrySize) {
+		return fail("KTX2 level index is truncated");
+	}
+	for (uint32_t level = 0; level < layout.levels; ++level) {
+		const uint8_t* entry = bytes + kKtx2HeaderSize + level * kKtx2LevelIndexEntrySize;
+		const uint64_t byteOffset = read64(entry);
+		const uint64_t byteLength = read64(entry + 8);
+		if (byteLength < layout.levelSize(level)) {
+			return fail("KTX2 level " + std::to_string(level) + " is smaller than its images");
+		}
+		for (uint32_t slice = 0; slice < layout.slices(); ++slice) {
+			TextureSubresource& subresource = layout.subresources[level * layout.slices() + slice];
+			subresource.offset = byteOffset + slice * subresource.size;
+		}
+	}
+	return checkFileSize(layout, fileSize);
+}
+
+/*
+ * DDS: "DDS " + DDS_HEADER(124) [+ DDS_HEADER_DXT10(20)] + data.
+ * data는 layer(cube면 face)마다 모든 mip이 이어져 있다.
+ * */
+inline bool parseDds(const uint8_t* bytes, size_t size, uint64_t fileSize, TextureLayout& layout)
+{
+	using namespace TextureDetail;
+	if (size < kDdsHeaderSize || read32(bytes) != fourCC('D', 'D', 'S', ' ') || read32(bytes + 4) != 124) {
+		return fail("not a DDS file");
+	}
+	const uint32_t flags = read32(bytes + 8);
+	const uint32_t pixelFlags = read32(bytes + 80);
+	const uint32_t code = read32(bytes + 84);
+	const uint32_t caps2 = read32(bytes + 112);
+	layout = TextureLayout();
+	layout.height = read32(bytes + 12);
+	layout.width = read32(bytes + 16);
+	layout.depth = (flags & 0x800000) && (caps2 & 0x200000) ? std::max(1u, read32(bytes + 24)) : 1;
+	layout.levels = std::max(1u, read32(bytes + 28));
+	layout.faces = (caps2 & 0x200) ? 6 : 1;
+	if (layout.faces == 6 && (caps2 & 0xFC00) != 0xFC00) {
+		return fail("DDS cube maps must have all six faces");
+	}
+
+	size_t dataOffset = kDdsHeaderSize;
+	if ((pixelFlags & 0x4) && code == fourCC('D', 'X', '1', '0')) {
+		if (size < kDdsHeaderSize + kDdsDx10HeaderSize) {
+			return fail("DDS DX10 header is truncated");
+		}
+		const uint8_t* extension = bytes + kDdsHeaderSize;
+		const uint32_t dxgiFormat = read32(extension);
+		layout.format = formatOfDxgi(dxgiFormat);
+		if (layout.format == TextureFormatInvalid) {
+			return fail("unsupported DXGI format " + std::to_string(dxgiFormat));
+		}
+		if (read32(extension + 4) != 4) {
+			layout.depth = 1;
+		}
+		if (read32(extension + 8) & 0x4) {
+			layout.faces = 6;
+		}
+		layout.layers = std::max(1u, read32(extension + 12));
+		dataOffset += kDdsDx10HeaderSize;
+	} else if (pixelFlags & 0x4) {
+		switch (code) {
+			case fourCC('D', 'X', 'T', '1'): layout.format = TextureFormatBC1_RGBA; break;
+			case fourCC('D', 'X', 'T', '2'):
+			case fourCC('D', 'X', 'T', '3'): layout.format = TextureFormatBC2_RGBA; break;
+			case fourCC('D', 'X', 'T', '4'):
+			case fourCC('D', 'X', 'T', '5'): layout.format = TextureFormatBC3_RGBA; break;
+			case fourCC('A', 'T', 'I', '1'):
+			case fourCC('B', 'C', '4', 'U'): layout.format = TextureFormatBC4_RUnorm; break;
+			case fourCC('B', 'C', '4', 'S'): layout.format = TextureFormatBC4_RSnorm; break;
+			case fourCC('A', 'T', 'I', '2'):
+			case fourCC('B', 'C', '5', 'U'): layout.format = TextureFormatBC5_RGUnorm; break;
+			case fourCC('B', 'C', '5', 'S'): layout.format = TextureFormatBC5_RGSnorm; break;
+			// D3DFMT_A16B16G16R16F, D3DFMT_A32B32G32R32F
+			case 113: layout.format = TextureFormatRGBA16Float; break;
+			case 116: layout.format = TextureFormatRGBA32Float; break;
+			default: return fail("unsupported DDS FourCC");
+		}
+	} else {
+		// mask로 적힌 8 bit 채널
+		const uint32_t bits = read32(bytes + 88);
+		const uint32_t red = read32(bytes + 92), green = read32(bytes + 96), blue = read32(bytes + 100);
+		if (bits == 32 && red == 0xFF && green == 0xFF00 && blue == 0xFF0000) {
+			layout.format = TextureFormatRGBA8Unorm;
+		} else if (bits == 32 && red == 0xFF0000 && green == 0xFF00 && blue == 0xFF) {
+			layout.format = TextureFormatBGRA8Unorm;
+		} else if (bits == 16 && red == 0xFF && green == 0xFF00) {
+			layout.format = TextureFormatRG8Unorm;
+		} else if (bits == 8 && red == 0xFF) {
+			layout.format = TextureFormatR8Unorm;
+		} else {
+			return fail("unsupported DDS pixel format");
+		}
+	}
+	if (!buildSubresources(layout)) {
+		return false;
+	}
+	uint64_t offset = dataOffset;
+	for (uint32_t slice = 0; slice < layout.slices(); ++slice) {
+		for (uint32_t level = 0; level < layout.levels; ++level) {
+			TextureSubresource& subresource = layout.subresources[level * layout.slices() + slice];
+			subresource.offset = offset;
+			offset += subresource.size;
+		}
+	}
+	return checkFileSize(layout, fileSize);
+}
+
+inline bool parseTextureHeader(const uint8_t* bytes, size_t size, uint64_t fileSize, TextureLayout& layout)
+{
+	using namespace TextureDetail;
+	if (size >= sizeof(kKtx2Identifier) && std::memcmp(bytes, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0) {
+		return parseKtx2(bytes, size, fileSize, layout);
+	}
+	if (size >= 4 && read32(bytes) == fourCC('D', 'D', 'S', ' ')) {
+		return parseDds(bytes, size, fileSize, layout);
+	}
+	return fail("unknown texture container");
+}
+
+inline bool loadTexture(const char* path, TextureData& texture)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return TextureDetail::fail(std::string("file not found: ") + path);
+	}
+	const uint64_t size = uint64_t(file.tellg());
+	texture.bytes.resize(size_t(size));
+	if (!TextureDetail::readRange(file, 0, size, texture.bytes.data())) {
+		return TextureDetail::fail(std::string("failed to read: ") + path);
+	}
+	return parseTextureHeader(texture.bytes.data(), texture.bytes.size(), size, texture.layout);
+}
+
+#pragma endregion TextureParsing }
+
+#pragma region TextureWriting {
+
+/*
+ * level은 작은 것부터 쓰고 각각 lcm(block 크기, 4)에 맞춘다. 그래야 앞에서부터 읽어도 작은 mip이 먼저 온다.
+ * DFD는 color model과 block 크기만 적은 basic descriptor이다. (sample 정보는 쓰지 않는다)
+ * */
+inline bool encodeKtx2(const TextureData& texture, std::vector<uint8_t>& file)
+{
+	using namespace TextureDetail;
+	const TextureLayout& layout = texture.layout;
+	const uint32_t vkFormat = vkOfFormat(layout.format);
+	if (vkFormat == 0 || layout.subresources.empty()) {
+		return fail("format cannot be written to KTX2");
+	}
+	const TextureFormatInfo info = textureFormatInfo(layout.format);
+	const bool sRGB = (layout.format >= TextureFormatASTC_4x4_sRGB && layout.format <= TextureFormatASTC_12x12_sRGB)
+		|| layout.format == TextureFormatRGBA8Unorm_sRGB || layout.format == TextureFormatBGRA8Unorm_sRGB || layout.format == TextureFormatBC1_RGBA_sRGB
+		|| layout.format == TextureFormatBC2_RGBA_sRGB || layout.format == TextureFormatBC3_RGBA_sRGB || layout.format == TextureFormatBC7_RGBAUnorm_sRGB;
+	uint8_t colorModel = 1;
+	switch (layout.format) {
+		case TextureFormatBC1_RGBA: case TextureFormatBC1_RGBA_sRGB: colorModel = 128; break;
+		case TextureFormatBC2_RGBA: case TextureFormatBC2_RGBA_sRGB: colorModel = 129; break;
+		case TextureFormatBC3_RGBA: case TextureFormatBC3_RGBA_sRGB: colorModel = 130; break;
+		case TextureFormatBC4_RUnorm: case TextureFormatBC4_RSnorm: colorModel = 131; break;
+		case TextureFormatBC5_RGUnorm: case TextureFormatBC5_RGSnorm: colorModel = 132; break;
+		case TextureFormatBC6H_RGBFloat: case TextureFormatBC6H_RGBUfloat: colorModel = 133; break;
+		case TextureFormatBC7_RGBAUnorm: case TextureFormatBC7_RGBAUnorm_sRGB: colorModel = 134; break;
+		default: colorModel = info.blockWidth > 1 ? 162 : 1; break;
+	}
+
+	const size_t levelIndexOffset = kKtx2HeaderSize;
+	const size_t dfdOffset = levelIndexOffset + layout.levels * kKtx2LevelIndexEntrySize;
+	const size_t dfdSize = 4 + 24;
+	size_t alignment = info.bytesPerBlock % 4 == 0 ? info.bytesPerBlock : info.bytesPerBlock * (info.bytesPerBlock % 2 == 0 ? 2 : 4);
+	uint64_t offset = dfdOffset + dfdSize;
+	std::vector<uint64_t> levelOffsets(layout.levels);
+	for (uint32_t level = layout.levels; level-- > 0;) {
+		offset = (offset + alignment - 1) / alignment * alignment;
+		levelOffsets[level] = offset;
+		offset += layout.levelSize(level);
+	}
+
+	file.assign(size_t(offset), 0);
+	std::memcpy(file.data(), kKtx2Identifier, sizeof(kKtx2Identifier));
+	write32(file, 12, vkFormat);
+	// typeSize: 채널 하나의 byte 수. block 압축은 1이다.
+	write32(file, 16, layout.format == TextureFormatRGBA16Float ? 2 : (layout.format == TextureFormatRGBA32Float ? 4 : 1));
+	write32(file, 20, layout.width);
+	write32(file, 24, layout.height);
+	write32(file, 28, layout.type == TextureType3D ? layout.depth : 0);
+	write32(file, 32, layout.layers > 1 ? layout.layers : 0);
+	write32(file, 36, layout.faces);
+	write32(file, 40, layout.levels);
+	write32(file, 44, 0);
+	write32(file, 48, uint32_t(dfdOffset));
+	write32(file, 52, uint32_t(dfdSize));
+	for (uint32_t level = 0; level < layout.levels; ++level) {
+		const size_t entry = levelIndexOffset + level * kKtx2LevelIndexEntrySize;
+		write64(file, entry, levelOffsets[level]);
+		write64(file, entry + 8, layout.levelSize(level));
+		write64(file, entry + 16, layout.levelSize(level));
+		for (uint32_t slice = 0; slice < layout.slices(); ++slice) {
+			const TextureSubresource& subresource = layout.subresource(level, slice);
+			if (subresource.offset + subresource.size > texture.bytes.size()) {
+				return fail("texture data is smaller than its layout");
+			}
+			std::memcpy(file.data() + levelOffsets[level] + slice * subresource.size, texture.bytes.data() + subresource.offset, size_t(subresource.size));
+		}
+	}
+	// dfdTotalSize, vendorId / descriptorType(0), versionNumber(2) / descriptorBlockSize(24)
+	write32(file, dfdOffset, uint32_t(dfdSize));
+	write32(file, dfdOffset + 4, 0);
+	write32(file, dfdOffset + 8, 2 | 24u << 16);
+	file[dfdOffset + 12] = colorModel;
+	file[dfdOffset + 13] = 1;
+	file[dfdOffset + 14] = sRGB ? 2 : 1;
+	file[dfdOffset + 16] = uint8_t(info.blockWidth - 1);
+	file[dfdOffset + 17] = uint8_t(info.blockHeight - 1);
+	file[dfdOffset + 20] = uint8_t(info.bytesPerBlock);
+	return true;
+}
+
+// 항상 DX10 header를 쓴다.
+inline bool encodeDds(const TextureData& texture, std::vector<uint8_t>& file)
+{
+	using namespace TextureDetail;
+	const TextureLayout& layout = texture.layout;
+	const uint32_t dxgiFormat = dxgiOfFormat(layout.format);
+	if (dxgiFormat == 0 || layout.subresources.empty()) {
+		return fail("format cannot be written to DDS");
+	}
+	const size_t dataOffset = kDdsHeaderSize + kDdsDx10HeaderSize;
+	file.assign(dataOffset + size_t(layout.totalSize()), 0);
+	write32(file, 0, fourCC('D', 'D', 'S', ' '));
+	write32(file, 4, 124);
+	// CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT | LINEARSIZE (| DEPTH)
+	write32(file, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000 | (layout.type == TextureType3D ? 0x800000 : 0));
+	write32(file, 12, layout.height);
+	write32(file, 16, layout.width);
+	write32(file, 20, uint32_t(layout.subresource(0, 0).bytesPerImage));
+	write32(file, 24, layout.type == TextureType3D ? layout.depth : 0);
+	write32(file, 28, layout.levels);
+	write32(file, 76, 32);
+	write32(file, 80, 0x4);
+	write32(file, 84, fourCC('D', 'X', '1', '0'));
+	// TEXTURE | MIPMAP | COMPLEX
+	write32(file, 108, 0x1000 | (layout.levels > 1 ? 0x400008 : 0) | (layout.slices() > 1 ? 0x8 : 0));
+	write32(file, 112, (layout.faces == 6 ? 0x200 | 0xFC00 : 0) | (layout.type == TextureType3D ? 0x200000 : 0));
+	write32(file, kDdsHeaderSize, dxgiFormat);
+	write32(file, kDdsHeaderSize + 4, layout.type == TextureType3D ? 4 : 3);
+	write32(file, kDdsHeaderSize + 8, layout.faces == 6 ? 0x4 : 0);
+	write32(file, kDdsHeaderSize + 12, layout.layers);
+
+	uint64_t offset = dataOffset;
+	for (uint32_t slice = 0; slice < layout.slices(); ++slice) {
+		for (uint32_t level = 0; level < layout.levels; ++level) {
+			const TextureSubresource& subresource = layout.subresource(level, slice);
+			if (subresource.offset + subresource.size > texture.bytes.size()) {
+				return fail("texture data is smaller than its layout");
+			}
+			std::memcpy(file.data() + offset, texture.bytes.data() + subresource.offset, size_t(subresource.size));
+			offset += subresource.size;
+		}
+	}
+	return true;
+}
+
+inline bool saveTexture(const char* path, const TextureData& texture)
+{
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::vector<uint8_t> file;
+	if (extension == ".ktx2") {
+		if (!encodeKtx2(texture, file)) {
+			return false;
+		}
+	} else if (extension == ".dds") {
+		if (!encodeDds(texture, file)) {
+			return false;
+		}
+	} else {
+		return TextureDetail::fail("unknown texture extension: " + extension);
+	}
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(file.data()), std::streamsize(file.size()));
+	return bool(out) || TextureDetail::fail(std::string("failed to write: ") + path);
+}
+
+#pragma endregion TextureWriting }
+
+#pragma region TextureStreamer {
+
+inline TextureStreamer::~TextureStreamer()
+{
+	_cancel = true;
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this] { return _tasksInFlight == 0; });
+}
+
+inline bool TextureStreamer::readLevel(uint32_t level, TextureLevelData& data) const
+{
+	std::ifstream file(_path, std::ios::binary);
+	data.level = level;
+	data.bytes.resize(size_t(_layout.levelSize(level)));
+	// KTX2는 level의 slice가 붙어 있어 한 번에, DDS는 slice마다 따로 읽는다.
+	uint8_t* out = data.bytes.data();
+	for (uint32_t slice = 0; slice < _layout.slices(); ++slice) {
+		const TextureSubresource& subresource = _layout.subresource(level, slice);
+		if (!file || !TextureDetail::readRange(file, subresource.offset, subresource.size, out)) {
+			return TextureDetail::fail("failed to read level " + std::to_string(level) + " of " + _path);
+		}
+		out += subresource.size;
+	}
+	return true;
+}
+
+inline bool TextureStreamer::open(const char* path, uint64_t initialBytes)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return TextureDetail::fail(std::string("file not found: ") + path);
+	}
+	const uint64_t fileSize = uint64_t(file.tellg());
+	std::vector<uint8_t> header(size_t(std::min<uint64_t>(fileSize, TextureDetail::kHeaderReadSize)));
+	if (!TextureDetail::readRange(file, 0, header.size(), header.data())) {
+		return TextureDetail::fail(std::string("failed to read: ") + path);
+	}
+	_path = path;
+	if (!parseTextureHeader(header.data(), header.size(), fileSize, _layout)) {
+		return false;
+	}
+
+	_nextLevel = _layout.levels;
+	uint64_t loaded = 0;
+	while (_nextLevel > 0 && (loaded == 0 || loaded + _layout.levelSize(_nextLevel - 1) <= initialBytes)) {
+		TextureLevelData data;
+		if (!readLevel(_nextLevel - 1, data)) {
+			return false;
+		}
+		loaded += data.bytes.size();
+		_ready.push_back(std::move(data));
+		--_nextLevel;
+	}
+	return true;
+}
+
+inline void TextureStreamer::stream(ThreadPool& pool)
+{
+	uint32_t level = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_nextLevel == 0 || _tasksInFlight > 0) {
+			return;
+		}
+		++_tasksInFlight;
+		level = --_nextLevel;
+	}
+	ThreadPool* pPool = &pool;
+	pool.submit([this, level, pPool] { streamLevel(level, pPool); });
+}
+
+inline void TextureStreamer::streamLevel(uint32_t level, ThreadPool* pPool)
+{
+	TextureLevelData data;
+	const bool read = !_cancel && readLevel(level, data);
+	bool next = false;
+	uint32_t nextLevel = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (read) {
+			_ready.push_back(std::move(data));
+		} else {
+			_failed = _failed || !_cancel;
+		}
+		next = read && _nextLevel > 0;
+		if (next) {
+			nextLevel = --_nextLevel;
+		} else {
+			--_tasksInFlight;
+			_idle.notify_all();
+		}
+	}
+	// 다음 level은 새 작업으로 넘긴다. worker가 없으면 pool.submit이 바로 실행하므로 깊이는 level 수만큼이다.
+	if (next) {
+		pPool->submit([this, nextLevel, pPool] { streamLevel(nextLevel, pPool); });
+	}
+}
+
+inline bool TextureStreamer::poll(TextureLevelData& level)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_ready.empty()) {
+		return false;
+	}
+	level = std::move(_ready.front());
+	_ready.pop_front();
+	++_levelsPolled;
+	return true;
+}
+
+inline bool TextureStreamer::finished() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _levelsPolled == _layout.levels || (_failed && _ready.empty());
+}
+
+#pragma endregion TextureStreamer }
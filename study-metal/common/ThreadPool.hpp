@@ -0,0 +1,175 @@
+/*
+ * ThreadPool.hpp
+ *
+ * 여러 실습에서 공유하는 간단한 작업 스레드 풀.
+ * parallelFor는 호출한 스레드도 작업에 참여하기 때문에
+ * worker 안에서 다시 parallelFor를 호출해도 deadlock이 생기지 않는다.
+ * */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool {
+	public:
+		// numberOfThreads는 호출 스레드를 포함한 전체 스레드 수.
+		explicit ThreadPool(unsigned numberOfThreads = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Number of threads that take part in parallelFor (workers + caller).
+		unsigned size() const { return unsigned(_workers.size()) + 1; }
+
+		/*
+		 * [0, count) 구간을 grainSize 크기의 조각으로 나누어 fn(begin, end)를 병렬로 호출한다.
+		 * 모든 조각이 끝날 때까지 반환하지 않는다.
+		 * */
+		void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& fn);
+
+		// Runs fn on a worker thread and returns a future for its result.
+		template <class F>
+		auto submit(F&& fn) -> std::future<std::invoke_result_t<std::decay_t<F>>>;
+
+		// Process-wide pool sized to the machine.
+		static ThreadPool& shared();
+
+	private:
+		void enqueue(std::function<void()> job);
+		void workerLoop();
+
+		std::vector<std::thread> _workers;
+		std::deque<std::function<void()>> _jobs;
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		bool _stopping{false};
+};
+
+#pragma region ThreadPool {
+
+inline ThreadPool::ThreadPool(unsigned numberOfThreads)
+{
+	unsigned workerCount = numberOfThreads > 1 ? numberOfThreads - 1 : 0;
+	_workers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; ++i) {
+		_workers.emplace_back([this] { workerLoop(); });
+	}
+}
+
+inline ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_condition.notify_all();
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+}
+
+inline ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+inline void ThreadPool::enqueue(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(std::move(job));
+	}
+	_condition.notify_one();
+}
+
+inline void ThreadPool::workerLoop()
+{
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+			if (_stopping && _jobs.empty()) {
+				return;
+			}
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+		}
+		job();
+	}
+}
+
+inline void ThreadPool::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& fn)
+{
+	if (count == 0) {
+		return;
+	}
+	grainSize = std::max<size_t>(grainSize, 1);
+	const size_t numberOfChunks = (count + grainSize - 1) / grainSize;
+	if (numberOfChunks == 1 || _workers.empty()) {
+		fn(0, count);
+		return;
+	}
+
+	// 조각 분배 상태. 늦게 시작한 helper가 접근할 수 있으므로 shared_ptr로 수명을 관리한다.
+	struct Batch {
+		std::atomic<size_t> nextChunk{0};
+		size_t finishedChunks{0};
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+	auto pBatch = std::make_shared<Batch>();
+	auto runChunks = [pBatch, count, grainSize, numberOfChunks, &fn]() {
+		size_t finished = 0;
+		for (size_t chunk = pBatch->nextChunk.fetch_add(1); chunk < numberOfChunks;
+				chunk = pBatch->nextChunk.fetch_add(1)) {
+			size_t begin = chunk * grainSize;
+			fn(begin, std::min(begin + grainSize, count));
+			++finished;
+		}
+		if (finished > 0) {
+			std::lock_guard<std::mutex> lock(pBatch->mutex);
+			pBatch->finishedChunks += finished;
+			if (pBatch->finishedChunks == numberOfChunks) {
+				pBatch->done.notify_all();
+			}
+		}
+	};
+
+	const size_t helpers = std::min(_workers.size(), numberOfChunks - 1);
+	for (size_t i = 0; i < helpers; ++i) {
+		enqueue(runChunks);
+	}
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(pBatch->mutex);
+	pBatch->done.wait(lock, [&] { return pBatch->finishedChunks == numberOfChunks; });
+}
+
+template <class F>
+auto ThreadPool::submit(F&& fn) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+{
+	using Result = std::invoke_result_t<std::decay_t<F>>;
+	auto pTask = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(fn));
+	std::future<Result> future = pTask->get_future();
+	if (_workers.empty()) {
+		(*pTask)();
+	} else {
+		enqueue([pTask] { (*pTask)(); });
+	}
+	return future;
+}
+
+#pragma endregion ThreadPool }
@@ -0,0 +1,55 @@
+/*
+ * font-atlas
+ *
+ * TrueType font로 MSDF glyph atlas(.mfnt)를 만든다. 01-primitive는 LEARNMETAL_FONT=<.mfnt>로 통계 글자를 그린다.
+ *   font-atlas [font.ttf] [출력.mfnt] [em 크기(px)] [distance range(px)] [더할 글자]
+ * 기본은 ASCII 32 ~ 126, em 32 pixel, range 4 pixel이다. 다섯 번째 인자의 UTF-8 글자를 더 넣는다. (예: "°±×가나다")
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "FontAtlas.hpp"
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::fprintf(stderr, "usage: %s font.ttf output.mfnt [em size] [distance range] [extra characters]\n", argv[0]);
+		return 1;
+	}
+	FontAtlasOptions options;
+	options.emSize = argc > 3 ? float(std::atof(argv[3])) : options.emSize;
+	options.distanceRange = argc > 4 ? float(std::atof(argv[4])) : options.distanceRange;
+	if (options.emSize < 4.0f || options.distanceRange <= 0.0f) {
+		std::fprintf(stderr, "em size must be at least 4 and distance range positive\n");
+		return 1;
+	}
+	for (uint32_t codepoint = 32; codepoint < 127; ++codepoint) {
+		options.codepoints.push_back(codepoint);
+	}
+	for (const char* extra = argc > 5 ? argv[5] : ""; *extra;) {
+		options.codepoints.push_back(decodeUtf8(extra));
+	}
+
+	TtfFont font;
+	if (!font.open(argv[1])) {
+		return 1;
+	}
+	FontAtlas atlas;
+	auto start = std::chrono::steady_clock::now();
+	if (!generateFontAtlas(font, options, atlas)) {
+		return 1;
+	}
+	const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (!saveFontAtlas(argv[2], atlas)) {
+		return 1;
+	}
+	size_t missing = 0;
+	for (const FontGlyph& glyph : atlas.glyphs) {
+		missing += font.glyphIndex(glyph.codepoint) == 0 ? 1 : 0;
+	}
+	std::printf("%s: %zu glyphs (%zu missing), %zu kerning pairs -> %ux%u atlas at %.0f px/em, range %.1f px in %.1f ms\n", argv[1],
+			atlas.glyphs.size(), missing, atlas.kerning.size(), atlas.width, atlas.height, atlas.emSize, atlas.distanceRange, elapsed);
+	return 0;
+}
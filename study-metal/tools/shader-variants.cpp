@@ -0,0 +1,50 @@
+/*
+ * shader-variants
+ *
+ * glTF scene을 그릴 때 나올 수 있는 scene shader variant(function constant 조합)를 출력한다.
+ *   shader-variants [scene.gltf|glb] [texture] [fog] [skinning]
+ * 뒤의 인자는 renderer가 켜는 기능이다. texture는 LEARNMETAL_TEXTURE / LEARNMETAL_VIRTUAL_TEXTURE, fog는 LEARNMETAL_FOG와 같다.
+ * skinning은 JOINTS_0 / WEIGHTS_0이 있는 primitive에만 켜진다. (01-primitive는 아직 켜지 않는다)
+ * 나온 variant만 compile 하면 되고, 나머지는 scene에 없다.
+ * */
+#include <cstdio>
+#include <cstring>
+
+#include "ShaderVariants.hpp"
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s scene.(gltf|glb) [texture] [fog] [skinning]\n", argv[0]);
+		return 1;
+	}
+	ShaderVariantOptions options;
+	for (int i = 2; i < argc; ++i) {
+		if (std::strcmp(argv[i], "texture") == 0) {
+			options.texture = true;
+		} else if (std::strcmp(argv[i], "fog") == 0) {
+			options.fog = true;
+		} else if (std::strcmp(argv[i], "skinning") == 0) {
+			options.skinning = true;
+		} else {
+			std::fprintf(stderr, "unknown feature: %s\n", argv[i]);
+			return 1;
+		}
+	}
+	GltfScene scene;
+	if (!loadGltf(argv[1], scene)) {
+		return 1;
+	}
+	const std::vector<ShaderVariantUsage> variants = enumerateShaderVariants(scene, options);
+	std::printf("%s: %zu meshes, %zu draws -> %zu of %u variants\n", argv[1], scene.meshes.size(), scene.draws.size(),
+			variants.size(), kShaderVariantCount);
+	std::printf("%10s %-28s %12s %10s\n", "constants", "variant", "primitives", "draws");
+	for (const ShaderVariantUsage& variant : variants) {
+		char constants[kShaderFeatureCount + 1] = {};
+		for (uint32_t i = 0; i < kShaderFeatureCount; ++i) {
+			constants[i] = variant.features & (1u << i) ? '1' : '0';
+		}
+		std::printf("%10s %-28s %12u %10u\n", constants, shaderVariantName(variant.features).c_str(), variant.primitives, variant.draws);
+	}
+	return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * texture-compress
+ *
+ * RGBA8 / BGRA8 KTX2, DDS texture를 BCn이나 ASTC로 압축해서 저장한다.
+ *   texture-compress [입력] [출력] [bc1|bc2|bc3|bc4|bc5|bc7] [fast|normal|high]
+ *   texture-compress [입력] [출력] [astc4x4|astc5x5|astc6x6|astc8x6|astc8x8|astc10x10|astc12x12] [fast|thorough]
+ * 출력 형식은 확장자(.ktx2, .dds)로 정한다. DDS에는 ASTC가 없으므로 ASTC는 .ktx2로 저장한다.
+ * format은 기본 bc7, quality는 BCn이 normal, ASTC가 fast이다.
+ * 모든 mip과 slice를 압축하고, 가장 큰 level을 다시 풀어 PSNR과 압축 속도, 크기 비율을 출력한다.
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "AstcEncoder.hpp"
+#include "BcEncoder.hpp"
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::fprintf(stderr, "usage: %s input.(ktx2|dds) output.(ktx2|dds) [bc1|bc2|bc3|bc4|bc5|bc7] [fast|normal|high]\n"
+				"       %s input.(ktx2|dds) output.ktx2 [astc4x4|astc5x5|astc6x6|astc8x6|astc8x8|astc10x10|astc12x12] [fast|thorough]\n",
+				argv[0], argv[0]);
+		return 1;
+	}
+	struct Format {
+		const char* name;
+		TextureFormat format;
+		uint32_t channels;
+	};
+	const Format formats[] = { { "bc1", TextureFormatBC1_RGBA, 0x7 }, { "bc2", TextureFormatBC2_RGBA, 0xF }, { "bc3", TextureFormatBC3_RGBA, 0xF },
+		{ "bc4", TextureFormatBC4_RUnorm, 0x1 }, { "bc5", TextureFormatBC5_RGUnorm, 0x3 }, { "bc7", TextureFormatBC7_RGBAUnorm, 0xF },
+		{ "astc4x4", TextureFormatASTC_4x4_LDR, 0xF }, { "astc5x5", TextureFormatASTC_5x5_LDR, 0xF }, { "astc6x6", TextureFormatASTC_6x6_LDR, 0xF },
+		{ "astc8x6", TextureFormatASTC_8x6_LDR, 0xF }, { "astc8x8", TextureFormatASTC_8x8_LDR, 0xF },
+		{ "astc10x10", TextureFormatASTC_10x10_LDR, 0xF }, { "astc12x12", TextureFormatASTC_12x12_LDR, 0xF } };
+	const char* formatName = argc > 3 ? argv[3] : "bc7";
+	const Format* format = nullptr;
+	for (const Format& candidate : formats) {
+		if (std::strcmp(candidate.name, formatName) == 0) {
+			format = &candidate;
+		}
+	}
+	const bool astc = format && isAstcTextureFormat(format->format);
+	const char* qualityName = argc > 4 ? argv[4] : astc ? "fast" : "normal";
+	const char* bcQualities[] = { "fast", "normal", "high" };
+	const char* astcQualities[] = { "fast", "thorough" };
+	const char** qualities = astc ? astcQualities : bcQualities;
+	const int qualityCount = astc ? 2 : 3;
+	int quality = -1;
+	for (int i = 0; i < qualityCount; ++i) {
+		if (std::strcmp(qualities[i], qualityName) == 0) {
+			quality = i;
+		}
+	}
+	if (!format || quality < 0) {
+		std::fprintf(stderr, "unknown format or quality: %s %s\n", formatName, qualityName);
+		return 1;
+	}
+
+	TextureData source;
+	if (!loadTexture(argv[1], source)) {
+		return 1;
+	}
+	TextureData compressed;
+	auto start = std::chrono::steady_clock::now();
+	const bool compressedOk = astc ? compressTextureAstc(source, format->format, compressed, AstcQuality(quality))
+								   : compressTexture(source, format->format, compressed, BcQuality(quality));
+	if (!compressedOk) {
+		return 1;
+	}
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!saveTexture(argv[2], compressed)) {
+		return 1;
+	}
+
+	// BGRA 원본은 RGBA로 바꿔서 비교한다.
+	const TextureSubresource& top = source.layout.subresource(0, 0);
+	std::vector<uint8_t> original(source.data(0), source.data(0) + top.size);
+	if (source.layout.format == TextureFormatBGRA8Unorm || source.layout.format == TextureFormatBGRA8Unorm_sRGB) {
+		for (size_t i = 0; i + 4 <= original.size(); i += 4) {
+			std::swap(original[i], original[i + 2]);
+		}
+	}
+	std::vector<uint8_t> decoded(original.size());
+	if (astc) {
+		decodeAstc(compressed.layout.format, compressed.data(0), top.width, top.height, decoded.data(), top.bytesPerRow);
+	} else {
+		decodeBc(compressed.layout.format, compressed.data(0), top.width, top.height, decoded.data(), top.bytesPerRow);
+	}
+	double pixels = 0.0;
+	for (const TextureSubresource& subresource : source.layout.subresources) {
+		pixels += double(subresource.width) * subresource.height;
+	}
+	std::printf("%s: %ux%u, %u levels, %u slices -> %s %s\n", argv[1], source.layout.width, source.layout.height, source.layout.levels,
+			source.layout.slices(), format->name, qualityName);
+	std::printf("PSNR %.2f dB, %.2f Mpix/s, %llu -> %llu bytes (%.1fx)\n", computePsnr(original.data(), decoded.data(), top.width, top.height,
+			top.bytesPerRow, format->channels), pixels / elapsed * 1e-6, (unsigned long long)source.layout.totalSize(),
+			(unsigned long long)compressed.layout.totalSize(), double(source.layout.totalSize()) / double(compressed.layout.totalSize()));
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * texture-mipmap
+ *
+ * RGBA8 / BGRA8 KTX2, DDS texture의 level 0으로 1x1까지 mip chain을 만들어 저장한다.
+ *   texture-mipmap [입력] [출력] [box|kaiser] [alpha 기준] [wrap]
+ * filter는 기본 kaiser이다. alpha 기준(예: 0.5)을 주면 alpha test coverage를 모든 level에서 유지한다.
+ * 다섯 번째 인자로 wrap을 주면 가장자리 너머를 반대편에서 읽는다. (반복해서 까는 texture)
+ * 만든 texture는 texture-compress로 그대로 압축할 수 있다.
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "MipmapGenerator.hpp"
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::fprintf(stderr, "usage: %s input.(ktx2|dds) output.(ktx2|dds) [box|kaiser] [alpha reference] [wrap]\n", argv[0]);
+		return 1;
+	}
+	MipmapOptions options;
+	const char* filterName = argc > 3 ? argv[3] : "kaiser";
+	if (std::strcmp(filterName, "box") == 0) {
+		options.filter = MipFilterBox;
+	} else if (std::strcmp(filterName, "kaiser") != 0) {
+		std::fprintf(stderr, "unknown filter: %s\n", filterName);
+		return 1;
+	}
+	options.alphaReference = argc > 4 ? float(std::atof(argv[4])) : 0.0f;
+	options.wrap = argc > 5 && std::strcmp(argv[5], "wrap") == 0;
+
+	TextureData source;
+	if (!loadTexture(argv[1], source)) {
+		return 1;
+	}
+	TextureData mipmapped;
+	auto start = std::chrono::steady_clock::now();
+	if (!generateMipmaps(source, mipmapped, options)) {
+		return 1;
+	}
+	const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (!saveTexture(argv[2], mipmapped)) {
+		return 1;
+	}
+	std::printf("%s: %ux%u, %u slices -> %u levels (%s", argv[1], source.layout.width, source.layout.height, source.layout.slices(),
+			mipmapped.layout.levels, filterName);
+	if (options.alphaReference > 0.0f) {
+		std::printf(", alpha coverage at %.2f", options.alphaReference);
+	}
+	std::printf(") in %.2f ms\n", elapsed);
+	return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * texture-tile
+ *
+ * KTX2, DDS 2D texture를 virtual texture(.vtex)로 나눠 저장한다. LEARNMETAL_VIRTUAL_TEXTURE로 읽는다.
+ *   texture-tile [입력] [출력.vtex] [tile 너비] [tile 높이]
+ * tile 크기를 주지 않으면 16 KB sparse page 하나에 맞는 크기(RGBA8 64x64, BC7 128x128)를 쓴다.
+ * 파일에 level이 하나뿐이면 MipmapGenerator로 mip chain을 만든 뒤 나눈다. (RGBA8 / BGRA8만)
+ * */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "MipmapGenerator.hpp"
+#include "SparseTexture.hpp"
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		std::fprintf(stderr, "usage: %s input.(ktx2|dds) output.vtex [tile width] [tile height]\n", argv[0]);
+		return 1;
+	}
+	TextureData source;
+	if (!loadTexture(argv[1], source)) {
+		return 1;
+	}
+	uint32_t tileWidth = 0, tileHeight = 0;
+	defaultSparseTileSize(source.layout.format, tileWidth, tileHeight);
+	if (argc > 4) {
+		tileWidth = uint32_t(std::strtoul(argv[3], nullptr, 10));
+		tileHeight = uint32_t(std::strtoul(argv[4], nullptr, 10));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	TextureData mipmapped;
+	const TextureData* texture = &source;
+	if (source.layout.levels == 1 && mipLevelCount(source.layout.width, source.layout.height) > 1) {
+		if (!generateMipmaps(source, mipmapped, MipmapOptions())) {
+			return 1;
+		}
+		texture = &mipmapped;
+	}
+	if (!writeSparseTexture(argv[2], *texture, tileWidth, tileHeight)) {
+		return 1;
+	}
+	const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	const SparseTileLayout layout = makeSparseTileLayout(texture->layout.format, texture->layout.width, texture->layout.height,
+			texture->layout.levels, tileWidth, tileHeight);
+	std::printf("%s: %ux%u, %u levels%s -> %u tiles of %ux%u (%u bytes), mip tail from level %u (%llu bytes) in %.2f ms\n", argv[1],
+			layout.width, layout.height, layout.levels, texture == &mipmapped ? " (generated)" : "", layout.tileCount, tileWidth, tileHeight,
+			layout.tileBytes, layout.tailLevel, (unsigned long long)layout.tailBytes, elapsed);
+	return 0;
+}
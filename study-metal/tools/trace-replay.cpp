@@ -0,0 +1,219 @@
+/*
+ * trace-replay
+ *
+ * CommandTrace.hpp로 기록한 render encoder trace를 Metal 없이 재생한다.
+ *   trace-replay [trace 파일] [반복 횟수]
+ * frame마다 명령 수, draw 수, 저장된 buffer 내용 크기, 재생 시간, FilteringRenderEncoder를 거쳤을 때 남는 호출 수와
+ * draw state digest를 출력한다. digest는 handle 주소와 상관없이 정해지므로 두 trace를 비교하면 달라진 frame을 찾을 수 있다.
+ * 파일을 주지 않으면 가짜 scene을 몇 frame 기록해서 재생하고, 기록할 때와 draw state가 같은지 확인한다.
+ * frame을 거꾸로 재생해도 buffer 내용이 차례로 재생할 때와 같은지도 확인한다.
+ * */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "BenchUtil.hpp"
+#include "CommandTrace.hpp"
+#include "FilteringEncoder.hpp"
+#include "RecordingEncoder.hpp"
+
+// 호출 수만 세는 encoder. trace를 읽고 나눠 주는 비용만 잰다.
+struct CountingEncoder {
+	size_t calls{0};
+
+	void setRenderPipelineState(const void*) { ++calls; }
+	void setDepthStencilState(const void*) { ++calls; }
+	void setViewport(const RecordedViewport&) { ++calls; }
+	void setCullMode(uint32_t) { ++calls; }
+	void setVertexBuffer(const void*, uint64_t, uint64_t) { ++calls; }
+	void setVertexBufferOffset(uint64_t, uint64_t) { ++calls; }
+	void setVertexBytes(const void*, uint64_t, uint64_t) { ++calls; }
+	void setFragmentBuffer(const void*, uint64_t, uint64_t) { ++calls; }
+	void setFragmentBufferOffset(uint64_t, uint64_t) { ++calls; }
+	void setFragmentBytes(const void*, uint64_t, uint64_t) { ++calls; }
+	void setVertexTexture(const void*, uint64_t) { ++calls; }
+	void setVertexSamplerState(const void*, uint64_t) { ++calls; }
+	void setFragmentTexture(const void*, uint64_t) { ++calls; }
+	void setFragmentSamplerState(const void*, uint64_t) { ++calls; }
+	void drawPrimitives(uint32_t, uint64_t, uint64_t, uint64_t) { ++calls; }
+	void drawIndexedPrimitives(uint32_t, uint64_t, uint32_t, const void*, uint64_t, uint64_t) { ++calls; }
+};
+
+static uint64_t digestOf(const std::vector<uint64_t>& hashes)
+{
+	uint64_t digest = 0xCBF29CE484222325ull;
+	for (uint64_t hash : hashes) {
+		digest = (digest ^ hash) * 0x100000001B3ull;
+	}
+	return digest;
+}
+
+// 가짜 scene의 buffer. handle이 이 구조체의 주소이다.
+struct SyntheticBuffer {
+	std::vector<uint8_t> contents;
+};
+
+static TraceBufferView syntheticContents(const void* buffer)
+{
+	const SyntheticBuffer* synthetic = static_cast<const SyntheticBuffer*>(buffer);
+	return { synthetic->contents.data(), synthetic->contents.size() };
+}
+
+/*
+ * pipeline 8종, mesh 64개, texture 4장, instance 2000개인 scene을 frame 수만큼 기록한다. vertex buffer는 그대로이고
+ * instance buffer만 frame마다 바뀐다. 기록하면서 넘긴 RecordingEncoder의 draw hash를 frame별로 돌려준다.
+ * */
+static std::vector<uint8_t> captureSyntheticScene(size_t numberOfFrames, std::vector<std::vector<uint64_t>>& capturedHashes)
+{
+	const uint32_t numberOfPipelines = 8, numberOfMeshes = 64, numberOfInstances = 2000;
+	std::mt19937 random(11);
+	std::vector<SyntheticBuffer> vertexBuffers(4);
+	for (SyntheticBuffer& buffer : vertexBuffers) {
+		buffer.contents.resize(numberOfMeshes / 4 * 4096);
+		for (uint8_t& byte : buffer.contents) {
+			byte = uint8_t(random());
+		}
+	}
+	SyntheticBuffer instanceBuffer;
+	instanceBuffer.contents.resize(numberOfInstances * 80);
+	int pipelineStates[numberOfPipelines], depthStencilStates[2], textures[4], samplerStates[2];
+
+	CommandTraceWriter writer;
+	writer.setBufferResolver(syntheticContents);
+	RecordingEncoder recorder;
+	CapturingRenderEncoder<RecordingEncoder> capturing(&recorder);
+	capturing.setWriter(&writer);
+	FilteringRenderEncoder<CapturingRenderEncoder<RecordingEncoder>> encoder;
+	for (size_t frame = 0; frame < numberOfFrames; ++frame) {
+		for (size_t i = 0; i < instanceBuffer.contents.size(); ++i) {
+			instanceBuffer.contents[i] = uint8_t(i * 7 + frame);
+		}
+		recorder.clear();
+		encoder.reset(&capturing);
+		writer.beginFrame();
+		const float transform[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, float(frame), 1.0f };
+		encoder.setViewport(RecordedViewport{ 0.0, 0.0, 1280.0, 720.0, 0.0, 1.0 });
+		encoder.setVertexBytes(transform, sizeof(transform), 16);
+		encoder.setFragmentSamplerState(&samplerStates[frame & 1], 0);
+		uint32_t firstInstance = 0;
+		for (uint32_t pipeline = 0; pipeline < numberOfPipelines; ++pipeline) {
+			encoder.setRenderPipelineState(&pipelineStates[pipeline]);
+			encoder.setDepthStencilState(&depthStencilStates[pipeline >= 6]);
+			encoder.setCullMode(pipeline & 1);
+			for (uint32_t mesh = pipeline; mesh < numberOfMeshes; mesh += numberOfPipelines) {
+				const SyntheticBuffer* vertexBuffer = &vertexBuffers[mesh % 4];
+				const size_t meshOffset = mesh / 4 * 4096;
+				encoder.setVertexBuffer(vertexBuffer, meshOffset, 0);
+				encoder.setVertexBuffer(vertexBuffer, meshOffset + 2048, 1);
+				encoder.setVertexBuffer(&instanceBuffer, firstInstance * 80, 17);
+				encoder.setFragmentTexture(&textures[mesh / 16], 0);
+				const uint32_t instanceCount = numberOfInstances / numberOfMeshes;
+				if (mesh % 3) {
+					encoder.drawIndexedPrimitives(3u, 384u, 1u, vertexBuffer, meshOffset + 3072, instanceCount);
+				} else {
+					encoder.drawPrimitives(3u, 0u, 192u, instanceCount);
+				}
+				firstInstance += instanceCount;
+			}
+		}
+		writer.endFrame();
+		capturedHashes.push_back(recorder.drawStateHashes());
+	}
+	return writer.bytes();
+}
+
+// replayFrame 직후 모든 buffer 내용의 digest. 재생 순서와 상관없이 frame마다 같아야 한다.
+static uint64_t contentsDigestOf(const CommandTraceReplayer& replayer, const CommandTrace& trace)
+{
+	uint64_t digest = 0xCBF29CE484222325ull;
+	for (size_t id = 1; id < trace.numberOfIds(); ++id) {
+		TraceBufferView view = replayer.contents(id);
+		const uint8_t* bytes = static_cast<const uint8_t*>(view.contents);
+		digest = (digest ^ view.length) * 0x100000001B3ull;
+		for (size_t i = 0; i < view.length; ++i) {
+			digest = (digest ^ bytes[i]) * 0x100000001B3ull;
+		}
+	}
+	return digest;
+}
+
+int main(int argc, char* argv[])
+{
+	CommandTrace trace;
+	std::string error;
+	std::vector<std::vector<uint64_t>> capturedHashes;
+	const int repeat = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+	if (argc > 1) {
+		if (!trace.load(argv[1], error)) {
+			std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+			return 1;
+		}
+	} else {
+		std::printf("usage: %s [trace] [repeat]. replaying a synthetic capture.\n", argv[0]);
+		if (!trace.parse(captureSyntheticScene(8, capturedHashes), error)) {
+			std::fprintf(stderr, "synthetic trace: %s\n", error.c_str());
+			return 1;
+		}
+	}
+
+	size_t opCounts[size_t(TraceOp::Count)] = {};
+	for (const TraceCommand& command : trace.commands()) {
+		++opCounts[size_t(command.op)];
+	}
+	std::printf("%zu bytes, %zu frames, %zu commands, %zu objects / buffers\n", trace.sizeInBytes(), trace.frames().size(),
+			trace.commands().size(), trace.numberOfIds() - 1);
+	for (size_t op = 0; op < size_t(TraceOp::Count); ++op) {
+		if (opCounts[op]) {
+			std::printf("  %-24s %10zu\n", traceOpName(TraceOp(op)), opCounts[op]);
+		}
+	}
+
+	std::printf("%6s %10s %8s %12s %12s %12s %18s\n", "frame", "commands", "draws", "contents(KB)", "replay(us)", "filtered to",
+			"digest");
+	CommandTraceReplayer replayer(trace);
+	CommandTraceReplayer original(trace, true);
+	bool matchesCapture = true;
+	std::vector<uint64_t> contentsDigests;
+	for (size_t frame = 0; frame < trace.frames().size(); ++frame) {
+		const TraceFrame& range = trace.frames()[frame];
+		RecordingEncoder recorder;
+		replayer.replayFrame(frame, recorder);
+		const uint64_t digest = digestOf(recorder.drawStateHashes());
+		contentsDigests.push_back(contentsDigestOf(replayer, trace));
+
+		RecordingEncoder filtered;
+		FilteringRenderEncoder<RecordingEncoder> filtering(&filtered);
+		replayer.replayFrame(frame, filtering);
+
+		CountingEncoder counter;
+		double milliseconds = bestOf(repeat, [&] {
+			replayer.replayFrame(frame, counter);
+		});
+		std::printf("%6zu %10zu %8zu %12.1f %12.1f %12zu %18llx\n", frame, range.numberOfCommands, range.numberOfDraws,
+				range.contentBytes / 1024.0, milliseconds * 1e3, filtered.calls().size(), (unsigned long long)digest);
+
+		if (frame < capturedHashes.size()) {
+			RecordingEncoder replayed;
+			original.replayFrame(frame, replayed);
+			matchesCapture = matchesCapture && replayed.drawStateHashes() == capturedHashes[frame];
+		}
+	}
+	// 새 replayer로 마지막 frame부터 재생한다. 앞 frame에서만 저장된 buffer도 내용이 있어야 한다.
+	CommandTraceReplayer reversed(trace);
+	bool matchesInOrder = true;
+	for (size_t frame = trace.frames().size(); frame-- > 0;) {
+		CountingEncoder counter;
+		reversed.replayFrame(frame, counter);
+		matchesInOrder = matchesInOrder && contentsDigestOf(reversed, trace) == contentsDigests[frame];
+	}
+	std::printf("reversed replay contents match: %s\n", matchesInOrder ? "yes" : "NO");
+	if (!matchesInOrder) {
+		return 1;
+	}
+	if (!capturedHashes.empty()) {
+		std::printf("replay matches capture: %s\n", matchesCapture ? "yes" : "NO");
+		return matchesCapture ? 0 : 1;
+	}
+	return 0;
+}